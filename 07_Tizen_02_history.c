@@ -0,0 +1,190 @@
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define HIST_MAGIC "TVAPI-HISTORY 1"
+
+struct curl_slist *hist_parse_headers(const char *text) {
+  if (!text || !*text) return NULL;
+  struct curl_slist *list = NULL;
+  const char *p = text;
+  char buf[2048];
+
+  while (*p) {
+    const char *nl = strchr(p, '\n');
+    size_t n = nl ? (size_t)(nl - p) : strlen(p);
+    /* trim CR and spaces */
+    size_t m = n;
+    while (m && (p[m-1] == '\r' || p[m-1] == ' ')) m--;
+    if (m > sizeof(buf) - 1) m = sizeof(buf) - 1;
+    memcpy(buf, p, m); buf[m] = 0;
+
+    if (m > 0) {
+      struct curl_slist *next = curl_slist_append(list, buf);
+      if (!next) { curl_slist_free_all(list); return NULL; }
+      list = next;
+    }
+    p = nl ? nl + 1 : p + n;
+  }
+  return list;
+}
+
+static char *dup_or_empty(const char *s) {
+  return strdup(s ? s : "");
+}
+
+static void entry_free(hist_entry *e) {
+  if (!e) return;
+  free(e->method); free(e->url); free(e->headers); free(e->body);
+  curl_slist_free_all(e->hdrs);
+  free(e);
+}
+
+static hist_entry *entry_new(const char *method, const char *url, const char *headers, const char *body) {
+  hist_entry *e = calloc(1, sizeof(*e));
+  if (!e) return NULL;
+  e->method = dup_or_empty(method);
+  e->url = dup_or_empty(url);
+  e->headers = dup_or_empty(headers);
+  e->body = dup_or_empty(body);
+  if (!e->method || !e->url || !e->headers || !e->body) { entry_free(e); return NULL; }
+  e->hdrs = hist_parse_headers(e->headers);
+  return e;
+}
+
+/* FNV-1a over the request identity names the cache file. */
+void hist_cache_path(const history *h, const hist_entry *e, char *out, size_t len) {
+  unsigned long long x = 1469598103934665603ULL;
+  const char *parts[] = { e->method, e->url, e->headers, e->body };
+  for (int i = 0; i < 4; i++) {
+    for (const unsigned char *p = (const unsigned char *)parts[i]; *p; p++) {
+      x ^= *p;
+      x *= 1099511628211ULL;
+    }
+    x ^= 0xff;                    /* field separator */
+    x *= 1099511628211ULL;
+  }
+  snprintf(out, len, "%s/cache/%016llx.body", h->dir, x);
+}
+
+void hist_uncache(history *h, hist_entry *e) {
+  char path[512];
+  hist_cache_path(h, e, path, sizeof(path));
+  remove(path);
+  e->cached = 0;
+  e->etag[0] = 0;
+  e->last_modified[0] = 0;
+}
+
+/* ----- Persistence -----
+ * "<status> <ms> <bytes> <when> <cached> <len>x6\n" then the six fields
+ * back to back (method, url, headers, body, etag, last-modified) and "\n". */
+
+static char *read_field(FILE *fp, size_t len) {
+  char *s = malloc(len + 1);
+  if (!s) return NULL;
+  if (fread(s, 1, len, fp) != len) { free(s); return NULL; }
+  s[len] = 0;
+  return s;
+}
+
+void hist_open(history *h, const char *dir) {
+  memset(h, 0, sizeof(*h));
+  snprintf(h->dir, sizeof(h->dir), "%s", dir);
+  char path[512];
+  mkdir(h->dir, 0700);
+  snprintf(path, sizeof(path), "%s/cache", h->dir);
+  mkdir(path, 0700);
+
+  snprintf(path, sizeof(path), "%s/history.txt", h->dir);
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return;
+  char magic[32];
+  if (!fgets(magic, sizeof(magic), fp) || strncmp(magic, HIST_MAGIC, strlen(HIST_MAGIC))) {
+    fclose(fp);
+    return;
+  }
+  while (h->count < HIST_MAX) {
+    long status; double ms; size_t bytes; long long when; int cached;
+    size_t len[6];
+    if (fscanf(fp, "%ld %lf %zu %lld %d %zu %zu %zu %zu %zu %zu", &status, &ms, &bytes, &when,
+               &cached, &len[0], &len[1], &len[2], &len[3], &len[4], &len[5]) != 11) break;
+    if (fgetc(fp) != '\n') break;
+    char *f[6] = {0};
+    int ok = 1;
+    for (int i = 0; i < 6 && ok; i++) ok = (f[i] = read_field(fp, len[i])) != NULL;
+    if (ok) ok = fgetc(fp) == '\n';
+    hist_entry *e = ok ? entry_new(f[0], f[1], f[2], f[3]) : NULL;
+    if (e) {
+      e->status = status;
+      e->total_ms = ms;
+      e->bytes = bytes;
+      e->when = when;
+      e->cached = cached;
+      snprintf(e->etag, sizeof(e->etag), "%s", f[4]);
+      snprintf(e->last_modified, sizeof(e->last_modified), "%s", f[5]);
+      h->items[h->count++] = e;
+    }
+    for (int i = 0; i < 6; i++) free(f[i]);
+    if (!e) break;
+  }
+  fclose(fp);
+}
+
+int hist_save(const history *h) {
+  char path[512], tmp[520];
+  snprintf(path, sizeof(path), "%s/history.txt", h->dir);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *fp = fopen(tmp, "wb");
+  if (!fp) return -1;
+  fprintf(fp, "%s\n", HIST_MAGIC);
+  for (int i = 0; i < h->count; i++) {
+    const hist_entry *e = h->items[i];
+    const char *f[6] = { e->method, e->url, e->headers, e->body, e->etag, e->last_modified };
+    fprintf(fp, "%ld %.3f %zu %lld %d", e->status, e->total_ms, e->bytes, e->when, e->cached);
+    for (int k = 0; k < 6; k++) fprintf(fp, " %zu", strlen(f[k]));
+    fputc('\n', fp);
+    for (int k = 0; k < 6; k++) fputs(f[k], fp);
+    fputc('\n', fp);
+  }
+  int ok = !ferror(fp);
+  if (fclose(fp) != 0) ok = 0;
+  if (ok && rename(tmp, path) != 0) ok = 0;
+  if (!ok) remove(tmp);
+  return ok ? 0 : -1;
+}
+
+void hist_close(history *h) {
+  for (int i = 0; i < h->count; i++) entry_free(h->items[i]);
+  h->count = 0;
+}
+
+hist_entry *hist_record(history *h, const char *method, const char *url,
+                        const char *headers, const char *body) {
+  int i = 0;
+  for (; i < h->count; i++) {
+    const hist_entry *e = h->items[i];
+    if (!strcmp(e->method, method) && !strcmp(e->url, url) &&
+        !strcmp(e->headers, headers ? headers : "") && !strcmp(e->body, body ? body : ""))
+      break;
+  }
+  hist_entry *e;
+  if (i < h->count) {
+    e = h->items[i];
+  } else {
+    e = entry_new(method, url, headers, body);
+    if (!e) return NULL;
+    if (h->count == HIST_MAX) {
+      hist_uncache(h, h->items[HIST_MAX - 1]);
+      entry_free(h->items[HIST_MAX - 1]);
+      h->count--;
+    }
+    i = h->count++;
+  }
+  memmove(&h->items[1], &h->items[0], (size_t)i * sizeof(h->items[0]));
+  h->items[0] = e;
+  return e;
+}
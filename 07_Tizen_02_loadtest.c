@@ -0,0 +1,229 @@
+#include "loadtest.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define LT_LOG_STEP 0.04879016416943205   /* ln(1.05) */
+
+typedef struct {
+  CURL *curl;
+  char *url;
+  char *body;
+  unsigned long seq;
+} slot;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Copy of tmpl with every "{{seq}}" replaced by seq. */
+static char *expand(const char *tmpl, unsigned long seq) {
+  if (!tmpl) return NULL;
+  char num[24];
+  int nlen = snprintf(num, sizeof(num), "%lu", seq);
+  size_t hits = 0;
+  for (const char *p = tmpl; (p = strstr(p, "{{seq}}")); p += 7) hits++;
+  char *out = malloc(strlen(tmpl) + hits * (size_t)nlen + 1);
+  if (!out) return NULL;
+  char *o = out;
+  const char *p = tmpl, *q;
+  while ((q = strstr(p, "{{seq}}"))) {
+    memcpy(o, p, (size_t)(q - p)); o += q - p;
+    memcpy(o, num, (size_t)nlen); o += nlen;
+    p = q + 7;
+  }
+  strcpy(o, p);
+  return out;
+}
+
+static size_t count_cb(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  (void)ptr;
+  *(unsigned long *)userdata += size * nmemb;
+  return size * nmemb;
+}
+
+static void record(lt_stats *s, CURLcode rc, long code, double ms) {
+  s->done++;
+  if (rc != CURLE_OK) {
+    s->by_class[0]++;
+    int i = 0;
+    while (i < LT_MAX_ERRORS && s->errors[i].count && s->errors[i].code != (int)rc) i++;
+    if (i < LT_MAX_ERRORS) { s->errors[i].code = (int)rc; s->errors[i].count++; }
+    return;
+  }
+  int cls = (int)(code / 100);
+  if (cls >= 1 && cls <= 5) s->by_class[cls]++;
+  if (s->done - s->by_class[0] == 1 || ms < s->min_ms) s->min_ms = ms;
+  if (ms > s->max_ms) s->max_ms = ms;
+  s->sum_ms += ms;
+  double us = ms * 1000.0;
+  int b = us <= 1.0 ? 0 : (int)(log(us) / LT_LOG_STEP);
+  if (b >= LT_BUCKETS) b = LT_BUCKETS - 1;
+  s->hist[b]++;
+}
+
+static int start(CURLM *m, slot *sl, const lt_config *cfg, unsigned long seq) {
+  free(sl->url); free(sl->body);
+  sl->url = expand(cfg->url, seq);
+  sl->body = expand(cfg->body, seq);
+  sl->seq = seq;
+  if (!sl->url) return -1;
+  curl_easy_setopt(sl->curl, CURLOPT_URL, sl->url);
+  if (sl->body && *sl->body) curl_easy_setopt(sl->curl, CURLOPT_POSTFIELDS, sl->body);
+  return curl_multi_add_handle(m, sl->curl) == CURLM_OK ? 0 : -1;
+}
+
+static void setup_handle(CURL *c, const lt_config *cfg, lt_stats *s) {
+  curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(c, CURLOPT_USERAGENT, "TV-API-Tester/1.0 (load)");
+  curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, count_cb);
+  curl_easy_setopt(c, CURLOPT_WRITEDATA, &s->bytes);
+  curl_easy_setopt(c, CURLOPT_TIMEOUT, cfg->timeout_sec > 0 ? cfg->timeout_sec : 30L);
+  curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+  if (cfg->headers) curl_easy_setopt(c, CURLOPT_HTTPHEADER, cfg->headers);
+  const char *m = cfg->method ? cfg->method : "GET";
+  if (!strcasecmp(m, "POST")) curl_easy_setopt(c, CURLOPT_POST, 1L);
+  else if (strcasecmp(m, "GET")) curl_easy_setopt(c, CURLOPT_CUSTOMREQUEST, m);
+}
+
+int lt_run(const lt_config *cfg, lt_stats *out, lt_cancel_fn cancelled,
+           lt_progress_fn progress, void *ctx) {
+  memset(out, 0, sizeof(*out));
+  int n = cfg->concurrency > 0 ? cfg->concurrency : 1;
+  if (cfg->total > 0 && n > cfg->total) n = cfg->total;
+  if (cfg->total <= 0 && cfg->duration_sec <= 0) return -1;
+
+  CURLM *m = curl_multi_init();
+  slot *slots = calloc((size_t)n, sizeof(slot));
+  if (!m || !slots) { if (m) curl_multi_cleanup(m); free(slots); return -1; }
+  curl_multi_setopt(m, CURLMOPT_MAX_HOST_CONNECTIONS, (long)n);
+
+  const double t0 = now_sec();
+  const double deadline = cfg->duration_sec > 0 ? t0 + cfg->duration_sec : 0;
+  double next_report = t0 + 0.5;
+  int rc = 0, running = 0;
+
+  for (int i = 0; i < n; i++) {
+    slots[i].curl = curl_easy_init();
+    if (!slots[i].curl) { rc = -1; goto done; }
+    setup_handle(slots[i].curl, cfg, out);
+    curl_easy_setopt(slots[i].curl, CURLOPT_PRIVATE, &slots[i]);
+    if (start(m, &slots[i], cfg, ++out->sent) < 0) { rc = -1; goto done; }
+    running++;
+  }
+
+  while (running > 0) {
+    int still = 0;
+    curl_multi_perform(m, &still);
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(m, &left))) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      CURL *c = msg->easy_handle;
+      slot *sl = NULL;
+      long code = 0;
+      double total = 0;
+      curl_easy_getinfo(c, CURLINFO_PRIVATE, (char **)&sl);
+      curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &code);
+      curl_easy_getinfo(c, CURLINFO_TOTAL_TIME, &total);
+      record(out, msg->data.result, code, total * 1000.0);
+      curl_multi_remove_handle(m, c);
+      running--;
+
+      double now = now_sec();
+      int more = (cfg->total <= 0 || out->sent < (unsigned long)cfg->total) &&
+                 (!deadline || now < deadline) && !(cancelled && cancelled(ctx));
+      /* same easy handle again: its connection stays in the multi cache */
+      if (more && start(m, sl, cfg, ++out->sent) == 0) running++;
+    }
+    if (cancelled && cancelled(ctx)) break;
+
+    double now = now_sec();
+    if (progress && now >= next_report) {
+      out->elapsed_sec = now - t0;
+      progress(out, ctx);
+      next_report = now + 0.5;
+    }
+    if (running > 0) curl_multi_wait(m, NULL, 0, 100, NULL);
+  }
+
+done:
+  out->elapsed_sec = now_sec() - t0;
+  for (int i = 0; i < n; i++) {
+    if (!slots[i].curl) continue;
+    curl_multi_remove_handle(m, slots[i].curl);
+    curl_easy_cleanup(slots[i].curl);
+    free(slots[i].url);
+    free(slots[i].body);
+  }
+  free(slots);
+  curl_multi_cleanup(m);
+  return rc;
+}
+
+static double bucket_upper_ms(int b) {
+  return exp((b + 1) * LT_LOG_STEP) / 1000.0;
+}
+
+double lt_percentile(const lt_stats *s, double q) {
+  unsigned long n = 0;
+  for (int b = 0; b < LT_BUCKETS; b++) n += s->hist[b];
+  if (!n) return 0;
+  unsigned long rank = (unsigned long)ceil(q * (double)n), seen = 0;
+  if (rank < 1) rank = 1;
+  for (int b = 0; b < LT_BUCKETS; b++) {
+    seen += s->hist[b];
+    if (seen >= rank) {
+      double v = bucket_upper_ms(b);
+      return v > s->max_ms ? s->max_ms : v;
+    }
+  }
+  return s->max_ms;
+}
+
+void lt_format(const lt_stats *s, char *buf, size_t len) {
+  size_t o = 0;
+#define OUT(...) do { if (o < len) o += (size_t)snprintf(buf + o, len - o, __VA_ARGS__); } while (0)
+  unsigned long timed = s->done - s->by_class[0];
+  double secs = s->elapsed_sec > 0 ? s->elapsed_sec : 1e-9;
+  OUT("Requests: %lu done in %.2f s  (%.1f req/s, %.2f MB received)\n",
+      s->done, s->elapsed_sec, s->done / secs, s->bytes / (1024.0 * 1024.0));
+  if (timed) {
+    OUT("Latency ms: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  mean %.1f\n",
+        s->min_ms, lt_percentile(s, 0.50), lt_percentile(s, 0.90), lt_percentile(s, 0.99),
+        s->max_ms, s->sum_ms / timed);
+  }
+  OUT("Status: 2xx %lu  3xx %lu  4xx %lu  5xx %lu  transport errors %lu\n",
+      s->by_class[2], s->by_class[3], s->by_class[4], s->by_class[5], s->by_class[0]);
+  for (int i = 0; i < LT_MAX_ERRORS && s->errors[i].count; i++)
+    OUT("  curl %d (%s): %lu\n", s->errors[i].code,
+        curl_easy_strerror((CURLcode)s->errors[i].code), s->errors[i].count);
+
+  /* fold the fine buckets into power-of-two ms rows */
+  unsigned long rows[32] = {0}, peak = 0;
+  int lo = 32, hi = -1;
+  for (int b = 0; b < LT_BUCKETS; b++) {
+    if (!s->hist[b]) continue;
+    double ms = exp(b * LT_LOG_STEP) / 1000.0;
+    int r = ms < 1.0 ? 0 : 1 + (int)floor(log2(ms));
+    if (r > 31) r = 31;
+    rows[r] += s->hist[b];
+    if (r < lo) lo = r;
+    if (r > hi) hi = r;
+  }
+  for (int r = lo; r <= hi; r++) if (rows[r] > peak) peak = rows[r];
+  if (hi >= 0) OUT("Histogram:\n");
+  for (int r = lo; r <= hi; r++) {
+    char bar[41];
+    int w = peak ? (int)(rows[r] * 40 / peak) : 0;
+    memset(bar, '#', (size_t)w); bar[w] = 0;
+    OUT("  < %6.0f ms  %-40s %lu\n", r == 0 ? 1.0 : ldexp(1.0, r), bar, rows[r]);
+  }
+#undef OUT
+}
@@ -1,17 +1,38 @@
 #include "app.h"
+#include "history.h"
+#include "loadtest.h"
+
+#include <time.h>
+
+#define SAVE_DIR "/opt/usr/home/owner/content/Downloads/"
+#define HISTORY_DIR "/opt/usr/home/owner/content/Documents/.tv_api_tester"
+#define VIEW_CAP_KB_DEFAULT 256       /* response pane shows at most this much */
+#define VIEW_CHUNK_BYTES (16 * 1024)  /* streamed to the pane in pieces of about this size */
 
 typedef struct appdata_s {
   Evas_Object *win, *bg, *root;
 
   Evas_Object *url_entry;
   Evas_Object *method_sel;
+  Evas_Object *history_sel;
+  Evas_Object *cache_chk;
   Evas_Object *headers_entry;
   Evas_Object *body_entry;
   Evas_Object *send_btn;
   Evas_Object *status_lbl;
   Evas_Object *resp_entry;
+  Evas_Object *cap_entry;
+  Evas_Object *save_btn;
+
+  Evas_Object *lt_conc_entry;
+  Evas_Object *lt_total_entry;
+  Evas_Object *lt_dur_entry;
+  Evas_Object *load_btn;
 
   Ecore_Thread *worker;
+  dynbuf last_body;            /* full body of the last response, for "Save body" */
+  size_t shown;                /* bytes of it already in resp_entry */
+  history hist;
 } appdata;
 
 /* ----- Helpers ----- */
@@ -21,54 +42,160 @@ static const char* current_method_get(Evas_Object *hoversel) {
   return txt ? txt : "GET";
 }
 
-static struct curl_slist* build_headers_from_text(const char *multi) {
-  if (!multi || !*multi) return NULL;
-  struct curl_slist *list = NULL;
-  const char *p = multi, *line;
-  char buf[2048];
-
-  while (*p) {
-    /* read until \n */
-    line = p;
-    const char *nl = strchr(p, '\n');
-    size_t n = nl ? (size_t)(nl - p) : strlen(p);
-    /* trim CR and spaces */
-    while (n && (line[n-1] == '\r' || line[n-1] == ' ')) n--;
-    size_t m = n < sizeof(buf)-1 ? n : sizeof(buf)-1;
-    memcpy(buf, line, m); buf[m] = 0;
-
-    if (m > 0) list = curl_slist_append(list, buf);
-    p = nl ? nl + 1 : p + n;
-  }
-  return list;
+/* Entry text as plain UTF-8 (malloc'd): the widgets hold markup, where a
+ * newline is "<br/>" and '&' is "&amp;". */
+static char* entry_utf8(Evas_Object *entry) {
+  char *s = elm_entry_markup_to_utf8(elm_object_text_get(entry));
+  return s ? s : strdup("");
 }
 
 typedef struct {
-  char *url;
-  char *method;
-  char *headers_text;
-  char *body;
+  appdata *ad;
+  Ecore_Thread *th;
+  hist_entry *entry;           /* request + validators; not touched by the worker */
+  const char *url;             /* these point into entry */
+  const char *method;
+  const char *body;
+  struct curl_slist *cond;     /* conditional-GET headers, owned, chained in front of entry->hdrs */
+  char cache_path[512];
+  int cache_store;             /* write a cacheable 200 to cache_path */
+  int from_cache;              /* 304: body was read from cache_path */
+  char etag[128];              /* validators of this response */
+  char last_modified[64];
   long http_code;
-  char *resp;
+  dynbuf resp;                 /* whole body; the pane only gets the first view_cap bytes */
+  size_t view_cap;
+  size_t streamed;             /* bytes handed to the main loop so far */
+  double next_progress;        /* ecore_time_get() of the next status update */
+  double t_dns, t_connect, t_tls, t_ttfb, t_total;
   char  err[CURL_ERROR_SIZE];
 } job;
 
+/* Worker -> main loop: a piece of body text, or (len == 0) a progress update. */
+typedef struct {
+  long long now, total;        /* bytes received / expected, -1 unknown */
+  size_t len;
+  char data[];
+} view_chunk;
+
 static void free_job(job *j) {
   if (!j) return;
-  free(j->url);
-  free(j->method);
-  free(j->headers_text);
-  free(j->body);
-  free(j->resp);
+  curl_slist_free_all(j->cond);
+  free(j->resp.data);
   free(j);
 }
 
+/* Longest prefix of s[0..n) that does not end inside a UTF-8 sequence. */
+static size_t utf8_prefix(const char *s, size_t n) {
+  size_t i = n, back = 0;
+  while (i > 0 && back < 4 && ((unsigned char)s[i-1] & 0xC0) == 0x80) { i--; back++; }
+  if (i == 0) return n;
+  unsigned char lead = (unsigned char)s[i-1];
+  size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+  return back + 1 >= need ? n : i - 1;
+}
+
+/* Worker: hand the next piece of the body (up to the view cap) to the main loop. */
+static void stream_to_view(job *j, int final) {
+  size_t limit = j->resp.len < j->view_cap ? j->resp.len : j->view_cap;
+  if (limit <= j->streamed) return;
+  size_t n = limit - j->streamed;
+  if (!final && n < VIEW_CHUNK_BYTES) return;
+  if (!final) n = utf8_prefix(j->resp.data + j->streamed, n);
+  if (!n) return;
+  view_chunk *c = malloc(sizeof(*c) + n + 1);
+  if (!c) return;
+  c->now = c->total = 0;
+  c->len = n;
+  memcpy(c->data, j->resp.data + j->streamed, n);
+  c->data[n] = 0;
+  j->streamed += n;
+  if (!ecore_thread_feedback(j->th, c)) free(c);
+}
+
+static size_t stream_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  job *j = (job*)userdata;
+  size_t total = curl_write_cb(ptr, size, nmemb, &j->resp);
+  if (total) stream_to_view(j, 0);
+  return total;
+}
+
+/* curl polls this at least once a second, so Cancel/Back stop a stuck
+ * transfer right away instead of waiting out CURLOPT_TIMEOUT. */
+static int xferinfo_cb(void *userdata, curl_off_t dltotal, curl_off_t dlnow,
+                       curl_off_t ultotal, curl_off_t ulnow) {
+  job *j = (job*)userdata;
+  (void)ultotal; (void)ulnow;
+  if (ecore_thread_check(j->th)) return 1;
+  double now = ecore_time_get();
+  if (now >= j->next_progress) {
+    j->next_progress = now + 0.25;
+    view_chunk *c = malloc(sizeof(*c) + 1);
+    if (c) {
+      c->now = (long long)dlnow;
+      c->total = dltotal > 0 ? (long long)dltotal : -1;
+      c->len = 0;
+      c->data[0] = 0;
+      if (!ecore_thread_feedback(j->th, c)) free(c);
+    }
+  }
+  return 0;
+}
+
+/* Remembers the response validators; a new status line (redirect, 100) starts over. */
+static size_t header_cb(char *line, size_t size, size_t nitems, void *userdata) {
+  job *j = (job*)userdata;
+  size_t n = size * nitems;
+  char *dst = NULL;
+  size_t cap = 0, skip = 0;
+  if (n > 5 && !strncmp(line, "HTTP/", 5)) {
+    j->etag[0] = j->last_modified[0] = 0;
+  } else if (n > 5 && !strncasecmp(line, "ETag:", 5)) {
+    dst = j->etag; cap = sizeof(j->etag); skip = 5;
+  } else if (n > 14 && !strncasecmp(line, "Last-Modified:", 14)) {
+    dst = j->last_modified; cap = sizeof(j->last_modified); skip = 14;
+  }
+  if (dst) {
+    const char *v = line + skip;
+    size_t len = n - skip;
+    while (len && (*v == ' ' || *v == '\t')) { v++; len--; }
+    while (len && (v[len-1] == '\r' || v[len-1] == '\n' || v[len-1] == ' ')) len--;
+    if (len >= cap) len = 0;             /* too long to replay: treat as absent */
+    memcpy(dst, v, len);
+    dst[len] = 0;
+  }
+  return n;
+}
+
+/* Worker: a 304 means the cached copy is current; it goes through the normal view path. */
+static int load_cached_body(job *j) {
+  FILE *fp = fopen(j->cache_path, "rb");
+  if (!fp) return 0;
+  char buf[16 * 1024];
+  size_t n;
+  int ok = 1;
+  while (ok && (n = fread(buf, 1, sizeof(buf), fp)) > 0) ok = dynbuf_append(&j->resp, buf, n);
+  fclose(fp);
+  return ok;
+}
+
+static void store_cached_body(job *j) {
+  char tmp[520];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", j->cache_path);
+  FILE *fp = fopen(tmp, "wb");
+  if (!fp) return;
+  int ok = fwrite(j->resp.data ? j->resp.data : "", 1, j->resp.len, fp) == j->resp.len;
+  if (fclose(fp) != 0) ok = 0;
+  if (ok && rename(tmp, j->cache_path) == 0) j->cache_store = 2;   /* stored */
+  else remove(tmp);
+}
+
 /* ----- Networking (runs in background thread) ----- */
 
 static void worker_do(void *data, Ecore_Thread *th) {
   job *j = (job*)data;
   CURL *curl = curl_easy_init();
-  dynbuf buf; dynbuf_init(&buf);
+  j->th = th;
   j->err[0] = 0;
 
   if (!curl) {
@@ -79,17 +206,31 @@ static void worker_do(void *data, Ecore_Thread *th) {
   curl_easy_setopt(curl, CURLOPT_URL, j->url);
   curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
   curl_easy_setopt(curl, CURLOPT_USERAGENT, "TV-API-Tester/1.0");
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_cb);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buf);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_write_cb);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, j);
   curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, j->err);
   curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
+  curl_easy_setopt(curl, CURLOPT_XFERINFODATA, j);
+  curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
 
   /* TLS okay on most TVs; disable only if you test self-signed endpoints
      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
      curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
   */
 
-  struct curl_slist *headers = build_headers_from_text(j->headers_text);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, j);
+
+  /* the entry's parsed list is reused as is; conditional headers are
+     chained in front of it for this transfer only */
+  struct curl_slist *headers = j->entry->hdrs, *cond_tail = NULL;
+  if (j->cond) {
+    for (cond_tail = j->cond; cond_tail->next; cond_tail = cond_tail->next) {}
+    cond_tail->next = j->entry->hdrs;
+    headers = j->cond;
+  }
   if (headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
   /* Method */
@@ -116,73 +257,370 @@ static void worker_do(void *data, Ecore_Thread *th) {
     if (!j->err[0]) snprintf(j->err, sizeof(j->err), "curl error: %s", curl_easy_strerror(rc));
   } else {
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &j->http_code);
-    j->resp = buf.data; /* take ownership */
-    buf.data = NULL;
+    if (j->http_code == 304 && j->cond && j->resp.len == 0)
+      j->from_cache = load_cached_body(j);
+    else if (j->http_code == 200 && j->cache_store && (j->etag[0] || j->last_modified[0]) &&
+             j->resp.len <= HIST_CACHE_MAX_BYTES)
+      store_cached_body(j);
+    stream_to_view(j, 1);
   }
+  /* cumulative from the start of the request; split into phases for the status line */
+  curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &j->t_dns);
+  curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &j->t_connect);
+  curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &j->t_tls);
+  curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &j->t_ttfb);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &j->t_total);
 
-  if (headers) curl_slist_free_all(headers);
-  if (buf.data) free(buf.data);
   curl_easy_cleanup(curl);
+  if (cond_tail) cond_tail->next = NULL;
+}
+
+/* ----- History ----- */
+
+static void history_item_cb(void *data, Evas_Object *obj, void *event_info);
+
+/* Rebuilds the History menu, newest first. */
+static void history_menu_refresh(appdata *ad) {
+  elm_hoversel_clear(ad->history_sel);
+  for (int i = 0; i < ad->hist.count; i++) {
+    const hist_entry *e = ad->hist.items[i];
+    char label[128];
+    if (e->status)
+      snprintf(label, sizeof(label), "%s %.80s  [%ld]", e->method, e->url, e->status);
+    else
+      snprintf(label, sizeof(label), "%s %.80s", e->method, e->url);
+    elm_hoversel_item_add(ad->history_sel, label, NULL, ELM_ICON_NONE, history_item_cb, (void*)e);
+  }
+  elm_object_disabled_set(ad->history_sel, ad->hist.count ? EINA_FALSE : EINA_TRUE);
+}
+
+static void history_fill(appdata *ad, const hist_entry *e) {
+  char *m;
+  elm_object_text_set(ad->method_sel, e->method);
+  m = elm_entry_utf8_to_markup(e->url);
+  elm_object_text_set(ad->url_entry, m ? m : "");
+  free(m);
+  m = elm_entry_utf8_to_markup(e->headers);
+  elm_object_text_set(ad->headers_entry, m ? m : "");
+  free(m);
+  m = elm_entry_utf8_to_markup(e->body);
+  elm_object_text_set(ad->body_entry, m ? m : "");
+  free(m);
+}
 
+static void history_item_cb(void *data, Evas_Object *obj, void *event_info) {
+  appdata *ad = (appdata*)evas_object_data_get(obj, "ad");
+  if (ad) history_fill(ad, (const hist_entry*)data);
+  (void)event_info;
+}
+
+/* Main loop, after a response: metadata, validators and the cache flag. */
+static void history_update(appdata *ad, job *j) {
+  hist_entry *e = j->entry;
+  if (!j->err[0]) {
+    e->status = j->http_code;
+    e->total_ms = j->t_total * 1000;
+    e->bytes = ad->last_body.len;
+    if (j->cache_store == 2) {
+      snprintf(e->etag, sizeof(e->etag), "%s", j->etag);
+      snprintf(e->last_modified, sizeof(e->last_modified), "%s", j->last_modified);
+      e->cached = 1;
+    } else if (e->cached && j->cache_store && !j->from_cache) {
+      /* new content without validators, or 304 with no cache file: drop the stale copy */
+      hist_uncache(&ad->hist, e);
+    }
+  }
+  hist_save(&ad->hist);
+  history_menu_refresh(ad);
+}
+
+/* While a job runs, Send turns into Cancel and Run load is locked. */
+static void set_busy(appdata *ad, Eina_Bool busy) {
+  elm_object_text_set(ad->send_btn, busy ? "Cancel" : "Send");
+  elm_object_disabled_set(ad->send_btn, EINA_FALSE);
+  elm_object_disabled_set(ad->load_btn, busy);
+}
+
+static void view_append(appdata *ad, const char *text) {
+  char *markup = elm_entry_utf8_to_markup(text);
+  if (markup) elm_entry_entry_append(ad->resp_entry, markup);
+  free(markup);
+}
+
+static void worker_notify(void *data, Ecore_Thread *th, void *msg) {
+  job *j = (job*)data;
+  view_chunk *c = (view_chunk*)msg;
+  if (c->len) {
+    view_append(j->ad, c->data);
+    j->ad->shown += c->len;
+  } else {
+    char status[128];
+    if (c->total > 0)
+      snprintf(status, sizeof(status), "Receiving... %lld / %lld KB (%d%%)",
+               c->now / 1024, c->total / 1024, (int)(c->now * 100 / c->total));
+    else
+      snprintf(status, sizeof(status), "Receiving... %lld KB", c->now / 1024);
+    elm_object_text_set(j->ad->status_lbl, c->now ? status : "Waiting for response...");
+  }
+  free(c);
   (void)th;
 }
 
 static void worker_end(void *data, Ecore_Thread *th) {
   job *j = (job*)data;
-  appdata *ad = ecore_thread_global_data_find("ad");
-  if (!ad) { free_job(j); return; }
+  appdata *ad = j->ad;
 
-  char status[256];
+  char status[512];
   if (j->err[0]) {
     snprintf(status, sizeof(status), "Error: %s", j->err);
     elm_object_text_set(ad->status_lbl, status);
     elm_object_text_set(ad->resp_entry, j->err);
   } else {
-    snprintf(status, sizeof(status), "HTTP %ld", j->http_code);
+    /* phases: DNS, TCP connect, TLS handshake, server wait until first byte, transfer */
+    double tls = j->t_tls > 0 ? j->t_tls - j->t_connect : 0;
+    double ready = j->t_tls > 0 ? j->t_tls : j->t_connect;
+    snprintf(status, sizeof(status),
+             "HTTP %ld%s  %.1f KB  DNS %.0f ms  connect %.0f  TLS %.0f  TTFB %.0f  total %.0f ms",
+             j->http_code, j->from_cache ? " (cached)" : "", j->resp.len / 1024.0, j->t_dns * 1000, (j->t_connect - j->t_dns) * 1000,
+             tls * 1000, (j->t_ttfb - ready) * 1000, j->t_total * 1000);
     elm_object_text_set(ad->status_lbl, status);
-    elm_object_text_set(ad->resp_entry, j->resp ? j->resp : "(empty)");
+    if (!j->resp.len) elm_object_text_set(ad->resp_entry, "(empty)");
+    if (j->resp.len > ad->shown) {
+      char note[160];
+      snprintf(note, sizeof(note), "\n\n[showing first %zu of %zu bytes - Save body writes all of it]",
+               ad->shown, j->resp.len);
+      view_append(ad, note);
+    }
+    /* keep the full body for Save */
+    free(ad->last_body.data);
+    ad->last_body = j->resp;
+    dynbuf_init(&j->resp);
+    elm_object_disabled_set(ad->save_btn, ad->last_body.len ? EINA_FALSE : EINA_TRUE);
   }
+  history_update(ad, j);
 
-  elm_object_disabled_set(ad->send_btn, EINA_FALSE);
+  set_busy(ad, EINA_FALSE);
   ad->worker = NULL;
 
   free_job(j);
   (void)th;
 }
 
+/* Runs instead of worker_end once the transfer has aborted; whatever was
+ * already streamed into the pane stays there. */
 static void worker_cancel(void *data, Ecore_Thread *th) {
-  /* If you add cancellation, update UI here. */
   job *j = (job*)data;
+  appdata *ad = j->ad;
+  char status[128];
+  snprintf(status, sizeof(status), "Cancelled after %zu bytes.", j->resp.len);
+  elm_object_text_set(ad->status_lbl, status);
+  history_update(ad, j);
+  set_busy(ad, EINA_FALSE);
+  ad->worker = NULL;
   free_job(j);
   (void)th;
 }
 
+/* ----- Load test (runs in background thread) ----- */
+
+typedef struct {
+  appdata *ad;
+  char *url;
+  char *method;
+  char *body;
+  struct curl_slist *headers;
+  lt_config cfg;
+  lt_stats stats;
+  int rc;
+} load_job;
+
+static void free_load_job(load_job *j) {
+  if (!j) return;
+  free(j->url);
+  free(j->method);
+  free(j->body);
+  if (j->headers) curl_slist_free_all(j->headers);
+  free(j);
+}
+
+static int load_cancelled(void *ctx) {
+  return ecore_thread_check((Ecore_Thread*)ctx);
+}
+
+static void load_progress(const lt_stats *now, void *ctx) {
+  lt_stats *snap = malloc(sizeof(*snap));
+  if (!snap) return;
+  memcpy(snap, now, sizeof(*snap));
+  if (!ecore_thread_feedback((Ecore_Thread*)ctx, snap)) free(snap);
+}
+
+static void load_do(void *data, Ecore_Thread *th) {
+  load_job *j = (load_job*)data;
+  j->rc = lt_run(&j->cfg, &j->stats, load_cancelled, load_progress, th);
+}
+
+static void load_notify(void *data, Ecore_Thread *th, void *msg) {
+  load_job *j = (load_job*)data;
+  lt_stats *s = (lt_stats*)msg;
+  char status[256];
+  snprintf(status, sizeof(status), "Load: %lu done, %lu errors, %.1f req/s, p99 %.1f ms",
+           s->done, s->done - s->by_class[2] - s->by_class[3],
+           s->elapsed_sec > 0 ? s->done / s->elapsed_sec : 0.0, lt_percentile(s, 0.99));
+  elm_object_text_set(j->ad->status_lbl, status);
+  free(s);
+  (void)th;
+}
+
+static void load_finish(load_job *j, const char *status) {
+  appdata *ad = j->ad;
+  char *report = malloc(8192);
+  if (report) {
+    lt_format(&j->stats, report, 8192);
+    char *markup = elm_entry_utf8_to_markup(report);
+    elm_object_text_set(ad->resp_entry, markup ? markup : "");
+    free(markup);
+    free(report);
+  }
+  elm_object_text_set(ad->status_lbl, status);
+  set_busy(ad, EINA_FALSE);
+  ad->worker = NULL;
+  free_load_job(j);
+}
+
+static void load_end(void *data, Ecore_Thread *th) {
+  load_job *j = (load_job*)data;
+  load_finish(j, j->rc < 0 ? "Load test could not start." : "Load test finished.");
+  (void)th;
+}
+
+static void load_cancel(void *data, Ecore_Thread *th) {
+  load_finish((load_job*)data, "Load test cancelled.");
+  (void)th;
+}
+
+static int entry_int(Evas_Object *entry, int fallback) {
+  const char *t = elm_object_text_get(entry);
+  int v = t && *t ? atoi(t) : fallback;
+  return v > 0 ? v : 0;
+}
+
 /* ----- UI callbacks ----- */
 
 static void send_clicked_cb(void *data, Evas_Object *obj, void *event_info) {
   appdata *ad = (appdata*)data;
-  if (ad->worker) return; /* already running */
+  if (ad->worker) {
+    /* the button reads "Cancel" while a job runs */
+    ecore_thread_cancel(ad->worker);
+    elm_object_text_set(ad->status_lbl, "Cancelling...");
+    elm_object_disabled_set(ad->send_btn, EINA_TRUE);
+    return;
+  }
 
-  const char *url = elm_object_text_get(ad->url_entry);
-  if (!url || !*url) {
+  char *url = entry_utf8(ad->url_entry);
+  if (!*url) {
     elm_object_text_set(ad->status_lbl, "Please enter a URL.");
+    free(url);
     return;
   }
+  char *headers = entry_utf8(ad->headers_entry);
+  char *body = entry_utf8(ad->body_entry);
+  hist_entry *e = hist_record(&ad->hist, current_method_get(ad->method_sel), url, headers, body);
+  free(url); free(headers); free(body);
+  history_menu_refresh(ad);   /* recording may have evicted an entry the menu points at */
 
-  job *j = calloc(1, sizeof(job));
-  j->url = strdup(url);
-  j->method = strdup(current_method_get(ad->method_sel));
-  j->headers_text = strdup(elm_object_text_get(ad->headers_entry) ?: "");
-  j->body = strdup(elm_object_text_get(ad->body_entry) ?: "");
+  job *j = e ? calloc(1, sizeof(job)) : NULL;
+  if (!j) return;
+  j->ad = ad;
+  j->entry = e;
+  j->url = e->url;
+  j->method = e->method;
+  j->body = e->body;
+  j->view_cap = (size_t)entry_int(ad->cap_entry, VIEW_CAP_KB_DEFAULT) * 1024;
+  if (!j->view_cap) j->view_cap = (size_t)VIEW_CAP_KB_DEFAULT * 1024;
+  e->when = (long long)time(NULL);
+
+  /* repeated GETs revalidate instead of downloading the body again */
+  if (!strcasecmp(e->method, "GET") && elm_check_state_get(ad->cache_chk)) {
+    char hdr[192];
+    hist_cache_path(&ad->hist, e, j->cache_path, sizeof(j->cache_path));
+    j->cache_store = 1;
+    if (e->cached && e->etag[0]) {
+      snprintf(hdr, sizeof(hdr), "If-None-Match: %s", e->etag);
+      j->cond = curl_slist_append(j->cond, hdr);
+    }
+    if (e->cached && e->last_modified[0]) {
+      snprintf(hdr, sizeof(hdr), "If-Modified-Since: %s", e->last_modified);
+      j->cond = curl_slist_append(j->cond, hdr);
+    }
+  }
 
   elm_object_text_set(ad->status_lbl, "Sending...");
   elm_object_text_set(ad->resp_entry, "");
-  elm_object_disabled_set(ad->send_btn, EINA_TRUE);
+  set_busy(ad, EINA_TRUE);
+  ad->shown = 0;
+
+  /* body arrives through worker_notify while the transfer runs */
+  ad->worker = ecore_thread_feedback_run(worker_do, worker_notify, worker_end, worker_cancel, j, EINA_FALSE);
+  if (!ad->worker) {
+    set_busy(ad, EINA_FALSE);
+    elm_object_text_set(ad->status_lbl, "Could not start request.");
+    free_job(j);
+  }
+  (void)obj; (void)event_info;
+}
 
-  /* Share appdata pointer via a global key for end callback */
-  ecore_thread_global_data_add("ad", ad, NULL, EINA_TRUE);
+static void save_clicked_cb(void *data, Evas_Object *obj, void *event_info) {
+  appdata *ad = (appdata*)data;
+  if (!ad->last_body.len) return;
+  char path[256], ts[32], status[320];
+  time_t now = time(NULL);
+  strftime(ts, sizeof(ts), "%Y%m%d_%H%M%S", localtime(&now));
+  snprintf(path, sizeof(path), "%sresponse_%s.txt", SAVE_DIR, ts);
+  FILE *fp = fopen(path, "wb");
+  int ok = fp && fwrite(ad->last_body.data, 1, ad->last_body.len, fp) == ad->last_body.len;
+  if (fp && fclose(fp) != 0) ok = 0;
+  if (ok) snprintf(status, sizeof(status), "Saved %zu bytes to %s", ad->last_body.len, path);
+  else snprintf(status, sizeof(status), "Could not write %s", path);
+  elm_object_text_set(ad->status_lbl, status);
+  (void)obj; (void)event_info;
+}
 
-  ad->worker = ecore_thread_run(worker_do, worker_end, worker_cancel, j);
+static void load_clicked_cb(void *data, Evas_Object *obj, void *event_info) {
+  appdata *ad = (appdata*)data;
+  if (ad->worker) return; /* one job at a time */
+
+  char *url = entry_utf8(ad->url_entry);
+  if (!*url) {
+    elm_object_text_set(ad->status_lbl, "Please enter a URL.");
+    free(url);
+    return;
+  }
+
+  load_job *j = calloc(1, sizeof(load_job));
+  if (!j) { free(url); return; }
+  j->ad = ad;
+  j->url = url;
+  j->method = strdup(current_method_get(ad->method_sel));
+  j->body = entry_utf8(ad->body_entry);
+  char *headers = entry_utf8(ad->headers_entry);
+  j->headers = hist_parse_headers(headers);
+  free(headers);
+  j->cfg.url = j->url;
+  j->cfg.method = j->method;
+  j->cfg.body = strcasecmp(j->method, "GET") ? j->body : NULL;
+  j->cfg.headers = j->headers;
+  j->cfg.concurrency = entry_int(ad->lt_conc_entry, 8);
+  j->cfg.total = entry_int(ad->lt_total_entry, 0);
+  j->cfg.duration_sec = entry_int(ad->lt_dur_entry, 0);
+  j->cfg.timeout_sec = 30L;
+  if (!j->cfg.total && !j->cfg.duration_sec) j->cfg.total = 100;
+
+  elm_object_text_set(ad->status_lbl, "Load test running...");
+  elm_object_text_set(ad->resp_entry, "");
+  set_busy(ad, EINA_TRUE);
+
+  ad->worker = ecore_thread_feedback_run(load_do, load_notify, load_end, load_cancel, j, EINA_FALSE);
+  if (!ad->worker) load_finish(j, "Load test could not start.");
   (void)obj; (void)event_info;
 }
 
@@ -199,6 +637,11 @@ static void keydown_cb(void *data, Evas *e, Evas_Object *obj, void *event_info)
   if (is_back_key(ev->keyname)) {
     if (ad->worker) ecore_thread_cancel(ad->worker);
     elm_exit();
+  } else if (!strcmp(ev->keyname, "XF86Red") || !strcmp(ev->keyname, "F5")) {
+    /* one-key replay of the newest history entry */
+    if (ad->worker || !ad->hist.count) return;
+    history_fill(ad, ad->hist.items[0]);
+    send_clicked_cb(ad, ad->send_btn, NULL);
   }
 }
 
@@ -250,6 +693,15 @@ EAPI_MAIN int elm_main(int argc, char **argv) {
   elm_box_pack_end(ad.root, row);
   evas_object_show(row);
 
+  /* History menu (Red / F5 resends the newest entry) */
+  ad.history_sel = elm_hoversel_add(row);
+  elm_object_text_set(ad.history_sel, "History");
+  evas_object_data_set(ad.history_sel, "ad", &ad);
+  evas_object_size_hint_weight_set(ad.history_sel, 0.0, 0.0);
+  evas_object_size_hint_align_set(ad.history_sel, 0.0, 0.5);
+  elm_box_pack_end(row, ad.history_sel);
+  evas_object_show(ad.history_sel);
+
   /* Method selector */
   ad.method_sel = elm_hoversel_add(row);
   elm_object_text_set(ad.method_sel, "GET");
@@ -274,6 +726,14 @@ EAPI_MAIN int elm_main(int argc, char **argv) {
   elm_box_pack_end(row, ad.url_entry);
   evas_object_show(ad.url_entry);
 
+  /* Response cache toggle */
+  ad.cache_chk = elm_check_add(row);
+  elm_object_text_set(ad.cache_chk, "Cache");
+  elm_check_state_set(ad.cache_chk, EINA_TRUE);
+  evas_object_size_hint_weight_set(ad.cache_chk, 0.0, 0.0);
+  elm_box_pack_end(row, ad.cache_chk);
+  evas_object_show(ad.cache_chk);
+
   /* Send button */
   ad.send_btn = elm_button_add(row);
   elm_object_text_set(ad.send_btn, "Send");
@@ -283,6 +743,40 @@ EAPI_MAIN int elm_main(int argc, char **argv) {
   elm_box_pack_end(row, ad.send_btn);
   evas_object_show(ad.send_btn);
 
+  /* Load test row: the request above is the template ("{{seq}}" = request number) */
+  Evas_Object *lt_row = elm_box_add(ad.root);
+  elm_box_horizontal_set(lt_row, EINA_TRUE);
+  elm_box_padding_set(lt_row, 12, 0);
+  evas_object_size_hint_weight_set(lt_row, EVAS_HINT_EXPAND, 0.0);
+  evas_object_size_hint_align_set(lt_row, EVAS_HINT_FILL, 0.0);
+  elm_box_pack_end(ad.root, lt_row);
+  evas_object_show(lt_row);
+
+  Evas_Object **lt_fields[] = { &ad.lt_conc_entry, &ad.lt_total_entry, &ad.lt_dur_entry };
+  const char *lt_guides[] = { "Concurrency (8)", "Total requests", "Duration s" };
+  const char *lt_defaults[] = { "8", "100", "" };
+  for (int i = 0; i < 3; i++) {
+    Evas_Object *e = elm_entry_add(lt_row);
+    elm_entry_single_line_set(e, EINA_TRUE);
+    elm_entry_scrollable_set(e, EINA_TRUE);
+    elm_entry_input_panel_layout_set(e, ELM_INPUT_PANEL_LAYOUT_NUMBERONLY);
+    elm_object_part_text_set(e, "guide", lt_guides[i]);
+    elm_object_text_set(e, lt_defaults[i]);
+    evas_object_size_hint_weight_set(e, EVAS_HINT_EXPAND, 0.0);
+    evas_object_size_hint_align_set(e, EVAS_HINT_FILL, 0.5);
+    elm_box_pack_end(lt_row, e);
+    evas_object_show(e);
+    *lt_fields[i] = e;
+  }
+
+  ad.load_btn = elm_button_add(lt_row);
+  elm_object_text_set(ad.load_btn, "Run load");
+  evas_object_smart_callback_add(ad.load_btn, "clicked", load_clicked_cb, &ad);
+  evas_object_size_hint_weight_set(ad.load_btn, 0.0, 0.0);
+  evas_object_size_hint_align_set(ad.load_btn, 1.0, 0.5);
+  elm_box_pack_end(lt_row, ad.load_btn);
+  evas_object_show(ad.load_btn);
+
   /* Headers frame + entry */
   Evas_Object *hdr_fr = titled_frame(ad.root, "Headers (one per line: Name: Value)");
   elm_box_pack_end(ad.root, hdr_fr);
@@ -310,14 +804,39 @@ EAPI_MAIN int elm_main(int argc, char **argv) {
   elm_object_content_set(body_fr, ad.body_entry);
   evas_object_show(ad.body_entry);
 
-  /* Status label */
-  ad.status_lbl = elm_label_add(ad.root);
+  /* Status row: label + view cap + save */
+  Evas_Object *st_row = elm_box_add(ad.root);
+  elm_box_horizontal_set(st_row, EINA_TRUE);
+  elm_box_padding_set(st_row, 12, 0);
+  evas_object_size_hint_weight_set(st_row, EVAS_HINT_EXPAND, 0.0);
+  evas_object_size_hint_align_set(st_row, EVAS_HINT_FILL, 0.0);
+  elm_box_pack_end(ad.root, st_row);
+  evas_object_show(st_row);
+
+  ad.status_lbl = elm_label_add(st_row);
   elm_object_text_set(ad.status_lbl, "<align=left>Status: idle</align>");
   evas_object_size_hint_weight_set(ad.status_lbl, EVAS_HINT_EXPAND, 0.0);
-  evas_object_size_hint_align_set(ad.status_lbl, EVAS_HINT_FILL, 0.0);
-  elm_box_pack_end(ad.root, ad.status_lbl);
+  evas_object_size_hint_align_set(ad.status_lbl, EVAS_HINT_FILL, 0.5);
+  elm_box_pack_end(st_row, ad.status_lbl);
   evas_object_show(ad.status_lbl);
 
+  ad.cap_entry = elm_entry_add(st_row);
+  elm_entry_single_line_set(ad.cap_entry, EINA_TRUE);
+  elm_entry_input_panel_layout_set(ad.cap_entry, ELM_INPUT_PANEL_LAYOUT_NUMBERONLY);
+  elm_object_part_text_set(ad.cap_entry, "guide", "View cap KB");
+  elm_object_text_set(ad.cap_entry, "256");
+  evas_object_size_hint_weight_set(ad.cap_entry, 0.0, 0.0);
+  evas_object_size_hint_min_set(ad.cap_entry, 160, 0);
+  elm_box_pack_end(st_row, ad.cap_entry);
+  evas_object_show(ad.cap_entry);
+
+  ad.save_btn = elm_button_add(st_row);
+  elm_object_text_set(ad.save_btn, "Save body");
+  elm_object_disabled_set(ad.save_btn, EINA_TRUE);
+  evas_object_smart_callback_add(ad.save_btn, "clicked", save_clicked_cb, &ad);
+  elm_box_pack_end(st_row, ad.save_btn);
+  evas_object_show(ad.save_btn);
+
   /* Response frame + entry (read-only) */
   Evas_Object *resp_fr = titled_frame(ad.root, "Response");
   elm_box_pack_end(ad.root, resp_fr);
@@ -332,13 +851,22 @@ EAPI_MAIN int elm_main(int argc, char **argv) {
   elm_object_content_set(resp_fr, ad.resp_entry);
   evas_object_show(ad.resp_entry);
 
+  hist_open(&ad.hist, HISTORY_DIR);
+  history_menu_refresh(&ad);
+
   /* Show */
   evas_object_resize(ad.win, 1920, 1080);
   evas_object_show(ad.win);
 
   elm_run();
 
-  if (ad.worker) ecore_thread_cancel(ad.worker);
+  /* ad lives on this stack: let the cancelled job's callback run before returning */
+  if (ad.worker) {
+    ecore_thread_cancel(ad.worker);
+    while (ad.worker) ecore_main_loop_iterate_may_block(EINA_TRUE);
+  }
+  free(ad.last_body.data);
+  hist_close(&ad.hist);
   curl_global_cleanup();
   return 0;
 }
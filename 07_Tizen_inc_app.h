@@ -9,22 +9,32 @@ static inline Eina_Bool is_back_key(const char *keyname) {
   return keyname && (!strcmp(keyname,"XF86Back") || !strcmp(keyname,"Back") || !strcmp(keyname,"Escape"));
 }
 
-/* Simple growing buffer for CURL writes */
+/* Growing buffer for CURL writes. Capacity doubles, so appending n bytes
+ * is amortised O(n) instead of a realloc (and copy) per chunk. */
 typedef struct {
   char *data;
   size_t len;
+  size_t cap;
 } dynbuf;
 
-static inline void dynbuf_init(dynbuf *b) { b->data = NULL; b->len = 0; }
+static inline void dynbuf_init(dynbuf *b) { b->data = NULL; b->len = 0; b->cap = 0; }
+
+static inline int dynbuf_append(dynbuf *b, const char *src, size_t n) {
+  if (b->len + n + 1 > b->cap) {
+    size_t cap = b->cap ? b->cap : 16 * 1024;
+    while (cap < b->len + n + 1) cap *= 2;
+    char *p = realloc(b->data, cap);
+    if (!p) return 0;
+    b->data = p;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, src, n);
+  b->len += n;
+  b->data[b->len] = '\0';
+  return 1;
+}
 
 static size_t curl_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata) {
   size_t total = size * nmemb;
-  dynbuf *b = (dynbuf *)userdata;
-  char *p = realloc(b->data, b->len + total + 1);
-  if (!p) return 0;
-  b->data = p;
-  memcpy(b->data + b->len, ptr, total);
-  b->len += total;
-  b->data[b->len] = '\0';
-  return total;
+  return dynbuf_append((dynbuf *)userdata, ptr, total) ? total : 0;
 }
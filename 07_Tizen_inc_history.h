@@ -0,0 +1,52 @@
+#pragma once
+#include <curl/curl.h>
+#include <stddef.h>
+
+/* ----- Request history + response cache -----
+ * The last HIST_MAX distinct requests (newest first), kept in
+ * <dir>/history.txt across runs. Each entry holds its header text already
+ * parsed into a curl_slist, the metadata of its last response and, for GETs
+ * that came back with an ETag or Last-Modified, the validators plus a cached
+ * copy of the body in <dir>/cache/, so the next send can be a conditional
+ * request answered by a 304.
+ * Not thread-safe: use from the main loop only. */
+
+#define HIST_MAX 50
+#define HIST_CACHE_MAX_BYTES (4 * 1024 * 1024)   /* larger bodies are not cached */
+
+typedef struct {
+  char *method, *url, *headers, *body;
+  struct curl_slist *hdrs;      /* headers parsed once, NULL when there are none */
+  long status;                  /* last response, 0 = never answered */
+  double total_ms;
+  size_t bytes;
+  long long when;               /* epoch seconds of the last send */
+  char etag[128];               /* validators of the cached body, "" = none */
+  char last_modified[64];
+  int cached;                   /* cache file matches the validators */
+} hist_entry;
+
+typedef struct {
+  hist_entry *items[HIST_MAX];
+  int count;
+  char dir[256];
+} history;
+
+/* Parses "Name: value" lines (CR/LF separated) into a header list. */
+struct curl_slist *hist_parse_headers(const char *text);
+
+/* Loads <dir>/history.txt (a missing file is an empty history). */
+void hist_open(history *h, const char *dir);
+void hist_close(history *h);
+int hist_save(const history *h);
+
+/* Entry for this exact request, moved to the front; created (evicting the
+ * oldest and its cache file) when new. NULL only on allocation failure. */
+hist_entry *hist_record(history *h, const char *method, const char *url,
+                        const char *headers, const char *body);
+
+/* Path of e's cached body. */
+void hist_cache_path(const history *h, const hist_entry *e, char *out, size_t len);
+
+/* Forgets e's cached body and validators. */
+void hist_uncache(history *h, hist_entry *e);
@@ -0,0 +1,49 @@
+#pragma once
+#include <curl/curl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ----- Load generator -----
+ * Runs one request template many times over a single curl multi handle:
+ * `concurrency` easy handles are reused for the whole run, so after the first
+ * round every transfer rides an existing connection (or an HTTP/2 stream).
+ * "{{seq}}" in the URL or body is replaced by the request number.
+ * Blocking; call from a worker thread. */
+
+#define LT_BUCKETS 400          /* 5% wide latency buckets, 1 us .. ~5 min */
+#define LT_MAX_ERRORS 8         /* distinct CURLcodes tracked */
+
+typedef struct {
+  const char *url;
+  const char *method;
+  const char *body;
+  struct curl_slist *headers;   /* owned by the caller */
+  int concurrency;              /* transfers in flight */
+  int total;                    /* 0 -> run for duration_sec */
+  int duration_sec;             /* 0 -> run until total is sent */
+  long timeout_sec;             /* per request */
+} lt_config;
+
+typedef struct {
+  unsigned long sent, done;
+  unsigned long by_class[6];    /* [1..5] = 1xx..5xx, [0] = transport errors */
+  struct { int code; unsigned long count; } errors[LT_MAX_ERRORS];
+  unsigned long bytes;
+  double elapsed_sec;
+  double min_ms, max_ms, sum_ms;
+  uint32_t hist[LT_BUCKETS];
+} lt_stats;
+
+typedef int (*lt_cancel_fn)(void *ctx);                       /* non-zero -> stop */
+typedef void (*lt_progress_fn)(const lt_stats *now, void *ctx); /* about twice a second */
+
+/* Returns 0 when the run finished (or was cancelled), -1 on setup failure. */
+int lt_run(const lt_config *cfg, lt_stats *out, lt_cancel_fn cancelled,
+           lt_progress_fn progress, void *ctx);
+
+/* Latency in ms at quantile q (0..1), to within one bucket. */
+double lt_percentile(const lt_stats *s, double q);
+
+/* Plain-text report: throughput, percentiles, status/error breakdown and a
+ * histogram. */
+void lt_format(const lt_stats *s, char *buf, size_t len);
@@ -5,20 +5,97 @@
 #include <Evas.h>
 #include <curl/curl.h>
 #include <dlog.h>
+#include <math.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include "cJSON.h"
+#include "st_account.h"
+#include "st_base64.h"
+#include "st_caps.h"
+#include "st_commands.h"
+#include "st_device_cache.h"
+#include "st_devstate.h"
+#include "st_hash.h"
+#include "st_http.h"
+#include "st_image_ready.h"
+#if ST_LOCAL_VLM
+#include "st_infer.h"
+#endif
+#include "st_jpeg_scale.h"
+#include "st_log.h"
+#include "st_memtrack.h"
+#include "st_metrics.h"
+#include "st_motion.h"
+#include "st_outbox.h"
+#include "st_pipeline.h"
+#include "st_preview.h"
+#include "st_roi.h"
+#include "st_scheduler.h"
+#include "st_storage.h"
+#include "st_thumbs.h"
+#include "st_token.h"
+#include "st_trace.h"
+#include "st_ui_log.h"
+#include "st_vlm.h"
 
 // ---------- CONFIG ----------
 #define TOKEN_DIR "/opt/usr/home/owner/content/Documents/"
 #define TOKEN_FILE TOKEN_DIR "token.txt"
 #define API_BASE "https://api.smartthings.com/v1"
 #define REFRESH_INTERVAL_SEC 30
-#define TOKEN_URL "https://auth-global.api.smartthings.com/oauth/token"
+#define DEVICES_FILE TOKEN_DIR "devices.txt"   // "<deviceId> [interval_sec] [name]" per line, "[account location]" sections
+#define ACCOUNTS_FILE TOKEN_DIR "accounts.txt" // "<name> <token_file> [rps] [burst] [parallel] [calls_per_min]" per line
+#define TRIGGERS_FILE TOKEN_DIR "triggers.txt" // "<sensorId> [cameraId] [motion|contact|any]" per line
+#define TRIGGER_HEARTBEAT_SEC 300                // timer captures of cameras that have a trigger
+#define EVENT_STREAM_FILE TOKEN_DIR "event_stream.txt"  // SSE URL of a device-event subscription
+#define PROMPTS_FILE TOKEN_DIR "prompts.txt"   // "<deviceId|*> <label> <prompt>" per line
+#define THREAT_PROMPT_LABEL "threat"             // VLM_PROMPT; the only question the local model answers
+#define MAX_PARALLEL_CAPTURES 4
+#define ANALYSIS_QUEUE_DEPTH 2                   // downloaded frames waiting per analysis stage
+#define ST_RATE_LIMIT_RPS 4.0                    // global SmartThings request budget
+#define ST_RATE_LIMIT_BURST 8
+#define LIVE_API_BUDGET_PER_MIN 120.0            // calls/min live capture may spend (of 240 allowed)
+#define PREWARM_LEAD_SEC 3.0                     // connections are opened this long before a capture is due
+#define PREWARM_IDLE_SEC 20.0                    // ...unless a request ran this recently (pool still warm)
+#define PREWARM_MAX_HOSTS 8
+#define LOG_FILE TOKEN_DIR "app_log.txt"
+#define LOG_MAX_BYTES (512 * 1024)                 // rotated to app_log.txt.1 .. .2
+#define TRACE_FILE TOKEN_DIR "trace.json"        // Chrome trace of recent spans
+#define METRICS_FILE TOKEN_DIR "metrics.prom"   // Prometheus text, rewritten every METRICS_FLUSH_SEC
+#define METRICS_FLUSH_SEC 60.0
+#define METRICS_PORT 9464                        // curl http://127.0.0.1:9464/metrics on the TV; 0 disables
+#define MEMTRACK_FILE TOKEN_DIR "memtrack.txt"  // heap still allocated at exit (ST_MEMTRACK builds)
+#define DEVICE_CACHE_TTL_SEC (6 * 3600)         // device descriptions, revalidated by ETag
+#define OUTBOX_FILE TOKEN_DIR "outbox.txt"     // frames waiting for the VLM service to come back
+#define OUTBOX_MAX_ENTRIES 200
+#define OUTBOX_SEND_INTERVAL_SEC 2.0            // drain pace once the service answers again
+#define VLM_ENDPOINT "http://192.168.3.80:9090/generate"   // evaluation service
+#define VLM_IMAGE_MAX_DIM 896       // longest side sent to the VLM; 0 sends the camera JPEG as-is
+#define VLM_JPEG_QUALITY 85
+#define VLM_ROI_CROP 1              // 1: send only the region that changed since the device's last frame
+#ifndef ST_LOCAL_VLM
+#define ST_LOCAL_VLM 0          // 1: judge frames in-process (st_infer.cpp, needs onnxruntime)
+#endif
+#define LOCAL_VLM_DIR TOKEN_DIR "vlm/"
+#define LOCAL_VLM_INPUT 448         // encoder image size (square)
+#define LOCAL_VLM_BOS_TOKEN 1
+#define LOCAL_VLM_DECISIVE 0.5f     // answer-token mass that ends decoding
+// "Yes"/"No" variants from the model's tokenizer, comma-separated, e.g.
+// -DLOCAL_VLM_YES_TOKENS=3869,4874 (cmake -DST_LOCAL_VLM_YES_TOKENS=...).
+// -1: not set, the on-device VLM stays off and captures use VLM_ENDPOINT.
+#ifndef LOCAL_VLM_YES_TOKENS
+#define LOCAL_VLM_YES_TOKENS -1
+#endif
+#ifndef LOCAL_VLM_NO_TOKENS
+#define LOCAL_VLM_NO_TOKENS -1
+#endif
+#ifndef ST_DEBUG_FILES
+#define ST_DEBUG_FILES 0        // 1: also write base64_/prompt_<ts> files to SAVE_FOLDER
+#endif
 
 // ---------- STRUCTS ----------
 typedef struct appdata {
@@ -27,526 +104,1338 @@ typedef struct appdata {
     Evas_Object *box;
     Evas_Object *entry_output;
     Evas_Object *entry_log;
+    st_ui_log_t log;
     Evas_Object *img_view;
+    st_preview_t preview;       // decodes captures off the main loop into img_view
     bool live_running;
+    bool paused;                // app in the background (app_pause), see LIFECYCLE
+    Evas_Object *btn_live;
+    Evas_Object *btn_once;
+    Evas_Object *btn_caps;
+    double shown_rate;          // captures/min last put on btn_live
+    Ecore_Thread *startup;      // background startup, NULL once done
+    Eina_Bool token_ready;      // capture buttons enabled
+    Ecore_Timer *sched_timer;
+    st_scheduler_t sched;
+    Ecore_Thread *prewarm;      // connection warm-up ahead of the next capture
+    unsigned long http_seen;    // st_http_request_count() at the last tick
+    double http_active_at;      // when that count last moved
+    st_pipe_t *analysis;        // decode/encode and evaluate stages after the download
+    st_vlm_prompt_set_t *prompts;   // per sched device (same index), compiled once
+    Evas_Object *gallery;       // inwin while the capture gallery is open
+    struct gallery_item *gallery_items;
+    size_t gallery_count;
+    Elm_Gengrid_Item_Class *gallery_itc;
 } appdata_s;
 
-typedef struct { char *buf; size_t len; } mem_t;
-typedef struct {
-    char client_id[256];
-    char client_secret[256];
-    char refresh_token[1024];
-    char access_token[1024];
-    char expires_in[64];
-} token_data_t;
-
 // ---------- GLOBAL ----------
-static char *ACCESS_TOKEN = NULL;
 static const char* DEVICE_ID = "95c6572c-6373-41f4-9cba-daf39a38f59c";  //ring camera identification number can be consulted at: https://my.smartthings.com/location/45cf8542-65e8-41f7-b441-999486d15a8b/rooms
 																		//Needs to log into the Samsung Developers Account where the device is registered to  see the deviceID.
 // ---------- Generate logs in the UI ----------
+// Bounded ring, appended to the widget at most once per loop iteration (st_ui_log.c)
 static void ui_log_append(appdata_s *ad, const char *text) {
-    const char *prev = elm_entry_entry_get(ad->entry_log);
-    char *new_txt = malloc(strlen(prev) + strlen(text) + 8);
-    sprintf(new_txt, "%s<br>%s", prev, text);
-    elm_entry_entry_set(ad->entry_log, new_txt);
-    free(new_txt);
-    elm_entry_cursor_end_set(ad->entry_log);
+    st_ui_log_append(&ad->log, text);
 }
 
+// Queued to the background writer (st_log.c); also mirrored to dlog.
 static void log_event(const char *msg) {
-    const char *logfile = TOKEN_DIR "app_log.txt";
-    FILE *fp = fopen(logfile, "a");
-    if (fp) {
-        time_t now = time(NULL);
-        fprintf(fp, "[%s] %s\n", ctime(&now), msg);
-        fclose(fp);
-    }
-    dlog_print(DLOG_INFO, "ST_LOG", "%s", msg);
-}
-
-
-static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
-    mem_t *m = userdata;
-    size_t new_len = m->len + size * nmemb;
-    m->buf = realloc(m->buf, new_len + 1);
-    memcpy(m->buf + m->len, ptr, size * nmemb);
-    m->buf[new_len] = '\0';
-    m->len = new_len;
-    return size * nmemb;
-}
-
-//HTTPS REQUESTS TO SMARTTHINGS API
-static char* http_get(const char *url, const char *token) {
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
-    mem_t m = { .buf = calloc(1,1), .len = 0 };
-    struct curl_slist *headers = NULL;
-    char auth[512];
-    snprintf(auth, sizeof(auth), "Authorization: Bearer %s", token);
-    headers = curl_slist_append(headers, auth);
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &m);
-    curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    curl_slist_free_all(headers);
-    return m.buf;
-}
-
-static char* http_post(const char *url,const char *token,const char *payload){
-    CURL *curl=curl_easy_init(); if(!curl)return NULL;
-    mem_t m={.buf=calloc(1,1),.len=0};
-    struct curl_slist *hdr=NULL; char auth[512];
-    snprintf(auth,sizeof(auth),"Authorization: Bearer %s",token);
-    hdr=curl_slist_append(hdr,auth);
-    hdr=curl_slist_append(hdr,"Content-Type: application/json");
-    curl_easy_setopt(curl,CURLOPT_URL,url);
-    curl_easy_setopt(curl,CURLOPT_HTTPHEADER,hdr);
-    curl_easy_setopt(curl,CURLOPT_POSTFIELDS,payload);
-    curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,write_cb);
-    curl_easy_setopt(curl,CURLOPT_WRITEDATA,&m);
-    curl_easy_perform(curl); curl_easy_cleanup(curl);
-    curl_slist_free_all(hdr);
-    return m.buf;
-}
-
-static bool http_download_file(const char *url,const char *token,const char *save_path){
-    CURL *curl=curl_easy_init(); if(!curl)return false;
-    FILE *fp=fopen(save_path,"wb"); if(!fp)return false;
-    struct curl_slist *hdr=NULL; char auth[512];
-    snprintf(auth,sizeof(auth),"Authorization: Bearer %s",token);
-    hdr=curl_slist_append(hdr,auth);
-    curl_easy_setopt(curl,CURLOPT_URL,url);
-    curl_easy_setopt(curl,CURLOPT_HTTPHEADER,hdr);
-    curl_easy_setopt(curl,CURLOPT_WRITEDATA,fp);
-    CURLcode res=curl_easy_perform(curl);
-    curl_easy_cleanup(curl); curl_slist_free_all(hdr); fclose(fp);
-    return (res==CURLE_OK);
-}
-
-// ---------- TOKEN REFRESH FUNCTIONS ----------
-static bool read_kv_file(const char *path, token_data_t *t) {
-    FILE *fp = fopen(path, "r");
-    if (!fp) return false;
-    char line[512];
-    while (fgets(line, sizeof(line), fp)) {
-        char *eq = strchr(line, '=');
-        if (!eq) continue;
-        *eq = '\0';
-        char *key = line, *val = eq + 1;
-        val[strcspn(val, "\r\n")] = '\0';
-        if (strcmp(key, "client_id") == 0) strncpy(t->client_id, val, sizeof(t->client_id));
-        else if (strcmp(key, "client_secret") == 0) strncpy(t->client_secret, val, sizeof(t->client_secret));
-        else if (strcmp(key, "refresh_token") == 0) strncpy(t->refresh_token, val, sizeof(t->refresh_token));
-        else if (strcmp(key, "access_token") == 0) strncpy(t->access_token, val, sizeof(t->access_token));
-        else if (strcmp(key, "expires_in") == 0) strncpy(t->expires_in, val, sizeof(t->expires_in));
+    st_log(ST_LOG_INFO, "%s", msg);
+}
+
+
+//HTTPS REQUESTS TO SMARTTHINGS API: st_http.c (pooled handles, shared DNS and TLS sessions)
+
+// ---------- TOKEN LIFECYCLE: st_token.c (expiry tracking, single-flight refresh) ----------
+static void ensure_token_dir_exists(void) {
+    struct stat st = {0};
+    if (stat(TOKEN_DIR, &st) == -1) mkdir(TOKEN_DIR, 0777);
+}
+
+
+// Runs on the startup thread: no UI here.
+static int load_token_file(void) {
+    ensure_token_dir_exists();
+
+    char *res_dir = app_get_resource_path();
+    char res_token[512];
+    snprintf(res_token, sizeof(res_token), "%stoken.txt", res_dir ? res_dir : "");
+    free(res_dir);
+
+    // 1️⃣ If token.txt does NOT exist → copy from res
+    if (!st_token_seed(TOKEN_FILE, res_token)) return -1;
+
+    // 2️⃣ Load it. No validation request: the recorded expiry says whether
+    // the token is still good, and st_token refreshes ahead of it.
+    return st_token_init(TOKEN_FILE) ? 0 : -2;
+}
+
+static void token_loaded_show(appdata_s *ad) {
+    time_t exp = st_token_expires_at();
+    char msg[128];
+    if (!exp) snprintf(msg, sizeof(msg), "Token loaded (expiry unknown).");
+    else if (exp > time(NULL)) snprintf(msg, sizeof(msg), "Token loaded, valid for %ld min.", (long)(exp - time(NULL)) / 60);
+    else snprintf(msg, sizeof(msg), "Token expired, it will be refreshed on first use.");
+    ui_log_append(ad, msg);
+    log_event(msg);
+}
+
+//END OF TAKEN REFRESH METHODS//
+
+//IMAGE CAPTURE METHODS//
+
+#define SAVE_FOLDER "/opt/usr/home/owner/content/Pictures/"
+#define STORAGE_MAX_FILES 500                   // captures (and debug files) kept; oldest go first
+#define STORAGE_MAX_AGE_SEC (7 * 24 * 3600)
+#define STORAGE_QUOTA_BYTES (200LL * 1024 * 1024)
+#define THUMBS_FOLDER TOKEN_DIR "thumbs/"       // gallery thumbnails, one per stored capture
+#define GALLERY_THUMB_DIM 240                   // longest thumbnail side (pixels)
+#define GALLERY_CELL_W 260                      // grid cell, scaled
+#define GALLERY_CELL_H 190
+
+// --- Generate timestamp for naming captures ---
+static void current_timestamp(char *buf, size_t size) {
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    strftime(buf, size, "%Y%m%d_%H%M%S", t);
+}
+
+// ---------- ASYNC CAPTURE PIPELINE ----------
+// The capture runs as a small state machine on an ecore_thread worker so
+// the UI never blocks on the network or on waiting for the camera. Progress lines and
+// the downloaded image are marshalled back to the main loop through
+// ecore_thread_feedback; only the notify/end callbacks touch EFL objects.
+//
+// Once the frame is downloaded the job is handed to ad->analysis (st_pipeline.c):
+// a prep stage (decode / resize + base64) and an eval stage (local model / VLM
+// upload), one thread each. The ecore_thread ends there and the camera is free
+// again, so frame N+1 is commanded and downloaded while frame N is evaluated.
+// From the hand-off on, messages go to the main loop with
+// ecore_main_loop_thread_safe_call_async instead of the thread feedback.
+typedef enum {
+    CAP_BASELINE,
+    CAP_COMMANDS,
+    CAP_STATUS,
+    CAP_DOWNLOAD,
+    CAP_DECODE,
+    CAP_INFER,
+    CAP_ENCODE,
+    CAP_PROMPT,
+    CAP_UPLOAD,
+    CAP_DONE,
+    CAP_FAILED
+} capture_state_e;
+
+typedef struct {
+    appdata_s *ad;
+    st_sched_device_t *dev;
+    capture_state_e state;
+    Ecore_Thread *th;           // network stage worker
+    bool handed_off;            // in ad->analysis: th no longer reports or cancels
+    atomic_int refs;            // capture_end and the analysis done callback each hold one
+    char device_id[64];
+    char device_name[128];
+    int account;                // st_account index, -1 when the device's account has no token file
+    double started;
+    char *token;                // private copy from st_account_token(), taken by the worker
+    char url[512];
+    char timestamp[64];
+    char img_name[128];         // capture_<timestamp>.jpg in SAVE_FOLDER
+    char image_url[512];
+    double prev_image_ts;       // timestamp of the frame before 'take'
+    double command_time;        // local time the 'take' command was sent
+    char *base64;               // filled while the image downloads
+    size_t base64_len;
+    size_t base64_cap;
+    uint8_t *img;               // downloaded bytes, written out once known to be new
+    size_t img_len;
+    size_t img_cap;
+    st_b64_stream_t b64;
+    st_xxh64_t hash;
+    char prev_image_url[512];   // last evaluated frame of this device
+    uint64_t prev_frame_hash;
+    uint64_t frame_hash;
+    bool duplicate;             // same frame as last time: nothing saved or sent
+    uint8_t *rgb;               // CAP_DECODE output for the local model
+    const st_vlm_prompt_set_t *prompts;     // questions for this frame (ad->prompts)
+} capture_job_t;
+
+typedef struct {
+    appdata_s *ad;
+    char device_name[128];
+    bool model_output;          // text is the evaluation reply
+    char text[1024];            // answers of every prompt of the frame
+} capture_msg_t;
+
+//Notes: the 'method' and 'id' values sent with it are sample values, this could change based on the Model being used for vlm evaluation.
+static const char VLM_PROMPT[] =
+    "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n"
+    "<|im_start|>user\n<image> Analyze the provided image and determine if any of the persons present pose a potential security threat. For example, the person is trying to hide his face, carries a weapon, etc.\n"
+    "Answer Yes or No.<|im_end|>\n"
+    "<|im_start|>assistant\n";
+
+// Main loop: one progress line, or the evaluation reply.
+static void capture_msg_show(void *data) {
+    capture_msg_t *m = data;
+    appdata_s *ad = m->ad;
+    char line[768];
+    snprintf(line, sizeof(line), "[%s] %s", m->device_name, m->text);
+    if (m->model_output) {
+        elm_object_text_set(ad->entry_output, line);
+        ui_log_append(ad, "Model output received.");
+    } else {
+        ui_log_append(ad, line);
     }
-    fclose(fp);
-    return true;
+    free(m);
 }
 
-//Writes on the file token.txt to update for fresh values
-static bool write_kv_file(const char *path, token_data_t *t) {
-    FILE *fp = fopen(path, "w");
-    if (!fp) return false;
-    fprintf(fp,"client_id=%s\nclient_secret=%s\nrefresh_token=%s\naccess_token=%s\nexpires_in=%s\n",
-        t->client_id, t->client_secret, t->refresh_token, t->access_token, t->expires_in);
-    fclose(fp);
-    log_event("token.txt updated successfully.");
-    return true;
+static void capture_post(capture_job_t *job, const char *text, bool model_output) {
+    capture_msg_t *m = calloc(1, sizeof(*m));
+    if (!m) return;
+    m->ad = job->ad;
+    snprintf(m->device_name, sizeof(m->device_name), "%s", job->device_name);
+    m->model_output = model_output;
+    snprintf(m->text, sizeof(m->text), "%s", text);
+    if (job->handed_off)
+        ecore_main_loop_thread_safe_call_async(capture_msg_show, m);
+    else if (!ecore_thread_feedback(job->th, m))
+        free(m);
 }
 
-static bool refresh_token_c(token_data_t *t) {
-    log_event("Performing SmartThings token refresh...");
-    CURL *curl = curl_easy_init();
-    if (!curl) return false;
+static void capture_report(capture_job_t *job, const char *text) {
+    capture_post(job, text, false);
+}
+
+static void capture_report_output(capture_job_t *job, const char *text) {
+    capture_post(job, text, true);
+}
 
-    char credentials[1024];
-    snprintf(credentials, sizeof(credentials), "%s:%s", t->client_id, t->client_secret);
-    char *b64 = NULL;
-    {
-        static const char tbl[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-        size_t out_len=((strlen(credentials)+2)/3)*4+4;
-        b64=malloc(out_len); int val=0,valb=-6,i,j=0;
-        for(i=0;credentials[i];i++){val=(val<<8)+credentials[i];valb+=8;
-            while(valb>=0){b64[j++]=tbl[(val>>valb)&0x3F];valb-=6;}}
-        while(valb>-6){b64[j++]=tbl[((val<<8)>>(valb+8))&0x3F];valb-=6;}
-        while(j%4)b64[j++]='='; b64[j]='\0';
+typedef struct {
+    appdata_s *ad;
+    bool ok;
+    char path[512];
+} capture_saved_t;
+
+// Main loop: display the image in UI (latest frame from any camera)
+static void capture_saved_show(void *data) {
+    capture_saved_t *s = data;
+    appdata_s *ad = s->ad;
+    if (s->ok) {
+        // shown by the preview once decoded; the previous frame stays up until then
+        st_preview_set_file(&ad->preview, s->path);
     }
+    char line[600];
+    snprintf(line, sizeof(line), "%s %s", s->ok ? "Image saved:" : "Failed to save image file:", s->path);
+    ui_log_append(ad, line);
+    free(s);
+}
 
-    char auth[512]; snprintf(auth,sizeof(auth),"Authorization: Basic %s",b64);
-    free(b64);
-    char data[1024];
-    snprintf(data,sizeof(data),"grant_type=refresh_token&refresh_token=%s",t->refresh_token);
-
-    mem_t m={.buf=calloc(1,1),.len=0};
-    struct curl_slist *headers=NULL;
-    headers=curl_slist_append(headers,auth);
-    headers=curl_slist_append(headers,"Content-Type: application/x-www-form-urlencoded");
-    curl_easy_setopt(curl,CURLOPT_URL,TOKEN_URL);
-    curl_easy_setopt(curl,CURLOPT_HTTPHEADER,headers);
-    curl_easy_setopt(curl,CURLOPT_POSTFIELDS,data);
-    curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,write_cb);
-    curl_easy_setopt(curl,CURLOPT_WRITEDATA,&m);
-    curl_easy_setopt(curl,CURLOPT_SSL_VERIFYPEER,0L);
-    CURLcode res=curl_easy_perform(curl);
-    curl_slist_free_all(headers); curl_easy_cleanup(curl);
-    if(res!=CURLE_OK){ log_event("CURL refresh failed."); free(m.buf); return false; }
-
-    cJSON *json=cJSON_Parse(m.buf);
-    if(!json){ log_event("JSON parse failed."); free(m.buf); return false; }
-    const cJSON *acc=cJSON_GetObjectItem(json,"access_token");
-    const cJSON *ref=cJSON_GetObjectItem(json,"refresh_token");
-    if(acc&&acc->valuestring) strncpy(t->access_token,acc->valuestring,sizeof(t->access_token));
-    if(ref&&ref->valuestring) strncpy(t->refresh_token,ref->valuestring,sizeof(t->refresh_token));
-    cJSON_Delete(json); free(m.buf);
-    log_event("Token refreshed successfully.");
-    return true;
+// Storage writer thread: the jpg is on disk (or not); hop to the main loop.
+static void capture_saved(const char *path, bool ok, void *ctx) {
+    capture_saved_t *s = calloc(1, sizeof(*s));
+    if (!s) return;
+    s->ad = ctx;
+    s->ok = ok;
+    snprintf(s->path, sizeof(s->path), "%s", path);
+    ecore_main_loop_thread_safe_call_async(capture_saved_show, s);
 }
 
+// The network stage stops with its ecore_thread, the analysis with the pipeline.
+static bool capture_cancelled(void *ctx) {
+    capture_job_t *job = ctx;
+    return job->handed_off ? st_pipe_stopping(job->ad->analysis) : ecore_thread_check(job->th);
+}
 
-// ---------- TOKEN VALIDATION ----------
-static bool validate_access_token(const char *token, const char *device_id) {
-    if (!token || strlen(token) < 10) return false;
+// Appends encoded text to job->base64 (kept NUL-terminated).
+static bool capture_b64_sink(const char *text, size_t len, void *ctx) {
+    capture_job_t *job = ctx;
+    if (job->base64_len + len + 1 > job->base64_cap) {
+        size_t cap = job->base64_cap ? job->base64_cap : 256 * 1024;
+        while (cap < job->base64_len + len + 1) cap *= 2;
+        char *p = realloc(job->base64, cap);
+        if (!p) return false;
+        job->base64 = p;
+        job->base64_cap = cap;
+    }
+    memcpy(job->base64 + job->base64_len, text, len);
+    job->base64_len += len;
+    job->base64[job->base64_len] = '\0';
+    return true;
+}
 
-    char url[512];
-    snprintf(url, sizeof(url), "%s/devices/%s/status", API_BASE, device_id);
-    char *resp = http_get(url, token);
-    if (!resp) return false;
+// curl chunks go to the image buffer, the frame hash and the base64 stream in one pass.
+static bool capture_download_sink(const void *data, size_t len, void *ctx) {
+    capture_job_t *job = ctx;
+    if (job->img_len + len > job->img_cap) {
+        size_t cap = job->img_cap ? job->img_cap : 256 * 1024;
+        while (cap < job->img_len + len) cap *= 2;
+        uint8_t *p = realloc(job->img, cap);
+        if (!p) return false;
+        job->img = p;
+        job->img_cap = cap;
+    }
+    memcpy(job->img + job->img_len, data, len);
+    job->img_len += len;
+    st_xxh64_update(&job->hash, data, len);
+    // with downscaling the base64 is made from the smaller JPEG in CAP_ENCODE
+    return VLM_IMAGE_MAX_DIM > 0 || st_b64_stream_update(&job->b64, data, len);
+}
 
-    bool valid = strstr(resp, "components") != NULL || strstr(resp, "status") != NULL;
-    free(resp);
-    return valid;
+// The server sent the whole image again instead of the missing range.
+static void capture_download_reset(void *ctx) {
+    capture_job_t *job = ctx;
+    job->img_len = 0;
+    job->base64_len = 0;
+    st_xxh64_init(&job->hash, 0);
+    st_b64_stream_init(&job->b64, capture_b64_sink, job);
 }
 
-static void ensure_token_dir_exists(void) {
-    struct stat st = {0};
-    if (stat(TOKEN_DIR, &st) == -1) mkdir(TOKEN_DIR, 0777);
+static capture_state_e capture_skip_duplicate(capture_job_t *job, const char *why) {
+    job->duplicate = true;
+    capture_report(job, why);
+    return CAP_DONE;
 }
 
+// The full frame goes to the storage writer, which owns it from here on.
+static void capture_store_image(capture_job_t *job) {
+    if (st_storage_put(job->img_name, job->img, job->img_len, capture_saved, job->ad))
+        capture_report(job, "Saving image...");
+    else
+        capture_report(job, "Failed to queue image file.");
+    job->img = NULL;
+    job->img_len = job->img_cap = 0;
+}
 
-static bool initialize_token_file(appdata_s *ad) {
-    ensure_token_dir_exists();
+// ---------- VLM REQUEST HELPERS ----------
+static char *b64_dup(const uint8_t *data, size_t len, size_t *b64_len) {
+    char *b64 = malloc(st_b64_encoded_len(len) + 1);
+    if (b64) {
+        *b64_len = st_b64_encode(data, len, b64);
+        b64[*b64_len] = '\0';
+    }
+    return b64;
+}
 
-    const char *res_dir = app_get_resource_path();
-    char res_token[512];
-    snprintf(res_token, sizeof(res_token), "%stoken.txt", res_dir);
+// Base64 of the frame as the VLM gets it: downscaled to VLM_IMAGE_MAX_DIM when
+// that makes it smaller (*small_len != 0 then), else the camera JPEG.
+static char *vlm_base64(const uint8_t *img, size_t len, size_t *b64_len, size_t *small_len,
+                        st_jpeg_scale_info_t *si) {
+    uint8_t *small = NULL;
+    *small_len = 0;
+    if (VLM_IMAGE_MAX_DIM > 0 &&
+        st_jpeg_downscale(img, len, VLM_IMAGE_MAX_DIM, VLM_JPEG_QUALITY, &small, small_len, si)) {
+        img = small;
+        len = *small_len;
+    }
+    char *b64 = b64_dup(img, len, b64_len);
+    free(small);
+    return b64;
+}
 
-    token_data_t t = {0};
-    struct stat st;
+// job->base64 becomes the changed region of the frame (st_roi.c); false when
+// the whole frame should go (first frame, still scene, change too wide).
+static bool capture_encode_roi(capture_job_t *job) {
+    static const st_roi_cfg_t cfg = ST_ROI_CFG_DEFAULT;
+    uint8_t *crop = NULL;
+    size_t crop_len = 0, b64_len = 0;
+    st_roi_info_t ri;
+    if (st_roi_crop(job->device_id, job->img, job->img_len, &cfg, VLM_IMAGE_MAX_DIM, VLM_JPEG_QUALITY,
+                    &crop, &crop_len, &ri) != ST_ROI_CROPPED)
+        return false;
+    char *b64 = b64_dup(crop, crop_len, &b64_len);
+    free(crop);
+    if (!b64) return false;
+    free(job->base64);
+    job->base64 = b64;
+    job->base64_len = b64_len;
+    job->base64_cap = b64_len + 1;
+    char msg[192];
+    snprintf(msg, sizeof(msg), "Changed region %dx%d at %d,%d of %dx%d sent as %dx%d (%zu KB -> %zu KB).",
+             ri.w, ri.h, ri.x, ri.y, ri.src_w, ri.src_h, ri.out_w, ri.out_h, job->img_len / 1024, crop_len / 1024);
+    capture_report(job, msg);
+    return true;
+}
 
-    ui_log_append(ad, "Checking for token.txt...");
+// One line per frame: the answer, or "label: answer; label: answer".
+static void vlm_answers_format(const st_vlm_prompt_set_t *prompts, const st_vlm_answers_t *answers,
+                               char *out, size_t len) {
+    if (answers->n == 1) { snprintf(out, len, "%s", answers->text[0]); return; }
+    size_t used = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < answers->n && used < len; i++) {
+        int w = snprintf(out + used, len - used, "%s%s: %s", i ? "; " : "", prompts->label[i],
+                         answers->ok[i] ? answers->text[i] : "(no answer)");
+        if (w < 0) break;
+        used += (size_t)w;
+    }
+}
 
-    // 1️⃣ If token.txt exists in permanent directory
-    if (stat(TOKEN_FILE, &st) == 0) {
-        ui_log_append(ad, "Found existing token.txt in permanent directory.");
+// No answer because of the link or the service, not because of the request.
+static bool vlm_unreachable(const st_http_info_t *info) {
+    return info->circuit_open || info->status == 0 || info->status == 429 || info->status >= 500;
+}
 
-        if (!read_kv_file(TOKEN_FILE, &t)) {
-            ui_log_append(ad, "Failed to read token.txt contents.");
-            return false;
-        }
+// The frame is already on its way to SAVE_FOLDER; only its name is queued.
+static capture_state_e capture_defer(capture_job_t *job, const char *why) {
+    if (!st_outbox_add(job->device_id, job->img_name)) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%s, frame not evaluated.", why);
+        capture_report(job, msg);
+        return CAP_FAILED;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%s: queued for evaluation (%zu waiting).", why, st_outbox_pending());
+    capture_report(job, msg);
+    return CAP_DONE;
+}
 
-        ui_log_append(ad, "Verifying access token validity...");
-        if (validate_access_token(t.access_token, DEVICE_ID)) {
-            ui_log_append(ad, "Access token is valid.");
-            ACCESS_TOKEN = strdup(t.access_token);
-            return true;
+static capture_state_e capture_step(capture_job_t *job) {
+    switch (job->state) {
+    case CAP_BASELINE: {
+        // may block on an expired token's refresh, so it is taken here and not on the main loop
+        job->token = st_account_token(job->account);
+        if (!job->token) { capture_report(job, "No access token for this account."); return CAP_FAILED; }
+        // 1) Remember the current frame so the previous one is never re-fetched
+        job->prev_image_ts = st_image_baseline(job->device_id, job->token);
+        return capture_cancelled(job) ? CAP_FAILED : CAP_COMMANDS;
+    }
+    case CAP_COMMANDS: {
+        // 2) Refresh + imageCapture.take in one batched commands request
+        capture_report(job, "Sending refresh and capture commands...");
+        // checked against the device's capabilities; without a description both are sent as before
+        st_cmd_batch_t batch;
+        st_cmd_batch_init(&batch, job->device_id);
+        if (st_caps_add(&batch, job->token, "main", "refresh", "refresh", NULL, 0) == ST_CAPS_NO_DEVICE)
+            st_cmd_add(&batch, "main", "refresh", "refresh", NULL);
+        st_caps_result_e take = st_caps_add(&batch, job->token, "main", "imageCapture", "take", NULL, 0);
+        if (take == ST_CAPS_NO_DEVICE) {
+            st_cmd_add(&batch, "main", "imageCapture", "take", NULL);
+        } else if (take != ST_CAPS_OK && take != ST_CAPS_UNCHECKED) {
+            char msg[160];
+            snprintf(msg, sizeof(msg), "Cannot capture: imageCapture.take %s.", st_caps_result_str(take));
+            capture_report(job, msg);
+            return CAP_FAILED;
         }
-
-        ui_log_append(ad, "Access token invalid. Attempting refresh...");
-        if (refresh_token_c(&t)) {
-            if (write_kv_file(TOKEN_FILE, &t)) {
-                ACCESS_TOKEN = strdup(t.access_token);
-                ui_log_append(ad, "Token refreshed and saved successfully.");
-                return true;
-            } else {
-                ui_log_append(ad, "Failed to save refreshed token.");
-                return false;
+        const int take_idx = batch.count - 1;
+        job->command_time = (double)time(NULL);
+        if (st_cmd_flush(&batch, job->token, NULL) < 0)
+            capture_report(job, "Failed to send capture commands.");
+        else if (batch.cmds[take_idx].status == ST_CMD_FAILED)
+            capture_report(job, "Camera rejected the capture command.");
+        return capture_cancelled(job) ? CAP_FAILED : CAP_STATUS;
+    }
+    case CAP_STATUS: {
+        // 3) Poll status (with backoff) until a frame newer than the command shows up
+        capture_report(job, "Waiting for new image...");
+        const st_backoff_t backoff = ST_BACKOFF_DEFAULT;
+        if (!st_wait_new_image(job->device_id, job->token, job->prev_image_ts, job->command_time,
+                               &backoff, capture_cancelled, job,
+                               job->image_url, sizeof(job->image_url))) {
+            capture_report(job, "No new image reported by the device.");
+            return CAP_FAILED;
+        }
+        // image URLs name one stored frame; the same URL again is the same picture
+        if (job->prev_image_url[0] && strcmp(job->image_url, job->prev_image_url) == 0)
+            return capture_skip_duplicate(job, "Same image URL as last capture, skipped.");
+        return CAP_DOWNLOAD;
+    }
+    case CAP_DOWNLOAD: {
+        // 4) Download new image; the bytes are hashed (and base64-encoded when sent as-is) as they
+        //    arrive, and a dropped transfer resumes with a Range request instead of starting over
+        capture_report(job, "Downloading captured image...");
+        st_b64_stream_init(&job->b64, capture_b64_sink, job);
+        st_xxh64_init(&job->hash, 0);
+
+        st_http_req_t req = { .url = job->image_url, .bearer = job->token,
+                              .cancelled = capture_cancelled, .xfer_ctx = job };
+        bool ok = st_http_download_stream(&req, 0, capture_download_sink, capture_download_reset, job, NULL) &&
+                  (VLM_IMAGE_MAX_DIM > 0 || st_b64_stream_final(&job->b64));
+        if (!ok || job->img_len == 0) {
+            if (!capture_cancelled(job)) capture_report(job, "Failed to download image.");
+            return CAP_FAILED;
+        }
+        // unchanged scene: no file, no prompt, no VLM request
+        job->frame_hash = st_xxh64_digest(&job->hash);
+        if (job->prev_frame_hash && job->frame_hash == job->prev_frame_hash)
+            return capture_skip_duplicate(job, "Frame unchanged since last capture, skipped.");
+#if ST_LOCAL_VLM
+        // the resident model answers the Yes/No threat question, nothing else
+        if (st_infer_available() && job->prompts && job->prompts->n == 1 &&
+            strcmp(job->prompts->label[0], THREAT_PROMPT_LABEL) == 0)
+            return CAP_DECODE;
+#endif
+        return CAP_ENCODE;
+    }
+    case CAP_DECODE: {
+#if ST_LOCAL_VLM
+        // 5') Decode at the encoder size on the prep stage, so the model only waits for pixels;
+        //     a retried frame already has its encoder features cached and needs no decode
+        if (st_infer_has_features(job->frame_hash)) return CAP_INFER;
+        int w, h;
+        st_infer_input_size(&w, &h);
+        if (!st_jpeg_decode_rgb(job->img, job->img_len, w, h, &job->rgb, NULL)) {
+            capture_report(job, "Could not decode the frame, sending to the VLM service.");
+            return CAP_ENCODE;
+        }
+        return CAP_INFER;
+#else
+        return CAP_ENCODE;
+#endif
+    }
+    case CAP_INFER: {
+#if ST_LOCAL_VLM
+        // 6') Ask the resident model: no base64, JSON or network
+        capture_report(job, "Evaluating on device...");
+        st_infer_result_t r;
+        bool ok = st_infer_frame(job->rgb, job->frame_hash, NULL, &r);
+        free(job->rgb);
+        job->rgb = NULL;
+        if (!ok) {
+            capture_report(job, "On-device evaluation failed, sending to the VLM service.");
+            return CAP_ENCODE;
+        }
+        char out[128];
+        snprintf(out, sizeof(out), "%s (p=%.2f, %d step(s), %.0f ms on device%s)",
+                 r.threat ? "Yes" : "No", r.p_yes, r.steps, r.ms, r.cached ? ", cached features" : "");
+        capture_report_output(job, out);
+        capture_store_image(job);
+        return CAP_DONE;
+#else
+        return CAP_ENCODE;
+#endif
+    }
+    case CAP_ENCODE: {
+        // 5) Crop to what changed since the device's last frame, or shrink the whole frame to
+        //    the VLM input size, and base64 that; the full frame stays on disk.
+        if (VLM_ROI_CROP && capture_encode_roi(job)) {
+            // job->base64 holds the region
+        } else if (VLM_IMAGE_MAX_DIM > 0) {
+            st_jpeg_scale_info_t si;
+            size_t small_len = 0;
+            job->base64 = vlm_base64(job->img, job->img_len, &job->base64_len, &small_len, &si);
+            if (!job->base64) return CAP_FAILED;
+            job->base64_cap = job->base64_len + 1;
+            if (small_len) {
+                char msg[160];
+                snprintf(msg, sizeof(msg), "Resized %dx%d -> %dx%d (%zu KB -> %zu KB).",
+                         si.src_w, si.src_h, si.out_w, si.out_h, job->img_len / 1024, small_len / 1024);
+                capture_report(job, msg);
+            }
+        }
+        capture_store_image(job);
+        // The base64 file is only saved for debugging purposes.
+        if (ST_DEBUG_FILES) {
+            char name[128];
+            char *copy = malloc(job->base64_len);
+            snprintf(name, sizeof(name), "base64_%s.txt", job->timestamp);
+            if (copy) {
+                memcpy(copy, job->base64, job->base64_len);
+                st_storage_put(name, copy, job->base64_len, NULL, NULL);
+            }
+        }
+        return CAP_PROMPT;
+    }
+    case CAP_PROMPT: {
+        // 6) Debug only: prompt_<timestamp>.json with the exact request that is streamed below
+        if (ST_DEBUG_FILES && job->prompts) {
+            size_t len = 0;
+            char *json_str = st_vlm_prompt_render(&job->prompts->tmpl, job->base64, job->base64_len, &len);
+            if (json_str) {
+                char name[128];
+                snprintf(name, sizeof(name), "prompt_%s.json", job->timestamp);
+                st_storage_put(name, json_str, len, NULL, NULL);
             }
-        } else {
-            ui_log_append(ad, "Token refresh failed.");
-            return false;
         }
+        return CAP_UPLOAD;
+    }
+    case CAP_UPLOAD: {
+        // 7) Stream the precompiled prompt framing + image to the evaluation service (no JSON copy,
+        //    no disk); all prompts of the device travel in one request with the image once
+        if (!job->prompts) { capture_report(job, "No VLM prompts configured."); return CAP_FAILED; }
+        if (!st_http_host_available(VLM_ENDPOINT)) return capture_defer(job, "VLM service unreachable");
+        capture_report(job, "Sending to VLM evaluation...");
+        const st_vlm_endpoint_t ep = { .url = VLM_ENDPOINT, .timeout_sec = 60,
+                                       .cancelled = capture_cancelled, .cancel_ctx = job };
+        st_vlm_answers_t *answers = malloc(sizeof(*answers));
+        if (!answers) return CAP_FAILED;
+        st_http_info_t info;
+        bool ok = st_vlm_send_set(&ep, job->prompts, job->base64, job->base64_len, answers, &info);
+        if (ok) {
+            char out[1024];
+            vlm_answers_format(job->prompts, answers, out, sizeof(out));
+            capture_report_output(job, out);
+            st_outbox_kick();       // the service answers again: stop backing off
+        }
+        free(answers);
+        if (ok) return CAP_DONE;
+        if (!capture_cancelled(job) && vlm_unreachable(&info)) return capture_defer(job, "VLM request failed");
+        char msg[256];
+        snprintf(msg, sizeof(msg), "VLM request failed (HTTP %ld).", info.status);
+        capture_report(job, msg);
+        return CAP_FAILED;
     }
+    default:
+        return job->state;
+    }
+}
 
-    // 2️⃣ If token.txt does NOT exist → copy from res, do NOT refresh
-    ui_log_append(ad, "No token.txt found. Copying from /res...");
+static void capture_job_free(capture_job_t *job) {
+    if (!job) return;
+    free(job->token);
+    free(job->base64);
+    free(job->img);
+    free(job->rgb);
+    free(job);
+}
 
-    FILE *src = fopen(res_token, "r");
-    if (!src) {
-        ui_log_append(ad, " Missing token.txt in resources.");
-        return false;
+static void capture_job_release(capture_job_t *job) {
+    if (atomic_fetch_sub(&job->refs, 1) == 1) capture_job_free(job);
+}
+
+// span name per state, so "Show Timing" splits a capture into its stages
+static const char *const capture_stage_name[] = {
+    [CAP_BASELINE] = "cap.baseline",
+    [CAP_COMMANDS] = "cap.commands",
+    [CAP_STATUS]   = "cap.status",
+    [CAP_DOWNLOAD] = "cap.download",
+    [CAP_DECODE]   = "cap.decode",
+    [CAP_INFER]    = "cap.infer",
+    [CAP_ENCODE]   = "cap.encode",
+    [CAP_PROMPT]   = "cap.prompt",
+    [CAP_UPLOAD]   = "cap.upload",
+};
+
+// Pipeline stage of a state; the network states run on the ecore_thread.
+enum { ANALYSIS_NETWORK = -2, ANALYSIS_PREP = 0, ANALYSIS_EVAL, ANALYSIS_STAGES };
+
+static int capture_stage_of(capture_state_e state) {
+    switch (state) {
+    case CAP_DECODE: case CAP_ENCODE: case CAP_PROMPT: return ANALYSIS_PREP;
+    case CAP_INFER: case CAP_UPLOAD: return ANALYSIS_EVAL;
+    case CAP_DONE: case CAP_FAILED: return ST_PIPE_DONE;
+    default: return ANALYSIS_NETWORK;
     }
+}
 
-    FILE *dst = fopen(TOKEN_FILE, "w");
-    if (!dst) {
-        fclose(src);
-        ui_log_append(ad, "Failed to create token.txt in permanent folder.");
-        return false;
+// Runs states until the job leaves stage (or finishes). An earlier stage's state
+// (the INFER -> ENCODE fallback) runs here too instead of queueing backwards.
+// Requests made meanwhile count against the device's account (rate, connections).
+static capture_state_e capture_run_until(capture_job_t *job, int stage) {
+    st_account_enter(job->account);
+    while (job->state != CAP_DONE && job->state != CAP_FAILED) {
+        if (capture_stage_of(job->state) > stage) break;
+        if (capture_cancelled(job)) { job->state = CAP_FAILED; break; }
+        st_span_t span = st_span_begin(capture_stage_name[job->state]);
+        job->state = capture_step(job);
+        st_span_end(&span);
+    }
+    st_account_leave();
+    return job->state;
+}
+
+static void capture_worker(void *data, Ecore_Thread *th) {
+    capture_job_t *job = data;
+    job->th = th;
+    ST_TRACE_SCOPE("capture");
+    if (capture_run_until(job, ANALYSIS_NETWORK) == CAP_DONE || job->state == CAP_FAILED) return;
+    if (job->ad->analysis) {
+        // the pipeline owns a reference from here on; push waits while analysis is backed up
+        job->handed_off = true;
+        atomic_store(&job->refs, 2);
+        if (st_pipe_push(job->ad->analysis, capture_stage_of(job->state), job, NULL, NULL)) return;
+        job->handed_off = false;
+        atomic_store(&job->refs, 1);
+        job->state = CAP_FAILED;
+        return;
     }
+    // no pipeline: analyse on this thread as before
+    capture_run_until(job, ANALYSIS_EVAL);
+}
 
-    char buf[1024];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), src)) > 0)
-        fwrite(buf, 1, n, dst);
-    fclose(src);
-    fclose(dst);
+static void capture_notify(void *data, Ecore_Thread *th, void *msg_data) {
+    (void)data;
+    (void)th;
+    capture_msg_show(msg_data);
+}
 
-    ui_log_append(ad, "token.txt copied from resources (no refresh performed).");
+// Analysis worker threads: one stage of a handed-off job.
+static int analysis_run(int stage, void *item, void *ctx) {
+    (void)ctx;
+    return capture_stage_of(capture_run_until(item, stage));
+}
 
-    // Optionally load into memory for ACCESS_TOKEN use later
-    if (read_kv_file(TOKEN_FILE, &t)) {
-        ACCESS_TOKEN = strdup(t.access_token);
-        ui_log_append(ad, "Loaded copied access token for future validation.");
-    }
+typedef struct {
+    st_sched_device_t *dev;
+    char image_url[512];
+    uint64_t frame_hash;
+} capture_seen_t;
 
-    return true;
+static void capture_seen_set(st_sched_device_t *dev, const char *image_url, uint64_t frame_hash) {
+    snprintf(dev->last_image_url, sizeof(dev->last_image_url), "%s", image_url);
+    if (frame_hash) dev->last_frame_hash = frame_hash;
 }
 
-//END OF TAKEN REFRESH METHODS//
+// Main loop: the frame was evaluated (or deferred to the outbox), so the next
+// capture may skip it as a duplicate.
+static void capture_seen_commit(void *data) {
+    capture_seen_t *s = data;
+    capture_seen_set(s->dev, s->image_url, s->frame_hash);
+    free(s);
+}
 
-//IMAGE CAPTURE METHODS//
+static void capture_seen(capture_job_t *job) {
+    capture_seen_t *s = malloc(sizeof(*s));
+    if (!s) return;
+    s->dev = job->dev;
+    snprintf(s->image_url, sizeof(s->image_url), "%s", job->image_url);
+    s->frame_hash = job->frame_hash;
+    ecore_main_loop_thread_safe_call_async(capture_seen_commit, s);
+}
 
-#define SAVE_FOLDER "/opt/usr/home/owner/content/Pictures/"
+static void analysis_done(void *item, bool dropped, void *ctx) {
+    capture_job_t *job = item;
+    (void)ctx;
+    if (!dropped && job->state == CAP_DONE) capture_seen(job);
+    if (!dropped && job->state == CAP_FAILED && !st_pipe_stopping(job->ad->analysis))
+        capture_report(job, "Analysis aborted.");
+    capture_job_release(job);
+}
 
-// --- Generate timestamp for naming captures ---
-static void current_timestamp(char *buf, size_t size) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(buf, size, "%Y%m%d_%H%M%S", t);
+static void capture_finish(capture_job_t *job, bool ok) {
+    if (ok) {
+        // a handed-off frame has no verdict yet; analysis_done commits it
+        if (!job->handed_off) capture_seen_set(job->dev, job->image_url, job->frame_hash);
+        if (job->duplicate) job->dev->duplicates++;
+    }
+    st_sched_done(&job->ad->sched, job->dev, ok, job->started, ecore_time_unix_get());
+    st_metric_inc(st_metrics_counter("st_captures_total", ok ? "result=\"ok\"" : "result=\"failed\""));
+    capture_job_release(job);
 }
 
-//for Base64 conversion
-static unsigned char* readImageToBytes(const char* filePath, size_t* size) {
-    FILE* f = fopen(filePath, "rb");
-    if (!f) return NULL;
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    rewind(f);
-    *size = sz;
-    unsigned char* buf = malloc(sz);
-    if (!buf) { fclose(f); return NULL; }
-    fread(buf, 1, sz, f);
-    fclose(f);
-    return buf;
+// A handed-off job only releases its device here; the analysis may still
+// be running (or done), reports on its own and settles the image URL and
+// hash once the frame was evaluated or deferred.
+static void capture_end(void *data, Ecore_Thread *th) {
+    capture_job_t *job = data;
+    (void)th;
+    if (job->handed_off) { capture_finish(job, true); return; }
+    if (job->state == CAP_FAILED) {
+        char line[256];
+        snprintf(line, sizeof(line), "[%s] Capture aborted.", job->device_name);
+        ui_log_append(job->ad, line);
+    }
+    capture_finish(job, job->state == CAP_DONE);
 }
 
+static void capture_cancel(void *data, Ecore_Thread *th) {
+    (void)th;
+    capture_finish(data, false);
+}
 
-static char* encode_base64(const unsigned char* data, size_t len, size_t* outlen) {
-    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    char* out = malloc(4 * ((len + 2) / 3) + 1);
-    if (!out) return NULL;
-    size_t i, j;
-    for (i = 0, j = 0; i < len;) {
-        uint32_t a = i < len ? data[i++] : 0;
-        uint32_t b = i < len ? data[i++] : 0;
-        uint32_t c = i < len ? data[i++] : 0;
-        uint32_t t = (a << 16) | (b << 8) | c;
-        out[j++] = tbl[(t >> 18) & 63];
-        out[j++] = tbl[(t >> 12) & 63];
-        out[j++] = (i > len + 1) ? '=' : tbl[(t >> 6) & 63];
-        out[j++] = (i > len) ? '=' : tbl[t & 63];
+// Starts one capture cycle for dev in the background; dev is already
+// marked busy by the scheduler and is released in capture_finish.
+static void capture_start(appdata_s *ad, st_sched_device_t *dev) {
+    capture_job_t *job = calloc(1, sizeof(*job));
+    if (!job) { st_sched_done(&ad->sched, dev, false, ecore_time_unix_get(), ecore_time_unix_get()); return; }
+    job->ad = ad;
+    job->dev = dev;
+    job->state = CAP_BASELINE;
+    atomic_init(&job->refs, 1);
+    job->started = ecore_time_unix_get();
+    snprintf(job->device_id, sizeof(job->device_id), "%s", dev->id);
+    snprintf(job->device_name, sizeof(job->device_name), "%s", dev->name);
+    job->account = st_account_find(ad->sched.accounts[dev->account].name);
+    snprintf(job->prev_image_url, sizeof(job->prev_image_url), "%s", dev->last_image_url);
+    job->prev_frame_hash = dev->last_frame_hash;
+    job->prompts = ad->prompts ? &ad->prompts[dev - ad->sched.devs] : NULL;
+
+    // timestamp + device prefix keeps files of parallel captures apart
+    char ts[32];
+    current_timestamp(ts, sizeof(ts));
+    snprintf(job->timestamp, sizeof(job->timestamp), "%s_%.8s", ts, dev->id);
+    snprintf(job->img_name, sizeof(job->img_name), "capture_%s.jpg", job->timestamp);
+
+    Ecore_Thread *th = ecore_thread_feedback_run(capture_worker, capture_notify,
+                                                 capture_end, capture_cancel, job, EINA_FALSE);
+    if (!th) {
+        ui_log_append(ad, "Failed to start capture worker.");
+        capture_finish(job, false);
+        return;
     }
-    out[j] = '\0';
-    *outlen = j;
-    return out;
+    dev->worker = th;
 }
 
+// ---------- SCHEDULER TICK ----------
+// The live button shows the rate the scheduler actually runs at, which drops
+// below the configured one when captures are slow or the API budget is tight.
+static void live_rate_show(appdata_s *ad) {
+    double rate = ad->live_running ? st_sched_rate_per_min(&ad->sched) : 0;
+    if (!ad->btn_live || fabs(rate - ad->shown_rate) < 0.05) return;
+    ad->shown_rate = rate;
+    char label[64];
+    if (ad->live_running)
+        snprintf(label, sizeof(label), "Stop Live Capture (%.1f/min)", rate);
+    else
+        snprintf(label, sizeof(label), "Start Live Capture");
+    elm_object_text_set(ad->btn_live, label);
+}
 
-static bool http_download_file_smart(const char *url, const char *token, const char *save_path) {
-    CURL *curl = curl_easy_init();
-    if (!curl) return false;
-    FILE *fp = fopen(save_path, "wb");
-    if (!fp) return false;
-    struct curl_slist *headers = NULL;
-    char auth[512];
-    snprintf(auth, sizeof(auth), "Authorization: Bearer %s", token);
-    headers = curl_slist_append(headers, auth);
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    curl_slist_free_all(headers);
-    fclose(fp);
-    return (res == CURLE_OK);
+// ---------- CONNECTION PRE-WARM ----------
+// A capture that starts on an idle pool first resolves and handshakes with
+// the API and then the image CDN. Shortly before the next camera is due, a
+// worker opens those connections (st_http_prewarm), so the capture's first
+// requests find them in the pool. Skipped while requests keep the
+// pool warm anyway.
+typedef struct {
+    appdata_s *ad;
+    size_t count;
+    char urls[PREWARM_MAX_HOSTS][512];
+} prewarm_job_t;
+
+static void prewarm_worker(void *data, Ecore_Thread *th) {
+    prewarm_job_t *job = data;
+    for (size_t i = 0; i < job->count && !ecore_thread_check(th); i++)
+        st_http_prewarm(job->urls[i]);
 }
 
+static void prewarm_end(void *data, Ecore_Thread *th) {
+    prewarm_job_t *job = data;
+    (void)th;
+    job->ad->prewarm = NULL;
+    free(job);
+}
 
-static void take_image_capture(appdata_s *ad) {
-    if (!ACCESS_TOKEN) {
-        ui_log_append(ad, "No valid ACCESS_TOKEN.");
-        return;
+// Length of scheme://host[:port]
+static size_t url_origin_len(const char *url) {
+    const char *p = strstr(url, "://");
+    return p ? (size_t)(p + 3 - url) + strcspn(p + 3, "/?#") : 0;
+}
+
+static void prewarm_add(prewarm_job_t *job, const char *url) {
+    size_t n = url_origin_len(url);
+    if (!n || job->count >= PREWARM_MAX_HOSTS) return;
+    for (size_t i = 0; i < job->count; i++)
+        if (url_origin_len(job->urls[i]) == n && strncmp(job->urls[i], url, n) == 0) return;
+    snprintf(job->urls[job->count++], sizeof(job->urls[0]), "%s", url);
+}
+
+static void prewarm_maybe(appdata_s *ad, double now) {
+    unsigned long calls = st_http_request_count();
+    if (calls != ad->http_seen) {
+        ad->http_seen = calls;
+        ad->http_active_at = now;
     }
+    if (!ad->live_running || ad->prewarm || now - ad->http_active_at < PREWARM_IDLE_SEC) return;
+
+    prewarm_job_t *job = NULL;
+    for (size_t i = 0; i < ad->sched.count; i++) {
+        st_sched_device_t *dev = &ad->sched.devs[i];
+        if (dev->busy || dev->next_due - now > PREWARM_LEAD_SEC) continue;
+        if (!job && !(job = calloc(1, sizeof(*job)))) return;
+        if (!job->count) prewarm_add(job, API_BASE);
+        if (dev->last_image_url[0]) prewarm_add(job, dev->last_image_url);
+    }
+    if (!job) return;
+    job->ad = ad;
+    ad->http_active_at = now;   // once per idle stretch
+    ad->prewarm = ecore_thread_run(prewarm_worker, prewarm_end, prewarm_end, job);
+    if (!ad->prewarm) free(job);
+}
 
-    char timestamp[64];
-    current_timestamp(timestamp, sizeof(timestamp));
+// Queue depths, sampled once a tick; the rest of the registry is fed
+// where the work happens (st_http, st_trace spans, st_token, st_infer).
+static void metrics_sample(appdata_s *ad) {
+    st_metric_set(st_metrics_gauge("st_captures_inflight", NULL), (int64_t)ad->sched.inflight);
+    st_metric_set(st_metrics_gauge("st_outbox_pending", NULL), (int64_t)st_outbox_pending());
+    st_memtrack_tick(ecore_time_get());     // RSS trend, sampled once a minute
+    for (int i = 0; ad->analysis && i < ANALYSIS_STAGES; i++) {
+        static const char *const labels[ANALYSIS_STAGES] = {
+            [ANALYSIS_PREP] = "stage=\"analysis.prep\"",
+            [ANALYSIS_EVAL] = "stage=\"analysis.eval\"",
+        };
+        st_pipe_stage_stats_t st;
+        st_pipe_stats(ad->analysis, i, &st);
+        st_metric_set(st_metrics_gauge("st_pipe_queued", labels[i]), (int64_t)st.queued);
+        st_metric_set(st_metrics_gauge("st_pipe_busy", labels[i]), (int64_t)st.busy);
+    }
+}
 
-    char img_path[512];
-    snprintf(img_path, sizeof(img_path), "%scapture_%s.jpg", SAVE_FOLDER, timestamp);
+// Starts every due camera while the worker pool has room. Per-device
+// intervals and per-account capture limits live in the scheduler; the
+// global and per-account request budgets are enforced inside st_http, so
+// parallel captures cannot exceed the API rate limit.
+static Eina_Bool sched_tick_cb(void *data) {
+    appdata_s *ad = data;
+    // triggers and startup land here too; due cameras wait for app_resume
+    if (ad->paused) return ECORE_CALLBACK_RENEW;
+    metrics_sample(ad);
+    if (!st_account_any_available()) return ECORE_CALLBACK_RENEW;
+    st_account_maintain();
+    // SmartThings is failing: let the breaker cool down instead of queueing captures
+    if (!st_http_host_available(API_BASE)) return ECORE_CALLBACK_RENEW;
+    st_sched_device_t *dev;
+    while ((dev = st_sched_next(&ad->sched, ecore_time_unix_get(), ad->live_running)) != NULL)
+        capture_start(ad, dev);
+    prewarm_maybe(ad, ecore_time_unix_get());
+    // sensor reads are not part of any capture
+    st_sched_note_calls(&ad->sched, st_http_request_count() - st_motion_request_count());
+    live_rate_show(ad);
+    return ECORE_CALLBACK_RENEW;
+}
 
-    char url[512];
-    snprintf(url, sizeof(url), "%s/devices/%s/commands", API_BASE, DEVICE_ID);
-
-    // 1️) Refresh (sends a refresh command to the API, to refresh)
-    ui_log_append(ad, "Sending refresh command...");
-    const char payload_refresh[] =
-        "{\"commands\":[{\"component\":\"main\",\"capability\":\"Refresh\","
-        "\"command\":\"refresh\",\"arguments\":[]}]}";
-    char *r1 = http_post(url, ACCESS_TOKEN, payload_refresh);
-    if (!r1) ui_log_append(ad, "Failed to send refresh command.");
-    free(r1);
-    sleep(5);
-
-    // 2️) Trigger image capture (send the 'take' command of the imageCaptures)
-    ui_log_append(ad, "Triggering image capture...");
-    const char payload_take[] =
-        "{\"commands\":[{\"component\":\"main\",\"capability\":\"imageCapture\","
-        "\"command\":\"take\",\"arguments\":[]}]}";
-    char *r2 = http_post(url, ACCESS_TOKEN, payload_take);
-    free(r2);
-    sleep(5);
-
-    // 3️) Fetch status for image URL
-    snprintf(url, sizeof(url), "%s/devices/%s/status", API_BASE, DEVICE_ID);
-    ui_log_append(ad, "Fetching latest device status...");
-    char *status = http_get(url, ACCESS_TOKEN);
-    if (!status) { ui_log_append(ad, "Failed to fetch device status."); return; }
-
-    char *found = strstr(status, "https://");
-    if (!found) {
-        ui_log_append(ad, "No image URL found in status response.");
-        free(status);
-        return;
+// ---------- MOTION TRIGGERS ----------
+// Cameras listed in TRIGGERS_FILE capture when a linked motion/contact
+// sensor reports activity (st_motion.c) and otherwise only every
+// TRIGGER_HEARTBEAT_SEC; the rest keep their fixed interval.
+typedef struct {
+    appdata_s *ad;
+    char camera_id[64];
+    char sensor_id[64];
+    int kind;
+} motion_msg_t;
+
+static void motion_fire_show(void *data) {
+    motion_msg_t *m = data;
+    appdata_s *ad = m->ad;
+    st_sched_device_t *dev = ad->live_running ? st_sched_trigger(&ad->sched, m->camera_id) : NULL;
+    if (dev) {
+        char line[256];
+        snprintf(line, sizeof(line), "[%s] %s, capturing.", dev->name,
+                 (m->kind & ST_MOTION_MOTION) ? "Motion detected" : "Contact opened");
+        ui_log_append(ad, line);
+        sched_tick_cb(ad);
+    } else if (ad->live_running) {
+        st_log(ST_LOG_WARN, "trigger for unknown camera %s (sensor %s)", m->camera_id, m->sensor_id);
     }
+    free(m);
+}
 
-    char image_url[512];
-    sscanf(found, "%511[^\"]", image_url);
-    free(status);
+// Watcher thread: hop to the main loop, where the scheduler lives.
+static void motion_fire(const char *camera_id, const char *sensor_id, int kind, void *ctx) {
+    motion_msg_t *m = calloc(1, sizeof(*m));
+    if (!m) return;
+    m->ad = ctx;
+    snprintf(m->camera_id, sizeof(m->camera_id), "%s", camera_id);
+    snprintf(m->sensor_id, sizeof(m->sensor_id), "%s", sensor_id);
+    m->kind = kind;
+    ecore_main_loop_thread_safe_call_async(motion_fire_show, m);
+}
 
-    // 4️) Download new image
-    /*ui_log_append(ad, "⬇️ Downloading captured image...");
-    if (!http_download_file_smart(image_url, ACCESS_TOKEN, img_path)) {
-        ui_log_append(ad, "Failed to download image.");
-        return;
-    }*/
-    ui_log_append(ad, "Downloading captured image...");
-    http_download_file_smart(image_url, ACCESS_TOKEN, img_path);
+// ---------- STORE-AND-FORWARD ----------
+// Frames the VLM could not be reached for wait in st_outbox (journal in
+// OUTBOX_FILE) and are re-sent from SAVE_FOLDER on its drain thread.
+static bool outbox_cancelled(void *ctx) {
+    (void)ctx;
+    return st_outbox_stopping();
+}
 
+static uint8_t *outbox_read_frame(const char *name, size_t *len) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", SAVE_FOLDER, name);
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = n > 0 ? malloc((size_t)n) : NULL;
+    *len = buf ? fread(buf, 1, (size_t)n, fp) : 0;
+    fclose(fp);
+    if (buf && *len != (size_t)n) { free(buf); buf = NULL; }
+    return buf;
+}
 
-    // 5️) Display the image in UI,
-    elm_image_file_set(ad->img_view, img_path, NULL);
-    evas_object_size_hint_align_set(ad->img_view, EVAS_HINT_FILL, EVAS_HINT_FILL);
-    evas_object_size_hint_weight_set(ad->img_view, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
-    elm_image_resizable_set(ad->img_view, EINA_TRUE, EINA_TRUE);
-    elm_image_aspect_fixed_set(ad->img_view, EINA_FALSE);
-    evas_object_show(ad->img_view);
+static st_outbox_result_e outbox_send(const st_outbox_entry_t *e, void *ctx) {
+    appdata_s *ad = ctx;
+    st_sched_device_t *dev = st_sched_find(&ad->sched, e->device_id);
+    const st_vlm_prompt_set_t *prompts = dev ? &ad->prompts[dev - ad->sched.devs] : NULL;
+    if (!prompts || !prompts->n) return ST_OUTBOX_DROP;
+
+    size_t len = 0;
+    uint8_t *img = outbox_read_frame(e->frame, &len);
+    if (!img) {
+        // just queued: the storage writer may not have it on disk yet; later it was rotated out
+        return time(NULL) - e->queued_at < 60 ? ST_OUTBOX_RETRY : ST_OUTBOX_DROP;
+    }
+    st_jpeg_scale_info_t si;
+    size_t b64_len = 0, small_len = 0;
+    char *b64 = vlm_base64(img, len, &b64_len, &small_len, &si);
+    free(img);
+    st_vlm_answers_t *answers = b64 ? malloc(sizeof(*answers)) : NULL;
+    if (!answers) { free(b64); return ST_OUTBOX_RETRY; }
+
+    const st_vlm_endpoint_t ep = { .url = VLM_ENDPOINT, .timeout_sec = 60, .cancelled = outbox_cancelled };
+    st_http_info_t info;
+    bool ok = st_vlm_send_set(&ep, prompts, b64, b64_len, answers, &info);
+    free(b64);
+    st_outbox_result_e r = ok ? ST_OUTBOX_SENT : vlm_unreachable(&info) ? ST_OUTBOX_RETRY : ST_OUTBOX_DROP;
+    if (r != ST_OUTBOX_RETRY) {
+        capture_msg_t *m = calloc(1, sizeof(*m));
+        if (m) {
+            m->ad = ad;
+            snprintf(m->device_name, sizeof(m->device_name), "%s", dev->name);
+            m->model_output = ok;
+            char answer[sizeof(m->text) - 64];
+            if (ok) vlm_answers_format(prompts, answers, answer, sizeof(answer));
+            else snprintf(answer, sizeof(answer), "VLM rejected the frame (HTTP %ld).", info.status);
+            snprintf(m->text, sizeof(m->text), "%s (queued %.0f s): %s", e->frame,
+                     difftime(time(NULL), (time_t)e->queued_at), answer);
+            ecore_main_loop_thread_safe_call_async(capture_msg_show, m);
+        }
+    }
+    free(answers);
+    return r;
+}
+
+// ---------- DEVICE EVENTS ----------
+// With an event subscription configured, image-ready waits and sensor
+// reads come from st_devstate's mirror instead of status polls.
+static bool event_stream_url(char *url, size_t len) {
+    FILE *fp = fopen(EVENT_STREAM_FILE, "r");
+    if (!fp) return false;
+    url[0] = '\0';
+    if (!fgets(url, (int)len, fp)) url[0] = '\0';
+    fclose(fp);
+    url[strcspn(url, " \t\r\n")] = '\0';
+    return url[0] != '\0';
+}
+
+static void events_setup(appdata_s *ad) {
+    char url[512];
+    if (!event_stream_url(url, sizeof(url))) return;
+    st_devstate_track("imageCapture", "image");
+    st_devstate_track("motionSensor", "motion");
+    st_devstate_track("contactSensor", "contact");
+    for (size_t i = 0; i < ad->sched.count; i++) st_devstate_watch(ad->sched.devs[i].id);
+    if (st_devstate_start(url)) ui_log_append(ad, "Device events: status is mirrored from the event stream.");
+}
+
+// Each account's limits go to the scheduler under its name before the
+// devices file refers to it; sections naming an unknown account still
+// load, and their captures report the missing token.
+static void accounts_setup(appdata_s *ad) {
+    st_account_init();
+    int n = st_account_load(ACCOUNTS_FILE);
+    for (size_t i = 0; i < st_account_count(); i++) {
+        const st_account_t *a = st_account_at((int)i);
+        int idx = st_sched_account(&ad->sched, a->name);
+        st_sched_set_account_limits(&ad->sched, idx, (size_t)a->max_parallel, a->calls_per_min);
+    }
+    if (n <= 0) return;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%zu account(s) from %s.", st_account_count(), ACCOUNTS_FILE);
+    ui_log_append(ad, msg);
+}
+
+static void sched_setup(appdata_s *ad) {
+    st_sched_init(&ad->sched, MAX_PARALLEL_CAPTURES);
+    accounts_setup(ad);
+    int n = st_sched_load(&ad->sched, DEVICES_FILE, REFRESH_INTERVAL_SEC);
+    if (n <= 0) st_sched_add(&ad->sched, DEVICE_ID, "camera", REFRESH_INTERVAL_SEC);
 
-    char msg[512];
-    snprintf(msg, sizeof(msg), "Image saved: %s", img_path);
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%zu camera(s), up to %d in parallel.",
+             ad->sched.count, MAX_PARALLEL_CAPTURES);
     ui_log_append(ad, msg);
+    for (size_t i = 1; i < ad->sched.account_count; i++) {
+        const st_sched_account_t *a = &ad->sched.accounts[i];
+        if (st_account_find(a->name) >= 0) continue;
+        snprintf(msg, sizeof(msg), "Account %s is not in accounts.txt: its %zu camera(s) have no token.",
+                 a->name, a->devices);
+        ui_log_append(ad, msg);
+    }
 
-    // 6️) Base64 encode
-    size_t img_size = 0;
-    unsigned char *img_data = readImageToBytes(img_path, &img_size);
-    if (!img_data) { ui_log_append(ad, "Failed to read image."); return; }
-
-    size_t out_len = 0;
-    char *base64 = encode_base64(img_data, img_size, &out_len);
-    free(img_data);
-    if (!base64) { ui_log_append(ad, "Base64 encoding failed."); return; }
-
-    // 7️) Save base64 file, saving the file is done for debugging purposes.
-    char txt_path[512];
-    snprintf(txt_path, sizeof(txt_path), "%sbase64_%s.txt", SAVE_FOLDER, timestamp);
-    FILE *txt = fopen(txt_path, "w");
-    if (txt) {
-        fwrite(base64, 1, out_len, txt);
-        fclose(txt);
-        ui_log_append(ad, "Base64 file saved.");
-    }
-
-    // 8️) Create prompt_<timestamp>.json (prompt to send to the evaluation pipeline through websockets)
-    //Notes: the 'method' and 'id' values are sample values, this could change based on the Model being used for vlm evaluation.
-    //The prompt used is in the 'params' field of the JSON.
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddStringToObject(json, "method", "generate_from_image");
-    cJSON *params = cJSON_CreateArray();
-    cJSON_AddItemToArray(params, cJSON_CreateString(
-        "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n"
-        "<|im_start|>user\n<image> Analyze the provided image and determine if any of the persons present pose a potential security threat. For example, the person is trying to hide his face, carries a weapon, etc.\n"
-        "Answer Yes or No.<|im_end|>\n"
-        "<|im_start|>assistant\n"));
-    cJSON_AddItemToArray(params, cJSON_CreateString(base64));
-    cJSON_AddItemToObject(json, "params", params);
-    cJSON_AddNumberToObject(json, "id", 42);
-
-    char *json_str = cJSON_Print(json);
-    if (json_str) {
-        char json_path[512];
-        snprintf(json_path, sizeof(json_path), "%sprompt_%s.json", SAVE_FOLDER, timestamp);
-        FILE *jf = fopen(json_path, "w");
-        if (jf) {
-            fprintf(jf, "%s", json_str);
-            fclose(jf);
-            ui_log_append(ad, "prompt.json created.");
+    // per-device prompt lists, else the '*' ones, else the built-in threat question
+    ad->prompts = calloc(ad->sched.count, sizeof(*ad->prompts));
+    for (size_t i = 0; ad->prompts && i < ad->sched.count; i++) {
+        st_vlm_prompt_set_t *set = &ad->prompts[i];
+        if (st_vlm_prompt_set_load(set, PROMPTS_FILE, ad->sched.devs[i].id) <= 0)
+            st_vlm_prompt_set_add(set, THREAT_PROMPT_LABEL, VLM_PROMPT);
+        if (!st_vlm_prompt_set_compile(set, 42)) ui_log_append(ad, "Could not prepare the VLM prompts.");
+        if (set->n > 1) {
+            snprintf(msg, sizeof(msg), "[%s] %zu prompts per frame.", ad->sched.devs[i].name, set->n);
+            ui_log_append(ad, msg);
         }
-        free(json_str);
     }
-    cJSON_Delete(json);
-    free(base64);
-}
 
+    int rules = st_motion_load(TRIGGERS_FILE);
+    if (rules > 0) {
+        size_t watched = 0;
+        for (size_t i = 0; i < ad->sched.count; i++) {
+            if (!st_motion_watches(ad->sched.devs[i].id)) continue;
+            st_sched_set_interval(&ad->sched, &ad->sched.devs[i], TRIGGER_HEARTBEAT_SEC);
+            watched++;
+        }
+        const st_motion_cfg_t motion_cfg = ST_MOTION_CFG_DEFAULT;
+        if (st_motion_start(&motion_cfg, motion_fire, ad)) {
+            snprintf(msg, sizeof(msg), "%d trigger rule(s): %zu camera(s) on motion, heartbeat every %d s.",
+                     rules, watched, TRIGGER_HEARTBEAT_SEC);
+            ui_log_append(ad, msg);
+        }
+    }
 
-static Eina_Bool live_loop_cb(void *data) {
-    appdata_s *ad = data;
-    if (!ad->live_running) return ECORE_CALLBACK_CANCEL;
-    take_image_capture(ad);
-    return ad->live_running ? ECORE_CALLBACK_RENEW : ECORE_CALLBACK_CANCEL;
+    ecore_thread_max_set(MAX_PARALLEL_CAPTURES);
+    const st_pipe_stage_cfg_t stages[ANALYSIS_STAGES] = {
+        [ANALYSIS_PREP] = { "analysis.prep", 1, ANALYSIS_QUEUE_DEPTH },
+        [ANALYSIS_EVAL] = { "analysis.eval", 1, ANALYSIS_QUEUE_DEPTH },
+    };
+    ad->analysis = st_pipe_create(stages, ANALYSIS_STAGES, analysis_run, analysis_done, ad);
+    if (!ad->analysis) ui_log_append(ad, "Analysis pipeline unavailable, frames are analysed inline.");
+    st_devcache_init(TOKEN_DIR, DEVICE_CACHE_TTL_SEC);
+    st_caps_init(TOKEN_DIR);
+    st_http_set_rate_limit(ST_RATE_LIMIT_RPS, ST_RATE_LIMIT_BURST);
+    st_sched_set_budget(&ad->sched, LIVE_API_BUDGET_PER_MIN);
+    // per endpoint: status polls are cheap to repeat, commands should not pile up, the VLM is slow
+    const st_http_policy_t status_policy = { 3, 10, 250, 4000 };
+    const st_http_policy_t command_policy = { 2, 15, 500, 4000 };
+    const st_http_policy_t vlm_policy = { 2, 60, 1000, 4000 };
+    st_http_set_policy("/status", &status_policy);
+    st_http_set_policy("/commands", &command_policy);
+    st_http_set_policy(VLM_ENDPOINT, &vlm_policy);
+    st_http_set_breaker(ST_HTTP_BREAKER_FAILURES, ST_HTTP_BREAKER_OPEN_SEC);
+    st_outbox_cfg_t outbox = ST_OUTBOX_CFG_DEFAULT;
+    outbox.path = OUTBOX_FILE;
+    outbox.max_entries = OUTBOX_MAX_ENTRIES;
+    outbox.min_interval_sec = OUTBOX_SEND_INTERVAL_SEC;
+    outbox.probe_url = VLM_ENDPOINT;
+    if (st_outbox_open(&outbox, outbox_send, ad) && st_outbox_pending()) {
+        snprintf(msg, sizeof(msg), "%zu frame(s) from the last run wait for evaluation.", st_outbox_pending());
+        ui_log_append(ad, msg);
+    }
+    events_setup(ad);           // after the trigger watcher registered its sensors
+    const st_metrics_cfg_t metrics = { METRICS_PORT, METRICS_FILE, METRICS_FLUSH_SEC };
+    st_metrics_start(&metrics);
+    ad->sched_timer = ecore_timer_add(1.0, sched_tick_cb, ad);
 }
 
 static void live_clicked(void *data, Evas_Object *obj, void *event_info) {
     appdata_s *ad = data;
     if (!ad->live_running) {
         ad->live_running = true;
-        elm_object_text_set(obj, "Stop Live Capture");
         ui_log_append(ad, "Starting live capture...");
-        ecore_timer_add(REFRESH_INTERVAL_SEC, live_loop_cb, ad);
+        sched_tick_cb(ad);
     } else {
         ad->live_running = false;
-        elm_object_text_set(obj, "Start Live Capture");
         ui_log_append(ad, "Live capture stopped.");
     }
+    st_motion_set_enabled(ad->live_running);
+    ad->shown_rate = -1;        // refresh the label now
+    live_rate_show(ad);
 }
 
 
 
 static void capture_once_clicked(void *data, Evas_Object *obj, void *event_info) {
     appdata_s *ad = data;
-    ui_log_append(ad, "Capturing single image...");
-    take_image_capture(ad);
+    if (!st_token_available()) { ui_log_append(ad, "No valid access token."); return; }
+    ui_log_append(ad, "Capturing one image per camera...");
+    st_sched_trigger_all(&ad->sched);
+    sched_tick_cb(ad);
 }
 
 
+// Per-stage latency: UI log + dlog, and a Chrome trace of the recent spans.
+static void show_timing_clicked(void *data, Evas_Object *obj, void *event_info) {
+    appdata_s *ad = data;
+    char buf[ST_TRACE_MAX_STAGES * 96];
+    if (!st_trace_summary(buf, sizeof(buf))) { ui_log_append(ad, "No timing data yet."); return; }
+    ui_log_append(ad, "<b>Timing:</b>");
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        ui_log_append(ad, line);
+    unsigned long events = 0, connects = 0;
+    st_devstate_counts(&events, &connects);
+    if (connects) {
+        char line[128];
+        snprintf(line, sizeof(line), "events  %s  applied=%lu  connects=%lu",
+                 st_devstate_live() ? "live" : "down", events, connects);
+        ui_log_append(ad, line);
+    }
+    if (st_outbox_pending() || st_outbox_evicted()) {
+        char line[128];
+        snprintf(line, sizeof(line), "outbox  pending=%zu  evicted=%lu", st_outbox_pending(), st_outbox_evicted());
+        ui_log_append(ad, line);
+    }
+    if (ad->analysis) {
+        char pipe_buf[ANALYSIS_STAGES * 128];
+        st_pipe_summary(ad->analysis, pipe_buf, sizeof(pipe_buf));
+        for (char *line = strtok_r(pipe_buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+            ui_log_append(ad, line);
+    }
+    st_trace_dump_dlog();
+    if (st_trace_write_chrome(TRACE_FILE)) ui_log_append(ad, "Trace written to " TRACE_FILE);
+}
+
 static void show_caps_clicked(void *data, Evas_Object *obj, void *event_info) {
     appdata_s *ad = data;
-    if (!ACCESS_TOKEN) { ui_log_append(ad, "No ACCESS_TOKEN."); return; }
-    char url[512];
-    snprintf(url, sizeof(url), "%s/devices/%s", API_BASE, DEVICE_ID);
-    ui_log_append(ad, "Fetching device capabilities...");
-    char *resp = http_get(url, ACCESS_TOKEN);
-    if (resp) {
+    char *token = st_token_get();
+    if (!token) { ui_log_append(ad, "No access token."); return; }
+    char caps[1024];
+    size_t n = st_caps_describe(DEVICE_ID, token, caps, sizeof(caps));
+    free(token);
+    if (n) {
         ui_log_append(ad, "<b>Capabilities:</b>");
-        ui_log_append(ad, resp);
-        free(resp);
+        char *save = NULL;
+        for (char *line = strtok_r(caps, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+            ui_log_append(ad, line);
     } else {
         ui_log_append(ad, "Failed to fetch capabilities.");
     }
 }
 
+// ---------- GALLERY ----------
+// The stored captures (st_storage index, newest first) as a thumbnail
+// grid. Gengrid only realizes the cells in view; a cell shows its cached
+// thumbnail (opened by elm_image off the main loop) or asks st_thumbs to
+// make it, and withdraws the request once scrolled away. A finished
+// thumbnail refreshes its cell. Selecting one shows the capture in the
+// preview, decoded at the size shown.
+typedef struct gallery_item {
+    st_storage_entry_t e;
+    Elm_Object_Item *it;
+} gallery_item_t;
+
+typedef struct {
+    appdata_s *ad;
+    char name[128];
+} thumb_msg_t;
+
+static char *gallery_text_get(void *data, Evas_Object *obj, const char *part) {
+    gallery_item_t *g = data;
+    (void)obj;
+    if (strcmp(part, "elm.text") != 0) return NULL;
+    time_t when = (time_t)g->e.when;
+    struct tm tm;
+    char label[32];
+    localtime_r(&when, &tm);
+    strftime(label, sizeof(label), "%b %d %H:%M:%S", &tm);
+    return strdup(label);
+}
+
+static Evas_Object *gallery_content_get(void *data, Evas_Object *obj, const char *part) {
+    gallery_item_t *g = data;
+    if (strcmp(part, "elm.swallow.icon") != 0) return NULL;
+    char path[512];
+    if (!st_thumbs_path(g->e.name, path, sizeof(path))) {
+        st_thumbs_request(g->e.name);   // the cell is refreshed once it exists
+        return NULL;
+    }
+    Evas_Object *img = elm_image_add(obj);
+    elm_image_async_open_set(img, EINA_TRUE);
+    elm_image_file_set(img, path, NULL);
+    return img;
+}
+
+static void gallery_unrealized_cb(void *data, Evas_Object *obj, void *event_info) {
+    (void)data; (void)obj;
+    gallery_item_t *g = elm_object_item_data_get(event_info);
+    if (g) st_thumbs_cancel(g->e.name);
+}
+
+static void gallery_close(appdata_s *ad) {
+    if (!ad->gallery) return;
+    st_thumbs_cancel(NULL);
+    evas_object_del(ad->gallery);
+    ad->gallery = NULL;
+    free(ad->gallery_items);
+    ad->gallery_items = NULL;
+    ad->gallery_count = 0;
+}
+
+static void gallery_selected_cb(void *data, Evas_Object *obj, void *event_info) {
+    appdata_s *ad = data;
+    (void)obj;
+    gallery_item_t *g = elm_object_item_data_get(event_info);
+    if (!g) return;
+    char path[400];
+    snprintf(path, sizeof(path), "%s%s", SAVE_FOLDER, g->e.name);
+    st_preview_set_file(&ad->preview, path);
+    gallery_close(ad);
+}
+
+static void gallery_close_clicked(void *data, Evas_Object *obj, void *event_info) {
+    (void)obj; (void)event_info;
+    gallery_close(data);
+}
+
+static void thumb_ready_show(void *data) {
+    thumb_msg_t *m = data;
+    appdata_s *ad = m->ad;
+    for (size_t i = 0; ad->gallery && i < ad->gallery_count; i++) {
+        if (strcmp(ad->gallery_items[i].e.name, m->name) != 0) continue;
+        elm_gengrid_item_update(ad->gallery_items[i].it);
+        break;
+    }
+    free(m);
+}
+
+// Thumbnail worker: hop to the main loop, where the grid lives.
+static void thumb_ready(const char *name, const char *thumb, void *ctx) {
+    if (!thumb) return;
+    thumb_msg_t *m = calloc(1, sizeof(*m));
+    if (!m) return;
+    m->ad = ctx;
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    ecore_main_loop_thread_safe_call_async(thumb_ready_show, m);
+}
+
+// Storage writer: a capture aged out, so does its thumbnail.
+static void capture_removed(const char *name, void *ctx) {
+    (void)ctx;
+    st_thumbs_forget(name);
+}
+
+static void gallery_clicked(void *data, Evas_Object *obj, void *event_info) {
+    appdata_s *ad = data;
+    (void)obj; (void)event_info;
+    if (ad->gallery) { gallery_close(ad); return; }
+    size_t max = st_storage_usage(NULL);
+    st_storage_entry_t *entries = max ? calloc(max, sizeof(*entries)) : NULL;
+    size_t n = entries ? st_storage_list("capture_", 0, entries, max) : 0;
+    if (!n) {
+        free(entries);
+        ui_log_append(ad, "No stored captures yet.");
+        return;
+    }
+    ad->gallery_items = calloc(n, sizeof(*ad->gallery_items));
+    if (!ad->gallery_items) { free(entries); return; }
+    ad->gallery_count = n;
+
+    if (!ad->gallery_itc) {
+        ad->gallery_itc = elm_gengrid_item_class_new();
+        ad->gallery_itc->item_style = "default";
+        ad->gallery_itc->func.text_get = gallery_text_get;
+        ad->gallery_itc->func.content_get = gallery_content_get;
+    }
+    ad->gallery = elm_win_inwin_add(ad->win);
+    Evas_Object *box = elm_box_add(ad->gallery);
+    Evas_Object *grid = elm_gengrid_add(box);
+    elm_gengrid_item_size_set(grid, ELM_SCALE_SIZE(GALLERY_CELL_W), ELM_SCALE_SIZE(GALLERY_CELL_H));
+    evas_object_size_hint_weight_set(grid, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
+    evas_object_size_hint_align_set(grid, EVAS_HINT_FILL, EVAS_HINT_FILL);
+    evas_object_smart_callback_add(grid, "unrealized", gallery_unrealized_cb, ad);
+    evas_object_smart_callback_add(grid, "selected", gallery_selected_cb, ad);
+    for (size_t i = 0; i < n; i++) {
+        gallery_item_t *g = &ad->gallery_items[i];
+        g->e = entries[i];
+        g->it = elm_gengrid_item_append(grid, ad->gallery_itc, g, NULL, NULL);
+    }
+    free(entries);
+    elm_box_pack_end(box, grid);
+    evas_object_show(grid);
+
+    Evas_Object *btn_close = elm_button_add(box);
+    elm_object_text_set(btn_close, "Close");
+    evas_object_smart_callback_add(btn_close, "clicked", gallery_close_clicked, ad);
+    evas_object_size_hint_align_set(btn_close, EVAS_HINT_FILL, EVAS_HINT_FILL);
+    elm_box_pack_end(box, btn_close);
+    evas_object_show(btn_close);
+
+    elm_win_inwin_content_set(ad->gallery, box);
+    elm_win_inwin_activate(ad->gallery);
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Gallery: %zu capture(s).", n);
+    ui_log_append(ad, msg);
+}
+
 // ------------------------------
 
 
@@ -589,6 +1478,8 @@ static void create_base_gui(appdata_s *ad) {
     evas_object_size_hint_weight_set(btn_caps, EVAS_HINT_EXPAND, 0.0);
     evas_object_size_hint_align_set(btn_caps, EVAS_HINT_FILL, EVAS_HINT_FILL);
     elm_box_pack_end(button_row, btn_caps);
+    elm_object_disabled_set(btn_caps, EINA_TRUE);   // until the token is loaded
+    ad->btn_caps = btn_caps;
     evas_object_show(btn_caps);
 
     // BUTTON: Capture Once
@@ -598,21 +1489,41 @@ static void create_base_gui(appdata_s *ad) {
     evas_object_size_hint_weight_set(btn_once, EVAS_HINT_EXPAND, 0.0);
     evas_object_size_hint_align_set(btn_once, EVAS_HINT_FILL, EVAS_HINT_FILL);
     elm_box_pack_end(button_row, btn_once);
+    elm_object_disabled_set(btn_once, EINA_TRUE);
+    ad->btn_once = btn_once;
     evas_object_show(btn_once);
 
+    // BUTTON: Show Timing
+    Evas_Object *btn_timing = elm_button_add(button_row);
+    elm_object_text_set(btn_timing, "Show Timing");
+    evas_object_smart_callback_add(btn_timing,"clicked",show_timing_clicked,ad);
+    evas_object_size_hint_weight_set(btn_timing, EVAS_HINT_EXPAND, 0.0);
+    evas_object_size_hint_align_set(btn_timing, EVAS_HINT_FILL, EVAS_HINT_FILL);
+    elm_box_pack_end(button_row, btn_timing);
+    evas_object_show(btn_timing);
+
+    // BUTTON: Gallery
+    Evas_Object *btn_gallery = elm_button_add(button_row);
+    elm_object_text_set(btn_gallery, "Gallery");
+    evas_object_smart_callback_add(btn_gallery,"clicked",gallery_clicked,ad);
+    evas_object_size_hint_weight_set(btn_gallery, EVAS_HINT_EXPAND, 0.0);
+    evas_object_size_hint_align_set(btn_gallery, EVAS_HINT_FILL, EVAS_HINT_FILL);
+    elm_box_pack_end(button_row, btn_gallery);
+    evas_object_show(btn_gallery);
+
     // BUTTON: Start Live Capture
-    Evas_Object *btn_live = elm_button_add(button_row);
+    Evas_Object *btn_live = ad->btn_live = elm_button_add(button_row);
     elm_object_text_set(btn_live, "Start Live Capture");
     evas_object_smart_callback_add(btn_live,"clicked",live_clicked,ad);
     evas_object_size_hint_weight_set(btn_live, EVAS_HINT_EXPAND, 0.0);
     evas_object_size_hint_align_set(btn_live, EVAS_HINT_FILL, EVAS_HINT_FILL);
     elm_box_pack_end(button_row, btn_live);
+    elm_object_disabled_set(btn_live, EINA_TRUE);
     evas_object_show(btn_live);
 
 
-    ad->img_view = elm_image_add(ad->box);
-    elm_image_resizable_set(ad->img_view, EINA_TRUE, EINA_TRUE);
-    elm_image_aspect_fixed_set(ad->img_view, EINA_FALSE);
+    // filled Evas image (stretched like the old elm_image), double-buffered by st_preview
+    ad->img_view = evas_object_image_filled_add(evas_object_evas_get(ad->box));
 
     // Make image the largest area (weight 4)
     evas_object_size_hint_weight_set(ad->img_view, EVAS_HINT_EXPAND, 6.0);
@@ -620,6 +1531,7 @@ static void create_base_gui(appdata_s *ad) {
 
     elm_box_pack_end(ad->box, ad->img_view);
     evas_object_hide(ad->img_view);  // until first capture
+    st_preview_init(&ad->preview, ad->img_view);
 
     Evas_Object *scroller = elm_scroller_add(ad->box);
     elm_scroller_policy_set(scroller, ELM_SCROLLER_POLICY_AUTO, ELM_SCROLLER_POLICY_AUTO);
@@ -636,6 +1548,7 @@ static void create_base_gui(appdata_s *ad) {
     elm_entry_editable_set(ad->entry_log, EINA_FALSE);
     elm_entry_line_wrap_set(ad->entry_log, ELM_WRAP_CHAR);
     elm_object_text_set(ad->entry_log, "Initializing SmartThings app...");
+    st_ui_log_init(&ad->log, ad->entry_log);
     elm_object_content_set(scroller, ad->entry_log);
     evas_object_show(ad->entry_log);
 
@@ -657,21 +1570,240 @@ static void create_base_gui(appdata_s *ad) {
     evas_object_show(ad->win);
 }
 
+// ---------- STARTUP ----------
+// app_create only builds the window and the scheduler. The capture folder
+// scan, token.txt, refreshing an expired token and the device description
+// run on a startup thread; each stage is reported back as it completes and
+// enables the buttons that need it, so the first frame does not wait for
+// disk or SmartThings round trips.
+typedef enum {
+    STARTUP_TOKEN,          // token loaded (and refreshed if it had expired)
+    STARTUP_NO_SEED,        // no token.txt, none in /res either
+    STARTUP_NO_TOKEN,       // token.txt unreadable or without tokens
+    STARTUP_DEVICE,         // device description cached
+    STARTUP_NO_DEVICE,
+    STARTUP_LOCAL_VLM,      // on-device model loaded (ST_LOCAL_VLM)
+    STARTUP_NO_LOCAL_VLM,
+    STARTUP_LOCAL_VLM_UNSET,    // LOCAL_VLM_YES_TOKENS / _NO_TOKENS not set at build time
+} startup_stage_t;
+
+static void startup_report(Ecore_Thread *th, startup_stage_t stage) {
+    startup_stage_t *m = malloc(sizeof(*m));
+    if (!m) return;
+    *m = stage;
+    if (!ecore_thread_feedback(th, m)) free(m);
+}
+
+static void startup_worker(void *data, Ecore_Thread *th) {
+    appdata_s *ad = data;
+    st_thumbs_cfg_t thumbs = ST_THUMBS_CFG_DEFAULT;
+    thumbs.src_dir = SAVE_FOLDER;
+    thumbs.dir = THUMBS_FOLDER;
+    thumbs.max_dim = GALLERY_THUMB_DIM;
+    st_thumbs_open(&thumbs, thumb_ready, ad);
+    const st_storage_cfg_t storage = {
+        .dir = SAVE_FOLDER,
+        .max_files = STORAGE_MAX_FILES,
+        .max_age_sec = STORAGE_MAX_AGE_SEC,
+        .quota_bytes = STORAGE_QUOTA_BYTES,
+    };
+    st_storage_on_remove(capture_removed, NULL);
+    st_storage_open(&storage);
+    if (ecore_thread_check(th)) return;
+
+    int rc = load_token_file();
+    if (rc < 0) { startup_report(th, rc == -1 ? STARTUP_NO_SEED : STARTUP_NO_TOKEN); return; }
+    // blocks only when the token has expired: that refresh happens here, not on the first capture
+    char *token = st_token_get();
+    startup_report(th, STARTUP_TOKEN);
+    if (!token || ecore_thread_check(th)) { free(token); return; }
+
+    bool cached = false;
+    char *resp = st_devcache_get(DEVICE_ID, token, &cached);
+    free(token);
+    startup_report(th, resp ? STARTUP_DEVICE : STARTUP_NO_DEVICE);
+    free(resp);
+
+#if ST_LOCAL_VLM
+    static const int32_t yes_ids[] = { LOCAL_VLM_YES_TOKENS };
+    static const int32_t no_ids[] = { LOCAL_VLM_NO_TOKENS };
+    if (yes_ids[0] < 0 || no_ids[0] < 0) {
+        startup_report(th, STARTUP_LOCAL_VLM_UNSET);
+        return;
+    }
+    // slowest stage, last: captures use the remote VLM until it is ready
+    if (ecore_thread_check(th)) return;
+    const st_infer_cfg_t vlm = {
+        .encoder_model = LOCAL_VLM_DIR "encoder.onnx",
+        .decoder_model = LOCAL_VLM_DIR "decoder.onnx",
+        .embedding = LOCAL_VLM_DIR "decoder_emb_weight.embq",
+        .input_w = LOCAL_VLM_INPUT,
+        .input_h = LOCAL_VLM_INPUT,
+        .bos_token = LOCAL_VLM_BOS_TOKEN,
+        .yes_tokens = yes_ids,
+        .yes_count = sizeof(yes_ids) / sizeof(yes_ids[0]),
+        .no_tokens = no_ids,
+        .no_count = sizeof(no_ids) / sizeof(no_ids[0]),
+        .decisive = LOCAL_VLM_DECISIVE,
+        .threads = 2,
+        .latency = true,            // alerts wait on the verdict's tail, not its mean
+        .feature_cache_entries = 8,
+        .feature_cache_dir = LOCAL_VLM_DIR "features",
+        .feature_cache_files = 256,
+    };
+    startup_report(th, st_infer_open(&vlm) ? STARTUP_LOCAL_VLM : STARTUP_NO_LOCAL_VLM);
+#endif
+}
+
+static void startup_notify(void *data, Ecore_Thread *th, void *msg) {
+    appdata_s *ad = data;
+    (void)th;
+    startup_stage_t stage = *(startup_stage_t *)msg;
+    free(msg);
+    switch (stage) {
+    case STARTUP_TOKEN:
+        token_loaded_show(ad);
+        ui_log_append(ad, "Token system ready.");
+        ad->token_ready = EINA_TRUE;
+        elm_object_disabled_set(ad->btn_once, EINA_FALSE);
+        elm_object_disabled_set(ad->btn_live, EINA_FALSE);
+        sched_tick_cb(ad);      // cameras already due do not wait for the next tick
+        break;
+    case STARTUP_NO_SEED:
+        ui_log_append(ad, " Missing token.txt in resources, or it could not be copied.");
+        ui_log_append(ad, "Token initialization failed.");
+        break;
+    case STARTUP_NO_TOKEN:
+        ui_log_append(ad, "Failed to read token.txt contents.");
+        ui_log_append(ad, "Token initialization failed.");
+        break;
+    case STARTUP_DEVICE:
+    case STARTUP_NO_DEVICE:
+        // without a cached description the button still fetches it on demand
+        elm_object_disabled_set(ad->btn_caps, EINA_FALSE);
+        break;
+    case STARTUP_LOCAL_VLM:
+        ui_log_append(ad, "On-device VLM ready.");
+        break;
+    case STARTUP_NO_LOCAL_VLM:
+        ui_log_append(ad, "On-device VLM not available, using " VLM_ENDPOINT);
+        break;
+    case STARTUP_LOCAL_VLM_UNSET:
+        ui_log_append(ad, "On-device VLM off: build with LOCAL_VLM_YES_TOKENS and LOCAL_VLM_NO_TOKENS "
+                          "(answer token ids), using " VLM_ENDPOINT);
+        break;
+    }
+}
+
+static void startup_end(void *data, Ecore_Thread *th) {
+    appdata_s *ad = data;
+    (void)th;
+    ad->startup = NULL;
+    if (ad->token_ready) elm_object_disabled_set(ad->btn_caps, EINA_FALSE);
+}
+
 static bool app_create(void *data) {
     appdata_s *ad = data;
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    st_log_open(LOG_FILE, LOG_MAX_BYTES, 2);
+    st_trace_record_events(true);
+    st_http_init();
     create_base_gui(ad);
     ui_log_append(ad,"Initializing SmartThings Token System...");
-    if(initialize_token_file(ad))
-        ui_log_append(ad,"Token system ready.");
-    else ui_log_append(ad,"Token initialization failed.");
+    sched_setup(ad);
+    ad->startup = ecore_thread_feedback_run(startup_worker, startup_notify, startup_end, startup_end,
+                                            ad, EINA_FALSE);
+    if (!ad->startup) ui_log_append(ad, "Could not start the startup thread.");
     return true;
 }
 
 static void app_control(app_control_h app_control, void *data){}
-static void app_pause(void *data){}
-static void app_resume(void *data){}
-static void app_terminate(void *data){curl_global_cleanup();}
+
+// ---------- LIFECYCLE ----------
+// In the background nothing new is started: the tick timer is frozen, the
+// sensor watcher and the event stream stop, the outbox holds its resends.
+// Captures already running finish (their frames are stored and queued as
+// usual). Decoded previews and the VLM feature cache are freed, as is the
+// resident part of the embedding table; all of it is rebuilt on demand.
+// On resume the stream reconnects, the connection pool is warmed and the
+// cameras that fell due meanwhile start at once.
+static void app_pause(void *data){
+    appdata_s *ad = data;
+    if (ad->paused) return;
+    ad->paused = true;
+    if (ad->sched_timer) ecore_timer_freeze(ad->sched_timer);
+    if (ad->prewarm) ecore_thread_cancel(ad->prewarm);
+    st_motion_set_enabled(false);
+    st_devstate_stop();         // status reads fall back to polling until resume
+    st_outbox_set_paused(true);
+    st_preview_release(&ad->preview);
+#if ST_LOCAL_VLM
+    st_infer_trim();
+#endif
+    st_log(ST_LOG_INFO, "paused: %zu capture(s) still running, %zu frame(s) queued",
+           ad->sched.inflight, st_outbox_pending());
+}
+
+static void app_resume(void *data){
+    appdata_s *ad = data;
+    if (!ad->paused) return;
+    ad->paused = false;
+    char url[512];
+    if (event_stream_url(url, sizeof(url))) st_devstate_start(url);
+    st_motion_set_enabled(ad->live_running);
+    st_outbox_set_paused(false);
+    st_preview_restore(&ad->preview);
+    if (ad->sched_timer) ecore_timer_thaw(ad->sched_timer);
+    ad->http_active_at = 0;     // pooled connections are likely stale: warm up now
+    sched_tick_cb(ad);
+}
+static void app_terminate(void *data){
+    appdata_s *ad = data;
+    ad->live_running = false;
+    if (ad->sched_timer) { ecore_timer_del(ad->sched_timer); ad->sched_timer = NULL; }
+    st_motion_stop();           // aborts an in-flight sensor read
+    st_devstate_stop();
+    st_ui_log_cleanup(&ad->log);
+    gallery_close(ad);
+    st_preview_cleanup(&ad->preview);
+    st_thumbs_close();
+    if (ad->startup) {
+        // still loading, so nothing was captured yet; the rest is left to process exit
+        ecore_thread_cancel(ad->startup);
+        return;
+    }
+    if (!ad->sched.inflight) {
+        // handed-off frames finish the stage they are in, queued ones are dropped
+        st_pipe_destroy(ad->analysis, false);
+        ad->analysis = NULL;
+    }
+    st_outbox_close();          // an in-flight resend is aborted; its entry stays queued
+    st_metrics_stop();          // last write of METRICS_FILE
+    st_storage_close();         // finishes queued image writes
+    st_log_close();
+    if (ad->prewarm) ecore_thread_cancel(ad->prewarm);
+    if (ad->sched.inflight || ad->prewarm) {
+        // cancelled transfers abort within a second; the pool is left to process exit
+        for (size_t i = 0; i < ad->sched.count; i++)
+            if (ad->sched.devs[i].worker) ecore_thread_cancel(ad->sched.devs[i].worker);
+        return;
+    }
+#if ST_LOCAL_VLM
+    st_infer_close();
+#endif
+    for (size_t i = 0; ad->prompts && i < ad->sched.count; i++) st_vlm_prompt_set_free(&ad->prompts[i]);
+    free(ad->prompts);
+    ad->prompts = NULL;
+    if (ad->gallery_itc) elm_gengrid_item_class_free(ad->gallery_itc);
+    st_caps_cleanup();
+    st_devcache_cleanup();
+    st_account_cleanup();
+    st_token_cleanup();
+    st_http_cleanup();
+    curl_global_cleanup();
+    // everything above is released, so what is left leaked
+    if (st_memtrack_enabled()) st_memtrack_report(MEMTRACK_FILE, 0);
+}
 
 int main(int argc,char*argv[]){
     appdata_s ad={0,};
@@ -39,6 +39,7 @@ typedef struct appdata {
     smartthings_client_h st_handle;
     char access_token[4096];
     char refresh_token[4096];
+    Ecore_Thread *auth_worker;      // token exchange in flight
 } appdata_s;
 
 // ---------- CURL helpers ----------
@@ -105,6 +106,53 @@ static void authorize_clicked(void *data, Evas_Object *obj, void *event_info) {
     evas_object_show(ad->web);
 }
 
+// The token exchange runs on an ecore_thread worker so the WebKit policy
+// callback returns at once; only auth_end writes the tokens into appdata.
+typedef struct {
+    appdata_s *ad;
+    char code[512];
+    char access_token[4096];
+    char refresh_token[4096];
+} auth_job_t;
+
+static void auth_do(void *data, Ecore_Thread *th) {
+    auth_job_t *j = data;
+    char post[1024];
+    snprintf(post, sizeof(post),
+             "grant_type=authorization_code&code=%s&redirect_uri=%s",
+             j->code, REDIRECT_URI);
+
+    char *resp = http_post_form(TOKEN_URL, CLIENT_ID, CLIENT_SECRET, post);
+    cJSON *json = cJSON_Parse(resp);
+    const cJSON *acc = cJSON_GetObjectItem(json, "access_token");
+    const cJSON *ref = cJSON_GetObjectItem(json, "refresh_token");
+    if (cJSON_IsString(acc) && cJSON_IsString(ref)) {
+        snprintf(j->access_token, sizeof(j->access_token), "%s", acc->valuestring);
+        snprintf(j->refresh_token, sizeof(j->refresh_token), "%s", ref->valuestring);
+    }
+    cJSON_Delete(json);
+    free(resp);
+}
+
+static void auth_end(void *data, Ecore_Thread *th) {
+    auth_job_t *j = data;
+    j->ad->auth_worker = NULL;
+    if (j->access_token[0]) {
+        snprintf(j->ad->access_token, sizeof(j->ad->access_token), "%s", j->access_token);
+        snprintf(j->ad->refresh_token, sizeof(j->ad->refresh_token), "%s", j->refresh_token);
+        dlog_print(DLOG_INFO, LOG_TAG, "Access token stored");
+    } else {
+        dlog_print(DLOG_ERROR, LOG_TAG, "Token exchange failed");
+    }
+    free(j);
+}
+
+static void auth_cancel(void *data, Ecore_Thread *th) {
+    auth_job_t *j = data;
+    j->ad->auth_worker = NULL;
+    free(j);
+}
+
 static Eina_Bool nav_policy_cb(Evas_Object *obj, Ewk_Policy_Decision *decision,
                                Ewk_Policy_Navigation_Type type,
                                Ewk_Frame_Ref *frame, void *data) {
@@ -112,32 +160,20 @@ static Eina_Bool nav_policy_cb(Evas_Object *obj, Ewk_Policy_Decision *decision,
     const char *url = ewk_policy_decision_url_get(decision);
     if (!url) return EINA_FALSE;
     if (strncmp(url, REDIRECT_URI, strlen(REDIRECT_URI)) == 0) {
-        const char *code_pos = strstr(url, "code=");
-        if (code_pos) {
-            char code[512];
-            sscanf(code_pos, "code=%511[^&]", code);
-            dlog_print(DLOG_INFO, LOG_TAG, "Got code: %s", code);
-
-            // Exchange code for tokens
-            char post[1024];
-            snprintf(post, sizeof(post),
-                     "grant_type=authorization_code&code=%s&redirect_uri=%s",
-                     code, REDIRECT_URI);
-
-            char creds[256];
-            snprintf(creds, sizeof(creds), "%s:%s", CLIENT_ID, CLIENT_SECRET);
-
-            char *resp = http_post_form(TOKEN_URL, CLIENT_ID, CLIENT_SECRET, post);
-            cJSON *j = cJSON_Parse(resp);
-            const cJSON *acc = cJSON_GetObjectItem(j, "access_token");
-            const cJSON *ref = cJSON_GetObjectItem(j, "refresh_token");
-            if (acc && ref) {
-                snprintf(ad->access_token, sizeof(ad->access_token), "%s", acc->valuestring);
-                snprintf(ad->refresh_token, sizeof(ad->refresh_token), "%s", ref->valuestring);
-                dlog_print(DLOG_INFO, LOG_TAG, "Access token stored");
-            }
-            cJSON_Delete(j);
-            free(resp);
+        // one exchange at a time: a second redirect while one runs is dropped
+        const char *code_pos = ad->auth_worker ? NULL : strstr(url, "code=");
+        auth_job_t *j = code_pos ? calloc(1, sizeof(*j)) : NULL;
+        if (j && sscanf(code_pos, "code=%511[^&]", j->code) != 1) {
+            dlog_print(DLOG_ERROR, LOG_TAG, "Redirect without a code");
+            free(j);
+            j = NULL;
+        }
+        if (j) {
+            j->ad = ad;
+            dlog_print(DLOG_INFO, LOG_TAG, "Got code");
+            ad->auth_worker = ecore_thread_run(auth_do, auth_end, auth_cancel, j);
+            if (!ad->auth_worker)
+                free(j);
         }
         evas_object_hide(ad->web);
         ewk_policy_decision_ignore(decision);
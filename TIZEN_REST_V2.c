@@ -56,7 +56,9 @@ static const char* DEVICE_ID = "95c6572c-6373-41f4-9cba-daf39a38f59c";
 static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
     mem_t *m = userdata;
     size_t new_len = m->len + size * nmemb;
-    m->buf = realloc(m->buf, new_len + 1);
+    char *buf = realloc(m->buf, new_len + 1);
+    if (!buf) return 0;   // curl fails the transfer; m->buf is still valid and freed by the caller
+    m->buf = buf;
     memcpy(m->buf + m->len, ptr, size * nmemb);
     m->buf[new_len] = '\0';
     m->len = new_len;
@@ -64,9 +66,10 @@ static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
 }
 
 static void log_event(const char *msg) {
-    const char *data_path = app_get_data_path();
+    char *data_path = app_get_data_path();
     char log_path[512];
     snprintf(log_path, sizeof(log_path), "%stoken_refresh.log", data_path);
+    free(data_path);
     FILE *fp = fopen(log_path, "a");
     if (fp) {
         time_t now = time(NULL);
@@ -80,11 +83,13 @@ static void log_event(const char *msg) {
 // STEP 1 — FIRST-RUN COPY (only if not already in /data)
 // ====================================================
 static bool ensure_token_in_data_path(void) {
-    const char *data_dir = app_get_data_path();
-    const char *res_dir  = app_get_resource_path();
+    char *data_dir = app_get_data_path();
+    char *res_dir = app_get_resource_path();
     char data_path[512], res_path[512];
     snprintf(data_path, sizeof(data_path), "%stoken.txt", data_dir);
+    free(data_dir);
     snprintf(res_path,  sizeof(res_path),  "%stoken.txt", res_dir);
+    free(res_dir);
 
     struct stat st;
     if (stat(data_path, &st) == 0) {
@@ -221,8 +226,9 @@ static void ui_log_append(appdata_s *ad, const char *text){
 // TOKEN REFRESH WITH UI FEEDBACK
 // ====================================================
 static bool token_refresh_sequence(appdata_s *ad) {
-    const char *data_path = app_get_data_path();
+    char *data_path = app_get_data_path();
     char token_path[512]; snprintf(token_path,sizeof(token_path),"%stoken.txt",data_path);
+    free(data_path);
     token_data_t t={0};
     if(!read_kv_file(token_path,&t)){
         log_event("❌ Could not read token.txt."); elm_entry_entry_set(ad->entry_log,"❌ Missing token.txt."); return false;
@@ -316,8 +322,9 @@ static void take_image_capture(appdata_s *ad){
     if(!found){ ui_log_append(ad,"❌ No image URL in response."); free(status); return;}
     char img_url[512]; sscanf(found,"%511[^\"]",img_url); free(status);
 
-    const char *data_path=app_get_data_path();
+    char *data_path = app_get_data_path();
     char img_path[512]; snprintf(img_path,sizeof(img_path),"%scaptured_image.jpg",data_path);
+    free(data_path);
     if(http_download_file(img_url,ACCESS_TOKEN,img_path)){
         ui_log_append(ad,"✅ Image downloaded.");
         elm_image_file_set(ad->img_view,img_path,NULL);
@@ -332,9 +339,10 @@ static Eina_Bool live_loop_cb(void *data) {
     appdata_s *ad = data;
     if (!ad->live_running) return ECORE_CALLBACK_CANCEL;
 
-    const char *data_path = app_get_data_path();
+    char *data_path = app_get_data_path();
     char save_path[512];
     snprintf(save_path, sizeof(save_path), "%scaptured_image.jpg", data_path);
+    free(data_path);
     take_image_capture(ad);
     return ad->live_running ? ECORE_CALLBACK_RENEW : ECORE_CALLBACK_CANCEL;
 }
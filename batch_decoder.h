@@ -0,0 +1,257 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "decoder_engine.h"
+#include "host_arena.h"
+#include "logits_reduce.h"
+
+// ============================================================
+// Batched multi-sequence decoding (continuous batching)
+//
+// Needs a model exported with a dynamic batch dimension. Each
+// active sequence owns one slot row in capacity-sized buffers:
+//   encoder  [B,352,2,8]   copied in once when the request is admitted
+//   token    [B,1,256]     gathered from the embedding table per step,
+//            or int64 ids [B,1] when embed is null and the model looks
+//            the rows up itself (EmbLookup, emb_lookup_op.h)
+//   state    [B,1,256] x2  ping-ponged between in/out buffer halves
+//   logits   [B,...,V]
+//
+// One session.Run covers every active slot, through an IoBinding
+// prepared once per (batch size, state half): outputs 1/2 are bound to
+// the other half's rows, so the recurrent state is never copied or
+// re-wrapped between steps. Finished sequences are evicted by moving
+// the last active slot into the hole, so the active rows stay
+// contiguous at [0, active), and free slots are refilled from the
+// pending queue before the next step.
+// ============================================================
+
+struct BatchRequest {
+    int64_t id = 0;
+    const float* encoder = nullptr;   // [1,352,2,8]; null means zeros
+    int32_t first_token = 1;
+    size_t max_steps = 16;
+    int32_t eos_token = -1;
+};
+
+struct BatchResult {
+    int64_t id = 0;
+    std::vector<int32_t> tokens;
+};
+
+// Called from step() for every token as it is produced (streaming).
+using BatchTokenFn = std::function<void(int64_t id, int32_t token)>;
+
+class BatchDecoder {
+public:
+    BatchDecoder(Ort::Session& session,
+                 const DecoderSignature& sig,
+                 size_t max_batch,
+                 DecoderEmbedFn embed)
+        : session_(session),
+          sig_(sig),
+          max_batch_(max_batch),
+          embed_(std::move(embed)),
+          mem_info_(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)) {
+        if (max_batch_ == 0) {
+            throw std::runtime_error("BatchDecoder: max_batch must be > 0");
+        }
+        std::vector<int64_t> out_shape = sig_.logits_shape.empty()
+            ? session_.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape()
+            : sig_.logits_shape;
+        vocab_ = static_cast<size_t>(out_shape.empty() || out_shape.back() <= 0 ? 1 : out_shape.back());
+        logits_row_shape_.assign(out_shape.begin() + (out_shape.empty() ? 0 : 1), out_shape.end());
+        for (auto& d : logits_row_shape_) {
+            if (d <= 0) d = 1;
+        }
+
+        enc_n_ = decoder_shape_elems(sig_.encoder_shape);
+        state_n_ = decoder_shape_elems(sig_.state_shape);
+        logits_n_ = decoder_shape_elems(logits_row_shape_);
+
+        const size_t a = HostArena::kAlign;
+        const size_t token_bytes = embed_ ? state_n_ * sizeof(float) : sizeof(int64_t);
+        arena_.reserve((max_batch_ * ((enc_n_ + 4 * state_n_ + logits_n_) * sizeof(float) + token_bytes) / a + 8) * a);
+        encoder_ = arena_.alloc_zeroed<float>(max_batch_ * enc_n_);
+        if (embed_) token_ = arena_.alloc_zeroed<float>(max_batch_ * state_n_);
+        else token_ids_ = arena_.alloc_zeroed<int64_t>(max_batch_);
+        for (auto& s : state_) s = arena_.alloc_zeroed<float>(max_batch_ * state_n_);
+        logits_ = arena_.alloc_zeroed<float>(max_batch_ * logits_n_);
+        slots_.resize(max_batch_);
+        for (auto& b : bindings_) b.resize(max_batch_);
+    }
+
+    void submit(const BatchRequest& r) { pending_.push_back(r); }
+
+    void set_on_token(BatchTokenFn fn) { on_token_ = std::move(fn); }
+
+    size_t active() const { return active_; }
+    size_t pending() const { return pending_.size(); }
+    bool idle() const { return active_ == 0 && pending_.empty(); }
+
+    // Admit pending requests into free slots, run one batched step,
+    // and move finished sequences into `finished`. Returns the batch
+    // size that was run.
+    size_t step(std::vector<BatchResult>& finished) {
+        admit();
+        if (active_ == 0) return 0;
+
+        const size_t b = active_;
+        for (size_t i = 0; i < b; ++i) {
+            if (embed_) embed_(slots_[i].next_token, token_ + i * state_n_);
+            else token_ids_[i] = slots_[i].next_token;
+        }
+
+        session_.Run(run_options_, *binding(b, cur_).io);
+        cur_ ^= 2;
+
+        // Next tokens, then evict finished slots (walking backwards so
+        // the slot moved into a hole has already been processed).
+        for (size_t i = 0; i < b; ++i) {
+            Slot& s = slots_[i];
+            int32_t tok = static_cast<int32_t>(logits_argmax(logits_ + i * logits_n_ + (logits_n_ - vocab_), vocab_));
+            s.result.tokens.push_back(tok);
+            if (on_token_) on_token_(s.result.id, tok);
+            s.next_token = tok;
+            s.done = tok == s.eos_token || s.result.tokens.size() >= s.max_steps;
+        }
+        for (size_t i = b; i-- > 0;) {
+            if (slots_[i].done) evict(i, finished);
+        }
+        return b;
+    }
+
+    // Drain every submitted request.
+    void run_all(std::vector<BatchResult>& finished) {
+        while (!idle()) step(finished);
+    }
+
+private:
+    struct Slot {
+        BatchResult result;
+        int32_t next_token = 0;
+        int32_t eos_token = -1;
+        size_t max_steps = 0;
+        bool done = false;
+    };
+
+    Ort::Session& session_;
+    DecoderSignature sig_;
+    size_t max_batch_;
+    DecoderEmbedFn embed_;
+    BatchTokenFn on_token_;
+    Ort::MemoryInfo mem_info_;
+
+    size_t vocab_ = 0;
+    std::vector<int64_t> logits_row_shape_;
+    size_t enc_n_ = 0, state_n_ = 0, logits_n_ = 0;
+
+    HostArena arena_;               // one 64-byte aligned block for the buffers below
+    float* encoder_ = nullptr;
+    float* token_ = nullptr;
+    int64_t* token_ids_ = nullptr;  // instead of token_ without an embed function
+    float* state_[4] = {};          // in/out halves: {0,1} and {2,3}
+    float* logits_ = nullptr;
+    int cur_ = 0;                   // index of the current input half
+
+    std::vector<Slot> slots_;
+    size_t active_ = 0;
+    std::deque<BatchRequest> pending_;
+
+    // Tensors over the first b rows of every buffer, bound once per
+    // (batch size, state half) and reused by every later step of that
+    // size: outputs 1/2 write straight into the other half's state rows.
+    struct StepBinding {
+        std::vector<int64_t> shapes[7];
+        std::vector<Ort::Value> values;
+        std::unique_ptr<Ort::IoBinding> io;
+    };
+    std::vector<std::unique_ptr<StepBinding>> bindings_[2];     // [cur_ / 2][b - 1]
+    Ort::RunOptions run_options_{nullptr};
+
+    StepBinding& binding(size_t b, int in) {
+        auto& slot = bindings_[in / 2][b - 1];
+        if (slot) return *slot;
+
+        slot.reset(new StepBinding);
+        StepBinding& sb = *slot;
+        const int out = in ^ 2;
+        const int64_t rows = static_cast<int64_t>(b);
+        // leading dimension replaced by the batch size, logits with it prepended
+        for (int i = 0; i < 7; ++i) {
+            sb.shapes[i] = i == 0 ? sig_.encoder_shape : sig_.state_shape;
+            sb.shapes[i][0] = rows;
+        }
+        sb.shapes[4].assign(1, rows);
+        sb.shapes[4].insert(sb.shapes[4].end(), logits_row_shape_.begin(), logits_row_shape_.end());
+        if (!embed_) sb.shapes[1] = {rows, 1};
+        float* data[7] = {encoder_, token_, state_[in], state_[in + 1], logits_, state_[out], state_[out + 1]};
+        const size_t row_n[7] = {enc_n_, state_n_, state_n_, state_n_, logits_n_, state_n_, state_n_};
+        for (int i = 0; i < 7; ++i) {
+            if (i == 1 && !embed_) {
+                sb.values.emplace_back(Ort::Value::CreateTensor<int64_t>(
+                    mem_info_, token_ids_, b, sb.shapes[1].data(), sb.shapes[1].size()));
+                continue;
+            }
+            sb.values.emplace_back(Ort::Value::CreateTensor<float>(
+                mem_info_, data[i], b * row_n[i], sb.shapes[i].data(), sb.shapes[i].size()));
+        }
+
+        sb.io.reset(new Ort::IoBinding(session_));
+        sb.io->BindInput(sig_.encoder_name.c_str(), sb.values[0]);
+        sb.io->BindInput(sig_.token_name.c_str(), sb.values[1]);
+        sb.io->BindInput(sig_.state0_name.c_str(), sb.values[2]);
+        sb.io->BindInput(sig_.state1_name.c_str(), sb.values[3]);
+        sb.io->BindOutput(sig_.logits_name.c_str(), sb.values[4]);
+        sb.io->BindOutput(sig_.state0_out.c_str(), sb.values[5]);
+        sb.io->BindOutput(sig_.state1_out.c_str(), sb.values[6]);
+        return sb;
+    }
+
+    void admit() {
+        while (active_ < max_batch_ && !pending_.empty()) {
+            BatchRequest r = pending_.front();
+            pending_.pop_front();
+
+            size_t i = active_++;
+            Slot& s = slots_[i];
+            s.result.id = r.id;
+            s.result.tokens.clear();
+            s.result.tokens.reserve(r.max_steps);
+            s.next_token = r.first_token;
+            s.eos_token = r.eos_token;
+            s.max_steps = r.max_steps;
+            s.done = r.max_steps == 0;
+
+            float* enc = encoder_ + i * enc_n_;
+            if (r.encoder) std::memcpy(enc, r.encoder, enc_n_ * sizeof(float));
+            else std::memset(enc, 0, enc_n_ * sizeof(float));
+            std::memset(state_[cur_] + i * state_n_, 0, state_n_ * sizeof(float));
+            std::memset(state_[cur_ + 1] + i * state_n_, 0, state_n_ * sizeof(float));
+        }
+    }
+
+    void evict(size_t i, std::vector<BatchResult>& finished) {
+        finished.push_back(std::move(slots_[i].result));
+        size_t last = --active_;
+        if (i == last) return;
+
+        std::swap(slots_[i], slots_[last]);
+        std::memcpy(encoder_ + i * enc_n_, encoder_ + last * enc_n_, enc_n_ * sizeof(float));
+        for (int h = cur_; h < cur_ + 2; ++h) {
+            std::memcpy(state_[h] + i * state_n_, state_[h] + last * state_n_,
+                        state_n_ * sizeof(float));
+        }
+    }
+};
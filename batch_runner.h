@@ -0,0 +1,270 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "npy_mmap.h"
+#include "result_file.h"
+#include "runner_config.h"
+#include "session_cache.h"
+#include "tensor_view.h"
+
+// ============================================================
+// Offline batch runner
+//
+// Runs the decoder over many recorded input sets in one process:
+//   --dir d         every subdirectory of d holding input0..3.npy
+//   --manifest f    one sample per line: a sample directory, or
+//                   "name in0.npy in1.npy in2.npy in3.npy"
+//
+// Samples are split into one deque per worker; a worker takes from
+// the front of its own deque and, when it runs dry, steals from the
+// back of the others, so uneven sample sizes still finish together.
+// Each worker owns a session created once (shared Env) and maps the
+// next sample (madvise WILLNEED) before running the current one, so
+// the page-in overlaps the run. Every sample's outputs are appended
+// to one results file (result_file.h).
+// ============================================================
+
+struct BatchSample {
+    std::string name;
+    std::string inputs[4];
+};
+
+static inline bool batch_file_exists(const std::string& p) {
+    struct stat st;
+    return ::stat(p.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static inline BatchSample batch_sample_in(const std::string& dir, const std::string& name) {
+    BatchSample s;
+    s.name = name;
+    for (int i = 0; i < 4; ++i) s.inputs[i] = dir + "/input" + std::to_string(i) + ".npy";
+    return s;
+}
+
+static inline std::vector<BatchSample> batch_samples_from_dir(const std::string& dir) {
+    std::vector<BatchSample> out;
+    DIR* d = ::opendir(dir.c_str());
+    if (!d) throw std::runtime_error("Failed to open sample directory: " + dir);
+    while (struct dirent* de = ::readdir(d)) {
+        if (de->d_name[0] == '.') continue;
+        BatchSample s = batch_sample_in(dir + "/" + de->d_name, de->d_name);
+        if (batch_file_exists(s.inputs[0])) out.push_back(std::move(s));
+    }
+    ::closedir(d);
+    std::sort(out.begin(), out.end(), [](const BatchSample& a, const BatchSample& b) { return a.name < b.name; });
+    return out;
+}
+
+static inline std::vector<BatchSample> batch_samples_from_manifest(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) throw std::runtime_error("Failed to open manifest: " + path);
+    std::vector<BatchSample> out;
+    std::string line;
+    while (std::getline(f, line)) {
+        auto hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        std::istringstream in(line);
+        std::vector<std::string> cols;
+        for (std::string c; in >> c;) cols.push_back(c);
+        if (cols.empty()) continue;
+        if (cols.size() == 1) {
+            out.push_back(batch_sample_in(cols[0], cols[0]));
+        } else if (cols.size() == 5) {
+            BatchSample s;
+            s.name = cols[0];
+            for (int i = 0; i < 4; ++i) s.inputs[i] = cols[i + 1];
+            out.push_back(std::move(s));
+        } else {
+            throw std::runtime_error("manifest: expected a directory or name + 4 paths: " + line);
+        }
+    }
+    return out;
+}
+
+// Mapped inputs of one sample; Fortran-order files are gathered once.
+struct BatchLoaded {
+    const BatchSample* sample = nullptr;
+    NpyMapped npy[4];
+    std::vector<ContiguousTensor> reordered;
+    std::vector<TensorView> views;
+    double load_ms = 0;
+
+    void load(const BatchSample& s) {
+        auto t0 = std::chrono::steady_clock::now();
+        sample = &s;
+        reordered.clear();
+        reordered.reserve(4);
+        views.clear();
+        for (int i = 0; i < 4; ++i) {
+            npy[i] = NpyMapped(s.inputs[i]);
+            npy[i].advise_willneed();
+            TensorView v = npy[i].view();
+            if (!v.is_c_contiguous()) {
+                reordered.push_back(ContiguousTensor::from(v));
+                v = reordered.back().view;
+            }
+            views.push_back(v);
+        }
+        load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+};
+
+class WorkStealingQueue {
+public:
+    WorkStealingQueue(size_t items, size_t workers) : lanes_(workers) {
+        // contiguous runs per worker keep neighbouring samples together
+        for (size_t i = 0; i < items; ++i) lanes_[i * workers / items].items.push_back(i);
+    }
+
+    bool pop(size_t worker, size_t& item) {
+        {
+            Lane& own = lanes_[worker];
+            std::lock_guard<std::mutex> lock(own.mu);
+            if (!own.items.empty()) {
+                item = own.items.front();
+                own.items.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < lanes_.size(); ++k) {
+            Lane& other = lanes_[(worker + k) % lanes_.size()];
+            std::lock_guard<std::mutex> lock(other.mu);
+            if (!other.items.empty()) {
+                item = other.items.back();
+                other.items.pop_back();
+                ++steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::atomic<size_t> steals{0};
+
+private:
+    struct Lane {
+        std::mutex mu;
+        std::deque<size_t> items;
+    };
+    std::vector<Lane> lanes_;
+};
+
+struct BatchRunStats {
+    size_t done = 0, failed = 0, steals = 0;
+    double wall_ms = 0;
+};
+
+static inline BatchRunStats batch_run(Ort::Env& env, const RunnerConfig& cfg, const std::string& model,
+                                      const std::vector<BatchSample>& samples, size_t workers,
+                                      ResultWriter& results) {
+    static const char* input_names[] = {"input:0", "input:1", "input:2", "input:3"};
+    static const char* output_names[] = {"output:0", "output:1", "output:2"};
+
+    workers = std::max<size_t>(1, std::min(workers, samples.size()));
+    WorkStealingQueue queue(samples.size(), workers);
+    const uint64_t model_hash = result_model_hash(model);
+    std::atomic<size_t> done{0}, failed{0};
+    std::mutex log_mu;
+    auto t0 = std::chrono::steady_clock::now();
+
+    auto worker = [&](size_t w) {
+        std::unique_ptr<Ort::Session> session;
+        try {
+            Ort::SessionOptions so;
+            runner_config_apply(cfg, so);
+            session.reset(new Ort::Session(create_session_warm(env, model, std::move(so), cfg.opt_level,
+                                                               cfg.warm, "batch_worker")));
+        } catch (const std::exception& e) {
+            // the other workers steal this worker's samples
+            std::lock_guard<std::mutex> lock(log_mu);
+            std::cerr << "[batch] worker " << w << " has no session: " << e.what() << "\n";
+            return;
+        }
+        Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        std::vector<unsigned char> record;
+        std::vector<ResultTensor> tensors;
+
+        BatchLoaded cur, next;
+        size_t item;
+        bool have = queue.pop(w, item);
+        auto load = [&](BatchLoaded& into, size_t i) {
+            try {
+                into.load(samples[i]);
+                return true;
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(log_mu);
+                std::cerr << "[batch] " << samples[i].name << ": " << e.what() << "\n";
+                ++failed;
+                return false;
+            }
+        };
+        while (have && !load(cur, item)) have = queue.pop(w, item);
+
+        while (have) {
+            // map the next sample while this one runs
+            size_t next_item;
+            bool have_next = queue.pop(w, next_item);
+            while (have_next && !load(next, next_item)) have_next = queue.pop(w, next_item);
+
+            try {
+                Ort::Value inputs[4] = {
+                    cur.views[0].as_ort_value(mem), cur.views[1].as_ort_value(mem),
+                    cur.views[2].as_ort_value(mem), cur.views[3].as_ort_value(mem),
+                };
+                auto t_run = std::chrono::steady_clock::now();
+                auto outputs = session->Run(Ort::RunOptions{nullptr}, input_names, inputs, 4, output_names, 3);
+                ResultMeta meta;
+                meta.model_hash = model_hash;
+                meta.load_ms = cur.load_ms;
+                meta.run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_run).count();
+                tensors.resize(outputs.size());
+                for (size_t i = 0; i < outputs.size(); ++i) {
+                    auto info = outputs[i].GetTensorTypeAndShapeInfo();
+                    tensors[i].dtype = dtype_from_onnx(info.GetElementType());
+                    tensors[i].shape = info.GetShape();
+                    tensors[i].data = outputs[i].GetTensorRawData();
+                    tensors[i].bytes = info.GetElementCount() * dtype_size(tensors[i].dtype);
+                }
+                results.append(cur.sample->name, tensors, meta, record);
+                ++done;
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(log_mu);
+                std::cerr << "[batch] " << cur.sample->name << ": " << e.what() << "\n";
+                ++failed;
+            }
+
+            std::swap(cur, next);
+            have = have_next;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < workers; ++w) threads.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : threads) t.join();
+
+    BatchRunStats st;
+    st.done = done;
+    st.failed = samples.size() - st.done;     // includes samples no worker could take
+    st.steals = queue.steals;
+    st.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return st;
+}
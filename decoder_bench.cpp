@@ -0,0 +1,163 @@
+// g++ -std=c++17 -O2 decoder_bench.cpp -o decoder_bench -lonnxruntime
+//
+// Decoder benchmark: runs the original int64 decoder (same inputs as
+// nump.cpp) for warmup + measured iterations and reports p50/p90/p99
+// per stage, optionally as JSON for diffing between builds.
+//
+// Usage: decoder_bench [--model m.onnx] [--inputs dir] [--warmup 5] [--iters 50]
+//                      [--session-iters 3] [--json out.json] [runner options]
+//
+// With --profile prefix the measured session is profiled and its
+// per-op table printed (and diffed with --profile-baseline, see
+// ort_profile.h); the session-creation iterations are not profiled.
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "latency_stats.h"
+#include "logits_reduce.h"
+#include "npy_mmap.h"
+#include "ort_profile.h"
+#include "runner_config.h"
+
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    try {
+        auto opt = [&](const char* flag, const char* def) {
+            const char* v = arg_value(argc, argv, flag);
+            return std::string(v ? v : def);
+        };
+
+        const std::string model = opt("--model",
+            "./best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi.onnx");
+        std::string dir = opt("--inputs", ".");
+        if (!dir.empty() && dir.back() != '/') dir += "/";
+        const int warmup = std::stoi(opt("--warmup", "5"));
+        const int iters = std::stoi(opt("--iters", "50"));
+        const int session_iters = std::stoi(opt("--session-iters", "3"));
+        const std::string json_path = opt("--json", "");
+
+        RunnerConfig cfg = runner_config_from_args(argc, argv);
+        runner_config_print(cfg);
+
+        LatencyRecorder t_load("npy_load");
+        LatencyRecorder t_session("session_create");
+        LatencyRecorder t_bind("tensor_bind");
+        LatencyRecorder t_run("run");
+        LatencyRecorder t_reduce("output_reduce");
+        LatencyRecorder t_total("total_step");
+
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "decoder_bench");
+        runner_register_arena(env, cfg);
+
+        RunnerConfig create_cfg = cfg;
+        create_cfg.profile.clear();
+        auto make_options = [&](const RunnerConfig& c) {
+            Ort::SessionOptions so;
+            runner_config_apply(c, so);
+            so.SetGraphOptimizationLevel(cfg.opt_level);
+            return so;
+        };
+
+        // Session creation is slow; measured separately and fewer times.
+        for (int i = 0; i < session_iters; ++i) {
+            auto t0 = bench_clock::now();
+            Ort::Session s(env, model.c_str(), make_options(create_cfg));
+            t_session.add(ms_since(t0));
+        }
+        Ort::Session session(env, model.c_str(), make_options(cfg));
+
+        Ort::MemoryInfo mem_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+        const char* input_names[] = {"input:0", "input:1", "input:2", "input:3"};
+        const char* output_names[] = {"output:0", "output:1", "output:2"};
+
+        // --warmup plays the part of prerun here
+        const int pinned = runner_pin_thread(cfg);
+        if (pinned >= 0) std::cout << "[config] bench thread pinned to cpu " << pinned << "\n";
+        volatile size_t sink = 0;
+        for (int it = 0; it < warmup + iters; ++it) {
+            const bool measure = it >= warmup;
+            auto t_step = bench_clock::now();
+
+            auto t0 = bench_clock::now();
+            NpyMapped in0(dir + "input0.npy");
+            NpyMapped in1(dir + "input1.npy");
+            NpyMapped in2(dir + "input2.npy");
+            NpyMapped in3(dir + "input3.npy");
+            double load_ms = ms_since(t0);
+
+            t0 = bench_clock::now();
+            Ort::Value inputs[4] = {
+                in0.as_tensor<float>(mem_info),
+                in1.as_tensor<int64_t>(mem_info),
+                in2.as_tensor<float>(mem_info),
+                in3.as_tensor<float>(mem_info),
+            };
+            double bind_ms = ms_since(t0);
+
+            // outputs come from the session's allocator (the Env arena with shared_arena)
+            t0 = bench_clock::now();
+            auto outputs = session.Run(Ort::RunOptions{nullptr},
+                                       input_names, inputs, 4,
+                                       output_names, 3);
+            double run_ms = ms_since(t0);
+
+            t0 = bench_clock::now();
+            for (auto& o : outputs) {
+                auto info = o.GetTensorTypeAndShapeInfo();
+                if (info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) continue;
+                sink += logits_reduce(o.GetTensorData<float>(), info.GetElementCount()).argmax;
+            }
+            double reduce_ms = ms_since(t0);
+
+            if (measure) {
+                t_load.add(load_ms);
+                t_bind.add(bind_ms);
+                t_run.add(run_ms);
+                t_reduce.add(reduce_ms);
+                t_total.add(ms_since(t_step));
+            }
+        }
+        (void)sink;
+
+        const LatencyRecorder* stages[] = {&t_load, &t_session, &t_bind, &t_run, &t_reduce, &t_total};
+
+        std::cout << "Decoder benchmark (" << warmup << " warmup, " << iters << " measured)\n";
+        for (const auto* s : stages) s->print(std::cout);
+        runner_profile_report(session, cfg, "decoder_bench");
+
+        if (!json_path.empty()) {
+            std::ofstream js(json_path);
+            if (!js) throw std::runtime_error("Failed to write " + json_path);
+            js << "{\"model\":\"" << model << "\",\"warmup\":" << warmup << ",\"iters\":" << iters
+               << ",\"intra_op_threads\":" << cfg.intra_op_threads << ",\"stages\":{";
+            for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+                js << (i ? "," : "") << "\"" << stages[i]->name() << "\":";
+                stages[i]->to_json(js);
+            }
+            js << "}}\n";
+            std::cout << "Wrote " << json_path << "\n";
+        }
+        return 0;
+    }
+    catch (const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << "\n";
+        return 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
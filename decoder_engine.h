@@ -0,0 +1,303 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "host_arena.h"
+#include "logits_reduce.h"
+
+// ============================================================
+// Autoregressive decode loop engine
+//
+// Runs the decoder step by step with everything bound up front:
+//   input:0                     encoder features, bound once per request
+//   input:1 | embedded_token    int64 token id or host-side embedding
+//   input:2 / input:3           recurrent state, fed from output:1/2
+//   output:0                    logits, argmax becomes the next token
+//
+// State lives in two preallocated buffer pairs (A and B). Two
+// Ort::IoBinding objects are prepared at construction: binding 0
+// reads A and writes B, binding 1 reads B and writes A. A step only
+// fills the token slot and runs the binding for the current parity,
+// so nothing is allocated, created or re-bound per token. All host
+// buffers come from one HostArena block, 64-byte aligned.
+// ============================================================
+
+enum class DecoderTokenInput {
+    TokenId,        // original model: int64 input:1 [1,1]
+    Embedding       // gather-replaced model: float embedded_token [1,1,H]
+};
+
+struct DecoderSignature {
+    std::vector<int64_t> encoder_shape = {1, 352, 2, 8};
+    std::vector<int64_t> state_shape   = {1, 1, 256};
+    std::vector<int64_t> logits_shape;  // empty: taken from the session
+
+    std::string encoder_name = "input:0";
+    std::string token_name   = "input:1";
+    std::string state0_name  = "input:2";
+    std::string state1_name  = "input:3";
+    std::string logits_name  = "output:0";
+    std::string state0_out   = "output:1";
+    std::string state1_out   = "output:2";
+};
+
+// Closed-set answer (e.g. "Answer Yes or No"). Only the listed ids are
+// considered, with every spelling variant of an answer in its list.
+// Decoding stops at the first decisive step: the first one where the
+// answer ids hold at least `decisive` of the full softmax mass (0: the
+// first step, whatever it holds). Until then the argmax is fed back, so
+// a preamble token such as a leading space costs one step, not a full
+// decode. The probability is a softmax over the answer ids only, at
+// `temperature` (fitted offline to calibrate it).
+struct DecoderChoice {
+    std::vector<int32_t> yes_ids;
+    std::vector<int32_t> no_ids;
+    float temperature = 1.0f;
+    float decisive = 0.0f;
+    size_t max_steps = 4;           // answer read at the last step regardless
+};
+
+struct DecoderVerdict {
+    bool yes = false;
+    float p_yes = 0.0f;             // calibrated P(yes | answer set)
+    float answer_mass = 0.0f;       // share of the full softmax on the answer ids
+    size_t steps = 0;
+    int32_t token = -1;             // best answer id at the deciding step
+};
+
+// Writes the embedding row for token into dst (state width floats).
+using DecoderEmbedFn = std::function<void(int32_t token, float* dst)>;
+
+// Optional: called with the argmax as soon as a step has produced it,
+// so the row the next step embeds can be fetched while the caller is
+// still looking at the logits (EmbeddingTable::prefetch).
+using DecoderPrefetchFn = std::function<void(int32_t token)>;
+
+static inline size_t decoder_shape_elems(const std::vector<int64_t>& shape) {
+    size_t n = 1;
+    for (int64_t d : shape) n *= static_cast<size_t>(d > 0 ? d : 1);
+    return n;
+}
+
+class DecoderEngine {
+public:
+    DecoderEngine(Ort::Session& session,
+                  const DecoderSignature& sig,
+                  DecoderTokenInput token_mode,
+                  DecoderEmbedFn embed = nullptr)
+        : session_(session),
+          sig_(sig),
+          token_mode_(token_mode),
+          embed_(std::move(embed)),
+          mem_info_(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)) {
+        if (token_mode_ == DecoderTokenInput::Embedding && !embed_) {
+            throw std::runtime_error("DecoderEngine: embedding mode needs an embed function");
+        }
+
+        if (sig_.logits_shape.empty()) {
+            sig_.logits_shape = session_.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        }
+        for (auto& d : sig_.logits_shape) {
+            if (d <= 0) d = 1;
+        }
+
+        token_shape_ = (token_mode_ == DecoderTokenInput::TokenId)
+            ? std::vector<int64_t>{1, 1}
+            : sig_.state_shape;
+
+        encoder_n_ = decoder_shape_elems(sig_.encoder_shape);
+        logits_n_ = decoder_shape_elems(sig_.logits_shape);
+        state_n_ = decoder_shape_elems(sig_.state_shape);
+        token_n_ = token_mode_ == DecoderTokenInput::Embedding ? state_n_ : 0;
+        const size_t a = HostArena::kAlign;
+        arena_.reserve(((encoder_n_ + logits_n_ + token_n_ + 4 * state_n_) * sizeof(float) / a + 7) * a);
+        encoder_ = arena_.alloc_zeroed<float>(encoder_n_);
+        logits_ = arena_.alloc_zeroed<float>(logits_n_);
+        token_emb_ = arena_.alloc_zeroed<float>(token_n_);
+        for (auto& s : state_) s = arena_.alloc_zeroed<float>(state_n_);
+
+        encoder_data_ = encoder_;
+        build_bindings();
+    }
+
+    DecoderEngine(const DecoderEngine&) = delete;
+    DecoderEngine& operator=(const DecoderEngine&) = delete;
+
+    // Internal encoder buffer; write features here before run()/step().
+    float* encoder_buffer() { return encoder_; }
+    size_t encoder_size() const { return encoder_n_; }
+
+    // Bind caller-owned encoder features (e.g. an NpyMapped view)
+    // instead of copying them. Done once per request, not per step.
+    void bind_encoder(float* data) {
+        encoder_data_ = data ? data : encoder_;
+        encoder_value_ = make_tensor(encoder_data_, encoder_n_, sig_.encoder_shape);
+        for (auto& b : bindings_) b->BindInput(sig_.encoder_name.c_str(), encoder_value_);
+    }
+
+    // Reset recurrent state to zeros, or to the given [1,1,H] buffers.
+    void reset_state(const float* s0 = nullptr, const float* s1 = nullptr) {
+        size_t bytes = state_n_ * sizeof(float);
+        if (s0) std::memcpy(state_[0], s0, bytes); else std::memset(state_[0], 0, bytes);
+        if (s1) std::memcpy(state_[1], s1, bytes); else std::memset(state_[1], 0, bytes);
+        parity_ = 0;
+    }
+
+    void set_prefetch(DecoderPrefetchFn fn) { prefetch_ = std::move(fn); }
+
+    // One decoder step on token; returns argmax of output:0.
+    int32_t step(int32_t token) {
+        if (token_mode_ == DecoderTokenInput::TokenId) {
+            token_id_[0] = token;
+        } else {
+            embed_(token, token_emb_);
+        }
+
+        session_.Run(run_options_, *bindings_[parity_]);
+        parity_ ^= 1;
+        int32_t next = static_cast<int32_t>(logits_argmax(logits_, vocab()));
+        if (prefetch_) prefetch_(next);
+        return next;
+    }
+
+    // Greedy decode from first_token. Writes up to max_steps tokens
+    // into out_tokens and stops early when eos_token is produced.
+    size_t run(int32_t first_token, size_t max_steps, int32_t* out_tokens, int32_t eos_token = -1) {
+        int32_t tok = first_token;
+        size_t n = 0;
+        while (n < max_steps) {
+            tok = step(tok);
+            out_tokens[n++] = tok;
+            if (tok == eos_token) break;
+        }
+        return n;
+    }
+
+    // Constrained decode from first_token; see DecoderChoice.
+    DecoderVerdict classify(int32_t first_token, const DecoderChoice& c) {
+        const size_t v = vocab();
+        for (int32_t id : c.yes_ids) check_id(id, v);
+        for (int32_t id : c.no_ids) check_id(id, v);
+        if (c.yes_ids.empty() || c.no_ids.empty()) {
+            throw std::runtime_error("DecoderEngine: classify needs yes and no ids");
+        }
+
+        DecoderVerdict r;
+        int32_t tok = first_token;
+        const size_t max_steps = c.max_steps ? c.max_steps : 1;
+        while (r.steps < max_steps) {
+            tok = step(tok);
+            ++r.steps;
+            const float* l = logits_;
+
+            // answer-set share of the full distribution, only when it decides anything
+            if (c.decisive > 0.0f && r.steps < max_steps) {
+                float mx = l[tok];
+                double all = 0.0, ans = 0.0;
+                for (size_t i = 0; i < v; ++i) all += std::exp(static_cast<double>(l[i] - mx));
+                for (int32_t id : c.yes_ids) ans += std::exp(static_cast<double>(l[id] - mx));
+                for (int32_t id : c.no_ids) ans += std::exp(static_cast<double>(l[id] - mx));
+                r.answer_mass = static_cast<float>(ans / all);
+                if (r.answer_mass < c.decisive) continue;
+            }
+            break;
+        }
+
+        const float* l = logits_;
+        const float t = c.temperature > 0.0f ? c.temperature : 1.0f;
+        float mx = l[c.yes_ids[0]];
+        r.token = c.yes_ids[0];
+        for (int32_t id : c.yes_ids) if (l[id] > mx) { mx = l[id]; r.token = id; }
+        for (int32_t id : c.no_ids) if (l[id] > mx) { mx = l[id]; r.token = id; }
+        double py = 0.0, pn = 0.0;
+        for (int32_t id : c.yes_ids) py += std::exp(static_cast<double>((l[id] - mx) / t));
+        for (int32_t id : c.no_ids) pn += std::exp(static_cast<double>((l[id] - mx) / t));
+        r.p_yes = static_cast<float>(py / (py + pn));
+        r.yes = r.p_yes > 0.5f;
+        return r;
+    }
+
+    const float* logits() const { return logits_; }
+    size_t vocab() const {
+        return static_cast<size_t>(sig_.logits_shape.empty() ? logits_n_ : sig_.logits_shape.back());
+    }
+    const std::vector<int64_t>& logits_shape() const { return sig_.logits_shape; }
+
+    // Current recurrent state (what the next step will read).
+    const float* state0() const { return state_[parity_ == 0 ? 0 : 2]; }
+    const float* state1() const { return state_[parity_ == 0 ? 1 : 3]; }
+
+private:
+    Ort::Session& session_;
+    DecoderSignature sig_;
+    DecoderTokenInput token_mode_;
+    DecoderEmbedFn embed_;
+    DecoderPrefetchFn prefetch_;
+    Ort::MemoryInfo mem_info_;
+    Ort::RunOptions run_options_{nullptr};
+
+    std::vector<int64_t> token_shape_;
+    HostArena arena_;
+    size_t encoder_n_ = 0, logits_n_ = 0, state_n_ = 0, token_n_ = 0;
+    float* encoder_ = nullptr;
+    float* encoder_data_ = nullptr;
+    float* logits_ = nullptr;
+    float* token_emb_ = nullptr;
+    int64_t token_id_[1] = {0};
+    float* state_[4] = {};          // A = {0,1}, B = {2,3}
+    int parity_ = 0;
+
+    Ort::Value encoder_value_{nullptr};
+    Ort::Value token_value_{nullptr};
+    Ort::Value logits_value_{nullptr};
+    std::vector<Ort::Value> state_value_;
+    std::unique_ptr<Ort::IoBinding> bindings_[2];
+
+    static void check_id(int32_t id, size_t vocab) {
+        if (id < 0 || static_cast<size_t>(id) >= vocab) {
+            throw std::runtime_error("DecoderEngine: answer id " + std::to_string(id) + " outside the vocabulary");
+        }
+    }
+
+    Ort::Value make_tensor(float* p, size_t n, const std::vector<int64_t>& shape) {
+        return Ort::Value::CreateTensor<float>(mem_info_, p, n, shape.data(), shape.size());
+    }
+
+    void build_bindings() {
+        encoder_value_ = make_tensor(encoder_data_, encoder_n_, sig_.encoder_shape);
+        logits_value_ = make_tensor(logits_, logits_n_, sig_.logits_shape);
+        if (token_mode_ == DecoderTokenInput::TokenId) {
+            token_value_ = Ort::Value::CreateTensor<int64_t>(
+                mem_info_, token_id_, 1, token_shape_.data(), token_shape_.size());
+        } else {
+            token_value_ = make_tensor(token_emb_, token_n_, token_shape_);
+        }
+        state_value_.clear();
+        for (int i = 0; i < 4; ++i) {
+            state_value_.emplace_back(make_tensor(state_[i], state_n_, sig_.state_shape));
+        }
+
+        for (int p = 0; p < 2; ++p) {
+            int in = p == 0 ? 0 : 2;
+            int out = p == 0 ? 2 : 0;
+            bindings_[p].reset(new Ort::IoBinding(session_));
+            auto& b = *bindings_[p];
+            b.BindInput(sig_.encoder_name.c_str(), encoder_value_);
+            b.BindInput(sig_.token_name.c_str(), token_value_);
+            b.BindInput(sig_.state0_name.c_str(), state_value_[in]);
+            b.BindInput(sig_.state1_name.c_str(), state_value_[in + 1]);
+            b.BindOutput(sig_.logits_name.c_str(), logits_value_);
+            b.BindOutput(sig_.state0_out.c_str(), state_value_[out]);
+            b.BindOutput(sig_.state1_out.c_str(), state_value_[out + 1]);
+        }
+    }
+};
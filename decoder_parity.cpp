@@ -0,0 +1,185 @@
+// g++ -std=c++17 -O2 decoder_parity.cpp -o decoder_parity -lonnxruntime
+//
+// Numerical parity between the original decoder (Gather_11 inside the
+// graph, int64 input:1) and the gather-replaced decoder fed by the
+// host-side embedding lookup. Both run on the same input0/2/3.npy for
+// many token ids; per-token errors are streamed as CSV and both
+// variants are timed side by side.
+//
+// Usage: decoder_parity [--orig m.onnx] [--replaced m_gather_replaced.onnx]
+//                       [--emb table.npy|table.embq] [--inputs dir]
+//                       [--tokens N] [--stride S] [--tol 1e-4] [runner options]
+//
+// With --profile prefix both sessions are profiled and the replaced
+// model's per-op costs are diffed against the original's.
+//
+// Exit code 3 when any max-abs error exceeds --tol.
+
+#include <onnxruntime_cxx_api.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "decoder_engine.h"
+#include "decoder_spec.h"
+#include "embedding_table.h"
+#include "latency_stats.h"
+#include "npy_mmap.h"
+#include "ort_profile.h"
+#include "runner_config.h"
+#include "session_pool.h"
+
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+struct ParityError {
+    double max_abs = 0.0;
+    double max_rel = 0.0;
+
+    void update(const float* a, const float* b, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            double d = std::fabs(static_cast<double>(a[i]) - b[i]);
+            double r = d / std::max(1e-12, std::fabs(static_cast<double>(a[i])));
+            max_abs = std::max(max_abs, d);
+            max_rel = std::max(max_rel, r);
+        }
+    }
+    void merge(const ParityError& o) {
+        max_abs = std::max(max_abs, o.max_abs);
+        max_rel = std::max(max_rel, o.max_rel);
+    }
+};
+
+int main(int argc, char** argv) {
+    try {
+        auto opt = [&](const char* flag, const char* def) {
+            const char* v = arg_value(argc, argv, flag);
+            return std::string(v ? v : def);
+        };
+
+        const std::string orig_model = opt("--orig",
+            "./best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi.onnx");
+        const std::string repl_model = opt("--replaced",
+            "./best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi_gather_replaced.onnx");
+        const std::string emb_path = opt("--emb", "decoder_emb_weight (1).npy");
+        std::string dir = opt("--inputs", ".");
+        if (!dir.empty() && dir.back() != '/') dir += "/";
+        const double tol = std::stod(opt("--tol", "1e-4"));
+        const size_t stride = std::max<size_t>(1, std::stoul(opt("--stride", "1")));
+
+        NpyMapped in0(dir + "input0.npy");
+        NpyMapped in2(dir + "input2.npy");
+        NpyMapped in3(dir + "input3.npy");
+        EmbeddingTable emb = EmbeddingTable::load(emb_path);
+        DefaultDecoderSpec::check_table(emb);
+
+        const size_t n_tokens = std::min(emb.rows(), static_cast<size_t>(
+            std::stoul(opt("--tokens", std::to_string(emb.rows()).c_str()))));
+
+        RunnerConfig cfg = runner_config_from_args(argc, argv);
+        runner_config_print(cfg);
+
+        // both decoders share one Env and its global thread pools
+        SessionPool pool(cfg, "decoder_parity");
+        pool.add("orig", PoolModel{orig_model, cfg, 1});
+        pool.add("replaced", PoolModel{repl_model, cfg, 1});
+        SessionPool::Lease orig_lease = pool.acquire("orig");
+        SessionPool::Lease repl_lease = pool.acquire("replaced");
+        Ort::Session& s_orig = orig_lease.session();
+        Ort::Session& s_repl = repl_lease.session();
+
+        DecoderSignature sig_orig = DefaultDecoderSpec::signature(DecoderTokenInput::TokenId);
+        DecoderSignature sig_repl = DefaultDecoderSpec::signature(DecoderTokenInput::Embedding);
+        DefaultDecoderSpec::check(s_orig, sig_orig, DecoderTokenInput::TokenId);
+        DefaultDecoderSpec::check(s_repl, sig_repl, DecoderTokenInput::Embedding);
+
+        DecoderEngine orig(s_orig, sig_orig, DecoderTokenInput::TokenId);
+        DecoderEngine repl(s_repl, sig_repl, DecoderTokenInput::Embedding,
+                           DefaultDecoderSpec::embed_fn(emb));
+        if (orig.vocab() != repl.vocab()) {
+            throw std::runtime_error("Logits width differs between the two models");
+        }
+
+        orig.bind_encoder(in0.data<float>());
+        repl.bind_encoder(in0.data<float>());
+        const float* s2 = in2.data<float>();
+        const float* s3 = in3.data<float>();
+        const size_t state_n = DefaultDecoderSpec::kStateElems;
+        if (static_cast<size_t>(in0.element_count()) != DefaultDecoderSpec::kEncoderElems ||
+            static_cast<size_t>(in2.element_count()) != state_n ||
+            static_cast<size_t>(in3.element_count()) != state_n) {
+            throw std::runtime_error("input0/2/3.npy shapes do not match the decoder signature");
+        }
+
+        LatencyRecorder t_orig("orig_run");
+        LatencyRecorder t_repl("replaced_run");
+        ParityError total[3];
+        size_t argmax_mismatch = 0;
+        size_t checked = 0;
+
+        std::cout << "token,logits_abs,logits_rel,state1_abs,state2_abs,argmax_orig,argmax_repl\n";
+        for (size_t tok = 0; tok < n_tokens; tok += stride) {
+            orig.reset_state(s2, s3);
+            repl.reset_state(s2, s3);
+
+            auto t0 = bench_clock::now();
+            int32_t a = orig.step(static_cast<int32_t>(tok));
+            t_orig.add(ms_since(t0));
+
+            t0 = bench_clock::now();
+            int32_t b = repl.step(static_cast<int32_t>(tok));
+            t_repl.add(ms_since(t0));
+
+            ParityError e[3];
+            e[0].update(orig.logits(), repl.logits(), orig.vocab());
+            e[1].update(orig.state0(), repl.state0(), state_n);
+            e[2].update(orig.state1(), repl.state1(), state_n);
+            for (int k = 0; k < 3; ++k) total[k].merge(e[k]);
+            if (a != b) ++argmax_mismatch;
+            ++checked;
+
+            std::cout << tok << "," << e[0].max_abs << "," << e[0].max_rel << ","
+                      << e[1].max_abs << "," << e[2].max_abs << "," << a << "," << b << "\n";
+        }
+
+        std::cout << "\nParity over " << checked << " token ids:\n";
+        const char* names[] = {"output:0", "output:1", "output:2"};
+        bool ok = true;
+        for (int k = 0; k < 3; ++k) {
+            std::cout << "  " << names[k] << " max_abs=" << total[k].max_abs
+                      << " max_rel=" << total[k].max_rel << "\n";
+            ok = ok && total[k].max_abs <= tol;
+        }
+        std::cout << "  argmax mismatches: " << argmax_mismatch << "\n";
+        t_orig.print(std::cout);
+        t_repl.print(std::cout);
+
+        // per-op view of the surgery: replaced against original
+        if (!cfg.profile.empty()) {
+            RunnerConfig orig_cfg = cfg;
+            orig_cfg.profile_baseline.clear();
+            ProfileReport p_orig = runner_profile_report(s_orig, orig_cfg, "orig");
+            ProfileReport p_repl = runner_profile_report(s_repl, cfg, "replaced");
+            profile_diff(p_orig, p_repl, "replaced (orig as baseline)", static_cast<size_t>(cfg.profile_top));
+        }
+        std::cout << (ok ? "PARITY OK" : "PARITY FAILED") << " (tol " << tol << ")\n";
+        return ok ? 0 : 3;
+    }
+    catch (const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << "\n";
+        return 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
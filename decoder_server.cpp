@@ -0,0 +1,502 @@
+// gcc -O2 -c st_json_path.c
+// g++ -std=c++17 -O2 decoder_server.cpp st_json_path.o -o decoder_server -lonnxruntime -lpthread
+//
+// Long-lived decoder daemon. Loads the gather-replaced decoder and the
+// embedding table once, then serves decode requests over HTTP on a
+// Unix socket (default) or a loopback TCP port.
+//
+//   POST /decode   {"reqid": "...", "purpose": "decode", "token": 1,
+//                   "max_steps": 16, "eos": 2, "features": "input0.npy"}
+//   GET  /health
+//
+// "features" is an optional path to the [1,352,2,8] float encoder
+// output (zeros when absent); the client and the daemon share the host,
+// so the file is mapped rather than shipped in the body. The reply is
+// chunked NDJSON, one line per token as it is decoded:
+//   {"reqid":"...","i":0,"token":42}
+//   {"reqid":"...","done":true,"tokens":7}
+//
+// Requests are queued for one BatchDecoder (continuous batching; the
+// model needs a dynamic batch dimension). When the decoder is idle the
+// first request waits up to --max-wait-ms for others so they start in
+// one batch; while it is busy, new requests join at the next step.
+//
+// Usage: decoder_server [--model m.onnx] [--emb table.npy|table.embq]
+//                       [--socket /tmp/decoder.sock | --port 8090]
+//                       [--max-batch 8] [--max-wait-ms 5] [--queue 256]
+//                       [runner options, see runner_config.h]
+
+#include <onnxruntime_cxx_api.h>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_decoder.h"
+#include "decoder_spec.h"
+#include "embedding_table.h"
+#include "npy_mmap.h"
+#include "runner_config.h"
+#include "st_json_path.h"
+
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+static std::atomic<bool> g_stop{false};
+
+static void on_signal(int) { g_stop = true; }
+
+// ============================================================
+// One request from parse to the final chunk. The scheduler thread
+// appends tokens; the connection thread drains and writes them.
+// ============================================================
+
+struct Stream {
+    std::string reqid;
+    BatchRequest req;
+    NpyMapped features;             // mapped until the sequence finishes
+    bool has_features = false;
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<int32_t> tokens;
+    bool done = false;
+    std::string error;
+};
+
+class Scheduler {
+public:
+    // Under the latency profile the scheduler thread, which makes every
+    // Run(), is pinned and decodes runner_prerun() throwaway steps first.
+    Scheduler(Ort::Session& session, const DecoderSignature& sig, size_t max_batch,
+              DecoderEmbedFn embed, std::chrono::milliseconds max_wait, size_t max_queue,
+              const RunnerConfig& tuning)
+        : session_(session), sig_(sig), max_batch_(max_batch), embed_(std::move(embed)),
+          max_wait_(max_wait), max_queue_(max_queue) {
+        reset_batch();
+        thread_ = std::thread([this, tuning] {
+            warm_up(tuning);
+            loop();
+        });
+    }
+
+    ~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    // False when the queue is full.
+    bool submit(const std::shared_ptr<Stream>& s) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (incoming_.size() >= max_queue_) return false;
+            incoming_.push_back(s);
+        }
+        cv_.notify_all();
+        return true;
+    }
+
+    std::string health() {
+        std::lock_guard<std::mutex> lock(mu_);
+        return "{\"queued\":" + std::to_string(incoming_.size()) +
+               ",\"active\":" + std::to_string(active_) +
+               ",\"served\":" + std::to_string(served_) +
+               ",\"runs\":" + std::to_string(runs_) + "}\n";
+    }
+
+private:
+    Ort::Session& session_;
+    DecoderSignature sig_;
+    size_t max_batch_;
+    DecoderEmbedFn embed_;
+    std::chrono::milliseconds max_wait_;
+    size_t max_queue_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Stream>> incoming_;
+    bool stop_ = false;
+    size_t active_ = 0, served_ = 0, runs_ = 0;     // under mu_, for /health
+
+    // scheduler thread only
+    std::unique_ptr<BatchDecoder> batch_;
+    std::map<int64_t, std::shared_ptr<Stream>> live_;
+    int64_t next_id_ = 0;
+    std::thread thread_;
+
+    void reset_batch() {
+        batch_.reset(new BatchDecoder(session_, sig_, max_batch_, embed_));
+        batch_->set_on_token([this](int64_t id, int32_t tok) {
+            auto it = live_.find(id);
+            if (it == live_.end()) return;
+            Stream& s = *it->second;
+            {
+                std::lock_guard<std::mutex> lock(s.mu);
+                s.tokens.push_back(tok);
+            }
+            s.cv.notify_one();
+        });
+    }
+
+    void warm_up(const RunnerConfig& tuning) {
+        int cpu = runner_pin_thread(tuning);
+        if (cpu >= 0) std::cout << "[server] decode thread pinned to cpu " << cpu << "\n";
+        std::vector<BatchResult> done;
+        try {
+            for (int i = 0; i < runner_prerun(tuning); ++i) {
+                BatchRequest r;
+                r.id = -1 - i;          // not in live_: its token goes nowhere
+                r.max_steps = 1;
+                batch_->submit(r);
+                while (!batch_->idle()) batch_->step(done);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "[server] prerun failed: " << e.what() << "\n";
+            reset_batch();
+        }
+    }
+
+    static void finish(Stream& s, const std::string& error) {
+        {
+            std::lock_guard<std::mutex> lock(s.mu);
+            s.done = true;
+            s.error = error;
+        }
+        s.cv.notify_one();
+    }
+
+    void loop() {
+        std::vector<BatchResult> done;
+        for (;;) {
+            std::vector<std::shared_ptr<Stream>> admit;
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                cv_.wait(lock, [this] { return stop_ || !incoming_.empty() || !batch_->idle(); });
+                if (stop_) break;
+                if (batch_->idle()) {
+                    // idle: give the first request's neighbours a moment to arrive
+                    cv_.wait_for(lock, max_wait_, [this] { return stop_ || incoming_.size() >= max_batch_; });
+                    if (stop_) break;
+                }
+                admit.assign(incoming_.begin(), incoming_.end());
+                incoming_.clear();
+            }
+
+            for (auto& s : admit) {
+                s->req.id = next_id_++;
+                s->req.encoder = s->has_features ? s->features.data<float>() : nullptr;
+                live_[s->req.id] = s;
+                batch_->submit(s->req);
+            }
+
+            try {
+                done.clear();
+                size_t b = batch_->step(done);
+                std::lock_guard<std::mutex> lock(mu_);
+                active_ = batch_->active();
+                served_ += done.size();
+                runs_ += b ? 1 : 0;
+            } catch (const std::exception& e) {
+                std::cerr << "[server] batch step failed: " << e.what() << "\n";
+                for (auto& kv : live_) finish(*kv.second, e.what());
+                live_.clear();
+                reset_batch();
+                continue;
+            }
+            for (const auto& r : done) {
+                auto it = live_.find(r.id);
+                if (it == live_.end()) continue;
+                finish(*it->second, "");
+                live_.erase(it);
+            }
+        }
+        for (auto& kv : live_) finish(*kv.second, "server shutting down");
+        std::lock_guard<std::mutex> lock(mu_);
+        for (auto& s : incoming_) finish(*s, "server shutting down");
+    }
+};
+
+// ============================================================
+// HTTP
+// ============================================================
+
+static bool write_all(int fd, const char* p, size_t n) {
+    while (n) {
+        ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+static bool write_chunk(int fd, const std::string& s) {
+    char len[16];
+    int n = std::snprintf(len, sizeof(len), "%zx\r\n", s.size());
+    return write_all(fd, len, static_cast<size_t>(n)) && write_all(fd, s.data(), s.size()) &&
+           write_all(fd, "\r\n", 2);
+}
+
+static void reply(int fd, const char* status, const std::string& body) {
+    std::string r = std::string("HTTP/1.1 ") + status +
+                    "\r\nContent-Type: application/json\r\nConnection: close\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\n\r\n" + body;
+    write_all(fd, r.data(), r.size());
+}
+
+// reqid is echoed inside JSON strings; keep it to safe characters
+static std::string json_safe(const char* s) {
+    std::string out;
+    for (; *s && out.size() < 64; ++s) {
+        if (*s >= 0x20 && *s != '"' && *s != '\\') out += *s;
+    }
+    return out;
+}
+
+// Reads headers and a Content-Length body (bounded). False on a bad request.
+static bool read_request(int fd, std::string& method, std::string& path, std::string& body) {
+    std::string buf;
+    char tmp[4096];
+    size_t head_end;
+    while ((head_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        if (buf.size() > 16384) return false;
+        ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) return false;
+        buf.append(tmp, static_cast<size_t>(r));
+    }
+    size_t sp1 = buf.find(' '), sp2 = sp1 == std::string::npos ? sp1 : buf.find(' ', sp1 + 1);
+    if (sp2 == std::string::npos || sp2 > head_end) return false;
+    method = buf.substr(0, sp1);
+    path = buf.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    size_t content_length = 0;
+    for (size_t p = buf.find("\r\n"); p < head_end; p = buf.find("\r\n", p + 2)) {
+        const char* line = buf.c_str() + p + 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) content_length = std::strtoul(line + 15, nullptr, 10);
+    }
+    if (content_length > 65536) return false;
+    body = buf.substr(head_end + 4);
+    while (body.size() < content_length) {
+        ssize_t r = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) return false;
+        body.append(tmp, static_cast<size_t>(r));
+    }
+    body.resize(content_length);
+    return true;
+}
+
+static void serve(int fd, Scheduler& sched, size_t enc_n) {
+    std::string method, path, body;
+    if (!read_request(fd, method, path, body)) {
+        reply(fd, "400 Bad Request", "{\"error\":\"bad request\"}\n");
+        return;
+    }
+    if (method == "GET" && path == "/health") {
+        reply(fd, "200 OK", sched.health());
+        return;
+    }
+    if (method != "POST" || path != "/decode") {
+        reply(fd, "404 Not Found", "{\"error\":\"not found\"}\n");
+        return;
+    }
+
+    char reqid[128] = "", purpose[32] = "", token[24] = "", steps[24] = "", eos[24] = "", features[1024] = "";
+    st_json_target_t t[] = {
+        {"reqid", reqid, sizeof(reqid), false},
+        {"purpose", purpose, sizeof(purpose), false},
+        {"token", token, sizeof(token), false},
+        {"max_steps", steps, sizeof(steps), false},
+        {"eos", eos, sizeof(eos), false},
+        {"features", features, sizeof(features), false},
+    };
+    st_json_extract(body.data(), body.size(), t, sizeof(t) / sizeof(t[0]));
+    if (!t[2].found || (t[1].found && std::strcmp(purpose, "decode") != 0)) {
+        reply(fd, "400 Bad Request", "{\"error\":\"expected purpose decode and a token\"}\n");
+        return;
+    }
+
+    auto s = std::make_shared<Stream>();
+    s->reqid = json_safe(reqid);
+    s->req.first_token = static_cast<int32_t>(std::strtol(token, nullptr, 10));
+    s->req.max_steps = t[3].found ? std::strtoul(steps, nullptr, 10) : 16;
+    s->req.eos_token = t[4].found ? static_cast<int32_t>(std::strtol(eos, nullptr, 10)) : -1;
+    if (t[5].found && features[0]) {
+        try {
+            s->features = NpyMapped(features);
+            s->has_features = true;
+            if (s->features.dtype != DType::F32 ||
+                static_cast<size_t>(npy_num_elements(s->features.shape)) != enc_n)
+                throw std::runtime_error("features must be float32 with " + std::to_string(enc_n) + " elements");
+        } catch (const std::exception& e) {
+            reply(fd, "400 Bad Request", "{\"error\":\"" + json_safe(e.what()) + "\"}\n");
+            return;
+        }
+    }
+    if (!sched.submit(s)) {
+        reply(fd, "503 Service Unavailable", "{\"error\":\"queue full\"}\n");
+        return;
+    }
+
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\n"
+                               "Transfer-Encoding: chunked\r\nConnection: close\r\n\r\n";
+    bool open = write_all(fd, head, sizeof(head) - 1);
+    size_t i = 0;
+    std::unique_lock<std::mutex> lock(s->mu);
+    for (;;) {
+        s->cv.wait(lock, [&s] { return !s->tokens.empty() || s->done; });
+        std::deque<int32_t> batch;
+        batch.swap(s->tokens);
+        const bool done = s->done;
+        const std::string error = s->error;
+        lock.unlock();
+        std::string lines;
+        for (int32_t tok : batch) {
+            lines += "{\"reqid\":\"" + s->reqid + "\",\"i\":" + std::to_string(i++) +
+                     ",\"token\":" + std::to_string(tok) + "}\n";
+        }
+        if (done) {
+            lines += error.empty()
+                ? "{\"reqid\":\"" + s->reqid + "\",\"done\":true,\"tokens\":" + std::to_string(i) + "}\n"
+                : "{\"reqid\":\"" + s->reqid + "\",\"error\":\"" + json_safe(error.c_str()) + "\"}\n";
+        }
+        // a client that hung up still decodes to the end; its tokens are dropped
+        if (open && !lines.empty()) open = write_chunk(fd, lines);
+        if (done) break;
+        lock.lock();
+    }
+    if (open) write_all(fd, "0\r\n\r\n", 5);
+}
+
+static int listen_on(const std::string& socket_path, int port) {
+    int fd;
+    if (port > 0) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = htons(static_cast<uint16_t>(port));
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0)
+            throw std::runtime_error("cannot bind 127.0.0.1:" + std::to_string(port));
+    } else {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un a{};
+        a.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(a.sun_path)) throw std::runtime_error("socket path too long");
+        std::memcpy(a.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        ::unlink(socket_path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) != 0)
+            throw std::runtime_error("cannot bind " + socket_path);
+    }
+    if (::listen(fd, 64) != 0) throw std::runtime_error("listen failed");
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    try {
+        auto opt = [&](const char* flag, const char* def) {
+            const char* v = arg_value(argc, argv, flag);
+            return std::string(v ? v : def);
+        };
+
+        const std::string model = opt("--model",
+            "best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi_gather_replaced.onnx");
+        const std::string emb_path = opt("--emb", "decoder_emb_weight (1).npy");
+        const std::string socket_path = opt("--socket", "/tmp/decoder.sock");
+        const int port = std::stoi(opt("--port", "0"));
+        const size_t max_batch = static_cast<size_t>(std::stoul(opt("--max-batch", "8")));
+        const std::chrono::milliseconds max_wait(std::stol(opt("--max-wait-ms", "5")));
+        const size_t max_queue = static_cast<size_t>(std::stoul(opt("--queue", "256")));
+
+        EmbeddingTable embedding = EmbeddingTable::load(emb_path);
+        DefaultDecoderSpec::check_table(embedding);
+
+        RunnerConfig cfg = runner_config_from_args(argc, argv);
+        cfg.warm.options_tag = runner_config_tag(cfg);
+        runner_config_print(cfg);
+
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "decoder_server");
+        runner_register_arena(env, cfg);
+        Ort::SessionOptions session_options;
+        runner_config_apply(cfg, session_options);
+        Ort::Session session = create_session_warm(
+            env, model, std::move(session_options), cfg.opt_level, cfg.warm, "decoder_server");
+
+        // batch-dynamic export: the leading dimension is not checked
+        DecoderSignature sig = DefaultDecoderSpec::signature(DecoderTokenInput::Embedding);
+        DefaultDecoderSpec::check(session, sig, DecoderTokenInput::Embedding);
+        const size_t enc_n = DefaultDecoderSpec::kEncoderElems;
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        int lfd = listen_on(socket_path, port);
+        std::cout << "[server] listening on "
+                  << (port > 0 ? "127.0.0.1:" + std::to_string(port) : socket_path)
+                  << " (max_batch=" << max_batch << ", max_wait=" << max_wait.count() << " ms)\n";
+
+        {
+            Scheduler sched(session, sig, max_batch,
+                            DefaultDecoderSpec::embed_fn(embedding),
+                            max_wait, max_queue, cfg);
+            std::atomic<int> connections{0};
+            while (!g_stop) {
+                pollfd p{lfd, POLLIN, 0};
+                if (::poll(&p, 1, 500) <= 0) continue;
+                int cfd = ::accept(lfd, nullptr, nullptr);
+                if (cfd < 0) continue;
+                timeval tv{5, 0};
+                ::setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                ++connections;
+                std::thread([cfd, &sched, &connections, enc_n] {
+                    serve(cfd, sched, enc_n);
+                    ::close(cfd);
+                    --connections;
+                }).detach();
+            }
+            // in-flight requests still decode; idle readers give up after the receive timeout
+            ::close(lfd);
+            while (connections > 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (port <= 0) ::unlink(socket_path.c_str());
+        std::cout << "[server] stopped\n";
+        return 0;
+    }
+    catch (const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << "\n";
+        return 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
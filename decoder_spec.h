@@ -0,0 +1,129 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "decoder_engine.h"
+#include "embedding_table.h"
+
+// ============================================================
+// Compile-time decoder signature
+//
+// The decoder's tensor sizes as template parameters instead of
+// constants repeated through the runners:
+//   input:0          float [1,Seq,Heads,Dim]   encoder features
+//   input:1          int64 [1,1]               original model
+//   embedded_token   float [1,1,Hidden]        gather-replaced model
+//   input:2 / 3      float [1,1,Hidden]        recurrent state
+//   output:1 / 2     float [1,1,Hidden]
+//
+// Buffer sizes are constexpr, check() compares the spec with the
+// session's input/output type info once at load (a dynamic dimension
+// in the model matches anything, so batch-dynamic exports pass), and
+// check_table() the embedding width. After that the per-step helpers
+// run with constant sizes: lookup() is EmbeddingTable::lookup_fixed,
+// copy_state()/copy_encoder() are fixed-size memcpys.
+//
+//   using Spec = DefaultDecoderSpec;
+//   DecoderSignature sig = Spec::signature(DecoderTokenInput::Embedding);
+//   Spec::check(session, sig, DecoderTokenInput::Embedding);
+//   Spec::check_table(embedding);
+//   DecoderEngine engine(session, sig, DecoderTokenInput::Embedding, Spec::embed_fn(embedding));
+// ============================================================
+
+template <int64_t Seq, int64_t Heads, int64_t Dim, int64_t Hidden>
+struct DecoderSpec {
+    static_assert(Seq > 0 && Heads > 0 && Dim > 0 && Hidden > 0, "DecoderSpec: sizes must be positive");
+    static_assert(Hidden % 8 == 0, "DecoderSpec: Hidden must be a multiple of 8 (vector dequant width)");
+
+    static constexpr int64_t kSeq = Seq;
+    static constexpr int64_t kHeads = Heads;
+    static constexpr int64_t kDim = Dim;
+    static constexpr int64_t kHidden = Hidden;
+
+    static constexpr size_t kEncoderElems = static_cast<size_t>(Seq * Heads * Dim);
+    static constexpr size_t kStateElems = static_cast<size_t>(Hidden);
+    static constexpr size_t kEncoderBytes = kEncoderElems * sizeof(float);
+    static constexpr size_t kStateBytes = kStateElems * sizeof(float);
+
+    static constexpr int64_t kEncoderShape[4] = {1, Seq, Heads, Dim};
+    static constexpr int64_t kStateShape[3] = {1, 1, Hidden};
+    static constexpr int64_t kTokenIdShape[2] = {1, 1};
+
+    // Default tensor names with this spec's shapes.
+    static DecoderSignature signature(DecoderTokenInput mode) {
+        DecoderSignature sig;
+        sig.encoder_shape.assign(kEncoderShape, kEncoderShape + 4);
+        sig.state_shape.assign(kStateShape, kStateShape + 3);
+        if (mode == DecoderTokenInput::Embedding) sig.token_name = "embedded_token";
+        return sig;
+    }
+
+    // Throws on the first input/output whose element type, rank or a
+    // fixed dimension disagrees with the spec.
+    static void check(Ort::Session& session, const DecoderSignature& sig, DecoderTokenInput mode) {
+        const bool ids = mode == DecoderTokenInput::TokenId;
+        expect(session, true, sig.encoder_name, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, kEncoderShape, 4);
+        expect(session, true, sig.token_name,
+               ids ? ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64 : ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
+               ids ? kTokenIdShape : kStateShape, ids ? 2 : 3);
+        expect(session, true, sig.state0_name, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, kStateShape, 3);
+        expect(session, true, sig.state1_name, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, kStateShape, 3);
+        expect(session, false, sig.state0_out, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, kStateShape, 3);
+        expect(session, false, sig.state1_out, ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT, kStateShape, 3);
+    }
+
+    static void check_table(const EmbeddingTable& emb) {
+        if (emb.cols() != kStateElems) {
+            throw std::runtime_error("Expected embedding width " + std::to_string(Hidden) +
+                                     ", table has " + std::to_string(emb.cols()));
+        }
+    }
+
+    static void lookup(const EmbeddingTable& emb, int32_t token, float* dst) {
+        emb.lookup_fixed<kStateElems>(token, dst);
+    }
+
+    static DecoderEmbedFn embed_fn(const EmbeddingTable& emb) {
+        return [&emb](int32_t token, float* dst) { emb.lookup_fixed<kStateElems>(token, dst); };
+    }
+
+    static void copy_state(float* dst, const float* src) { std::memcpy(dst, src, kStateBytes); }
+    static void copy_encoder(float* dst, const float* src) { std::memcpy(dst, src, kEncoderBytes); }
+
+private:
+    static void expect(Ort::Session& session, bool input, const std::string& name,
+                       ONNXTensorElementDataType type, const int64_t* dims, size_t rank) {
+        Ort::AllocatorWithDefaultOptions allocator;
+        const size_t n = input ? session.GetInputCount() : session.GetOutputCount();
+        for (size_t i = 0; i < n; ++i) {
+            auto got = input ? session.GetInputNameAllocated(i, allocator) : session.GetOutputNameAllocated(i, allocator);
+            if (name != got.get()) continue;
+
+            auto info = (input ? session.GetInputTypeInfo(i) : session.GetOutputTypeInfo(i)).GetTensorTypeAndShapeInfo();
+            std::vector<int64_t> shape = info.GetShape();
+            bool ok = info.GetElementType() == type && shape.size() == rank;
+            for (size_t d = 0; ok && d < rank; ++d) ok = shape[d] <= 0 || shape[d] == dims[d];
+            if (ok) return;
+
+            std::ostringstream oss;
+            oss << "Decoder spec mismatch: " << name << " expected type " << type << " [";
+            for (size_t d = 0; d < rank; ++d) oss << (d ? "," : "") << dims[d];
+            oss << "], model has type " << info.GetElementType() << " [";
+            for (size_t d = 0; d < shape.size(); ++d) oss << (d ? "," : "") << shape[d];
+            oss << "]";
+            throw std::runtime_error(oss.str());
+        }
+        throw std::runtime_error("Decoder spec mismatch: model has no " +
+                                 std::string(input ? "input " : "output ") + name);
+    }
+};
+
+// The exported ST decoder: features [1,352,2,8], state [1,1,256].
+using DefaultDecoderSpec = DecoderSpec<352, 2, 8, 256>;
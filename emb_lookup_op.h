@@ -0,0 +1,116 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "embedding_table.h"
+
+// ============================================================
+// In-graph embedding lookup (custom op st.emb::EmbLookup)
+//
+// The gather-replaced model takes the embedded row as a float input,
+// so every step does a host lookup into the bound buffer first. The
+// EmbLookup export (Embedding_custom_op) keeps the model just as small
+// but puts the lookup back in the graph: Gather_11 becomes
+//
+//   EmbLookup(ids int64 [...]) -> float [..., Hidden]     domain st.emb
+//
+// and the kernel reads the memory-mapped EmbeddingTable (F32, F16 or
+// I8, hot rows included) straight into ORT's output inside
+// session.Run. The model keeps the original int64 input:1, so it runs
+// with DecoderTokenInput::TokenId and any leading shape, [B,1] in a
+// batch included.
+//
+// The domain has to be added to the SessionOptions of every session
+// that loads the model and outlive those sessions:
+//
+//   EmbLookupDomain<Spec::kStateElems> emb_op(embedding);
+//   emb_op.add_to(session_options);
+//   Ort::Session session(env, model_path, session_options);
+// ============================================================
+
+static constexpr const char* kEmbLookupDomain = "st.emb";
+static constexpr const char* kEmbLookupOp = "EmbLookup";
+
+// N: the table width, checked against the table when the domain is made.
+template <size_t N>
+struct EmbLookupKernel {
+    const EmbeddingTable* table;
+
+    void Compute(OrtKernelContext* context) {
+        Ort::KernelContext ctx(context);
+        Ort::ConstValue ids = ctx.GetInput(0);
+        auto info = ids.GetTensorTypeAndShapeInfo();
+        std::vector<int64_t> shape = info.GetShape();
+        const size_t n = info.GetElementCount();
+        const int64_t* src = ids.GetTensorData<int64_t>();
+
+        const int64_t rows = static_cast<int64_t>(table->rows());
+        for (size_t i = 0; i < n; ++i) {
+            if (src[i] < 0 || src[i] >= rows) {
+                throw Ort::Exception("EmbLookup: token id " + std::to_string(src[i]) +
+                                     " outside the table", ORT_INVALID_ARGUMENT);
+            }
+        }
+
+        shape.push_back(static_cast<int64_t>(N));
+        Ort::UnownedValue out = ctx.GetOutput(0, shape.data(), shape.size());
+        float* dst = out.GetTensorMutableData<float>();
+        for (size_t i = 0; i < n; ++i) {
+            table->lookup_fixed<N>(static_cast<int32_t>(src[i]), dst + i * N);
+        }
+    }
+};
+
+template <size_t N>
+struct EmbLookupCustomOp : Ort::CustomOpBase<EmbLookupCustomOp<N>, EmbLookupKernel<N>> {
+    explicit EmbLookupCustomOp(const EmbeddingTable& table) : table_(&table) {}
+
+    void* CreateKernel(const OrtApi&, const OrtKernelInfo*) const {
+        return new EmbLookupKernel<N>{table_};
+    }
+
+    const char* GetName() const { return kEmbLookupOp; }
+    const char* GetExecutionProviderType() const { return "CPUExecutionProvider"; }
+
+    size_t GetInputTypeCount() const { return 1; }
+    ONNXTensorElementDataType GetInputType(size_t) const { return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64; }
+    size_t GetOutputTypeCount() const { return 1; }
+    ONNXTensorElementDataType GetOutputType(size_t) const { return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT; }
+
+private:
+    const EmbeddingTable* table_;
+};
+
+// The op and its domain for one table. Non-movable: ORT keeps pointers
+// to both from add_to() until the sessions using them are gone.
+template <size_t N>
+class EmbLookupDomain {
+public:
+    explicit EmbLookupDomain(const EmbeddingTable& table)
+        : op_(check(table)), domain_(kEmbLookupDomain) {
+        domain_.Add(&op_);
+    }
+
+    EmbLookupDomain(const EmbLookupDomain&) = delete;
+    EmbLookupDomain& operator=(const EmbLookupDomain&) = delete;
+
+    void add_to(Ort::SessionOptions& options) { options.Add(domain_); }
+
+private:
+    EmbLookupCustomOp<N> op_;
+    Ort::CustomOpDomain domain_;
+
+    static const EmbeddingTable& check(const EmbeddingTable& table) {
+        if (table.cols() != N) {
+            throw std::runtime_error("EmbLookup: op width " + std::to_string(N) +
+                                     ", table has " + std::to_string(table.cols()));
+        }
+        return table;
+    }
+};
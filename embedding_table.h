@@ -0,0 +1,489 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "npy_mmap.h"
+
+// ============================================================
+// Embedding table for the external Gather_11 replacement
+//
+// Storage formats:
+//   F32   the original decoder_emb_weight .npy, mmapped as-is
+//   F16   IEEE half per element                    (2x smaller)
+//   I8    int8 per element + one fp32 scale per row (~4x smaller)
+//
+// Compact tables live in a small .embq file, mmapped on load:
+//   char     magic[4] = "EMBQ"
+//   uint32_t version  = 1
+//   uint32_t format   (1 = F16, 2 = I8)
+//   uint32_t rows, cols
+//   uint32_t reserved[3]             (header is 32 bytes)
+//   float    scales[rows]            (I8 only)
+//   payload  rows * cols elements
+//
+// lookup() dequantizes one row into the caller's [1,1,cols] buffer
+// with AVX2/F16C or NEON when available, scalar otherwise.
+//
+// Hot rows: pin_hot() dequantizes the rows every request touches
+// (BOS, EOS, punctuation, the Yes/No answer ids) once into a single
+// 64-byte aligned block, mlock'd when the process may, so they never
+// come from a cold page of the table. row() returns a view (a hot
+// row, or the mapped row of an F32 table) and only dequantizes into
+// the caller's scratch for the rest. prefetch() pulls a row towards
+// the cache ahead of the step that reads it.
+// ============================================================
+
+enum class EmbFormat : uint32_t { F32 = 0, F16 = 1, I8 = 2 };
+
+static inline uint16_t emb_f32_to_f16(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000u;
+    int32_t exp = static_cast<int32_t>((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffffu;
+
+    if (((x >> 23) & 0xff) == 0xff) {                 // inf / nan
+        return static_cast<uint16_t>(sign | 0x7c00u | (mant ? 0x200u : 0));
+    }
+    if (exp >= 31) return static_cast<uint16_t>(sign | 0x7c00u);
+    if (exp <= 0) {                                    // subnormal / zero
+        if (exp < -10) return static_cast<uint16_t>(sign);
+        mant |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exp);
+        uint32_t h = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1))) ++h;
+        return static_cast<uint16_t>(sign | h);
+    }
+    uint32_t h = (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1))) ++h;   // may carry into exp: fine
+    return static_cast<uint16_t>(sign | h);
+}
+
+static inline float emb_f16_to_f32(uint16_t h) {
+    uint32_t sign = (h & 0x8000u) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ffu;
+    uint32_t x;
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400u)) { mant <<= 1; --exp; }
+            x = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000u | (mant << 13);
+    } else {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+static inline void emb_dequant_i8(const int8_t* src, float scale, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 vs = _mm256_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, vs));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float32x4_t vs = vdupq_n_f32(scale);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t w = vmovl_s8(vld1_s8(src + i));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(w)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(w)));
+        vst1q_f32(dst + i, vmulq_f32(lo, vs));
+        vst1q_f32(dst + i + 4, vmulq_f32(hi, vs));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = static_cast<float>(src[i]) * scale;
+}
+
+static inline void emb_dequant_f16(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__) && defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = emb_f16_to_f32(src[i]);
+}
+
+// Fixed-width variants for EmbeddingTable::lookup_fixed: N is a
+// multiple of 8, so there is no scalar tail and the loops fully unroll.
+template <size_t N>
+static inline void emb_dequant_i8_fixed(const int8_t* src, float scale, float* dst) {
+    static_assert(N % 8 == 0, "fixed width must be a multiple of 8");
+#if defined(__AVX2__)
+    const __m256 vs = _mm256_set1_ps(scale);
+    for (size_t i = 0; i < N; i += 8) {
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b)), vs));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float32x4_t vs = vdupq_n_f32(scale);
+    for (size_t i = 0; i < N; i += 8) {
+        int16x8_t w = vmovl_s8(vld1_s8(src + i));
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(w))), vs));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(w))), vs));
+    }
+#else
+    for (size_t i = 0; i < N; ++i) dst[i] = static_cast<float>(src[i]) * scale;
+#endif
+}
+
+template <size_t N>
+static inline void emb_dequant_f16_fixed(const uint16_t* src, float* dst) {
+    static_assert(N % 8 == 0, "fixed width must be a multiple of 8");
+#if defined(__AVX2__) && defined(__F16C__)
+    for (size_t i = 0; i < N; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+    }
+#elif defined(__aarch64__)
+    for (size_t i = 0; i < N; i += 4) vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+#else
+    for (size_t i = 0; i < N; ++i) dst[i] = emb_f16_to_f32(src[i]);
+#endif
+}
+
+class EmbeddingTable {
+public:
+    EmbeddingTable() = default;
+
+    // Picks the loader from the extension: .embq is compact, anything
+    // else is treated as a float32 2D .npy.
+    static EmbeddingTable load(const std::string& path) {
+        EmbeddingTable t;
+        const std::string ext = ".embq";
+        if (path.size() >= ext.size() &&
+            path.compare(path.size() - ext.size(), ext.size(), ext) == 0) {
+            t.load_compact(path);
+        } else {
+            t.npy_ = NpyMapped(path);
+            if (t.npy_.shape.size() != 2) {
+                throw std::runtime_error("Expected a 2D .npy array: " + path);
+            }
+            t.f32_ = t.npy_.data<float>();
+            t.rows_ = static_cast<size_t>(t.npy_.shape[0]);
+            t.cols_ = static_cast<size_t>(t.npy_.shape[1]);
+            t.format_ = EmbFormat::F32;
+        }
+        return t;
+    }
+
+    ~EmbeddingTable() { unmap(); free_hot(); }
+    EmbeddingTable(const EmbeddingTable&) = delete;
+    EmbeddingTable& operator=(const EmbeddingTable&) = delete;
+    EmbeddingTable(EmbeddingTable&& o) noexcept { *this = std::move(o); }
+    EmbeddingTable& operator=(EmbeddingTable&& o) noexcept {
+        if (this != &o) {
+            unmap();
+            free_hot();
+            npy_ = std::move(o.npy_);
+            base_ = o.base_; map_size_ = o.map_size_;
+            format_ = o.format_; rows_ = o.rows_; cols_ = o.cols_;
+            f32_ = o.f32_; f16_ = o.f16_; i8_ = o.i8_; scales_ = o.scales_;
+            o.base_ = nullptr; o.map_size_ = 0;
+            o.f32_ = nullptr; o.f16_ = nullptr; o.i8_ = nullptr; o.scales_ = nullptr;
+            hot_ = o.hot_; hot_bytes_ = o.hot_bytes_; hot_locked_ = o.hot_locked_;
+            hot_slot_ = std::move(o.hot_slot_);
+            o.hot_ = nullptr; o.hot_bytes_ = 0; o.hot_locked_ = false;
+        }
+        return *this;
+    }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    EmbFormat format() const { return format_; }
+
+    size_t resident_bytes() const {
+        switch (format_) {
+        case EmbFormat::F16: return rows_ * cols_ * 2;
+        case EmbFormat::I8:  return rows_ * cols_ + rows_ * sizeof(float);
+        default:             return rows_ * cols_ * sizeof(float);
+        }
+    }
+
+    // fp32 row pointer, only valid for F32 tables (no dequantization).
+    const float* f32_row(size_t row) const { return f32_ ? f32_ + row * cols_ : nullptr; }
+
+    // Copies the rows of ids (duplicates and out-of-range ids are
+    // skipped) into the hot block; replaces any previous hot set.
+    void pin_hot(const std::vector<int32_t>& ids) {
+        free_hot();
+        std::vector<int32_t> keep;
+        hot_slot_.assign(rows_, -1);
+        for (int32_t id : ids) {
+            if (id < 0 || static_cast<size_t>(id) >= rows_ || hot_slot_[id] >= 0) continue;
+            hot_slot_[id] = static_cast<int32_t>(keep.size());
+            keep.push_back(id);
+        }
+        if (keep.empty()) { hot_slot_.clear(); return; }
+
+        const size_t stride = hot_stride();
+        hot_bytes_ = (keep.size() * stride * sizeof(float) + 63) / 64 * 64;
+        hot_ = static_cast<float*>(std::aligned_alloc(64, hot_bytes_));
+        if (!hot_) { hot_bytes_ = 0; hot_slot_.clear(); throw std::bad_alloc(); }
+        for (size_t i = 0; i < keep.size(); ++i) dequant_row(static_cast<size_t>(keep[i]), hot_ + i * stride);
+        hot_locked_ = ::mlock(hot_, hot_bytes_) == 0;   // best effort (RLIMIT_MEMLOCK)
+    }
+
+    // Drops the resident pages of the mapped table (e.g. while the app is
+    // in the background); rows fault back in from the file on the next
+    // lookup. The hot block stays.
+    void release_pages() const {
+        npy_.advise_dontneed();
+        if (base_) ::madvise(base_, map_size_, MADV_DONTNEED);
+    }
+
+    size_t hot_rows() const { return hot_ ? hot_bytes_ / (hot_stride() * sizeof(float)) : 0; }
+    bool hot_locked() const { return hot_locked_; }
+
+    // Row token_id as cols floats: a view into the hot block or the F32
+    // mapping, else dequantized into scratch[cols]. Valid until the
+    // table is destroyed or pin_hot() is called again.
+    const float* row(int32_t token_id, float* scratch) const {
+        check_row(token_id);
+        size_t r = static_cast<size_t>(token_id);
+        if (hot_ && hot_slot_[r] >= 0) return hot_ + static_cast<size_t>(hot_slot_[r]) * hot_stride();
+        if (format_ == EmbFormat::F32) return f32_ + r * cols_;
+        dequant_row(r, scratch);
+        return scratch;
+    }
+
+    // Hints the row of token_id into the cache (no-op for hot rows).
+    void prefetch(int32_t token_id) const {
+        if (token_id < 0 || static_cast<size_t>(token_id) >= rows_) return;
+        size_t r = static_cast<size_t>(token_id);
+        if (hot_ && hot_slot_[r] >= 0) return;
+        const char* p = nullptr;
+        size_t bytes = 0;
+        switch (format_) {
+        case EmbFormat::F32: p = reinterpret_cast<const char*>(f32_ + r * cols_); bytes = cols_ * 4; break;
+        case EmbFormat::F16: p = reinterpret_cast<const char*>(f16_ + r * cols_); bytes = cols_ * 2; break;
+        case EmbFormat::I8:
+            p = reinterpret_cast<const char*>(i8_ + r * cols_);
+            bytes = cols_;
+            __builtin_prefetch(scales_ + r);
+            break;
+        }
+        for (size_t off = 0; off < bytes; off += 64) __builtin_prefetch(p + off);
+    }
+
+    // Dequantizes row token_id into dst[cols].
+    void lookup(int32_t token_id, float* dst) const {
+        check_row(token_id);
+        size_t row = static_cast<size_t>(token_id);
+        if (hot_ && hot_slot_[row] >= 0) {
+            std::memcpy(dst, hot_ + static_cast<size_t>(hot_slot_[row]) * hot_stride(), cols_ * sizeof(float));
+            return;
+        }
+        dequant_row(row, dst);
+    }
+
+    // lookup() for a width fixed at compile time (DecoderSpec): the
+    // copy and dequant loops get a constant trip count and no tail.
+    // The caller has checked cols() == N once, at load.
+    template <size_t N>
+    void lookup_fixed(int32_t token_id, float* dst) const {
+        check_row(token_id);
+        size_t row = static_cast<size_t>(token_id);
+        if (hot_ && hot_slot_[row] >= 0) {
+            std::memcpy(dst, hot_ + static_cast<size_t>(hot_slot_[row]) * ((N + 15) / 16 * 16), N * sizeof(float));
+            return;
+        }
+        switch (format_) {
+        case EmbFormat::F32: std::memcpy(dst, f32_ + row * N, N * sizeof(float)); break;
+        case EmbFormat::F16: emb_dequant_f16_fixed<N>(f16_ + row * N, dst); break;
+        case EmbFormat::I8:  emb_dequant_i8_fixed<N>(i8_ + row * N, scales_[row], dst); break;
+        }
+    }
+
+    // One-shot converter: writes this table as a compact .embq file.
+    // I8 uses symmetric per-row scales (max |x| / 127).
+    void write_compact(const std::string& out_path, EmbFormat fmt) const {
+        if (fmt == EmbFormat::F32) {
+            throw std::runtime_error("write_compact: target format must be F16 or I8");
+        }
+        FILE* fp = std::fopen(out_path.c_str(), "wb");
+        if (!fp) throw std::runtime_error("Failed to create " + out_path);
+
+        uint32_t hdr[8] = {0, 1, static_cast<uint32_t>(fmt),
+                           static_cast<uint32_t>(rows_), static_cast<uint32_t>(cols_), 0, 0, 0};
+        std::memcpy(&hdr[0], "EMBQ", 4);
+        bool ok = std::fwrite(hdr, sizeof(hdr), 1, fp) == 1;
+
+        std::string row_f(cols_ * sizeof(float), '\0');
+        float* tmp = reinterpret_cast<float*>(&row_f[0]);
+
+        if (fmt == EmbFormat::I8) {
+            for (size_t r = 0; ok && r < rows_; ++r) {
+                lookup(static_cast<int32_t>(r), tmp);
+                float amax = 0.0f;
+                for (size_t c = 0; c < cols_; ++c) amax = std::fmax(amax, std::fabs(tmp[c]));
+                float scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+                ok = std::fwrite(&scale, sizeof(float), 1, fp) == 1;
+            }
+            std::string q(cols_, '\0');
+            for (size_t r = 0; ok && r < rows_; ++r) {
+                lookup(static_cast<int32_t>(r), tmp);
+                float amax = 0.0f;
+                for (size_t c = 0; c < cols_; ++c) amax = std::fmax(amax, std::fabs(tmp[c]));
+                float inv = amax > 0.0f ? 127.0f / amax : 0.0f;
+                for (size_t c = 0; c < cols_; ++c) {
+                    long v = std::lround(tmp[c] * inv);
+                    q[c] = static_cast<char>(v > 127 ? 127 : (v < -127 ? -127 : v));
+                }
+                ok = std::fwrite(q.data(), 1, cols_, fp) == cols_;
+            }
+        } else {
+            std::string h(cols_ * 2, '\0');
+            uint16_t* hp = reinterpret_cast<uint16_t*>(&h[0]);
+            for (size_t r = 0; ok && r < rows_; ++r) {
+                lookup(static_cast<int32_t>(r), tmp);
+                for (size_t c = 0; c < cols_; ++c) hp[c] = emb_f32_to_f16(tmp[c]);
+                ok = std::fwrite(h.data(), 1, h.size(), fp) == h.size();
+            }
+        }
+
+        if (std::fclose(fp) != 0 || !ok) {
+            throw std::runtime_error("Failed to write " + out_path);
+        }
+    }
+
+private:
+    NpyMapped npy_;
+    char* base_ = nullptr;
+    size_t map_size_ = 0;
+
+    EmbFormat format_ = EmbFormat::F32;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    const float* f32_ = nullptr;
+    const uint16_t* f16_ = nullptr;
+    const int8_t* i8_ = nullptr;
+    const float* scales_ = nullptr;
+
+    float* hot_ = nullptr;              // hot rows, 64-byte aligned, hot_stride() apart
+    size_t hot_bytes_ = 0;
+    bool hot_locked_ = false;
+    std::vector<int32_t> hot_slot_;     // row -> hot index, -1 when cold; empty without hot rows
+
+    // rows start on a cache line
+    size_t hot_stride() const { return (cols_ + 15) / 16 * 16; }
+
+    void free_hot() {
+        if (hot_locked_) ::munlock(hot_, hot_bytes_);
+        std::free(hot_);
+        hot_ = nullptr;
+        hot_bytes_ = 0;
+        hot_locked_ = false;
+        hot_slot_.clear();
+    }
+
+    void check_row(int32_t token_id) const {
+        if (token_id < 0 || static_cast<size_t>(token_id) >= rows_) {
+            std::ostringstream oss;
+            oss << "Token id out of range: " << token_id
+                << " valid range is [0, " << (rows_ - 1) << "]";
+            throw std::runtime_error(oss.str());
+        }
+    }
+
+    void dequant_row(size_t row, float* dst) const {
+        switch (format_) {
+        case EmbFormat::F32:
+            std::memcpy(dst, f32_ + row * cols_, cols_ * sizeof(float));
+            break;
+        case EmbFormat::F16:
+            emb_dequant_f16(f16_ + row * cols_, dst, cols_);
+            break;
+        case EmbFormat::I8:
+            emb_dequant_i8(i8_ + row * cols_, scales_[row], dst, cols_);
+            break;
+        }
+    }
+
+    void unmap() {
+        if (base_) ::munmap(base_, map_size_);
+        base_ = nullptr;
+        map_size_ = 0;
+    }
+
+    void load_compact(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open embedding table: " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < 32) {
+            ::close(fd);
+            throw std::runtime_error("Invalid embedding table: " + path);
+        }
+        map_size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap embedding table: " + path);
+        base_ = static_cast<char*>(p);
+
+        uint32_t hdr[8];
+        std::memcpy(hdr, base_, sizeof(hdr));
+        if (std::memcmp(base_, "EMBQ", 4) != 0 || hdr[1] != 1) {
+            unmap();
+            throw std::runtime_error("Bad .embq header: " + path);
+        }
+        format_ = static_cast<EmbFormat>(hdr[2]);
+        rows_ = hdr[3];
+        cols_ = hdr[4];
+
+        size_t off = sizeof(hdr);
+        size_t need = off;
+        if (format_ == EmbFormat::I8) need += rows_ * sizeof(float) + rows_ * cols_;
+        else if (format_ == EmbFormat::F16) need += rows_ * cols_ * 2;
+        else need = SIZE_MAX;
+        if (need > map_size_) {
+            unmap();
+            throw std::runtime_error("Truncated or unsupported .embq file: " + path);
+        }
+
+        if (format_ == EmbFormat::I8) {
+            scales_ = reinterpret_cast<const float*>(base_ + off);
+            i8_ = reinterpret_cast<const int8_t*>(base_ + off + rows_ * sizeof(float));
+        } else {
+            f16_ = reinterpret_cast<const uint16_t*>(base_ + off);
+        }
+    }
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "npy_mmap.h"
+
+// ============================================================
+// Encoder feature cache
+//
+// The decoder's input:0 is a pure function of the image and the
+// encoder model, so asking several questions about one frame (or
+// retrying one) only needs the encoder once. Features are kept in
+// a bounded LRU keyed by (frame content hash, model version).
+//
+// With a directory set, every entry is also written there as a
+// .npy (<dir>/<model>-<frame>.npy, temp file + rename) and a memory
+// miss maps that file with NpyMapped instead of running the encoder,
+// so the cache survives restarts and is shared between processes.
+// The directory keeps at most max_files entries, oldest first out.
+//
+// Pointers returned by find()/insert() stay valid until the next
+// find() or insert(): a disk hit in find() adds an entry and can evict
+// the oldest one. Not thread-safe; the owner serializes access.
+// ============================================================
+
+class FeatureCache {
+public:
+    FeatureCache(std::vector<int64_t> shape, size_t max_entries,
+                 std::string dir = std::string(), size_t max_files = 0)
+        : shape_(std::move(shape)),
+          elems_(static_cast<size_t>(npy_num_elements(shape_))),
+          max_entries_(max_entries ? max_entries : 1),
+          dir_(std::move(dir)),
+          max_files_(max_files) {
+        if (!dir_.empty()) ::mkdir(dir_.c_str(), 0700);
+    }
+
+    FeatureCache(const FeatureCache&) = delete;
+    FeatureCache& operator=(const FeatureCache&) = delete;
+
+    // Version key of a model file: path, size and mtime, so a replaced
+    // model never serves features of the old one.
+    static uint64_t model_version(const std::string& path) {
+        struct stat st;
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&h](const void* p, size_t n) {
+            const unsigned char* b = static_cast<const unsigned char*>(p);
+            for (size_t i = 0; i < n; ++i) {
+                h ^= b[i];
+                h *= 1099511628211ULL;
+            }
+        };
+        mix(path.data(), path.size());
+        if (::stat(path.c_str(), &st) == 0) {
+            int64_t size = static_cast<int64_t>(st.st_size), mtime = static_cast<int64_t>(st.st_mtime);
+            mix(&size, sizeof(size));
+            mix(&mtime, sizeof(mtime));
+        }
+        return h;
+    }
+
+    size_t elems() const { return elems_; }
+
+    // nullptr on a miss (memory and disk).
+    const float* find(uint64_t frame, uint64_t model) {
+        Key k{frame, model};
+        auto it = index_.find(k);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++hits;
+            return it->second->ptr;
+        }
+        if (!dir_.empty()) {
+            try {
+                NpyMapped m(path_of(k));
+                if (m.dtype == DType::F32 && m.shape == shape_) {
+                    Entry& e = push(k);
+                    e.map = std::move(m);
+                    e.ptr = e.map.data<float>();
+                    ++disk_hits;
+                    return e.ptr;
+                }
+            } catch (const std::exception&) {
+                // not on disk (or unreadable): a miss
+            }
+        }
+        ++misses;
+        return nullptr;
+    }
+
+    // Copies elems() floats in; returns the cached copy.
+    const float* insert(uint64_t frame, uint64_t model, const float* data) {
+        Key k{frame, model};
+        auto it = index_.find(k);
+        if (it != index_.end()) {
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+        Entry& e = push(k);
+        e.heap.assign(data, data + elems_);
+        e.ptr = e.heap.data();
+        if (!dir_.empty()) write_file(k, e.ptr);
+        return e.ptr;
+    }
+
+    // Drops every in-memory entry (heap copies and mappings); files in
+    // the directory stay and are mapped again on the next find().
+    // Pointers returned earlier are invalid afterwards.
+    void clear() {
+        index_.clear();
+        lru_.clear();
+    }
+
+    size_t hits = 0, disk_hits = 0, misses = 0;
+
+private:
+    struct Key {
+        uint64_t frame, model;
+        bool operator==(const Key& o) const { return frame == o.frame && model == o.model; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return static_cast<size_t>(k.frame ^ (k.model * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+    struct Entry {
+        Key key;
+        std::vector<float> heap;        // computed here
+        NpyMapped map;                  // or mapped from dir_
+        const float* ptr = nullptr;
+    };
+
+    std::vector<int64_t> shape_;
+    size_t elems_;
+    size_t max_entries_;
+    std::string dir_;
+    size_t max_files_;
+    std::list<Entry> lru_;              // front = most recent
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+    Entry& push(const Key& k) {
+        while (lru_.size() >= max_entries_) {
+            index_.erase(lru_.back().key);
+            lru_.pop_back();
+        }
+        lru_.emplace_front();
+        lru_.front().key = k;
+        index_[k] = lru_.begin();
+        return lru_.front();
+    }
+
+    std::string path_of(const Key& k) const {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/%016llx-%016llx.npy",
+                      static_cast<unsigned long long>(k.model), static_cast<unsigned long long>(k.frame));
+        return dir_ + name;
+    }
+
+    void write_file(const Key& k, const float* data) {
+        if (npy_write(path_of(k), DType::F32, shape_, data) && max_files_) prune();
+    }
+
+    void prune() {
+        DIR* d = ::opendir(dir_.c_str());
+        if (!d) return;
+        std::vector<std::pair<time_t, std::string>> files;
+        while (struct dirent* de = ::readdir(d)) {
+            size_t n = std::strlen(de->d_name);
+            if (n < 4 || std::strcmp(de->d_name + n - 4, ".npy") != 0) continue;
+            std::string p = dir_ + "/" + de->d_name;
+            struct stat st;
+            if (::stat(p.c_str(), &st) == 0) files.emplace_back(st.st_mtime, std::move(p));
+        }
+        ::closedir(d);
+        if (files.size() <= max_files_) return;
+        std::sort(files.begin(), files.end());
+        // mapped entries keep their pages after the unlink
+        for (size_t i = 0; i + max_files_ < files.size(); ++i) ::unlink(files[i].second.c_str());
+    }
+};
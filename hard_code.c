@@ -92,6 +92,7 @@ static char* http_request(const char *url, const char *token,
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &m);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");   // gzip/br JSON, decoded by curl
     // Uncomment next line only if you hit CA issues during dev:
     // curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
 
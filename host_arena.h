@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// ============================================================
+// Host-side bump arena
+//
+// Decoder buffers (features, token rows, state halves, logits) and
+// per-request scratch are carved from a few large blocks instead of
+// one heap allocation each. Every allocation is 64-byte aligned, so
+// rows start on a cache line and the logits scans vectorize without
+// a scalar prologue.
+//
+//   alloc<T>(n)       uninitialized, alloc_zeroed<T>(n) cleared
+//   mark()/rewind(m)  drop everything allocated after m
+//   reset()           drop everything
+//
+// Blocks are kept across resets. When reset() finds that a request
+// spilled into several blocks, it replaces them with a single block
+// of the high-water size, so a long-running loop settles into one
+// block and reuses it without touching malloc.
+// Pointers stay valid until the rewind/reset that covers them. Not
+// thread-safe; one arena per engine or worker.
+// ============================================================
+
+class HostArena {
+public:
+    static constexpr size_t kAlign = 64;
+
+    explicit HostArena(size_t block_bytes = 64 * 1024) : block_bytes_(round_up(block_bytes ? block_bytes : kAlign)) {}
+    ~HostArena() { release(); }
+
+    HostArena(const HostArena&) = delete;
+    HostArena& operator=(const HostArena&) = delete;
+
+    // Sizes the first block, e.g. to the sum of an engine's buffers.
+    void reserve(size_t bytes) {
+        if (blocks_.empty()) add_block(bytes > block_bytes_ ? bytes : block_bytes_);
+    }
+
+    template <typename T>
+    T* alloc(size_t n) {
+        return static_cast<T*>(bytes(n * sizeof(T)));
+    }
+
+    template <typename T>
+    T* alloc_zeroed(size_t n) {
+        T* p = alloc<T>(n);
+        std::memset(p, 0, n * sizeof(T));
+        return p;
+    }
+
+    struct Mark {
+        size_t block = 0, used = 0, live = 0;
+    };
+
+    Mark mark() const { return Mark{cur_, used_, live_}; }
+
+    void rewind(const Mark& m) {
+        if (m.block > cur_ || (m.block == cur_ && m.used > used_)) return;   // not an earlier mark
+        cur_ = m.block;
+        used_ = m.used;
+        live_ = m.live;
+    }
+
+    void reset() {
+        if (blocks_.size() > 1) {
+            size_t total = high_water_;
+            release();
+            add_block(total);
+        }
+        cur_ = 0;
+        used_ = 0;
+        live_ = 0;
+    }
+
+    size_t used() const { return live_ + used_; }     // bytes handed out since the last reset
+    size_t capacity() const {
+        size_t n = 0;
+        for (const auto& b : blocks_) n += b.size;
+        return n;
+    }
+    size_t high_water() const { return high_water_; }
+    size_t blocks() const { return blocks_.size(); }
+
+private:
+    struct Block {
+        unsigned char* p;
+        size_t size;
+    };
+
+    size_t block_bytes_;
+    std::vector<Block> blocks_;
+    size_t cur_ = 0;            // block being bumped
+    size_t used_ = 0;           // bytes used in blocks_[cur_]
+    size_t live_ = 0;           // bytes used in the blocks before cur_
+    size_t high_water_ = 0;
+
+    static size_t round_up(size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+    void add_block(size_t size) {
+        size = round_up(size);
+        void* p = std::aligned_alloc(kAlign, size);
+        if (!p) throw std::bad_alloc();
+        blocks_.push_back(Block{static_cast<unsigned char*>(p), size});
+    }
+
+    void* bytes(size_t n) {
+        n = round_up(n ? n : 1);
+        if (blocks_.empty()) add_block(n > block_bytes_ ? n : block_bytes_);
+        while (used_ + n > blocks_[cur_].size) {
+            live_ += used_;
+            used_ = 0;
+            if (++cur_ == blocks_.size()) add_block(n > block_bytes_ ? n : block_bytes_);
+        }
+        void* p = blocks_[cur_].p + used_;
+        used_ += n;
+        if (used() > high_water_) high_water_ = used();
+        return p;
+    }
+
+    void release() {
+        for (const auto& b : blocks_) std::free(b.p);
+        blocks_.clear();
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================
+// Latency samples with percentile summaries
+//
+// Benchmarks record one sample per iteration per stage and report
+// p50/p90/p99 (nearest-rank). to_json() emits a flat object so two
+// builds can be diffed directly.
+// ============================================================
+
+using bench_clock = std::chrono::steady_clock;
+
+static inline double ms_since(bench_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - t0).count();
+}
+
+struct LatencySummary {
+    size_t count = 0;
+    double min = 0, max = 0, mean = 0, p50 = 0, p90 = 0, p99 = 0;
+};
+
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(std::string name = "") : name_(std::move(name)) {}
+
+    void add(double ms) { samples_.push_back(ms); }
+    void reserve(size_t n) { samples_.reserve(n); }
+    const std::string& name() const { return name_; }
+    size_t count() const { return samples_.size(); }
+
+    LatencySummary summary() const {
+        LatencySummary s;
+        s.count = samples_.size();
+        if (samples_.empty()) return s;
+        std::vector<double> v = samples_;
+        std::sort(v.begin(), v.end());
+        double sum = 0;
+        for (double x : v) sum += x;
+        s.min = v.front();
+        s.max = v.back();
+        s.mean = sum / static_cast<double>(v.size());
+        s.p50 = rank(v, 0.50);
+        s.p90 = rank(v, 0.90);
+        s.p99 = rank(v, 0.99);
+        return s;
+    }
+
+    void to_json(std::ostream& os) const {
+        LatencySummary s = summary();
+        os << "{\"count\":" << s.count
+           << ",\"min_ms\":" << s.min << ",\"max_ms\":" << s.max << ",\"mean_ms\":" << s.mean
+           << ",\"p50_ms\":" << s.p50 << ",\"p90_ms\":" << s.p90 << ",\"p99_ms\":" << s.p99 << "}";
+    }
+
+    void print(std::ostream& os) const {
+        LatencySummary s = summary();
+        os << "  " << name_ << ": n=" << s.count << " p50=" << s.p50 << "ms p90=" << s.p90
+           << "ms p99=" << s.p99 << "ms (min " << s.min << ", max " << s.max << ")\n";
+    }
+
+private:
+    std::string name_;
+    std::vector<double> samples_;
+
+    static double rank(const std::vector<double>& sorted, double q) {
+        size_t idx = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+        if (idx > 0) --idx;
+        return sorted[std::min(idx, sorted.size() - 1)];
+    }
+};
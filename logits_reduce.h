@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LOGITS_REDUCE_AVX2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LOGITS_REDUCE_NEON 1
+#endif
+
+// ============================================================
+// Fused logits reduction
+//
+// One pass over a float buffer computes min, max, mean, argmax and
+// (optionally) top-k. Vector paths: AVX2 (8 lanes) and NEON (4
+// lanes), with a scalar fallback and a scalar tail. Build with
+// -mavx2 (x86) or -mfpu=neon (armv7) to enable the vector paths.
+//
+// Sums go into double accumulators so the mean matches the old
+// scalar loop in nump.cpp. Argmax ties resolve to the lowest index.
+// Top-k only falls back to scalar work for lanes that beat the
+// current k-th value, which is rare after the first few blocks.
+// ============================================================
+
+#define LOGITS_TOPK_MAX 16
+
+struct LogitsTopK {
+    size_t k = 0;                       // requested, <= LOGITS_TOPK_MAX
+    size_t filled = 0;
+    float val[LOGITS_TOPK_MAX];         // descending
+    int32_t idx[LOGITS_TOPK_MAX];
+};
+
+struct LogitsStats {
+    float min = 0.0f;
+    float max = 0.0f;
+    double mean = 0.0;
+    size_t argmax = 0;
+    size_t count = 0;
+};
+
+static inline void logits_topk_reset(LogitsTopK* t, size_t k) {
+    t->k = k > LOGITS_TOPK_MAX ? LOGITS_TOPK_MAX : k;
+    t->filled = 0;
+}
+
+static inline float logits_topk_threshold(const LogitsTopK* t) {
+    return t->filled < t->k ? -std::numeric_limits<float>::infinity() : t->val[t->k - 1];
+}
+
+static inline void logits_topk_push(LogitsTopK* t, float v, int32_t i) {
+    if (t->k == 0) return;
+    if (t->filled == t->k && !(v > t->val[t->k - 1])) return;
+    size_t pos = t->filled < t->k ? t->filled++ : t->k - 1;
+    while (pos > 0 && t->val[pos - 1] < v) {
+        t->val[pos] = t->val[pos - 1];
+        t->idx[pos] = t->idx[pos - 1];
+        --pos;
+    }
+    t->val[pos] = v;
+    t->idx[pos] = i;
+}
+
+static inline void logits_reduce_scalar(const float* p, size_t begin, size_t n,
+                                        float& mn, float& mx, double& sum,
+                                        size_t& amax, LogitsTopK* topk) {
+    for (size_t i = begin; i < n; ++i) {
+        float v = p[i];
+        if (v < mn) mn = v;
+        if (v > mx) { mx = v; amax = i; }
+        sum += v;
+        if (topk) logits_topk_push(topk, v, static_cast<int32_t>(i));
+    }
+}
+
+// Returns stats over p[0..n). topk may be null; otherwise it must be
+// reset with logits_topk_reset() to the wanted k beforehand.
+static inline LogitsStats logits_reduce(const float* p, size_t n, LogitsTopK* topk = nullptr) {
+    LogitsStats st;
+    st.count = n;
+    if (n == 0) return st;
+
+    float mn = p[0];
+    float mx = p[0];
+    double sum = 0.0;
+    size_t amax = 0;
+    size_t i = 0;
+
+#if defined(LOGITS_REDUCE_AVX2)
+    if (n >= 8) {
+        __m256 vmin = _mm256_loadu_ps(p);
+        __m256 vmax = vmin;
+        __m256i vidx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i vbest = vidx;
+        const __m256i step = _mm256_set1_epi32(8);
+        __m256d s0 = _mm256_setzero_pd();
+        __m256d s1 = _mm256_setzero_pd();
+
+        for (; i + 8 <= n; i += 8) {
+            __m256 v = _mm256_loadu_ps(p + i);
+            vmin = _mm256_min_ps(vmin, v);
+            __m256 gt = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+            vmax = _mm256_blendv_ps(vmax, v, gt);
+            vbest = _mm256_blendv_epi8(vbest, vidx, _mm256_castps_si256(gt));
+            vidx = _mm256_add_epi32(vidx, step);
+            s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+            s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+
+            if (topk) {
+                __m256 thr = _mm256_set1_ps(logits_topk_threshold(topk));
+                int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GT_OQ));
+                while (mask) {
+                    int lane = __builtin_ctz(mask);
+                    logits_topk_push(topk, p[i + lane], static_cast<int32_t>(i + lane));
+                    mask &= mask - 1;
+                }
+            }
+        }
+
+        alignas(32) float lmin[8], lmax[8];
+        alignas(32) int32_t lidx[8];
+        alignas(32) double ls[4];
+        _mm256_store_ps(lmin, vmin);
+        _mm256_store_ps(lmax, vmax);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lidx), vbest);
+        _mm256_store_pd(ls, _mm256_add_pd(s0, s1));
+        mn = lmin[0];
+        mx = lmax[0];
+        amax = static_cast<size_t>(lidx[0]);
+        for (int l = 1; l < 8; ++l) {
+            if (lmin[l] < mn) mn = lmin[l];
+            if (lmax[l] > mx || (lmax[l] == mx && static_cast<size_t>(lidx[l]) < amax)) {
+                mx = lmax[l];
+                amax = static_cast<size_t>(lidx[l]);
+            }
+        }
+        sum = ls[0] + ls[1] + ls[2] + ls[3];
+    }
+#elif defined(LOGITS_REDUCE_NEON)
+    if (n >= 4) {
+        float32x4_t vmin = vld1q_f32(p);
+        float32x4_t vmax = vmin;
+        const uint32_t idx0[4] = {0, 1, 2, 3};
+        uint32x4_t vidx = vld1q_u32(idx0);
+        uint32x4_t vbest = vidx;
+        const uint32x4_t step = vdupq_n_u32(4);
+        float32x4_t vsum = vdupq_n_f32(0.0f);
+        size_t blocks = 0;
+
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t v = vld1q_f32(p + i);
+            vmin = vminq_f32(vmin, v);
+            uint32x4_t gt = vcgtq_f32(v, vmax);
+            vmax = vbslq_f32(gt, v, vmax);
+            vbest = vbslq_u32(gt, vidx, vbest);
+            vidx = vaddq_u32(vidx, step);
+            vsum = vaddq_f32(vsum, v);
+
+            // Flush the float partial sum into double regularly so
+            // long buffers keep the scalar loop's accuracy (armv7 has
+            // no f64 NEON lanes).
+            if (++blocks == 256) {
+                float ps[4];
+                vst1q_f32(ps, vsum);
+                sum += static_cast<double>(ps[0]) + ps[1] + ps[2] + ps[3];
+                vsum = vdupq_n_f32(0.0f);
+                blocks = 0;
+            }
+
+            if (topk) {
+                uint32x4_t m = vcgtq_f32(v, vdupq_n_f32(logits_topk_threshold(topk)));
+                uint32_t lanes[4];
+                vst1q_u32(lanes, m);
+                for (int l = 0; l < 4; ++l) {
+                    if (lanes[l]) logits_topk_push(topk, p[i + l], static_cast<int32_t>(i + l));
+                }
+            }
+        }
+
+        float lmin[4], lmax[4], ps[4];
+        uint32_t lidx[4];
+        vst1q_f32(lmin, vmin);
+        vst1q_f32(lmax, vmax);
+        vst1q_u32(lidx, vbest);
+        vst1q_f32(ps, vsum);
+        sum += static_cast<double>(ps[0]) + ps[1] + ps[2] + ps[3];
+        mn = lmin[0];
+        mx = lmax[0];
+        amax = lidx[0];
+        for (int l = 1; l < 4; ++l) {
+            if (lmin[l] < mn) mn = lmin[l];
+            if (lmax[l] > mx || (lmax[l] == mx && lidx[l] < amax)) {
+                mx = lmax[l];
+                amax = lidx[l];
+            }
+        }
+    }
+#endif
+
+    logits_reduce_scalar(p, i, n, mn, mx, sum, amax, topk);
+
+    st.min = mn;
+    st.max = mx;
+    st.mean = sum / static_cast<double>(n);
+    st.argmax = amax;
+    return st;
+}
+
+// Argmax only: the per-step call in the decode loop.
+static inline size_t logits_argmax(const float* p, size_t n) {
+    return logits_reduce(p, n).argmax;
+}
@@ -1,6 +1,4 @@
-// g++ -std=c++17 main_client_full.cpp -o st_cam_client \
-//   `pkg-config --cflags --libs elementary ewebkit2` \
-//   -lcurl -lcjson -lsmartthings-client
+// Built by CMakeLists.txt (target st_cam_client, linked against st_core).
 //
 // In Tizen Studio, use this as your main.cpp. Adjust CLIENT_ID, CLIENT_SECRET, REDIRECT_URI.
 //
@@ -15,10 +13,20 @@
 #include <cjson/cJSON.h>
 #include <app_common.h>
 #include <dlog.h>
-
+#include "st_base64.h"
+#include "st_http.h"
+#include "st_preview.h"
+#include "st_transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <unistd.h>
 
@@ -35,38 +43,18 @@ static const char* API_BASE      = "https://api.smartthings.com/v1";
 // ----------------------------
 
 // ----------- CURL HELPERS -----------
-struct Buf { std::string data; };
-static size_t write_cb(void* ptr, size_t s, size_t n, void* ud){ ((Buf*)ud)->data.append((const char*)ptr,s*n); return s*n; }
-static void curl_check(CURLcode rc, const char* w){ if(rc!=CURLE_OK){ dlog_print(DLOG_ERROR,LOG_TAG,"%s: %s",w,curl_easy_strerror(rc)); throw std::runtime_error("curl"); } }
+// Requests go through st_core's pooled client: shared connections, retry policy and rate limit.
+static std::string http_call(st_http_req_t& req,const char* what){ st_buf_t m{}; st_http_info_t info; st_http_perform(&req,&m,nullptr,&info); std::string r=m.buf?std::string(m.buf,m.len):std::string(); free(m.buf);
+  if(info.curl_code!=CURLE_OK){ dlog_print(DLOG_ERROR,LOG_TAG,"%s: %s",what,info.circuit_open?"circuit open":curl_easy_strerror((CURLcode)info.curl_code)); throw std::runtime_error("curl"); } return r; }
 static std::string http_post_form(const std::string& url,const std::vector<std::pair<std::string,std::string>>& form,const std::string& u="",const std::string& p=""){
-  CURL* c=curl_easy_init(); if(!c) throw std::runtime_error("curl init"); Buf b;
-  curl_easy_setopt(c,CURLOPT_URL,url.c_str()); curl_easy_setopt(c,CURLOPT_WRITEFUNCTION,write_cb); curl_easy_setopt(c,CURLOPT_WRITEDATA,&b);
-  curl_easy_setopt(c,CURLOPT_POST,1L); curl_easy_setopt(c,CURLOPT_SSL_VERIFYPEER,1L);
-  std::string body; for(size_t i=0;i<form.size();++i){ char* k=curl_easy_escape(c,form[i].first.c_str(),0); char* v=curl_easy_escape(c,form[i].second.c_str(),0); if(i) body+="&"; body+=k; body+="="; body+=v; curl_free(k); curl_free(v);}
-  curl_easy_setopt(c,CURLOPT_POSTFIELDS,body.c_str());
-  struct curl_slist* h=nullptr; h=curl_slist_append(h,"Content-Type: application/x-www-form-urlencoded"); curl_easy_setopt(c,CURLOPT_HTTPHEADER,h);
-  if(!u.empty()){ std::string up=u+":"+p; curl_easy_setopt(c,CURLOPT_HTTPAUTH,CURLAUTH_BASIC); curl_easy_setopt(c,CURLOPT_USERPWD,up.c_str()); }
-  CURLcode rc=curl_easy_perform(c); curl_check(rc,"POST"); curl_slist_free_all(h); curl_easy_cleanup(c); return b.data;
-}
-static std::string http_get_json(const std::string& url,const std::string& bearer){
-  CURL* c=curl_easy_init(); if(!c) throw std::runtime_error("curl init"); Buf b;
-  curl_easy_setopt(c,CURLOPT_URL,url.c_str()); curl_easy_setopt(c,CURLOPT_WRITEFUNCTION,write_cb); curl_easy_setopt(c,CURLOPT_WRITEDATA,&b); curl_easy_setopt(c,CURLOPT_SSL_VERIFYPEER,1L);
-  struct curl_slist* h=nullptr; std::string a="Authorization: Bearer "+bearer; h=curl_slist_append(h,a.c_str()); h=curl_slist_append(h,"Accept: application/json"); curl_easy_setopt(c,CURLOPT_HTTPHEADER,h);
-  CURLcode rc=curl_easy_perform(c); curl_check(rc,"GET"); curl_slist_free_all(h); curl_easy_cleanup(c); return b.data;
-}
-static std::string http_post_json(const std::string& url,const std::string& bearer,const std::string& json){
-  CURL* c=curl_easy_init(); if(!c) throw std::runtime_error("curl init"); Buf b;
-  curl_easy_setopt(c,CURLOPT_URL,url.c_str()); curl_easy_setopt(c,CURLOPT_WRITEFUNCTION,write_cb); curl_easy_setopt(c,CURLOPT_WRITEDATA,&b); curl_easy_setopt(c,CURLOPT_SSL_VERIFYPEER,1L);
-  curl_easy_setopt(c,CURLOPT_POST,1L); curl_easy_setopt(c,CURLOPT_POSTFIELDS,json.c_str());
-  struct curl_slist* h=nullptr; std::string a="Authorization: Bearer "+bearer; h=curl_slist_append(h,a.c_str()); h=curl_slist_append(h,"Content-Type: application/json; charset=utf-8");
-  curl_easy_setopt(c,CURLOPT_HTTPHEADER,h);
-  CURLcode rc=curl_easy_perform(c); curl_check(rc,"POST JSON"); curl_slist_free_all(h); curl_easy_cleanup(c); return b.data;
-}
-static void http_download_binary(const std::string& url,const char* path){
-  CURL* c=curl_easy_init(); if(!c) throw std::runtime_error("curl init"); FILE* fp=fopen(path,"wb"); if(!fp) throw std::runtime_error("fopen");
-  curl_easy_setopt(c,CURLOPT_URL,url.c_str()); curl_easy_setopt(c,CURLOPT_WRITEDATA,fp); curl_easy_setopt(c,CURLOPT_SSL_VERIFYPEER,1L);
-  CURLcode rc=curl_easy_perform(c); curl_check(rc,"DOWNLOAD"); curl_easy_cleanup(c); fclose(fp);
+  std::string body; for(size_t i=0;i<form.size();++i){ char* k=curl_easy_escape(nullptr,form[i].first.c_str(),0); char* v=curl_easy_escape(nullptr,form[i].second.c_str(),0); if(i) body+="&"; body+=k; body+="="; body+=v; curl_free(k); curl_free(v);}
+  std::string basic; if(!u.empty()){ std::string up=u+":"+p; basic.resize(st_b64_encoded_len(up.size())); basic.resize(st_b64_encode((const uint8_t*)up.data(),up.size(),&basic[0])); basic="Basic "+basic; }
+  st_http_req_t req{}; req.url=url.c_str(); req.auth_header=basic.empty()?nullptr:basic.c_str(); req.content_type="application/x-www-form-urlencoded"; req.body=body.c_str(); req.body_len=body.size();
+  return http_call(req,"POST");
 }
+static std::string http_get_json(const std::string& url,const std::string& bearer){ st_http_req_t req{}; req.url=url.c_str(); req.bearer=bearer.c_str(); return http_call(req,"GET"); }
+// checked, resumable, written to <path>.part and renamed: the preview never shows half a JPEG
+static void http_download_binary(const std::string& url,const char* path){ if(!st_http_download(url.c_str(),nullptr,path)){ dlog_print(DLOG_ERROR,LOG_TAG,"DOWNLOAD: %s",url.c_str()); throw std::runtime_error("download"); } }
 // ----------------------------------
 
 // ---------- TOKEN HANDLING ----------
@@ -74,20 +62,36 @@ struct Tokens { std::string access; std::string refresh; };
 static std::string path_join(const std::string& a,const std::string& b){ return a.back()=='/'?a+b:a+"/"+b; }
 static bool save_tokens(const std::string& dir,const Tokens& t){ std::ofstream f(path_join(dir,"tokens.json")); if(!f.good()) return false; f<<"{\"access_token\":\""<<t.access<<"\",\"refresh_token\":\""<<t.refresh<<"\"}"; return true; }
 static bool load_tokens(const std::string& dir,Tokens& t){ std::ifstream f(path_join(dir,"tokens.json")); if(!f.good()) return false; std::string d((std::istreambuf_iterator<char>(f)),{}); cJSON* r=cJSON_Parse(d.c_str()); if(!r) return false; auto* a=cJSON_GetObjectItem(r,"access_token"); auto* rtk=cJSON_GetObjectItem(r,"refresh_token"); if(a&&cJSON_IsString(a)) t.access=a->valuestring; if(rtk&&cJSON_IsString(rtk)) t.refresh=rtk->valuestring; cJSON_Delete(r); return !t.refresh.empty(); }
-static Tokens token_exchange(const std::string& code){ auto r=http_post_form(TOKEN_URL,{{"grant_type","authorization_code"},{"code",code},{"redirect_uri",REDIRECT_URI}},CLIENT_ID,CLIENT_SECRET); cJSON* j=cJSON_Parse(r.c_str()); if(!j) throw std::runtime_error("bad token json"); Tokens t; t.access=cJSON_GetObjectItem(j,"access_token")->valuestring; auto* rr=cJSON_GetObjectItem(j,"refresh_token"); if(rr&&cJSON_IsString(rr)) t.refresh=rr->valuestring; cJSON_Delete(j); return t; }
+static Tokens token_exchange(const std::string& code){ auto r=http_post_form(TOKEN_URL,{{"grant_type","authorization_code"},{"code",code},{"redirect_uri",REDIRECT_URI}},CLIENT_ID,CLIENT_SECRET); cJSON* j=cJSON_Parse(r.c_str()); if(!j) throw std::runtime_error("bad token json"); auto* at=cJSON_GetObjectItem(j,"access_token"); if(!cJSON_IsString(at)){ cJSON_Delete(j); throw std::runtime_error("no access_token: "+r.substr(0,200)); } Tokens t; t.access=at->valuestring; auto* rr=cJSON_GetObjectItem(j,"refresh_token"); if(rr&&cJSON_IsString(rr)) t.refresh=rr->valuestring; cJSON_Delete(j); return t; }
 static Tokens token_refresh(const std::string& refresh){ auto r=http_post_form(TOKEN_URL,{{"grant_type","refresh_token"},{"refresh_token",refresh},{"redirect_uri",REDIRECT_URI}},CLIENT_ID,CLIENT_SECRET); cJSON* j=cJSON_Parse(r.c_str()); if(!j) throw std::runtime_error("bad refresh json"); Tokens t; t.access=cJSON_GetObjectItem(j,"access_token")->valuestring; auto* rr=cJSON_GetObjectItem(j,"refresh_token"); if(rr&&cJSON_IsString(rr)) t.refresh=rr->valuestring; cJSON_Delete(j); return t; }
 // -----------------------------------
 
 // ---------- SMARTTHINGS REST ----------
-struct Device { std::string id,name; bool hasImage=false; };
-static bool has_img(const std::string& tk,const std::string& id){ try{ auto s=http_get_json(std::string(API_BASE)+"/devices/"+id+"/status",tk); return s.find("\"imageCapture\"")!=std::string::npos; }catch(...){return false;} }
-static std::vector<Device> list_devices(const std::string& tk){ std::vector<Device> v; auto r=http_get_json(std::string(API_BASE)+"/devices",tk); cJSON* j=cJSON_Parse(r.c_str()); if(!j) return v; cJSON* items=cJSON_GetObjectItem(j,"items"); if(items&&cJSON_IsArray(items)){ cJSON* it; cJSON_ArrayForEach(it,items){ auto* id=cJSON_GetObjectItem(it,"deviceId"); auto* nm=cJSON_GetObjectItem(it,"name"); if(id&&nm&&cJSON_IsString(id)&&cJSON_IsString(nm)){ Device d; d.id=id->valuestring; d.name=nm->valuestring; d.hasImage=has_img(tk,d.id); v.push_back(d); } } } cJSON_Delete(j); return v; }
-static void take_image(const std::string& tk,const std::string& id){ std::string url=std::string(API_BASE)+"/devices/"+id+"/commands"; std::string body=R"({"commands":[{"component":"main","capability":"imageCapture","command":"take","arguments":[]}]} )"; http_post_json(url,tk,body); }
-static std::string find_snapshot(const std::string& tk,const std::string& id){ auto s=http_get_json(std::string(API_BASE)+"/devices/"+id+"/status",tk); cJSON* j=cJSON_Parse(s.c_str()); if(!j) return ""; auto pick=[&](const char*c,const char*a){ auto* comps=cJSON_GetObjectItem(j,"components"); if(!comps) return (cJSON*)nullptr; auto* main=cJSON_GetObjectItem(comps,"main"); if(!main) return (cJSON*)nullptr; auto* cap=cJSON_GetObjectItem(main,c); if(!cap) return (cJSON*)nullptr; auto* attr=cJSON_GetObjectItem(cap,a); return attr; }; std::string url; for(auto&p:{std::pair<const char*,const char*>{"imageCapture","imageUrl"},{"imageCapture","image"},{"camera","image"}}){ auto* a=pick(p.first,p.second); if(a&&cJSON_IsObject(a)){ auto* v=cJSON_GetObjectItem(a,"value"); if(v&&cJSON_IsString(v)) {url=v->valuestring; break;} } } cJSON_Delete(j); return url; }
+struct Device { std::string id,name; bool hasImage=false; std::vector<std::string> caps; };
+// Status and commands go through st_transport. No local channel is registered (see STClient), so
+// they are answered over REST.
+static std::string device_status(const std::string& tk,const std::string& id){ st_buf_t b{}; st_path_e p=st_transport_status(id.c_str(),tk.empty()?nullptr:tk.c_str(),&b);
+  if(p==ST_PATH_NONE){ dlog_print(DLOG_ERROR,LOG_TAG,"STATUS %s failed",id.c_str()); throw std::runtime_error("status"); } std::string r=b.buf?std::string(b.buf,b.len):std::string(); free(b.buf); return r; }
+static bool has_img(const std::string& tk,const std::string& id){ try{ auto s=device_status(tk,id); return s.find("\"imageCapture\"")!=std::string::npos; }catch(...){return false;} }
+// Capability metadata comes with /devices (items[].components[].capabilities[].id), so no per-device
+// /status call is needed; only items without components fall back to has_img, 8 at a time.
+static std::vector<std::string> caps_of(const cJSON* it){ std::vector<std::string> v; const cJSON* comps=cJSON_GetObjectItem(it,"components"); if(!comps||!cJSON_IsArray(comps)) return v; const cJSON* c; cJSON_ArrayForEach(c,comps){ const cJSON* caps=cJSON_GetObjectItem(c,"capabilities"); const cJSON* k; if(caps&&cJSON_IsArray(caps)) cJSON_ArrayForEach(k,caps){ auto* id=cJSON_GetObjectItem(k,"id"); if(id&&cJSON_IsString(id)&&std::find(v.begin(),v.end(),id->valuestring)==v.end()) v.push_back(id->valuestring); } } return v; }
+static std::vector<Device> list_devices(const std::string& tk){ std::vector<Device> v; std::vector<size_t> unknown; std::string next=std::string(API_BASE)+"/devices";
+  while(!next.empty()){ auto r=http_get_json(next,tk); next.clear(); cJSON* j=cJSON_Parse(r.c_str()); if(!j) break; cJSON* items=cJSON_GetObjectItem(j,"items");
+    if(items&&cJSON_IsArray(items)){ cJSON* it; cJSON_ArrayForEach(it,items){ auto* id=cJSON_GetObjectItem(it,"deviceId"); auto* nm=cJSON_GetObjectItem(it,"name"); if(id&&nm&&cJSON_IsString(id)&&cJSON_IsString(nm)){ Device d; d.id=id->valuestring; d.name=nm->valuestring; if(cJSON_IsArray(cJSON_GetObjectItem(it,"components"))){ d.caps=caps_of(it); d.hasImage=std::find(d.caps.begin(),d.caps.end(),"imageCapture")!=d.caps.end(); } else unknown.push_back(v.size()); v.push_back(d); } } }
+    auto* links=cJSON_GetObjectItem(j,"_links"); auto* nx=links?cJSON_GetObjectItem(links,"next"):nullptr; auto* href=nx?cJSON_GetObjectItem(nx,"href"):nullptr; if(href&&cJSON_IsString(href)&&*href->valuestring) next=href->valuestring; cJSON_Delete(j); }
+  const size_t kFanout=8; for(size_t b=0;b<unknown.size();b+=kFanout){ std::vector<std::future<bool>> f; size_t e=std::min(unknown.size(),b+kFanout); for(size_t k=b;k<e;++k) f.push_back(std::async(std::launch::async,has_img,tk,v[unknown[k]].id)); for(size_t k=b;k<e;++k) v[unknown[k]].hasImage=f[k-b].get(); }
+  return v; }
+static void take_image(const std::string& tk,const std::string& id){ std::string body=R"({"commands":[{"component":"main","capability":"imageCapture","command":"take","arguments":[]}]})"; st_buf_t b{};
+  st_path_e p=st_transport_command(id.c_str(),tk.empty()?nullptr:tk.c_str(),body.c_str(),&b); free(b.buf); if(p==ST_PATH_NONE){ dlog_print(DLOG_ERROR,LOG_TAG,"TAKE %s failed",id.c_str()); throw std::runtime_error("take"); }
+  dlog_print(DLOG_INFO,LOG_TAG,"take %s sent",id.c_str()); }
+static std::string find_snapshot(const std::string& tk,const std::string& id){ auto s=device_status(tk,id); cJSON* j=cJSON_Parse(s.c_str()); if(!j) return ""; auto pick=[&](const char*c,const char*a){ auto* comps=cJSON_GetObjectItem(j,"components"); if(!comps) return (cJSON*)nullptr; auto* main=cJSON_GetObjectItem(comps,"main"); if(!main) return (cJSON*)nullptr; auto* cap=cJSON_GetObjectItem(main,c); if(!cap) return (cJSON*)nullptr; auto* attr=cJSON_GetObjectItem(cap,a); return attr; }; std::string url; for(auto&p:{std::pair<const char*,const char*>{"imageCapture","imageUrl"},{"imageCapture","image"},{"camera","image"}}){ auto* a=pick(p.first,p.second); if(a&&cJSON_IsObject(a)){ auto* v=cJSON_GetObjectItem(a,"value"); if(v&&cJSON_IsString(v)) {url=v->valuestring; break;} } } cJSON_Delete(j); return url; }
 // --------------------------------------
 
 // ---------- SMARTTHINGS CLIENT SDK ----------
-struct STClient{ smartthings_client_h h{}; bool connected=false; };
+// The SDK build this tree targets only exposes session and connection state, no device calls, so
+// it is not registered as st_transport's local channel; that waits for a real status/command binding.
+struct STClient{ smartthings_client_h h{}; std::atomic<bool> connected{false}; };
 static void status_cb(smartthings_client_h,smartthings_client_status_e st,void* ud){ ((STClient*)ud)->connected=(st==SMARTTHINGS_CLIENT_STATUS_CONNECTED); dlog_print(DLOG_INFO,LOG_TAG,"ST Client status=%d",st); }
 static void conn_cb(smartthings_client_h,bool c,void*ud){ ((STClient*)ud)->connected=c; dlog_print(DLOG_INFO,LOG_TAG,"Connection=%d",c); }
 static void init_client(STClient&ctx){ int r=smartthings_client_initialize(&ctx.h,status_cb,&ctx); if(r!=SMARTTHINGS_CLIENT_ERROR_NONE){dlog_print(DLOG_ERROR,LOG_TAG,"init fail %d",r);return;} smartthings_client_set_connection_status_cb(ctx.h,conn_cb,&ctx); r=smartthings_client_start(ctx.h); if(r==SMARTTHINGS_CLIENT_ERROR_NONE)dlog_print(DLOG_INFO,LOG_TAG,"Client started"); }
@@ -103,42 +107,101 @@ struct App {
   Evas_Object* btnCap{};
   Evas_Object* list{};
   Evas_Object* img{};
+  st_preview_t preview{};
   Evas_Object* web{};
 
   std::string dataDir;
   std::string imgPath;
   Tokens tok;
-  std::vector<Device> devs;
-  int sel=-1;
+  // Inventory keyed by deviceId. Entries are heap-allocated and only freed when the
+  // device disappears, so genlist item data stays valid across refreshes.
+  struct Row { Device dev; std::string label; Elm_Object_Item* item{}; };
+  std::vector<std::unique_ptr<Row>> devs;          // API order
+  std::string capFilter;                          // "" -> all, else only devices with this capability
+  bool listReady=false;
+  Row* sel{};
+  Ecore_Thread* capWorker{};
+  Ecore_Thread* authWorker{};
 };
 
-static char* gl_text(void* data,Evas_Object*,const char*){auto*d=(Device*)data; std::string s=d->name+(d->hasImage?" [imageCapture]":""); return strdup(s.c_str());}
-static void gl_sel(void*data,Evas_Object*,void*it){((App*)data)->sel=elm_genlist_item_index_get((Elm_Object_Item*)it)-1;}
+// label is built once per change; realize only copies it (genlist frees the copy)
+static char* gl_text(void* data,Evas_Object*,const char*){return strdup(((App::Row*)data)->label.c_str());}
+static void gl_sel(void*data,Evas_Object*,void*it){((App*)data)->sel=(App::Row*)elm_object_item_data_get((Elm_Object_Item*)it);}
+static std::string dev_label(const Device& d){return d.name+(d.hasImage?" [imageCapture]":"");}
+static bool dev_matches(const App* a,const Device& d){ if(a->capFilter.empty())return true; if(a->capFilter=="imageCapture")return d.hasImage; return std::find(d.caps.begin(),d.caps.end(),a->capFilter)!=d.caps.end(); }
 static std::string urlenc(CURL*c,const std::string&s){char*e=curl_easy_escape(c,s.c_str(),0);std::string r=e?e:"";if(e)curl_free(e);return r;}
 static std::string auth_url(){CURL*c=curl_easy_init();auto u=std::string(AUTH_BASE)+"?response_type=code&client_id="+urlenc(c,CLIENT_ID)+"&redirect_uri="+urlenc(c,REDIRECT_URI)+"&scope="+urlenc(c,SCOPES);curl_easy_cleanup(c);return u;}
 
+// The code exchange (a TLS round trip to the auth host) and the token write run on an
+// ecore_thread worker; the policy callback only picks the code out and returns.
+struct AuthJob{ App* a; std::string code,dir; Tokens tok; std::string err; };
+static void auth_do(void*d,Ecore_Thread*){auto*j=(AuthJob*)d; try{ j->tok=token_exchange(j->code); if(!save_tokens(j->dir,j->tok)) dlog_print(DLOG_WARN,LOG_TAG,"tokens not saved"); }catch(const std::exception&e){ j->err=e.what(); } }
+static void auth_end(void*d,Ecore_Thread*){auto*j=(AuthJob*)d; j->a->authWorker=nullptr;
+  if(j->err.empty()&&!j->tok.access.empty()){ j->a->tok=j->tok; elm_object_text_set(j->a->btnAuth,"Authorized ✓"); }
+  else{ dlog_print(DLOG_ERROR,LOG_TAG,"Auth err %s",j->err.c_str()); elm_object_text_set(j->a->btnAuth,"Authorize (failed, retry)"); } delete j;}
+static void auth_cancel(void*d,Ecore_Thread*){auto*j=(AuthJob*)d; j->a->authWorker=nullptr; delete j;}
 static Eina_Bool nav_cb(Evas_Object*,Ewk_Policy_Decision*d,Ewk_Policy_Navigation_Type, Ewk_Frame_Ref*,void*ud){
   auto*a=(App*)ud; const char* u=ewk_policy_decision_url_get(d); if(!u) return EINA_FALSE; std::string s=u;
-  if(s.rfind(REDIRECT_URI,0)==0){ auto p=s.find("code="); if(p!=std::string::npos){ auto code=s.substr(p+5); auto amp=code.find('&'); if(amp!=std::string::npos)code=code.substr(0,amp);
-      try{ a->tok=token_exchange(code); save_tokens(a->dataDir,a->tok); elm_object_text_set(a->btnAuth,"Authorized ✓"); evas_object_hide(a->web);}catch(const std::exception&e){dlog_print(DLOG_ERROR,LOG_TAG,"Auth err %s",e.what());}} ewk_policy_decision_ignore(d); return EINA_TRUE;}
+  if(s.rfind(REDIRECT_URI,0)==0){ ewk_policy_decision_ignore(d); evas_object_hide(a->web); auto p=s.find("code="); if(p==std::string::npos||a->authWorker) return EINA_TRUE;
+    auto code=s.substr(p+5); auto amp=code.find('&'); if(amp!=std::string::npos)code=code.substr(0,amp);
+    elm_object_text_set(a->btnAuth,"Authorizing…"); auto*j=new AuthJob{a,code,a->dataDir}; a->authWorker=ecore_thread_run(auth_do,auth_end,auth_cancel,j); if(!a->authWorker) delete j; return EINA_TRUE;}
   ewk_policy_decision_use(d); return EINA_TRUE;
 }
 
-static void refresh_preview(App*a){ if(a->imgPath.empty())return; evas_object_image_file_set(a->img,a->imgPath.c_str(),nullptr); evas_object_show(a->img); }
-
-static void btn_auth(void*d,Evas_Object*,void*){auto*a=(App*)d; if(!a->tok.access.empty()){elm_object_text_set(a->btnAuth,"Authorized ✓");return;} evas_object_show(a->web); ewk_view_url_set(a->web,auth_url().c_str());}
-static void btn_list(void*d,Evas_Object*,void*){auto*a=(App*)d; if(a->tok.access.empty())return; a->devs=list_devices(a->tok.access); elm_genlist_clear(a->list);
-  static Elm_Genlist_Item_Class itc; memset(&itc,0,sizeof(itc)); itc.item_style="default"; itc.func.text_get=gl_text;
-  for(auto&x:a->devs) elm_genlist_item_append(a->list,&itc,&x,nullptr,ELM_GENLIST_ITEM_NONE,gl_sel,a);
+// decoded off the main loop at the widget's size; the last frame stays up meanwhile
+static void refresh_preview(App*a){ if(a->imgPath.empty()||!a->img)return; if(!a->preview.img[0]) st_preview_init(&a->preview,a->img); st_preview_set_file(&a->preview,a->imgPath.c_str()); }
+
+// DNS + TLS to the token host are set up while the user is still on the login page,
+// so the exchange after the redirect reuses a warm connection.
+static void prewarm_do(void*d,Ecore_Thread*){ st_http_prewarm((const char*)d); }
+static void btn_auth(void*d,Evas_Object*,void*){auto*a=(App*)d; if(!a->tok.access.empty()){elm_object_text_set(a->btnAuth,"Authorized ✓");return;} if(a->authWorker)return;
+  ecore_thread_run(prewarm_do,nullptr,nullptr,(void*)TOKEN_URL); evas_object_show(a->web); ewk_view_url_set(a->web,auth_url().c_str());}
+// Makes the genlist show exactly the rows passing the filter, in API order, touching only
+// items that have to appear or go. Homogeneous + compress: one row height is measured and
+// only the visible rows are ever realized.
+static void sync_items(App*a){
+  static Elm_Genlist_Item_Class itc; if(!itc.func.text_get){ itc.item_style="default"; itc.func.text_get=gl_text; }
+  if(!a->listReady){ elm_genlist_homogeneous_set(a->list,EINA_TRUE); elm_genlist_mode_set(a->list,ELM_LIST_COMPRESS); a->listReady=true; }
+  Elm_Object_Item* prev=nullptr;
+  for(auto&r:a->devs){ bool show=dev_matches(a,r->dev);
+    if(show&&!r->item) r->item=prev?elm_genlist_item_insert_after(a->list,&itc,r.get(),nullptr,prev,ELM_GENLIST_ITEM_NONE,gl_sel,a)
+                                 :elm_genlist_item_prepend(a->list,&itc,r.get(),nullptr,ELM_GENLIST_ITEM_NONE,gl_sel,a);
+    else if(!show&&r->item){ if(a->sel==r.get())a->sel=nullptr; elm_object_item_del(r->item); r->item=nullptr; }
+    if(r->item) prev=r->item; }
+}
+// Diffs a fresh /devices listing against the inventory by deviceId: new devices get rows,
+// changed names/capabilities update only their own row, vanished ones are removed.
+static void apply_devices(App*a,std::vector<Device>&& fresh){
+  std::unordered_map<std::string,std::unique_ptr<App::Row>> pool; for(auto&r:a->devs){ std::string id=r->dev.id; pool[id]=std::move(r); }
+  std::vector<std::unique_ptr<App::Row>> order; order.reserve(fresh.size());
+  for(auto&d:fresh){ auto f=pool.find(d.id); std::unique_ptr<App::Row> r;
+    if(f!=pool.end()){ r=std::move(f->second); pool.erase(f);
+      bool changed=r->dev.name!=d.name||r->dev.hasImage!=d.hasImage; r->dev=std::move(d);
+      if(changed){ r->label=dev_label(r->dev); if(r->item) elm_genlist_item_update(r->item); } }
+    else { r.reset(new App::Row); r->dev=std::move(d); r->label=dev_label(r->dev); }
+    order.push_back(std::move(r)); }
+  for(auto&left:pool){ if(left.second->item) elm_object_item_del(left.second->item); if(a->sel==left.second.get())a->sel=nullptr; }
+  a->devs=std::move(order);
+  sync_items(a);
 }
-static void btn_cap(void*d,Evas_Object*,void*){auto*a=(App*)d; if(a->tok.access.empty()||a->devs.empty())return; int i=a->sel; if(i<0||i>=(int)a->devs.size()) for(size_t j=0;j<a->devs.size();++j) if(a->devs[j].hasImage){i=j;break;}
-  if(i<0)return; auto&dv=a->devs[i]; if(!dv.hasImage)return; take_image(a->tok.access,dv.id); std::string url; for(int r=0;r<10;++r){ usleep(500000); url=find_snapshot(a->tok.access,dv.id); if(!url.empty())break;}
-  if(url.empty()){ dlog_print(DLOG_INFO,LOG_TAG,"No snapshot URL."); return; } http_download_binary(url,a->imgPath.c_str()); refresh_preview(a); }
+static void btn_list(void*d,Evas_Object*,void*){auto*a=(App*)d; if(a->tok.access.empty())return; apply_devices(a,list_devices(a->tok.access)); }
+// "imageCapture only" check; other capability ids can be set in capFilter the same way.
+static void chk_cap_filter(void*d,Evas_Object*o,void*){auto*a=(App*)d; a->capFilter=elm_check_state_get(o)?"imageCapture":""; sync_items(a); }
+// Capture runs on an ecore_thread worker; only cap_end touches the UI.
+struct CapJob{ App* a; std::string tok,id,path; bool ok=false; };
+static void cap_do(void*d,Ecore_Thread*th){auto*j=(CapJob*)d; try{ std::string prev=find_snapshot(j->tok,j->id); take_image(j->tok,j->id); std::string url;
+  // backoff 250ms..2s, ~20s budget; a frame counts only once the snapshot URL changes
+  for(int waited=0,delay=250; waited<20000&&!ecore_thread_check(th); waited+=delay,delay=std::min(delay*2,2000)){ usleep(delay*1000); url=find_snapshot(j->tok,j->id); if(!url.empty()&&url!=prev)break; url.clear();}
+  if(url.empty()){ dlog_print(DLOG_INFO,LOG_TAG,"No snapshot URL."); return; } http_download_binary(url,j->path.c_str()); j->ok=true; }catch(const std::exception&e){ dlog_print(DLOG_ERROR,LOG_TAG,"Capture err %s",e.what()); } }
+static void cap_end(void*d,Ecore_Thread*){auto*j=(CapJob*)d; j->a->capWorker=nullptr; if(j->ok) refresh_preview(j->a); delete j;}
+static void cap_cancel(void*d,Ecore_Thread*){auto*j=(CapJob*)d; j->a->capWorker=nullptr; delete j;}
+static void btn_cap(void*d,Evas_Object*,void*){auto*a=(App*)d; if(a->capWorker||a->tok.access.empty()||a->devs.empty())return; const Device* dv=a->sel?&a->sel->dev:nullptr; if(!dv) for(auto&r:a->devs) if(r->dev.hasImage){dv=&r->dev;break;}
+  if(!dv||!dv->hasImage)return; auto*j=new CapJob{a,a->tok.access,dv->id,a->imgPath}; a->capWorker=ecore_thread_run(cap_do,cap_end,cap_cancel,j); if(!a->capWorker) delete j; }
 
 static void try_refresh(App*a){Tokens t;if(!load_tokens(a->dataDir,t))return; try{Tokens n=token_refresh(t.refresh); if(n.refresh.empty())n.refresh=t.refresh; a->tok=n; save_tokens(a->dataDir,n); elm_object_text_set(a->btnAuth,"Authorized ✓");}catch(...){;}}
 
 EAPI_MAIN int elm_main(int,char**){
-  curl_global_init(CURL_GLOBAL_DEFAULT);
+  curl_global_init(CURL_GLOBAL_DEFAULT); st_http_init();
   STClient ctx; init_client(ctx);
 
   App a; char*p=app_get_data_path(); a.dataDir=p?p:"/tmp/"; if(p)free(p); a.imgPath=path_join(a.dataDir,"capture.jpg");
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tensor_view.h"
+
+// ============================================================
+// Memory-mapped .npy loader
+//
+// Shared by nump.cpp and onnx_cpp_help.cpp. The file is mapped
+// once and the payload is handed to Ort::Value::CreateTensor
+// in place, so inputs and the embedding table are never copied
+// onto the heap. The mapping is MAP_PRIVATE: pages stay shared
+// with the page cache (and with other decoder processes reading
+// the same file) unless something writes to them.
+//
+// Supports:
+// - v1/v2/v3 headers, any rank
+// - f2/f4/f8/i1/u1/i4/i8/b1 little-endian payloads (see tensor_view.h)
+// - C order (bound directly) and Fortran order (view() reports
+//   Fortran strides; reversed() or ContiguousTensor to bind it)
+// ============================================================
+
+static inline std::string npy_trim_spaces(std::string s) {
+    s.erase(std::remove_if(s.begin(), s.end(), ::isspace), s.end());
+    return s;
+}
+
+static inline std::vector<int64_t> npy_parse_shape(const std::string& header) {
+    auto shape_pos = header.find("shape");
+    if (shape_pos == std::string::npos) {
+        throw std::runtime_error("Could not find shape in .npy header");
+    }
+
+    auto lparen = header.find('(', shape_pos);
+    auto rparen = header.find(')', lparen);
+    if (lparen == std::string::npos || rparen == std::string::npos) {
+        throw std::runtime_error("Could not parse shape tuple in .npy header");
+    }
+
+    std::string inside = header.substr(lparen + 1, rparen - lparen - 1);
+    std::vector<int64_t> dims;
+
+    size_t start = 0;
+    while (start < inside.size()) {
+        size_t comma = inside.find(',', start);
+        std::string token = (comma == std::string::npos)
+            ? inside.substr(start)
+            : inside.substr(start, comma - start);
+
+        token = npy_trim_spaces(token);
+        if (!token.empty()) {
+            dims.push_back(static_cast<int64_t>(std::stoll(token)));
+        }
+
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+
+    return dims;
+}
+
+// Value of a quoted header key, e.g. 'descr': '<f4' -> "<f4".
+static inline std::string npy_header_string(const std::string& header, const char* key) {
+    auto key_pos = header.find(key);
+    if (key_pos == std::string::npos) return "";
+    auto colon = header.find(':', key_pos);
+    if (colon == std::string::npos) return "";
+    auto q1 = header.find_first_of("'\"", colon + 1);
+    if (q1 == std::string::npos) return "";
+    auto q2 = header.find(header[q1], q1 + 1);
+    if (q2 == std::string::npos) return "";
+    return header.substr(q1 + 1, q2 - q1 - 1);
+}
+
+static inline bool npy_header_fortran(const std::string& header) {
+    auto key_pos = header.find("fortran_order");
+    if (key_pos == std::string::npos) return false;
+    auto colon = header.find(':', key_pos);
+    if (colon == std::string::npos) return false;
+    auto val = header.find_first_not_of(" ", colon + 1);
+    return val != std::string::npos && header.compare(val, 4, "True") == 0;
+}
+
+static inline int64_t npy_num_elements(const std::vector<int64_t>& shape) {
+    if (shape.empty()) return 1;
+    return std::accumulate(shape.begin(), shape.end(), int64_t{1}, std::multiplies<int64_t>());
+}
+
+class NpyMapped {
+public:
+    NpyMapped() = default;
+
+    explicit NpyMapped(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open .npy file: " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < 10) {
+            ::close(fd);
+            throw std::runtime_error("Invalid .npy file: too small: " + path);
+        }
+        map_size_ = static_cast<size_t>(st.st_size);
+
+        void* p = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Failed to mmap .npy file: " + path);
+        }
+        base_ = static_cast<char*>(p);
+
+        try {
+            parse_header();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    ~NpyMapped() { unmap(); }
+
+    NpyMapped(const NpyMapped&) = delete;
+    NpyMapped& operator=(const NpyMapped&) = delete;
+
+    NpyMapped(NpyMapped&& o) noexcept { *this = std::move(o); }
+    NpyMapped& operator=(NpyMapped&& o) noexcept {
+        if (this != &o) {
+            unmap();
+            base_ = o.base_;
+            map_size_ = o.map_size_;
+            data_offset_ = o.data_offset_;
+            descr = std::move(o.descr);
+            dtype = o.dtype;
+            fortran_order = o.fortran_order;
+            shape = std::move(o.shape);
+            o.base_ = nullptr;
+            o.map_size_ = 0;
+        }
+        return *this;
+    }
+
+    std::string descr;              // normalized, e.g. "<f4"
+    DType dtype = DType::F32;
+    bool fortran_order = false;
+    std::vector<int64_t> shape;
+
+    size_t payload_bytes() const { return map_size_ - data_offset_; }
+    int64_t element_count() const { return npy_num_elements(shape); }
+
+    // Untyped view over the mapped payload, with the file's layout.
+    TensorView view() const {
+        void* p = base_ + data_offset_;
+        return fortran_order ? TensorView::fortran_order(p, dtype, shape)
+                             : TensorView::c_order(p, dtype, shape);
+    }
+
+    // Typed C-order pointer into the mapping. Checks dtype and size.
+    template <typename T>
+    T* data(size_t* count = nullptr) const {
+        if (fortran_order) {
+            throw std::runtime_error("Fortran-order array: use view() instead of data<T>()");
+        }
+        T* p = view().typed<T>();
+        if (count) *count = static_cast<size_t>(element_count());
+        return p;
+    }
+
+    // Wraps the mapping directly; the NpyMapped must outlive the tensor.
+    template <typename T>
+    Ort::Value as_tensor(const Ort::MemoryInfo& mem_info) const {
+        size_t n = 0;
+        T* p = data<T>(&n);
+        return Ort::Value::CreateTensor<T>(mem_info, p, n, shape.data(), shape.size());
+    }
+
+    // Same, with the element type taken from the file.
+    Ort::Value as_value(const Ort::MemoryInfo& mem_info) const {
+        if (fortran_order) {
+            throw std::runtime_error("Fortran-order array: bind view().reversed() or a ContiguousTensor");
+        }
+        return view().as_ort_value(mem_info);
+    }
+
+    // Hint sequential access for large tables we are about to touch
+    // (optional; a no-op cost if the pages are already resident).
+    void advise_willneed() const {
+        if (base_) ::madvise(base_, map_size_, MADV_WILLNEED);
+    }
+
+    // Gives the resident pages back; the next access reads them from the
+    // file again. Only for mappings nobody wrote to (private copies of
+    // modified pages are discarded too).
+    void advise_dontneed() const {
+        if (base_) ::madvise(base_, map_size_, MADV_DONTNEED);
+    }
+
+private:
+    char* base_ = nullptr;
+    size_t map_size_ = 0;
+    size_t data_offset_ = 0;
+
+    void unmap() {
+        if (base_) ::munmap(base_, map_size_);
+        base_ = nullptr;
+        map_size_ = 0;
+    }
+
+    void parse_header() {
+        if (std::memcmp(base_, "\x93NUMPY", 6) != 0) {
+            throw std::runtime_error("Invalid .npy file: bad magic");
+        }
+
+        uint8_t major = static_cast<uint8_t>(base_[6]);
+        uint32_t header_len = 0;
+        size_t len_bytes = 0;
+        if (major == 1) {
+            uint16_t hl16 = 0;
+            std::memcpy(&hl16, base_ + 8, 2);
+            header_len = hl16;
+            len_bytes = 2;
+        } else if (major == 2 || major == 3) {
+            if (map_size_ < 12) throw std::runtime_error("Failed to read v2/v3 header length");
+            std::memcpy(&header_len, base_ + 8, 4);
+            len_bytes = 4;
+        } else {
+            throw std::runtime_error("Unsupported .npy version");
+        }
+
+        data_offset_ = 8 + len_bytes + header_len;
+        if (data_offset_ >= map_size_) {
+            throw std::runtime_error("No payload data in .npy file");
+        }
+
+        std::string header(base_ + 8 + len_bytes, header_len);
+        shape = npy_parse_shape(header);
+
+        fortran_order = npy_header_fortran(header);
+
+        std::string d = npy_header_string(header, "descr");
+        dtype = dtype_from_npy(d);
+        descr = "<" + d.substr(1);
+
+        if (payload_bytes() < static_cast<size_t>(element_count()) * dtype_size(dtype)) {
+            throw std::runtime_error("Raw byte size does not match expected tensor size");
+        }
+    }
+};
+
+// Writes a C-order v1 .npy, header padded so the payload is 64-byte
+// aligned (mappable in place by NpyMapped). Goes to <path>.tmp and is
+// renamed over path, so readers never see a partial file. False on
+// any I/O error.
+static inline bool npy_write(const std::string& path, DType dtype, const std::vector<int64_t>& shape,
+                             const void* data) {
+    std::string header = std::string("{'descr': '") + dtype_to_npy(dtype) + "', 'fortran_order': False, 'shape': (";
+    for (size_t i = 0; i < shape.size(); ++i) {
+        header += std::to_string(shape[i]);
+        header += shape.size() == 1 || i + 1 < shape.size() ? ", " : "";
+    }
+    header += "), }";
+    size_t total = 10 + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header += '\n';
+    const uint16_t hlen = static_cast<uint16_t>(header.size());
+    const size_t bytes = static_cast<size_t>(npy_num_elements(shape)) * dtype_size(dtype);
+
+    const std::string tmp = path + ".tmp";
+    FILE* fp = std::fopen(tmp.c_str(), "wb");
+    if (!fp) return false;
+    bool ok = std::fwrite("\x93NUMPY\x01\x00", 1, 8, fp) == 8 &&
+              std::fwrite(&hlen, 1, 2, fp) == 2 &&
+              std::fwrite(header.data(), 1, header.size(), fp) == header.size() &&
+              (bytes == 0 || std::fwrite(data, 1, bytes, fp) == bytes);
+    if (std::fclose(fp) != 0) ok = false;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
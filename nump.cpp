@@ -1,246 +1,160 @@
 #include <onnxruntime_cxx_api.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
-#include <cstring>
-#include <fstream>
 #include <iostream>
-#include <numeric>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
-// ============================================================
-// Small .npy loader
-// Supports:
-// - little-endian float32
-// - little-endian int64
-// - C-contiguous arrays
-// ============================================================
+#include "batch_runner.h"
+#include "logits_reduce.h"
+#include "npy_mmap.h"
+#include "ort_profile.h"
+#include "runner_config.h"
 
-struct NpyTensor {
-    std::string descr;
-    bool fortran_order = false;
-    std::vector<int64_t> shape;
-    std::vector<char> raw;
-};
-
-static std::string read_exact(std::ifstream& f, size_t n) {
-    std::string s(n, '\0');
-    f.read(&s[0], static_cast<std::streamsize>(n));
-    if (!f) {
-        throw std::runtime_error("Failed to read expected bytes");
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
     }
-    return s;
-}
-
-static std::string trim_spaces(std::string s) {
-    s.erase(std::remove_if(s.begin(), s.end(), ::isspace), s.end());
-    return s;
+    return nullptr;
 }
 
-static std::vector<int64_t> parse_shape_from_header(const std::string& header) {
-    auto shape_pos = header.find("shape");
-    if (shape_pos == std::string::npos) {
-        throw std::runtime_error("Could not find shape in .npy header");
-    }
-
-    auto lparen = header.find('(', shape_pos);
-    auto rparen = header.find(')', lparen);
-    if (lparen == std::string::npos || rparen == std::string::npos) {
-        throw std::runtime_error("Could not parse shape tuple in .npy header");
-    }
-
-    std::string inside = header.substr(lparen + 1, rparen - lparen - 1);
-    std::vector<int64_t> dims;
-
-    size_t start = 0;
-    while (start < inside.size()) {
-        size_t comma = inside.find(',', start);
-        std::string token = (comma == std::string::npos)
-            ? inside.substr(start)
-            : inside.substr(start, comma - start);
-
-        token = trim_spaces(token);
-        if (!token.empty()) {
-            dims.push_back(static_cast<int64_t>(std::stoll(token)));
-        }
-
-        if (comma == std::string::npos) {
-            break;
-        }
-        start = comma + 1;
-    }
-
-    return dims;
-}
-
-static NpyTensor load_npy(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) {
-        throw std::runtime_error("Failed to open .npy file: " + path);
-    }
-
-    std::string magic = read_exact(f, 6);
-    if (magic != "\x93NUMPY") {
-        throw std::runtime_error("Invalid .npy file: bad magic");
-    }
-
-    uint8_t major = 0;
-    uint8_t minor = 0;
-    f.read(reinterpret_cast<char*>(&major), 1);
-    f.read(reinterpret_cast<char*>(&minor), 1);
-    if (!f) {
-        throw std::runtime_error("Failed to read .npy version");
-    }
-
-    uint32_t header_len = 0;
-    if (major == 1) {
-        uint16_t hl16 = 0;
-        f.read(reinterpret_cast<char*>(&hl16), 2);
-        if (!f) throw std::runtime_error("Failed to read v1 header length");
-        header_len = hl16;
-    } else if (major == 2 || major == 3) {
-        f.read(reinterpret_cast<char*>(&header_len), 4);
-        if (!f) throw std::runtime_error("Failed to read v2/v3 header length");
-    } else {
-        throw std::runtime_error("Unsupported .npy version");
-    }
-
-    std::string header = read_exact(f, header_len);
-
-    NpyTensor t;
-    t.shape = parse_shape_from_header(header);
-
-    if (header.find("fortran_order") != std::string::npos &&
-        header.find("True") != std::string::npos) {
-        throw std::runtime_error("Fortran-order arrays are not supported");
-    }
-    t.fortran_order = false;
-
-    if (header.find("'descr': '<f4'") != std::string::npos ||
-        header.find("\"descr\": \"<f4\"") != std::string::npos ||
-        header.find("'descr': '|f4'") != std::string::npos) {
-        t.descr = "<f4";
-    } else if (header.find("'descr': '<i8'") != std::string::npos ||
-               header.find("\"descr\": \"<i8\"") != std::string::npos ||
-               header.find("'descr': '|i8'") != std::string::npos) {
-        t.descr = "<i8";
-    } else {
-        throw std::runtime_error("Unsupported dtype in .npy header");
-    }
-
-    f.seekg(0, std::ios::end);
-    std::streamoff end_pos = f.tellg();
-    std::streamoff data_pos = 6 + 2 + ((major == 1) ? 2 : 4) + header_len;
-    std::streamoff raw_size = end_pos - data_pos;
-
-    if (raw_size <= 0) {
-        throw std::runtime_error("No payload data in .npy file");
-    }
-
-    t.raw.resize(static_cast<size_t>(raw_size));
-    f.seekg(data_pos, std::ios::beg);
-    f.read(t.raw.data(), raw_size);
-    if (!f) {
-        throw std::runtime_error("Failed to read .npy payload");
+static void print_shape(const std::vector<int64_t>& shape) {
+    std::cout << "[";
+    for (size_t i = 0; i < shape.size(); ++i) {
+        std::cout << shape[i];
+        if (i + 1 < shape.size()) std::cout << ", ";
     }
-
-    return t;
-}
-
-static int64_t num_elements(const std::vector<int64_t>& shape) {
-    if (shape.empty()) return 1;
-    return std::accumulate(shape.begin(), shape.end(), int64_t{1}, std::multiplies<int64_t>());
+    std::cout << "]";
 }
 
 template <typename T>
-static std::vector<T> tensor_as_vector(const NpyTensor& t, const std::string& expected_descr) {
-    if (t.descr != expected_descr) {
-        throw std::runtime_error("Unexpected dtype. Expected " + expected_descr + ", got " + t.descr);
+static void print_first_values(const T* data, size_t elem_count) {
+    std::cout << " first 10 values: ";
+    size_t show_n = std::min<size_t>(10, elem_count);
+    for (size_t j = 0; j < show_n; ++j) {
+        std::cout << data[j] << " ";
     }
-
-    int64_t n = num_elements(t.shape);
-    size_t expected_bytes = static_cast<size_t>(n) * sizeof(T);
-    if (t.raw.size() != expected_bytes) {
-        throw std::runtime_error("Raw byte size does not match expected tensor size");
-    }
-
-    std::vector<T> out(static_cast<size_t>(n));
-    std::memcpy(out.data(), t.raw.data(), expected_bytes);
-    return out;
+    std::cout << "\n";
 }
 
-static void print_shape(const std::vector<int64_t>& shape) {
-    std::cout << "[";
-    for (size_t i = 0; i < shape.size(); ++i) {
-        std::cout << shape[i];
-        if (i + 1 < shape.size()) std::cout << ", ";
+// Integer outputs stay on the plain scalar path.
+template <typename T>
+static void print_int_summary(const T* data, size_t elem_count) {
+    T min_val = data[0];
+    T max_val = data[0];
+    double sum = 0.0;
+    for (size_t j = 0; j < elem_count; ++j) {
+        min_val = std::min(min_val, data[j]);
+        max_val = std::max(max_val, data[j]);
+        sum += static_cast<double>(data[j]);
     }
-    std::cout << "]";
+    std::cout << " min=" << min_val << "\n";
+    std::cout << " max=" << max_val << "\n";
+    std::cout << " mean=" << sum / static_cast<double>(elem_count) << "\n";
+    print_first_values(data, elem_count);
 }
 
 // ============================================================
 // Main
 // ============================================================
 
-int main() {
+// Usage: nump [--config runner.cfg] [--intra-op-threads N] [--providers xnnpack,cpu]
+//             [--warm-start [--opt-cache path]] ...   (see runner_config.h)
+//             [--out results.bin [--zstd LEVEL]]   full outputs, see result_file.h
+//        nump --dir samples/ | --manifest list.txt [--workers N] [--out results.bin]
+//             [--zstd LEVEL]   batch mode, see batch_runner.h
+int main(int argc, char** argv) {
     try {
+        RunnerConfig cfg = runner_config_from_args(argc, argv);
+        cfg.warm.options_tag = runner_config_tag(cfg);
+
         // ------------------------------------------------------------
         // Paths
         // ------------------------------------------------------------
         const std::string onnx_file =
             "./best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi.onnx";
 
+        // ------------------------------------------------------------
+        // Batch mode: many recorded input sets, one process
+        // ------------------------------------------------------------
+        const char* batch_dir = arg_value(argc, argv, "--dir");
+        const char* manifest = arg_value(argc, argv, "--manifest");
+        const char* out_arg = arg_value(argc, argv, "--out");
+        const char* zstd_arg = arg_value(argc, argv, "--zstd");
+        const int zstd_level = zstd_arg ? std::stoi(zstd_arg) : 0;
+        if (batch_dir || manifest) {
+            std::vector<BatchSample> samples = batch_dir ? batch_samples_from_dir(batch_dir)
+                                                         : batch_samples_from_manifest(manifest);
+            const char* workers_arg = arg_value(argc, argv, "--workers");
+            const size_t workers = workers_arg ? std::stoul(workers_arg)
+                                               : std::max(1u, std::thread::hardware_concurrency());
+            ResultWriter results(out_arg ? out_arg : "results.bin", zstd_level);
+
+            Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "decoder_runner");
+            runner_register_arena(env, cfg);
+            runner_config_print(cfg);
+            std::cout << "Batch: " << samples.size() << " samples, " << workers << " workers\n";
+            BatchRunStats st = batch_run(env, cfg, onnx_file, samples, workers, results);
+            std::cout << "Batch finished: " << st.done << " ok, " << st.failed << " failed, "
+                      << st.steals << " steals, " << st.wall_ms << " ms";
+            if (st.wall_ms > 0) std::cout << " (" << st.done * 1000.0 / st.wall_ms << " samples/s)";
+            std::cout << "\n";
+            return st.failed ? 3 : 0;
+        }
+
         const std::string input0_npy = "./input0.npy";   // float32 [1,352,2,8]
         const std::string input1_npy = "./input1.npy";   // int64 [1,1] or float32 [1,1] depending on model
         const std::string input2_npy = "./input2.npy";   // float32 [1,1,256]
         const std::string input3_npy = "./input3.npy";   // float32 [1,1,256]
 
         // ------------------------------------------------------------
-        // Load .npy tensors
+        // Map .npy tensors (payloads stay in the mapping, no copies)
+        //
+        // The element type comes from each file, so input:1 may be
+        // int64 or float32 depending on the model. Fortran-order files
+        // are gathered once into an aligned C-order buffer.
         // ------------------------------------------------------------
-        NpyTensor input0_npy_tensor = load_npy(input0_npy);
-        NpyTensor input1_npy_tensor = load_npy(input1_npy);
-        NpyTensor input2_npy_tensor = load_npy(input2_npy);
-        NpyTensor input3_npy_tensor = load_npy(input3_npy);
-
-        std::vector<float> input0 = tensor_as_vector<float>(input0_npy_tensor, "<f4");
-        std::vector<float> input2 = tensor_as_vector<float>(input2_npy_tensor, "<f4");
-        std::vector<float> input3 = tensor_as_vector<float>(input3_npy_tensor, "<f4");
-
-        // IMPORTANT:
-        // This example assumes your current model expects input:1 as int64.
-        // If your model expects float32 there, switch this to float and adjust
-        // CreateTensor below.
-        std::vector<int64_t> input1 = tensor_as_vector<int64_t>(input1_npy_tensor, "<i8");
+        const std::string input_paths[4] = {input0_npy, input1_npy, input2_npy, input3_npy};
+        auto t_load = std::chrono::steady_clock::now();
+        std::vector<NpyMapped> npy_inputs;
+        std::vector<ContiguousTensor> reordered;
+        std::vector<TensorView> views;
+        reordered.reserve(4);
+        for (const auto& path : input_paths) {
+            npy_inputs.emplace_back(path);
+            TensorView v = npy_inputs.back().view();
+            if (!v.is_c_contiguous()) {
+                reordered.push_back(ContiguousTensor::from(v));
+                v = reordered.back().view;
+            }
+            views.push_back(v);
+        }
+        const double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_load).count();
 
         std::cout << "Loaded inputs from .npy:\n";
-        std::cout << " input0 dtype=float32 shape=";
-        print_shape(input0_npy_tensor.shape);
-        std::cout << "\n";
-
-        std::cout << " input1 dtype=int64 shape=";
-        print_shape(input1_npy_tensor.shape);
-        std::cout << "\n";
-
-        std::cout << " input2 dtype=float32 shape=";
-        print_shape(input2_npy_tensor.shape);
+        for (size_t i = 0; i < views.size(); ++i) {
+            std::cout << " input" << i << " dtype=" << dtype_name(views[i].dtype)
+                      << (npy_inputs[i].fortran_order ? " (fortran->C)" : "") << " shape=";
+            print_shape(views[i].shape);
+            std::cout << "\n";
+        }
         std::cout << "\n";
 
-        std::cout << " input3 dtype=float32 shape=";
-        print_shape(input3_npy_tensor.shape);
-        std::cout << "\n\n";
-
         // ------------------------------------------------------------
         // ONNX Runtime setup
         // ------------------------------------------------------------
         Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "decoder_runner");
         Ort::SessionOptions session_options;
-        session_options.SetIntraOpNumThreads(1);
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        runner_config_print(cfg);
+        runner_config_apply(cfg, session_options);
+        runner_register_arena(env, cfg);
 
-        Ort::Session session(env, onnx_file.c_str(), session_options);
+        Ort::Session session = create_session_warm(
+            env, onnx_file, std::move(session_options),
+            cfg.opt_level, cfg.warm, "decoder_runner");
         Ort::AllocatorWithDefaultOptions allocator;
 
         std::cout << "Model inputs:\n";
@@ -268,38 +182,6 @@ int main() {
         Ort::MemoryInfo mem_info = Ort::MemoryInfo::CreateCpu(
             OrtArenaAllocator, OrtMemTypeDefault);
 
-        Ort::Value input0_tensor = Ort::Value::CreateTensor<float>(
-            mem_info,
-            input0.data(),
-            input0.size(),
-            input0_npy_tensor.shape.data(),
-            input0_npy_tensor.shape.size()
-        );
-
-        Ort::Value input1_tensor = Ort::Value::CreateTensor<int64_t>(
-            mem_info,
-            input1.data(),
-            input1.size(),
-            input1_npy_tensor.shape.data(),
-            input1_npy_tensor.shape.size()
-        );
-
-        Ort::Value input2_tensor = Ort::Value::CreateTensor<float>(
-            mem_info,
-            input2.data(),
-            input2.size(),
-            input2_npy_tensor.shape.data(),
-            input2_npy_tensor.shape.size()
-        );
-
-        Ort::Value input3_tensor = Ort::Value::CreateTensor<float>(
-            mem_info,
-            input3.data(),
-            input3.size(),
-            input3_npy_tensor.shape.data(),
-            input3_npy_tensor.shape.size()
-        );
-
         std::vector<const char*> input_names = {
             "input:0",
             "input:1",
@@ -308,10 +190,9 @@ int main() {
         };
 
         std::vector<Ort::Value> input_tensors;
-        input_tensors.emplace_back(std::move(input0_tensor));
-        input_tensors.emplace_back(std::move(input1_tensor));
-        input_tensors.emplace_back(std::move(input2_tensor));
-        input_tensors.emplace_back(std::move(input3_tensor));
+        for (const auto& v : views) {
+            input_tensors.emplace_back(v.as_ort_value(mem_info));
+        }
 
         std::vector<const char*> output_names = {
             "output:0",
@@ -320,8 +201,15 @@ int main() {
         };
 
         // ------------------------------------------------------------
-        // Run inference
+        // Run inference (latency profile: pinned, after untimed preruns)
         // ------------------------------------------------------------
+        const int pinned = runner_pin_thread(cfg);
+        if (pinned >= 0) std::cout << "[config] inference thread pinned to cpu " << pinned << "\n";
+        for (int i = 0; i < runner_prerun(cfg); ++i) {
+            session.Run(Ort::RunOptions{nullptr}, input_names.data(), input_tensors.data(),
+                        input_tensors.size(), output_names.data(), output_names.size());
+        }
+        auto t_run = std::chrono::steady_clock::now();
         auto outputs = session.Run(
             Ort::RunOptions{nullptr},
             input_names.data(),
@@ -330,6 +218,29 @@ int main() {
             output_names.data(),
             output_names.size()
         );
+        const double run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_run).count();
+
+        // ------------------------------------------------------------
+        // Full outputs to a results file (the summaries below stay)
+        // ------------------------------------------------------------
+        if (out_arg) {
+            std::vector<ResultTensor> tensors(outputs.size());
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                auto info = outputs[i].GetTensorTypeAndShapeInfo();
+                tensors[i].dtype = dtype_from_onnx(info.GetElementType());
+                tensors[i].shape = info.GetShape();
+                tensors[i].data = outputs[i].GetTensorRawData();
+                tensors[i].bytes = info.GetElementCount() * dtype_size(tensors[i].dtype);
+            }
+            ResultMeta meta;
+            meta.model_hash = result_model_hash(onnx_file);
+            meta.load_ms = load_ms;
+            meta.run_ms = run_ms;
+            std::vector<unsigned char> record;
+            ResultWriter results(out_arg, zstd_level);
+            results.append(".", tensors, meta, record);
+            std::cout << "wrote " << outputs.size() << " outputs to " << out_arg << "\n";
+        }
 
         // ------------------------------------------------------------
         // Print output summaries
@@ -347,32 +258,42 @@ int main() {
             std::cout << "\n";
             std::cout << " element_count=" << elem_count << "\n";
 
-            float* data = outputs[i].GetTensorMutableData<float>();
-
-            float min_val = data[0];
-            float max_val = data[0];
-            double sum = 0.0;
-
-            for (size_t j = 0; j < elem_count; ++j) {
-                min_val = std::min(min_val, data[j]);
-                max_val = std::max(max_val, data[j]);
-                sum += data[j];
+            if (elem_count == 0) {
+                continue;
             }
 
-            double mean = sum / static_cast<double>(elem_count);
-
-            std::cout << " min=" << min_val << "\n";
-            std::cout << " max=" << max_val << "\n";
-            std::cout << " mean=" << mean << "\n";
-
-            std::cout << " first 10 values: ";
-            size_t show_n = std::min<size_t>(10, elem_count);
-            for (size_t j = 0; j < show_n; ++j) {
-                std::cout << data[j] << " ";
+            if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+                const float* data = outputs[i].GetTensorData<float>();
+
+                // output:0 carries the logits: also report the top-k
+                LogitsTopK topk;
+                logits_topk_reset(&topk, i == 0 ? 5 : 0);
+                LogitsStats st = logits_reduce(data, elem_count, &topk);
+
+                std::cout << " min=" << st.min << "\n";
+                std::cout << " max=" << st.max << "\n";
+                std::cout << " mean=" << st.mean << "\n";
+                std::cout << " argmax=" << st.argmax << "\n";
+
+                if (topk.filled) {
+                    std::cout << " top" << topk.filled << ":";
+                    for (size_t k = 0; k < topk.filled; ++k) {
+                        std::cout << " " << topk.idx[k] << "(" << topk.val[k] << ")";
+                    }
+                    std::cout << "\n";
+                }
+
+                print_first_values(data, elem_count);
+            } else if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+                print_int_summary(outputs[i].GetTensorData<int64_t>(), elem_count);
+            } else if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32) {
+                print_int_summary(outputs[i].GetTensorData<int32_t>(), elem_count);
+            } else {
+                std::cout << " type=" << info.GetElementType() << " (no summary)\n";
             }
-            std::cout << "\n";
         }
 
+        runner_profile_report(session, cfg, "nump");
         std::cout << "\nfinished\n";
         return 0;
     }
@@ -2,201 +2,162 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <cstring>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "batch_decoder.h"
+#include "decoder_engine.h"
+#include "decoder_spec.h"
+#include "emb_lookup_op.h"
+#include "embedding_table.h"
+#include "ort_profile.h"
+#include "runner_config.h"
+#include "speculative_decoder.h"
+
 // ============================================================
-// Minimal NPY loader for float32 C-contiguous 2D arrays
+// External substitute for Gather_11
+//
+// The table is an EmbeddingTable: the fp32 decoder_emb_weight .npy,
+// or a compact fp16/int8 .embq written by --quantize-emb. Its width
+// is checked against the decoder spec once at load, so the per-step
+// lookups run at the spec's fixed width without re-checking it.
+//
+// With --emb-op the model is the EmbLookup export instead: the same
+// table is read by the st.emb custom op inside session.Run
+// (emb_lookup_op.h) and the model takes int64 token ids as input:1.
 // ============================================================
 
-struct NpyArray2D {
-    std::vector<float> data;
-    size_t rows = 0;
-    size_t cols = 0;
-};
-
-static std::string read_exact(std::ifstream& f, size_t n) {
-    std::string s(n, '\0');
-    f.read(&s[0], static_cast<std::streamsize>(n));
-    if (!f) {
-        throw std::runtime_error("Failed to read expected number of bytes from file");
-    }
-    return s;
-}
-
-static NpyArray2D load_npy_float32_2d(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) {
-        throw std::runtime_error("Failed to open .npy file: " + path);
-    }
-
-    // Magic string
-    std::string magic = read_exact(f, 6);
-    if (magic != "\x93NUMPY") {
-        throw std::runtime_error("Invalid .npy file: bad magic header");
-    }
-
-    // Version
-    uint8_t major = 0;
-    uint8_t minor = 0;
-    f.read(reinterpret_cast<char*>(&major), 1);
-    f.read(reinterpret_cast<char*>(&minor), 1);
-    if (!f) {
-        throw std::runtime_error("Failed to read .npy version");
-    }
-
-    // Header length
-    uint32_t header_len = 0;
-    if (major == 1) {
-        uint16_t hl16 = 0;
-        f.read(reinterpret_cast<char*>(&hl16), 2);
-        if (!f) throw std::runtime_error("Failed to read .npy v1 header length");
-        header_len = hl16;
-    } else if (major == 2 || major == 3) {
-        f.read(reinterpret_cast<char*>(&header_len), 4);
-        if (!f) throw std::runtime_error("Failed to read .npy v2/v3 header length");
-    } else {
-        throw std::runtime_error("Unsupported .npy version");
-    }
-
-    std::string header = read_exact(f, header_len);
-
-    // Very small parser for:
-    // descr: '<f4'
-    // fortran_order: False
-    // shape: (2105, 256)
-    if (header.find("'descr': '<f4'") == std::string::npos &&
-        header.find("\"descr\": \"<f4\"") == std::string::npos &&
-        header.find("'descr': '|f4'") == std::string::npos) {
-        throw std::runtime_error("Expected float32 .npy array");
-    }
-
-    if (header.find("fortran_order") != std::string::npos &&
-        header.find("True") != std::string::npos) {
-        throw std::runtime_error("Fortran-order .npy arrays are not supported in this loader");
-    }
-
-    auto shape_pos = header.find("shape");
-    if (shape_pos == std::string::npos) {
-        throw std::runtime_error("Could not find shape in .npy header");
-    }
-
-    auto lparen = header.find('(', shape_pos);
-    auto comma = header.find(',', lparen);
-    auto comma2 = header.find(',', comma + 1);
-    auto rparen = header.find(')', comma + 1);
-
-    if (lparen == std::string::npos || comma == std::string::npos || rparen == std::string::npos) {
-        throw std::runtime_error("Could not parse 2D shape from .npy header");
-    }
-
-    std::string rows_str = header.substr(lparen + 1, comma - lparen - 1);
-    std::string cols_str = header.substr(comma + 1, rparen - comma - 1);
-
-    auto trim = [](std::string s) {
-        s.erase(std::remove_if(s.begin(), s.end(), ::isspace), s.end());
-        return s;
-    };
-
-    rows_str = trim(rows_str);
-    cols_str = trim(cols_str);
-
-    size_t rows = static_cast<size_t>(std::stoull(rows_str));
-    size_t cols = static_cast<size_t>(std::stoull(cols_str));
-
-    std::vector<float> data(rows * cols);
-    f.read(reinterpret_cast<char*>(data.data()),
-           static_cast<std::streamsize>(data.size() * sizeof(float)));
-    if (!f) {
-        throw std::runtime_error("Failed to read array payload from .npy file");
-    }
+using Spec = DefaultDecoderSpec;
 
-    return {std::move(data), rows, cols};
+// Writes the [1,1,Hidden] row for token_id into dst. Used by the decode
+// loop so each step fills the engine's bound buffer in place.
+static void external_embedding_lookup_into(
+    const EmbeddingTable& emb,
+    int32_t token_id,
+    float* dst
+) {
+    Spec::lookup(emb, token_id, dst);
 }
 
-// ============================================================
-// External substitute for Gather_11
-// ============================================================
-
-static std::vector<float> external_embedding_lookup(
-    const NpyArray2D& emb,
-    int32_t token_id
+// View of the [1,1,Hidden] row for token_id: a hot or mapped row, or the
+// row dequantized into scratch. No allocation per call.
+static const float* external_embedding_lookup(
+    const EmbeddingTable& emb,
+    int32_t token_id,
+    float* scratch
 ) {
-    if (emb.cols != 256) {
-        throw std::runtime_error("Expected embedding width 256");
-    }
+    return emb.row(token_id, scratch);
+}
 
-    if (token_id < 0 || static_cast<size_t>(token_id) >= emb.rows) {
-        std::ostringstream oss;
-        oss << "Token id out of range: " << token_id
-            << " valid range is [0, " << (emb.rows - 1) << "]";
-        throw std::runtime_error(oss.str());
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
     }
-
-    // Output shape must be [1,1,256]
-    std::vector<float> out(1 * 1 * 256);
-
-    const float* src = emb.data.data() + static_cast<size_t>(token_id) * emb.cols;
-    std::memcpy(out.data(), src, 256 * sizeof(float));
-
-    return out;
+    return nullptr;
 }
 
 // ============================================================
 // Example inference with modified ONNX
 // ============================================================
 
-int main() {
+// Usage: onnx_cpp_help [--steps N] [--eos T] [--emb table.npy|table.embq]
+//                      [--model m.onnx] [--batch <max_batch> --requests <num_requests>]
+//                      [--draft draft.onnx [--spec-k K]]   speculative decoding, --model
+//                                                          is then the K-token export
+//                      [--emb-op emb_lookup.onnx]  in-graph lookup (EmbLookup export)
+//                                                  instead of --model
+//                      [--quantize-emb int8|fp16 --out table.embq]
+//                      [--config runner.cfg] [runner options, see runner_config.h]
+int main(int argc, char** argv) {
     try {
+        auto opt = [&](const char* flag, const char* def) {
+            const char* v = arg_value(argc, argv, flag);
+            return std::string(v ? v : def);
+        };
+        const bool batch_mode = arg_value(argc, argv, "--batch") != nullptr;
+        const size_t max_batch = static_cast<size_t>(std::stoul(opt("--batch", "8")));
+        const size_t num_requests = static_cast<size_t>(std::stoul(opt("--requests", "32")));
+        const char* draft_path = arg_value(argc, argv, "--draft");
+        const size_t max_steps = static_cast<size_t>(std::stoul(opt("--steps", batch_mode || draft_path ? "16" : "1")));
+        const int32_t eos_token = static_cast<int32_t>(std::stol(opt("--eos", "-1")));
+        const size_t spec_k = static_cast<size_t>(std::stoul(opt("--spec-k", "4")));
+        const char* emb_op_path = arg_value(argc, argv, "--emb-op");
+        if (emb_op_path && draft_path) {
+            throw std::runtime_error("--draft needs the gather-replaced model, not --emb-op");
+        }
+        const DecoderTokenInput token_mode = emb_op_path ? DecoderTokenInput::TokenId
+                                                         : DecoderTokenInput::Embedding;
+
         // ------------------------------------------------------------
         // Paths
         // ------------------------------------------------------------
-        const std::string model_path =
-            "best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi_gather_replaced.onnx";
+        const std::string model_path = emb_op_path ? std::string(emb_op_path) : opt("--model",
+            "best_eval_epoch_49_decoder_single_legalized_DeleteExpandConstant_GemmToMatMul_surgeon_int64_modi_gather_replaced.onnx");
 
-        const std::string embedding_npy_path =
-            "decoder_emb_weight (1).npy";
+        const std::string embedding_path = opt("--emb", "decoder_emb_weight (1).npy");
 
         // ------------------------------------------------------------
         // Load embedding table
         // ------------------------------------------------------------
-        NpyArray2D embedding = load_npy_float32_2d(embedding_npy_path);
+        EmbeddingTable embedding = EmbeddingTable::load(embedding_path);
+        Spec::check_table(embedding);
 
         std::cout << "Loaded embedding matrix: ["
-                  << embedding.rows << ", " << embedding.cols << "]\n";
+                  << embedding.rows() << ", " << embedding.cols() << "] ("
+                  << embedding.resident_bytes() / 1024 << " KiB)\n";
+
+        // One-shot conversion to a compact table, then exit.
+        if (const char* q = arg_value(argc, argv, "--quantize-emb")) {
+            const std::string fmt = q;
+            const std::string out = opt("--out", fmt == "fp16" ? "decoder_emb_weight.f16.embq"
+                                                               : "decoder_emb_weight.i8.embq");
+            if (fmt != "int8" && fmt != "fp16") {
+                throw std::runtime_error("--quantize-emb must be int8 or fp16");
+            }
+            embedding.write_compact(out, fmt == "fp16" ? EmbFormat::F16 : EmbFormat::I8);
+            std::cout << "Wrote " << fmt << " table: " << out << "\n";
+            return 0;
+        }
 
         // ------------------------------------------------------------
         // Example runtime inputs
         //
         // Replace these with your real tensors in production.
+        // input:0 is zero-filled inside the engine, and input:2/input:3
+        // start from zero state.
         // ------------------------------------------------------------
-        std::vector<float> input0(1 * 352 * 2 * 8, 0.0f);     // input:0
-        std::vector<float> input2(1 * 1 * 256, 0.0f);         // input:2
-        std::vector<float> input3(1 * 1 * 256, 0.0f);         // input:3
 
         // Token id that originally would have gone into input:1
         int32_t token_id = 1;
 
-        // ------------------------------------------------------------
-        // External substitute for Gather_11
-        // ------------------------------------------------------------
-        std::vector<float> embedded_token =
-            external_embedding_lookup(embedding, token_id);
+        // The start and stop tokens are embedded by every sequence.
+        embedding.pin_hot({token_id, eos_token});
+        std::cout << "Hot embedding rows: " << embedding.hot_rows()
+                  << (embedding.hot_locked() ? " (locked)" : "") << "\n";
+        std::vector<float> scratch(Spec::kStateElems);
+        const float* first_row = external_embedding_lookup(embedding, token_id, scratch.data());
+        std::cout << "Embedding row " << token_id << " [0] = " << first_row[0] << "\n";
 
         // ------------------------------------------------------------
         // ONNX Runtime setup
         // ------------------------------------------------------------
         Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "decoder_external_gather");
         Ort::SessionOptions session_options;
-        session_options.SetIntraOpNumThreads(1);
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        RunnerConfig cfg = runner_config_from_args(argc, argv);
+        cfg.warm.options_tag = runner_config_tag(cfg);
+        runner_config_print(cfg);
+        runner_config_apply(cfg, session_options);
+        runner_register_arena(env, cfg);
 
-        Ort::Session session(env, model_path.c_str(), session_options);
+        // Outlives the sessions below; only registered for the EmbLookup export.
+        EmbLookupDomain<Spec::kStateElems> emb_op(embedding);
+        if (emb_op_path) emb_op.add_to(session_options);
+
+        Ort::Session session = create_session_warm(
+            env, model_path, std::move(session_options),
+            cfg.opt_level, cfg.warm, "decoder_external_gather");
 
         Ort::AllocatorWithDefaultOptions allocator;
 
@@ -213,74 +174,111 @@ int main() {
         }
 
         // ------------------------------------------------------------
-        // Prepare tensors
+        // Decode engine
         //
-        // IMPORTANT:
-        // This assumes the modified model inputs are:
+        // The modified model's inputs, checked against Spec here:
         //   input:0         float [1,352,2,8]
-        //   embedded_token  float [1,1,256]
-        //   input:2         float [1,1,256]
-        //   input:3         float [1,1,256]
+        //   embedded_token  float [1,1,256]   (external Gather_11)
+        //     or input:1    int64 [1,1]       (--emb-op, EmbLookup in the graph)
+        //   input:2         float [1,1,256]   (fed from output:1)
+        //   input:3         float [1,1,256]   (fed from output:2)
         // ------------------------------------------------------------
-        std::vector<int64_t> shape_input0 = {1, 352, 2, 8};
-        std::vector<int64_t> shape_emb    = {1, 1, 256};
-        std::vector<int64_t> shape_state  = {1, 1, 256};
-
-        Ort::MemoryInfo mem_info = Ort::MemoryInfo::CreateCpu(
-            OrtArenaAllocator, OrtMemTypeDefault);
-
-        Ort::Value tensor_input0 = Ort::Value::CreateTensor<float>(
-            mem_info, input0.data(), input0.size(),
-            shape_input0.data(), shape_input0.size());
-
-        Ort::Value tensor_emb = Ort::Value::CreateTensor<float>(
-            mem_info, embedded_token.data(), embedded_token.size(),
-            shape_emb.data(), shape_emb.size());
-
-        Ort::Value tensor_input2 = Ort::Value::CreateTensor<float>(
-            mem_info, input2.data(), input2.size(),
-            shape_state.data(), shape_state.size());
-
-        Ort::Value tensor_input3 = Ort::Value::CreateTensor<float>(
-            mem_info, input3.data(), input3.size(),
-            shape_state.data(), shape_state.size());
-
-        std::vector<const char*> input_names = {
-            "input:0",
-            "embedded_token",
-            "input:2",
-            "input:3"
+        DecoderSignature sig = Spec::signature(token_mode);
+        if (!draft_path) Spec::check(session, sig, token_mode);
+
+        DecoderEmbedFn embed = [&embedding](int32_t tok, float* dst) {
+            external_embedding_lookup_into(embedding, tok, dst);
         };
 
-        std::vector<Ort::Value> input_tensors;
-        input_tensors.emplace_back(std::move(tensor_input0));
-        input_tensors.emplace_back(std::move(tensor_emb));
-        input_tensors.emplace_back(std::move(tensor_input2));
-        input_tensors.emplace_back(std::move(tensor_input3));
+        // ------------------------------------------------------------
+        // Speculative mode: the draft decoder runs ahead, the K-token
+        // main model checks K positions per run (speculative_decoder.h)
+        // ------------------------------------------------------------
+        if (draft_path) {
+            Ort::SessionOptions draft_options;
+            runner_config_apply(cfg, draft_options);
+            Ort::Session draft_session = create_session_warm(
+                env, draft_path, std::move(draft_options),
+                cfg.opt_level, cfg.warm, "decoder_draft");
+            Spec::check(draft_session, sig, DecoderTokenInput::Embedding);
+
+            DecoderEngine draft(draft_session, sig, DecoderTokenInput::Embedding, embed);
+            draft.set_prefetch([&embedding](int32_t tok) { embedding.prefetch(tok); });
+            draft.reset_state();
+            SpeculativeDecoder spec(session, sig, spec_k, draft, embed);
+            spec.reset_state();
+
+            std::vector<int32_t> tokens(max_steps);
+            size_t n = spec.run(token_id, max_steps, tokens.data(), eos_token);
+            const SpeculativeStats& st = spec.stats();
+            std::cout << "Decoded tokens:";
+            for (size_t i = 0; i < n; ++i) std::cout << " " << tokens[i];
+            std::cout << "\n";
+            std::cout << "Speculative (k=" << spec_k << "): " << st.main_runs << " main runs, "
+                      << st.draft_steps << " draft steps, acceptance "
+                      << st.acceptance_rate() * 100.0 << "% (" << st.accepted << "/" << st.proposed
+                      << "), " << st.tokens_per_main_run() << " tokens per main run\n";
+            runner_profile_report(session, cfg, "decoder_verifier");
+            runner_profile_report(draft_session, cfg, "decoder_draft");
+            std::cout << "Inference finished successfully.\n";
+            return 0;
+        }
+
+        // ------------------------------------------------------------
+        // Batched mode: continuous batching over num_requests sequences
+        // (model must have a dynamic batch dimension)
+        // ------------------------------------------------------------
+        if (batch_mode) {
+            // without an embed function the ids go in as [B,1] and EmbLookup gathers the rows
+            BatchDecoder batch(session, sig, max_batch, emb_op_path ? nullptr : embed);
+            for (size_t r = 0; r < num_requests; ++r) {
+                BatchRequest req;
+                req.id = static_cast<int64_t>(r);
+                req.first_token = token_id;
+                req.max_steps = max_steps;
+                req.eos_token = eos_token;
+                batch.submit(req);
+            }
+
+            std::vector<BatchResult> done;
+            size_t runs = 0;
+            while (!batch.idle()) {
+                batch.step(done);
+                ++runs;
+            }
+
+            std::cout << "Batched decode: " << done.size() << " sequences in "
+                      << runs << " session runs (max_batch=" << max_batch << ")\n";
+            for (const auto& r : done) {
+                std::cout << "  seq " << r.id << ":";
+                for (int32_t t : r.tokens) std::cout << " " << t;
+                std::cout << "\n";
+            }
+            runner_profile_report(session, cfg, "decoder_batch");
+            std::cout << "Inference finished successfully.\n";
+            return 0;
+        }
 
-        std::vector<const char*> output_names = {
-            "output:0",
-            "output:1",
-            "output:2"
-        };
+        DecoderEngine engine(session, sig, token_mode, embed);
+        engine.set_prefetch([&embedding](int32_t tok) { embedding.prefetch(tok); });
+        const int pinned = runner_pin_thread(cfg);
+        if (pinned >= 0) std::cout << "[config] inference thread pinned to cpu " << pinned << "\n";
+        for (int i = 0; i < runner_prerun(cfg); ++i) {
+            engine.reset_state();
+            engine.step(token_id);
+        }
+        engine.reset_state();
 
         // ------------------------------------------------------------
-        // Run inference
+        // Run inference: first step, then greedy steps if requested
         // ------------------------------------------------------------
-        auto outputs = session.Run(
-            Ort::RunOptions{nullptr},
-            input_names.data(),
-            input_tensors.data(),
-            input_tensors.size(),
-            output_names.data(),
-            output_names.size());
+        int32_t next_token = engine.step(token_id);
 
         // ------------------------------------------------------------
         // Inspect output:0 (logits)
         // ------------------------------------------------------------
-        float* logits = outputs[0].GetTensorMutableData<float>();
-        auto logits_info = outputs[0].GetTensorTypeAndShapeInfo();
-        auto logits_shape = logits_info.GetShape();
+        const float* logits = engine.logits();
+        const auto& logits_shape = engine.logits_shape();
 
         std::cout << "output:0 shape = [";
         for (size_t i = 0; i < logits_shape.size(); ++i) {
@@ -290,12 +288,22 @@ int main() {
         std::cout << "]\n";
 
         std::cout << "First 10 logits: ";
-        size_t num_logits = logits_info.GetElementCount();
+        size_t num_logits = engine.vocab();
         for (size_t i = 0; i < std::min<size_t>(10, num_logits); ++i) {
             std::cout << logits[i] << " ";
         }
         std::cout << "\n";
+        std::cout << "argmax token: " << next_token << "\n";
+
+        if (max_steps > 1) {
+            std::vector<int32_t> tokens(max_steps - 1);
+            size_t n = engine.run(next_token, tokens.size(), tokens.data(), eos_token);
+            std::cout << "Decoded tokens:";
+            for (size_t i = 0; i < n; ++i) std::cout << " " << tokens[i];
+            std::cout << "\n";
+        }
 
+        runner_profile_report(session, cfg, "decoder_external_gather");
         std::cout << "Inference finished successfully.\n";
         return 0;
     }
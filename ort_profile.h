@@ -0,0 +1,246 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "runner_config.h"
+
+// ============================================================
+// Per-operator profile reports
+//
+// With profile=<prefix> (--profile prefix) runner_config_apply turns
+// on SessionOptions::EnableProfiling; ORT then writes a Chrome trace
+// (prefix_<date>.json) when the session ends profiling. This header
+// reads that trace back:
+//   every "Node" event named <node>_kernel_time is one kernel run,
+//   every "model_run" event one session.Run
+// and folds it into per-node and per-op-type costs, normalized per
+// run so profiles with different run counts compare.
+//
+// runner_profile_report() ends profiling on a session, prints the
+// top-N nodes and the op-type rollup, and with profile_baseline set
+// diffs against the stored baseline (a small TSV), or records it when
+// the file does not exist yet. Graph surgery (Gather_11 taken out,
+// GemmToMatMul) shows up as removed nodes and shifted op-type totals.
+// ============================================================
+
+struct ProfileOp {
+    std::string node;
+    std::string op;
+    size_t calls = 0;
+    double total_us = 0;
+};
+
+struct ProfileReport {
+    std::vector<ProfileOp> nodes;       // sorted by total_us, largest first
+    size_t runs = 0;
+    double run_us = 0;                  // sum of model_run durations
+    double kernel_us = 0;               // sum over nodes
+
+    double per_run(double us) const { return runs ? us / runs : us; }
+    std::map<std::string, double> by_op() const {
+        std::map<std::string, double> m;
+        for (const auto& n : nodes) m[n.op] += n.total_us;
+        return m;
+    }
+};
+
+// Value of "key" inside one trace event: a string (unquoted), or the
+// raw number. Empty when absent.
+static inline std::string profile_field(const std::string& ev, const char* key) {
+    const std::string k = std::string("\"") + key + "\"";
+    size_t p = ev.find(k);
+    if (p == std::string::npos) return "";
+    p = ev.find(':', p + k.size());
+    if (p == std::string::npos) return "";
+    p = ev.find_first_not_of(" \t\r\n", p + 1);
+    if (p == std::string::npos) return "";
+    if (ev[p] == '"') {
+        std::string out;
+        for (size_t i = p + 1; i < ev.size() && ev[i] != '"'; ++i) {
+            if (ev[i] == '\\' && i + 1 < ev.size()) ++i;
+            out += ev[i];
+        }
+        return out;
+    }
+    size_t e = ev.find_first_of(",}", p);
+    return ev.substr(p, e == std::string::npos ? std::string::npos : e - p);
+}
+
+static inline ProfileReport profile_parse(const std::string& trace_path) {
+    std::ifstream f(trace_path, std::ios::binary);
+    if (!f) throw std::runtime_error("Failed to open profile trace: " + trace_path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    const std::string doc = ss.str();
+
+    static const std::string kSuffix = "_kernel_time";
+    std::map<std::string, ProfileOp> nodes;
+    ProfileReport r;
+
+    // top-level events are the objects at depth 1 of the trace array
+    int depth = 0;
+    bool in_str = false;
+    size_t start = 0;
+    for (size_t i = 0; i < doc.size(); ++i) {
+        char c = doc[i];
+        if (in_str) {
+            if (c == '\\') ++i;
+            else if (c == '"') in_str = false;
+            continue;
+        }
+        if (c == '"') in_str = true;
+        else if (c == '{' && depth++ == 0) start = i;
+        else if (c == '}' && --depth == 0) {
+            const std::string ev = doc.substr(start, i + 1 - start);
+            const std::string cat = profile_field(ev, "cat");
+            const std::string name = profile_field(ev, "name");
+            const double dur = std::atof(profile_field(ev, "dur").c_str());
+            if (cat == "Session" && name == "model_run") {
+                ++r.runs;
+                r.run_us += dur;
+            } else if (cat == "Node" && name.size() > kSuffix.size() &&
+                       name.compare(name.size() - kSuffix.size(), kSuffix.size(), kSuffix) == 0) {
+                ProfileOp& op = nodes[name.substr(0, name.size() - kSuffix.size())];
+                if (op.op.empty()) op.op = profile_field(ev, "op_name");
+                ++op.calls;
+                op.total_us += dur;
+                r.kernel_us += dur;
+            }
+        }
+    }
+
+    for (auto& kv : nodes) {
+        kv.second.node = kv.first;
+        r.nodes.push_back(kv.second);
+    }
+    std::sort(r.nodes.begin(), r.nodes.end(),
+              [](const ProfileOp& a, const ProfileOp& b) { return a.total_us > b.total_us; });
+    return r;
+}
+
+// Baseline file: "# runs N" then node, op, calls, total_us per line.
+static inline void profile_save(const ProfileReport& r, const std::string& path) {
+    std::ofstream f(path);
+    if (!f) throw std::runtime_error("Failed to write profile baseline: " + path);
+    f << "# runs " << r.runs << "\n";
+    for (const auto& n : r.nodes) f << n.node << "\t" << n.op << "\t" << n.calls << "\t" << n.total_us << "\n";
+}
+
+static inline ProfileReport profile_load(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) throw std::runtime_error("Failed to open profile baseline: " + path);
+    ProfileReport r;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.rfind("# runs ", 0) == 0) {
+            r.runs = static_cast<size_t>(std::stoul(line.substr(7)));
+            continue;
+        }
+        std::istringstream in(line);
+        ProfileOp op;
+        if (std::getline(in, op.node, '\t') && std::getline(in, op.op, '\t') && in >> op.calls >> op.total_us) {
+            r.kernel_us += op.total_us;
+            r.nodes.push_back(op);
+        }
+    }
+    return r;
+}
+
+static inline void profile_print(const ProfileReport& r, const std::string& label, size_t top) {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "[profile] " << label << ": " << r.runs << " runs, " << r.per_run(r.run_us)
+              << " us/run, kernels " << r.per_run(r.kernel_us) << " us/run\n";
+    std::cout << "[profile]   " << std::left << std::setw(40) << "node" << std::setw(16) << "op"
+              << std::right << std::setw(12) << "us/run" << std::setw(8) << "share" << "\n";
+    for (size_t i = 0; i < r.nodes.size() && i < top; ++i) {
+        const ProfileOp& n = r.nodes[i];
+        std::cout << "[profile]   " << std::left << std::setw(40) << n.node << std::setw(16) << n.op
+                  << std::right << std::setw(12) << r.per_run(n.total_us) << std::setw(7)
+                  << (r.kernel_us > 0 ? 100.0 * n.total_us / r.kernel_us : 0.0) << "%\n";
+    }
+    std::cout << "[profile]   by op type:";
+    const std::map<std::string, double> by_op = r.by_op();
+    std::vector<std::pair<std::string, double>> ops(by_op.begin(), by_op.end());
+    std::sort(ops.begin(), ops.end(), [](const std::pair<std::string, double>& a,
+                                         const std::pair<std::string, double>& b) { return a.second > b.second; });
+    for (const auto& o : ops) std::cout << " " << o.first << "=" << r.per_run(o.second);
+    std::cout << "\n";
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// Per-run cost of cur against base: the top-N nodes of either side
+// (missing on one side: "new" / "removed"), then every op type.
+static inline void profile_diff(const ProfileReport& base, const ProfileReport& cur,
+                                const std::string& label, size_t top) {
+    std::map<std::string, const ProfileOp*> b, c;
+    for (const auto& n : base.nodes) b[n.node] = &n;
+    for (const auto& n : cur.nodes) c[n.node] = &n;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < cur.nodes.size() && i < top; ++i) names.push_back(cur.nodes[i].node);
+    for (size_t i = 0; i < base.nodes.size() && i < top; ++i) {
+        if (!c.count(base.nodes[i].node)) names.push_back(base.nodes[i].node);
+    }
+
+    auto row = [](const std::string& name, double was, double now, bool in_b, bool in_c) {
+        std::cout << "[profile]   " << std::left << std::setw(40) << name << std::right
+                  << std::setw(12) << was << std::setw(12) << now;
+        if (!in_b) std::cout << "   new";
+        else if (!in_c) std::cout << "   removed";
+        else if (was > 0) std::cout << std::setw(9) << std::showpos << 100.0 * (now - was) / was << std::noshowpos << "%";
+        std::cout << "\n";
+    };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "[profile] " << label << " vs baseline, us/run: kernels " << base.per_run(base.kernel_us)
+              << " -> " << cur.per_run(cur.kernel_us) << "\n";
+    for (const auto& name : names) {
+        bool in_b = b.count(name) != 0, in_c = c.count(name) != 0;
+        row(name, in_b ? base.per_run(b[name]->total_us) : 0.0, in_c ? cur.per_run(c[name]->total_us) : 0.0,
+            in_b, in_c);
+    }
+    std::map<std::string, double> bo = base.by_op(), co = cur.by_op();
+    std::map<std::string, bool> all;
+    for (const auto& kv : bo) all[kv.first] = true;
+    for (const auto& kv : co) all[kv.first] = true;
+    std::cout << "[profile]   by op type:\n";
+    for (const auto& kv : all) {
+        bool in_b = bo.count(kv.first) != 0, in_c = co.count(kv.first) != 0;
+        row("  " + kv.first, base.per_run(bo[kv.first]), cur.per_run(co[kv.first]), in_b, in_c);
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// Ends profiling on session and reports it; returns the parsed profile
+// (empty when profiling is off).
+static inline ProfileReport runner_profile_report(Ort::Session& session, const RunnerConfig& cfg,
+                                                  const std::string& label) {
+    if (cfg.profile.empty()) return ProfileReport();
+    Ort::AllocatorWithDefaultOptions allocator;
+    auto trace = session.EndProfilingAllocated(allocator);
+    std::cout << "[profile] " << label << " trace: " << trace.get() << "\n";
+    ProfileReport r = profile_parse(trace.get());
+    profile_print(r, label, static_cast<size_t>(cfg.profile_top));
+
+    if (!cfg.profile_baseline.empty()) {
+        std::ifstream probe(cfg.profile_baseline);
+        if (probe) {
+            profile_diff(profile_load(cfg.profile_baseline), r, label, static_cast<size_t>(cfg.profile_top));
+        } else {
+            profile_save(r, cfg.profile_baseline);
+            std::cout << "[profile] baseline recorded: " << cfg.profile_baseline << "\n";
+        }
+    }
+    return r;
+}
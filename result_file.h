@@ -0,0 +1,384 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(USE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "npy_mmap.h"
+#include "tensor_view.h"
+
+// ============================================================
+// Append-only results file
+//
+// Full decoder outputs for offline analysis, instead of scraping the
+// printed summaries. One record per sample, each self-delimiting and
+// a multiple of 64 bytes, so records and payloads stay 64-byte aligned
+// in the file. Several workers (and processes: the fd is O_APPEND, a
+// record goes out in one write(), and a new file is linked into place
+// with its header) can append to one file, and a reader maps it and
+// reads payloads in place.
+//
+//   file header, 64 bytes: "STRESULT", u32 version, zero padding
+//   record:
+//     u32 'SREC'  u32 tensor_count
+//     u64 record_bytes               including header and padding
+//     u64 model_hash                 result_model_hash() of the model
+//     i64 unix_ns                    when the record was written
+//     f64 load_ms  f64 run_ms        input mapping, session.Run
+//     u32 name_len  u32 0
+//     name bytes, zero-padded to 8
+//     per tensor:
+//       u32 dtype (DType)  u32 ndim
+//       i64 dims[ndim]
+//       u32 codec (0 raw, 1 zstd)  u32 0
+//       u64 bytes  u64 stored_bytes  u64 offset (from the record start)
+//     payloads, each 64-byte aligned
+//
+// zstd needs a build with -DUSE_ZSTD (and -lzstd); raw records are
+// always readable. Little-endian, as written by the host.
+// ResultReader walks a file; ResultReader::export_npy writes one
+// tensor as .npy for numpy.
+// ============================================================
+
+static const char kResultFileMagic[8] = {'S', 'T', 'R', 'E', 'S', 'U', 'L', 'T'};
+static const uint32_t kResultFileVersion = 2;
+static const uint32_t kResultRecordMagic = 0x43455253u;    // "SREC"
+
+enum class ResultCodec : uint32_t { Raw = 0, Zstd = 1 };
+
+struct ResultMeta {
+    uint64_t model_hash = 0;
+    double load_ms = 0;
+    double run_ms = 0;
+    int64_t unix_ns = 0;            // filled in by append() when 0
+};
+
+struct ResultTensor {
+    DType dtype = DType::F32;
+    std::vector<int64_t> shape;
+    const void* data = nullptr;
+    size_t bytes = 0;
+};
+
+// FNV-1a over the model file, so results name the exact weights.
+static inline uint64_t result_model_hash(const std::string& path) {
+    uint64_t h = 1469598103934665603ULL;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    void* p = ::fstat(fd, &st) == 0 && st.st_size > 0
+        ? ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) return 0;
+    const unsigned char* b = static_cast<const unsigned char*>(p);
+    for (off_t i = 0; i < st.st_size; ++i) {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+    ::munmap(p, static_cast<size_t>(st.st_size));
+    return h;
+}
+
+class ResultWriter {
+public:
+    // level 0 stores payloads raw; > 0 is the zstd level.
+    explicit ResultWriter(const std::string& path, int zstd_level = 0) : path_(path), level_(zstd_level) {
+#if !defined(USE_ZSTD)
+        if (level_ > 0) {
+            throw std::runtime_error("zstd support not compiled in (build with -DUSE_ZSTD)");
+        }
+#endif
+        if (!create(path)) throw std::runtime_error("Failed to create results file: " + path);
+        fd_ = ::open(path.c_str(), O_WRONLY | O_APPEND);
+        if (fd_ < 0) throw std::runtime_error("Failed to open results file: " + path);
+        // an empty file that was already there (touch, shell redirect)
+        if (::lseek(fd_, 0, SEEK_END) == 0 && !write_all(header().data(), 64)) {
+            throw std::runtime_error("Failed to write results file: " + path);
+        }
+    }
+
+    ~ResultWriter() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    // Serializes (and compresses) into the caller's buffer, reused
+    // between calls, then appends it in one write under the lock.
+    void append(const std::string& sample, const std::vector<ResultTensor>& tensors, ResultMeta meta,
+                std::vector<unsigned char>& buf) {
+        if (!meta.unix_ns) {
+            meta.unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        encode(sample, tensors, meta, buf);
+        std::lock_guard<std::mutex> lock(mu_);
+        if (!write_all(buf.data(), buf.size())) {
+            throw std::runtime_error("Failed to append to results file: " + path_);
+        }
+    }
+
+private:
+    std::string path_;
+    int level_ = 0;
+    int fd_ = -1;
+    std::mutex mu_;
+
+    // A new file appears with its header already in it: the header goes
+    // to a private temp file that is then link()ed into place, which
+    // fails with EEXIST for everyone but the first writer. Opening with
+    // O_CREAT and writing the header after would let a second process
+    // see the empty file and write a second header (or append a record
+    // before the first one).
+    static bool create(const std::string& path) {
+        if (::access(path.c_str(), F_OK) == 0) return true;
+        const std::string tmp = path + ".new." + std::to_string(::getpid()) + "." +
+            std::to_string(reinterpret_cast<uintptr_t>(&tmp));
+        const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return false;
+        bool ok = write_fd(fd, header().data(), 64);
+        ok = ::close(fd) == 0 && ok;
+        ok = ok && (::link(tmp.c_str(), path.c_str()) == 0 || errno == EEXIST);
+        ::unlink(tmp.c_str());
+        return ok;
+    }
+
+    static std::vector<unsigned char> header() {
+        std::vector<unsigned char> h(64, 0);
+        std::memcpy(h.data(), kResultFileMagic, sizeof(kResultFileMagic));
+        std::memcpy(h.data() + 8, &kResultFileVersion, sizeof(kResultFileVersion));
+        return h;
+    }
+
+    bool write_all(const void* p, size_t n) { return write_fd(fd_, p, n); }
+
+    static bool write_fd(int fd, const void* p, size_t n) {
+        const char* c = static_cast<const char*>(p);
+        while (n) {
+            ssize_t w = ::write(fd, c, n);
+            if (w <= 0) return false;
+            c += w;
+            n -= static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    template <typename T>
+    static void put(std::vector<unsigned char>& buf, T v) {
+        const size_t at = buf.size();
+        buf.resize(at + sizeof(T));
+        std::memcpy(buf.data() + at, &v, sizeof(T));
+    }
+
+    template <typename T>
+    static void patch(std::vector<unsigned char>& buf, size_t at, T v) {
+        std::memcpy(buf.data() + at, &v, sizeof(T));
+    }
+
+    static void align(std::vector<unsigned char>& buf, size_t a) { buf.resize((buf.size() + a - 1) / a * a, 0); }
+
+    void encode(const std::string& sample, const std::vector<ResultTensor>& tensors, const ResultMeta& meta,
+                std::vector<unsigned char>& buf) const {
+        buf.clear();
+        put<uint32_t>(buf, kResultRecordMagic);
+        put<uint32_t>(buf, static_cast<uint32_t>(tensors.size()));
+        put<uint64_t>(buf, 0);
+        put<uint64_t>(buf, meta.model_hash);
+        put<int64_t>(buf, meta.unix_ns);
+        put<double>(buf, meta.load_ms);
+        put<double>(buf, meta.run_ms);
+        put<uint32_t>(buf, static_cast<uint32_t>(sample.size()));
+        put<uint32_t>(buf, 0);
+        buf.insert(buf.end(), sample.begin(), sample.end());
+        align(buf, 8);
+
+        std::vector<size_t> field_at(tensors.size());
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            const ResultTensor& t = tensors[i];
+            put<uint32_t>(buf, static_cast<uint32_t>(t.dtype));
+            put<uint32_t>(buf, static_cast<uint32_t>(t.shape.size()));
+            for (int64_t d : t.shape) put<int64_t>(buf, d);
+            put<uint32_t>(buf, static_cast<uint32_t>(ResultCodec::Raw));
+            put<uint32_t>(buf, 0);
+            put<uint64_t>(buf, t.bytes);
+            field_at[i] = buf.size();
+            put<uint64_t>(buf, 0);      // stored_bytes
+            put<uint64_t>(buf, 0);      // offset
+        }
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            align(buf, 64);
+            const size_t at = buf.size();
+            size_t stored = tensors[i].bytes;
+            const unsigned char* p = static_cast<const unsigned char*>(tensors[i].data);
+            if (level_ > 0) {
+#if defined(USE_ZSTD)
+                buf.resize(at + ZSTD_compressBound(tensors[i].bytes));
+                stored = ZSTD_compress(buf.data() + at, buf.size() - at, p, tensors[i].bytes, level_);
+                if (ZSTD_isError(stored)) {
+                    throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(stored));
+                }
+                if (stored < tensors[i].bytes) {
+                    buf.resize(at + stored);
+                    patch<uint32_t>(buf, field_at[i] - 16, static_cast<uint32_t>(ResultCodec::Zstd));
+                } else {
+                    // incompressible (tiny outputs): stored raw
+                    stored = tensors[i].bytes;
+                    buf.resize(at);
+                    buf.insert(buf.end(), p, p + stored);
+                }
+#endif
+            } else {
+                buf.insert(buf.end(), p, p + stored);
+            }
+            patch<uint64_t>(buf, field_at[i], stored);
+            patch<uint64_t>(buf, field_at[i] + 8, at);
+        }
+        align(buf, 64);
+        patch<uint64_t>(buf, 8, buf.size());
+    }
+};
+
+class ResultReader {
+public:
+    struct Tensor {
+        DType dtype = DType::F32;
+        std::vector<int64_t> shape;
+        ResultCodec codec = ResultCodec::Raw;
+        size_t bytes = 0;
+        const unsigned char* stored = nullptr;
+        size_t stored_bytes = 0;
+
+        // In place for raw payloads; zstd payloads are decoded into scratch.
+        const void* data(std::vector<unsigned char>& scratch) const {
+            if (codec == ResultCodec::Raw) return stored;
+#if defined(USE_ZSTD)
+            scratch.resize(bytes);
+            size_t n = ZSTD_decompress(scratch.data(), bytes, stored, stored_bytes);
+            if (ZSTD_isError(n) || n != bytes) throw std::runtime_error("results file: corrupt zstd payload");
+            return scratch.data();
+#else
+            (void)scratch;
+            throw std::runtime_error("zstd support not compiled in (build with -DUSE_ZSTD)");
+#endif
+        }
+    };
+
+    struct Record {
+        std::string name;
+        ResultMeta meta;
+        std::vector<Tensor> tensors;
+    };
+
+    explicit ResultReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open results file: " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < 64) {
+            ::close(fd);
+            throw std::runtime_error("Invalid results file: too small: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap results file: " + path);
+        base_ = static_cast<const unsigned char*>(p);
+        try {
+            index();
+        } catch (...) {
+            ::munmap(const_cast<unsigned char*>(base_), size_);
+            throw;
+        }
+    }
+
+    ~ResultReader() { ::munmap(const_cast<unsigned char*>(base_), size_); }
+
+    ResultReader(const ResultReader&) = delete;
+    ResultReader& operator=(const ResultReader&) = delete;
+
+    const std::vector<Record>& records() const { return records_; }
+
+    // A record cut short by a crash while appending is dropped, not an error.
+    bool truncated() const { return truncated_; }
+
+    bool export_npy(const Tensor& t, const std::string& path) const {
+        std::vector<unsigned char> scratch;
+        return npy_write(path, t.dtype, t.shape, t.data(scratch));
+    }
+
+private:
+    const unsigned char* base_ = nullptr;
+    size_t size_ = 0;
+    std::vector<Record> records_;
+    bool truncated_ = false;
+
+    template <typename T>
+    T get(size_t at) const {
+        T v;
+        std::memcpy(&v, base_ + at, sizeof(T));
+        return v;
+    }
+
+    void index() {
+        if (std::memcmp(base_, kResultFileMagic, sizeof(kResultFileMagic)) != 0 ||
+            get<uint32_t>(8) != kResultFileVersion) {
+            throw std::runtime_error("Not a results file (or an unsupported version)");
+        }
+        size_t off = 64;
+        while (off + 56 <= size_) {
+            if (get<uint32_t>(off) != kResultRecordMagic) throw std::runtime_error("results file: bad record magic");
+            const uint32_t count = get<uint32_t>(off + 4);
+            const uint64_t len = get<uint64_t>(off + 8);
+            if (len < 56 || len % 64 || off + len > size_) {
+                truncated_ = true;
+                return;
+            }
+            Record r;
+            r.meta.model_hash = get<uint64_t>(off + 16);
+            r.meta.unix_ns = get<int64_t>(off + 24);
+            r.meta.load_ms = get<double>(off + 32);
+            r.meta.run_ms = get<double>(off + 40);
+            const uint32_t name_len = get<uint32_t>(off + 48);
+            if (name_len > len - 56) throw std::runtime_error("results file: name outside its record");
+            size_t p = off + 56;
+            r.name.assign(reinterpret_cast<const char*>(base_ + p), name_len);
+            p += (name_len + 7) / 8 * 8;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (p + 8 > off + len || p + 40 + 8 * get<uint32_t>(p + 4) > off + len) {
+                    throw std::runtime_error("results file: tensor table outside its record");
+                }
+                Tensor t;
+                t.dtype = static_cast<DType>(get<uint32_t>(p));
+                const uint32_t ndim = get<uint32_t>(p + 4);
+                p += 8;
+                for (uint32_t d = 0; d < ndim; ++d, p += 8) t.shape.push_back(get<int64_t>(p));
+                t.codec = static_cast<ResultCodec>(get<uint32_t>(p));
+                t.bytes = get<uint64_t>(p + 8);
+                t.stored_bytes = get<uint64_t>(p + 16);
+                const uint64_t at = get<uint64_t>(p + 24);
+                p += 32;
+                if (at + t.stored_bytes > len) throw std::runtime_error("results file: payload outside its record");
+                t.stored = base_ + off + at;
+                r.tensors.push_back(std::move(t));
+            }
+            records_.push_back(std::move(r));
+            off += len;
+        }
+        truncated_ = off != size_;
+    }
+};
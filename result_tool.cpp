@@ -0,0 +1,81 @@
+// g++ -std=c++17 -O2 result_tool.cpp -o result_tool [-DUSE_ZSTD -lzstd]
+//
+// Reads the results files written by nump --out (result_file.h).
+//
+// Usage: result_tool results.bin                   list records and tensors
+//        result_tool results.bin --export dir      every tensor as
+//                                                  dir/<sample>.output<i>.npy
+//        result_tool results.bin --sample name     only that sample
+//
+// Exit code 3 when the file ends in a truncated record.
+
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "result_file.h"
+
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+// Sample names may be directory paths; keep export names flat.
+static std::string flat_name(const std::string& s) {
+    std::string out = s;
+    for (char& c : out) {
+        if (c == '/') c = '_';
+    }
+    return out == "." ? "sample" : out;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        std::cerr << "usage: result_tool results.bin [--export dir] [--sample name]\n";
+        return 2;
+    }
+    try {
+        ResultReader reader(argv[1]);
+        const char* export_dir = arg_value(argc, argv, "--export");
+        const char* only = arg_value(argc, argv, "--sample");
+
+        size_t shown = 0, exported = 0;
+        for (const auto& r : reader.records()) {
+            if (only && r.name != only) continue;
+            ++shown;
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016" PRIx64, r.meta.model_hash);
+            std::cout << r.name << " model=" << hash << " load_ms=" << r.meta.load_ms
+                      << " run_ms=" << r.meta.run_ms << "\n";
+            for (size_t i = 0; i < r.tensors.size(); ++i) {
+                const auto& t = r.tensors[i];
+                std::cout << "  output" << i << " " << dtype_name(t.dtype) << " [";
+                for (size_t d = 0; d < t.shape.size(); ++d) std::cout << (d ? ", " : "") << t.shape[d];
+                std::cout << "] " << t.bytes << " bytes";
+                if (t.codec == ResultCodec::Zstd) std::cout << " (zstd " << t.stored_bytes << ")";
+                std::cout << "\n";
+                if (export_dir) {
+                    std::string path = std::string(export_dir) + "/" + flat_name(r.name) + ".output" +
+                                       std::to_string(i) + ".npy";
+                    if (!reader.export_npy(t, path)) throw std::runtime_error("Failed to write " + path);
+                    ++exported;
+                }
+            }
+        }
+        std::cout << shown << " records";
+        if (export_dir) std::cout << ", " << exported << " tensors exported to " << export_dir;
+        std::cout << "\n";
+        if (reader.truncated()) {
+            std::cerr << "warning: last record truncated\n";
+            return 3;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
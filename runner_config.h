@@ -0,0 +1,358 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#if defined(USE_NNAPI)
+#include <nnapi_provider_factory.h>
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "session_cache.h"
+
+// ============================================================
+// Runner configuration for the decoder sessions
+//
+// Read from a key=value file (same format as token.txt; '#' starts
+// a comment) and/or the command line. --config <file> is applied
+// first, then every --some-key value pair overrides the file, with
+// '-' in the flag mapped to '_' in the key. Unknown keys are left
+// for the runner's own options.
+//
+//   intra_op_threads=4          SetIntraOpNumThreads (0 = ORT default)
+//   inter_op_threads=2          SetInterOpNumThreads (parallel mode only)
+//   execution_mode=parallel     sequential | parallel
+//   thread_affinity=1;2;3       session.intra_op_thread_affinities
+//   providers=xnnpack,cpu       EP priority list, cpu is always last
+//   opt_level=all               disable | basic | extended | all
+//   warm_start=1                see session_cache.h
+//   opt_cache=path
+//   shared_arena=1              one CPU arena on the Env for every session
+//   arena_extend=requested      requested | power_of_two (OrtArenaCfg)
+//   arena_initial_kb=1024       first arena chunk, 0 = ORT default
+//   arena_max_mb=64             arena limit, 0 = unlimited
+//   profile=prof/decoder        EnableProfiling trace prefix (ort_profile.h)
+//   profile_baseline=base.tsv   per-op baseline to diff against / record
+//   profile_top=20              rows in the per-op tables
+//   tuning=latency              throughput (default) | latency
+//   spinning=1                  pool threads spin-wait between runs: 1 | 0
+//   pin_cpu=auto                inference thread's CPU: auto | off | <cpu>
+//   prerun=2                    untimed runs of the first step at startup
+//
+// "throughput" keeps ORT's defaults. "latency" is for runs so small
+// that wake-up and scheduling decide their wall time, like the one-step
+// Yes/No verdict: the intra/inter-op pools spin instead of parking
+// between runs, runner_pin_thread() pins the thread calling Run() to a
+// performance core (pool threads get the other performance cores unless
+// thread_affinity is set), and the runner makes runner_prerun() untimed
+// runs of its first step, so weights, arena chunks and caches are hot
+// before the first request is timed. spinning, pin_cpu and prerun set
+// explicitly win over the profile. Performance cores are the ones with
+// the highest cpu_capacity (big.LITTLE), else cpuinfo_max_freq, among
+// those the process may run on.
+//
+// With shared_arena the arena is registered on the Env by
+// runner_register_arena() and sessions opt in through
+// session.use_env_allocators, so encoder/decoder sessions and every
+// Run() draw outputs and intermediates from one pool instead of each
+// growing its own. "requested" extends by what a step asks for rather
+// than doubling, which keeps a long-running decoder's footprint flat.
+//
+// EPs that are not compiled into this ORT build fail to append; they
+// are logged and skipped, so the CPU provider is the fallback.
+// ============================================================
+
+enum { kRunnerPinProfile = -1, kRunnerPinOff = -2, kRunnerPinAuto = -3 };
+
+struct RunnerConfig {
+    int intra_op_threads = 1;
+    int inter_op_threads = 0;
+    bool parallel = false;
+    std::string thread_affinity;
+    std::vector<std::string> providers = {"cpu"};
+    GraphOptimizationLevel opt_level = GraphOptimizationLevel::ORT_ENABLE_ALL;
+    SessionWarmStart warm;
+    bool shared_arena = false;
+    bool arena_power_of_two = false;
+    int arena_initial_kb = 0;
+    int arena_max_mb = 0;
+    std::string profile;            // trace file prefix; empty = profiling off
+    std::string profile_baseline;   // ort_profile.h: diffed against, or recorded when missing
+    int profile_top = 20;
+    bool latency = false;           // tuning=latency
+    int spinning = -1;              // -1: from the profile
+    int pin_cpu = kRunnerPinProfile;
+    int prerun = -1;                // -1: from the profile
+};
+
+static inline std::vector<std::string> runner_split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t p = s.find(sep, start);
+        std::string tok = s.substr(start, p == std::string::npos ? std::string::npos : p - start);
+        tok.erase(std::remove_if(tok.begin(), tok.end(), ::isspace), tok.end());
+        if (!tok.empty()) out.push_back(tok);
+        if (p == std::string::npos) break;
+        start = p + 1;
+    }
+    return out;
+}
+
+static inline bool runner_truthy(const std::string& v) {
+    return v == "1" || v == "true" || v == "on" || v == "yes";
+}
+
+// Applies one key; returns false if the key is not a runner setting.
+static inline bool runner_config_set(RunnerConfig& cfg, const std::string& key, const std::string& val) {
+    if (key == "intra_op_threads") cfg.intra_op_threads = std::stoi(val);
+    else if (key == "inter_op_threads") cfg.inter_op_threads = std::stoi(val);
+    else if (key == "execution_mode") {
+        if (val != "sequential" && val != "parallel") {
+            throw std::runtime_error("execution_mode must be sequential or parallel");
+        }
+        cfg.parallel = val == "parallel";
+    }
+    else if (key == "thread_affinity") cfg.thread_affinity = val;
+    else if (key == "providers") cfg.providers = runner_split(val, ',');
+    else if (key == "opt_level") {
+        if (val == "disable") cfg.opt_level = GraphOptimizationLevel::ORT_DISABLE_ALL;
+        else if (val == "basic") cfg.opt_level = GraphOptimizationLevel::ORT_ENABLE_BASIC;
+        else if (val == "extended") cfg.opt_level = GraphOptimizationLevel::ORT_ENABLE_EXTENDED;
+        else if (val == "all") cfg.opt_level = GraphOptimizationLevel::ORT_ENABLE_ALL;
+        else throw std::runtime_error("opt_level must be disable, basic, extended or all");
+    }
+    else if (key == "warm_start") cfg.warm.enabled = runner_truthy(val);
+    else if (key == "opt_cache") cfg.warm.cache_path = val;
+    else if (key == "shared_arena") cfg.shared_arena = runner_truthy(val);
+    else if (key == "arena_extend") {
+        if (val != "requested" && val != "power_of_two") {
+            throw std::runtime_error("arena_extend must be requested or power_of_two");
+        }
+        cfg.arena_power_of_two = val == "power_of_two";
+    }
+    else if (key == "arena_initial_kb") cfg.arena_initial_kb = std::stoi(val);
+    else if (key == "arena_max_mb") cfg.arena_max_mb = std::stoi(val);
+    else if (key == "profile") cfg.profile = val;
+    else if (key == "profile_baseline") cfg.profile_baseline = val;
+    else if (key == "profile_top") cfg.profile_top = std::stoi(val);
+    else if (key == "tuning") {
+        if (val != "throughput" && val != "latency") {
+            throw std::runtime_error("tuning must be throughput or latency");
+        }
+        cfg.latency = val == "latency";
+    }
+    else if (key == "spinning") cfg.spinning = runner_truthy(val) ? 1 : 0;
+    else if (key == "pin_cpu") {
+        if (val == "auto") cfg.pin_cpu = kRunnerPinAuto;
+        else if (val == "off" || val == "-1") cfg.pin_cpu = kRunnerPinOff;
+        else cfg.pin_cpu = std::stoi(val);
+    }
+    else if (key == "prerun") cfg.prerun = std::max(0, std::stoi(val));
+    else return false;
+    return true;
+}
+
+static inline void runner_config_load_file(RunnerConfig& cfg, const std::string& path) {
+    std::ifstream f(path);
+    if (!f) {
+        throw std::runtime_error("Failed to open runner config: " + path);
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        auto hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        auto eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string val = line.substr(eq + 1);
+        key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+        val.erase(0, val.find_first_not_of(" \t"));
+        val.erase(val.find_last_not_of(" \t\r") + 1);
+        if (!runner_config_set(cfg, key, val)) {
+            std::cerr << "runner config: ignoring unknown key '" << key << "'\n";
+        }
+    }
+}
+
+static inline RunnerConfig runner_config_from_args(int argc, char** argv) {
+    RunnerConfig cfg;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--config") runner_config_load_file(cfg, argv[i + 1]);
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--", 0) != 0 || a == "--config") continue;
+        std::string key = a.substr(2);
+        std::replace(key.begin(), key.end(), '-', '_');
+        bool has_val = i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0;
+        if ((key == "warm_start" || key == "shared_arena") && !has_val) {
+            runner_config_set(cfg, key, "1");
+        } else if (has_val && runner_config_set(cfg, key, argv[i + 1])) {
+            ++i;
+        }
+    }
+    return cfg;
+}
+
+// Key material for the warm-start cache: anything that changes the
+// optimized graph.
+static inline std::string runner_config_tag(const RunnerConfig& cfg) {
+    std::string tag;
+    for (const auto& p : cfg.providers) tag += p + ",";
+    return tag;
+}
+
+// ---------- LATENCY TUNING ----------
+// Spin-wait of the pools: 1 | 0, -1 = ORT's default.
+static inline int runner_spinning(const RunnerConfig& cfg) {
+    return cfg.spinning >= 0 ? cfg.spinning : cfg.latency ? 1 : -1;
+}
+
+static inline int runner_prerun(const RunnerConfig& cfg) {
+    return cfg.prerun >= 0 ? cfg.prerun : cfg.latency ? 2 : 0;
+}
+
+static inline long runner_cpu_sysfs(int cpu, const char* leaf) {
+    std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/" + leaf);
+    long v = 0;
+    return (f >> v) ? v : 0;
+}
+
+// CPUs of the affinity mask with the largest capacity, ascending.
+static inline std::vector<int> runner_perf_cpus() {
+    std::vector<int> all, best;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return all;
+    for (int c = 0; c < CPU_SETSIZE; ++c) if (CPU_ISSET(c, &set)) all.push_back(c);
+    for (const char* leaf : {"cpu_capacity", "cpufreq/cpuinfo_max_freq"}) {
+        long top = 0;
+        for (int c : all) top = std::max(top, runner_cpu_sysfs(c, leaf));
+        if (top <= 0) continue;
+        for (int c : all) if (runner_cpu_sysfs(c, leaf) == top) best.push_back(c);
+        return best;
+    }
+    return all;
+}
+
+// CPU runner_pin_thread() uses: -1 when not pinning.
+static inline int runner_pin_target(const RunnerConfig& cfg) {
+    int pin = cfg.pin_cpu;
+    if (pin == kRunnerPinProfile) pin = cfg.latency ? kRunnerPinAuto : kRunnerPinOff;
+    if (pin == kRunnerPinOff) return -1;
+    if (pin >= 0) return pin;
+    std::vector<int> perf = runner_perf_cpus();
+    // the last one: cpu0 usually takes the interrupts
+    return perf.empty() ? -1 : perf.back();
+}
+
+// Pins the calling thread (the one that will call Run()); returns the
+// CPU, or -1 when the profile does not pin or the kernel refused.
+static inline int runner_pin_thread(const RunnerConfig& cfg) {
+    int cpu = runner_pin_target(cfg);
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? cpu : -1;
+}
+
+// intra_op_thread_affinities for the latency profile: one of the other
+// performance cores per pool thread (ORT numbers processors from 1). ""
+// when thread_affinity is set, nothing is pinned or there are too few.
+static inline std::string runner_pool_affinity(const RunnerConfig& cfg) {
+    if (!cfg.thread_affinity.empty() || !cfg.latency || cfg.intra_op_threads < 2) return "";
+    int pinned = runner_pin_target(cfg);
+    if (pinned < 0) return "";
+    std::string aff;
+    int need = cfg.intra_op_threads - 1;
+    for (int c : runner_perf_cpus()) {
+        if (c == pinned || need == 0) continue;
+        aff += (aff.empty() ? "" : ";") + std::to_string(c + 1);
+        --need;
+    }
+    return need ? "" : aff;
+}
+
+static inline void runner_append_provider(Ort::SessionOptions& so, const std::string& name,
+                                          const RunnerConfig& cfg) {
+    if (name == "xnnpack") {
+        so.AppendExecutionProvider("XNNPACK", {{"intra_op_num_threads",
+                                                std::to_string(std::max(1, cfg.intra_op_threads))}});
+    } else if (name == "nnapi") {
+#if defined(USE_NNAPI)
+        Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_Nnapi(so, 0));
+#else
+        throw Ort::Exception("NNAPI support not compiled in (build with -DUSE_NNAPI)", ORT_FAIL);
+#endif
+    } else {
+        // Generic provider-name API (QNN, SNPE, ...).
+        so.AppendExecutionProvider(name);
+    }
+}
+
+// Registers the shared CPU arena on env; call once, before the
+// sessions are created. No-op unless shared_arena is set.
+static inline void runner_register_arena(Ort::Env& env, const RunnerConfig& cfg) {
+    if (!cfg.shared_arena) return;
+    Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    // extend strategy: 0 = kNextPowerOfTwo, 1 = kSameAsRequested; -1 = ORT default
+    Ort::ArenaCfg arena(static_cast<size_t>(cfg.arena_max_mb) << 20,
+                        cfg.arena_power_of_two ? 0 : 1,
+                        cfg.arena_initial_kb > 0 ? cfg.arena_initial_kb * 1024 : -1,
+                        -1);
+    env.CreateAndRegisterAllocator(mem, arena);
+    std::cout << "[config] shared CPU arena registered\n";
+}
+
+static inline void runner_config_apply(const RunnerConfig& cfg, Ort::SessionOptions& so) {
+    if (cfg.shared_arena) so.AddConfigEntry("session.use_env_allocators", "1");
+    if (cfg.intra_op_threads > 0) so.SetIntraOpNumThreads(cfg.intra_op_threads);
+    if (cfg.inter_op_threads > 0) so.SetInterOpNumThreads(cfg.inter_op_threads);
+    so.SetExecutionMode(cfg.parallel ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+    const std::string affinity = cfg.thread_affinity.empty() ? runner_pool_affinity(cfg) : cfg.thread_affinity;
+    if (!affinity.empty()) so.AddConfigEntry("session.intra_op_thread_affinities", affinity.c_str());
+    const int spin = runner_spinning(cfg);
+    if (spin >= 0) {
+        so.AddConfigEntry("session.intra_op.allow_spinning", spin ? "1" : "0");
+        so.AddConfigEntry("session.inter_op.allow_spinning", spin ? "1" : "0");
+    }
+    if (!cfg.profile.empty()) so.EnableProfiling(cfg.profile.c_str());
+
+    for (const auto& p : cfg.providers) {
+        if (p == "cpu") break;      // everything after cpu is unreachable
+        try {
+            runner_append_provider(so, p, cfg);
+            std::cout << "[config] execution provider: " << p << "\n";
+        } catch (const Ort::Exception& e) {
+            std::cerr << "[config] provider " << p << " unavailable, skipping: " << e.what() << "\n";
+        }
+    }
+}
+
+static inline void runner_config_print(const RunnerConfig& cfg) {
+    std::cout << "[config] intra=" << cfg.intra_op_threads
+              << " inter=" << cfg.inter_op_threads
+              << " mode=" << (cfg.parallel ? "parallel" : "sequential")
+              << " providers=";
+    for (size_t i = 0; i < cfg.providers.size(); ++i) {
+        std::cout << (i ? "," : "") << cfg.providers[i];
+    }
+    if (!cfg.thread_affinity.empty()) std::cout << " affinity=" << cfg.thread_affinity;
+    if (cfg.shared_arena) std::cout << " arena=shared," << (cfg.arena_power_of_two ? "power_of_two" : "requested");
+    if (!cfg.profile.empty()) std::cout << " profile=" << cfg.profile;
+    if (cfg.latency) std::cout << " tuning=latency";
+    if (runner_spinning(cfg) >= 0) std::cout << " spinning=" << runner_spinning(cfg);
+    if (runner_pin_target(cfg) >= 0) std::cout << " pin_cpu=" << runner_pin_target(cfg);
+    if (runner_prerun(cfg)) std::cout << " prerun=" << runner_prerun(cfg);
+    std::cout << "\n";
+}
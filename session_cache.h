@@ -0,0 +1,99 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// ============================================================
+// Session warm-start
+//
+// The first run creates the session from the surgered model with
+// the requested optimization level and lets ORT serialize the
+// optimized graph (SetOptimizedModelFilePath). Later runs load that
+// file with optimizations disabled, so graph optimization is paid
+// once per model/options combination instead of on every launch.
+//
+// The cached file name carries a key built from the options that
+// change the optimized graph (level + a caller-provided tag such as
+// the EP list), and is regenerated when the source model is newer.
+// Session creation time is logged either way.
+// ============================================================
+
+struct SessionWarmStart {
+    bool enabled = false;
+    std::string cache_path;        // empty: <model>.opt-<key>.onnx
+    std::string options_tag;       // extra key material (EPs, etc.)
+};
+
+static inline bool session_cache_fresh(const std::string& cached, const std::string& model) {
+    struct stat cs, ms;
+    if (::stat(cached.c_str(), &cs) != 0 || cs.st_size == 0) return false;
+    if (::stat(model.c_str(), &ms) != 0) return true;
+    return cs.st_mtime >= ms.st_mtime;
+}
+
+static inline std::string session_cache_key(GraphOptimizationLevel level, const std::string& tag) {
+    // FNV-1a over the key material; short and stable across runs.
+    uint32_t h = 2166136261u;
+    std::string material = std::to_string(static_cast<int>(level)) + "|" + tag;
+    for (unsigned char c : material) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%08x", h);
+    return buf;
+}
+
+static inline std::string session_cache_path(const std::string& model, GraphOptimizationLevel level,
+                                             const SessionWarmStart& ws) {
+    if (!ws.cache_path.empty()) return ws.cache_path;
+    std::string base = model;
+    const std::string ext = ".onnx";
+    if (base.size() > ext.size() && base.compare(base.size() - ext.size(), ext.size(), ext) == 0) {
+        base.resize(base.size() - ext.size());
+    }
+    return base + ".opt-" + session_cache_key(level, ws.options_tag) + ".onnx";
+}
+
+// Creates the session, using or producing the optimized-model cache
+// when ws.enabled. `options` is taken by value because the cache
+// path and optimization level are adjusted per mode.
+static inline Ort::Session create_session_warm(Ort::Env& env,
+                                               const std::string& model_path,
+                                               Ort::SessionOptions options,
+                                               GraphOptimizationLevel level,
+                                               const SessionWarmStart& ws,
+                                               const char* log_tag = "session") {
+    auto t0 = std::chrono::steady_clock::now();
+    std::string load_path = model_path;
+    const char* mode = "cold";
+
+    if (!ws.enabled) {
+        options.SetGraphOptimizationLevel(level);
+    } else {
+        std::string cached = session_cache_path(model_path, level, ws);
+        if (session_cache_fresh(cached, model_path)) {
+            options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            load_path = cached;
+            mode = "warm";
+        } else {
+            options.SetGraphOptimizationLevel(level);
+            options.SetOptimizedModelFilePath(cached.c_str());
+            mode = "cold+save";
+        }
+    }
+
+    Ort::Session session(env, load_path.c_str(), options);
+
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[" << log_tag << "] session create (" << mode << ") "
+              << ms << " ms from " << load_path << "\n";
+    return session;
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "runner_config.h"
+#include "session_cache.h"
+
+// ============================================================
+// Multi-model session pool
+//
+// Every runner used to build its own Ort::Env and per-session
+// thread pools, so two models in one process meant two sets of
+// intra-op threads fighting over the same cores. The pool owns the
+// single Env of the process, created with global intra/inter-op
+// thread pools sized from the pool's RunnerConfig; every session it
+// creates disables its per-session threads and runs on those. With
+// shared_arena the arena is registered on that Env as well.
+//
+// Models are registered by name and loaded on the first acquire()
+// (warm-started through create_session_warm). acquire() returns a
+// Lease that keeps the session alive and holds one of the model's
+// max_concurrent slots; further acquires block until a lease is
+// released. unload_idle() drops sessions nobody holds; a lease taken
+// before the unload keeps its session until it is released.
+//
+// Thread-safe. Sessions themselves may be run from several threads;
+// the slot limit is what bounds concurrent Run() calls per model.
+// ============================================================
+
+struct PoolModel {
+    std::string path;
+    RunnerConfig cfg;               // providers, opt level, warm start; threads come from the pool
+    size_t max_concurrent = 1;      // 0 = unlimited
+};
+
+class SessionPool {
+    struct Entry;
+
+public:
+    explicit SessionPool(const RunnerConfig& global, const char* log_id = "session_pool")
+        : env_(threading(global), ORT_LOGGING_LEVEL_WARNING, log_id) {
+        runner_register_arena(env_, global);
+        shared_arena_ = global.shared_arena;
+    }
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    Ort::Env& env() { return env_; }
+
+    // Registers (or replaces the settings of) a model; nothing is loaded.
+    void add(const std::string& name, PoolModel model) {
+        std::lock_guard<std::mutex> lock(mu_);
+        Entry& e = models_[name];
+        e.model = std::move(model);
+        e.model.cfg.shared_arena = shared_arena_;
+    }
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& o) noexcept : pool_(o.pool_), entry_(o.entry_), session_(std::move(o.session_)) {
+            o.pool_ = nullptr;
+        }
+        Lease& operator=(Lease&& o) noexcept {
+            if (this != &o) {
+                release();
+                pool_ = o.pool_;
+                entry_ = o.entry_;
+                session_ = std::move(o.session_);
+                o.pool_ = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { release(); }
+
+        Ort::Session& session() const { return *session_; }
+        Ort::Session& operator*() const { return *session_; }
+        Ort::Session* operator->() const { return session_.get(); }
+        explicit operator bool() const { return session_ != nullptr; }
+
+        void release() {
+            if (!pool_) return;
+            pool_->give_back(*entry_);
+            session_.reset();
+            pool_ = nullptr;
+        }
+
+    private:
+        friend class SessionPool;
+        SessionPool* pool_ = nullptr;
+        Entry* entry_ = nullptr;
+        std::shared_ptr<Ort::Session> session_;
+    };
+
+    // Loads the model if needed and takes a slot, waiting for one.
+    Lease acquire(const std::string& name) {
+        std::unique_lock<std::mutex> lock(mu_);
+        Entry& e = find(name);
+        cv_.wait(lock, [&e] { return !e.model.max_concurrent || e.leased < e.model.max_concurrent; });
+        ++e.leased;
+        try {
+            if (!e.session) {
+                // one loader per model; other models stay available meanwhile
+                cv_.wait(lock, [&e] { return !e.loading; });
+                if (!e.session) {
+                    e.loading = true;
+                    PoolModel m = e.model;
+                    lock.unlock();
+                    std::shared_ptr<Ort::Session> s;
+                    try {
+                        s = load(name, m);
+                    } catch (...) {
+                        lock.lock();
+                        e.loading = false;
+                        cv_.notify_all();
+                        throw;
+                    }
+                    lock.lock();
+                    e.session = std::move(s);
+                    e.loading = false;
+                    cv_.notify_all();
+                }
+            }
+        } catch (...) {
+            --e.leased;
+            cv_.notify_all();
+            throw;
+        }
+        Lease l;
+        l.pool_ = this;
+        l.entry_ = &e;
+        l.session_ = e.session;
+        return l;
+    }
+
+    bool loaded(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = models_.find(name);
+        return it != models_.end() && it->second.session != nullptr;
+    }
+
+    // Drops every session without a live lease; returns how many.
+    size_t unload_idle() {
+        std::lock_guard<std::mutex> lock(mu_);
+        size_t n = 0;
+        for (auto& kv : models_) {
+            Entry& e = kv.second;
+            if (e.session && !e.leased && !e.loading) {
+                e.session.reset();
+                ++n;
+            }
+        }
+        return n;
+    }
+
+private:
+    struct Entry {
+        PoolModel model;
+        std::shared_ptr<Ort::Session> session;
+        size_t leased = 0;
+        bool loading = false;
+    };
+
+    Ort::Env env_;
+    bool shared_arena_ = false;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::map<std::string, Entry> models_;   // node-based: Entry addresses are stable
+
+    static Ort::ThreadingOptions threading(const RunnerConfig& cfg) {
+        Ort::ThreadingOptions tp;
+        if (cfg.intra_op_threads > 0) tp.SetGlobalIntraOpNumThreads(cfg.intra_op_threads);
+        if (cfg.inter_op_threads > 0) tp.SetGlobalInterOpNumThreads(cfg.inter_op_threads);
+        // per-session spinning and affinity entries do not reach the global pools
+        const int spin = runner_spinning(cfg);
+        if (spin >= 0) tp.SetGlobalSpinControl(spin);
+        const std::string affinity = cfg.thread_affinity.empty() ? runner_pool_affinity(cfg) : cfg.thread_affinity;
+        if (!affinity.empty()) Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(tp, affinity.c_str()));
+        return tp;
+    }
+
+    Entry& find(const std::string& name) {
+        auto it = models_.find(name);
+        if (it == models_.end()) throw std::runtime_error("session pool: unknown model '" + name + "'");
+        return it->second;
+    }
+
+    std::shared_ptr<Ort::Session> load(const std::string& name, PoolModel& m) {
+        Ort::SessionOptions so;
+        runner_config_apply(m.cfg, so);
+        so.DisablePerSessionThreads();
+        if (m.cfg.warm.options_tag.empty()) m.cfg.warm.options_tag = runner_config_tag(m.cfg);
+        return std::make_shared<Ort::Session>(create_session_warm(
+            env_, m.path, std::move(so), m.cfg.opt_level, m.cfg.warm, name.c_str()));
+    }
+
+    void give_back(Entry& e) {
+        std::lock_guard<std::mutex> lock(mu_);
+        --e.leased;
+        cv_.notify_all();
+    }
+};
@@ -62,6 +62,7 @@ static char* http_request(const char *url, const char *token,
         curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &m);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");   // gzip/br JSON, decoded by curl
     CURLcode res = curl_easy_perform(curl);
     if (out_code)
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, out_code);
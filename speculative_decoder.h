@@ -0,0 +1,260 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "decoder_engine.h"
+#include "host_arena.h"
+#include "logits_reduce.h"
+
+// ============================================================
+// Speculative greedy decoding with a draft decoder
+//
+// Every main-model session.Run pays a fixed overhead that dominates a
+// single-token step. A small draft decoder (a DecoderEngine) runs
+// ahead one token at a time; the main decoder then checks k positions
+// (the current token and k-1 drafts) in one run, keeps the longest
+// draft prefix it agrees with and adds its own next token. Output is
+// identical to greedy decoding with the main model; each main run
+// yields 1..k tokens. The draft's k-th step only advances its state,
+// so a fully accepted round needs no catch-up step.
+//
+// The decoder state is recurrent, so the k positions cannot be
+// checked as k rows of a batch (row i+1 needs the state after row i).
+// The main model is instead a k-token export with a sequence axis:
+//   input:0          float [1,352,2,8]      bound once per request
+//   embedded_token   float [1,k,H]          current token + k-1 drafts
+//   input:2 / 3      float [1,1,H]          state before the first one
+//   output:0         float [1,k,V]          logits after each position
+//   output:1 / 2     float [1,k,H]          state after each position
+// The per-position states make the rollback a row copy: after
+// accepting r drafts the next run starts from row r. The draft is
+// rolled back the same way from the state it had after each step.
+//
+// The binding is prepared once (as in DecoderEngine): a run only
+// embeds the k tokens into the bound buffer. Buffers come from one
+// HostArena block.
+// ============================================================
+
+struct SpeculativeStats {
+    size_t main_runs = 0;
+    size_t draft_steps = 0;
+    size_t proposed = 0;            // draft tokens checked by the main model
+    size_t accepted = 0;            // of those, kept
+    size_t tokens = 0;              // tokens emitted
+
+    double acceptance_rate() const { return proposed ? static_cast<double>(accepted) / proposed : 0.0; }
+    double tokens_per_main_run() const { return main_runs ? static_cast<double>(tokens) / main_runs : 0.0; }
+};
+
+class SpeculativeDecoder {
+public:
+    // sig describes the main model; its shapes are the single-position
+    // ones ([1,1,H] state), the k axis is added here.
+    SpeculativeDecoder(Ort::Session& main,
+                       const DecoderSignature& sig,
+                       size_t k,
+                       DecoderEngine& draft,
+                       DecoderEmbedFn embed)
+        : session_(main),
+          sig_(sig),
+          k_(k),
+          draft_(draft),
+          embed_(std::move(embed)),
+          mem_info_(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)) {
+        if (k_ < 2) throw std::runtime_error("SpeculativeDecoder: k must be >= 2");
+        if (!embed_) throw std::runtime_error("SpeculativeDecoder: needs an embed function");
+        check_k_axis();
+
+        std::vector<int64_t> out_shape = session_.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        vocab_ = static_cast<size_t>(out_shape.empty() || out_shape.back() <= 0 ? 1 : out_shape.back());
+        if (draft_.vocab() != vocab_) {
+            throw std::runtime_error("SpeculativeDecoder: draft and main vocabularies differ");
+        }
+
+        encoder_n_ = decoder_shape_elems(sig_.encoder_shape);
+        state_n_ = decoder_shape_elems(sig_.state_shape);
+        const size_t a = HostArena::kAlign;
+        arena_.reserve(((encoder_n_ + k_ * (3 * state_n_ + vocab_) + 2 * state_n_ + 2 * k_ * state_n_) *
+                        sizeof(float) / a + 16) * a);
+        encoder_ = arena_.alloc_zeroed<float>(encoder_n_);
+        tokens_ = arena_.alloc_zeroed<float>(k_ * state_n_);
+        for (auto& s : state_in_) s = arena_.alloc_zeroed<float>(state_n_);
+        for (auto& s : state_out_) s = arena_.alloc_zeroed<float>(k_ * state_n_);
+        logits_ = arena_.alloc_zeroed<float>(k_ * vocab_);
+        for (auto& s : draft_saved_) s = arena_.alloc<float>(k_ * state_n_);
+        encoder_data_ = encoder_;
+        build_binding();
+    }
+
+    SpeculativeDecoder(const SpeculativeDecoder&) = delete;
+    SpeculativeDecoder& operator=(const SpeculativeDecoder&) = delete;
+
+    float* encoder_buffer() { return encoder_; }
+    size_t encoder_size() const { return encoder_n_; }
+
+    // Caller-owned features for the main model; the draft engine is
+    // bound separately (its encoder input may differ).
+    void bind_encoder(float* data) {
+        encoder_data_ = data ? data : encoder_;
+        encoder_value_ = make_tensor(encoder_data_, encoder_n_, sig_.encoder_shape);
+        binding_->BindInput(sig_.encoder_name.c_str(), encoder_value_);
+    }
+
+    // Main state to zeros or the given [1,1,H] buffers; the draft
+    // engine's state is reset by the caller.
+    void reset_state(const float* s0 = nullptr, const float* s1 = nullptr) {
+        const size_t bytes = state_n_ * sizeof(float);
+        if (s0) std::memcpy(state_in_[0], s0, bytes); else std::memset(state_in_[0], 0, bytes);
+        if (s1) std::memcpy(state_in_[1], s1, bytes); else std::memset(state_in_[1], 0, bytes);
+    }
+
+    // Greedy decode from first_token, same tokens as DecoderEngine::run
+    // on the main model. Stops at max_steps tokens or eos_token.
+    size_t run(int32_t first_token, size_t max_steps, int32_t* out_tokens, int32_t eos_token = -1) {
+        std::vector<int32_t> draft(k_);
+        int32_t tok = first_token;
+        size_t n = 0;
+        while (n < max_steps) {
+            // draft: k steps, keeping its state after each
+            int32_t d = tok;
+            for (size_t i = 0; i < k_; ++i) {
+                d = draft_.step(d);
+                draft[i] = d;
+                save_draft(i);
+            }
+            stats_.draft_steps += k_;
+
+            // main: tok, d1 .. d(k-1) in one run
+            embed_(tok, tokens_);
+            for (size_t i = 1; i < k_; ++i) embed_(draft[i - 1], tokens_ + i * state_n_);
+            session_.Run(run_options_, *binding_);
+            ++stats_.main_runs;
+
+            // accept while the main argmax after position i equals draft i
+            size_t r = 0;
+            int32_t m = main_argmax(0);
+            while (r + 1 < k_ && m == draft[r]) m = main_argmax(++r);
+            stats_.proposed += k_ - 1;
+            stats_.accepted += r;
+
+            bool stop = false;
+            for (size_t i = 0; i <= r && n < max_steps; ++i) {
+                out_tokens[n++] = i < r ? draft[i] : m;
+                if (out_tokens[n - 1] == eos_token) { stop = true; break; }
+            }
+            if (stop) break;
+
+            // main continues from the state after position r, the draft
+            // from its state after it consumed tok, d1 .. dr
+            const size_t bytes = state_n_ * sizeof(float);
+            std::memcpy(state_in_[0], state_out_[0] + r * state_n_, bytes);
+            std::memcpy(state_in_[1], state_out_[1] + r * state_n_, bytes);
+            draft_.reset_state(draft_saved_[0] + r * state_n_, draft_saved_[1] + r * state_n_);
+            tok = m;
+        }
+        stats_.tokens += n;
+        return n;
+    }
+
+    const SpeculativeStats& stats() const { return stats_; }
+    void reset_stats() { stats_ = SpeculativeStats(); }
+    size_t k() const { return k_; }
+    size_t vocab() const { return vocab_; }
+
+private:
+    Ort::Session& session_;
+    DecoderSignature sig_;
+    size_t k_;
+    DecoderEngine& draft_;
+    DecoderEmbedFn embed_;
+    Ort::MemoryInfo mem_info_;
+    Ort::RunOptions run_options_{nullptr};
+    SpeculativeStats stats_;
+
+    size_t vocab_ = 0, encoder_n_ = 0, state_n_ = 0;
+    HostArena arena_;
+    float* encoder_ = nullptr;
+    float* encoder_data_ = nullptr;
+    float* tokens_ = nullptr;           // [k,H]
+    float* state_in_[2] = {};           // [H] each
+    float* state_out_[2] = {};          // [k,H] each
+    float* logits_ = nullptr;           // [k,V]
+    float* draft_saved_[2] = {};        // draft state after each of its k steps, [k,H]
+
+    std::vector<int64_t> shapes_[7];
+    std::vector<Ort::Value> values_;
+    Ort::Value encoder_value_{nullptr};
+    std::unique_ptr<Ort::IoBinding> binding_;
+
+    int32_t main_argmax(size_t pos) const {
+        return static_cast<int32_t>(logits_argmax(logits_ + pos * vocab_, vocab_));
+    }
+
+    void save_draft(size_t i) {
+        const size_t bytes = state_n_ * sizeof(float);
+        std::memcpy(draft_saved_[0] + i * state_n_, draft_.state0(), bytes);
+        std::memcpy(draft_saved_[1] + i * state_n_, draft_.state1(), bytes);
+    }
+
+    Ort::Value make_tensor(float* p, size_t n, const std::vector<int64_t>& shape) {
+        return Ort::Value::CreateTensor<float>(mem_info_, p, n, shape.data(), shape.size());
+    }
+
+    // The token input and the state outputs need a k (or dynamic)
+    // sequence axis; a single-token export cannot verify drafts.
+    void check_k_axis() {
+        Ort::AllocatorWithDefaultOptions allocator;
+        auto seq_ok = [this](const std::vector<int64_t>& shape) {
+            return shape.size() >= 2 && (shape[1] <= 0 || static_cast<size_t>(shape[1]) == k_);
+        };
+        for (size_t i = 0; i < session_.GetInputCount(); ++i) {
+            auto name = session_.GetInputNameAllocated(i, allocator);
+            if (sig_.token_name != name.get()) continue;
+            if (!seq_ok(session_.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape())) break;
+            for (size_t j = 0; j < session_.GetOutputCount(); ++j) {
+                auto out = session_.GetOutputNameAllocated(j, allocator);
+                if (sig_.state0_out != out.get()) continue;
+                if (seq_ok(session_.GetOutputTypeInfo(j).GetTensorTypeAndShapeInfo().GetShape())) return;
+            }
+            break;
+        }
+        throw std::runtime_error("SpeculativeDecoder: main model has no " + std::to_string(k_) +
+                                 "-token axis on " + sig_.token_name + " / " + sig_.state0_out +
+                                 " (export the verifier with a sequence dimension)");
+    }
+
+    void build_binding() {
+        const int64_t k = static_cast<int64_t>(k_);
+        shapes_[0] = sig_.encoder_shape;
+        shapes_[1] = sig_.state_shape;              // tokens  [1,k,H]
+        shapes_[1][1] = k;
+        shapes_[2] = shapes_[3] = sig_.state_shape; // state in [1,1,H]
+        shapes_[4] = {1, k, static_cast<int64_t>(vocab_)};
+        shapes_[5] = shapes_[6] = shapes_[1];       // state out [1,k,H]
+
+        encoder_value_ = make_tensor(encoder_data_, encoder_n_, shapes_[0]);
+        values_.clear();
+        values_.emplace_back(make_tensor(tokens_, k_ * state_n_, shapes_[1]));
+        values_.emplace_back(make_tensor(state_in_[0], state_n_, shapes_[2]));
+        values_.emplace_back(make_tensor(state_in_[1], state_n_, shapes_[3]));
+        values_.emplace_back(make_tensor(logits_, k_ * vocab_, shapes_[4]));
+        values_.emplace_back(make_tensor(state_out_[0], k_ * state_n_, shapes_[5]));
+        values_.emplace_back(make_tensor(state_out_[1], k_ * state_n_, shapes_[6]));
+
+        binding_.reset(new Ort::IoBinding(session_));
+        binding_->BindInput(sig_.encoder_name.c_str(), encoder_value_);
+        binding_->BindInput(sig_.token_name.c_str(), values_[0]);
+        binding_->BindInput(sig_.state0_name.c_str(), values_[1]);
+        binding_->BindInput(sig_.state1_name.c_str(), values_[2]);
+        binding_->BindOutput(sig_.logits_name.c_str(), values_[3]);
+        binding_->BindOutput(sig_.state0_out.c_str(), values_[4]);
+        binding_->BindOutput(sig_.state1_out.c_str(), values_[5]);
+    }
+};
@@ -0,0 +1,163 @@
+#include "st_account.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "ST_ACCOUNT"
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;  // writers only
+static st_account_t g_accounts[ST_ACCOUNT_MAX];
+static atomic_size_t g_count;           // entries below it are complete
+
+// Caller holds g_lock.
+static void init_locked(void) {
+    if (atomic_load(&g_count)) return;
+    st_account_t *a = &g_accounts[0];
+    memset(a, 0, sizeof(*a));
+    snprintf(a->name, sizeof(a->name), "default");
+    a->token = st_token_default();
+    a->lane = 1;
+    st_http_set_lane(a->lane, a->name, 0, 0, 0);
+    atomic_store(&g_count, 1);
+}
+
+void st_account_init(void) {
+    pthread_mutex_lock(&g_lock);
+    init_locked();
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void apply_limits(st_account_t *a, const st_account_cfg_t *cfg) {
+    a->requests_per_sec = cfg->requests_per_sec > 0 ? cfg->requests_per_sec : 0;
+    a->burst = cfg->burst > 0 ? cfg->burst : 1;
+    a->max_parallel = cfg->max_parallel > 0 ? cfg->max_parallel : 0;
+    a->calls_per_min = cfg->calls_per_min > 0 ? cfg->calls_per_min : 0;
+    st_http_set_lane(a->lane, a->name, a->requests_per_sec, a->burst, a->max_parallel);
+}
+
+int st_account_add(const st_account_cfg_t *cfg) {
+    if (!cfg || !cfg->name || !*cfg->name) return -1;
+    pthread_mutex_lock(&g_lock);
+    init_locked();
+    size_t n = atomic_load(&g_count);
+    int index = -1;
+    for (size_t i = 0; i < n; i++)
+        if (strcmp(g_accounts[i].name, cfg->name) == 0) index = (int)i;
+    if (index > 0 && cfg->token_file && strcmp(cfg->token_file, g_accounts[index].token_file) != 0) {
+        dlog_print(DLOG_WARN, LOG_TAG, "account %s listed twice, keeping %s", cfg->name,
+                   g_accounts[index].token_file);
+    }
+    if (index >= 0) {
+        apply_limits(&g_accounts[index], cfg);
+        pthread_mutex_unlock(&g_lock);
+        return index;
+    }
+    if (n >= ST_ACCOUNT_MAX || !cfg->token_file || !*cfg->token_file) {
+        pthread_mutex_unlock(&g_lock);
+        dlog_print(DLOG_ERROR, LOG_TAG, "account %s not added (%s)", cfg->name,
+                   n >= ST_ACCOUNT_MAX ? "too many accounts" : "no token file");
+        return -1;
+    }
+    // a token file read from disk, no request: cheap enough under the lock
+    st_token_t *tok = st_token_open(cfg->token_file);
+    if (!tok) {
+        pthread_mutex_unlock(&g_lock);
+        dlog_print(DLOG_ERROR, LOG_TAG, "account %s: no usable token in %s", cfg->name, cfg->token_file);
+        return -1;
+    }
+    st_account_t *a = &g_accounts[n];
+    memset(a, 0, sizeof(*a));
+    snprintf(a->name, sizeof(a->name), "%s", cfg->name);
+    snprintf(a->token_file, sizeof(a->token_file), "%s", cfg->token_file);
+    a->token = tok;
+    a->lane = (int)n + 1;
+    apply_limits(a, cfg);
+    atomic_store(&g_count, n + 1);
+    pthread_mutex_unlock(&g_lock);
+    return (int)n;
+}
+
+int st_account_load(const char *path) {
+    FILE *fp = path ? fopen(path, "r") : NULL;
+    if (!fp) return -1;
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    char line[512];
+    int added = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n#")] = '\0';
+        char name[32], file[224];
+        st_account_cfg_t cfg = ST_ACCOUNT_CFG_DEFAULT;
+        if (sscanf(line, "%31s %223s %lf %d %d %lf", name, file, &cfg.requests_per_sec, &cfg.burst,
+                   &cfg.max_parallel, &cfg.calls_per_min) < 2)
+            continue;
+        char full[256];
+        if (file[0] == '/') snprintf(full, sizeof(full), "%s", file);
+        else snprintf(full, sizeof(full), "%.*s%s", dir_len, path, file);
+        cfg.name = name;
+        cfg.token_file = strcmp(name, "default") == 0 ? NULL : full;
+        if (st_account_add(&cfg) >= 0) added++;
+    }
+    fclose(fp);
+    return added;
+}
+
+void st_account_cleanup(void) {
+    pthread_mutex_lock(&g_lock);
+    size_t n = atomic_load(&g_count);
+    atomic_store(&g_count, n ? 1 : 0);
+    for (size_t i = 1; i < n; i++) {
+        st_token_close(g_accounts[i].token);
+        g_accounts[i].token = NULL;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+size_t st_account_count(void) {
+    return atomic_load(&g_count);
+}
+
+const st_account_t *st_account_at(int index) {
+    if (index < 0 || (size_t)index >= atomic_load(&g_count)) return NULL;
+    return &g_accounts[index];
+}
+
+int st_account_find(const char *name) {
+    size_t n = atomic_load(&g_count);
+    for (size_t i = 0; name && i < n; i++)
+        if (strcmp(g_accounts[i].name, name) == 0) return (int)i;
+    return -1;
+}
+
+bool st_account_any_available(void) {
+    size_t n = atomic_load(&g_count);
+    if (!n) return st_token_available();
+    for (size_t i = 0; i < n; i++)
+        if (st_token_available_for(g_accounts[i].token)) return true;
+    return false;
+}
+
+char *st_account_token(int index) {
+    const st_account_t *a = st_account_at(index);
+    if (a) return st_token_get_for(a->token);
+    return index == 0 ? st_token_get() : NULL;
+}
+
+void st_account_maintain(void) {
+    size_t n = atomic_load(&g_count);
+    if (!n) st_token_maintain();
+    for (size_t i = 0; i < n; i++) st_token_maintain_for(g_accounts[i].token);
+}
+
+void st_account_enter(int index) {
+    const st_account_t *a = st_account_at(index);
+    st_http_use_lane(a ? a->lane : 0);
+}
+
+void st_account_leave(void) {
+    st_http_use_lane(0);
+}
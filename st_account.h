@@ -0,0 +1,87 @@
+#ifndef ST_ACCOUNT_H
+#define ST_ACCOUNT_H
+
+#include "st_http.h"
+#include "st_token.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- ACCOUNTS ----------
+// One process serves the cameras of several SmartThings accounts (homes,
+// sites, customers). Every account has its own token file with its own
+// refresh cycle (st_token_open), its own st_http lane (rate bucket and
+// connection share) and its own capture limits, which the app hands to
+// the scheduler (st_sched_set_account_limits) under the same name.
+//
+// Account 0 is "default": the token of st_token_init, without limits of
+// its own unless the accounts file lists it. The others come from the
+// accounts file (one account per line, '#' comments):
+//   <name> <token_file> [requests_per_sec] [burst] [max_parallel] [calls_per_min]
+// A relative token_file is taken from the accounts file's directory.
+//
+// Accounts are set up once from one thread, before the first capture; the
+// table does not change after that, and the lookups below are thread-safe.
+
+#define ST_ACCOUNT_MAX ST_HTTP_MAX_LANES    // account i runs in lane i + 1
+
+typedef struct {
+    char name[32];
+    char token_file[256];       // "" for the default account
+    st_token_t *token;
+    int lane;
+    double requests_per_sec;    // 0: only the global st_http budget
+    int burst;
+    int max_parallel;           // captures and transfers at once, 0: no own cap
+    double calls_per_min;       // scheduler budget for its devices, 0: none of its own
+} st_account_t;
+
+typedef struct {
+    const char *name;
+    const char *token_file;     // NULL or "" only for "default"
+    double requests_per_sec;
+    int burst;
+    int max_parallel;
+    double calls_per_min;
+} st_account_cfg_t;
+
+#define ST_ACCOUNT_CFG_DEFAULT { NULL, NULL, 0, 0, 0, 0 }
+
+// Registers the default account. Called by the others when needed.
+void st_account_init(void);
+// Opens the account's token and configures its lane; "default" only
+// changes the limits. Returns the index, -1 when the token file is
+// unusable or the table is full.
+int st_account_add(const st_account_cfg_t *cfg);
+// Accounts added from path; -1 when it is unreadable.
+int st_account_load(const char *path);
+// Closes the tokens of every account but the default one.
+void st_account_cleanup(void);
+
+size_t st_account_count(void);
+// NULL when index is out of range.
+const st_account_t *st_account_at(int index);
+// -1 when there is no account called name.
+int st_account_find(const char *name);
+
+// True when any account has a token.
+bool st_account_any_available(void);
+// The account's current token like st_token_get (caller frees).
+char *st_account_token(int index);
+// st_token_maintain for every account.
+void st_account_maintain(void);
+
+// Binds the calling thread's requests to the account's lane until
+// st_account_leave (e.g. for the duration of one capture step).
+void st_account_enter(int index);
+void st_account_leave(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include "st_base64.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ST_B64_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define ST_B64_SSSE3 1
+#endif
+
+static const char B64_TBL[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encodes whole 3-byte groups only (n % 3 == 0), returns chars written.
+static size_t encode_scalar(const uint8_t *in, size_t n, char *out) {
+    size_t j = 0;
+    for (size_t i = 0; i + 3 <= n; i += 3) {
+        uint32_t t = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        out[j++] = B64_TBL[(t >> 18) & 63];
+        out[j++] = B64_TBL[(t >> 12) & 63];
+        out[j++] = B64_TBL[(t >> 6) & 63];
+        out[j++] = B64_TBL[t & 63];
+    }
+    return j;
+}
+
+#if ST_B64_NEON
+// 6-bit index -> ASCII: offset chosen by range (A-Z, a-z, 0-9, '+', '/').
+static inline uint8x16_t neon_translate(uint8x16_t idx, uint8x8x2_t lut) {
+    uint8x16_t r = vqsubq_u8(idx, vdupq_n_u8(51));
+    uint8x16_t less = vcltq_u8(idx, vdupq_n_u8(26));
+    r = vorrq_u8(r, vandq_u8(less, vdupq_n_u8(13)));
+    uint8x16_t shift = vcombine_u8(vtbl2_u8(lut, vget_low_u8(r)), vtbl2_u8(lut, vget_high_u8(r)));
+    return vaddq_u8(shift, idx);
+}
+
+// 48 bytes in -> 64 chars out per iteration.
+static size_t encode_bulk(const uint8_t *in, size_t n, char *out, size_t *consumed) {
+    static const uint8_t shift_lut[16] = {
+        (uint8_t)('a' - 26), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52),
+        (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52),
+        (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('0' - 52), (uint8_t)('+' - 62),
+        (uint8_t)('/' - 63), (uint8_t)'A', 0, 0 };
+    uint8x8x2_t lut = { { vld1_u8(shift_lut), vld1_u8(shift_lut + 8) } };
+    const uint8x16_t m6 = vdupq_n_u8(0x3f);
+    size_t i = 0, j = 0;
+    for (; i + 48 <= n; i += 48, j += 64) {
+        uint8x16x3_t s = vld3q_u8(in + i);
+        uint8x16x4_t o;
+        o.val[0] = vshrq_n_u8(s.val[0], 2);
+        o.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(s.val[0], 4), vshrq_n_u8(s.val[1], 4)), m6);
+        o.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(s.val[1], 2), vshrq_n_u8(s.val[2], 6)), m6);
+        o.val[3] = vandq_u8(s.val[2], m6);
+        o.val[0] = neon_translate(o.val[0], lut);
+        o.val[1] = neon_translate(o.val[1], lut);
+        o.val[2] = neon_translate(o.val[2], lut);
+        o.val[3] = neon_translate(o.val[3], lut);
+        vst4q_u8((uint8_t *)out + j, o);
+    }
+    *consumed = i;
+    return j;
+}
+#elif ST_B64_SSSE3
+// 12 bytes in -> 16 chars out per iteration (reads 16, so stop 4 early).
+static size_t encode_bulk(const uint8_t *in, size_t n, char *out, size_t *consumed) {
+    const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0, j = 0;
+    for (; i + 16 <= n; i += 12, j += 16) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + i)), shuf);
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t0, t1);
+
+        __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        r = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+        r = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, r), idx);
+        _mm_storeu_si128((__m128i *)(out + j), r);
+    }
+    *consumed = i;
+    return j;
+}
+#else
+static size_t encode_bulk(const uint8_t *in, size_t n, char *out, size_t *consumed) {
+    (void)in; (void)n; (void)out;
+    *consumed = 0;
+    return 0;
+}
+#endif
+
+// Whole groups: vector kernel first, scalar for what is left.
+static size_t encode_groups(const uint8_t *in, size_t n, char *out) {
+    size_t used = 0;
+    size_t j = encode_bulk(in, n, out, &used);
+    return j + encode_scalar(in + used, n - used, out + j);
+}
+
+static size_t encode_tail(const uint8_t *in, size_t n, char *out) {
+    if (n == 0) return 0;
+    uint32_t t = (uint32_t)in[0] << 16;
+    if (n > 1) t |= (uint32_t)in[1] << 8;
+    out[0] = B64_TBL[(t >> 18) & 63];
+    out[1] = B64_TBL[(t >> 12) & 63];
+    out[2] = n > 1 ? B64_TBL[(t >> 6) & 63] : '=';
+    out[3] = '=';
+    return 4;
+}
+
+size_t st_b64_encode(const uint8_t *in, size_t n, char *out) {
+    size_t whole = n - n % 3;
+    size_t j = encode_groups(in, whole, out);
+    return j + encode_tail(in + whole, n - whole, out + j);
+}
+
+// ---------- STREAMING ----------
+void st_b64_stream_init(st_b64_stream_t *s, st_b64_sink_fn sink, void *ctx) {
+    s->ncarry = 0;
+    s->total_out = 0;
+    s->sink = sink;
+    s->ctx = ctx;
+}
+
+static bool stream_emit(st_b64_stream_t *s, size_t len) {
+    s->total_out += len;
+    return len == 0 || s->sink(s->out, len, s->ctx);
+}
+
+bool st_b64_stream_update(st_b64_stream_t *s, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    // complete a group started by the previous chunk
+    if (s->ncarry) {
+        while (s->ncarry < 3 && len) { s->carry[s->ncarry++] = *p++; len--; }
+        if (s->ncarry < 3) return true;
+        if (!stream_emit(s, encode_scalar(s->carry, 3, s->out))) return false;
+        s->ncarry = 0;
+    }
+
+    while (len >= 3) {
+        size_t take = len < ST_B64_CHUNK ? len - len % 3 : ST_B64_CHUNK;
+        if (!stream_emit(s, encode_groups(p, take, s->out))) return false;
+        p += take;
+        len -= take;
+    }
+
+    memcpy(s->carry, p, len);
+    s->ncarry = len;
+    return true;
+}
+
+bool st_b64_stream_final(st_b64_stream_t *s) {
+    size_t n = encode_tail(s->carry, s->ncarry, s->out);
+    s->ncarry = 0;
+    return stream_emit(s, n);
+}
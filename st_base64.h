@@ -0,0 +1,47 @@
+#ifndef ST_BASE64_H
+#define ST_BASE64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- BASE64 ----------
+// One encoder for every app (replaces the per-file encode_base64 copies).
+// Bulk input goes through a vectorized kernel (NEON on the TV boards,
+// SSSE3 on x86 dev hosts, scalar otherwise). The streaming interface takes
+// arbitrary chunks, e.g. straight from a curl write callback, so a download
+// can be encoded as it arrives without re-reading the file from disk.
+
+// Encoded length of n input bytes (with padding, without NUL).
+static inline size_t st_b64_encoded_len(size_t n) { return 4 * ((n + 2) / 3); }
+
+// One-shot: writes st_b64_encoded_len(n) chars (no NUL) and returns that count.
+size_t st_b64_encode(const uint8_t *in, size_t n, char *out);
+
+// Receives encoded text as it is produced. Return false to abort.
+typedef bool (*st_b64_sink_fn)(const char *text, size_t len, void *ctx);
+
+#define ST_B64_CHUNK 3072       // input bytes encoded per sink call (multiple of 48)
+
+typedef struct {
+    uint8_t carry[3];           // input bytes not yet forming a full group
+    size_t ncarry;
+    size_t total_out;
+    st_b64_sink_fn sink;
+    void *ctx;
+    char out[ST_B64_CHUNK / 3 * 4];
+} st_b64_stream_t;
+
+void st_b64_stream_init(st_b64_stream_t *s, st_b64_sink_fn sink, void *ctx);
+bool st_b64_stream_update(st_b64_stream_t *s, const void *data, size_t len);
+bool st_b64_stream_final(st_b64_stream_t *s);   // flushes the padded tail
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,355 @@
+// cmake -DST_BENCH=ON ... && make st_bench
+//
+// End-to-end capture benchmark: forks the mock SmartThings server
+// (st_mock_server.c), points st_http at it with st_http_map_origin, and
+// runs the real st_core capture path headless:
+//
+//   list:    GET /devices                               (--lists times)
+//   capture: baseline status -> refresh+take command ->
+//            wait for the new frame -> CDN download     (--captures in total)
+//
+// Captures run on --concurrency workers, each owning a share of the
+// cameras, as the scheduler does (one capture per camera at a time).
+// Reported: captures/sec, p50/p90/p99 end-to-end and per stage, requests
+// and bytes on the mock's sockets (headers included), connections opened,
+// and client CPU time. Latency, errors and payload sizes come from a
+// scenario file (see st_mock_server.h); --json writes everything as one
+// object so two builds can be diffed.
+//
+// Usage: st_bench [--scenario file] [--port 8089] [--captures 40]
+//                 [--concurrency 4] [--lists 20] [--json out.json]
+//                 [--metrics out.prom]
+
+#include <curl/curl.h>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_stats.h"
+#include "st_commands.h"
+#include "st_http.h"
+#include "st_image_ready.h"
+#include "st_json_path.h"
+#include "st_metrics.h"
+#include "st_mock_server.h"
+#include "st_token.h"
+
+#define API_BASE "https://api.smartthings.com/v1"
+
+static const char* arg_value(int argc, char** argv, const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+// ---------- MOCK PROCESS ----------
+static volatile sig_atomic_t g_mock_stop = 0;
+static void mock_term(int) { g_mock_stop = 1; }
+
+// Child: serves until SIGTERM, then writes its counters to fd.
+static int mock_child(const st_mock_cfg_t& cfg, int fd) {
+    signal(SIGTERM, mock_term);
+    st_mock_stats_t st{};
+    bool ok = st_mock_run(&cfg, &g_mock_stop, &st);
+    if (ok && write(fd, &st, sizeof(st)) != (ssize_t)sizeof(st)) ok = false;
+    close(fd);
+    return ok ? 0 : 1;
+}
+
+static bool wait_listening(int port) {
+    for (int i = 0; i < 100; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(static_cast<uint16_t>(port));
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool up = connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) == 0;
+        close(fd);
+        if (up) return true;
+        usleep(20000);
+    }
+    return false;
+}
+
+// ---------- CAPTURE PATH ----------
+struct Sample {
+    double baseline_ms = 0, command_ms = 0, wait_ms = 0, download_ms = 0, total_ms = 0;
+    unsigned long long image_bytes = 0;
+};
+
+struct Stages {
+    LatencyRecorder total{"capture"}, baseline{"baseline"}, command{"command"}, wait{"wait_frame"}, download{"download"};
+    unsigned long ok = 0, failed = 0;
+    unsigned long long image_bytes = 0;
+    std::mutex lock;
+
+    void add(const Sample* s) {
+        std::lock_guard<std::mutex> g(lock);
+        if (!s) { ++failed; return; }
+        ++ok;
+        baseline.add(s->baseline_ms);
+        command.add(s->command_ms);
+        wait.add(s->wait_ms);
+        download.add(s->download_ms);
+        total.add(s->total_ms);
+        image_bytes += s->image_bytes;
+    }
+};
+
+static bool count_sink(const void*, size_t len, void* ctx) {
+    *static_cast<unsigned long long*>(ctx) += len;
+    return true;
+}
+static void count_reset(void* ctx) { *static_cast<unsigned long long*>(ctx) = 0; }
+
+static double epoch_now() {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// One capture the way Final.c's network stage runs it; false on any failure.
+static bool capture_one(const std::string& id, Sample& s) {
+    auto t0 = bench_clock::now();
+    char* token = st_token_get();
+    if (!token) return false;
+    bool ok = false;
+    do {
+        auto t = bench_clock::now();
+        double prev = st_image_baseline(id.c_str(), token);
+        s.baseline_ms = ms_since(t);
+
+        t = bench_clock::now();
+        double cmd_time = epoch_now();
+        st_cmd_batch_t b;
+        st_cmd_batch_init(&b, id.c_str());
+        st_cmd_add(&b, "main", "refresh", "refresh", nullptr);
+        st_cmd_add(&b, "main", "imageCapture", "take", nullptr);
+        if (st_cmd_flush(&b, token, nullptr) < 2) break;
+        s.command_ms = ms_since(t);
+
+        t = bench_clock::now();
+        st_backoff_t backoff = ST_BACKOFF_DEFAULT;
+        char url[512];
+        if (!st_wait_new_image(id.c_str(), token, prev, cmd_time, &backoff, nullptr, nullptr, url, sizeof(url)))
+            break;
+        s.wait_ms = ms_since(t);
+
+        t = bench_clock::now();
+        st_http_req_t req{};
+        req.url = url;
+        req.bearer = token;
+        if (!st_http_download_stream(&req, 0, count_sink, count_reset, &s.image_bytes, nullptr)) break;
+        s.download_ms = ms_since(t);
+        s.total_ms = ms_since(t0);
+        ok = true;
+    } while (false);
+    free(token);
+    return ok;
+}
+
+static std::vector<std::string> list_devices(LatencyRecorder& rec) {
+    std::vector<std::string> ids;
+    char* token = st_token_get();
+    if (!token) return ids;
+    auto t0 = bench_clock::now();
+    st_http_req_t req{};
+    req.url = API_BASE "/devices";
+    req.bearer = token;
+    st_buf_t m{};
+    st_http_info_t info;
+    bool ok = st_http_perform(&req, &m, nullptr, &info);
+    free(token);
+    if (ok) {
+        rec.add(ms_since(t0));
+        char paths[ST_MOCK_MAX_DEVICES][40], vals[ST_MOCK_MAX_DEVICES][64];
+        st_json_target_t t[ST_MOCK_MAX_DEVICES];
+        for (int i = 0; i < ST_MOCK_MAX_DEVICES; ++i) {
+            snprintf(paths[i], sizeof(paths[i]), "items[%d].deviceId", i);
+            t[i] = st_json_target_t{paths[i], vals[i], sizeof(vals[i]), false};
+        }
+        st_json_extract(m.buf, m.len, t, ST_MOCK_MAX_DEVICES);
+        for (int i = 0; i < ST_MOCK_MAX_DEVICES && t[i].found; ++i) ids.emplace_back(vals[i]);
+    }
+    free(m.buf);
+    return ids;
+}
+
+static double cpu_sec() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char** argv) {
+    auto opt = [&](const char* flag, const char* def) {
+        const char* v = arg_value(argc, argv, flag);
+        return std::string(v ? v : def);
+    };
+    st_mock_cfg_t cfg;
+    st_mock_cfg_default(&cfg);
+    const std::string scenario = opt("--scenario", "");
+    if (!scenario.empty() && !st_mock_cfg_load(&cfg, scenario.c_str())) {
+        std::cerr << "bad scenario " << scenario << "\n";
+        return 2;
+    }
+    cfg.port = std::stoi(opt("--port", std::to_string(cfg.port).c_str()));
+    const int captures = std::stoi(opt("--captures", "40"));
+    const int concurrency = std::max(1, std::stoi(opt("--concurrency", "4")));
+    const int lists = std::stoi(opt("--lists", "20"));
+    const std::string json_path = opt("--json", "");
+    const std::string metrics_path = opt("--metrics", "");
+
+    // fork before any thread exists
+    int pfd[2];
+    if (pipe(pfd) != 0) return 1;
+    pid_t child = fork();
+    if (child < 0) return 1;
+    if (child == 0) {
+        close(pfd[0]);
+        _exit(mock_child(cfg, pfd[1]));
+    }
+    close(pfd[1]);
+    if (!wait_listening(cfg.port)) {
+        std::cerr << "mock server did not come up on port " << cfg.port << "\n";
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+        return 1;
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    st_http_init();
+    const std::string mock = "http://127.0.0.1:" + std::to_string(cfg.port);
+    st_http_map_origin("https://api.smartthings.com", mock.c_str());
+    st_http_map_origin("https://auth-global.api.smartthings.com", mock.c_str());
+
+    // token file that gets refreshed through the mock once it nears expiry
+    char dir[] = "/tmp/st_bench.XXXXXX";
+    if (!mkdtemp(dir)) return 1;
+    const std::string token_path = std::string(dir) + "/token.txt";
+    {
+        std::ofstream f(token_path);
+        f << "client_id=bench\nclient_secret=bench\nrefresh_token=mock-refresh-0\naccess_token=mock-access-0\n"
+          << "expires_in=" << cfg.token_ttl_sec << "\nexpires_at=" << (long long)(time(nullptr) + cfg.token_ttl_sec) << "\n";
+    }
+    st_token_init(token_path.c_str());
+
+    std::cout << "mock: " << cfg.devices << " devices, image delay " << cfg.image_delay_ms << " ms, connect "
+              << cfg.connect_ms << " ms\n";
+    for (int r = 0; r < ST_MOCK_ROUTES; ++r) {
+        const st_mock_route_t& rt = cfg.routes[r];
+        std::cout << "  " << st_mock_route_name(static_cast<st_mock_route_e>(r)) << ": " << rt.latency_ms << "+"
+                  << rt.jitter_ms << " ms, errors " << rt.error_rate * 100 << "%, bytes " << rt.bytes << "\n";
+    }
+
+    double cpu0 = cpu_sec();
+    LatencyRecorder t_list("list_devices");
+    std::vector<std::string> ids;
+    auto t_lists = bench_clock::now();
+    for (int i = 0; i < std::max(1, lists); ++i) {
+        auto got = list_devices(t_list);
+        if (!got.empty()) ids = got;
+    }
+    double lists_ms = ms_since(t_lists);
+    if (ids.empty()) {
+        std::cerr << "no devices listed\n";
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+        return 1;
+    }
+
+    Stages st;
+    std::atomic<int> left{captures};
+    auto t_caps = bench_clock::now();
+    std::vector<std::thread> workers;
+    for (int w = 0; w < concurrency; ++w) {
+        workers.emplace_back([&, w] {
+            std::vector<std::string> mine;
+            for (size_t i = w; i < ids.size(); i += concurrency) mine.push_back(ids[i]);
+            if (mine.empty()) return;
+            for (size_t n = 0; left.fetch_sub(1) > 0; ++n) {
+                Sample s;
+                st.add(capture_one(mine[n % mine.size()], s) ? &s : nullptr);
+            }
+        });
+    }
+    for (auto& t : workers) t.join();
+    double caps_sec = ms_since(t_caps) / 1000.0;
+    double cpu = cpu_sec() - cpu0;
+
+    if (!metrics_path.empty()) st_metrics_write(metrics_path.c_str());
+    st_token_cleanup();
+    st_http_cleanup();
+    curl_global_cleanup();
+    unlink(token_path.c_str());
+    rmdir(dir);
+
+    kill(child, SIGTERM);
+    st_mock_stats_t ms{};
+    bool have_ms = read(pfd[0], &ms, sizeof(ms)) == (ssize_t)sizeof(ms);
+    close(pfd[0]);
+    waitpid(child, nullptr, 0);
+
+    const double rate = caps_sec > 0 ? st.ok / caps_sec : 0;
+    const double wall = lists_ms / 1000.0 + caps_sec;
+    std::cout << "\ncaptures: " << st.ok << " ok, " << st.failed << " failed in " << caps_sec << " s ("
+              << rate << "/s, concurrency " << concurrency << ")\n";
+    t_list.print(std::cout);
+    st.total.print(std::cout);
+    st.baseline.print(std::cout);
+    st.command.print(std::cout);
+    st.wait.print(std::cout);
+    st.download.print(std::cout);
+    if (have_ms) {
+        std::cout << "mock: " << ms.requests << " requests over " << ms.connections << " connections, "
+                  << ms.errors << " injected errors, " << ms.bytes_out << " bytes out, " << ms.bytes_in << " in\n";
+        for (int r = 0; r < ST_MOCK_ROUTES; ++r)
+            std::cout << "  " << st_mock_route_name(static_cast<st_mock_route_e>(r)) << ": " << ms.by_route[r] << "\n";
+        if (st.ok)
+            std::cout << "per capture: " << (double)(ms.by_route[ST_MOCK_STATUS] + ms.by_route[ST_MOCK_COMMANDS] + ms.by_route[ST_MOCK_CDN]) / st.ok
+                      << " requests\n";
+    }
+    std::cout << "client cpu: " << cpu << " s (" << (wall > 0 ? 100.0 * cpu / wall : 0) << "% of one core"
+              << (st.ok ? ", " + std::to_string(1000.0 * cpu / st.ok) + " ms per capture" : std::string()) << ")\n";
+
+    if (!json_path.empty()) {
+        std::ofstream js(json_path);
+        js << "{\"captures_ok\":" << st.ok << ",\"captures_failed\":" << st.failed
+           << ",\"captures_per_sec\":" << rate << ",\"cpu_sec\":" << cpu
+           << ",\"requests\":" << ms.requests << ",\"connections\":" << ms.connections
+           << ",\"bytes_out\":" << ms.bytes_out << ",\"bytes_in\":" << ms.bytes_in
+           << ",\"image_bytes\":" << st.image_bytes << ",\"list_devices\":";
+        t_list.to_json(js);
+        js << ",\"capture\":";
+        st.total.to_json(js);
+        js << ",\"baseline\":";
+        st.baseline.to_json(js);
+        js << ",\"command\":";
+        st.command.to_json(js);
+        js << ",\"wait_frame\":";
+        st.wait.to_json(js);
+        js << ",\"download\":";
+        st.download.to_json(js);
+        js << "}\n";
+        std::cout << "wrote " << json_path << "\n";
+    }
+    return have_ms && st.ok > 0 ? 0 : 1;
+}
@@ -0,0 +1,487 @@
+#include "st_caps.h"
+
+#include "st_device_cache.h"
+#include "st_http.h"
+#include "st_json_path.h"
+#include "st_vlm.h"
+
+#include <dlog.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "ST_CAPS"
+#define API_BASE "https://api.smartthings.com/v1"
+
+#define MAX_DEVICES 64
+#define MAX_COMPONENTS 8
+#define MAX_CAPS 32                     // per component
+#define MAX_DEFS 96
+#define MAX_CMDS 12                     // parsed commands per definition
+#define MAX_ENUM 8
+#define DEF_RETRY_SEC 60                // a failed definition fetch is retried after this
+
+typedef enum { SCHEMA_ANY, SCHEMA_INT, SCHEMA_NUMBER, SCHEMA_STRING, SCHEMA_BOOL } schema_type_e;
+
+typedef struct {
+    char name[32];
+    schema_type_e type;
+    bool optional;
+    bool has_min, has_max;
+    double min, max;
+    int n_enum;
+    char enums[MAX_ENUM][32];
+} arg_schema_t;
+
+typedef struct {
+    char name[64];
+    bool exists;
+    int nargs;
+    arg_schema_t args[ST_CAPS_MAX_ARGS];
+} cmd_schema_t;
+
+typedef struct {
+    char id[64];
+    int version;
+    char *json;                 // NULL until fetched
+    time_t failed_at;
+    int ncmds;
+    cmd_schema_t cmds[MAX_CMDS];
+} def_t;
+
+typedef struct {
+    char id[64];
+    int version;
+} cap_ref_t;
+
+typedef struct {
+    char id[32];
+    int ncaps;
+    cap_ref_t caps[MAX_CAPS];
+} component_t;
+
+typedef struct {
+    char id[64];
+    int ncomps;
+    component_t comps[MAX_COMPONENTS];
+} device_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static device_t g_devices[MAX_DEVICES];
+static int g_device_count = 0;
+static def_t g_defs[MAX_DEFS];
+static int g_def_count = 0;
+static char g_dir[256] = "";
+
+void st_caps_init(const char *dir) {
+    pthread_mutex_lock(&g_lock);
+    snprintf(g_dir, sizeof(g_dir), "%s", dir ? dir : "");
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_caps_cleanup(void) {
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_def_count; i++) free(g_defs[i].json);
+    memset(g_defs, 0, sizeof(g_defs));
+    g_def_count = 0;
+    g_device_count = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+const char *st_caps_result_str(st_caps_result_e r) {
+    switch (r) {
+    case ST_CAPS_OK:            return "ok";
+    case ST_CAPS_UNCHECKED:     return "queued unchecked (no capability definition)";
+    case ST_CAPS_NO_DEVICE:     return "device description unavailable";
+    case ST_CAPS_NO_CAPABILITY: return "capability not on this component";
+    case ST_CAPS_NO_COMMAND:    return "no such command";
+    case ST_CAPS_BAD_ARGS:      return "arguments do not match the schema";
+    case ST_CAPS_FULL:          return "batch full";
+    }
+    return "?";
+}
+
+// ---------- DEVICES ----------
+static bool device_parse(const char *json, device_t *d) {
+    // components[i].id and components[i].capabilities[k].{id,version} in one pass
+    enum { PER_COMP = 1 + 2 * MAX_CAPS, N = MAX_COMPONENTS * PER_COMP };
+    typedef struct { char path[64]; char out[64]; } slot_t;
+    slot_t *slots = calloc(N, sizeof(*slots));
+    st_json_target_t *t = calloc(N, sizeof(*t));
+    if (!slots || !t) { free(slots); free(t); return false; }
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        int base = c * PER_COMP;
+        snprintf(slots[base].path, sizeof(slots[0].path), "components[%d].id", c);
+        for (int k = 0; k < MAX_CAPS; k++) {
+            snprintf(slots[base + 1 + 2 * k].path, sizeof(slots[0].path), "components[%d].capabilities[%d].id", c, k);
+            snprintf(slots[base + 2 + 2 * k].path, sizeof(slots[0].path),
+                     "components[%d].capabilities[%d].version", c, k);
+        }
+    }
+    for (int i = 0; i < N; i++) t[i] = (st_json_target_t){ slots[i].path, slots[i].out, sizeof(slots[0].out), false };
+    st_json_extract(json, strlen(json), t, N);
+
+    d->ncomps = 0;
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        int base = c * PER_COMP;
+        if (!t[base].found) break;
+        component_t *comp = &d->comps[d->ncomps++];
+        snprintf(comp->id, sizeof(comp->id), "%s", slots[base].out);
+        comp->ncaps = 0;
+        for (int k = 0; k < MAX_CAPS && t[base + 1 + 2 * k].found; k++) {
+            cap_ref_t *cap = &comp->caps[comp->ncaps++];
+            snprintf(cap->id, sizeof(cap->id), "%s", slots[base + 1 + 2 * k].out);
+            cap->version = t[base + 2 + 2 * k].found ? atoi(slots[base + 2 + 2 * k].out) : 1;
+        }
+    }
+    free(slots);
+    free(t);
+    return d->ncomps > 0;
+}
+
+// Copies the parsed device into out, parsing the st_devcache description on first use.
+static bool device_get(const char *device_id, const char *token, device_t *out) {
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_device_count; i++) {
+        if (strcmp(g_devices[i].id, device_id) == 0) {
+            *out = g_devices[i];
+            pthread_mutex_unlock(&g_lock);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    char *json = st_devcache_get(device_id, token, NULL);
+    if (!json) return false;
+    memset(out, 0, sizeof(*out));
+    snprintf(out->id, sizeof(out->id), "%s", device_id);
+    bool ok = device_parse(json, out);
+    free(json);
+    if (!ok) {
+        dlog_print(DLOG_WARN, LOG_TAG, "%s: no components in the description", device_id);
+        return false;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    bool present = false;
+    for (int i = 0; i < g_device_count && !present; i++) present = strcmp(g_devices[i].id, device_id) == 0;
+    if (!present && g_device_count < MAX_DEVICES) g_devices[g_device_count++] = *out;
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+static const cap_ref_t *device_cap(const device_t *d, const char *component, const char *capability) {
+    for (int c = 0; c < d->ncomps; c++) {
+        if (strcmp(d->comps[c].id, component) != 0) continue;
+        for (int k = 0; k < d->comps[c].ncaps; k++)
+            if (strcmp(d->comps[c].caps[k].id, capability) == 0) return &d->comps[c].caps[k];
+    }
+    return NULL;
+}
+
+bool st_caps_device_has(const char *device_id, const char *token,
+                        const char *component, const char *capability) {
+    device_t *d = malloc(sizeof(*d));
+    bool ok = d && device_get(device_id, token, d) && device_cap(d, component, capability);
+    free(d);
+    return ok;
+}
+
+size_t st_caps_describe(const char *device_id, const char *token, char *out, size_t len) {
+    if (!len) return 0;
+    out[0] = '\0';
+    device_t *d = malloc(sizeof(*d));
+    if (!d || !device_get(device_id, token, d)) { free(d); return 0; }
+    size_t used = 0;
+    for (int c = 0; c < d->ncomps && used < len; c++) {
+        int w = snprintf(out + used, len - used, "%s%s:", c ? "\n" : "", d->comps[c].id);
+        for (int k = 0; w >= 0 && k < d->comps[c].ncaps && used + (size_t)w < len; k++) {
+            int x = snprintf(out + used + w, len - used - w, "%s %s", k ? "," : "", d->comps[c].caps[k].id);
+            if (x < 0) break;
+            w += x;
+        }
+        if (w < 0) break;
+        used += (size_t)w < len - used ? (size_t)w : len - used - 1;
+    }
+    free(d);
+    return used;
+}
+
+void st_caps_invalidate(const char *device_id) {
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_device_count; i++) {
+        if (strcmp(g_devices[i].id, device_id) != 0) continue;
+        g_devices[i] = g_devices[--g_device_count];
+        break;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// ---------- DEFINITIONS ----------
+// Definitions are immutable per version: the disk copy never needs revalidating.
+static bool def_path(const char *id, int version, char *out, size_t len) {
+    if (!g_dir[0] || strchr(id, '/') || strstr(id, "..")) return false;
+    snprintf(out, len, "%scap_%s_%d.json", g_dir, id, version);
+    return true;
+}
+
+static char *def_disk_load(const char *id, int version) {
+    char path[384];
+    if (!def_path(id, version, path, sizeof(path))) return NULL;
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *json = n > 0 ? malloc((size_t)n + 1) : NULL;
+    if (json) json[fread(json, 1, (size_t)n, fp)] = '\0';
+    fclose(fp);
+    return json;
+}
+
+static void def_disk_save(const char *id, int version, const char *json) {
+    char path[384];
+    if (!def_path(id, version, path, sizeof(path))) return;
+    FILE *fp = fopen(path, "w");
+    if (!fp) return;
+    fputs(json, fp);
+    fclose(fp);
+}
+
+static schema_type_e parse_schema_type(const char *s) {
+    if (strcmp(s, "integer") == 0) return SCHEMA_INT;
+    if (strcmp(s, "number") == 0) return SCHEMA_NUMBER;
+    if (strcmp(s, "string") == 0) return SCHEMA_STRING;
+    if (strcmp(s, "boolean") == 0) return SCHEMA_BOOL;
+    return SCHEMA_ANY;          // object, array, $ref
+}
+
+// commands.<name> out of a definition: whether it exists and its argument schemas.
+static void cmd_parse(const char *json, const char *name, cmd_schema_t *cmd) {
+    enum { FIELDS = 5 + MAX_ENUM, N = 1 + ST_CAPS_MAX_ARGS * FIELDS };
+    typedef struct { char path[160]; char out[64]; } slot_t;
+    slot_t *slots = calloc(N, sizeof(*slots));
+    st_json_target_t *t = calloc(N, sizeof(*t));
+    memset(cmd, 0, sizeof(*cmd));
+    snprintf(cmd->name, sizeof(cmd->name), "%s", name);
+    if (!slots || !t) { free(slots); free(t); return; }
+
+    // no target on "arguments" itself: a matched container is skipped whole
+    snprintf(slots[0].path, sizeof(slots[0].path), "commands.%s.name", name);
+    static const char *const field[5] = { "name", "optional", "schema.type", "schema.minimum", "schema.maximum" };
+    for (int a = 0; a < ST_CAPS_MAX_ARGS; a++) {
+        slot_t *s = &slots[1 + a * FIELDS];
+        for (int f = 0; f < 5; f++)
+            snprintf(s[f].path, sizeof(s[f].path), "commands.%s.arguments[%d].%s", name, a, field[f]);
+        for (int e = 0; e < MAX_ENUM; e++)
+            snprintf(s[5 + e].path, sizeof(s[5 + e].path), "commands.%s.arguments[%d].schema.enum[%d]", name, a, e);
+    }
+    for (int i = 0; i < N; i++) t[i] = (st_json_target_t){ slots[i].path, slots[i].out, sizeof(slots[0].out), false };
+    st_json_extract(json, strlen(json), t, N);
+
+    cmd->exists = t[0].found || t[1].found;
+    for (int a = 0; cmd->exists && a < ST_CAPS_MAX_ARGS; a++) {
+        const st_json_target_t *at = &t[1 + a * FIELDS];
+        const slot_t *s = &slots[1 + a * FIELDS];
+        if (!at[0].found) break;
+        arg_schema_t *arg = &cmd->args[cmd->nargs++];
+        snprintf(arg->name, sizeof(arg->name), "%s", s[0].out);
+        arg->optional = at[1].found && strcmp(s[1].out, "true") == 0;
+        arg->type = at[2].found ? parse_schema_type(s[2].out) : SCHEMA_ANY;
+        if ((arg->has_min = at[3].found)) arg->min = strtod(s[3].out, NULL);
+        if ((arg->has_max = at[4].found)) arg->max = strtod(s[4].out, NULL);
+        for (int e = 0; e < MAX_ENUM && at[5 + e].found; e++)
+            snprintf(arg->enums[arg->n_enum++], sizeof(arg->enums[0]), "%s", s[5 + e].out);
+    }
+    free(slots);
+    free(t);
+}
+
+// Caller holds g_lock.
+static def_t *def_find(const char *id, int version, bool create) {
+    for (int i = 0; i < g_def_count; i++)
+        if (g_defs[i].version == version && strcmp(g_defs[i].id, id) == 0) return &g_defs[i];
+    if (!create || g_def_count == MAX_DEFS) return NULL;
+    def_t *d = &g_defs[g_def_count++];
+    memset(d, 0, sizeof(*d));
+    snprintf(d->id, sizeof(d->id), "%s", id);
+    d->version = version;
+    d->json = def_disk_load(id, version);
+    return d;
+}
+
+static char *def_fetch(const char *id, int version, const char *token) {
+    char url[256];
+    snprintf(url, sizeof(url), "%s/capabilities/%s/%d", API_BASE, id, version);
+    st_http_req_t req = { .url = url, .bearer = token };
+    st_buf_t body = {0};
+    st_http_info_t info = {0};
+    if (!st_http_perform(&req, &body, NULL, &info)) {
+        dlog_print(DLOG_WARN, LOG_TAG, "capability %s/%d: HTTP %ld", id, version, info.status);
+        free(body.buf);
+        return NULL;
+    }
+    return body.buf;
+}
+
+// Schema of capability/version's command into out; false when the
+// definition is unavailable (fetched at most every DEF_RETRY_SEC).
+static bool cmd_get(const cap_ref_t *cap, const char *command, const char *token, cmd_schema_t *out) {
+    pthread_mutex_lock(&g_lock);
+    def_t *d = def_find(cap->id, cap->version, true);
+    bool need_fetch = d && !d->json && time(NULL) - d->failed_at >= DEF_RETRY_SEC;
+    pthread_mutex_unlock(&g_lock);
+    if (!d) return false;
+
+    if (need_fetch) {
+        char *json = def_fetch(cap->id, cap->version, token);
+        pthread_mutex_lock(&g_lock);
+        if (json && !d->json) {
+            d->json = json;
+            def_disk_save(cap->id, cap->version, json);
+            json = NULL;
+        } else if (!json) {
+            d->failed_at = time(NULL);
+        }
+        pthread_mutex_unlock(&g_lock);
+        free(json);
+    }
+
+    pthread_mutex_lock(&g_lock);
+    bool ok = d->json != NULL;
+    if (ok) {
+        int i = 0;
+        while (i < d->ncmds && strcmp(d->cmds[i].name, command) != 0) i++;
+        if (i == d->ncmds) {
+            cmd_parse(d->json, command, out);
+            if (d->ncmds < MAX_CMDS) d->cmds[d->ncmds++] = *out;
+        } else {
+            *out = d->cmds[i];
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return ok;
+}
+
+// ---------- COMMANDS ----------
+static bool arg_matches(const arg_schema_t *s, const st_arg_t *a) {
+    double v = 0;
+    switch (s->type) {
+    case SCHEMA_ANY:    return true;
+    case SCHEMA_INT:    if (a->type != ST_ARG_INT) return false; v = (double)a->i; break;
+    case SCHEMA_NUMBER:
+        if (a->type != ST_ARG_INT && a->type != ST_ARG_NUMBER) return false;
+        v = a->type == ST_ARG_INT ? (double)a->i : a->num;
+        if (!isfinite(v)) return false;
+        break;
+    case SCHEMA_BOOL:   return a->type == ST_ARG_BOOL;
+    case SCHEMA_STRING:
+        if (a->type != ST_ARG_STRING || !a->str) return false;
+        if (!s->n_enum) return true;
+        for (int e = 0; e < s->n_enum; e++)
+            if (strcmp(s->enums[e], a->str) == 0) return true;
+        return false;
+    }
+    return (!s->has_min || v >= s->min) && (!s->has_max || v <= s->max);
+}
+
+static bool args_valid(const cmd_schema_t *cmd, const st_arg_t *args, int nargs) {
+    if (nargs > cmd->nargs) return false;
+    for (int i = 0; i < cmd->nargs; i++) {
+        if (i >= nargs) {
+            if (!cmd->args[i].optional) return false;
+            continue;
+        }
+        if (!arg_matches(&cmd->args[i], &args[i])) return false;
+    }
+    return true;
+}
+
+// JSON array of args into out; false when it does not fit.
+static bool args_serialize(const st_arg_t *args, int nargs, char *out, size_t cap) {
+    size_t n = 0;
+    out[n++] = '[';
+    for (int i = 0; i < nargs; i++) {
+        const st_arg_t *a = &args[i];
+        if (i) { if (n + 1 >= cap) return false; out[n++] = ','; }
+        int w = 0;
+        switch (a->type) {
+        case ST_ARG_INT:    w = snprintf(out + n, cap - n, "%lld", a->i); break;
+        case ST_ARG_NUMBER:
+            if (!isfinite(a->num)) return false;
+            w = snprintf(out + n, cap - n, "%.17g", a->num);
+            break;
+        case ST_ARG_BOOL:   w = snprintf(out + n, cap - n, "%s", a->b ? "true" : "false"); break;
+        case ST_ARG_JSON:   w = snprintf(out + n, cap - n, "%s", a->str ? a->str : "null"); break;
+        case ST_ARG_STRING: {
+            if (!a->str) return false;
+            size_t el = st_json_escape(a->str, NULL);
+            if (n + el + 2 >= cap) return false;
+            out[n++] = '"';
+            n += st_json_escape(a->str, out + n);
+            out[n++] = '"';
+            continue;
+        }
+        }
+        if (w < 0 || (size_t)w >= cap - n) return false;
+        n += (size_t)w;
+    }
+    if (n + 1 >= cap) return false;
+    out[n++] = ']';
+    out[n] = '\0';
+    return true;
+}
+
+st_caps_result_e st_caps_add(st_cmd_batch_t *b, const char *token,
+                             const char *component, const char *capability,
+                             const char *command, const st_arg_t *args, int nargs) {
+    if (nargs < 0 || nargs > ST_CAPS_MAX_ARGS || (nargs && !args)) return ST_CAPS_BAD_ARGS;
+    device_t *d = malloc(sizeof(*d));
+    if (!d || !device_get(b->device_id, token, d)) { free(d); return ST_CAPS_NO_DEVICE; }
+    const cap_ref_t *found = device_cap(d, component, capability);
+    cap_ref_t cap = found ? *found : (cap_ref_t){ "", 0 };
+    free(d);
+    if (!found) return ST_CAPS_NO_CAPABILITY;
+
+    st_caps_result_e r = ST_CAPS_OK;
+    cmd_schema_t cmd;
+    if (!cmd_get(&cap, command, token, &cmd)) r = ST_CAPS_UNCHECKED;
+    else if (!cmd.exists) return ST_CAPS_NO_COMMAND;
+    else if (!args_valid(&cmd, args, nargs)) return ST_CAPS_BAD_ARGS;
+
+    char json[sizeof(b->cmds[0].arguments)];
+    if (!args_serialize(args, nargs, json, sizeof(json))) return ST_CAPS_FULL;
+    if (!st_cmd_add(b, component, capability, command, json)) return ST_CAPS_FULL;
+    return r;
+}
+
+// ---------- MULTI-DEVICE DISPATCH ----------
+void st_dispatch_init(st_dispatch_t *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+st_caps_result_e st_dispatch_add(st_dispatch_t *d, const char *token, const char *device_id,
+                                 const char *component, const char *capability,
+                                 const char *command, const st_arg_t *args, int nargs) {
+    st_cmd_batch_t *b = NULL;
+    for (int i = 0; i < d->count && !b; i++)
+        if (strcmp(d->batches[i].device_id, device_id) == 0) b = &d->batches[i];
+    if (!b) {
+        if (d->count == ST_DISPATCH_MAX_DEVICES) return ST_CAPS_FULL;
+        b = &d->batches[d->count++];
+        st_cmd_batch_init(b, device_id);
+    }
+    return st_caps_add(b, token, component, capability, command, args, nargs);
+}
+
+int st_dispatch_flush(st_dispatch_t *d, const char *token) {
+    int ok = 0;
+    for (int i = 0; i < d->count; i++) {
+        int n = st_cmd_flush(&d->batches[i], token, NULL);
+        if (n > 0) ok += n;
+    }
+    return ok;
+}
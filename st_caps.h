@@ -0,0 +1,115 @@
+#ifndef ST_CAPS_H
+#define ST_CAPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "st_commands.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- CAPABILITY-CHECKED COMMANDS ----------
+// Commands built from a compact argument list and checked against the
+// device's own capability schema before they are queued, instead of
+// hand-formatted JSON per call site:
+//
+//   st_arg_t level = ST_ARG_INT(40);
+//   st_caps_add(&batch, token, "main", "switchLevel", "setLevel", &level, 1);
+//   st_caps_add(&batch, token, "main", "switch", "on", NULL, 0);
+//   st_cmd_flush(&batch, token, NULL);
+//
+// Two things are loaded once and kept:
+//  - the device's components and their capability ids/versions, parsed
+//    from the st_devcache description (/devices/{id})
+//  - each capability definition (/capabilities/{id}/{version}), which
+//    never changes for a version; mirrored to <dir>/cap_<id>_<v>.json
+// A command is parsed out of its definition the first time it is used.
+//
+// Checks: the component has the capability, the capability has the
+// command, required arguments are present, each argument has the schema
+// type (integer, number, string, boolean; anything else takes raw JSON),
+// numbers are within minimum/maximum and strings in enum. When a
+// definition cannot be fetched the command is queued unchecked (a schema
+// outage must not stop captures) and st_caps_add says so.
+//
+// st_dispatch_t spreads commands for several devices over one batch per
+// device. All st_caps_* functions are thread-safe.
+
+#define ST_CAPS_MAX_ARGS 4
+
+typedef enum {
+    ST_ARG_INT,
+    ST_ARG_NUMBER,
+    ST_ARG_STRING,
+    ST_ARG_BOOL,
+    ST_ARG_JSON,                // raw JSON value (objects, arrays)
+} st_arg_type_e;
+
+typedef struct {
+    st_arg_type_e type;
+    long long i;
+    double num;
+    bool b;
+    const char *str;            // ST_ARG_STRING / ST_ARG_JSON
+} st_arg_t;
+
+#define ST_ARG_INT(v)    ((st_arg_t){ .type = ST_ARG_INT, .i = (v) })
+#define ST_ARG_NUMBER(v) ((st_arg_t){ .type = ST_ARG_NUMBER, .num = (v) })
+#define ST_ARG_STRING(v) ((st_arg_t){ .type = ST_ARG_STRING, .str = (v) })
+#define ST_ARG_BOOL(v)   ((st_arg_t){ .type = ST_ARG_BOOL, .b = (v) })
+#define ST_ARG_JSON(v)   ((st_arg_t){ .type = ST_ARG_JSON, .str = (v) })
+
+typedef enum {
+    ST_CAPS_OK,
+    ST_CAPS_UNCHECKED,          // queued, but the definition was unavailable
+    ST_CAPS_NO_DEVICE,          // description not available
+    ST_CAPS_NO_CAPABILITY,      // component missing or without it
+    ST_CAPS_NO_COMMAND,
+    ST_CAPS_BAD_ARGS,
+    ST_CAPS_FULL,               // batch full or arguments too long
+} st_caps_result_e;
+
+// dir may be NULL for a memory-only definition cache. Needs st_devcache_init.
+void st_caps_init(const char *dir);
+void st_caps_cleanup(void);
+
+const char *st_caps_result_str(st_caps_result_e r);
+
+bool st_caps_device_has(const char *device_id, const char *token,
+                        const char *component, const char *capability);
+
+// "main: imageCapture, motionSensor, refresh" one line per component.
+// Returns the length written, 0 when the device is unknown.
+size_t st_caps_describe(const char *device_id, const char *token, char *out, size_t len);
+
+// Checks and serializes one command into b (b->device_id's schema).
+// Queues on ST_CAPS_OK and ST_CAPS_UNCHECKED only.
+st_caps_result_e st_caps_add(st_cmd_batch_t *b, const char *token,
+                             const char *component, const char *capability,
+                             const char *command, const st_arg_t *args, int nargs);
+
+// Drops the parsed device (e.g. after a firmware update added capabilities).
+void st_caps_invalidate(const char *device_id);
+
+// ---------- MULTI-DEVICE DISPATCH ----------
+#define ST_DISPATCH_MAX_DEVICES 16
+
+typedef struct {
+    st_cmd_batch_t batches[ST_DISPATCH_MAX_DEVICES];
+    int count;
+} st_dispatch_t;
+
+void st_dispatch_init(st_dispatch_t *d);
+st_caps_result_e st_dispatch_add(st_dispatch_t *d, const char *token, const char *device_id,
+                                 const char *component, const char *capability,
+                                 const char *command, const st_arg_t *args, int nargs);
+// One request per device; returns the commands not FAILED over all batches.
+int st_dispatch_flush(st_dispatch_t *d, const char *token);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#include "st_commands.h"
+
+#include "st_json_path.h"
+
+#include <dlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "ST_CMD"
+#define API_BASE "https://api.smartthings.com/v1"
+
+void st_cmd_batch_init(st_cmd_batch_t *b, const char *device_id) {
+    memset(b, 0, sizeof(*b));
+    snprintf(b->device_id, sizeof(b->device_id), "%s", device_id);
+}
+
+bool st_cmd_add(st_cmd_batch_t *b, const char *component, const char *capability,
+                const char *command, const char *arguments_json) {
+    const char *args = arguments_json ? arguments_json : "[]";
+    for (int i = 0; i < b->count; i++) {
+        const st_cmd_t *c = &b->cmds[i];
+        if (c->status == ST_CMD_QUEUED && strcmp(c->component, component) == 0 &&
+            strcmp(c->capability, capability) == 0 && strcmp(c->command, command) == 0 &&
+            strcmp(c->arguments, args) == 0)
+            return true;
+    }
+    if (b->count >= ST_CMD_MAX || strlen(args) >= sizeof(b->cmds[0].arguments)) return false;
+    st_cmd_t *c = &b->cmds[b->count++];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->component, sizeof(c->component), "%s", component);
+    snprintf(c->capability, sizeof(c->capability), "%s", capability);
+    snprintf(c->command, sizeof(c->command), "%s", command);
+    snprintf(c->arguments, sizeof(c->arguments), "%s", args);
+    c->status = ST_CMD_QUEUED;
+    return true;
+}
+
+static st_cmd_status_e parse_status(const char *s) {
+    if (strcmp(s, "COMPLETED") == 0) return ST_CMD_COMPLETED;
+    if (strcmp(s, "ACCEPTED") == 0) return ST_CMD_ACCEPTED;
+    return ST_CMD_FAILED;
+}
+
+int st_cmd_flush(st_cmd_batch_t *b, const char *token, st_http_info_t *info) {
+    int sent[ST_CMD_MAX];
+    int n = 0;
+    for (int i = 0; i < b->count; i++)
+        if (b->cmds[i].status == ST_CMD_QUEUED) sent[n++] = i;
+    if (n == 0) return 0;
+
+    // names are plain identifiers; arguments are already JSON
+    char body[ST_CMD_MAX * 512 + 32];
+    size_t len = (size_t)snprintf(body, sizeof(body), "{\"commands\":[");
+    for (int k = 0; k < n; k++) {
+        const st_cmd_t *c = &b->cmds[sent[k]];
+        len += (size_t)snprintf(body + len, sizeof(body) - len,
+                                "%s{\"component\":\"%s\",\"capability\":\"%s\",\"command\":\"%s\",\"arguments\":%s}",
+                                k ? "," : "", c->component, c->capability, c->command, c->arguments);
+    }
+    snprintf(body + len, sizeof(body) - len, "]}");
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/devices/%s/commands", API_BASE, b->device_id);
+    st_http_req_t req = { .url = url, .bearer = token,
+                          .content_type = "application/json", .body = body };
+    st_buf_t m = {0};
+    st_http_info_t local;
+    st_http_info_t *in = info ? info : &local;
+    if (!st_http_perform(&req, &m, NULL, in)) {
+        dlog_print(DLOG_WARN, LOG_TAG, "%s: %d command(s) failed (HTTP %ld)", b->device_id, n, in->status);
+        for (int k = 0; k < n; k++) b->cmds[sent[k]].status = ST_CMD_FAILED;
+        free(m.buf);
+        return -1;
+    }
+
+    // results come back in command order
+    char paths[ST_CMD_MAX][2][40];
+    char status[ST_CMD_MAX][16];
+    st_json_target_t t[ST_CMD_MAX * 2];
+    for (int k = 0; k < n; k++) {
+        st_cmd_t *c = &b->cmds[sent[k]];
+        snprintf(paths[k][0], sizeof(paths[k][0]), "results[%d].status", k);
+        snprintf(paths[k][1], sizeof(paths[k][1]), "results[%d].id", k);
+        t[2 * k] = (st_json_target_t){ paths[k][0], status[k], sizeof(status[k]), false };
+        t[2 * k + 1] = (st_json_target_t){ paths[k][1], c->result_id, sizeof(c->result_id), false };
+    }
+    st_json_extract(m.buf, m.len, t, (size_t)n * 2);
+    free(m.buf);
+
+    int ok = 0;
+    for (int k = 0; k < n; k++) {
+        st_cmd_t *c = &b->cmds[sent[k]];
+        // a 2xx without a per-command result still means the batch was taken
+        c->status = t[2 * k].found ? parse_status(status[k]) : ST_CMD_ACCEPTED;
+        if (c->status == ST_CMD_FAILED)
+            dlog_print(DLOG_WARN, LOG_TAG, "%s: %s.%s rejected", b->device_id, c->capability, c->command);
+        else
+            ok++;
+    }
+    return ok;
+}
@@ -0,0 +1,68 @@
+#ifndef ST_COMMANDS_H
+#define ST_COMMANDS_H
+
+#include <stdbool.h>
+
+#include "st_http.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- BATCHED DEVICE COMMANDS ----------
+// Queues commands for one device and sends them as a single
+// POST /devices/{id}/commands {"commands":[...]}. A capture cycle used to
+// post Refresh and imageCapture.take separately; batched they cost one
+// round trip, and so does any multi-capability action.
+//
+//   st_cmd_batch_t b;
+//   st_cmd_batch_init(&b, device_id);
+//   st_cmd_add(&b, "main", "Refresh", "refresh", NULL);
+//   st_cmd_add(&b, "main", "imageCapture", "take", NULL);
+//   st_cmd_flush(&b, token, NULL);     // b.cmds[i].status per command
+//
+// The API answers {"results":[{"id":..,"status":"ACCEPTED"|"COMPLETED"|
+// "FAILED"},..]} in command order; each result is kept with its command.
+
+#define ST_CMD_MAX 8
+
+typedef enum {
+    ST_CMD_QUEUED,              // not sent yet
+    ST_CMD_ACCEPTED,
+    ST_CMD_COMPLETED,
+    ST_CMD_FAILED,              // rejected, or the request itself failed
+} st_cmd_status_e;
+
+typedef struct {
+    char component[32];
+    char capability[64];
+    char command[64];
+    char arguments[256];        // raw JSON array
+    st_cmd_status_e status;
+    char result_id[64];
+} st_cmd_t;
+
+typedef struct {
+    char device_id[64];
+    st_cmd_t cmds[ST_CMD_MAX];
+    int count;
+} st_cmd_batch_t;
+
+void st_cmd_batch_init(st_cmd_batch_t *b, const char *device_id);
+
+// arguments_json is a JSON array ("[]" when NULL). A command identical to
+// one still queued is not added twice. Returns false when the batch is full.
+bool st_cmd_add(st_cmd_batch_t *b, const char *component, const char *capability,
+                const char *command, const char *arguments_json);
+
+// Sends every ST_CMD_QUEUED command in one request; their status and
+// result id are filled in from the reply. Returns how many of them were
+// not FAILED, 0 when nothing was queued, -1 when the request failed (all
+// sent commands are then FAILED).
+int st_cmd_flush(st_cmd_batch_t *b, const char *token, st_http_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
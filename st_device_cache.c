@@ -0,0 +1,239 @@
+#include "st_device_cache.h"
+
+#include "st_http.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "ST_DEVCACHE"
+#define API_BASE "https://api.smartthings.com/v1"
+
+typedef struct {
+    char id[64];
+    char *json;
+    char etag[128];
+    time_t fetched;
+    bool refreshing;
+} entry_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_idle = PTHREAD_COND_INITIALIZER;
+static entry_t g_entries[ST_DEVCACHE_MAX_DEVICES];
+static int g_count = 0;
+static int g_inflight = 0;
+static char g_dir[256] = "";
+static int g_ttl = ST_DEVCACHE_DEFAULT_TTL_SEC;
+
+void st_devcache_init(const char *dir, int ttl_sec) {
+    pthread_mutex_lock(&g_lock);
+    snprintf(g_dir, sizeof(g_dir), "%s", dir ? dir : "");
+    g_ttl = ttl_sec > 0 ? ttl_sec : ST_DEVCACHE_DEFAULT_TTL_SEC;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_devcache_cleanup(void) {
+    pthread_mutex_lock(&g_lock);
+    // background revalidations hold no lock while on the wire; wait them out
+    while (g_inflight > 0) pthread_cond_wait(&g_idle, &g_lock);
+    for (int i = 0; i < g_count; i++) free(g_entries[i].json);
+    memset(g_entries, 0, sizeof(g_entries));
+    g_count = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+// ---------- DISK MIRROR ----------
+// File layout: "<etag>\t<fetched>\n" followed by the raw JSON.
+static bool disk_path(const char *id, char *out, size_t len) {
+    if (!g_dir[0] || strchr(id, '/') || strstr(id, "..")) return false;
+    snprintf(out, len, "%sdevcache_%s.json", g_dir, id);
+    return true;
+}
+
+static void disk_save(const entry_t *e) {
+    char path[384];
+    if (!disk_path(e->id, path, sizeof(path))) return;
+    FILE *fp = fopen(path, "w");
+    if (!fp) return;
+    fprintf(fp, "%s\t%lld\n%s", e->etag, (long long)e->fetched, e->json);
+    fclose(fp);
+}
+
+static bool disk_load(entry_t *e) {
+    char path[384];
+    if (!disk_path(e->id, path, sizeof(path))) return false;
+    FILE *fp = fopen(path, "r");
+    if (!fp) return false;
+    char head[192];
+    long long fetched = 0;
+    bool ok = false;
+    if (fgets(head, sizeof(head), fp)) {
+        char *tab = strchr(head, '\t');
+        if (tab) {
+            *tab = '\0';
+            fetched = atoll(tab + 1);
+            long start = ftell(fp);
+            fseek(fp, 0, SEEK_END);
+            long end = ftell(fp);
+            fseek(fp, start, SEEK_SET);
+            char *json = end > start ? malloc((size_t)(end - start) + 1) : NULL;
+            if (json) {
+                size_t n = fread(json, 1, (size_t)(end - start), fp);
+                json[n] = '\0';
+                e->json = json;
+                snprintf(e->etag, sizeof(e->etag), "%.127s", head);
+                e->fetched = (time_t)fetched;
+                ok = true;
+            }
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+static void disk_remove(const char *id) {
+    char path[384];
+    if (disk_path(id, path, sizeof(path))) remove(path);
+}
+
+// ---------- ENTRIES ----------
+// Caller holds g_lock. create: add (and try to preload from disk) when absent.
+static entry_t *entry_find(const char *id, bool create) {
+    for (int i = 0; i < g_count; i++)
+        if (strcmp(g_entries[i].id, id) == 0) return &g_entries[i];
+    if (!create || g_count >= ST_DEVCACHE_MAX_DEVICES) return NULL;
+    entry_t *e = &g_entries[g_count++];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->id, sizeof(e->id), "%s", id);
+    disk_load(e);
+    return e;
+}
+
+// Conditional GET. Returns 200 with *json set, 304, or 0 on failure.
+static int fetch(const char *id, const char *token, const char *etag,
+                 char **json, char *etag_out, size_t etag_len) {
+    char url[256];
+    snprintf(url, sizeof(url), "%s/devices/%s", API_BASE, id);
+    st_http_req_t req = { .url = url, .bearer = token, .if_none_match = etag };
+    st_buf_t m = {0};
+    st_http_info_t info;
+    bool ok = st_http_perform(&req, &m, NULL, &info);
+    if (info.status == 304) { free(m.buf); return 304; }
+    if (!ok) {
+        dlog_print(DLOG_WARN, LOG_TAG, "fetch %s failed (HTTP %ld)", id, info.status);
+        free(m.buf);
+        return 0;
+    }
+    *json = m.buf;
+    snprintf(etag_out, etag_len, "%s", info.etag);
+    return 200;
+}
+
+// Stores a fetch result; caller holds g_lock.
+static void entry_update(entry_t *e, int code, char *json, const char *etag) {
+    if (code == 200) {
+        free(e->json);
+        e->json = json;
+        snprintf(e->etag, sizeof(e->etag), "%s", etag);
+    }
+    if (code) {
+        e->fetched = time(NULL);
+        disk_save(e);
+    }
+}
+
+typedef struct {
+    char id[64];
+    char *token;
+    char etag[128];
+} refresh_arg_t;
+
+static void *refresh_thread(void *p) {
+    refresh_arg_t *a = p;
+    char *json = NULL;
+    char etag[128] = "";
+    int code = fetch(a->id, a->token, a->etag, &json, etag, sizeof(etag));
+
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = entry_find(a->id, false);
+    if (e) {
+        entry_update(e, code, json, etag);
+        e->refreshing = false;
+        json = NULL;
+    }
+    if (--g_inflight == 0) pthread_cond_broadcast(&g_idle);
+    pthread_mutex_unlock(&g_lock);
+
+    dlog_print(DLOG_DEBUG, LOG_TAG, "revalidated %s: %s", a->id,
+               code == 304 ? "not modified" : code == 200 ? "updated" : "failed");
+    free(json);
+    free(a->token);
+    free(a);
+    return NULL;
+}
+
+// Caller holds g_lock.
+static void refresh_async(entry_t *e, const char *token) {
+    refresh_arg_t *a = calloc(1, sizeof(*a));
+    if (!a) return;
+    snprintf(a->id, sizeof(a->id), "%s", e->id);
+    snprintf(a->etag, sizeof(a->etag), "%s", e->etag);
+    a->token = strdup(token);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t th;
+    if (a->token && pthread_create(&th, &attr, refresh_thread, a) == 0) {
+        e->refreshing = true;
+        g_inflight++;
+    } else {
+        free(a->token);
+        free(a);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+char *st_devcache_get(const char *device_id, const char *token, bool *from_cache) {
+    if (from_cache) *from_cache = false;
+    if (!device_id || !token) return NULL;
+
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = entry_find(device_id, true);
+    if (e && e->json) {
+        if (time(NULL) - e->fetched >= g_ttl && !e->refreshing) refresh_async(e, token);
+        char *copy = strdup(e->json);
+        pthread_mutex_unlock(&g_lock);
+        if (from_cache) *from_cache = true;
+        return copy;
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    char *json = NULL;
+    char etag[128] = "";
+    if (fetch(device_id, token, NULL, &json, etag, sizeof(etag)) != 200) return NULL;
+
+    char *copy = strdup(json);
+    pthread_mutex_lock(&g_lock);
+    e = entry_find(device_id, true);
+    if (e) entry_update(e, 200, json, etag);
+    else free(json);
+    pthread_mutex_unlock(&g_lock);
+    return copy;
+}
+
+void st_devcache_invalidate(const char *device_id) {
+    if (!device_id) return;
+    pthread_mutex_lock(&g_lock);
+    entry_t *e = entry_find(device_id, false);
+    if (e) {
+        free(e->json);
+        e->json = NULL;
+        e->etag[0] = '\0';
+        e->fetched = 0;
+    }
+    disk_remove(device_id);
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,42 @@
+#ifndef ST_DEVICE_CACHE_H
+#define ST_DEVICE_CACHE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- DEVICE DESCRIPTION CACHE ----------
+// /devices/{id} (name, components, capabilities) almost never changes, yet
+// the capability view used to refetch it on every click. Descriptions are
+// kept in memory and mirrored to <dir>/devcache_<id>.json together with
+// their ETag, so they also survive restarts.
+//
+//  - fresh (younger than ttl): returned without any request
+//  - stale: returned immediately, revalidated in the background with
+//    If-None-Match (a 304 only renews the timestamp)
+//  - missing: fetched synchronously
+//
+// All functions are thread-safe.
+
+#define ST_DEVCACHE_MAX_DEVICES 128
+#define ST_DEVCACHE_DEFAULT_TTL_SEC (6 * 3600)
+
+// dir may be NULL for a memory-only cache. ttl_sec <= 0 -> default.
+void st_devcache_init(const char *dir, int ttl_sec);
+void st_devcache_cleanup(void);
+
+// Returns a malloc'd copy of the device JSON (caller frees), or NULL when
+// it is neither cached nor fetchable. *from_cache (optional) tells whether
+// the answer was served without waiting for the network.
+char *st_devcache_get(const char *device_id, const char *token, bool *from_cache);
+
+// Drops the entry so the next get refetches (memory and disk).
+void st_devcache_invalidate(const char *device_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,372 @@
+#include "st_devstate.h"
+
+#include "st_http.h"
+#include "st_image_ready.h"
+#include "st_json_path.h"
+#include "st_token.h"
+#include "st_transport.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_DEVSTATE"
+#define MAX_ENTRIES 256
+#define STREAM_TIMEOUT_SEC (15 * 60)    // a connection is renewed (and re-seeded) this often
+#define RECONNECT_MIN_SEC 1
+#define RECONNECT_MAX_SEC 60
+#define LINE_MAX_BYTES 4096
+#define EVENT_MAX_BYTES 8192
+
+typedef struct {
+    char device[64];
+    char component[32];
+    char capability[64];
+    char attribute[64];
+    char value[512];
+    double ts;
+} entry_t;
+
+typedef struct {
+    char capability[64];
+    char attribute[64];
+} tracked_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static bool g_running = false;
+static atomic_bool g_stop;
+static bool g_live = false;
+static char g_url[512];
+static entry_t g_entries[MAX_ENTRIES];
+static size_t g_entry_count = 0;
+static tracked_t g_tracked[ST_DEVSTATE_MAX_TRACKED];
+static size_t g_tracked_count = 0;
+static char g_devices[ST_DEVSTATE_MAX_DEVICES][64];
+static size_t g_device_count = 0;
+static atomic_ulong g_events, g_connects;
+
+static double now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// ---------- MIRROR (caller holds g_lock) ----------
+static entry_t *find(const char *device, const char *component, const char *capability,
+                     const char *attribute, bool create) {
+    for (size_t i = 0; i < g_entry_count; i++) {
+        entry_t *e = &g_entries[i];
+        if (strcmp(e->device, device) == 0 && strcmp(e->component, component) == 0 &&
+            strcmp(e->capability, capability) == 0 && strcmp(e->attribute, attribute) == 0)
+            return e;
+    }
+    if (!create || g_entry_count == MAX_ENTRIES) return NULL;
+    entry_t *e = &g_entries[g_entry_count++];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->device, sizeof(e->device), "%s", device);
+    snprintf(e->component, sizeof(e->component), "%s", component);
+    snprintf(e->capability, sizeof(e->capability), "%s", capability);
+    snprintf(e->attribute, sizeof(e->attribute), "%s", attribute);
+    return e;
+}
+
+static void set_value(const char *device, const char *component, const char *capability,
+                      const char *attribute, const char *value, double ts) {
+    size_t len = strlen(value);
+    if (len >= sizeof(g_entries[0].value)) {
+        // a cut value would be read as the attribute's state
+        dlog_print(DLOG_WARN, LOG_TAG, "%s %s.%s: value of %zu bytes not mirrored",
+                   device, capability, attribute, len);
+        return;
+    }
+    entry_t *e = find(device, component, capability, attribute, true);
+    if (!e) return;
+    // a replayed or reordered event never moves an attribute back in time
+    if (ts < e->ts) return;
+    memcpy(e->value, value, len + 1);
+    e->ts = ts;
+    pthread_cond_broadcast(&g_cond);
+}
+
+void st_devstate_track(const char *capability, const char *attribute) {
+    pthread_mutex_lock(&g_lock);
+    if (!g_running && g_tracked_count < ST_DEVSTATE_MAX_TRACKED) {
+        tracked_t *t = &g_tracked[g_tracked_count++];
+        snprintf(t->capability, sizeof(t->capability), "%s", capability);
+        snprintf(t->attribute, sizeof(t->attribute), "%s", attribute);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_devstate_watch(const char *device_id) {
+    pthread_mutex_lock(&g_lock);
+    bool known = false;
+    for (size_t i = 0; i < g_device_count && !known; i++) known = strcmp(g_devices[i], device_id) == 0;
+    if (!known && !g_running && g_device_count < ST_DEVSTATE_MAX_DEVICES)
+        snprintf(g_devices[g_device_count++], sizeof(g_devices[0]), "%s", device_id);
+    pthread_mutex_unlock(&g_lock);
+}
+
+// ---------- SEED ----------
+static void seed_device(const char *device, const char *token) {
+    st_buf_t body;
+    if (st_transport_status(device, token, &body) == ST_PATH_NONE) return;
+
+    enum { PER = 2 };
+    // "components.main.<capability>.<attribute>.timestamp", the longer suffix
+    char paths[ST_DEVSTATE_MAX_TRACKED * PER][sizeof("components.main..timestamp") +
+                                               sizeof(g_tracked[0].capability) + sizeof(g_tracked[0].attribute)];
+    // one byte more than an entry holds, so set_value sees a cut value as too long
+    char values[ST_DEVSTATE_MAX_TRACKED][sizeof(g_entries[0].value) + 1];
+    char stamps[ST_DEVSTATE_MAX_TRACKED][64];
+    st_json_target_t t[ST_DEVSTATE_MAX_TRACKED * PER];
+    size_t idx[ST_DEVSTATE_MAX_TRACKED];  // tracked entry of each target pair
+    size_t n = 0;
+    for (size_t i = 0; i < g_tracked_count; i++) {     // fixed once running
+        const tracked_t *tr = &g_tracked[i];
+        int a = snprintf(paths[n * PER], sizeof(paths[0]), "components.main.%s.%s.value",
+                         tr->capability, tr->attribute);
+        int b = snprintf(paths[n * PER + 1], sizeof(paths[0]), "components.main.%s.%s.timestamp",
+                         tr->capability, tr->attribute);
+        // a cut path would match nothing: say so instead of searching for it
+        if (a < 0 || (size_t)a >= sizeof(paths[0]) || b < 0 || (size_t)b >= sizeof(paths[0])) {
+            dlog_print(DLOG_WARN, LOG_TAG, "%s.%s: path too long, not seeded", tr->capability, tr->attribute);
+            continue;
+        }
+        t[n * PER] = (st_json_target_t){ paths[n * PER], values[n], sizeof(values[0]), false };
+        t[n * PER + 1] = (st_json_target_t){ paths[n * PER + 1], stamps[n], sizeof(stamps[0]), false };
+        idx[n++] = i;
+    }
+    st_json_extract(body.buf, body.len, t, n * PER);
+    free(body.buf);
+
+    pthread_mutex_lock(&g_lock);
+    for (size_t k = 0; k < n; k++) {
+        if (!t[k * PER].found) continue;
+        const tracked_t *tr = &g_tracked[idx[k]];
+        double ts = t[k * PER + 1].found ? st_parse_iso8601(stamps[k]) : 0;
+        set_value(device, "main", tr->capability, tr->attribute, values[k], ts);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// ---------- EVENT STREAM ----------
+typedef struct {
+    char line[LINE_MAX_BYTES];
+    size_t line_len;
+    bool line_overflow;
+    char data[EVENT_MAX_BYTES];
+    size_t data_len;
+    bool connected;
+} sse_t;
+
+static bool tracked(const char *capability, const char *attribute) {
+    for (size_t i = 0; i < g_tracked_count; i++)
+        if (strcmp(g_tracked[i].capability, capability) == 0 && strcmp(g_tracked[i].attribute, attribute) == 0)
+            return true;
+    return false;
+}
+
+static bool watched(const char *device) {
+    for (size_t i = 0; i < g_device_count; i++)
+        if (strcmp(g_devices[i], device) == 0) return true;
+    return false;
+}
+
+static void apply_event(const char *json, size_t len) {
+    enum { F_DEVICE, F_COMPONENT, F_CAPABILITY, F_ATTRIBUTE, F_VALUE, F_TIME, F_COUNT };
+    static const char *const field[F_COUNT] = { "deviceId", "componentId", "capability", "attribute", "value", "eventTime" };
+    char out[2][F_COUNT][512];
+    char paths[F_COUNT][48];
+    st_json_target_t t[2 * F_COUNT];
+    for (int f = 0; f < F_COUNT; f++) {
+        snprintf(paths[f], sizeof(paths[0]), "deviceEvent.%s", field[f]);
+        t[f] = (st_json_target_t){ paths[f], out[0][f], sizeof(out[0][f]), false };
+        t[F_COUNT + f] = (st_json_target_t){ field[f], out[1][f], sizeof(out[1][f]), false };
+    }
+    st_json_extract(json, len, t, 2 * F_COUNT);
+
+    int set = t[F_DEVICE].found ? 0 : 1;
+    const st_json_target_t *e = &t[set * F_COUNT];
+    char (*v)[512] = out[set];
+    if (!e[F_DEVICE].found || !e[F_CAPABILITY].found || !e[F_ATTRIBUTE].found || !e[F_VALUE].found) return;
+    const char *component = e[F_COMPONENT].found ? v[F_COMPONENT] : "main";
+    double ts = e[F_TIME].found ? st_parse_iso8601(v[F_TIME]) : 0;
+    if (ts <= 0) ts = now_sec();
+
+    pthread_mutex_lock(&g_lock);
+    if (watched(v[F_DEVICE]) && tracked(v[F_CAPABILITY], v[F_ATTRIBUTE])) {
+        set_value(v[F_DEVICE], component, v[F_CAPABILITY], v[F_ATTRIBUTE], v[F_VALUE], ts);
+        atomic_fetch_add(&g_events, 1);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void sse_line(sse_t *s) {
+    const char *l = s->line;
+    if (!s->line_len) {
+        // blank line: the event is complete
+        if (s->data_len) apply_event(s->data, s->data_len);
+        s->data_len = 0;
+        return;
+    }
+    if (strncmp(l, "data:", 5) != 0) return;       // event:, id:, retry:, ": keepalive"
+    l += 5;
+    if (*l == ' ') l++;
+    size_t n = strlen(l);
+    if (s->data_len + n + 1 >= sizeof(s->data)) { s->data_len = 0; return; }
+    if (s->data_len) s->data[s->data_len++] = '\n';
+    memcpy(s->data + s->data_len, l, n);
+    s->data_len += n;
+    s->data[s->data_len] = '\0';
+}
+
+static bool sse_sink(const void *data, size_t len, void *ctx) {
+    sse_t *s = ctx;
+    if (!s->connected) {
+        s->connected = true;
+        pthread_mutex_lock(&g_lock);
+        g_live = true;
+        pthread_cond_broadcast(&g_cond);
+        pthread_mutex_unlock(&g_lock);
+        atomic_fetch_add(&g_connects, 1);
+        dlog_print(DLOG_INFO, LOG_TAG, "event stream connected");
+    }
+    const char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '\n') {
+            if (s->line_len && s->line[s->line_len - 1] == '\r') s->line_len--;
+            s->line[s->line_len] = '\0';
+            if (!s->line_overflow) sse_line(s);
+            s->line_len = 0;
+            s->line_overflow = false;
+        } else if (s->line_len + 1 < sizeof(s->line)) {
+            s->line[s->line_len++] = p[i];
+        } else {
+            s->line_overflow = true;
+        }
+    }
+    return !atomic_load(&g_stop);
+}
+
+static bool stream_cancelled(void *ctx) {
+    (void)ctx;
+    return atomic_load(&g_stop);
+}
+
+static void *stream_main(void *arg) {
+    (void)arg;
+    int backoff = RECONNECT_MIN_SEC;
+    sse_t *s = malloc(sizeof(*s));
+    while (s && !atomic_load(&g_stop)) {
+        char *token = st_token_get();
+        if (token) {
+            for (size_t i = 0; i < g_device_count && !atomic_load(&g_stop); i++) seed_device(g_devices[i], token);
+            memset(s, 0, sizeof(*s));
+            st_http_req_t req = { .url = g_url, .bearer = token, .timeout_sec = STREAM_TIMEOUT_SEC,
+                                  .cancelled = stream_cancelled };
+            st_http_info_t info;
+            bool ok = st_http_stream(&req, sse_sink, s, &info);
+            if (!ok && !atomic_load(&g_stop))
+                dlog_print(DLOG_WARN, LOG_TAG, "event stream ended (HTTP %ld, curl %d)", info.status, info.curl_code);
+            free(token);
+            if (s->connected) backoff = RECONNECT_MIN_SEC;
+        }
+        pthread_mutex_lock(&g_lock);
+        g_live = false;
+        pthread_cond_broadcast(&g_cond);
+        pthread_mutex_unlock(&g_lock);
+
+        for (int waited = 0; waited < backoff * 10 && !atomic_load(&g_stop); waited++) usleep(100 * 1000);
+        backoff = backoff * 2 > RECONNECT_MAX_SEC ? RECONNECT_MAX_SEC : backoff * 2;
+    }
+    free(s);
+    return NULL;
+}
+
+// ---------- API ----------
+bool st_devstate_start(const char *stream_url) {
+    if (g_running || !stream_url || !*stream_url || !g_tracked_count || !g_device_count) return false;
+    snprintf(g_url, sizeof(g_url), "%s", stream_url);
+    atomic_store(&g_stop, false);
+    if (pthread_create(&g_thread, NULL, stream_main, NULL) != 0) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start the event stream thread");
+        return false;
+    }
+    pthread_mutex_lock(&g_lock);
+    g_running = true;
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+void st_devstate_stop(void) {
+    if (!g_running) return;
+    atomic_store(&g_stop, true);
+    pthread_mutex_lock(&g_lock);
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+    pthread_mutex_lock(&g_lock);
+    g_running = false;
+    g_live = false;
+    pthread_mutex_unlock(&g_lock);
+}
+
+bool st_devstate_live(void) {
+    pthread_mutex_lock(&g_lock);
+    bool live = g_live;
+    pthread_mutex_unlock(&g_lock);
+    return live;
+}
+
+bool st_devstate_get(const char *device_id, const char *component, const char *capability,
+                     const char *attribute, char *value, size_t len, double *ts) {
+    pthread_mutex_lock(&g_lock);
+    const entry_t *e = g_live ? find(device_id, component, capability, attribute, false) : NULL;
+    if (e) {
+        if (value && len) snprintf(value, len, "%s", e->value);
+        if (ts) *ts = e->ts;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return e != NULL;
+}
+
+bool st_devstate_wait(const char *device_id, const char *component, const char *capability,
+                      const char *attribute, double after, double timeout_sec,
+                      bool (*cancel)(void *ctx), void *ctx,
+                      char *value, size_t len, double *ts) {
+    const double deadline = now_sec() + timeout_sec;
+    pthread_mutex_lock(&g_lock);
+    bool ok = false;
+    while (g_live && !atomic_load(&g_stop)) {
+        const entry_t *e = find(device_id, component, capability, attribute, false);
+        if (e && e->ts > after) {
+            if (value && len) snprintf(value, len, "%s", e->value);
+            if (ts) *ts = e->ts;
+            ok = true;
+            break;
+        }
+        double now = now_sec();
+        if (now >= deadline) break;
+        // short slices keep cancel responsive
+        double wake = now + 0.1 < deadline ? now + 0.1 : deadline;
+        struct timespec dl = { (time_t)wake, (long)((wake - (time_t)wake) * 1e9) };
+        pthread_cond_timedwait(&g_cond, &g_lock, &dl);
+        if (cancel && cancel(ctx)) break;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return ok;
+}
+
+void st_devstate_counts(unsigned long *events, unsigned long *connects) {
+    if (events) *events = atomic_load(&g_events);
+    if (connects) *connects = atomic_load(&g_connects);
+}
@@ -0,0 +1,61 @@
+#ifndef ST_DEVSTATE_H
+#define ST_DEVSTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- DEVICE STATE MIRROR ----------
+// Attribute values of the watched devices, kept current by one long-lived
+// event stream (Server-Sent Events: "data: <json>" blocks, either
+// SmartThings' {"deviceEvent":{...}} envelope or the bare event) instead
+// of GET /devices/{id}/status per question. A thread holds the stream open
+// and reconnects with backoff.
+//
+// Before each connect, every watched device is read once to seed the
+// mirror (main component, tracked attributes only). During the short gap
+// between seed and connect an event may be missed; nothing is missed
+// after that. The mirror answers only while the stream is connected
+// (st_devstate_live). Otherwise callers poll as before, so an outage of the
+// stream costs freshness, never correctness.
+//
+// Event timestamps are the event's own time when it has one, else the
+// local time of receipt. Tracked attributes and watched devices are set
+// before st_devstate_start(). Thread-safe.
+
+#define ST_DEVSTATE_MAX_TRACKED 16
+#define ST_DEVSTATE_MAX_DEVICES 32
+
+void st_devstate_track(const char *capability, const char *attribute);
+void st_devstate_watch(const char *device_id);
+
+// stream_url: the SSE endpoint of the subscription (bearer = st_token_get()).
+bool st_devstate_start(const char *stream_url);
+void st_devstate_stop(void);
+
+bool st_devstate_live(void);
+
+// Value and timestamp (epoch seconds) of an attribute; false unless live
+// and the attribute is known.
+bool st_devstate_get(const char *device_id, const char *component, const char *capability,
+                     const char *attribute, char *value, size_t len, double *ts);
+
+// Waits up to timeout_sec for the attribute's timestamp to pass after.
+// False on timeout, cancel, or when the stream drops (the caller then
+// falls back to polling for the rest of its budget).
+bool st_devstate_wait(const char *device_id, const char *component, const char *capability,
+                      const char *attribute, double after, double timeout_sec,
+                      bool (*cancel)(void *ctx), void *ctx,
+                      char *value, size_t len, double *ts);
+
+// Events applied and stream connections made since start.
+void st_devstate_counts(unsigned long *events, unsigned long *connects);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#include "st_hash.h"
+
+#include <string.h>
+
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t in) {
+    acc += in * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t v) {
+    acc ^= round64(0, v);
+    return acc * P1 + P4;
+}
+
+void st_xxh64_init(st_xxh64_t *h, uint64_t seed) {
+    memset(h, 0, sizeof(*h));
+    h->seed = seed;
+    h->v[0] = seed + P1 + P2;
+    h->v[1] = seed + P2;
+    h->v[2] = seed;
+    h->v[3] = seed - P1;
+}
+
+void st_xxh64_update(st_xxh64_t *h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    const uint8_t *end = p + len;
+    h->total += len;
+
+    if (h->memsize + len < 32) {
+        memcpy(h->mem + h->memsize, p, len);
+        h->memsize += len;
+        return;
+    }
+    if (h->memsize) {
+        size_t fill = 32 - h->memsize;
+        memcpy(h->mem + h->memsize, p, fill);
+        for (int i = 0; i < 4; i++) h->v[i] = round64(h->v[i], read64(h->mem + 8 * i));
+        p += fill;
+        h->memsize = 0;
+    }
+    while (p + 32 <= end) {
+        for (int i = 0; i < 4; i++) h->v[i] = round64(h->v[i], read64(p + 8 * i));
+        p += 32;
+    }
+    if (p < end) {
+        memcpy(h->mem, p, (size_t)(end - p));
+        h->memsize = (size_t)(end - p);
+    }
+}
+
+uint64_t st_xxh64_digest(const st_xxh64_t *h) {
+    uint64_t acc;
+    if (h->total >= 32) {
+        acc = rotl(h->v[0], 1) + rotl(h->v[1], 7) + rotl(h->v[2], 12) + rotl(h->v[3], 18);
+        for (int i = 0; i < 4; i++) acc = merge64(acc, h->v[i]);
+    } else {
+        acc = h->seed + P5;
+    }
+    acc += h->total;
+
+    const uint8_t *p = h->mem;
+    const uint8_t *end = p + h->memsize;
+    while (p + 8 <= end) {
+        acc ^= round64(0, read64(p));
+        acc = rotl(acc, 27) * P1 + P4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        acc ^= (uint64_t)read32(p) * P1;
+        acc = rotl(acc, 23) * P2 + P3;
+        p += 4;
+    }
+    while (p < end) {
+        acc ^= (*p++) * P5;
+        acc = rotl(acc, 11) * P1;
+    }
+    acc ^= acc >> 33;
+    acc *= P2;
+    acc ^= acc >> 29;
+    acc *= P3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+uint64_t st_xxh64(const void *data, size_t len, uint64_t seed) {
+    st_xxh64_t h;
+    st_xxh64_init(&h, seed);
+    st_xxh64_update(&h, data, len);
+    return st_xxh64_digest(&h);
+}
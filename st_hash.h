@@ -0,0 +1,34 @@
+#ifndef ST_HASH_H
+#define ST_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- XXH64 ----------
+// xxHash64 (seed 0 by default), streaming and one-shot, for spotting
+// repeated frames without comparing them byte by byte. Output matches the
+// reference XXH64 implementation.
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total;
+    uint64_t seed;
+    uint8_t mem[32];
+    size_t memsize;
+} st_xxh64_t;
+
+void st_xxh64_init(st_xxh64_t *h, uint64_t seed);
+void st_xxh64_update(st_xxh64_t *h, const void *data, size_t len);
+uint64_t st_xxh64_digest(const st_xxh64_t *h);
+
+uint64_t st_xxh64(const void *data, size_t len, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
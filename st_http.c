@@ -0,0 +1,968 @@
+#include "st_http.h"
+
+#include "st_metrics.h"
+#include "st_trace.h"
+
+#include <curl/curl.h>
+#include <dlog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_HTTP"
+
+typedef struct {
+    CURL *handle;
+    bool in_use;
+} pool_slot_t;
+
+static CURLSH *g_share = NULL;
+static pthread_mutex_t g_share_locks[CURL_LOCK_DATA_LAST];
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pool_slot_t g_pool[ST_HTTP_POOL_SIZE];
+static bool g_ready = false;
+
+typedef struct {
+    double per_sec;             // 0: unlimited
+    double burst;
+    double tokens;
+    double stamp;
+} bucket_t;
+
+static pthread_mutex_t g_rate_lock = PTHREAD_MUTEX_INITIALIZER;
+static bucket_t g_rate;
+
+typedef struct {
+    bool used;
+    char name[32];
+    bucket_t rate;              // under g_lane_lock
+    int max_parallel;           // 0: no cap
+    int active;
+} lane_t;
+
+static pthread_mutex_t g_lane_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_lane_cond = PTHREAD_COND_INITIALIZER;
+static lane_t g_lanes[ST_HTTP_MAX_LANES + 1];   // [0] unused: no lane
+static _Thread_local int t_lane;
+static atomic_ulong g_requests;
+static atomic_ulong g_prewarms;            // not in g_requests: the API never sees them
+
+typedef struct {
+    char match[128];
+    st_http_policy_t policy;
+} policy_entry_t;
+
+typedef struct {
+    char host[128];
+    int failures;               // consecutive unhealthy outcomes
+    double open_until;          // fail fast until then
+    bool probing;               // half-open: one request is testing the host
+} breaker_t;
+
+static pthread_mutex_t g_policy_lock = PTHREAD_MUTEX_INITIALIZER;
+static policy_entry_t g_policies[ST_HTTP_MAX_POLICIES];
+static int g_policy_count = 0;
+static st_http_policy_t g_default_policy = ST_HTTP_POLICY_DEFAULT;
+static breaker_t g_breakers[ST_HTTP_MAX_HOSTS];
+static int g_breaker_threshold = ST_HTTP_BREAKER_FAILURES;
+static int g_breaker_open_sec = ST_HTTP_BREAKER_OPEN_SEC;
+
+// ---------- SHARE LOCKING ----------
+static void share_lock_cb(CURL *h, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)h; (void)access; (void)userptr;
+    pthread_mutex_lock(&g_share_locks[data]);
+}
+
+static void share_unlock_cb(CURL *h, curl_lock_data data, void *userptr) {
+    (void)h; (void)userptr;
+    pthread_mutex_unlock(&g_share_locks[data]);
+}
+
+bool st_http_init(void) {
+    if (g_ready) return true;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) pthread_mutex_init(&g_share_locks[i], NULL);
+
+    g_share = curl_share_init();
+    if (!g_share) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "curl_share_init failed");
+        return false;
+    }
+    curl_share_setopt(g_share, CURLSHOPT_LOCKFUNC, share_lock_cb);
+    curl_share_setopt(g_share, CURLSHOPT_UNLOCKFUNC, share_unlock_cb);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // not CURL_LOCK_DATA_CONNECT: libcurl does not support one connection
+    // cache driven from several threads at once. Each pooled handle keeps
+    // its own, which curl_easy_reset leaves alone.
+
+    memset(g_pool, 0, sizeof(g_pool));
+    g_ready = true;
+    return true;
+}
+
+void st_http_cleanup(void) {
+    if (!g_ready) return;
+    pthread_mutex_lock(&g_pool_lock);
+    for (int i = 0; i < ST_HTTP_POOL_SIZE; i++) {
+        if (g_pool[i].handle) curl_easy_cleanup(g_pool[i].handle);
+        g_pool[i].handle = NULL;
+        g_pool[i].in_use = false;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+
+    curl_share_cleanup(g_share);
+    g_share = NULL;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) pthread_mutex_destroy(&g_share_locks[i]);
+    g_ready = false;
+}
+
+// ---------- RATE LIMIT ----------
+// Monotonic: buckets and breakers must not jump when NTP steps the clock.
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bucket_set(bucket_t *b, double requests_per_sec, int burst) {
+    b->per_sec = requests_per_sec > 0 ? requests_per_sec : 0;
+    b->burst = burst > 0 ? burst : 1;
+    b->tokens = b->burst;
+    b->stamp = now_sec();
+}
+
+// Takes a token from b (guarded by lock), sleeping until one is there.
+static void bucket_acquire(bucket_t *b, pthread_mutex_t *lock) {
+    for (;;) {
+        pthread_mutex_lock(lock);
+        if (b->per_sec <= 0) { pthread_mutex_unlock(lock); return; }
+        double now = now_sec();
+        b->tokens += (now - b->stamp) * b->per_sec;
+        if (b->tokens > b->burst) b->tokens = b->burst;
+        b->stamp = now;
+        if (b->tokens >= 1.0) {
+            b->tokens -= 1.0;
+            pthread_mutex_unlock(lock);
+            return;
+        }
+        double wait = (1.0 - b->tokens) / b->per_sec;
+        pthread_mutex_unlock(lock);
+        usleep((useconds_t)(wait * 1e6) + 1000);
+    }
+}
+
+void st_http_set_rate_limit(double requests_per_sec, int burst) {
+    pthread_mutex_lock(&g_rate_lock);
+    bucket_set(&g_rate, requests_per_sec, burst);
+    pthread_mutex_unlock(&g_rate_lock);
+}
+
+unsigned long st_http_request_count(void) {
+    return atomic_load(&g_requests);
+}
+
+// ---------- POLICY ----------
+bool st_http_set_policy(const char *url_match, const st_http_policy_t *policy) {
+    if (!policy) return false;
+    pthread_mutex_lock(&g_policy_lock);
+    bool ok = true;
+    if (!url_match || !*url_match) {
+        g_default_policy = *policy;
+    } else {
+        int i = 0;
+        while (i < g_policy_count && strcmp(g_policies[i].match, url_match) != 0) i++;
+        if (i == g_policy_count && g_policy_count < ST_HTTP_MAX_POLICIES) g_policy_count++;
+        if (i < g_policy_count) {
+            snprintf(g_policies[i].match, sizeof(g_policies[i].match), "%s", url_match);
+            g_policies[i].policy = *policy;
+        } else {
+            ok = false;
+        }
+    }
+    pthread_mutex_unlock(&g_policy_lock);
+    return ok;
+}
+
+static st_http_policy_t policy_for(const char *url) {
+    pthread_mutex_lock(&g_policy_lock);
+    st_http_policy_t p = g_default_policy;
+    for (int i = 0; i < g_policy_count; i++)
+        if (strstr(url, g_policies[i].match)) { p = g_policies[i].policy; break; }
+    pthread_mutex_unlock(&g_policy_lock);
+    if (p.max_attempts < 1) p.max_attempts = 1;
+    if (p.timeout_sec <= 0) p.timeout_sec = ST_HTTP_DEFAULT_TIMEOUT_SEC;
+    return p;
+}
+
+void st_http_set_breaker(int failure_threshold, int open_sec) {
+    pthread_mutex_lock(&g_policy_lock);
+    g_breaker_threshold = failure_threshold;
+    g_breaker_open_sec = open_sec > 0 ? open_sec : ST_HTTP_BREAKER_OPEN_SEC;
+    pthread_mutex_unlock(&g_policy_lock);
+}
+
+// ---------- ORIGIN MAP ----------
+typedef struct {
+    char from[128];
+    char to[128];
+} origin_map_t;
+
+static origin_map_t g_maps[ST_HTTP_MAX_ORIGIN_MAPS];
+static int g_map_count = 0;
+
+bool st_http_map_origin(const char *from, const char *to) {
+    if (!from || !*from || !to || strlen(from) >= sizeof(g_maps[0].from) || strlen(to) >= sizeof(g_maps[0].to))
+        return false;
+    pthread_mutex_lock(&g_policy_lock);
+    bool ok = g_map_count < ST_HTTP_MAX_ORIGIN_MAPS;
+    if (ok) {
+        snprintf(g_maps[g_map_count].from, sizeof(g_maps[0].from), "%s", from);
+        snprintf(g_maps[g_map_count].to, sizeof(g_maps[0].to), "%s", to);
+        g_map_count++;
+    }
+    pthread_mutex_unlock(&g_policy_lock);
+    return ok;
+}
+
+// The URL actually put on the wire: url itself, or buf holding it with a
+// mapped origin swapped in. The map is fixed before the first request.
+static const char *wire_url(const char *url, char *buf, size_t len) {
+    for (int i = 0; i < g_map_count; i++) {
+        size_t n = strlen(g_maps[i].from);
+        if (strncmp(url, g_maps[i].from, n) != 0) continue;
+        int w = snprintf(buf, len, "%s%s", g_maps[i].to, url + n);
+        return w > 0 && (size_t)w < len ? buf : url;
+    }
+    return url;
+}
+
+// "https://api.smartthings.com/v1/..." -> "api.smartthings.com"
+static void url_host(const char *url, char *out, size_t len) {
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    size_t n = strcspn(p, ":/?#");
+    if (n >= len) n = len - 1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+}
+
+// Caller holds g_policy_lock. NULL when the table is full.
+static breaker_t *breaker_find(const char *host) {
+    breaker_t *free_slot = NULL;
+    for (int i = 0; i < ST_HTTP_MAX_HOSTS; i++) {
+        if (strcmp(g_breakers[i].host, host) == 0) return &g_breakers[i];
+        if (!free_slot && !g_breakers[i].host[0]) free_slot = &g_breakers[i];
+    }
+    if (free_slot) snprintf(free_slot->host, sizeof(free_slot->host), "%s", host);
+    return free_slot;
+}
+
+// False while the host's breaker is open; after the cool-down exactly one
+// caller is let through as a probe.
+static bool breaker_admit(const char *host, bool *probe) {
+    *probe = false;
+    pthread_mutex_lock(&g_policy_lock);
+    bool ok = true;
+    breaker_t *b = g_breaker_threshold > 0 ? breaker_find(host) : NULL;
+    if (b) {
+        double now = now_sec();
+        if (now < b->open_until) ok = false;
+        else if (b->failures >= g_breaker_threshold) {
+            if (b->probing) ok = false;
+            else b->probing = *probe = true;
+        }
+    }
+    pthread_mutex_unlock(&g_policy_lock);
+    return ok;
+}
+
+static void breaker_record(const char *host, bool healthy, long retry_after_sec) {
+    pthread_mutex_lock(&g_policy_lock);
+    breaker_t *b = g_breaker_threshold > 0 ? breaker_find(host) : NULL;
+    if (b) {
+        double now = now_sec();
+        b->probing = false;
+        if (healthy) {
+            if (b->failures >= g_breaker_threshold)
+                dlog_print(DLOG_INFO, LOG_TAG, "%s reachable again, circuit closed", host);
+            b->failures = 0;
+            b->open_until = 0;
+        } else if (++b->failures >= g_breaker_threshold) {
+            if (b->failures == g_breaker_threshold)
+                dlog_print(DLOG_WARN, LOG_TAG, "%s failing, circuit open for %d s", host, g_breaker_open_sec);
+            b->open_until = now + g_breaker_open_sec;
+        }
+        // 429: every caller waits as long as the server asked
+        if (retry_after_sec > 0 && now + retry_after_sec > b->open_until)
+            b->open_until = now + retry_after_sec;
+    }
+    pthread_mutex_unlock(&g_policy_lock);
+}
+
+bool st_http_host_available(const char *url) {
+    char host[128];
+    url_host(url, host, sizeof(host));
+    pthread_mutex_lock(&g_policy_lock);
+    bool ok = true;
+    for (int i = 0; i < ST_HTTP_MAX_HOSTS; i++)
+        if (strcmp(g_breakers[i].host, host) == 0) ok = now_sec() >= g_breakers[i].open_until;
+    pthread_mutex_unlock(&g_policy_lock);
+    return ok;
+}
+
+// ---------- HANDLE POOL ----------
+// Returns a pooled handle, or a one-off handle (slot -1) when all are busy.
+// One-off handles open their own connection, but still get DNS and TLS
+// session resumption from the share.
+static CURL *pool_acquire(int *slot) {
+    CURL *h = NULL;
+    *slot = -1;
+    pthread_mutex_lock(&g_pool_lock);
+    for (int i = 0; i < ST_HTTP_POOL_SIZE; i++) {
+        if (g_pool[i].in_use) continue;
+        if (!g_pool[i].handle) g_pool[i].handle = curl_easy_init();
+        if (!g_pool[i].handle) break;
+        g_pool[i].in_use = true;
+        h = g_pool[i].handle;
+        *slot = i;
+        break;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+
+    if (!h) h = curl_easy_init();
+    // reset keeps live connections, DNS and TLS session caches
+    if (h) curl_easy_reset(h);
+    return h;
+}
+
+static void pool_release(CURL *h, int slot) {
+    if (slot < 0) {
+        curl_easy_cleanup(h);
+        return;
+    }
+    pthread_mutex_lock(&g_pool_lock);
+    g_pool[slot].in_use = false;
+    pthread_mutex_unlock(&g_pool_lock);
+}
+
+// ---------- PRE-WARM ----------
+static size_t discard_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    (void)ptr;
+    (void)userdata;
+    return size * nmemb;
+}
+
+bool st_http_prewarm(const char *url) {
+    if (!url || !g_share || !st_http_host_available(url)) return false;
+    // scheme://host[:port]/ only: nothing at the API is touched
+    const char *p = strstr(url, "://");
+    size_t n = p ? (size_t)(p + 3 - url) + strcspn(p + 3, "/?#") : strcspn(url, "/?#");
+    char origin[256];
+    if (n + 2 > sizeof(origin)) return false;
+    memcpy(origin, url, n);
+    origin[n] = '/';
+    origin[n + 1] = '\0';
+
+    int slot;
+    CURL *curl = pool_acquire(&slot);
+    if (!curl) return false;
+    curl_easy_setopt(curl, CURLOPT_SHARE, g_share);
+    char mapped[512];
+    curl_easy_setopt(curl, CURLOPT_URL, wire_url(origin, mapped, sizeof(mapped)));
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, ST_HTTP_PREWARM_TIMEOUT_SEC);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_cb);
+    st_span_t span = st_span_begin("http.prewarm");
+    CURLcode res = curl_easy_perform(curl);
+    st_span_end(&span);
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    pool_release(curl, slot);
+    atomic_fetch_add(&g_prewarms, 1);
+    // any HTTP answer will do: the connection stays in this handle's cache,
+    // the DNS entry and TLS session in the share for the others
+    if (res != CURLE_OK) dlog_print(DLOG_INFO, LOG_TAG, "prewarm %s: %s", origin, curl_easy_strerror(res));
+    else if (connects) dlog_print(DLOG_DEBUG, LOG_TAG, "prewarm %s: new connection", origin);
+    return res == CURLE_OK;
+}
+
+unsigned long st_http_prewarm_count(void) {
+    return atomic_load(&g_prewarms);
+}
+
+// st_buf_t has no capacity field (callers fill it themselves too), so the
+// body is grown geometrically through this wrapper for one perform.
+typedef struct {
+    st_buf_t *m;
+    size_t cap;                 // bytes m->buf holds before the NUL
+} grow_buf_t;
+
+static size_t buf_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    grow_buf_t *g = userdata;
+    st_buf_t *m = g->m;
+    size_t n = size * nmemb;
+    if (m->len + n > g->cap) {
+        size_t cap = g->cap ? g->cap * 2 : 4096;
+        while (cap < m->len + n) cap *= 2;
+        char *p = realloc(m->buf, cap + 1);
+        if (!p) return 0;
+        m->buf = p;
+        g->cap = cap;
+    }
+    memcpy(m->buf + m->len, ptr, n);
+    m->len += n;
+    m->buf[m->len] = '\0';
+    return n;
+}
+
+typedef struct {
+    st_http_sink_fn fn;
+    void *ctx;
+} sink_adapter_t;
+
+static size_t sink_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    sink_adapter_t *a = userdata;
+    size_t n = size * nmemb;
+    return a->fn(ptr, n, a->ctx) ? n : 0;
+}
+
+static size_t source_read_cb(char *dst, size_t size, size_t nitems, void *userdata) {
+    const st_http_req_t *req = userdata;
+    return req->read_fn(dst, size * nitems, req->read_ctx);
+}
+
+// Picks status, ETag, Content-Length and Content-Range out of the response
+// headers as they arrive, so a write callback can already look at them.
+static size_t header_cb(char *line, size_t size, size_t nitems, void *userdata) {
+    st_http_info_t *info = userdata;
+    size_t n = size * nitems;
+    char tmp[128];
+    size_t m = n < sizeof(tmp) - 1 ? n : sizeof(tmp) - 1;
+    memcpy(tmp, line, m);
+    tmp[m] = '\0';
+    if (strncmp(tmp, "HTTP/", 5) == 0) {
+        // a new response (e.g. after 100 Continue) starts from scratch
+        const char *sp = strchr(tmp, ' ');
+        info->status = sp ? strtol(sp + 1, NULL, 10) : 0;
+        info->content_length = info->range_start = info->range_total = -1;
+        info->retry_after_sec = 0;
+        info->etag[0] = '\0';
+    } else if (strncasecmp(tmp, "Retry-After:", 12) == 0) {
+        // delta-seconds or an HTTP date
+        const char *v = tmp + 12;
+        while (*v == ' ') v++;
+        if (*v >= '0' && *v <= '9') {
+            info->retry_after_sec = strtol(v, NULL, 10);
+        } else {
+            time_t t = curl_getdate(v, NULL);
+            time_t now = time(NULL);
+            info->retry_after_sec = t > now ? (long)(t - now) : 0;
+        }
+    } else if (strncasecmp(tmp, "Content-Length:", 15) == 0) {
+        info->content_length = strtoll(tmp + 15, NULL, 10);
+    } else if (strncasecmp(tmp, "Content-Range:", 14) == 0) {
+        long long a, b, total;
+        char star;
+        if (sscanf(tmp + 14, " bytes %lld-%lld/%lld", &a, &b, &total) == 3) {
+            info->range_start = a;
+            info->range_total = total;
+        } else if (sscanf(tmp + 14, " bytes %lld-%lld/%c", &a, &b, &star) == 3) {
+            info->range_start = a;
+        }
+    } else if (n > 5 && strncasecmp(line, "ETag:", 5) == 0) {
+        const char *v = line + 5;
+        size_t len = n - 5;
+        while (len && (*v == ' ' || *v == '\t')) { v++; len--; }
+        while (len && (v[len - 1] == '\r' || v[len - 1] == '\n' || v[len - 1] == ' ')) len--;
+        if (len >= sizeof(info->etag)) len = sizeof(info->etag) - 1;
+        memcpy(info->etag, v, len);
+        info->etag[len] = '\0';
+    }
+    return n;
+}
+
+// ---------- CANCELLATION ----------
+static bool req_cancelled(const st_http_req_t *req) {
+    return req->cancelled && req->cancelled(req->xfer_ctx);
+}
+
+static int xferinfo_cb(void *userdata, curl_off_t dltotal, curl_off_t dlnow,
+                       curl_off_t ultotal, curl_off_t ulnow) {
+    const st_http_req_t *req = userdata;
+    (void)ultotal; (void)ulnow;
+    if (req->progress) req->progress((long long)dlnow, dltotal > 0 ? (long long)dltotal : -1, req->xfer_ctx);
+    return req_cancelled(req) ? 1 : 0;
+}
+
+// Sleeps ms in short slices; false as soon as the request is cancelled.
+static bool pause_ms(const st_http_req_t *req, int ms) {
+    while (ms > 0) {
+        if (req_cancelled(req)) return false;
+        int step = ms < 100 ? ms : 100;
+        usleep((useconds_t)step * 1000);
+        ms -= step;
+    }
+    return !req_cancelled(req);
+}
+
+// ---------- LANES ----------
+bool st_http_set_lane(int lane, const char *name, double requests_per_sec, int burst, int max_parallel) {
+    if (lane < 1 || lane > ST_HTTP_MAX_LANES) return false;
+    pthread_mutex_lock(&g_lane_lock);
+    lane_t *l = &g_lanes[lane];
+    l->used = true;
+    snprintf(l->name, sizeof(l->name), "%s", name && *name ? name : "lane");
+    bucket_set(&l->rate, requests_per_sec, burst);
+    l->max_parallel = max_parallel > 0 ? max_parallel : 0;
+    pthread_cond_broadcast(&g_lane_cond);       // a raised cap lets waiters in
+    pthread_mutex_unlock(&g_lane_lock);
+    return true;
+}
+
+void st_http_use_lane(int lane) {
+    t_lane = lane >= 1 && lane <= ST_HTTP_MAX_LANES ? lane : 0;
+}
+
+int st_http_current_lane(void) {
+    return t_lane;
+}
+
+static lane_t *lane_of(const st_http_req_t *req) {
+    int lane = req->lane ? req->lane : t_lane;
+    if (lane < 1 || lane > ST_HTTP_MAX_LANES) return NULL;
+    pthread_mutex_lock(&g_lane_lock);
+    lane_t *l = g_lanes[lane].used ? &g_lanes[lane] : NULL;
+    pthread_mutex_unlock(&g_lane_lock);
+    return l;
+}
+
+// One of the lane's transfer slots, then a token from its bucket. False
+// when req was cancelled while waiting for the slot.
+static bool lane_enter(lane_t *l, const st_http_req_t *req) {
+    pthread_mutex_lock(&g_lane_lock);
+    while (l->max_parallel && l->active >= l->max_parallel) {
+        if (req_cancelled(req)) { pthread_mutex_unlock(&g_lane_lock); return false; }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += 1;
+        pthread_cond_timedwait(&g_lane_cond, &g_lane_lock, &until);
+    }
+    l->active++;
+    pthread_mutex_unlock(&g_lane_lock);
+    bucket_acquire(&l->rate, &g_lane_lock);
+    char labels[48];
+    snprintf(labels, sizeof(labels), "account=\"%s\"", l->name);
+    st_metric_inc(st_metrics_counter("st_http_lane_requests_total", labels));
+    return true;
+}
+
+static void lane_leave(lane_t *l) {
+    pthread_mutex_lock(&g_lane_lock);
+    if (l->active) l->active--;
+    pthread_cond_signal(&g_lane_cond);
+    pthread_mutex_unlock(&g_lane_lock);
+}
+
+// ---------- METRICS ----------
+// Path of url with ids folded to {id} ("/v1/devices/{id}/status"), so the
+// endpoint label stays bounded. A segment counts as an id when it is long
+// or mixes in digits (UUIDs, hashes, presigned object keys).
+static void endpoint_of(const char *url, char *out, size_t len) {
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 + strcspn(p + 3, "/?#") : url;
+    size_t n = 0;
+    int segs = 0;
+    while (*p == '/' && segs < 4 && n + 1 < len) {
+        p++;
+        size_t sl = strcspn(p, "/?#");
+        size_t digits = 0;
+        for (size_t i = 0; i < sl; i++) digits += p[i] >= '0' && p[i] <= '9';
+        bool id = sl > 24 || (sl >= 8 && digits > 0);
+        int w = snprintf(out + n, len - n, "/%.*s", id ? 4 : (int)sl, id ? "{id}" : p);
+        if (w < 0 || (size_t)w >= len - n) break;
+        n += (size_t)w;
+        p += sl;
+        segs++;
+    }
+    if (!n) snprintf(out, len, "/");
+}
+
+static void http_metrics(const char *url, long status, double total_sec) {
+    char ep[96], labels[ST_METRICS_MAX_LABELS];
+    endpoint_of(url, ep, sizeof(ep));
+    snprintf(labels, sizeof(labels), "endpoint=\"%s\",status=\"%ld\"", ep, status);
+    st_metric_inc(st_metrics_counter("st_http_requests_total", labels));
+    snprintf(labels, sizeof(labels), "endpoint=\"%s\"", ep);
+    st_metric_observe(st_metrics_histogram("st_http_request_ms", labels), total_sec * 1000.0);
+}
+
+// ---------- REQUESTS ----------
+typedef size_t (*write_fn_t)(void *ptr, size_t size, size_t nmemb, void *userdata);
+
+// One transfer, no retries.
+static bool http_once(const st_http_req_t *req, long timeout_sec, write_fn_t write_fn,
+                      void *write_ctx, st_http_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->content_length = info->range_start = info->range_total = -1;
+    lane_t *lane = lane_of(req);
+    st_span_t wait = st_span_begin("http.ratelimit");
+    bool admitted = !lane || lane_enter(lane, req);
+    if (admitted) bucket_acquire(&g_rate, &g_rate_lock);
+    st_span_end(&wait);
+    if (!admitted) {
+        info->curl_code = CURLE_ABORTED_BY_CALLBACK;
+        return false;
+    }
+    atomic_fetch_add(&g_requests, 1);
+
+    int slot;
+    CURL *curl = pool_acquire(&slot);
+    if (!curl) {
+        if (lane) lane_leave(lane);
+        return false;
+    }
+
+    struct curl_slist *hdr = NULL;
+    char auth[1536];
+    if (req->bearer) {
+        snprintf(auth, sizeof(auth), "Authorization: Bearer %s", req->bearer);
+        hdr = curl_slist_append(hdr, auth);
+    } else if (req->auth_header) {
+        snprintf(auth, sizeof(auth), "Authorization: %s", req->auth_header);
+        hdr = curl_slist_append(hdr, auth);
+    }
+    if (req->if_none_match && *req->if_none_match) {
+        char inm[192];
+        snprintf(inm, sizeof(inm), "If-None-Match: %s", req->if_none_match);
+        hdr = curl_slist_append(hdr, inm);
+    }
+    if (req->range_from > 0) {
+        char range[64];
+        snprintf(range, sizeof(range), "Range: bytes=%lld-", req->range_from);
+        hdr = curl_slist_append(hdr, range);
+        if (req->if_range && *req->if_range) {
+            char ifr[192];
+            snprintf(ifr, sizeof(ifr), "If-Range: %s", req->if_range);
+            hdr = curl_slist_append(hdr, ifr);
+        }
+    }
+    if ((req->body || req->read_fn) && req->content_type) {
+        char ct[256];
+        snprintf(ct, sizeof(ct), "Content-Type: %s", req->content_type);
+        hdr = curl_slist_append(hdr, ct);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_SHARE, g_share);
+    char mapped[2048];
+    curl_easy_setopt(curl, CURLOPT_URL, wire_url(req->url, mapped, sizeof(mapped)));
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdr);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout_sec);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, info);
+    // pooled handles keep options: set it either way
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, req->identity || req->range_from > 0 ? NULL : "");
+
+    if (req->body) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)(req->body_len ? req->body_len : strlen(req->body)));
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->body);
+    }
+    if (req->read_fn) {
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        curl_easy_setopt(curl, CURLOPT_READFUNCTION, source_read_cb);
+        curl_easy_setopt(curl, CURLOPT_READDATA, (void *)req);
+        if (req->read_len >= 0)
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)req->read_len);
+        else
+            hdr = curl_slist_append(hdr, "Transfer-Encoding: chunked");
+        // no "Expect: 100-continue" round trip before the body
+        hdr = curl_slist_append(hdr, "Expect:");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdr);
+    }
+    if (req->method && strcmp(req->method, "GET") != 0 && strcmp(req->method, "POST") != 0)
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, req->method);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_fn);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_ctx);
+    if (req->cancelled || req->progress) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *)req);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
+
+    st_span_t span = st_span_begin(req->body || req->read_fn ? "http.post" : "http.get");
+    CURLcode res = curl_easy_perform(curl);
+    st_span_end(&span);
+    // also after a failed transfer: an aborted 503 is still a 503
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    long connects = 0;
+    info->status = status;
+    info->curl_code = (int)res;
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &info->total_sec);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    info->reused = (res == CURLE_OK && connects == 0);
+    http_metrics(req->url, status, info->total_sec);    // status 0: no response
+    if (res != CURLE_OK)
+        dlog_print(DLOG_WARN, LOG_TAG, "%s: %s", req->url, curl_easy_strerror(res));
+
+    curl_slist_free_all(hdr);
+    pool_release(curl, slot);
+    if (lane) lane_leave(lane);
+    return res == CURLE_OK && status >= 200 && status < 300;
+}
+
+// ---------- RETRIES ----------
+typedef struct {
+    write_fn_t fn;              // NULL -> fwrite into ctx (a FILE*)
+    void *ctx;
+    size_t delivered;
+} counted_write_t;
+
+static size_t counted_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    counted_write_t *c = userdata;
+    size_t n = c->fn ? c->fn(ptr, size, nmemb, c->ctx) : fwrite(ptr, size, nmemb, c->ctx) * size;
+    c->delivered += n;
+    return n;
+}
+
+// The request never reached the server, so even a POST is safe to repeat.
+static bool not_sent(int code) {
+    return code == CURLE_COULDNT_RESOLVE_HOST || code == CURLE_COULDNT_CONNECT ||
+           code == CURLE_SSL_CONNECT_ERROR;
+}
+
+// Transport errors our own callbacks caused say nothing about the host.
+static bool host_failed(const st_http_info_t *info) {
+    int code = info->curl_code;
+    if (code != CURLE_OK && code != CURLE_WRITE_ERROR && code != CURLE_ABORTED_BY_CALLBACK)
+        return true;
+    return info->status == 429 || info->status >= 500;
+}
+
+static int backoff_ms(const st_http_policy_t *p, int attempt) {
+    long cap = p->backoff_base_ms > 0 ? p->backoff_base_ms : 1;
+    for (int i = 1; i < attempt && cap < p->backoff_max_ms; i++) cap *= 2;
+    if (p->backoff_max_ms > 0 && cap > p->backoff_max_ms) cap = p->backoff_max_ms;
+    // half fixed, half random: parallel captures do not retry in lockstep
+    return (int)(cap / 2 + random() % (cap / 2 + 1));
+}
+
+// Runs req under its URL's policy: fail fast while the host's circuit is
+// open, otherwise retry transient failures with jittered exponential
+// backoff (or the server's Retry-After). rewind (may be NULL) discards
+// what an earlier attempt wrote; without it only attempts that delivered
+// nothing are repeated.
+static bool http_run(const st_http_req_t *req, write_fn_t write_fn, void *write_ctx,
+                     void (*rewind_fn)(void *ctx), st_http_info_t *info) {
+    st_http_info_t local;
+    if (!info) info = &local;
+    memset(info, 0, sizeof(*info));
+    if (!g_ready && !st_http_init()) return false;
+
+    const st_http_policy_t p = policy_for(req->url);
+    const long timeout = req->timeout_sec > 0 ? req->timeout_sec : p.timeout_sec;
+    const bool idempotent = !req->body && !req->read_fn;
+    char host[128];
+    url_host(req->url, host, sizeof(host));
+
+    for (int attempt = 1;; attempt++) {
+        if (req_cancelled(req)) {
+            info->curl_code = CURLE_ABORTED_BY_CALLBACK;
+            return false;
+        }
+        bool probe;
+        if (!breaker_admit(host, &probe)) {
+            memset(info, 0, sizeof(*info));
+            info->curl_code = CURLE_COULDNT_CONNECT;
+            info->circuit_open = true;
+            info->attempts = attempt - 1;
+            dlog_print(DLOG_DEBUG, LOG_TAG, "%s: circuit open, not sent", req->url);
+            return false;
+        }
+        counted_write_t c = { write_fn, write_ctx, 0 };
+        bool ok = http_once(req, timeout, counted_write_cb, &c, info);
+        bool failed = host_failed(info);
+        breaker_record(host, !failed, info->status == 429 ? info->retry_after_sec : 0);
+        info->attempts = attempt;
+        if (ok || !failed || probe || attempt >= p.max_attempts || req_cancelled(req)) return ok;
+
+        // only what is known to be safe to send twice
+        bool retry = info->curl_code != CURLE_OK && info->curl_code != CURLE_WRITE_ERROR
+            ? idempotent || not_sent(info->curl_code)
+            : idempotent || info->status == 429 || info->status == 503;
+        if (req->read_fn) retry = false;                    // a streamed body cannot be replayed
+        if (c.delivered && !rewind_fn) retry = false;
+        if (info->retry_after_sec > ST_HTTP_RETRY_AFTER_MAX_SEC) retry = false;
+        if (!retry) return false;
+
+        int delay = backoff_ms(&p, attempt);
+        // just past Retry-After, when the host's breaker lets callers in again
+        if (info->retry_after_sec * 1000 >= delay) delay = (int)(info->retry_after_sec * 1000) + 50;
+        dlog_print(DLOG_INFO, LOG_TAG, "%s: attempt %d/%d failed (HTTP %ld), retry in %d ms",
+                   req->url, attempt, p.max_attempts, info->status, delay);
+        if (c.delivered) rewind_fn(write_ctx);
+        if (!pause_ms(req, delay)) return false;
+    }
+}
+
+static void buf_rewind(void *ctx) {
+    st_buf_t *m = ((grow_buf_t *)ctx)->m;
+    m->len = 0;
+    if (m->buf) m->buf[0] = '\0';
+}
+
+static void file_rewind(void *ctx) {
+    FILE *fp = ctx;
+    fflush(fp);
+    rewind(fp);
+    if (ftruncate(fileno(fp), 0) != 0) dlog_print(DLOG_WARN, LOG_TAG, "truncate failed");
+}
+
+bool st_http_perform(const st_http_req_t *req, st_buf_t *out, FILE *fp, st_http_info_t *info) {
+    if (info) memset(info, 0, sizeof(*info));
+    if (!req || !req->url || (!out == !fp)) return false;
+    if (!out) return http_run(req, NULL, fp, file_rewind, info);
+    if (!out->buf) { out->buf = calloc(1, 1); out->len = 0; }
+    grow_buf_t g = { out, out->len };
+    return http_run(req, buf_write_cb, &g, buf_rewind, info);
+}
+
+bool st_http_stream(const st_http_req_t *req, st_http_sink_fn sink, void *ctx, st_http_info_t *info) {
+    if (info) memset(info, 0, sizeof(*info));
+    if (!req || !req->url || !sink) return false;
+    sink_adapter_t a = { sink, ctx };
+    return http_run(req, sink_write_cb, &a, NULL, info);
+}
+
+// ---------- RESUMABLE DOWNLOAD ----------
+typedef struct {
+    st_http_sink_fn sink;
+    st_http_reset_fn reset;
+    void *ctx;
+    const st_http_info_t *info;     // filled by header_cb during the transfer
+    long long received;             // bytes handed to the sink so far
+    long long total;                // expected body size, -1 unknown
+    bool checked;                   // this attempt's response was accepted
+    bool sink_failed;               // the sink said stop: no retry
+    bool rejected;                  // response was not usable as a continuation
+} download_t;
+
+static size_t download_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    download_t *d = userdata;
+    size_t n = size * nmemb;
+    if (!d->checked) {
+        const st_http_info_t *info = d->info;
+        if (info->status == 206 && info->range_start == d->received) {
+            d->total = info->range_total;
+        } else if (info->status == 200) {
+            if (d->received > 0) {
+                // server ignored the range or the entity changed: start over
+                if (d->reset) d->reset(d->ctx);
+                d->received = 0;
+            }
+            d->total = info->content_length;
+        } else {
+            d->rejected = true;
+            return 0;
+        }
+        d->checked = true;
+    }
+    if (!d->sink(ptr, n, d->ctx)) {
+        d->sink_failed = true;
+        return 0;
+    }
+    d->received += (long long)n;
+    return n;
+}
+
+bool st_http_download_stream(const st_http_req_t *req, int attempts, st_http_sink_fn sink,
+                             st_http_reset_fn reset, void *ctx, st_http_info_t *info) {
+    st_http_info_t local;
+    if (!info) info = &local;
+    memset(info, 0, sizeof(*info));
+    if (!req || !req->url || !sink) return false;
+    if (attempts <= 0) attempts = ST_HTTP_DOWNLOAD_ATTEMPTS;
+
+    download_t d = { .sink = sink, .reset = reset, .ctx = ctx, .info = info, .total = -1 };
+    st_http_req_t r = *req;
+    r.identity = true;          // received must count the bytes Content-Length and ranges refer to
+    char etag[128] = "";
+    for (int attempt = 1; attempt <= attempts; attempt++) {
+        d.checked = d.rejected = false;
+        d.total = -1;
+        r.range_from = d.received;
+        r.if_range = etag[0] ? etag : NULL;
+        bool ok = http_run(&r, download_write_cb, &d, NULL, info);
+        if (d.sink_failed || info->circuit_open || req_cancelled(req)) return false;
+        if (info->etag[0] && !etag[0]) snprintf(etag, sizeof(etag), "%s", info->etag);
+        if (ok && (d.checked || d.received == 0) && (d.total < 0 || d.received == d.total))
+            return true;
+
+        bool retry;
+        if ((info->status == 416 && d.received > 0) || (d.rejected && info->status == 206)) {
+            // range no longer valid or misaligned: fetch the whole thing again
+            if (reset) reset(ctx);
+            d.received = 0;
+            etag[0] = '\0';
+            retry = true;
+        } else if (ok || (info->curl_code != CURLE_OK && !d.rejected)) {
+            retry = true;                   // short body, dropped connection, timeout
+        } else {
+            // a real HTTP error (404, 401, ...) is not going to fix itself
+            retry = info->status == 408 || info->status == 429 || info->status >= 500;
+        }
+        if (!retry) break;
+        if (attempt < attempts) {
+            dlog_print(DLOG_INFO, LOG_TAG, "download attempt %d failed (HTTP %ld), resuming at %lld",
+                       attempt, info->status, d.received);
+            if (!pause_ms(req, attempt * 500)) return false;
+        }
+    }
+    return false;
+}
+
+char *st_http_get(const char *url, const char *token) {
+    st_http_req_t req = { .url = url, .bearer = token };
+    st_buf_t m = {0};
+    st_http_info_t info;
+    st_http_perform(&req, &m, NULL, &info);
+    if (info.curl_code != CURLE_OK) { free(m.buf); return NULL; }
+    return m.buf;
+}
+
+char *st_http_post(const char *url, const char *token, const char *payload) {
+    st_http_req_t req = { .url = url, .bearer = token,
+                          .content_type = "application/json", .body = payload };
+    st_buf_t m = {0};
+    st_http_info_t info;
+    st_http_perform(&req, &m, NULL, &info);
+    if (info.curl_code != CURLE_OK) { free(m.buf); return NULL; }
+    return m.buf;
+}
+
+static bool file_sink(const void *data, size_t len, void *ctx) {
+    return fwrite(data, 1, len, (FILE *)ctx) == len;
+}
+
+bool st_http_download(const char *url, const char *token, const char *save_path) {
+    char part[1024];
+    snprintf(part, sizeof(part), "%s.part", save_path);
+    FILE *fp = fopen(part, "wb");
+    if (!fp) return false;
+    st_http_req_t req = { .url = url, .bearer = token };
+    bool ok = st_http_download_stream(&req, 0, file_sink, file_rewind, fp, NULL);
+    ok = fclose(fp) == 0 && ok;
+    if (ok) ok = rename(part, save_path) == 0;
+    if (!ok) remove(part);
+    return ok;
+}
@@ -0,0 +1,199 @@
+#ifndef ST_HTTP_H
+#define ST_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- SHARED HTTP CLIENT ----------
+// Pooled libcurl client for the SmartThings REST calls.
+//
+// A capture cycle (refresh -> take -> status -> download) used to pay a
+// fresh TCP+TLS handshake per call. Here easy handles are kept in a small
+// pool and never cleaned up between requests, each keeping its own
+// connection cache, and all handles share one CURLSH for DNS and TLS
+// sessions, with HTTP/2 negotiated over TLS. After the first requests to
+// api.smartthings.com the rest of the cycle reuses open connections, and a
+// handle connecting for the first time resumes the TLS session.
+//
+// Call st_http_init() after curl_global_init() and st_http_cleanup()
+// before curl_global_cleanup(). All functions are thread-safe.
+
+#define ST_HTTP_POOL_SIZE 4
+
+typedef struct { char *buf; size_t len; } st_buf_t;
+
+typedef struct {
+    const char *method;         // NULL -> GET, or POST when body is set
+    const char *url;
+    const char *bearer;         // "Authorization: Bearer <bearer>" when set
+    const char *auth_header;    // full Authorization header (e.g. Basic ...)
+    const char *content_type;   // Content-Type for body
+    const char *body;           // request body (copied by curl as POSTFIELDS)
+    size_t body_len;            // 0 -> strlen(body)
+    // streamed request body instead of body: read_fn fills dst with up to
+    // cap bytes and returns 0 at the end. read_len < 0 -> chunked upload.
+    size_t (*read_fn)(char *dst, size_t cap, void *ctx);
+    void *read_ctx;
+    long long read_len;
+    const char *if_none_match;  // ETag for a conditional GET (304 -> not modified)
+    long long range_from;       // > 0 -> "Range: bytes=<range_from>-"
+    const char *if_range;       // ETag the range must still match (else 200 + full body)
+    long timeout_sec;           // 0 -> ST_HTTP_DEFAULT_TIMEOUT_SEC
+    // Responses are requested compressed (Accept-Encoding: every encoding
+    // libcurl was built with, gzip/deflate and br where available) and
+    // decoded chunk by chunk before they reach the write path, so callers
+    // always see the plain body. identity turns that off where byte
+    // offsets and lengths must match the wire (ranges, length checks);
+    // requests with range_from set are never compressed.
+    bool identity;
+    // Polled while the transfer runs (at least once a second, more often
+    // while data flows) and during retry backoff. Returning true aborts
+    // with CURLE_ABORTED_BY_CALLBACK and nothing is retried, so a worker
+    // thread can be stopped without waiting out timeout_sec.
+    bool (*cancelled)(void *ctx);
+    // Bytes received so far and the expected total (-1 unknown), from the
+    // same progress callback.
+    void (*progress)(long long now, long long total, void *ctx);
+    void *xfer_ctx;             // passed to cancelled and progress
+    int lane;                   // account lane, 0 -> the calling thread's (st_http_use_lane)
+} st_http_req_t;
+
+typedef struct {
+    long status;                // HTTP status, 0 when no response arrived
+    int curl_code;              // CURLcode of the transfer
+    double total_sec;           // CURLINFO_TOTAL_TIME
+    bool reused;                // connection came from the handle's cache
+    char etag[128];             // response ETag header, "" when absent
+    long long content_length;   // Content-Length header, -1 when absent
+    long long range_start;      // Content-Range "bytes <start>-<end>/<total>", -1 when absent
+    long long range_total;      // -1 when absent or "*"
+    long retry_after_sec;       // Retry-After of the last response, 0 when absent
+    int attempts;               // transfers made under the retry policy
+    bool circuit_open;          // not sent: the host's circuit breaker is open
+} st_http_info_t;
+
+#define ST_HTTP_DEFAULT_TIMEOUT_SEC 30L
+#define ST_HTTP_DOWNLOAD_ATTEMPTS 4
+
+// ---------- RETRY POLICY ----------
+// Every request runs under the policy of the first registered url_match
+// that is a substring of its URL (else the default). Transport errors,
+// 408, 429 and 5xx are retried with jittered exponential backoff; a 429's
+// Retry-After is honoured (up to ST_HTTP_RETRY_AFTER_MAX_SEC, beyond that
+// the call fails). Requests with a body are only repeated when they never
+// reached the server or got 429/503, streamed bodies never.
+//
+// Per host, ST_HTTP_BREAKER_FAILURES unhealthy outcomes in a row (transport
+// error, 429, 5xx) open a circuit breaker: for open_sec every request to
+// that host fails at once with info->circuit_open, then a single probe
+// decides whether it closes again. A 429 holds every caller off the host
+// for its Retry-After.
+typedef struct {
+    int max_attempts;           // 1 -> no retries
+    long timeout_sec;           // per attempt; req->timeout_sec overrides
+    int backoff_base_ms;        // first delay, doubled per attempt
+    int backoff_max_ms;
+} st_http_policy_t;
+
+#define ST_HTTP_POLICY_DEFAULT { 3, ST_HTTP_DEFAULT_TIMEOUT_SEC, 250, 8000 }
+#define ST_HTTP_MAX_POLICIES 16
+#define ST_HTTP_MAX_HOSTS 8
+#define ST_HTTP_BREAKER_FAILURES 5
+#define ST_HTTP_BREAKER_OPEN_SEC 30
+#define ST_HTTP_RETRY_AFTER_MAX_SEC 30
+
+// url_match NULL or "" sets the default. False when the table is full.
+bool st_http_set_policy(const char *url_match, const st_http_policy_t *policy);
+// failure_threshold <= 0 disables the breakers.
+void st_http_set_breaker(int failure_threshold, int open_sec);
+// False while url's host is failing fast; lets callers skip scheduling work.
+bool st_http_host_available(const char *url);
+
+bool st_http_init(void);
+void st_http_cleanup(void);
+
+// Global request budget shared by every thread (token bucket): callers
+// block until a token is available. requests_per_sec <= 0 disables it.
+void st_http_set_rate_limit(double requests_per_sec, int burst);
+// Transfers started since st_http_init (retries included).
+unsigned long st_http_request_count(void);
+
+// ---------- ACCOUNT LANES ----------
+// Several SmartThings accounts in one process share the handle pool and
+// its connections (connections are per host, the bearer is per request)
+// but not their budgets. A lane has its own token bucket, taken
+// before the global one, and a cap on the transfers it runs at once, so
+// one busy account cannot hold every connection or spend the others' rate
+// limit. A request runs in req->lane, else in the lane of the calling
+// thread, else in none (global budget only). A transfer cancelled while
+// it waits for a lane slot fails with CURLE_ABORTED_BY_CALLBACK. Counted
+// in st_http_lane_requests_total{account=name}.
+#define ST_HTTP_MAX_LANES 16
+
+// lane is 1..ST_HTTP_MAX_LANES. requests_per_sec <= 0: no bucket of its
+// own; max_parallel <= 0: no cap. May be called again to change limits.
+bool st_http_set_lane(int lane, const char *name, double requests_per_sec, int burst, int max_parallel);
+// Lane for the requests of this thread from now on (0: none).
+void st_http_use_lane(int lane);
+int st_http_current_lane(void);
+
+// ---------- ORIGIN MAP ----------
+// Sends every request whose URL starts with from to the same path under to
+// instead, e.g. "https://api.smartthings.com" -> "http://127.0.0.1:8080"
+// for the mock server of st_bench. Policies, breakers and metrics still see
+// the original URL. Call before the first request. False when the table is
+// full.
+#define ST_HTTP_MAX_ORIGIN_MAPS 4
+bool st_http_map_origin(const char *from, const char *to);
+
+// ---------- PRE-WARM ----------
+// Resolves url's host and leaves an open TLS connection to it in a pooled
+// handle (a HEAD to scheme://host/, outside the rate limit), so the next
+// real request skips DNS, TCP and TLS setup, or at least DNS and a full
+// TLS handshake when it lands on another handle. Blocks; run it off the main
+// loop. False when the host is unreachable or its breaker is open.
+#define ST_HTTP_PREWARM_TIMEOUT_SEC 10L
+bool st_http_prewarm(const char *url);
+unsigned long st_http_prewarm_count(void);
+
+// Body is written to out (NUL-terminated, caller frees out->buf) or to fp.
+// Exactly one of out/fp must be set. Returns true on a completed transfer
+// with a 2xx status.
+bool st_http_perform(const st_http_req_t *req, st_buf_t *out, FILE *fp, st_http_info_t *info);
+
+// Streams the body into sink chunk by chunk as it arrives, with no
+// intermediate buffer. Returning false from the sink aborts the transfer.
+typedef bool (*st_http_sink_fn)(const void *data, size_t len, void *ctx);
+bool st_http_stream(const st_http_req_t *req, st_http_sink_fn sink, void *ctx, st_http_info_t *info);
+
+// Checked, resumable download. The body only reaches sink once the
+// response is known to be a 200 or the 206 continuing where the last
+// attempt stopped; error bodies never do. A dropped transfer is retried up
+// to attempts times (0 -> ST_HTTP_DOWNLOAD_ATTEMPTS) with a Range request
+// guarded by If-Range on the first ETag. When the server sends the whole
+// body again, reset (may be NULL only if the sink can take that) is called
+// first so the sink starts over. Succeeds only when the byte count matches
+// Content-Length/Content-Range.
+typedef void (*st_http_reset_fn)(void *ctx);
+bool st_http_download_stream(const st_http_req_t *req, int attempts, st_http_sink_fn sink,
+                             st_http_reset_fn reset, void *ctx, st_http_info_t *info);
+
+// Convenience wrappers matching the old per-app helpers. The returned
+// string is malloc'd; NULL when the transfer itself failed.
+char *st_http_get(const char *url, const char *token);
+char *st_http_post(const char *url, const char *token, const char *payload);
+// Downloads through st_http_download_stream into <save_path>.part and
+// renames it over save_path once complete; a failed download leaves
+// save_path untouched.
+bool st_http_download(const char *url, const char *token, const char *save_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include "st_image_ready.h"
+
+#include "st_devstate.h"
+#include "st_http.h"
+#include "st_json_path.h"
+
+#include <dlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_IMAGE"
+#define API_BASE "https://api.smartthings.com/v1"
+
+double st_parse_iso8601(const char *s) {
+    if (!s) return 0;
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    double frac = 0;
+    int n = 0;
+    if (sscanf(s, "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &n) != 6)
+        return 0;
+    if (s[n] == '.') frac = strtod(s + n, NULL);
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return (double)timegm(&tm) + frac;
+}
+
+bool st_status_image(const char *status_json, char *url, size_t url_len, double *ts_out) {
+    if (ts_out) *ts_out = 0;
+    if (!status_json) return false;
+
+    char ts[64], capture_time[64];
+    st_json_target_t t[] = {
+        { "components.main.imageCapture.image.value", url, url_len, false },
+        { "components.main.imageCapture.image.timestamp", ts, sizeof(ts), false },
+        { "components.main.imageCapture.captureTime.value", capture_time, sizeof(capture_time), false },
+    };
+    st_json_extract(status_json, strlen(status_json), t, 3);
+    if (!t[0].found) return false;
+
+    if (ts_out) {
+        // captureTime is the camera's own clock; prefer it when present
+        double c = t[2].found ? st_parse_iso8601(capture_time) : 0;
+        *ts_out = c > 0 ? c : (t[1].found ? st_parse_iso8601(ts) : 0);
+    }
+    return true;
+}
+
+double st_image_baseline(const char *device_id, const char *token) {
+    double ts = 0;
+    if (st_devstate_get(device_id, "main", "imageCapture", "image", NULL, 0, &ts)) return ts;
+    char status_url[512];
+    snprintf(status_url, sizeof(status_url), "%s/devices/%s/status", API_BASE, device_id);
+    char *status = st_http_get(status_url, token);
+    char url[512];
+    st_status_image(status, url, sizeof(url), &ts);
+    free(status);
+    return ts;
+}
+
+static double now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Sleeps ms in short slices so cancellation stays responsive.
+static bool backoff_sleep(int ms, st_cancel_fn cancel, void *ctx) {
+    while (ms > 0) {
+        if (cancel && cancel(ctx)) return false;
+        int slice = ms < 100 ? ms : 100;
+        usleep((useconds_t)slice * 1000);
+        ms -= slice;
+    }
+    return !(cancel && cancel(ctx));
+}
+
+bool st_wait_new_image(const char *device_id, const char *token,
+                       double prev_ts, double command_time,
+                       const st_backoff_t *backoff,
+                       st_cancel_fn cancel, void *ctx,
+                       char *url, size_t url_len) {
+    static const st_backoff_t defaults = ST_BACKOFF_DEFAULT;
+    const st_backoff_t *b = backoff ? backoff : &defaults;
+
+    char status_url[512];
+    snprintf(status_url, sizeof(status_url), "%s/devices/%s/status", API_BASE, device_id);
+
+    double threshold = command_time - b->clock_skew_sec;
+    if (prev_ts > threshold) threshold = prev_ts;
+
+    const double deadline = now_sec() + b->timeout_ms / 1000.0;
+    int delay = b->first_delay_ms;
+    int polls = 0;
+
+    // while the event stream is up the new frame is pushed to the mirror: no polls at all.
+    // It gets half the budget; an event missed on a live stream (e.g. between the seed
+    // and the connect) is then still caught by the polls below.
+    if (st_devstate_get(device_id, "main", "imageCapture", "image", NULL, 0, NULL)) {
+        char found[512];
+        if (st_devstate_wait(device_id, "main", "imageCapture", "image", threshold, b->timeout_ms / 2000.0,
+                             cancel, ctx, found, sizeof(found), NULL)) {
+            snprintf(url, url_len, "%s", found);
+            dlog_print(DLOG_INFO, LOG_TAG, "new image from the event stream, %.2fs after command",
+                       now_sec() - command_time);
+            return true;
+        }
+        if (cancel && cancel(ctx)) return false;
+        // timed out, or the stream dropped: poll for the rest of the budget, right away
+        delay = 0;
+    }
+
+    // at least one poll, however the budget was spent
+    while (polls == 0 || now_sec() < deadline) {
+        if (!backoff_sleep(delay, cancel, ctx)) return false;
+        polls++;
+
+        char *status = st_http_get(status_url, token);
+        double ts = 0;
+        char found[512];
+        bool have = st_status_image(status, found, sizeof(found), &ts);
+        free(status);
+
+        if (have && ts > threshold) {
+            snprintf(url, url_len, "%s", found);
+            dlog_print(DLOG_INFO, LOG_TAG, "new image after %d polls, %.2fs after command",
+                       polls, now_sec() - command_time);
+            return true;
+        }
+
+        delay = delay ? delay * 2 : b->first_delay_ms;
+        if (delay > b->max_delay_ms) delay = b->max_delay_ms;
+    }
+    dlog_print(DLOG_WARN, LOG_TAG, "no new image within %d ms (%d polls)", b->timeout_ms, polls);
+    return false;
+}
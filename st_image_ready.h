@@ -0,0 +1,56 @@
+#ifndef ST_IMAGE_READY_H
+#define ST_IMAGE_READY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- IMAGE-READY DETECTION ----------
+// Replaces the fixed sleeps after Refresh/imageCapture.take. The device
+// status is polled with exponential backoff and a frame counts as new only
+// when imageCapture.image (or captureTime) carries a timestamp later than
+// both the previous frame and the moment the take command was sent, so a
+// fast poll can never hand back the previous capture.
+// When st_devstate's event stream mirrors the device, the wait is for the
+// pushed imageCapture.image event instead, for up to half of timeout_ms;
+// the rest is polled, so a dropped stream or a missed event costs time
+// but not the frame. At least one poll is always made.
+
+typedef struct {
+    int first_delay_ms;     // first poll after the take command
+    int max_delay_ms;       // backoff cap
+    int timeout_ms;         // give up after this long
+    double clock_skew_sec;  // tolerated device/server vs local clock skew
+} st_backoff_t;
+
+#define ST_BACKOFF_DEFAULT { 250, 2000, 20000, 2.0 }
+
+// Returns true to abort the wait (e.g. ecore_thread_check).
+typedef bool (*st_cancel_fn)(void *ctx);
+
+// ISO-8601 UTC ("2024-05-01T12:34:56.789Z") -> epoch seconds, 0 on error.
+double st_parse_iso8601(const char *s);
+
+// Pulls components.main.imageCapture.image {value, timestamp} out of a
+// /devices/{id}/status body. ts_out is 0 when no timestamp is present.
+bool st_status_image(const char *status_json, char *url, size_t url_len, double *ts_out);
+
+// Timestamp of the image currently reported by the device (0 if none).
+double st_image_baseline(const char *device_id, const char *token);
+
+// Polls until a frame newer than max(prev_ts, command_time - skew) shows up.
+// command_time is local epoch seconds taken just before sending 'take'.
+bool st_wait_new_image(const char *device_id, const char *token,
+                       double prev_ts, double command_time,
+                       const st_backoff_t *backoff,
+                       st_cancel_fn cancel, void *ctx,
+                       char *url, size_t url_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+#include "st_infer.h"
+
+#include <onnxruntime_cxx_api.h>
+
+#include <dlog.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "decoder_engine.h"
+#include "decoder_spec.h"
+#include "embedding_table.h"
+#include "feature_cache.h"
+#include "session_pool.h"
+#include "st_metrics.h"
+
+#define LOG_TAG "ST_INFER"
+
+namespace {
+
+// Per-channel normalization the encoder was trained with (ImageNet).
+const float kMean[3] = {0.485f, 0.456f, 0.406f};
+const float kStd[3] = {0.229f, 0.224f, 0.225f};
+
+struct Engine {
+    st_infer_cfg_t cfg{};
+    RunnerConfig rc;
+    std::unique_ptr<SessionPool> pool;
+    Ort::MemoryInfo mem{Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)};
+    SessionPool::Lease encoder, decoder;
+    EmbeddingTable embedding;
+    std::unique_ptr<DecoderEngine> engine;
+    DecoderChoice choice;
+    std::unique_ptr<FeatureCache> features;
+    uint64_t model_version = 0;         // encoder file, part of the cache key
+    bool external_features = false;     // decoder bound to a cached buffer
+    std::vector<float> pixels;          // [1,3,H,W], refilled per frame
+    std::unique_ptr<Ort::IoBinding> encoder_io;
+    Ort::Value pixel_value{nullptr}, feature_value{nullptr};
+    std::vector<int64_t> pixel_shape, feature_shape;
+};
+
+std::mutex g_lock;
+std::unique_ptr<Engine> g_engine;
+
+// Encoder and decoder share one Env: the global intra-op pool and one
+// CPU arena, extended by what a run asks for rather than doubling.
+RunnerConfig runner_config(const st_infer_cfg_t& cfg) {
+    RunnerConfig rc;
+    rc.intra_op_threads = cfg.threads;
+    rc.shared_arena = true;
+    rc.warm.enabled = true;
+    rc.warm.options_tag = "threads=" + std::to_string(cfg.threads);
+    rc.latency = cfg.latency;
+    return rc;
+}
+
+std::unique_ptr<Engine> build(const st_infer_cfg_t& cfg) {
+    std::unique_ptr<Engine> e(new Engine);
+    e->cfg = cfg;
+    e->embedding = EmbeddingTable::load(cfg.embedding);
+
+    DecoderSignature sig = DefaultDecoderSpec::signature(DecoderTokenInput::Embedding);
+    DefaultDecoderSpec::check_table(e->embedding);
+
+    const RunnerConfig rc = runner_config(cfg);
+    e->rc = rc;
+    e->pool.reset(new SessionPool(rc, "st_infer"));
+    e->pool->add("st_infer.encoder", PoolModel{cfg.encoder_model, rc, 1});
+    e->pool->add("st_infer.decoder", PoolModel{cfg.decoder_model, rc, 1});
+    e->encoder = e->pool->acquire("st_infer.encoder");
+    e->decoder = e->pool->acquire("st_infer.decoder");
+
+    // every verdict embeds BOS and reads the answer rows
+    std::vector<int32_t> hot(cfg.yes_tokens, cfg.yes_tokens + cfg.yes_count);
+    hot.insert(hot.end(), cfg.no_tokens, cfg.no_tokens + cfg.no_count);
+    hot.push_back(cfg.bos_token);
+    e->embedding.pin_hot(hot);
+
+    const EmbeddingTable& emb = e->embedding;
+    DefaultDecoderSpec::check(*e->decoder, sig, DecoderTokenInput::Embedding);
+    e->engine.reset(new DecoderEngine(*e->decoder, sig, DecoderTokenInput::Embedding,
+                                      DefaultDecoderSpec::embed_fn(emb)));
+    e->engine->set_prefetch([&emb](int32_t tok) { emb.prefetch(tok); });
+    e->choice.yes_ids.assign(cfg.yes_tokens, cfg.yes_tokens + cfg.yes_count);
+    e->choice.no_ids.assign(cfg.no_tokens, cfg.no_tokens + cfg.no_count);
+    e->choice.temperature = cfg.temperature > 0 ? cfg.temperature : 1.0f;
+    e->choice.decisive = cfg.decisive;
+    e->choice.max_steps = cfg.max_steps > 0 ? static_cast<size_t>(cfg.max_steps) : 4;
+    // checks the ids against the vocabulary now rather than on the first frame
+    e->engine->reset_state();
+    e->engine->classify(cfg.bos_token, e->choice);
+
+    e->features.reset(new FeatureCache(sig.encoder_shape,
+                                       cfg.feature_cache_entries > 0 ? cfg.feature_cache_entries : 8,
+                                       cfg.feature_cache_dir ? cfg.feature_cache_dir : "",
+                                       cfg.feature_cache_files > 0 ? cfg.feature_cache_files : 0));
+    e->model_version = FeatureCache::model_version(cfg.encoder_model);
+
+    // encoder writes its features straight into the decoder's input:0 buffer
+    e->pixel_shape = {1, 3, cfg.input_h, cfg.input_w};
+    e->feature_shape = sig.encoder_shape;
+    e->pixels.assign(decoder_shape_elems(e->pixel_shape), 0.0f);
+    e->pixel_value = Ort::Value::CreateTensor<float>(e->mem, e->pixels.data(), e->pixels.size(),
+                                                     e->pixel_shape.data(), e->pixel_shape.size());
+    e->feature_value = Ort::Value::CreateTensor<float>(e->mem, e->engine->encoder_buffer(),
+                                                       e->engine->encoder_size(),
+                                                       e->feature_shape.data(), e->feature_shape.size());
+    Ort::AllocatorWithDefaultOptions alloc;
+    auto in_name = e->encoder->GetInputNameAllocated(0, alloc);
+    auto out_name = e->encoder->GetOutputNameAllocated(0, alloc);
+    e->encoder_io.reset(new Ort::IoBinding(*e->encoder));
+    e->encoder_io->BindInput(in_name.get(), e->pixel_value);
+    e->encoder_io->BindOutput(out_name.get(), e->feature_value);
+
+    // latency profile: the first timed frame finds weights and arena chunks hot
+    for (int i = 0; i < runner_prerun(rc); ++i) {
+        e->encoder->Run(Ort::RunOptions{nullptr}, *e->encoder_io);
+        e->engine->reset_state();
+        e->engine->classify(cfg.bos_token, e->choice);
+    }
+    return e;
+}
+
+}  // namespace
+
+extern "C" bool st_infer_open(const st_infer_cfg_t* cfg) {
+    if (!cfg || !cfg->encoder_model || !cfg->decoder_model || !cfg->embedding ||
+        cfg->input_w <= 0 || cfg->input_h <= 0)
+        return false;
+    if (!cfg->yes_count || !cfg->no_count) {
+        dlog_print(DLOG_WARN, LOG_TAG, "no yes/no answer token ids configured, engine not loaded");
+        return false;
+    }
+    try {
+        std::unique_ptr<Engine> e = build(*cfg);
+        std::lock_guard<std::mutex> lock(g_lock);
+        g_engine = std::move(e);
+        dlog_print(DLOG_INFO, LOG_TAG, "engine ready (%dx%d input, vocab %zu)",
+                   cfg->input_w, cfg->input_h, g_engine->engine->vocab());
+        return true;
+    } catch (const std::exception& ex) {
+        dlog_print(DLOG_WARN, LOG_TAG, "engine not available: %s", ex.what());
+        return false;
+    }
+}
+
+extern "C" void st_infer_close(void) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    g_engine.reset();
+}
+
+// The bound buffer belongs to the cache, and any find() or insert() may
+// evict it: unbind before touching the cache.
+static void unbind_features(Engine& e) {
+    if (!e.external_features) return;
+    e.engine->bind_encoder(nullptr);
+    e.external_features = false;
+}
+
+extern "C" void st_infer_trim(void) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (!g_engine) return;
+    Engine& e = *g_engine;
+    unbind_features(e);
+    e.features->clear();
+    e.embedding.release_pages();
+}
+
+extern "C" bool st_infer_available(void) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    return g_engine != nullptr;
+}
+
+extern "C" void st_infer_input_size(int* w, int* h) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    *w = g_engine ? g_engine->cfg.input_w : 0;
+    *h = g_engine ? g_engine->cfg.input_h : 0;
+}
+
+extern "C" bool st_infer_has_features(uint64_t frame_hash) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (!g_engine || !frame_hash) return false;
+    unbind_features(*g_engine);
+    return g_engine->features->find(frame_hash, g_engine->model_version) != nullptr;
+}
+
+extern "C" bool st_infer_frame(const uint8_t* rgb, uint64_t frame_hash, const st_infer_question_t* q,
+                               st_infer_result_t* out) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    if (!g_engine || !out) return false;
+    Engine& e = *g_engine;
+    // verdicts come from one app worker in practice; each thread is pinned once
+    static thread_local bool pinned = false;
+    if (e.cfg.latency && !pinned) {
+        pinned = true;
+        int cpu = runner_pin_thread(e.rc);
+        if (cpu >= 0) dlog_print(DLOG_INFO, LOG_TAG, "verdict thread pinned to cpu %d", cpu);
+    }
+    try {
+        auto t0 = std::chrono::steady_clock::now();
+        unbind_features(e);
+        const float* cached = frame_hash ? e.features->find(frame_hash, e.model_version) : nullptr;
+        if (cached) {
+            // read-only input: the mapping/heap copy is bound as is
+            e.engine->bind_encoder(const_cast<float*>(cached));
+            e.external_features = true;
+        } else {
+            if (!rgb) return false;
+            // packed HWC uint8 -> normalized planar CHW float
+            const size_t plane = static_cast<size_t>(e.cfg.input_w) * e.cfg.input_h;
+            for (int c = 0; c < 3; ++c) {
+                float* dst = e.pixels.data() + c * plane;
+                const float scale = 1.0f / (255.0f * kStd[c]), bias = kMean[c] / kStd[c];
+                for (size_t i = 0; i < plane; ++i) dst[i] = rgb[i * 3 + c] * scale - bias;
+            }
+            e.encoder->Run(Ort::RunOptions{nullptr}, *e.encoder_io);
+            if (frame_hash) e.features->insert(frame_hash, e.model_version, e.engine->encoder_buffer());
+        }
+
+        DecoderChoice asked;
+        const DecoderChoice* choice = &e.choice;
+        int bos = e.cfg.bos_token;
+        if (q) {
+            asked = e.choice;
+            asked.yes_ids.assign(q->yes_tokens, q->yes_tokens + q->yes_count);
+            asked.no_ids.assign(q->no_tokens, q->no_tokens + q->no_count);
+            choice = &asked;
+            bos = q->bos_token;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        e.engine->reset_state();
+        DecoderVerdict v = e.engine->classify(bos, *choice);
+        auto t2 = std::chrono::steady_clock::now();
+        // per-step time is the decode time spread over its steps (classify is one call)
+        st_metric_observe(st_metrics_histogram("st_infer_encode_ms", cached ? "features=\"cached\"" : "features=\"computed\""),
+                          std::chrono::duration<double, std::milli>(t1 - t0).count());
+        if (v.steps)
+            st_metric_observe(st_metrics_histogram("st_decoder_step_ms", nullptr),
+                              std::chrono::duration<double, std::milli>(t2 - t1).count() / v.steps);
+        out->threat = v.yes;
+        out->p_yes = v.p_yes;
+        out->steps = static_cast<int>(v.steps);
+        out->cached = cached != nullptr;
+        out->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    } catch (const std::exception& ex) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "inference failed: %s", ex.what());
+        return false;
+    }
+}
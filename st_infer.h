@@ -0,0 +1,101 @@
+#ifndef ST_INFER_H
+#define ST_INFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- ON-DEVICE VLM ----------
+// The remote path turns each frame into base64, a JSON request and an HTTP
+// round trip to the evaluation service. This keeps the model resident in
+// the capture process instead: an image encoder session fills the
+// decoder's input:0 features straight from the decoded RGB frame, and the
+// DecoderEngine (decoder_engine.h, external-embedding model) decodes from
+// bos_token with output:0 restricted to the Yes/No token variants
+// (DecoderEngine::classify). It stops at the first decisive step, usually
+// the first, so no text has to be generated or parsed.
+//
+// Sessions load once (warm-started from the serialized optimized graph,
+// session_cache.h) into a SessionPool whose single Env gives both models
+// one thread pool and one arena; verdicts are serialized on one engine,
+// so concurrent capture workers queue. Any thread; no EFL involved.
+//
+// Encoder outputs are cached by frame hash and encoder model version
+// (feature_cache.h), so further questions about a frame, or a retry, only
+// run the decoder. With feature_cache_dir set the cache is also kept on
+// disk and survives restarts.
+
+typedef struct {
+    const char *encoder_model;  // RGB [1,3,H,W] float -> [1,352,2,8] features
+    const char *decoder_model;  // gather-replaced decoder ("embedded_token" input)
+    const char *embedding;      // .npy or .embq table for the external Gather
+    int input_w, input_h;       // encoder image size
+    int bos_token;              // first token fed to the decoder
+    const int32_t *yes_tokens;  // answer variants ("Yes", " yes", ...)
+    size_t yes_count;
+    const int32_t *no_tokens;
+    size_t no_count;
+    float temperature;          // calibration, 0 -> 1
+    float decisive;             // answer mass that ends decoding, 0 -> first step
+    int max_steps;              // 0 -> 4
+    int threads;                // intra-op threads, 0 -> ORT default
+    // tuning=latency (runner_config.h): spin-waiting pools, the thread that
+    // calls st_infer_frame pinned to a performance core, both models run
+    // once at open. For when the verdict's tail latency matters most.
+    bool latency;
+    int feature_cache_entries;  // frames kept in memory, 0 -> 8
+    const char *feature_cache_dir;  // NULL: memory only
+    int feature_cache_files;    // bound on the directory, 0 -> unbounded
+} st_infer_cfg_t;
+
+// Another closed question about the same frame; the answer ids and
+// bos_token replace the configured ones, the calibration stays.
+typedef struct {
+    int bos_token;
+    const int32_t *yes_tokens;
+    size_t yes_count;
+    const int32_t *no_tokens;
+    size_t no_count;
+} st_infer_question_t;
+
+typedef struct {
+    bool threat;                // p_yes > 0.5
+    float p_yes;                // calibrated P(Yes | answer tokens)
+    int steps;                  // decoder steps taken
+    bool cached;                // features came from the cache, encoder skipped
+    double ms;                  // encoder (unless cached) + decoder steps
+} st_infer_result_t;
+
+// Loads the models. False (logged) when a file is missing or does not
+// match the expected signature; the caller keeps the remote path then.
+bool st_infer_open(const st_infer_cfg_t *cfg);
+void st_infer_close(void);
+bool st_infer_available(void);
+// Frees what the engine can rebuild (in-memory cached features, resident
+// pages of the embedding table) while the models stay loaded. Features
+// cached on disk are found again.
+void st_infer_trim(void);
+
+// Encoder input size of the open engine.
+void st_infer_input_size(int *w, int *h);
+
+// True when the features of frame_hash are cached: st_infer_frame() then
+// needs no pixels.
+bool st_infer_has_features(uint64_t frame_hash);
+
+// rgb is packed RGB of exactly the input size (st_jpeg_decode_rgb), or
+// NULL when the features are cached. frame_hash names the image content
+// (0: not cached). q NULL asks the configured question. False on error,
+// or when rgb is NULL and the features are not (or no longer) cached.
+bool st_infer_frame(const uint8_t *rgb, uint64_t frame_hash, const st_infer_question_t *q,
+                    st_infer_result_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
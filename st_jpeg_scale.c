@@ -0,0 +1,361 @@
+#include "st_jpeg_scale.h"
+
+#include <setjmp.h>
+#include <stdio.h>      // before jpeglib.h, which uses FILE
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+typedef struct {
+    struct jpeg_error_mgr mgr;
+    jmp_buf jump;
+} error_ctx_t;
+
+static void on_error(j_common_ptr cinfo) {
+    error_ctx_t *e = (error_ctx_t *)cinfo->err;
+    longjmp(e->jump, 1);
+}
+
+static void on_message(j_common_ptr cinfo) { (void)cinfo; }
+
+// Area average of an RGB image into tw x th (tw <= sw, th <= sh).
+static void box_resize(const uint8_t *src, int sw, int sh, uint8_t *dst, int tw, int th,
+                       uint32_t *acc) {
+    for (int oy = 0; oy < th; oy++) {
+        int y0 = (int)((long long)oy * sh / th);
+        int y1 = (int)((long long)(oy + 1) * sh / th);
+        if (y1 <= y0) y1 = y0 + 1;
+        memset(acc, 0, sizeof(uint32_t) * 3 * (size_t)tw);
+        for (int y = y0; y < y1; y++) {
+            const uint8_t *row = src + (size_t)y * sw * 3;
+            for (int ox = 0; ox < tw; ox++) {
+                int x0 = (int)((long long)ox * sw / tw);
+                int x1 = (int)((long long)(ox + 1) * sw / tw);
+                if (x1 <= x0) x1 = x0 + 1;
+                uint32_t r = 0, g = 0, b = 0;
+                for (int x = x0; x < x1; x++) {
+                    r += row[x * 3];
+                    g += row[x * 3 + 1];
+                    b += row[x * 3 + 2];
+                }
+                acc[ox * 3] += r;
+                acc[ox * 3 + 1] += g;
+                acc[ox * 3 + 2] += b;
+            }
+        }
+        uint8_t *out = dst + (size_t)oy * tw * 3;
+        for (int ox = 0; ox < tw; ox++) {
+            int x0 = (int)((long long)ox * sw / tw);
+            int x1 = (int)((long long)(ox + 1) * sw / tw);
+            if (x1 <= x0) x1 = x0 + 1;
+            uint32_t n = (uint32_t)((x1 - x0) * (y1 - y0));
+            for (int c = 0; c < 3; c++) out[ox * 3 + c] = (uint8_t)((acc[ox * 3 + c] + n / 2) / n);
+        }
+    }
+}
+
+bool st_jpeg_downscale(const uint8_t *jpg, size_t len, int max_dim, int quality,
+                       uint8_t **out, size_t *out_len, st_jpeg_scale_info_t *info) {
+    *out = NULL;
+    *out_len = 0;
+    if (!jpg || len < 4 || max_dim <= 0) return false;
+
+    // everything the error path must free lives outside locals touched by longjmp
+    struct {
+        struct jpeg_decompress_struct d;
+        struct jpeg_compress_struct c;
+        error_ctx_t err;
+        uint8_t *decoded, *resized;
+        uint32_t *acc;
+        unsigned char *enc;
+        unsigned long enc_len;
+        bool have_d, have_c, ok;
+    } *s = calloc(1, sizeof(*s));
+    if (!s) return false;
+
+    s->d.err = jpeg_std_error(&s->err.mgr);
+    s->err.mgr.error_exit = on_error;
+    s->err.mgr.output_message = on_message;
+    if (setjmp(s->err.jump)) goto done;
+
+    jpeg_create_decompress(&s->d);
+    s->have_d = true;
+    jpeg_mem_src(&s->d, jpg, (unsigned long)len);
+    if (jpeg_read_header(&s->d, TRUE) != JPEG_HEADER_OK) goto done;
+
+    const int sw = (int)s->d.image_width, sh = (int)s->d.image_height;
+    const int longest = sw > sh ? sw : sh;
+    if (longest <= max_dim) goto done;
+
+    // largest DCT reduction that still leaves at least max_dim pixels
+    unsigned denom = 1;
+    while (denom < 8 && longest / (int)(denom * 2) >= max_dim) denom *= 2;
+    s->d.scale_num = 1;
+    s->d.scale_denom = denom;
+    s->d.out_color_space = JCS_RGB;
+    s->d.dct_method = JDCT_ISLOW;
+    jpeg_start_decompress(&s->d);
+
+    const int dw = (int)s->d.output_width, dh = (int)s->d.output_height;
+    s->decoded = malloc((size_t)dw * dh * 3);
+    if (!s->decoded) goto done;
+    while (s->d.output_scanline < s->d.output_height) {
+        JSAMPROW row = s->decoded + (size_t)s->d.output_scanline * dw * 3;
+        jpeg_read_scanlines(&s->d, &row, 1);
+    }
+    jpeg_finish_decompress(&s->d);
+
+    int tw = dw, th = dh;
+    if ((dw > dh ? dw : dh) > max_dim) {
+        if (dw >= dh) { tw = max_dim; th = (int)((long long)dh * max_dim / dw); }
+        else { th = max_dim; tw = (int)((long long)dw * max_dim / dh); }
+        if (tw < 1) tw = 1;
+        if (th < 1) th = 1;
+        s->resized = malloc((size_t)tw * th * 3);
+        s->acc = malloc(sizeof(uint32_t) * 3 * (size_t)tw);
+        if (!s->resized || !s->acc) goto done;
+        box_resize(s->decoded, dw, dh, s->resized, tw, th, s->acc);
+    }
+    const uint8_t *pixels = s->resized ? s->resized : s->decoded;
+
+    s->c.err = &s->err.mgr;
+    jpeg_create_compress(&s->c);
+    s->have_c = true;
+    jpeg_mem_dest(&s->c, &s->enc, &s->enc_len);
+    s->c.image_width = (JDIMENSION)tw;
+    s->c.image_height = (JDIMENSION)th;
+    s->c.input_components = 3;
+    s->c.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&s->c);
+    jpeg_set_quality(&s->c, quality > 0 && quality <= 100 ? quality : 85, TRUE);
+    jpeg_start_compress(&s->c, TRUE);
+    while (s->c.next_scanline < s->c.image_height) {
+        JSAMPROW row = (JSAMPROW)(pixels + (size_t)s->c.next_scanline * tw * 3);
+        jpeg_write_scanlines(&s->c, &row, 1);
+    }
+    jpeg_finish_compress(&s->c);
+
+    if (s->enc && s->enc_len < len) {
+        *out = s->enc;
+        *out_len = s->enc_len;
+        s->enc = NULL;
+        if (info) *info = (st_jpeg_scale_info_t){ sw, sh, tw, th };
+        s->ok = true;
+    }
+
+done:
+    if (s->have_c) jpeg_destroy_compress(&s->c);
+    if (s->have_d) jpeg_destroy_decompress(&s->d);
+    free(s->enc);
+    free(s->decoded);
+    free(s->resized);
+    free(s->acc);
+    bool ok = s->ok;
+    free(s);
+    return ok;
+}
+
+bool st_jpeg_decode_rgb(const uint8_t *jpg, size_t len, int out_w, int out_h,
+                        uint8_t **rgb, st_jpeg_scale_info_t *info) {
+    *rgb = NULL;
+    if (!jpg || len < 4 || out_w <= 0 || out_h <= 0) return false;
+
+    struct {
+        struct jpeg_decompress_struct d;
+        error_ctx_t err;
+        uint8_t *decoded, *resized;
+        uint32_t *acc;
+        bool have_d, ok;
+    } *s = calloc(1, sizeof(*s));
+    if (!s) return false;
+
+    s->d.err = jpeg_std_error(&s->err.mgr);
+    s->err.mgr.error_exit = on_error;
+    s->err.mgr.output_message = on_message;
+    if (setjmp(s->err.jump)) goto done;
+
+    jpeg_create_decompress(&s->d);
+    s->have_d = true;
+    jpeg_mem_src(&s->d, jpg, (unsigned long)len);
+    if (jpeg_read_header(&s->d, TRUE) != JPEG_HEADER_OK) goto done;
+
+    const int sw = (int)s->d.image_width, sh = (int)s->d.image_height;
+    // largest DCT reduction that still covers out_w x out_h
+    unsigned denom = 1;
+    while (denom < 8 && sw / (int)(denom * 2) >= out_w && sh / (int)(denom * 2) >= out_h) denom *= 2;
+    s->d.scale_num = 1;
+    s->d.scale_denom = denom;
+    s->d.out_color_space = JCS_RGB;
+    s->d.dct_method = JDCT_ISLOW;
+    jpeg_start_decompress(&s->d);
+
+    const int dw = (int)s->d.output_width, dh = (int)s->d.output_height;
+    s->decoded = malloc((size_t)dw * dh * 3);
+    if (!s->decoded) goto done;
+    while (s->d.output_scanline < s->d.output_height) {
+        JSAMPROW row = s->decoded + (size_t)s->d.output_scanline * dw * 3;
+        jpeg_read_scanlines(&s->d, &row, 1);
+    }
+    jpeg_finish_decompress(&s->d);
+
+    if (dw == out_w && dh == out_h) {
+        s->resized = s->decoded;
+        s->decoded = NULL;
+    } else {
+        // a smaller source is sampled nearest-neighbour by the same loop
+        s->resized = malloc((size_t)out_w * out_h * 3);
+        s->acc = malloc(sizeof(uint32_t) * 3 * (size_t)out_w);
+        if (!s->resized || !s->acc) goto done;
+        box_resize(s->decoded, dw, dh, s->resized, out_w, out_h, s->acc);
+    }
+    *rgb = s->resized;
+    s->resized = NULL;
+    if (info) *info = (st_jpeg_scale_info_t){ sw, sh, out_w, out_h };
+    s->ok = true;
+
+done:
+    if (s->have_d) jpeg_destroy_decompress(&s->d);
+    free(s->decoded);
+    free(s->resized);
+    free(s->acc);
+    bool ok = s->ok;
+    free(s);
+    return ok;
+}
+
+bool st_jpeg_crop(const uint8_t *jpg, size_t len, int x, int y, int w, int h, int max_dim,
+                  int quality, uint8_t **out, size_t *out_len, st_jpeg_scale_info_t *info) {
+    *out = NULL;
+    *out_len = 0;
+    if (!jpg || len < 4 || w <= 0 || h <= 0) return false;
+
+    struct {
+        struct jpeg_decompress_struct d;
+        struct jpeg_compress_struct c;
+        error_ctx_t err;
+        uint8_t *rows, *resized;
+        uint32_t *acc;
+        unsigned char *enc;
+        unsigned long enc_len;
+        int x, y, w, h;                 // the crop, clamped to the image below
+        bool have_d, have_c, ok;
+    } *s = calloc(1, sizeof(*s));
+    if (!s) return false;
+    // copied before setjmp: the parameters themselves stay untouched after it
+    s->x = x;
+    s->y = y;
+    s->w = w;
+    s->h = h;
+
+    s->d.err = jpeg_std_error(&s->err.mgr);
+    s->err.mgr.error_exit = on_error;
+    s->err.mgr.output_message = on_message;
+    if (setjmp(s->err.jump)) goto done;
+
+    jpeg_create_decompress(&s->d);
+    s->have_d = true;
+    jpeg_mem_src(&s->d, jpg, (unsigned long)len);
+    if (jpeg_read_header(&s->d, TRUE) != JPEG_HEADER_OK) goto done;
+
+    const int sw = (int)s->d.image_width, sh = (int)s->d.image_height;
+    if (s->x < 0) { s->w += s->x; s->x = 0; }
+    if (s->y < 0) { s->h += s->y; s->y = 0; }
+    if (s->x + s->w > sw) s->w = sw - s->x;
+    if (s->y + s->h > sh) s->h = sh - s->y;
+    if (s->w <= 0 || s->h <= 0) goto done;
+
+    // largest DCT reduction that still leaves the crop at least max_dim long
+    const int longest = s->w > s->h ? s->w : s->h;
+    unsigned denom = 1;
+    while (max_dim > 0 && denom < 8 && longest / (int)(denom * 2) >= max_dim) denom *= 2;
+    s->d.scale_num = 1;
+    s->d.scale_denom = denom;
+    s->d.out_color_space = JCS_RGB;
+    s->d.dct_method = JDCT_ISLOW;
+    jpeg_start_decompress(&s->d);
+
+    // the crop in output pixels; the decoder widens the columns to whole iMCUs
+    int cx = s->x / (int)denom, cy = s->y / (int)denom;
+    int cw = s->w / (int)denom, ch = s->h / (int)denom;
+    if (cw < 1) cw = 1;
+    if (ch < 1) ch = 1;
+    if (cx + cw > (int)s->d.output_width) cw = (int)s->d.output_width - cx;
+    if (cy + ch > (int)s->d.output_height) ch = (int)s->d.output_height - cy;
+    if (cw <= 0 || ch <= 0) goto done;
+    int skip_x = cx;
+#ifdef LIBJPEG_TURBO_VERSION
+    JDIMENSION xoff = (JDIMENSION)cx, xw = (JDIMENSION)cw;
+    jpeg_crop_scanline(&s->d, &xoff, &xw);
+    skip_x = cx - (int)xoff;
+    if (cy > 0) jpeg_skip_scanlines(&s->d, (JDIMENSION)cy);
+#else
+    if (cy > 0) {
+        // plain libjpeg: decode and drop the rows above
+        s->rows = malloc((size_t)s->d.output_width * 3);
+        if (!s->rows) goto done;
+        JSAMPROW row = s->rows;
+        while ((int)s->d.output_scanline < cy) jpeg_read_scanlines(&s->d, &row, 1);
+        free(s->rows);
+        s->rows = NULL;
+    }
+#endif
+    const int dw = (int)s->d.output_width;      // decoded row width after cropping
+    s->rows = malloc((size_t)dw * ch * 3);
+    if (!s->rows) goto done;
+    for (int r = 0; r < ch; r++) {
+        JSAMPROW row = s->rows + (size_t)r * dw * 3;
+        jpeg_read_scanlines(&s->d, &row, 1);
+        if (skip_x) memmove(s->rows + (size_t)r * cw * 3, row + (size_t)skip_x * 3, (size_t)cw * 3);
+        else if (dw != cw) memmove(s->rows + (size_t)r * cw * 3, row, (size_t)cw * 3);
+    }
+    jpeg_abort_decompress(&s->d);       // the rows below the crop are never decoded
+
+    int tw = cw, th = ch;
+    if (max_dim > 0 && (cw > ch ? cw : ch) > max_dim) {
+        if (cw >= ch) { tw = max_dim; th = (int)((long long)ch * max_dim / cw); }
+        else { th = max_dim; tw = (int)((long long)cw * max_dim / ch); }
+        if (tw < 1) tw = 1;
+        if (th < 1) th = 1;
+        s->resized = malloc((size_t)tw * th * 3);
+        s->acc = malloc(sizeof(uint32_t) * 3 * (size_t)tw);
+        if (!s->resized || !s->acc) goto done;
+        box_resize(s->rows, cw, ch, s->resized, tw, th, s->acc);
+    }
+    const uint8_t *pixels = s->resized ? s->resized : s->rows;
+
+    s->c.err = &s->err.mgr;
+    jpeg_create_compress(&s->c);
+    s->have_c = true;
+    jpeg_mem_dest(&s->c, &s->enc, &s->enc_len);
+    s->c.image_width = (JDIMENSION)tw;
+    s->c.image_height = (JDIMENSION)th;
+    s->c.input_components = 3;
+    s->c.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&s->c);
+    jpeg_set_quality(&s->c, quality > 0 && quality <= 100 ? quality : 85, TRUE);
+    jpeg_start_compress(&s->c, TRUE);
+    while (s->c.next_scanline < s->c.image_height) {
+        JSAMPROW row = (JSAMPROW)(pixels + (size_t)s->c.next_scanline * tw * 3);
+        jpeg_write_scanlines(&s->c, &row, 1);
+    }
+    jpeg_finish_compress(&s->c);
+
+    if (s->enc) {
+        *out = s->enc;
+        *out_len = s->enc_len;
+        s->enc = NULL;
+        if (info) *info = (st_jpeg_scale_info_t){ sw, sh, tw, th };
+        s->ok = true;
+    }
+
+done:
+    if (s->have_c) jpeg_destroy_compress(&s->c);
+    if (s->have_d) jpeg_destroy_decompress(&s->d);
+    free(s->enc);
+    free(s->rows);
+    free(s->resized);
+    free(s->acc);
+    bool ok = s->ok;
+    free(s);
+    return ok;
+}
@@ -0,0 +1,50 @@
+#ifndef ST_JPEG_SCALE_H
+#define ST_JPEG_SCALE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- JPEG DOWNSCALE ----------
+// Camera frames arrive at full resolution and the VLM resizes them to its
+// input size anyway, so sending them as-is only inflates the upload and
+// the prefill. This decodes with libjpeg-turbo's DCT scaling (1/2, 1/4,
+// 1/8 straight out of the decoder), box-filters the rest of the way so
+// the longest side is max_dim, and re-encodes at quality. Runs on any
+// thread; no EFL involved.
+
+typedef struct {
+    int src_w, src_h;
+    int out_w, out_h;
+} st_jpeg_scale_info_t;
+
+// On success *out is a malloc'd JPEG (caller frees). Returns false when the
+// input is not a decodable JPEG, already fits in max_dim, or would not
+// get smaller; the caller then sends the original bytes.
+bool st_jpeg_downscale(const uint8_t *jpg, size_t len, int max_dim, int quality,
+                       uint8_t **out, size_t *out_len, st_jpeg_scale_info_t *info);
+
+// Decodes to packed RGB of exactly out_w x out_h (aspect not kept, like
+// the model's own resize), using the same DCT reduction + box filter. On
+// success *rgb is malloc'd (caller frees). For in-process inference.
+bool st_jpeg_decode_rgb(const uint8_t *jpg, size_t len, int out_w, int out_h,
+                        uint8_t **rgb, st_jpeg_scale_info_t *info);
+
+// Crops the source rectangle x,y,w,h (source pixels, clamped to the
+// image), shrinks it so the longest side is at most max_dim (0: DCT
+// reduction only, never below the crop size) and re-encodes at quality.
+// Rows above and columns beside the rectangle are skipped in the decoder
+// rather than decoded (libjpeg-turbo). On success *out is malloc'd;
+// info->out_w/out_h is the encoded size.
+bool st_jpeg_crop(const uint8_t *jpg, size_t len, int x, int y, int w, int h, int max_dim,
+                  int quality, uint8_t **out, size_t *out_len, st_jpeg_scale_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+#include "st_json_path.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_DEPTH 32
+#define MAX_PATH 256
+
+typedef struct {
+    const char *p, *end;
+    char path[MAX_PATH];
+    size_t plen;
+    st_json_target_t *t;
+    size_t n;
+    size_t found;
+    bool error;
+} scan_t;
+
+static void skip_ws(scan_t *s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\n' || *s->p == '\r' || *s->p == '\t')) s->p++;
+}
+
+static bool done(const scan_t *s) { return s->error || s->found == s->n; }
+
+// true when some unfound target equals or lies under the current path
+static bool path_relevant(const scan_t *s) {
+    for (size_t i = 0; i < s->n; i++) {
+        if (s->t[i].found) continue;
+        const char *tp = s->t[i].path;
+        if (strncmp(tp, s->path, s->plen) != 0) continue;
+        char c = tp[s->plen];
+        if (s->plen == 0 || c == '\0' || c == '.' || c == '[') return true;
+    }
+    return false;
+}
+
+static st_json_target_t *path_target(const scan_t *s) {
+    for (size_t i = 0; i < s->n; i++)
+        if (!s->t[i].found && strlen(s->t[i].path) == s->plen &&
+            memcmp(s->t[i].path, s->path, s->plen) == 0)
+            return &s->t[i];
+    return NULL;
+}
+
+// Skips a string starting at the opening quote.
+static bool skip_string(scan_t *s) {
+    s->p++;
+    while (s->p < s->end) {
+        char c = *s->p++;
+        if (c == '\\') { if (s->p < s->end) s->p++; }
+        else if (c == '"') return true;
+    }
+    return false;
+}
+
+// Skips any value without tracking paths.
+static bool skip_value(scan_t *s) {
+    skip_ws(s);
+    if (s->p >= s->end) return false;
+    if (*s->p == '"') return skip_string(s);
+    if (*s->p == '{' || *s->p == '[') {
+        int depth = 0;
+        while (s->p < s->end) {
+            char c = *s->p;
+            if (c == '"') { if (!skip_string(s)) return false; continue; }
+            if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') { if (--depth == 0) { s->p++; return true; } }
+            s->p++;
+        }
+        return false;
+    }
+    while (s->p < s->end && *s->p != ',' && *s->p != '}' && *s->p != ']' &&
+           *s->p != ' ' && *s->p != '\n' && *s->p != '\r' && *s->p != '\t')
+        s->p++;
+    return true;
+}
+
+static size_t put_utf8(char *dst, uint32_t cp) {
+    if (cp < 0x80) { dst[0] = (char)cp; return 1; }
+    if (cp < 0x800) { dst[0] = (char)(0xC0 | (cp >> 6)); dst[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) {
+        dst[0] = (char)(0xE0 | (cp >> 12));
+        dst[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        dst[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    dst[0] = (char)(0xF0 | (cp >> 18));
+    dst[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    dst[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    dst[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// The four hex digits after "\u" at s->p, or -1. Never reads past s->end.
+static long read_hex4(scan_t *s) {
+    if (s->end - s->p < 4) return -1;
+    long v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s->p[i];
+        int d = c >= '0' && c <= '9' ? c - '0'
+              : c >= 'a' && c <= 'f' ? c - 'a' + 10
+              : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return -1;
+        v = v << 4 | d;
+    }
+    s->p += 4;
+    return v;
+}
+
+// Copies (unescaped) the string at s->p into out, truncating to cap-1 on a
+// whole UTF-8 sequence. Surrogate pairs are combined; a lone surrogate
+// fails the string.
+static bool read_string(scan_t *s, char *out, size_t cap) {
+    size_t j = 0;
+    bool full = false;
+    s->p++;
+    while (s->p < s->end) {
+        char c = *s->p++;
+        if (c == '"') { if (out && cap) out[j] = '\0'; return true; }
+        char tmp[4];
+        size_t n = 1;
+        tmp[0] = c;
+        if (c == '\\' && s->p < s->end) {
+            char e = *s->p++;
+            switch (e) {
+            case 'n': tmp[0] = '\n'; break;
+            case 't': tmp[0] = '\t'; break;
+            case 'r': tmp[0] = '\r'; break;
+            case 'b': tmp[0] = '\b'; break;
+            case 'f': tmp[0] = '\f'; break;
+            case 'u': {
+                long cp = read_hex4(s);
+                if (cp < 0 || (cp >= 0xDC00 && cp <= 0xDFFF)) return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (s->end - s->p < 2 || s->p[0] != '\\' || s->p[1] != 'u') return false;
+                    s->p += 2;
+                    long lo = read_hex4(s);
+                    if (lo < 0xDC00 || lo > 0xDFFF) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                n = put_utf8(tmp, (uint32_t)cp);
+                break;
+            }
+            default: tmp[0] = e; break;     // \" \\ \/
+            }
+        }
+        // once a piece does not fit, nothing after it is written either
+        if (out && !full && j + n < cap) {
+            memcpy(out + j, tmp, n);
+            j += n;
+        } else {
+            full = true;
+        }
+    }
+    return false;
+}
+
+static bool scan_value(scan_t *s, int depth);
+
+static bool push_key(scan_t *s, const char *k, size_t klen, bool index) {
+    size_t need = klen + (s->plen && !index ? 1 : 0);
+    if (s->plen + need >= MAX_PATH) return false;
+    if (s->plen && !index) s->path[s->plen++] = '.';
+    memcpy(s->path + s->plen, k, klen);
+    s->plen += klen;
+    s->path[s->plen] = '\0';
+    return true;
+}
+
+static bool scan_object(scan_t *s, int depth) {
+    s->p++;     // '{'
+    skip_ws(s);
+    if (s->p < s->end && *s->p == '}') { s->p++; return true; }
+    const size_t base = s->plen;
+    while (s->p < s->end) {
+        skip_ws(s);
+        if (s->p >= s->end || *s->p != '"') return false;
+        const char *k = s->p + 1;
+        if (!skip_string(s)) return false;
+        size_t klen = (size_t)(s->p - 1 - k);
+        skip_ws(s);
+        if (s->p >= s->end || *s->p != ':') return false;
+        s->p++;
+
+        bool ok = push_key(s, k, klen, false)
+            ? (path_relevant(s) ? scan_value(s, depth + 1) : skip_value(s))
+            : skip_value(s);
+        s->plen = base;
+        s->path[base] = '\0';
+        if (!ok) return false;
+        if (done(s)) return true;
+
+        skip_ws(s);
+        if (s->p < s->end && *s->p == ',') { s->p++; continue; }
+        if (s->p < s->end && *s->p == '}') { s->p++; return true; }
+        return false;
+    }
+    return false;
+}
+
+static bool scan_array(scan_t *s, int depth) {
+    s->p++;     // '['
+    skip_ws(s);
+    if (s->p < s->end && *s->p == ']') { s->p++; return true; }
+    const size_t base = s->plen;
+    for (unsigned idx = 0; s->p < s->end; idx++) {
+        char k[16];
+        int klen = snprintf(k, sizeof(k), "[%u]", idx);
+        bool ok = push_key(s, k, (size_t)klen, true)
+            ? (path_relevant(s) ? scan_value(s, depth + 1) : skip_value(s))
+            : skip_value(s);
+        s->plen = base;
+        s->path[base] = '\0';
+        if (!ok) return false;
+        if (done(s)) return true;
+
+        skip_ws(s);
+        if (s->p < s->end && *s->p == ',') { s->p++; continue; }
+        if (s->p < s->end && *s->p == ']') { s->p++; return true; }
+        return false;
+    }
+    return false;
+}
+
+static bool scan_value(scan_t *s, int depth) {
+    skip_ws(s);
+    if (s->p >= s->end || depth > MAX_DEPTH) return false;
+
+    st_json_target_t *t = path_target(s);
+    char c = *s->p;
+    if (c == '{') return t ? skip_value(s) : scan_object(s, depth);
+    if (c == '[') return t ? skip_value(s) : scan_array(s, depth);
+    if (c == '"') {
+        if (!read_string(s, t ? t->out : NULL, t ? t->cap : 0)) return false;
+    } else {
+        const char *v = s->p;
+        if (!skip_value(s)) return false;
+        if (t && t->cap) {
+            size_t n = (size_t)(s->p - v);
+            if (n >= t->cap) n = t->cap - 1;
+            memcpy(t->out, v, n);
+            t->out[n] = '\0';
+        }
+    }
+    if (t) { t->found = true; s->found++; }
+    return true;
+}
+
+int st_json_extract(const char *json, size_t len, st_json_target_t *targets, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        targets[i].found = false;
+        if (targets[i].out && targets[i].cap) targets[i].out[0] = '\0';
+    }
+    if (!json) return -1;
+    scan_t s = { .p = json, .end = json + len, .t = targets, .n = n };
+    s.path[0] = '\0';
+    bool ok = scan_value(&s, 0);
+    if (!ok && s.found < n) return -1;
+    return (int)s.found;
+}
@@ -0,0 +1,40 @@
+#ifndef ST_JSON_PATH_H
+#define ST_JSON_PATH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- TARGETED JSON EXTRACTOR ----------
+// Pulls a handful of values out of a JSON document by dotted path in one
+// pass, without building a DOM. Subtrees that cannot contain any target are
+// skipped with a bracket/string-aware scan, and the scan stops as soon as
+// every target has been found. Array elements are addressed as "[n]".
+//
+//   st_json_target_t t[] = {
+//       { "components.main.imageCapture.image.value", url, sizeof(url) },
+//       { "components.main.imageCapture.image.timestamp", ts, sizeof(ts) },
+//   };
+//   st_json_extract(body, len, t, 2);
+//
+// Strings are unescaped into out; numbers/true/false/null are copied raw.
+
+typedef struct {
+    const char *path;
+    char *out;
+    size_t cap;
+    bool found;
+} st_json_target_t;
+
+// Returns the number of targets found; -1 on malformed input before all
+// targets were seen (targets found up to that point stay valid).
+int st_json_extract(const char *json, size_t len, st_json_target_t *targets, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
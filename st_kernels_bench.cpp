@@ -0,0 +1,435 @@
+// g++ -std=c++17 -O2 st_kernels_bench.cpp st_base64.c st_json_path.c -o st_kernels_bench -lbenchmark -lpthread
+//
+// Microbenchmarks for the byte-level helpers the apps grew several copies
+// of, next to the shared st_core replacements, over payload sizes seen on
+// the wire (credentials, token replies, device status, camera JPEGs):
+//
+//   BM_b64_*    encode_base64 (st_rest_v1.c byte loop, thing.c/yep.c
+//               group loop), the inline credential encoder of
+//               refresh_token_c, st_b64_encode and the st_b64 stream fed
+//               in curl-sized chunks
+//   BM_append_* write_cb growth: realloc per chunk (write_cb, st_http), the
+//               doubling dynbuf of 07_Tizen_inc_app.h, and a buffer
+//               reserved from Content-Length
+//   BM_json_*   strstr+sscanf scraping vs st_json_extract on token replies
+//               and status documents with the wanted key early or late
+//
+// The legacy kernels are copied here as they are in the apps (tails fixed
+// where the original wrote the wrong bytes), so the apps can move on
+// without losing the baseline.
+//
+// Usage: st_kernels_bench [--benchmark_filter=BM_b64] [--benchmark_repetitions=5]
+//                         [--benchmark_out=results/<rev>.json --benchmark_out_format=json]
+//
+// Keep one JSON per revision and diff two of them with Google Benchmark's
+// tools/compare.py (compare.py benchmarks old.json new.json). Build with
+// -DST_GIT_REV=\"<rev>\" to stamp the revision into the JSON context.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "st_base64.h"
+#include "st_json_path.h"
+
+static const char B64_TBL[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// ---------- LEGACY KERNELS ----------
+
+// st_rest_v1.c: collects three bytes at a time through a small array.
+static char *legacy_b64_bytewise(const unsigned char *data, size_t length, size_t *output_length) {
+    *output_length = 4 * ((length + 2) / 3);
+    char *result = (char *)malloc(*output_length + 1);
+    if (!result) return NULL;
+    int i = 0, j = 0;
+    unsigned char chunks[3];
+    for (size_t in_idx = 0; in_idx < length; in_idx++) {
+        chunks[i++] = data[in_idx];
+        if (i == 3) {
+            result[j++] = B64_TBL[(chunks[0] & 0xFC) >> 2];
+            result[j++] = B64_TBL[((chunks[0] & 0x03) << 4) | (chunks[1] & 0xF0) >> 4];
+            result[j++] = B64_TBL[((chunks[1] & 0x0F) << 2) | (chunks[2] & 0xC0) >> 6];
+            result[j++] = B64_TBL[chunks[2] & 0x3F];
+            i = 0;
+        }
+    }
+    if (i) {
+        for (int k = i; k < 3; k++) chunks[k] = '\0';
+        result[j++] = B64_TBL[(chunks[0] & 0xFC) >> 2];
+        result[j++] = B64_TBL[((chunks[0] & 0x03) << 4) | (chunks[1] & 0xF0) >> 4];
+        result[j++] = i == 2 ? B64_TBL[((chunks[1] & 0x0F) << 2)] : '=';
+        result[j++] = '=';
+    }
+    result[j] = '\0';
+    *output_length = j;
+    return result;
+}
+
+// thing.c / yep.c: one 24-bit group per iteration with per-byte bounds checks.
+static char *legacy_b64_group(const unsigned char *data, size_t len, size_t *outlen) {
+    char *out = (char *)malloc(4 * ((len + 2) / 3) + 1);
+    size_t i = 0, j = 0;
+    if (!out) return NULL;
+    while (i < len) {
+        size_t rem = len - i;   // the original tested i > len, which never holds, so it never padded
+        uint32_t a = i < len ? data[i++] : 0;
+        uint32_t b = i < len ? data[i++] : 0;
+        uint32_t c = i < len ? data[i++] : 0;
+        uint32_t t = (a << 16) | (b << 8) | c;
+        out[j++] = B64_TBL[(t >> 18) & 63];
+        out[j++] = B64_TBL[(t >> 12) & 63];
+        out[j++] = rem < 2 ? '=' : B64_TBL[(t >> 6) & 63];
+        out[j++] = rem < 3 ? '=' : B64_TBL[t & 63];
+    }
+    out[j] = '\0';
+    if (outlen) *outlen = j;
+    return out;
+}
+
+// refresh_token_c (Tizen_REST.c, TIZEN_REST_V2.c, f.c): bit accumulator over a C string.
+static char *legacy_b64_cred(const char *credentials) {
+    size_t out_len = ((strlen(credentials) + 2) / 3) * 4 + 4;
+    char *b64 = (char *)malloc(out_len);
+    if (!b64) return NULL;
+    int val = 0, valb = -6, i, j = 0;
+    for (i = 0; credentials[i]; i++) {
+        val = (val << 8) + credentials[i];
+        valb += 8;
+        while (valb >= 0) { b64[j++] = B64_TBL[(val >> valb) & 0x3F]; valb -= 6; }
+    }
+    while (valb > -6) { b64[j++] = B64_TBL[((val << 8) >> (valb + 8)) & 0x3F]; valb -= 6; }
+    while (j % 4) b64[j++] = '=';
+    b64[j] = '\0';
+    return b64;
+}
+
+typedef struct { char *buf; size_t len; } mem_t;
+
+// write_cb (Tizen_REST.c, st_rest_v1.c) and st_http's buf_write_cb: exact realloc per chunk.
+static size_t legacy_write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    mem_t *m = (mem_t *)userdata;
+    size_t n = size * nmemb;
+    char *p = (char *)realloc(m->buf, m->len + n + 1);
+    if (!p) return 0;
+    m->buf = p;
+    memcpy(m->buf + m->len, ptr, n);
+    m->len += n;
+    m->buf[m->len] = '\0';
+    return n;
+}
+
+typedef struct { char *data; size_t len, cap; } dynbuf;
+
+// curl_write_cb (07_Tizen_inc_app.h): doubling from 16 KiB.
+static size_t dynbuf_write_cb(char *ptr, size_t size, size_t nmemb, void *userdata) {
+    dynbuf *b = (dynbuf *)userdata;
+    size_t n = size * nmemb;
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 16 * 1024;
+        while (cap < b->len + n + 1) cap *= 2;
+        char *p = (char *)realloc(b->data, cap);
+        if (!p) return 0;
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, ptr, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return n;
+}
+
+// token_request (1.c, smartthings_v2.c, new_tizen_app.c).
+static bool legacy_scrape_token(const char *buf, char *access, char *refresh) {
+    const char *acc = strstr(buf, "\"access_token\"");
+    const char *ref = strstr(buf, "\"refresh_token\"");
+    if (acc) sscanf(acc, "\"access_token\"%*[^:]:\"%4095[^\"]\"", access);
+    if (ref) sscanf(ref, "\"refresh_token\"%*[^:]:\"%1023[^\"]\"", refresh);
+    return acc && ref;
+}
+
+// image URL out of a device status: capability, then the first "value" after it.
+static bool legacy_scrape_image(const char *buf, char *url, size_t cap) {
+    const char *p = strstr(buf, "\"imageCapture\"");
+    if (p) p = strstr(p, "\"image\"");
+    if (p) p = strstr(p, "\"value\"");
+    if (!p) return false;
+    p = strchr(p + 7, '"');
+    if (!p) return false;
+    const char *e = strchr(++p, '"');
+    if (!e || (size_t)(e - p) >= cap) return false;
+    memcpy(url, p, e - p);
+    url[e - p] = '\0';
+    return true;
+}
+
+// ---------- PAYLOADS ----------
+
+static std::vector<uint8_t> random_bytes(size_t n) {
+    std::vector<uint8_t> v(n);
+    std::mt19937 rng(42);
+    for (auto &b : v) b = (uint8_t)rng();
+    return v;
+}
+
+static const char CREDENTIALS[] =
+    "3c5a4a0e-7f1d-4b0a-9e1f-2a6c4b8d9e0f:9f8e7d6c-5b4a-3928-1706-f5e4d3c2b1a0";
+
+static std::string token_reply() {
+    std::string tok(1100, 'x');
+    for (size_t i = 0; i < tok.size(); ++i) tok[i] = B64_TBL[(i * 7) % 64];
+    return "{\"access_token\":\"" + tok +
+           "\",\"token_type\":\"bearer\",\"refresh_token\":\"6f2b9c1e-8d4a-4e3b-a1f7-0c9d2e5b8a64\","
+           "\"expires_in\":86399,\"scope\":\"r:devices:* w:devices:* x:devices:*\","
+           "\"access_tier\":0,\"installed_app_id\":\"b2f1c8e0-5a3d-4c7e-9f1b-6d2a8e4c0b37\"}";
+}
+
+// A camera status of about target bytes; image first (late=false) or after
+// the other capabilities (late=true), the worst case for a forward scan.
+static std::string device_status(size_t target, bool late) {
+    const std::string image =
+        "\"imageCapture\":{\"image\":{\"value\":\"https://cdn.example.com/v1/devices/cam/img-000123.jpg\","
+        "\"timestamp\":\"2026-10-14T08:15:42.120Z\"},\"captureTime\":{\"value\":\"2026-10-14T08:15:41.870Z\"}}";
+    std::string others;
+    for (int i = 0; others.size() < target; ++i) {
+        char cap[256];
+        snprintf(cap, sizeof(cap),
+                 "\"custom.capability%03d\":{\"state\":{\"value\":\"idle\",\"timestamp\":\"2026-10-14T08:00:%02d.000Z\"},"
+                 "\"level\":{\"value\":%d,\"unit\":\"%%\"}},", i, i % 60, i % 100);
+        others += cap;
+    }
+    std::string main = late ? others + image : image + "," + others.substr(0, others.size() - 1);
+    return "{\"components\":{\"main\":{" + main + "}}}";
+}
+
+// ---------- BASE64 ----------
+
+// Skips the benchmark if a legacy encoder disagrees with st_b64_encode.
+static bool b64_matches(benchmark::State &state, const std::vector<uint8_t> &in, const char *legacy) {
+    std::string want(st_b64_encoded_len(in.size()), '\0');
+    st_b64_encode(in.data(), in.size(), &want[0]);
+    if (want == legacy) return true;
+    state.SkipWithError("output differs from st_b64_encode");
+    return false;
+}
+
+static void BM_b64_bytewise(benchmark::State &state) {
+    auto in = random_bytes((size_t)state.range(0));
+    size_t n;
+    char *check = legacy_b64_bytewise(in.data(), in.size(), &n);
+    bool ok = b64_matches(state, in, check);
+    free(check);
+    if (!ok) return;
+    for (auto _ : state) {
+        char *out = legacy_b64_bytewise(in.data(), in.size(), &n);
+        benchmark::DoNotOptimize(out);
+        free(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)in.size());
+}
+
+static void BM_b64_group(benchmark::State &state) {
+    auto in = random_bytes((size_t)state.range(0));
+    size_t n;
+    char *check = legacy_b64_group(in.data(), in.size(), &n);
+    bool ok = b64_matches(state, in, check);
+    free(check);
+    if (!ok) return;
+    for (auto _ : state) {
+        char *out = legacy_b64_group(in.data(), in.size(), &n);
+        benchmark::DoNotOptimize(out);
+        free(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)in.size());
+}
+
+// malloc included, as the legacy versions pay it on every call too
+static void BM_b64_st(benchmark::State &state) {
+    auto in = random_bytes((size_t)state.range(0));
+    for (auto _ : state) {
+        char *out = (char *)malloc(st_b64_encoded_len(in.size()) + 1);
+        out[st_b64_encode(in.data(), in.size(), out)] = '\0';
+        benchmark::DoNotOptimize(out);
+        free(out);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)in.size());
+}
+
+static bool count_sink(const char *text, size_t len, void *ctx) {
+    benchmark::DoNotOptimize(text);
+    *(size_t *)ctx += len;
+    return true;
+}
+
+// fed in CURL_MAX_WRITE_SIZE pieces, as from a download write callback
+static void BM_b64_st_stream(benchmark::State &state) {
+    auto in = random_bytes((size_t)state.range(0));
+    st_b64_stream_t s;
+    for (auto _ : state) {
+        size_t total = 0;
+        st_b64_stream_init(&s, count_sink, &total);
+        for (size_t off = 0; off < in.size(); off += 16384)
+            st_b64_stream_update(&s, in.data() + off, std::min<size_t>(16384, in.size() - off));
+        st_b64_stream_final(&s);
+        benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)in.size());
+}
+
+static void BM_b64_cred_legacy(benchmark::State &state) {
+    for (auto _ : state) {
+        char *out = legacy_b64_cred(CREDENTIALS);
+        benchmark::DoNotOptimize(out);
+        free(out);
+    }
+}
+
+static void BM_b64_cred_st(benchmark::State &state) {
+    size_t n = sizeof(CREDENTIALS) - 1;
+    for (auto _ : state) {
+        char out[128];
+        out[st_b64_encode((const uint8_t *)CREDENTIALS, n, out)] = '\0';
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+// 48 B ~ credentials, 1 KiB, 64 KiB thumbnail, 256 KiB and 1 MiB camera frames
+#define B64_SIZES ->Arg(48)->Arg(1 << 10)->Arg(64 << 10)->Arg(256 << 10)->Arg(1 << 20)
+
+BENCHMARK(BM_b64_bytewise) B64_SIZES;
+BENCHMARK(BM_b64_group) B64_SIZES;
+BENCHMARK(BM_b64_st) B64_SIZES;
+BENCHMARK(BM_b64_st_stream) B64_SIZES;
+BENCHMARK(BM_b64_cred_legacy);
+BENCHMARK(BM_b64_cred_st);
+
+// ---------- RESPONSE APPEND ----------
+// range(0) is the body size, delivered in 16 KiB writes (curl's usual
+// chunk; small bodies arrive in one).
+
+static void BM_append_realloc(benchmark::State &state) {
+    auto body = random_bytes((size_t)state.range(0));
+    for (auto _ : state) {
+        mem_t m = {NULL, 0};
+        for (size_t off = 0; off < body.size(); off += 16384)
+            legacy_write_cb(body.data() + off, 1, std::min<size_t>(16384, body.size() - off), &m);
+        benchmark::DoNotOptimize(m.buf);
+        free(m.buf);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)body.size());
+}
+
+static void BM_append_doubling(benchmark::State &state) {
+    auto body = random_bytes((size_t)state.range(0));
+    for (auto _ : state) {
+        dynbuf b = {NULL, 0, 0};
+        for (size_t off = 0; off < body.size(); off += 16384)
+            dynbuf_write_cb((char *)body.data() + off, 1, std::min<size_t>(16384, body.size() - off), &b);
+        benchmark::DoNotOptimize(b.data);
+        free(b.data);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)body.size());
+}
+
+static void BM_append_reserved(benchmark::State &state) {
+    auto body = random_bytes((size_t)state.range(0));
+    for (auto _ : state) {
+        dynbuf b = {(char *)malloc(body.size() + 1), 0, body.size() + 1};
+        for (size_t off = 0; off < body.size(); off += 16384)
+            dynbuf_write_cb((char *)body.data() + off, 1, std::min<size_t>(16384, body.size() - off), &b);
+        benchmark::DoNotOptimize(b.data);
+        free(b.data);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)body.size());
+}
+
+// 2 KiB token reply, 8 KiB status, 128 KiB device list, 1 MiB image
+#define APPEND_SIZES ->Arg(2 << 10)->Arg(8 << 10)->Arg(128 << 10)->Arg(1 << 20)
+
+BENCHMARK(BM_append_realloc) APPEND_SIZES;
+BENCHMARK(BM_append_doubling) APPEND_SIZES;
+BENCHMARK(BM_append_reserved) APPEND_SIZES;
+
+// ---------- JSON SCRAPING ----------
+
+static void BM_json_token_strstr(benchmark::State &state) {
+    std::string body = token_reply();
+    static char access[4096], refresh[1024];
+    for (auto _ : state) {
+        bool ok = legacy_scrape_token(body.c_str(), access, refresh);
+        benchmark::DoNotOptimize(ok);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)body.size());
+}
+
+static void BM_json_token_extract(benchmark::State &state) {
+    std::string body = token_reply();
+    static char access[4096], refresh[1024];
+    for (auto _ : state) {
+        st_json_target_t t[] = {
+            { "access_token", access, sizeof(access), false },
+            { "refresh_token", refresh, sizeof(refresh), false },
+        };
+        int n = st_json_extract(body.data(), body.size(), t, 2);
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)body.size());
+}
+
+// Both scrapers stop once they have what they need, so bytes/s counts the
+// body up to the end of the last string value each one reads (key is
+// searched from the image block), not the whole document.
+static size_t status_scanned(const std::string &body, const char *key) {
+    size_t p = body.find(key, body.find("\"imageCapture\""));
+    p = body.find('"', p + strlen(key));        // opening quote of the value
+    return body.find('"', p + 1) + 1;
+}
+
+// range(0): document size; range(1): 1 when the image comes last
+static void BM_json_status_strstr(benchmark::State &state) {
+    std::string body = device_status((size_t)state.range(0), state.range(1) != 0);
+    char url[512];
+    for (auto _ : state) {
+        bool ok = legacy_scrape_image(body.c_str(), url, sizeof(url));
+        benchmark::DoNotOptimize(ok);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)status_scanned(body, "\"value\""));
+}
+
+static void BM_json_status_extract(benchmark::State &state) {
+    std::string body = device_status((size_t)state.range(0), state.range(1) != 0);
+    char url[512], ts[64];
+    for (auto _ : state) {
+        st_json_target_t t[] = {
+            { "components.main.imageCapture.image.value", url, sizeof(url), false },
+            { "components.main.imageCapture.image.timestamp", ts, sizeof(ts), false },
+        };
+        int n = st_json_extract(body.data(), body.size(), t, 2);
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)status_scanned(body, "\"timestamp\""));
+}
+
+#define STATUS_SIZES ->ArgsProduct({{1 << 10, 8 << 10, 64 << 10}, {0, 1}})
+
+BENCHMARK(BM_json_token_strstr);
+BENCHMARK(BM_json_token_extract);
+BENCHMARK(BM_json_status_strstr) STATUS_SIZES;
+BENCHMARK(BM_json_status_extract) STATUS_SIZES;
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+#ifdef ST_GIT_REV
+    benchmark::AddCustomContext("st_git_rev", ST_GIT_REV);
+#endif
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "st_log.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define LOG_TAG "ST_LOG"
+
+typedef struct log_node {
+    _Atomic(struct log_node *) next;
+    st_log_level_e level;
+    struct timeval when;
+    char msg[];
+} log_node_t;
+
+// ---------- MPSC QUEUE ----------
+// Intrusive Vyukov queue: producers swap themselves into head, the single
+// consumer walks from tail. A stub node keeps it non-empty.
+static log_node_t g_stub;
+static _Atomic(log_node_t *) g_head = &g_stub;
+static log_node_t *g_tail = &g_stub;
+
+static void q_push(log_node_t *n) {
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    log_node_t *prev = atomic_exchange_explicit(&g_head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+}
+
+// NULL when empty, or when a producer is between its two steps.
+static log_node_t *q_pop(void) {
+    log_node_t *tail = g_tail;
+    log_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &g_stub) {
+        if (!next) return NULL;
+        g_tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) { g_tail = next; return tail; }
+    if (tail != atomic_load_explicit(&g_head, memory_order_acquire)) return NULL;
+    q_push(&g_stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) { g_tail = next; return tail; }
+    return NULL;
+}
+
+// ---------- STATE ----------
+static pthread_t g_writer;
+static atomic_bool g_running = false;
+static atomic_bool g_stop = false;
+static atomic_int g_min_level = ST_LOG_INFO;
+static atomic_uint_fast64_t g_queued = 0;       // messages pushed
+static atomic_uint_fast64_t g_written = 0;      // messages handled by the writer
+static atomic_int g_idle = 1;                   // writer waits for a post
+static sem_t g_wake;
+static pthread_mutex_t g_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_flush_cond = PTHREAD_COND_INITIALIZER;
+
+static char g_path[512];
+static long g_max_bytes;
+static int g_keep;
+static FILE *g_fp;
+
+static const char *level_name(st_log_level_e l) {
+    switch (l) {
+    case ST_LOG_DEBUG: return "DEBUG";
+    case ST_LOG_INFO:  return "INFO";
+    case ST_LOG_WARN:  return "WARN";
+    default:           return "ERROR";
+    }
+}
+
+static log_priority dlog_level(st_log_level_e l) {
+    switch (l) {
+    case ST_LOG_DEBUG: return DLOG_DEBUG;
+    case ST_LOG_INFO:  return DLOG_INFO;
+    case ST_LOG_WARN:  return DLOG_WARN;
+    default:           return DLOG_ERROR;
+    }
+}
+
+// ---------- WRITER ----------
+static void rotate(void) {
+    if (g_fp) { fclose(g_fp); g_fp = NULL; }
+    char from[600], to[600];
+    for (int i = g_keep; i >= 1; i--) {
+        if (i == 1) snprintf(from, sizeof(from), "%s", g_path);
+        else snprintf(from, sizeof(from), "%s.%d", g_path, i - 1);
+        snprintf(to, sizeof(to), "%s.%d", g_path, i);
+        rename(from, to);
+    }
+    if (g_keep <= 0) remove(g_path);
+}
+
+static void write_node(const log_node_t *n) {
+    if (!g_fp) {
+        g_fp = fopen(g_path, "a");
+        if (!g_fp) return;
+    }
+    struct tm tm;
+    time_t sec = n->when.tv_sec;
+    localtime_r(&sec, &tm);
+    char ts[32];
+    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(g_fp, "[%s.%03ld] %-5s %s\n", ts, (long)(n->when.tv_usec / 1000), level_name(n->level), n->msg);
+    if (g_max_bytes > 0 && ftell(g_fp) >= g_max_bytes) rotate();
+}
+
+static int drain(void) {
+    int n = 0;
+    log_node_t *node;
+    while ((node = q_pop()) != NULL) {
+        write_node(node);
+        free(node);
+        n++;
+    }
+    if (n && g_fp) fflush(g_fp);
+    return n;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        atomic_store(&g_idle, 1);
+        if (atomic_load(&g_queued) == atomic_load(&g_written)) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += (long)ST_LOG_BATCH_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+            sem_timedwait(&g_wake, &until);
+        }
+        atomic_store(&g_idle, 0);
+
+        int n = drain();
+        if (n) {
+            atomic_fetch_add(&g_written, (uint_fast64_t)n);
+            pthread_mutex_lock(&g_flush_lock);
+            pthread_cond_broadcast(&g_flush_cond);
+            pthread_mutex_unlock(&g_flush_lock);
+        }
+        if (atomic_load(&g_stop) && atomic_load(&g_queued) == atomic_load(&g_written)) break;
+    }
+    if (g_fp) { fclose(g_fp); g_fp = NULL; }
+    return NULL;
+}
+
+// ---------- API ----------
+bool st_log_open(const char *path, long max_bytes, int keep) {
+    if (atomic_load(&g_running) || !path) return atomic_load(&g_running);
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    g_max_bytes = max_bytes > 0 ? max_bytes : ST_LOG_DEFAULT_MAX_BYTES;
+    g_keep = keep;
+    sem_init(&g_wake, 0, 0);
+    atomic_store(&g_stop, false);
+    if (pthread_create(&g_writer, NULL, writer_main, NULL) != 0) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start log writer");
+        sem_destroy(&g_wake);
+        return false;
+    }
+    atomic_store(&g_running, true);
+    return true;
+}
+
+void st_log_close(void) {
+    if (!atomic_exchange(&g_running, false)) return;
+    atomic_store(&g_stop, true);
+    sem_post(&g_wake);
+    pthread_join(g_writer, NULL);
+    sem_destroy(&g_wake);
+}
+
+void st_log_set_level(st_log_level_e level) {
+    atomic_store(&g_min_level, (int)level);
+}
+
+void st_log(st_log_level_e level, const char *fmt, ...) {
+    char stackbuf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(stackbuf, sizeof(stackbuf), fmt, ap);
+    va_end(ap);
+    if (len < 0) return;
+    dlog_print(dlog_level(level), LOG_TAG, "%s", stackbuf);
+    if ((int)level < atomic_load(&g_min_level) || !atomic_load(&g_running)) return;
+
+    log_node_t *n = malloc(sizeof(*n) + (size_t)len + 1);
+    if (!n) return;
+    n->level = level;
+    gettimeofday(&n->when, NULL);
+    if ((size_t)len < sizeof(stackbuf)) {
+        memcpy(n->msg, stackbuf, (size_t)len + 1);
+    } else {
+        va_start(ap, fmt);
+        vsnprintf(n->msg, (size_t)len + 1, fmt, ap);
+        va_end(ap);
+    }
+    q_push(n);
+    atomic_fetch_add(&g_queued, 1);
+    // errors go out right away; everything else waits for the next batch
+    if (level >= ST_LOG_ERROR && atomic_load(&g_idle)) sem_post(&g_wake);
+}
+
+void st_log_flush(void) {
+    if (!atomic_load(&g_running)) return;
+    uint_fast64_t target = atomic_load(&g_queued);
+    sem_post(&g_wake);
+    pthread_mutex_lock(&g_flush_lock);
+    while (atomic_load(&g_written) < target && atomic_load(&g_running))
+        pthread_cond_wait(&g_flush_cond, &g_flush_lock);
+    pthread_mutex_unlock(&g_flush_lock);
+}
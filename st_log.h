@@ -0,0 +1,48 @@
+#ifndef ST_LOG_H
+#define ST_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- ASYNC FILE LOGGER ----------
+// log_event used to fopen/fprintf/fclose the log file and call ctime() for
+// every line. Here callers only format the message and push it onto a
+// lock-free MPSC queue; one writer thread keeps the file open, writes
+// whatever has queued up in one batch, flushes once per batch and rotates
+// the file by size (log -> log.1 -> ... -> log.<keep>). Messages are also
+// mirrored to dlog.
+//
+// st_log() is safe from any thread and never blocks on I/O.
+
+typedef enum {
+    ST_LOG_DEBUG,
+    ST_LOG_INFO,
+    ST_LOG_WARN,
+    ST_LOG_ERROR,
+} st_log_level_e;
+
+#define ST_LOG_DEFAULT_MAX_BYTES (512 * 1024)
+#define ST_LOG_BATCH_MS 500             // writer wakes at least this often
+
+// max_bytes <= 0 -> default; keep = rotated files to retain.
+bool st_log_open(const char *path, long max_bytes, int keep);
+// Drains the queue, stops the writer and closes the file.
+void st_log_close(void);
+
+// Lines below level go to dlog only.
+void st_log_set_level(st_log_level_e level);
+
+void st_log(st_log_level_e level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Blocks until everything logged so far is written (e.g. before exit).
+void st_log_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
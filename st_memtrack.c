@@ -0,0 +1,359 @@
+#define _GNU_SOURCE             // dladdr
+#include "st_memtrack.h"
+
+#include "st_metrics.h"
+
+#include <dlfcn.h>
+#include <dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_MEMTRACK"
+
+#ifndef ST_MEMTRACK
+#define ST_MEMTRACK 0
+#endif
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ---------- ALLOCATION TRACKING ----------
+typedef struct {
+    const void *addr;               // return address of the allocating call, NULL: "other"
+    unsigned long allocs, frees;
+    size_t live_bytes, live_blocks, peak_bytes;
+} site_t;
+
+#if ST_MEMTRACK
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t count, size_t n);
+void *__real_realloc(void *p, size_t n);
+void __real_free(void *p);
+
+#define SITE_SLOTS (ST_MEMTRACK_MAX_SITES * 2)
+#define TOMBSTONE ((void *)1)
+
+typedef struct {
+    void *ptr;                      // NULL: empty, TOMBSTONE: removed
+    size_t size;
+    uint32_t site;
+} block_t;
+
+// sites[0] pools the overflow; g_site_slot maps an address hash to sites[] + 1
+static site_t g_sites[ST_MEMTRACK_MAX_SITES];
+static uint16_t g_site_slot[SITE_SLOTS];
+static size_t g_site_count = 1;
+static block_t *g_blocks;
+static size_t g_block_cap, g_block_used, g_block_dead;  // used counts live + dead slots
+static size_t g_live_bytes, g_live_blocks, g_peak_bytes;
+static unsigned long g_allocs, g_frees;
+
+static size_t ptr_hash(const void *p) {
+    uint64_t h = (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 17);
+}
+
+static uint32_t site_of(const void *addr) {
+    size_t i = ptr_hash(addr) % SITE_SLOTS;
+    for (;; i = (i + 1) % SITE_SLOTS) {
+        uint16_t s = g_site_slot[i];
+        if (!s) break;
+        if (g_sites[s].addr == addr) return s;
+    }
+    if (g_site_count >= ST_MEMTRACK_MAX_SITES) return 0;
+    uint32_t s = (uint32_t)g_site_count++;
+    g_sites[s].addr = addr;
+    g_site_slot[i] = (uint16_t)s;
+    return s;
+}
+
+static block_t *block_find(const void *p) {
+    if (!g_block_cap) return NULL;
+    for (size_t i = ptr_hash(p) & (g_block_cap - 1);; i = (i + 1) & (g_block_cap - 1)) {
+        if (!g_blocks[i].ptr) return NULL;
+        if (g_blocks[i].ptr == p) return &g_blocks[i];
+    }
+}
+
+// True when it took a dead slot.
+static bool block_put(block_t *tab, size_t cap, const block_t *b) {
+    size_t i = ptr_hash(b->ptr) & (cap - 1);
+    while (tab[i].ptr && tab[i].ptr != TOMBSTONE) i = (i + 1) & (cap - 1);
+    bool dead = tab[i].ptr == TOMBSTONE;
+    tab[i] = *b;
+    return dead;
+}
+
+// Rehashes at half load (dead slots included) to at most a quarter live;
+// false when out of memory.
+static bool blocks_reserve(void) {
+    if ((g_block_used + 1) * 2 <= g_block_cap) return true;
+    size_t live = g_block_used - g_block_dead;
+    size_t cap = g_block_cap ? g_block_cap : 4096;
+    while ((live + 1) * 4 > cap) cap *= 2;
+    block_t *tab = __real_calloc(cap, sizeof(*tab));
+    if (!tab) return false;
+    for (size_t i = 0; i < g_block_cap; i++)
+        if (g_blocks[i].ptr && g_blocks[i].ptr != TOMBSTONE) block_put(tab, cap, &g_blocks[i]);
+    __real_free(g_blocks);
+    g_blocks = tab;
+    g_block_cap = cap;
+    g_block_used = live;
+    g_block_dead = 0;
+    return true;
+}
+
+static void untrack_locked(void *p) {
+    block_t *b = block_find(p);
+    if (!b) return;                 // not ours (a library's block)
+    site_t *s = &g_sites[b->site];
+    s->frees++;
+    s->live_bytes -= b->size;
+    s->live_blocks--;
+    g_live_bytes -= b->size;
+    g_live_blocks--;
+    g_frees++;
+    b->ptr = TOMBSTONE;
+    g_block_dead++;
+}
+
+static void track_locked(void *p, size_t n, const void *addr) {
+    // a block a library freed for us, its address now reused
+    untrack_locked(p);
+    if (!blocks_reserve()) return;
+    uint32_t si = site_of(addr);
+    block_t b = { p, n, si };
+    if (block_put(g_blocks, g_block_cap, &b)) g_block_dead--;
+    else g_block_used++;
+    site_t *s = &g_sites[si];
+    s->allocs++;
+    s->live_bytes += n;
+    s->live_blocks++;
+    if (s->live_bytes > s->peak_bytes) s->peak_bytes = s->live_bytes;
+    g_live_bytes += n;
+    g_live_blocks++;
+    if (g_live_bytes > g_peak_bytes) g_peak_bytes = g_live_bytes;
+    g_allocs++;
+}
+
+static void *track(void *p, size_t n, const void *addr) {
+    if (!p) return NULL;
+    pthread_mutex_lock(&g_lock);
+    track_locked(p, n, addr);
+    pthread_mutex_unlock(&g_lock);
+    return p;
+}
+
+#define CALLER __builtin_extract_return_addr(__builtin_return_address(0))
+
+__attribute__((noinline)) void *__wrap_malloc(size_t n) {
+    return track(__real_malloc(n), n, CALLER);
+}
+
+__attribute__((noinline)) void *__wrap_calloc(size_t count, size_t n) {
+    return track(__real_calloc(count, n), count * n, CALLER);
+}
+
+__attribute__((noinline)) char *__wrap_strdup(const char *s) {
+    size_t n = strlen(s) + 1;
+    char *p = track(__real_malloc(n), n, CALLER);
+    if (p) memcpy(p, s, n);
+    return p;
+}
+
+// Under the lock across the real call: the old address must not be handed
+// out (and tracked) again before its entry is gone.
+__attribute__((noinline)) void *__wrap_realloc(void *p, size_t n) {
+    if (!p) return track(__real_realloc(NULL, n), n, CALLER);
+    pthread_mutex_lock(&g_lock);
+    void *q = __real_realloc(p, n);
+    if (q || !n) {
+        untrack_locked(p);
+        if (q) track_locked(q, n, CALLER);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return q;
+}
+
+__attribute__((noinline)) void __wrap_free(void *p) {
+    if (!p) return;
+    pthread_mutex_lock(&g_lock);
+    untrack_locked(p);
+    pthread_mutex_unlock(&g_lock);
+    __real_free(p);
+}
+
+// Copies the sites holding memory, largest first.
+static size_t sites_live(site_t *out, size_t max) {
+    pthread_mutex_lock(&g_lock);
+    size_t n = 0;
+    for (size_t i = 0; i < g_site_count && n < max; i++)
+        if (g_sites[i].live_blocks) out[n++] = g_sites[i];
+    pthread_mutex_unlock(&g_lock);
+    for (size_t i = 1; i < n; i++) {
+        site_t s = out[i];
+        size_t j = i;
+        for (; j > 0 && out[j - 1].live_bytes < s.live_bytes; j--) out[j] = out[j - 1];
+        out[j] = s;
+    }
+    return n;
+}
+
+#else
+
+static size_t sites_live(site_t *out, size_t max) {
+    (void)out; (void)max;
+    return 0;
+}
+
+#endif
+
+bool st_memtrack_enabled(void) {
+    return ST_MEMTRACK;
+}
+
+// ---------- RSS ----------
+static double g_rss_at[ST_MEMTRACK_WINDOW];     // sample times, ring
+static size_t g_rss_ring[ST_MEMTRACK_WINDOW];
+static size_t g_rss_n, g_rss_next;
+static double g_started = -1, g_sampled_at, g_reported_at;
+static size_t g_rss_last, g_rss_baseline, g_rss_peak;
+
+size_t st_memtrack_rss_bytes(void) {
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp) return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    return n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+// Least-squares slope of the window, bytes per hour.
+static double rss_growth_locked(void) {
+    if (g_rss_n < 2) return 0;
+    double mt = 0, mr = 0;
+    for (size_t i = 0; i < g_rss_n; i++) {
+        mt += g_rss_at[i];
+        mr += (double)g_rss_ring[i];
+    }
+    mt /= g_rss_n;
+    mr /= g_rss_n;
+    double num = 0, den = 0;
+    for (size_t i = 0; i < g_rss_n; i++) {
+        double dt = g_rss_at[i] - mt;
+        num += dt * ((double)g_rss_ring[i] - mr);
+        den += dt * dt;
+    }
+    return den > 0 ? num / den * 3600.0 : 0;
+}
+
+void st_memtrack_stats(st_memtrack_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->tracking = ST_MEMTRACK;
+    pthread_mutex_lock(&g_lock);
+#if ST_MEMTRACK
+    out->heap_live_bytes = g_live_bytes;
+    out->heap_live_blocks = g_live_blocks;
+    out->heap_peak_bytes = g_peak_bytes;
+    out->allocs = g_allocs;
+    out->frees = g_frees;
+    out->sites = g_site_count - 1;
+#endif
+    out->rss_bytes = g_rss_last;
+    out->rss_baseline_bytes = g_rss_baseline;
+    out->rss_peak_bytes = g_rss_peak;
+    out->rss_growth_per_hour = rss_growth_locked();
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_memtrack_tick(double now) {
+    pthread_mutex_lock(&g_lock);
+    if (g_started < 0) g_started = g_reported_at = now;
+    else if (now - g_sampled_at < ST_MEMTRACK_SAMPLE_SEC) { pthread_mutex_unlock(&g_lock); return; }
+    g_sampled_at = now;
+    pthread_mutex_unlock(&g_lock);
+
+    size_t rss = st_memtrack_rss_bytes();   // file read outside the lock
+    if (!rss) return;
+
+    pthread_mutex_lock(&g_lock);
+    g_rss_last = rss;
+    if (rss > g_rss_peak) g_rss_peak = rss;
+    bool warm = now - g_started >= ST_MEMTRACK_WARMUP_SEC;
+    if (warm && !g_rss_baseline) g_rss_baseline = rss;
+    // the fit only covers steady state
+    if (warm) {
+        g_rss_at[g_rss_next] = now;
+        g_rss_ring[g_rss_next] = rss;
+        g_rss_next = (g_rss_next + 1) % ST_MEMTRACK_WINDOW;
+        if (g_rss_n < ST_MEMTRACK_WINDOW) g_rss_n++;
+    }
+    bool report = now - g_reported_at >= ST_MEMTRACK_REPORT_SEC;
+    if (report) g_reported_at = now;
+    pthread_mutex_unlock(&g_lock);
+
+    st_memtrack_stats_t st;
+    st_memtrack_stats(&st);
+    st_metric_set(st_metrics_gauge("st_process_rss_bytes", NULL), (int64_t)st.rss_bytes);
+    st_metric_set(st_metrics_gauge("st_process_rss_growth_bytes_per_hour", NULL), (int64_t)st.rss_growth_per_hour);
+    if (st.tracking) st_metric_set(st_metrics_gauge("st_heap_tracked_bytes", NULL), (int64_t)st.heap_live_bytes);
+    if (!report) return;
+    if (!st.rss_baseline_bytes) {
+        dlog_print(DLOG_INFO, LOG_TAG, "rss %.1f MB (warming up)", st.rss_bytes / 1048576.0);
+        return;
+    }
+    dlog_print(DLOG_INFO, LOG_TAG, "rss %.1f MB, baseline %.1f MB, peak %.1f MB, %+.2f MB/h over %zu min%s",
+               st.rss_bytes / 1048576.0, st.rss_baseline_bytes / 1048576.0, st.rss_peak_bytes / 1048576.0,
+               st.rss_growth_per_hour / 1048576.0, g_rss_n, st.tracking ? "" : " (heap not tracked)");
+    if (st.tracking)
+        dlog_print(DLOG_INFO, LOG_TAG, "heap %.1f MB in %zu block(s), peak %.1f MB",
+                   st.heap_live_bytes / 1048576.0, st.heap_live_blocks, st.heap_peak_bytes / 1048576.0);
+}
+
+// ---------- REPORT ----------
+static void site_name(const void *addr, char *buf, size_t len) {
+    Dl_info info;
+    if (!addr) { snprintf(buf, len, "(other sites)"); return; }
+    if (!dladdr(addr, &info) || !info.dli_fname) { snprintf(buf, len, "%p", addr); return; }
+    const char *mod = strrchr(info.dli_fname, '/');
+    mod = mod ? mod + 1 : info.dli_fname;
+    int n = snprintf(buf, len, "%s+0x%lx", mod,
+                     (unsigned long)((const char *)addr - (const char *)info.dli_fbase));
+    if (info.dli_sname && n > 0 && (size_t)n < len) snprintf(buf + n, len - n, " (%s)", info.dli_sname);
+}
+
+size_t st_memtrack_report(const char *path, size_t max_sites) {
+    static site_t sites[ST_MEMTRACK_MAX_SITES];     // the report is rare; keep it off the stack
+    static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&report_lock);
+    size_t n = sites_live(sites, ST_MEMTRACK_MAX_SITES);
+    st_memtrack_stats_t st;
+    st_memtrack_stats(&st);
+    FILE *fp = path ? fopen(path, "w") : NULL;
+    char line[384];
+
+    if (!st.tracking) {
+        snprintf(line, sizeof(line), "allocation tracking off (build with ST_MEMTRACK), rss %zu B", st.rss_bytes);
+    } else {
+        snprintf(line, sizeof(line), "%zu B in %zu block(s) from %zu site(s) live, peak %zu B, %lu allocs, %lu frees",
+                 st.heap_live_bytes, st.heap_live_blocks, n, st.heap_peak_bytes, st.allocs, st.frees);
+    }
+    dlog_print(DLOG_INFO, LOG_TAG, "%s", line);
+    if (fp) fprintf(fp, "%s\n", line);
+
+    for (size_t i = 0; i < n && (!max_sites || i < max_sites); i++) {
+        char name[256];
+        site_name(sites[i].addr, name, sizeof(name));
+        snprintf(line, sizeof(line), "%10zu B %6zu blk  peak %10zu B  %lu/%lu alloc/free  %s",
+                 sites[i].live_bytes, sites[i].live_blocks, sites[i].peak_bytes,
+                 sites[i].allocs, sites[i].frees, name);
+        dlog_print(DLOG_WARN, LOG_TAG, "%s", line);
+        if (fp) fprintf(fp, "%s\n", line);
+    }
+    if (fp) fclose(fp);
+    pthread_mutex_unlock(&report_lock);
+    return n;
+}
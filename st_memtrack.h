@@ -0,0 +1,72 @@
+#ifndef ST_MEMTRACK_H
+#define ST_MEMTRACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- MEMORY TRACKING ----------
+// Keeps multi-day live sessions measurable against the TV's memory budget.
+//
+// Allocation tracking (debug builds, cmake -DST_MEMTRACK=ON): the link
+// wraps malloc, calloc, realloc, free and strdup (ld --wrap) for the app
+// and st_core objects, while shared libraries keep the real allocator.
+// Every block is charged to its call site (the caller's return address).
+// A site counts allocations and frees, its live bytes and their high-water
+// mark. st_memtrack_report() lists sites still holding memory, largest
+// first, as module offsets for addr2line -e <binary>. Blocks a library
+// allocates and we free pass through untracked; blocks a library frees for
+// us stay charged (and show up as leaks). Without ST_MEMTRACK the report
+// is empty and the heap counters stay 0.
+//
+// RSS reporter (every build): st_memtrack_tick() reads the resident set
+// from /proc/self/statm once per ST_MEMTRACK_SAMPLE_SEC. After
+// ST_MEMTRACK_WARMUP_SEC (pools, caches and sessions filled) the first
+// sample becomes the baseline. The growth rate is fitted over the last
+// ST_MEMTRACK_WINDOW samples, and every ST_MEMTRACK_REPORT_SEC a line goes
+// to dlog. The same values feed the metrics gauges st_process_rss_bytes,
+// st_process_rss_growth_bytes_per_hour and st_heap_tracked_bytes.
+// Thread-safe.
+
+#define ST_MEMTRACK_MAX_SITES 1024      // further sites are pooled as "other"
+#define ST_MEMTRACK_SAMPLE_SEC 60.0
+#define ST_MEMTRACK_WARMUP_SEC 600.0
+#define ST_MEMTRACK_WINDOW 60           // samples in the growth fit (one hour)
+#define ST_MEMTRACK_REPORT_SEC 900.0
+
+typedef struct {
+    bool tracking;                  // built with ST_MEMTRACK
+    size_t heap_live_bytes;         // tracked blocks not yet freed
+    size_t heap_live_blocks;
+    size_t heap_peak_bytes;
+    unsigned long allocs, frees;
+    size_t sites;                   // distinct call sites seen
+    size_t rss_bytes;               // last sample, 0 before the first
+    size_t rss_baseline_bytes;      // 0 until the warm-up is over
+    size_t rss_peak_bytes;
+    double rss_growth_per_hour;     // bytes/h over the window, 0 with < 2 samples
+} st_memtrack_stats_t;
+
+bool st_memtrack_enabled(void);
+void st_memtrack_stats(st_memtrack_stats_t *out);
+
+// Logs the sites holding memory now, at most max_sites of them (0: all),
+// plus the totals. path non-NULL also writes the report there. Returns the
+// number of sites with live blocks.
+size_t st_memtrack_report(const char *path, size_t max_sites);
+
+// Resident set of this process in bytes (0 when /proc is unreadable).
+size_t st_memtrack_rss_bytes(void);
+// Call periodically (e.g. once per scheduler tick); now is any monotonic
+// time in seconds. Samples and reports at the rates above.
+void st_memtrack_tick(double now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
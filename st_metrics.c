@@ -0,0 +1,313 @@
+#include "st_metrics.h"
+
+#include <arpa/inet.h>
+#include <dlog.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_METRICS"
+#define FORMAT_BUF (64 * 1024)
+
+typedef enum { KIND_COUNTER, KIND_GAUGE, KIND_HISTOGRAM } kind_e;
+
+static const double k_bounds[] = { ST_METRICS_BUCKETS_MS };
+#define NBOUNDS (sizeof(k_bounds) / sizeof(k_bounds[0]))
+
+struct st_metric {
+    const char *name;
+    char labels[ST_METRICS_MAX_LABELS];
+    kind_e kind;
+    atomic_uint_fast64_t value;         // counter total, or gauge bits (int64)
+    atomic_uint_fast64_t buckets[NBOUNDS + 1];  // per bucket, last one +Inf
+    atomic_uint_fast64_t sum_us;
+};
+
+static struct st_metric g_series[ST_METRICS_MAX_SERIES];
+static atomic_size_t g_nseries;         // published entries; g_series[0..n) are immutable except values
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_full_logged = false;
+
+static st_metric_t *find(const char *name, const char *labels, kind_e kind, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        st_metric_t *m = &g_series[i];
+        if (m->kind == kind && strcmp(m->name, name) == 0 && strcmp(m->labels, labels) == 0) return m;
+    }
+    return NULL;
+}
+
+static st_metric_t *lookup(const char *name, const char *labels, kind_e kind) {
+    if (!name) return NULL;
+    if (!labels) labels = "";
+    st_metric_t *m = find(name, labels, kind, atomic_load_explicit(&g_nseries, memory_order_acquire));
+    if (m) return m;
+
+    pthread_mutex_lock(&g_lock);
+    size_t n = atomic_load_explicit(&g_nseries, memory_order_relaxed);
+    m = find(name, labels, kind, n);
+    if (!m && n < ST_METRICS_MAX_SERIES && strlen(labels) < ST_METRICS_MAX_LABELS) {
+        m = &g_series[n];
+        m->name = name;
+        snprintf(m->labels, sizeof(m->labels), "%s", labels);
+        m->kind = kind;
+        atomic_store_explicit(&g_nseries, n + 1, memory_order_release);
+    } else if (!m && !g_full_logged) {
+        g_full_logged = true;
+        dlog_print(DLOG_WARN, LOG_TAG, "registry full or labels too long, dropping %s{%s}", name, labels);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return m;
+}
+
+st_metric_t *st_metrics_counter(const char *name, const char *labels) {
+    return lookup(name, labels, KIND_COUNTER);
+}
+
+st_metric_t *st_metrics_gauge(const char *name, const char *labels) {
+    return lookup(name, labels, KIND_GAUGE);
+}
+
+st_metric_t *st_metrics_histogram(const char *name, const char *labels) {
+    return lookup(name, labels, KIND_HISTOGRAM);
+}
+
+void st_metric_inc(st_metric_t *m) {
+    st_metric_add(m, 1);
+}
+
+void st_metric_add(st_metric_t *m, uint64_t n) {
+    if (m) atomic_fetch_add_explicit(&m->value, n, memory_order_relaxed);
+}
+
+void st_metric_set(st_metric_t *m, int64_t v) {
+    if (m) atomic_store_explicit(&m->value, (uint64_t)v, memory_order_relaxed);
+}
+
+void st_metric_observe(st_metric_t *m, double ms) {
+    if (!m || m->kind != KIND_HISTOGRAM) return;
+    if (ms < 0) ms = 0;
+    size_t b = 0;
+    while (b < NBOUNDS && ms > k_bounds[b]) b++;
+    atomic_fetch_add_explicit(&m->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->sum_us, (uint64_t)(ms * 1000.0), memory_order_relaxed);
+}
+
+// ---------- EXPOSITION ----------
+typedef struct {
+    char *buf;
+    size_t len, n;
+    bool truncated;
+} out_t;
+
+static void emit(out_t *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void emit(out_t *o, const char *fmt, ...) {
+    if (o->truncated) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int w = vsnprintf(o->buf + o->n, o->len - o->n, fmt, ap);
+    va_end(ap);
+    if (w < 0 || (size_t)w >= o->len - o->n) {
+        o->truncated = true;
+        o->buf[o->n] = '\0';        // drop the partial line
+        return;
+    }
+    o->n += (size_t)w;
+}
+
+// name{labels[,extra]} with the braces left out when both are empty
+static void emit_series(out_t *o, const char *name, const char *suffix, const char *labels, const char *extra) {
+    bool l = labels[0], e = extra && extra[0];
+    emit(o, "%s%s%s%s%s%s%s", name, suffix, l || e ? "{" : "", labels, l && e ? "," : "",
+         e ? extra : "", l || e ? "}" : "");
+}
+
+static void emit_metric(out_t *o, st_metric_t *m) {
+    if (m->kind == KIND_COUNTER) {
+        emit_series(o, m->name, "", m->labels, NULL);
+        emit(o, " %llu\n", (unsigned long long)atomic_load(&m->value));
+    } else if (m->kind == KIND_GAUGE) {
+        emit_series(o, m->name, "", m->labels, NULL);
+        emit(o, " %lld\n", (long long)(int64_t)atomic_load(&m->value));
+    } else {
+        uint64_t cum = 0;
+        char le[32];
+        for (size_t b = 0; b <= NBOUNDS; b++) {
+            cum += atomic_load(&m->buckets[b]);
+            if (b < NBOUNDS) snprintf(le, sizeof(le), "le=\"%g\"", k_bounds[b]);
+            else snprintf(le, sizeof(le), "le=\"+Inf\"");
+            emit_series(o, m->name, "_bucket", m->labels, le);
+            emit(o, " %llu\n", (unsigned long long)cum);
+        }
+        emit_series(o, m->name, "_sum", m->labels, NULL);
+        emit(o, " %.3f\n", (double)atomic_load(&m->sum_us) / 1000.0);
+        emit_series(o, m->name, "_count", m->labels, NULL);
+        emit(o, " %llu\n", (unsigned long long)cum);
+    }
+}
+
+size_t st_metrics_format(char *buf, size_t len) {
+    if (!buf || !len) return 0;
+    out_t o = { buf, len, 0, false };
+    buf[0] = '\0';
+    size_t n = atomic_load_explicit(&g_nseries, memory_order_acquire);
+    static const char *kinds[] = { "counter", "gauge", "histogram" };
+    // grouped by name, in order of first registration
+    for (size_t i = 0; i < n && !o.truncated; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) seen = strcmp(g_series[j].name, g_series[i].name) == 0;
+        if (seen) continue;
+        emit(&o, "# TYPE %s %s\n", g_series[i].name, kinds[g_series[i].kind]);
+        for (size_t j = i; j < n; j++)
+            if (strcmp(g_series[j].name, g_series[i].name) == 0) emit_metric(&o, &g_series[j]);
+    }
+    return o.n;
+}
+
+bool st_metrics_write(const char *path) {
+    char *buf = malloc(FORMAT_BUF);
+    if (!buf || !path) { free(buf); return false; }
+    size_t n = st_metrics_format(buf, FORMAT_BUF);
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    bool ok = fp && fwrite(buf, 1, n, fp) == n;
+    if (fp && fclose(fp) != 0) ok = false;
+    free(buf);
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) {
+        dlog_print(DLOG_WARN, LOG_TAG, "could not write %s", path);
+        unlink(tmp);
+    }
+    return ok;
+}
+
+// ---------- EXPORTER THREAD ----------
+static pthread_t g_thread;
+static bool g_running = false;
+static atomic_bool g_stop;
+static st_metrics_cfg_t g_cfg;
+static char g_file[256];
+static int g_listen = -1;
+
+static double mono_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) { if (w < 0 && errno == EINTR) continue; return; }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+// One request per connection; only the request line is looked at.
+static void serve_one(int fd) {
+    struct timeval tv = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char req[1024];
+    ssize_t r = recv(fd, req, sizeof(req) - 1, 0);
+    if (r <= 0) return;
+    req[r] = '\0';
+    char head[160];
+    if (strncmp(req, "GET /metrics", 12) != 0 || (req[12] != ' ' && req[12] != '?')) {
+        int n = snprintf(head, sizeof(head), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        send_all(fd, head, (size_t)n);
+        return;
+    }
+    char *body = malloc(FORMAT_BUF);
+    if (!body) return;
+    size_t len = st_metrics_format(body, FORMAT_BUF);
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+    send_all(fd, head, (size_t)n);
+    send_all(fd, body, len);
+    free(body);
+}
+
+static void *exporter_main(void *arg) {
+    (void)arg;
+    double next_flush = g_file[0] ? mono_sec() + g_cfg.flush_sec : 0;
+    while (!atomic_load(&g_stop)) {
+        // wake at least once a second for stop, sooner for a due flush
+        int wait_ms = 1000;
+        if (next_flush) {
+            double left = next_flush - mono_sec();
+            if (left <= 0) {
+                st_metrics_write(g_file);
+                next_flush = mono_sec() + g_cfg.flush_sec;
+                continue;
+            }
+            if (left * 1000 < wait_ms) wait_ms = (int)(left * 1000) + 1;
+        }
+        if (g_listen < 0) {
+            usleep((useconds_t)wait_ms * 1000);
+            continue;
+        }
+        struct pollfd p = { g_listen, POLLIN, 0 };
+        if (poll(&p, 1, wait_ms) <= 0 || !(p.revents & POLLIN)) continue;
+        int fd = accept(g_listen, NULL, NULL);
+        if (fd < 0) continue;
+        serve_one(fd);
+        close(fd);
+    }
+    if (g_file[0]) st_metrics_write(g_file);
+    return NULL;
+}
+
+static int listen_local(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);         // never reachable from the network
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(fd, 4) != 0) {
+        dlog_print(DLOG_WARN, LOG_TAG, "cannot listen on 127.0.0.1:%d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool st_metrics_start(const st_metrics_cfg_t *cfg) {
+    if (g_running || !cfg) return false;
+    g_cfg = *cfg;
+    if (g_cfg.flush_sec <= 0) g_cfg.flush_sec = 60.0;
+    snprintf(g_file, sizeof(g_file), "%s", cfg->file ? cfg->file : "");
+    g_listen = cfg->port > 0 ? listen_local(cfg->port) : -1;
+    if (g_listen < 0 && !g_file[0]) return false;
+    atomic_store(&g_stop, false);
+    if (pthread_create(&g_thread, NULL, exporter_main, NULL) != 0) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start the exporter thread");
+        if (g_listen >= 0) close(g_listen);
+        g_listen = -1;
+        return false;
+    }
+    g_running = true;
+    if (g_listen >= 0) dlog_print(DLOG_INFO, LOG_TAG, "serving http://127.0.0.1:%d/metrics", cfg->port);
+    return true;
+}
+
+void st_metrics_stop(void) {
+    if (!g_running) return;
+    atomic_store(&g_stop, true);
+    pthread_join(g_thread, NULL);
+    if (g_listen >= 0) close(g_listen);
+    g_listen = -1;
+    g_running = false;
+}
@@ -0,0 +1,70 @@
+#ifndef ST_METRICS_H
+#define ST_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- METRICS REGISTRY ----------
+// Counters, gauges and fixed-bucket latency histograms, exported in the
+// Prometheus text format. A series is a name plus an optional label set,
+// written the way it appears in the output:
+//
+//   st_metric_t *m = st_metrics_counter("st_http_requests_total",
+//                                       "endpoint=\"/v1/devices/{id}/status\",status=\"200\"");
+//   st_metric_inc(m);
+//
+// Lookups scan the registry without a lock, and updates are single atomic
+// operations, so hot paths may look a series up on every call. Only the
+// first use of a series takes the registry lock. Series are never freed.
+// When the registry is full, lookups return NULL, and every update accepts
+// NULL and does nothing.
+//
+// st_metrics_start() runs one thread that answers GET /metrics on a local
+// port and/or rewrites a file at a fixed interval. Either side may be
+// left off. All functions are thread-safe.
+
+#define ST_METRICS_MAX_SERIES 256
+#define ST_METRICS_MAX_LABELS 160       // bytes of label text per series
+// Histogram bucket upper bounds in milliseconds (plus +Inf).
+#define ST_METRICS_BUCKETS_MS 1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000
+
+typedef struct st_metric st_metric_t;
+
+// name must outlive the registry (a string literal); labels are copied.
+st_metric_t *st_metrics_counter(const char *name, const char *labels);
+st_metric_t *st_metrics_gauge(const char *name, const char *labels);
+st_metric_t *st_metrics_histogram(const char *name, const char *labels);
+
+void st_metric_inc(st_metric_t *m);
+void st_metric_add(st_metric_t *m, uint64_t n);
+void st_metric_set(st_metric_t *m, int64_t v);    // gauges
+void st_metric_observe(st_metric_t *m, double ms); // histograms
+
+// The whole registry in Prometheus text format; returns the length written
+// (truncated at a line boundary when buf is too small).
+size_t st_metrics_format(char *buf, size_t len);
+// Writes it to path atomically (temp file + rename).
+bool st_metrics_write(const char *path);
+
+typedef struct {
+    int port;                   // 127.0.0.1:port serves /metrics; 0 -> no endpoint
+    const char *file;           // rewritten every flush_sec; NULL -> no file
+    double flush_sec;
+} st_metrics_cfg_t;
+
+#define ST_METRICS_CFG_DEFAULT { 0, NULL, 60.0 }
+
+bool st_metrics_start(const st_metrics_cfg_t *cfg);
+// Writes the file a last time and stops the thread.
+void st_metrics_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,502 @@
+#define _GNU_SOURCE            // strcasestr
+#include "st_mock_server.h"
+
+#include "st_json_path.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REQ_MAX (64 * 1024)
+#define DEVICE_ETAG "\"mock-device-1\""
+#define MOCK_VLM_PROMPTS 8     // batch prompts answered (ST_VLM_MAX_PROMPTS)
+
+static const char *const k_routes[ST_MOCK_ROUTES] = {
+    [ST_MOCK_TOKEN] = "token",
+    [ST_MOCK_DEVICES] = "devices",
+    [ST_MOCK_DEVICE] = "device",
+    [ST_MOCK_STATUS] = "status",
+    [ST_MOCK_COMMANDS] = "commands",
+    [ST_MOCK_CDN] = "cdn",
+    [ST_MOCK_VLM] = "vlm",
+};
+
+const char *st_mock_route_name(st_mock_route_e route) {
+    return route >= 0 && route < ST_MOCK_ROUTES ? k_routes[route] : "?";
+}
+
+void st_mock_cfg_default(st_mock_cfg_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->port = 8089;
+    cfg->devices = 4;
+    cfg->image_delay_ms = 1500;
+    cfg->connect_ms = 0;
+    cfg->token_ttl_sec = 86400;
+    cfg->vlm_batch = true;
+    for (int i = 0; i < ST_MOCK_ROUTES; i++) {
+        cfg->routes[i].latency_ms = 50;
+        cfg->routes[i].jitter_ms = 20;
+        cfg->routes[i].error_status = 503;
+    }
+    cfg->routes[ST_MOCK_STATUS].bytes = 2048;
+    cfg->routes[ST_MOCK_DEVICES].bytes = 0;     // grows with devices
+    cfg->routes[ST_MOCK_CDN].bytes = 120 * 1024;
+    cfg->routes[ST_MOCK_CDN].latency_ms = 80;
+}
+
+static bool set_route_field(st_mock_route_t *r, const char *field, const char *val) {
+    if (strcmp(field, "latency_ms") == 0) r->latency_ms = atoi(val);
+    else if (strcmp(field, "jitter_ms") == 0) r->jitter_ms = atoi(val);
+    else if (strcmp(field, "error_rate") == 0) r->error_rate = atof(val);
+    else if (strcmp(field, "error_status") == 0) r->error_status = atoi(val);
+    else if (strcmp(field, "bytes") == 0) r->bytes = atol(val);
+    else return false;
+    return true;
+}
+
+bool st_mock_cfg_load(st_mock_cfg_t *cfg, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return false;
+    char line[256];
+    bool ok = true;
+    while (fgets(line, sizeof(line), fp)) {
+        char key[64], val[64];
+        if (line[0] == '#' || sscanf(line, "%63s %63s", key, val) != 2) continue;
+        char *dot = strchr(key, '.');
+        bool known = true;
+        if (dot) {
+            *dot = '\0';
+            known = false;
+            for (int i = 0; i < ST_MOCK_ROUTES && !known; i++)
+                if (strcmp(key, k_routes[i]) == 0) known = set_route_field(&cfg->routes[i], dot + 1, val);
+        } else if (strcmp(key, "devices") == 0) {
+            cfg->devices = atoi(val);
+        } else if (strcmp(key, "image_delay_ms") == 0) {
+            cfg->image_delay_ms = atoi(val);
+        } else if (strcmp(key, "connect_ms") == 0) {
+            cfg->connect_ms = atoi(val);
+        } else if (strcmp(key, "token_ttl_sec") == 0) {
+            cfg->token_ttl_sec = atoi(val);
+        } else if (strcmp(key, "vlm_batch") == 0) {
+            cfg->vlm_batch = atoi(val) != 0;
+        } else if (strcmp(key, "port") == 0) {
+            cfg->port = atoi(val);
+        } else {
+            known = false;
+        }
+        if (!known) {
+            fprintf(stderr, "%s: unknown key %s%s%s\n", path, key, dot ? "." : "", dot ? dot + 1 : "");
+            ok = false;
+        }
+    }
+    fclose(fp);
+    if (cfg->devices < 1) cfg->devices = 1;
+    if (cfg->devices > ST_MOCK_MAX_DEVICES) cfg->devices = ST_MOCK_MAX_DEVICES;
+    return ok;
+}
+
+// ---------- STATE ----------
+typedef struct {
+    double take_at;             // pending take (epoch seconds), 0 -> none
+    unsigned frame;
+    double frame_at;            // epoch seconds of the current frame
+} device_t;
+
+static const st_mock_cfg_t *g_cfg;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static device_t g_devs[ST_MOCK_MAX_DEVICES];
+static unsigned long g_tokens = 0;
+static atomic_ulong g_requests, g_connections, g_errors, g_by_route[ST_MOCK_ROUTES];
+static atomic_ullong g_bytes_in, g_bytes_out;
+static atomic_int g_live_threads;
+
+static double now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void iso8601(double t, char *out, size_t len) {
+    time_t s = (time_t)t;
+    struct tm tm;
+    gmtime_r(&s, &tm);
+    size_t n = strftime(out, len, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(out + n, len - n, ".%03dZ", (int)((t - (double)s) * 1000));
+}
+
+static void device_id(int i, char *out, size_t len) {
+    snprintf(out, len, "00000000-0000-4000-8000-%012d", i);
+}
+
+static int device_index(const char *id) {
+    char want[64];
+    for (int i = 0; i < g_cfg->devices; i++) {
+        device_id(i, want, sizeof(want));
+        if (strncmp(id, want, strlen(want)) == 0) return i;
+    }
+    return -1;
+}
+
+// ---------- REPLIES ----------
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} sbuf_t;
+
+static void sb_add(sbuf_t *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void sb_add(sbuf_t *b, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int w = vsnprintf(b->buf ? b->buf + b->len : NULL, b->buf ? b->cap - b->len : 0, fmt, ap);
+        va_end(ap);
+        if (w < 0) return;
+        if (b->buf && (size_t)w < b->cap - b->len) { b->len += (size_t)w; return; }
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + (size_t)w + 1) cap *= 2;
+        char *nb = realloc(b->buf, cap);
+        if (!nb) return;
+        b->buf = nb;
+        b->cap = cap;
+    }
+}
+
+// Pads a JSON object (ending in '}') to target bytes with a filler member.
+static void sb_pad(sbuf_t *b, long target) {
+    if (!b->len || target <= (long)b->len + 16) return;
+    b->len--;                                   // reopen the object
+    sb_add(b, ",\"_pad\":\"");
+    size_t from = b->len;
+    int fill = (int)(target - (long)b->len - 2);
+    sb_add(b, "%*s\"}", fill, "");
+    // text-like filler, so compression behaves as on a verbose payload
+    for (int i = 0; b->buf && i < fill; i++) b->buf[from + (size_t)i] = "status value timestamp "[i % 23];
+}
+
+static void send_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) { if (w < 0 && errno == EINTR) continue; return; }
+        atomic_fetch_add(&g_bytes_out, (unsigned long long)w);
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void reply(int fd, int status, const char *ctype, const char *extra, const char *body, size_t len) {
+    char head[512];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                     status, status < 300 ? "OK" : status == 304 ? "Not Modified" : "Error",
+                     ctype, len, extra ? extra : "");
+    send_all(fd, head, (size_t)n);
+    if (len) send_all(fd, body, len);
+}
+
+static void reply_json(int fd, sbuf_t *b, const char *extra) {
+    reply(fd, 200, "application/json", extra, b->buf ? b->buf : "", b->len);
+}
+
+static void route_token(int fd) {
+    pthread_mutex_lock(&g_lock);
+    unsigned long n = ++g_tokens;
+    pthread_mutex_unlock(&g_lock);
+    sbuf_t b = {0};
+    sb_add(&b, "{\"access_token\":\"mock-access-%lu\",\"refresh_token\":\"mock-refresh-%lu\","
+               "\"token_type\":\"bearer\",\"expires_in\":%d}", n, n, g_cfg->token_ttl_sec);
+    reply_json(fd, &b, NULL);
+    free(b.buf);
+}
+
+static void device_json(sbuf_t *b, int i) {
+    char id[64];
+    device_id(i, id, sizeof(id));
+    sb_add(b, "{\"deviceId\":\"%s\",\"name\":\"mock-camera\",\"label\":\"Mock camera %d\","
+              "\"components\":[{\"id\":\"main\",\"capabilities\":[{\"id\":\"imageCapture\",\"version\":1},"
+              "{\"id\":\"refresh\",\"version\":1},{\"id\":\"motionSensor\",\"version\":1}]}]}", id, i);
+}
+
+static void route_devices(int fd) {
+    sbuf_t b = {0};
+    sb_add(&b, "{\"items\":[");
+    for (int i = 0; i < g_cfg->devices; i++) {
+        if (i) sb_add(&b, ",");
+        device_json(&b, i);
+    }
+    sb_add(&b, "]}");
+    sb_pad(&b, g_cfg->routes[ST_MOCK_DEVICES].bytes);
+    reply_json(fd, &b, NULL);
+    free(b.buf);
+}
+
+static void route_device(int fd, int dev, const char *req) {
+    if (strcasestr(req, "If-None-Match: " DEVICE_ETAG)) {
+        reply(fd, 304, "application/json", "ETag: " DEVICE_ETAG "\r\n", NULL, 0);
+        return;
+    }
+    sbuf_t b = {0};
+    device_json(&b, dev);
+    sb_pad(&b, g_cfg->routes[ST_MOCK_DEVICE].bytes);
+    reply_json(fd, &b, "ETag: " DEVICE_ETAG "\r\n");
+    free(b.buf);
+}
+
+static void route_status(int fd, int dev) {
+    double now = now_sec();
+    pthread_mutex_lock(&g_lock);
+    device_t *d = &g_devs[dev];
+    if (d->take_at && now >= d->take_at + g_cfg->image_delay_ms / 1000.0) {
+        d->frame++;
+        d->frame_at = now;
+        d->take_at = 0;
+    }
+    unsigned frame = d->frame;
+    double at = d->frame_at;
+    pthread_mutex_unlock(&g_lock);
+
+    char id[64], ts[40];
+    device_id(dev, id, sizeof(id));
+    iso8601(at, ts, sizeof(ts));
+    sbuf_t b = {0};
+    sb_add(&b, "{\"components\":{\"main\":{\"imageCapture\":{"
+               "\"image\":{\"value\":\"http://127.0.0.1:%d/cdn/%s/%u.jpg\",\"timestamp\":\"%s\"},"
+               "\"captureTime\":{\"value\":\"%s\",\"timestamp\":\"%s\"}},"
+               "\"motionSensor\":{\"motion\":{\"value\":\"inactive\",\"timestamp\":\"%s\"}}}}}",
+           g_cfg->port, id, frame, ts, ts, ts, ts);
+    sb_pad(&b, g_cfg->routes[ST_MOCK_STATUS].bytes);
+    reply_json(fd, &b, NULL);
+    free(b.buf);
+}
+
+static void route_commands(int fd, int dev, const char *body) {
+    int n = 0;
+    for (const char *p = body; (p = strstr(p, "\"command\"")) != NULL; p += 9) n++;
+    if (strstr(body, "\"take\"")) {
+        pthread_mutex_lock(&g_lock);
+        if (!g_devs[dev].take_at) g_devs[dev].take_at = now_sec();
+        pthread_mutex_unlock(&g_lock);
+    }
+    sbuf_t b = {0};
+    sb_add(&b, "{\"results\":[");
+    for (int i = 0; i < n; i++) sb_add(&b, "%s{\"id\":\"mock-cmd-%d\",\"status\":\"ACCEPTED\"}", i ? "," : "", i);
+    sb_add(&b, "]}");
+    reply_json(fd, &b, NULL);
+    free(b.buf);
+}
+
+static void route_cdn(int fd) {
+    size_t len = (size_t)(g_cfg->routes[ST_MOCK_CDN].bytes > 4 ? g_cfg->routes[ST_MOCK_CDN].bytes : 4);
+    char *img = malloc(len);
+    if (!img) { reply(fd, 500, "text/plain", NULL, NULL, 0); return; }
+    // SOI ... EOI around incompressible filler
+    unsigned x = 2463534242u;
+    for (size_t i = 0; i < len; i++) { x ^= x << 13; x ^= x >> 17; x ^= x << 5; img[i] = (char)x; }
+    img[0] = (char)0xFF; img[1] = (char)0xD8; img[len - 2] = (char)0xFF; img[len - 1] = (char)0xD9;
+    reply(fd, 200, "image/jpeg", NULL, img, len);
+    free(img);
+}
+
+// "answer: <prompt>" as a JSON string: quotes and backslashes escaped,
+// control bytes dropped.
+static void sb_answer(sbuf_t *b, const char *prompt) {
+    sb_add(b, "\"answer: ");
+    for (const char *s = prompt; *s; s++) {
+        if ((unsigned char)*s < 0x20) continue;
+        if (*s == '"' || *s == '\\') sb_add(b, "\\%c", *s);
+        else sb_add(b, "%c", *s);
+    }
+    sb_add(b, "\"");
+}
+
+static void route_vlm(int fd, const char *body, size_t len) {
+    char prompts[MOCK_VLM_PROMPTS][256];
+    char paths[MOCK_VLM_PROMPTS][24];
+    st_json_target_t t[MOCK_VLM_PROMPTS];
+    bool batch = strstr(body, "\"generate_batch_from_image\"") != NULL;
+    for (int i = 0; i < MOCK_VLM_PROMPTS; i++) {
+        snprintf(paths[i], sizeof(paths[i]), batch ? "params[0][%d]" : "params[0]", i);
+        t[i] = (st_json_target_t){ paths[i], prompts[i], sizeof(prompts[i]), false };
+    }
+    st_json_extract(body, len, t, batch ? MOCK_VLM_PROMPTS : 1);
+
+    sbuf_t b = {0};
+    if (batch && !g_cfg->vlm_batch) {
+        sb_add(&b, "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32601,\"message\":\"Method not found\"},\"id\":1}");
+    } else if (batch) {
+        sb_add(&b, "{\"jsonrpc\":\"2.0\",\"result\":[");
+        for (int i = 0; i < MOCK_VLM_PROMPTS && t[i].found; i++) {
+            if (i) sb_add(&b, ",");
+            sb_answer(&b, prompts[i]);
+        }
+        sb_add(&b, "],\"id\":1}");
+    } else if (t[0].found) {
+        sb_add(&b, "{\"jsonrpc\":\"2.0\",\"result\":");
+        sb_answer(&b, prompts[0]);
+        sb_add(&b, ",\"id\":1}");
+    } else {
+        sb_add(&b, "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32602,\"message\":\"Invalid params\"},\"id\":1}");
+    }
+    reply_json(fd, &b, NULL);
+    free(b.buf);
+}
+
+// ---------- CONNECTIONS ----------
+static volatile sig_atomic_t *g_stop;
+
+static void sleep_ms(int ms) {
+    if (ms > 0) usleep((useconds_t)ms * 1000);
+}
+
+static int route_of(const char *method, const char *path, int *dev) {
+    *dev = -1;
+    if (strncmp(path, "/oauth/token", 12) == 0) return strcmp(method, "POST") == 0 ? ST_MOCK_TOKEN : -1;
+    if (strcmp(path, "/vlm") == 0) return strcmp(method, "POST") == 0 ? ST_MOCK_VLM : -1;
+    if (strncmp(path, "/cdn/", 5) == 0) return (*dev = device_index(path + 5)) >= 0 ? ST_MOCK_CDN : -1;
+    if (strncmp(path, "/v1/devices", 11) != 0) return -1;
+    const char *p = path + 11;
+    if (*p == '\0' || *p == '?') return ST_MOCK_DEVICES;
+    if (*p++ != '/' || (*dev = device_index(p)) < 0) return -1;
+    const char *rest = p + strcspn(p, "/?");
+    if (*rest == '\0' || *rest == '?') return ST_MOCK_DEVICE;
+    if (strncmp(rest, "/status", 7) == 0) return ST_MOCK_STATUS;
+    if (strncmp(rest, "/commands", 9) == 0) return strcmp(method, "POST") == 0 ? ST_MOCK_COMMANDS : -1;
+    return -1;
+}
+
+// One request out of buf[0..*have); false when the connection should close.
+static bool handle(int fd, char *buf, size_t *have, bool first) {
+    char *end = strstr(buf, "\r\n\r\n");
+    if (!end) return true;              // need more
+    size_t head_len = (size_t)(end + 4 - buf);
+    const char *cl = strcasestr(buf, "\r\nContent-Length:");
+    size_t body_len = cl && cl < end ? strtoul(cl + 17, NULL, 10) : 0;
+    if (head_len + body_len > REQ_MAX - 1) return false;
+    if (*have < head_len + body_len) return true;
+
+    char method[8] = "", path[1024] = "";
+    sscanf(buf, "%7s %1023s", method, path);
+    char saved = buf[head_len + body_len];
+    buf[head_len + body_len] = '\0';
+    bool close_after = strcasestr(buf, "\r\nConnection: close") != NULL;
+    atomic_fetch_add(&g_requests, 1);
+
+    int dev;
+    int route = route_of(method, path, &dev);
+    if (route < 0) {
+        reply(fd, 404, "application/json", NULL, "{}", 2);
+    } else {
+        const st_mock_route_t *r = &g_cfg->routes[route];
+        atomic_fetch_add(&g_by_route[route], 1);
+        int delay = r->latency_ms + (r->jitter_ms > 0 ? rand() % (r->jitter_ms + 1) : 0);
+        sleep_ms(delay + (first ? g_cfg->connect_ms : 0));
+        if (r->error_rate > 0 && (double)rand() / RAND_MAX < r->error_rate) {
+            atomic_fetch_add(&g_errors, 1);
+            reply(fd, r->error_status, "application/json", NULL, "{\"error\":\"injected\"}", 20);
+        } else {
+            switch (route) {
+            case ST_MOCK_TOKEN: route_token(fd); break;
+            case ST_MOCK_DEVICES: route_devices(fd); break;
+            case ST_MOCK_DEVICE: route_device(fd, dev, buf); break;
+            case ST_MOCK_STATUS: route_status(fd, dev); break;
+            case ST_MOCK_COMMANDS: route_commands(fd, dev, buf + head_len); break;
+            case ST_MOCK_CDN: route_cdn(fd); break;
+            case ST_MOCK_VLM: route_vlm(fd, buf + head_len, body_len); break;
+            }
+        }
+    }
+    buf[head_len + body_len] = saved;
+    memmove(buf, buf + head_len + body_len, *have - head_len - body_len);
+    *have -= head_len + body_len;
+    buf[*have] = '\0';
+    return !close_after;
+}
+
+static void *conn_main(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    char *buf = malloc(REQ_MAX);
+    size_t have = 0;
+    bool first = true, open = buf != NULL;
+    while (open && !*g_stop) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 200) <= 0) continue;
+        ssize_t r = recv(fd, buf + have, REQ_MAX - 1 - have, 0);
+        if (r <= 0) break;
+        atomic_fetch_add(&g_bytes_in, (unsigned long long)r);
+        have += (size_t)r;
+        buf[have] = '\0';
+        // pipelined requests are served in order
+        for (size_t before = have + 1; open && have && have != before;) {
+            before = have;
+            open = handle(fd, buf, &have, first);
+            if (have != before) first = false;
+        }
+        if (have >= REQ_MAX - 1) break;
+    }
+    free(buf);
+    close(fd);
+    atomic_fetch_sub(&g_live_threads, 1);
+    return NULL;
+}
+
+bool st_mock_run(const st_mock_cfg_t *cfg, volatile sig_atomic_t *stop, st_mock_stats_t *out) {
+    g_cfg = cfg;
+    g_stop = stop;
+    memset(g_devs, 0, sizeof(g_devs));
+    double start = now_sec() - 60;              // a frame is already there
+    for (int i = 0; i < cfg->devices; i++) g_devs[i].frame_at = start;
+
+    int ls = socket(AF_INET, SOCK_STREAM, 0);
+    if (ls < 0) return false;
+    int one = 1;
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons((uint16_t)cfg->port) };
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(ls, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(ls, 64) != 0) {
+        fprintf(stderr, "mock: cannot listen on 127.0.0.1:%d: %s\n", cfg->port, strerror(errno));
+        close(ls);
+        return false;
+    }
+    while (!*stop) {
+        struct pollfd p = { ls, POLLIN, 0 };
+        if (poll(&p, 1, 200) <= 0) continue;
+        int fd = accept(ls, NULL, NULL);
+        if (fd < 0) continue;
+        atomic_fetch_add(&g_connections, 1);
+        atomic_fetch_add(&g_live_threads, 1);
+        pthread_t th;
+        if (pthread_create(&th, NULL, conn_main, (void *)(intptr_t)fd) != 0) {
+            atomic_fetch_sub(&g_live_threads, 1);
+            close(fd);
+            continue;
+        }
+        pthread_detach(th);
+    }
+    close(ls);
+    for (int i = 0; i < 50 && atomic_load(&g_live_threads) > 0; i++) usleep(20000);
+
+    if (out) {
+        memset(out, 0, sizeof(*out));
+        out->requests = atomic_load(&g_requests);
+        out->connections = atomic_load(&g_connections);
+        out->errors = atomic_load(&g_errors);
+        out->bytes_in = atomic_load(&g_bytes_in);
+        out->bytes_out = atomic_load(&g_bytes_out);
+        for (int i = 0; i < ST_MOCK_ROUTES; i++) out->by_route[i] = atomic_load(&g_by_route[i]);
+    }
+    return true;
+}
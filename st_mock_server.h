@@ -0,0 +1,89 @@
+#ifndef ST_MOCK_SERVER_H
+#define ST_MOCK_SERVER_H
+
+#include <signal.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- MOCK SMARTTHINGS SERVER ----------
+// A plain HTTP/1.1 stand-in for the parts of the cloud a capture touches,
+// for st_bench (the apps reach it through st_http_map_origin):
+//
+//   POST /oauth/token                  fresh access token every call
+//   GET  /v1/devices                   cfg.devices cameras
+//   GET  /v1/devices/{id}              one description (ETag, 304 on match)
+//   GET  /v1/devices/{id}/status       imageCapture.image of the last frame
+//   POST /v1/devices/{id}/commands     a "take" makes a new frame after image_delay_ms
+//   GET  /cdn/{id}/{n}.jpg             an image of cdn.bytes bytes
+//   POST /vlm                          JSON-RPC evaluation: every prompt is
+//                                      answered "answer: <prompt>"; the batch
+//                                      method is -32601 unless vlm_batch
+//
+// Every route has its own latency (plus uniform jitter), error rate and
+// payload size. JSON replies are padded to bytes with a filler attribute
+// that no reader targets. connect_ms is added to the first request on
+// each connection; it stands in for the TCP+TLS setup that a plain local
+// socket does not have. Each connection gets a thread and keep-alive.
+//
+// Scenario files hold "key value" lines ('#' comments): devices,
+// image_delay_ms, connect_ms, token_ttl_sec, vlm_batch, and the per-route
+// "<route>.latency_ms", ".jitter_ms", ".error_rate", ".error_status" and
+// ".bytes". The routes are token, devices, device, status, commands, cdn
+// and vlm.
+
+typedef enum {
+    ST_MOCK_TOKEN,
+    ST_MOCK_DEVICES,
+    ST_MOCK_DEVICE,
+    ST_MOCK_STATUS,
+    ST_MOCK_COMMANDS,
+    ST_MOCK_CDN,
+    ST_MOCK_VLM,
+    ST_MOCK_ROUTES,
+} st_mock_route_e;
+
+typedef struct {
+    int latency_ms;
+    int jitter_ms;
+    double error_rate;          // share of requests answered with error_status
+    int error_status;
+    long bytes;                 // JSON: pad the reply to this size; cdn: image size
+} st_mock_route_t;
+
+#define ST_MOCK_MAX_DEVICES 64
+
+typedef struct {
+    int port;                   // on 127.0.0.1
+    int devices;
+    int image_delay_ms;         // take -> new frame in status
+    int connect_ms;
+    int token_ttl_sec;          // expires_in of issued tokens
+    bool vlm_batch;             // /vlm knows generate_batch_from_image
+    st_mock_route_t routes[ST_MOCK_ROUTES];
+} st_mock_cfg_t;
+
+typedef struct {
+    unsigned long requests;
+    unsigned long connections;
+    unsigned long errors;       // injected error replies
+    unsigned long long bytes_in, bytes_out;     // on the socket, headers included
+    unsigned long by_route[ST_MOCK_ROUTES];
+} st_mock_stats_t;
+
+void st_mock_cfg_default(st_mock_cfg_t *cfg);
+// Overrides cfg from a scenario file; false when unreadable or a key is unknown.
+bool st_mock_cfg_load(st_mock_cfg_t *cfg, const char *path);
+const char *st_mock_route_name(st_mock_route_e route);
+
+// Serves until *stop turns non-zero (checked at least every 200 ms), then
+// fills out. False when the port cannot be bound.
+bool st_mock_run(const st_mock_cfg_t *cfg, volatile sig_atomic_t *stop, st_mock_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
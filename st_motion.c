@@ -0,0 +1,330 @@
+#include "st_motion.h"
+
+#include "st_devstate.h"
+#include "st_http.h"
+#include "st_json_path.h"
+#include "st_token.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define LOG_TAG "ST_MOTION"
+#define API_BASE "https://api.smartthings.com/v1"
+
+typedef struct {
+    char id[64];
+    bool seeded;                // baseline read since the last enable
+    bool from_mirror;           // last read came from st_devstate, not a status call
+    char motion_ts[64];
+    char contact_ts[64];
+    bool motion_active;
+    bool contact_open;
+    double last_activity;       // local time of the last counted activity
+} sensor_t;
+
+typedef struct {
+    char id[64];
+    double last_fire;
+} camera_t;
+
+typedef struct {
+    int sensor, camera;
+    int kinds;
+} rule_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static bool g_running = false;
+static bool g_enabled = false;
+static unsigned g_epoch = 0;            // bumped per enable; the watcher re-seeds when it moves
+static atomic_bool g_stop;
+static st_motion_cfg_t g_cfg = ST_MOTION_CFG_DEFAULT;
+static st_motion_fire_fn g_fire;
+static void *g_fire_ctx;
+static atomic_ulong g_calls;
+
+// rule tables are filled before st_motion_start and fixed afterwards;
+// sensor/camera state is only touched by the watcher thread
+static sensor_t g_sensors[ST_MOTION_MAX_SENSORS];
+static size_t g_sensor_count = 0;
+static camera_t g_cameras[ST_MOTION_MAX_CAMERAS];
+static size_t g_camera_count = 0;
+static rule_t g_rules[ST_MOTION_MAX_RULES];
+static size_t g_rule_count = 0;
+
+static double now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// ---------- RULES ----------
+static int sensor_index(const char *id) {
+    for (size_t i = 0; i < g_sensor_count; i++)
+        if (strcmp(g_sensors[i].id, id) == 0) return (int)i;
+    if (g_sensor_count == ST_MOTION_MAX_SENSORS) return -1;
+    sensor_t *s = &g_sensors[g_sensor_count];
+    memset(s, 0, sizeof(*s));
+    snprintf(s->id, sizeof(s->id), "%s", id);
+    return (int)g_sensor_count++;
+}
+
+static int camera_index(const char *id) {
+    for (size_t i = 0; i < g_camera_count; i++)
+        if (strcmp(g_cameras[i].id, id) == 0) return (int)i;
+    if (g_camera_count == ST_MOTION_MAX_CAMERAS) return -1;
+    camera_t *c = &g_cameras[g_camera_count];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->id, sizeof(c->id), "%s", id);
+    return (int)g_camera_count++;
+}
+
+bool st_motion_add(const char *sensor_id, const char *camera_id, int kinds) {
+    if (!sensor_id || !*sensor_id || g_running || g_rule_count == ST_MOTION_MAX_RULES) return false;
+    if (!camera_id || !*camera_id) camera_id = sensor_id;
+    kinds &= ST_MOTION_ANY;
+    if (!kinds) kinds = ST_MOTION_ANY;
+
+    int s = sensor_index(sensor_id);
+    int c = camera_index(camera_id);
+    if (s < 0 || c < 0) return false;
+    for (size_t i = 0; i < g_rule_count; i++) {
+        if (g_rules[i].sensor == s && g_rules[i].camera == c) { g_rules[i].kinds |= kinds; return true; }
+    }
+    g_rules[g_rule_count++] = (rule_t){ s, c, kinds };
+    return true;
+}
+
+static int parse_kind(const char *word) {
+    if (strcmp(word, "motion") == 0) return ST_MOTION_MOTION;
+    if (strcmp(word, "contact") == 0) return ST_MOTION_CONTACT;
+    if (strcmp(word, "any") == 0) return ST_MOTION_ANY;
+    return 0;
+}
+
+int st_motion_load(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[256];
+    int added = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n#")] = '\0';
+        char sensor[64] = {0}, second[64] = {0}, third[16] = {0};
+        int n = sscanf(line, "%63s %63s %15s", sensor, second, third);
+        if (n < 1) continue;
+
+        const char *camera = NULL;
+        int kinds = ST_MOTION_ANY;
+        if (n >= 2 && parse_kind(second)) {
+            kinds = parse_kind(second);         // "<sensorId> <kind>": the sensor is the camera
+        } else if (n >= 2) {
+            camera = second;
+            if (n == 3 && !(kinds = parse_kind(third))) {
+                dlog_print(DLOG_WARN, LOG_TAG, "unknown trigger kind '%s' for %s", third, sensor);
+                continue;
+            }
+        }
+        if (st_motion_add(sensor, camera, kinds)) added++;
+    }
+    fclose(fp);
+    return added;
+}
+
+size_t st_motion_rule_count(void) {
+    return g_rule_count;
+}
+
+bool st_motion_watches(const char *camera_id) {
+    for (size_t i = 0; i < g_rule_count; i++)
+        if (strcmp(g_cameras[g_rules[i].camera].id, camera_id) == 0) return true;
+    return false;
+}
+
+// ---------- ATTRIBUTES ----------
+// A new timestamp is a new event. It is activity when the attribute is
+// active now, or inactive after we last saw it inactive too (the active
+// event came and went between two polls).
+static bool attribute_activity(bool active_now, bool *was_active, const char *ts, char *last_ts, size_t ts_len) {
+    bool changed = strcmp(ts, last_ts) != 0;
+    bool activity = changed && (active_now || !*was_active);
+    if (active_now && !*was_active) activity = true;
+    *was_active = active_now;
+    snprintf(last_ts, ts_len, "%s", ts);
+    return activity;
+}
+
+// motion/contact NULL when the device did not report them.
+static int sensor_update(sensor_t *s, const char *motion, const char *motion_ts,
+                         const char *contact, const char *contact_ts) {
+    bool seeded = s->seeded;
+    s->seeded = true;
+    int kinds = 0;
+    if (motion &&
+        attribute_activity(strcmp(motion, "active") == 0, &s->motion_active, motion_ts,
+                           s->motion_ts, sizeof(s->motion_ts)))
+        kinds |= ST_MOTION_MOTION;
+    if (contact &&
+        attribute_activity(strcmp(contact, "open") == 0, &s->contact_open, contact_ts,
+                           s->contact_ts, sizeof(s->contact_ts)))
+        kinds |= ST_MOTION_CONTACT;
+    return seeded ? kinds : 0;
+}
+
+static bool watcher_cancelled(void *ctx) {
+    (void)ctx;
+    return atomic_load(&g_stop);
+}
+
+// The attributes from the event-stream mirror, when it has them.
+static bool sensor_mirror(const sensor_t *s, char *motion, char *motion_ts, char *contact, char *contact_ts,
+                          bool found[2]) {
+    double ts = 0;
+    found[0] = st_devstate_get(s->id, "main", "motionSensor", "motion", motion, 32, &ts);
+    if (found[0]) snprintf(motion_ts, 64, "%.3f", ts);
+    found[1] = st_devstate_get(s->id, "main", "contactSensor", "contact", contact, 32, &ts);
+    if (found[1]) snprintf(contact_ts, 64, "%.3f", ts);
+    return found[0] || found[1];
+}
+
+// Reads one sensor; returns the kinds with activity since the last read.
+static int sensor_poll(sensor_t *s, const char *token) {
+    char motion[32], motion_ts[64], contact[32], contact_ts[64];
+    bool mirrored[2];
+    bool from_mirror = sensor_mirror(s, motion, motion_ts, contact, contact_ts, mirrored);
+    // the two sources stamp differently: a switch takes a new baseline instead of firing
+    if (from_mirror != s->from_mirror) s->seeded = false;
+    s->from_mirror = from_mirror;
+    if (from_mirror)
+        return sensor_update(s, mirrored[0] ? motion : NULL, motion_ts, mirrored[1] ? contact : NULL, contact_ts);
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/devices/%s/status", API_BASE, s->id);
+    st_http_req_t req = { .url = url, .bearer = token, .timeout_sec = 10,
+                          .cancelled = watcher_cancelled };
+    st_buf_t body = {0};
+    atomic_fetch_add(&g_calls, 1);
+    if (!st_http_perform(&req, &body, NULL, NULL)) {
+        free(body.buf);
+        return 0;
+    }
+
+    st_json_target_t t[] = {
+        { "components.main.motionSensor.motion.value", motion, sizeof(motion), false },
+        { "components.main.motionSensor.motion.timestamp", motion_ts, sizeof(motion_ts), false },
+        { "components.main.contactSensor.contact.value", contact, sizeof(contact), false },
+        { "components.main.contactSensor.contact.timestamp", contact_ts, sizeof(contact_ts), false },
+    };
+    st_json_extract(body.buf, body.len, t, 4);
+    free(body.buf);
+    if (!t[1].found) motion_ts[0] = '\0';
+    if (!t[3].found) contact_ts[0] = '\0';
+    return sensor_update(s, t[0].found ? motion : NULL, motion_ts, t[2].found ? contact : NULL, contact_ts);
+}
+
+// ---------- WATCHER ----------
+static void watcher_round(void) {
+    char *token = st_token_get();
+    if (!token) return;
+    for (size_t i = 0; i < g_sensor_count && !atomic_load(&g_stop); i++) {
+        if (!st_http_host_available(API_BASE)) break;
+        sensor_t *s = &g_sensors[i];
+        int kinds = sensor_poll(s, token);
+        if (!kinds) continue;
+
+        double now = now_sec();
+        bool bounce = s->last_activity > 0 && now - s->last_activity < g_cfg.debounce_sec;
+        s->last_activity = now;
+        if (bounce) continue;
+
+        for (size_t r = 0; r < g_rule_count; r++) {
+            const rule_t *rule = &g_rules[r];
+            int hit = rule->kinds & kinds;
+            if (rule->sensor != (int)i || !hit) continue;
+            camera_t *c = &g_cameras[rule->camera];
+            if (c->last_fire > 0 && now - c->last_fire < g_cfg.cooldown_sec) continue;
+            c->last_fire = now;
+            dlog_print(DLOG_INFO, LOG_TAG, "%s: %s on %s", c->id,
+                       (hit & ST_MOTION_MOTION) ? "motion" : "contact", s->id);
+            g_fire(c->id, s->id, hit, g_fire_ctx);
+        }
+    }
+    free(token);
+}
+
+static void *watcher_main(void *arg) {
+    (void)arg;
+    unsigned seen_epoch = 0;
+    pthread_mutex_lock(&g_lock);
+    while (!atomic_load(&g_stop)) {
+        if (!g_enabled) {
+            pthread_cond_wait(&g_cond, &g_lock);
+            continue;
+        }
+        if (seen_epoch != g_epoch) {
+            seen_epoch = g_epoch;
+            for (size_t i = 0; i < g_sensor_count; i++) g_sensors[i].seeded = false;
+        }
+        pthread_mutex_unlock(&g_lock);
+        double started = now_sec();
+        watcher_round();
+        pthread_mutex_lock(&g_lock);
+
+        // next round poll_sec after this one started (mirror reads cost nothing: every
+        // second while the event stream is up); enable/stop wake it early
+        double wake = started + (st_devstate_live() ? 1.0 : g_cfg.poll_sec);
+        struct timespec dl = { (time_t)wake, (long)((wake - (time_t)wake) * 1e9) };
+        while (g_enabled && !atomic_load(&g_stop) && now_sec() < wake)
+            if (pthread_cond_timedwait(&g_cond, &g_lock, &dl) != 0) break;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+bool st_motion_start(const st_motion_cfg_t *cfg, st_motion_fire_fn fire, void *ctx) {
+    if (g_running || !fire || !g_rule_count) return false;
+    if (cfg) g_cfg = *cfg;
+    if (g_cfg.poll_sec < 1) g_cfg.poll_sec = 1;
+    g_fire = fire;
+    g_fire_ctx = ctx;
+    for (size_t i = 0; i < g_sensor_count; i++) st_devstate_watch(g_sensors[i].id);
+    atomic_store(&g_stop, false);
+    g_enabled = false;
+    if (pthread_create(&g_thread, NULL, watcher_main, NULL) != 0) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start the trigger watcher");
+        return false;
+    }
+    g_running = true;
+    dlog_print(DLOG_INFO, LOG_TAG, "%zu sensor(s) -> %zu camera(s), poll %.0f s",
+               g_sensor_count, g_camera_count, g_cfg.poll_sec);
+    return true;
+}
+
+void st_motion_set_enabled(bool enabled) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_lock);
+    if (enabled && !g_enabled) g_epoch++;
+    g_enabled = enabled;
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+}
+
+unsigned long st_motion_request_count(void) {
+    return atomic_load(&g_calls);
+}
+
+void st_motion_stop(void) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_lock);
+    atomic_store(&g_stop, true);
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+    g_running = false;
+}
@@ -0,0 +1,79 @@
+#ifndef ST_MOTION_H
+#define ST_MOTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- MOTION / CONTACT TRIGGERS ----------
+// Live capture on a fixed timer spends most of its API calls, downloads and
+// VLM requests on empty scenes. The watcher instead follows the
+// motionSensor.motion and contactSensor.contact attributes of selected
+// devices and asks for a capture of the linked camera only when they report
+// activity; the app keeps the timer as a slow heartbeat.
+//
+// SmartThings delivers device events only to SmartApps (webhook or
+// subscription), which this app cannot host, so the attributes are read on
+// one background thread: one /devices/{id}/status call per sensor per poll,
+// against roughly six calls plus a download and a VLM request per capture.
+// While st_devstate's event stream is live (started after the watcher) the
+// sensors are read from its mirror instead: no calls, checked every second.
+// Every change of an attribute carries a new timestamp, so an
+// active -> inactive pulse that fell between two polls still counts.
+//
+// Per sensor, activity within debounce_sec of the previous activity is
+// merged into it; per camera, triggers within cooldown_sec of the last one
+// are dropped. fire() runs on the watcher thread.
+//
+// Trigger file format (one rule per line, '#' comments):
+//   <sensorId> [cameraId] [motion|contact|any]
+// Without cameraId the sensor is the camera itself (e.g. a doorbell with a
+// motionSensor capability); the kind defaults to any.
+
+#define ST_MOTION_MAX_SENSORS 32
+#define ST_MOTION_MAX_CAMERAS 32
+#define ST_MOTION_MAX_RULES 64
+
+enum {
+    ST_MOTION_MOTION = 1,       // motionSensor.motion went active
+    ST_MOTION_CONTACT = 2,      // contactSensor.contact went open
+    ST_MOTION_ANY = ST_MOTION_MOTION | ST_MOTION_CONTACT
+};
+
+typedef struct {
+    double poll_sec;            // attribute reads per sensor
+    double debounce_sec;
+    double cooldown_sec;
+} st_motion_cfg_t;
+
+#define ST_MOTION_CFG_DEFAULT { 10.0, 5.0, 60.0 }
+
+// camera_id asked for a capture because sensor_id reported kind.
+typedef void (*st_motion_fire_fn)(const char *camera_id, const char *sensor_id, int kind, void *ctx);
+
+// Rules are added before st_motion_start(). camera_id NULL -> sensor_id.
+bool st_motion_add(const char *sensor_id, const char *camera_id, int kinds);
+// Appends rules from a file; returns how many were added, -1 if unreadable.
+int st_motion_load(const char *path);
+size_t st_motion_rule_count(void);
+// True when some rule triggers camera_id.
+bool st_motion_watches(const char *camera_id);
+
+// Starts the watcher thread (idle until enabled). False without rules.
+bool st_motion_start(const st_motion_cfg_t *cfg, st_motion_fire_fn fire, void *ctx);
+// Polls only while enabled; on enable the current state becomes the
+// baseline, so activity from before live mode started does not fire.
+void st_motion_set_enabled(bool enabled);
+// Status calls made by the watcher (part of st_http_request_count()).
+unsigned long st_motion_request_count(void);
+// Joins the thread; an in-flight read is aborted.
+void st_motion_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
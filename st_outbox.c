@@ -0,0 +1,296 @@
+#include "st_outbox.h"
+
+#include "st_http.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define LOG_TAG "ST_OUTBOX"
+#define COMPACT_MIN_LINES 64            // dead journal lines tolerated before a rewrite
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static bool g_open = false;
+static atomic_bool g_stop;
+static bool g_paused;
+static st_outbox_cfg_t g_cfg;
+static char g_path[256];
+static char g_probe[256];
+static st_outbox_send_fn g_send;
+static void *g_send_ctx;
+
+// oldest first; g_ring[(g_head + i) % max_entries]
+static st_outbox_entry_t *g_ring;
+static size_t g_head = 0, g_count = 0;
+static unsigned long g_next_seq = 1;
+static unsigned long g_evicted = 0;
+static FILE *g_journal;
+static size_t g_journal_lines = 0;
+static double g_next_at = 0;            // no send before this (local time)
+static double g_backoff = 0;
+
+static double now_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static bool valid_token(const char *s) {
+    return s && *s && !strpbrk(s, " \t\r\n") && strlen(s) < sizeof(((st_outbox_entry_t *)0)->frame);
+}
+
+// ---------- RING (caller holds g_lock) ----------
+static size_t cap(void) {
+    return (size_t)g_cfg.max_entries;
+}
+
+static st_outbox_entry_t *at(size_t i) {
+    return &g_ring[(g_head + i) % cap()];
+}
+
+static void pop_front(void) {
+    g_head = (g_head + 1) % cap();
+    g_count--;
+}
+
+static bool remove_seq(unsigned long seq) {
+    for (size_t i = 0; i < g_count; i++) {
+        if (at(i)->seq != seq) continue;
+        for (size_t j = i; j > 0; j--) *at(j) = *at(j - 1);
+        pop_front();
+        return true;
+    }
+    return false;
+}
+
+// Appends e, evicting the oldest when full; returns the evicted seq or 0.
+static unsigned long push_back(const st_outbox_entry_t *e) {
+    unsigned long evicted = 0;
+    if (g_count == cap()) {
+        evicted = at(0)->seq;
+        pop_front();
+    }
+    *at(g_count) = *e;
+    g_count++;
+    return evicted;
+}
+
+// ---------- JOURNAL (caller holds g_lock) ----------
+static void journal_line(const char *fmt, ...) {
+    if (!g_journal) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(g_journal, fmt, ap);
+    va_end(ap);
+    fflush(g_journal);
+    g_journal_lines++;
+}
+
+static void journal_add(const st_outbox_entry_t *e) {
+    journal_line("+ %lu %lld %s %s\n", e->seq, e->queued_at, e->device_id, e->frame);
+}
+
+// Rewrites the journal with the live entries (<path>.tmp, then renamed).
+static void journal_compact(void) {
+    char tmp[272];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return;
+    for (size_t i = 0; i < g_count; i++) {
+        const st_outbox_entry_t *e = at(i);
+        fprintf(fp, "+ %lu %lld %s %s\n", e->seq, e->queued_at, e->device_id, e->frame);
+    }
+    bool ok = fclose(fp) == 0 && rename(tmp, g_path) == 0;
+    if (!ok) { remove(tmp); return; }
+    if (g_journal) fclose(g_journal);
+    g_journal = fopen(g_path, "a");
+    g_journal_lines = g_count;
+}
+
+static void journal_replay(void) {
+    FILE *fp = fopen(g_path, "r");
+    if (!fp) return;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        st_outbox_entry_t e = {0};
+        char op = 0;
+        if (sscanf(line, " %c %lu", &op, &e.seq) != 2) continue;
+        if (op == '-') {
+            remove_seq(e.seq);
+        } else if (op == '+' &&
+                   sscanf(line, " + %lu %lld %63s %127s", &e.seq, &e.queued_at, e.device_id, e.frame) == 4) {
+            push_back(&e);
+        }
+        if (e.seq >= g_next_seq) g_next_seq = e.seq + 1;
+    }
+    fclose(fp);
+}
+
+// ---------- DRAIN ----------
+static void wait_until(double t) {
+    struct timespec dl = { (time_t)t, (long)((t - (time_t)t) * 1e9) };
+    pthread_cond_timedwait(&g_cond, &g_lock, &dl);
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_lock);
+    while (!atomic_load(&g_stop)) {
+        if (!g_count || g_paused) { pthread_cond_wait(&g_cond, &g_lock); continue; }
+        double now = now_sec();
+        if (now < g_next_at) { wait_until(g_next_at); continue; }
+        if (g_probe[0] && !st_http_host_available(g_probe)) {
+            g_next_at = now + g_cfg.retry_sec;
+            continue;
+        }
+
+        st_outbox_entry_t e = *at(0);
+        pthread_mutex_unlock(&g_lock);
+        st_outbox_result_e r = g_send(&e, g_send_ctx);
+        pthread_mutex_lock(&g_lock);
+
+        if (r == ST_OUTBOX_RETRY) {
+            if (atomic_load(&g_stop)) break;
+            g_backoff = g_backoff > 0 ? g_backoff * 2 : g_cfg.retry_sec;
+            if (g_backoff > g_cfg.retry_max_sec) g_backoff = g_cfg.retry_max_sec;
+            g_next_at = now_sec() + g_backoff;
+            dlog_print(DLOG_INFO, LOG_TAG, "%zu pending, next attempt in %.0f s", g_count, g_backoff);
+            continue;
+        }
+        // an eviction meanwhile may already have removed it
+        if (remove_seq(e.seq)) journal_line("- %lu\n", e.seq);
+        if (r == ST_OUTBOX_DROP) dlog_print(DLOG_WARN, LOG_TAG, "dropped %s (%s)", e.frame, e.device_id);
+        g_backoff = 0;
+        g_next_at = now_sec() + g_cfg.min_interval_sec;
+        if (g_journal_lines > COMPACT_MIN_LINES + 2 * g_count) journal_compact();
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+// ---------- API ----------
+bool st_outbox_open(const st_outbox_cfg_t *cfg, st_outbox_send_fn send, void *ctx) {
+    if (g_open || !cfg || !cfg->path || !send) return false;
+    pthread_mutex_lock(&g_lock);
+    g_cfg = *cfg;
+    if (g_cfg.max_entries < 1) g_cfg.max_entries = 1;
+    if (g_cfg.retry_sec <= 0) g_cfg.retry_sec = 1;
+    if (g_cfg.retry_max_sec < g_cfg.retry_sec) g_cfg.retry_max_sec = g_cfg.retry_sec;
+    snprintf(g_path, sizeof(g_path), "%s", cfg->path);
+    snprintf(g_probe, sizeof(g_probe), "%s", cfg->probe_url ? cfg->probe_url : "");
+    g_ring = calloc(cap(), sizeof(*g_ring));
+    if (!g_ring) { pthread_mutex_unlock(&g_lock); return false; }
+    g_head = g_count = 0;
+    g_evicted = 0;
+    g_next_seq = 1;
+    g_next_at = 0;
+    g_backoff = 0;
+    g_paused = false;
+    journal_replay();
+    journal_compact();
+    if (!g_journal) g_journal = fopen(g_path, "a");
+    if (!g_journal) dlog_print(DLOG_WARN, LOG_TAG, "%s not writable, queue is memory-only", g_path);
+    g_send = send;
+    g_send_ctx = ctx;
+    atomic_store(&g_stop, false);
+    if (pthread_create(&g_thread, NULL, drain_main, NULL) != 0) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start the drain thread");
+        if (g_journal) fclose(g_journal);
+        g_journal = NULL;
+        free(g_ring);
+        g_ring = NULL;
+        pthread_mutex_unlock(&g_lock);
+        return false;
+    }
+    g_open = true;
+    if (g_count) dlog_print(DLOG_INFO, LOG_TAG, "%zu frame(s) pending from the last run", g_count);
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+void st_outbox_close(void) {
+    if (!g_open) return;
+    pthread_mutex_lock(&g_lock);
+    atomic_store(&g_stop, true);
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+
+    pthread_mutex_lock(&g_lock);
+    if (g_journal) fclose(g_journal);
+    g_journal = NULL;
+    free(g_ring);
+    g_ring = NULL;
+    g_count = 0;
+    g_open = false;
+    pthread_mutex_unlock(&g_lock);
+}
+
+bool st_outbox_stopping(void) {
+    return atomic_load(&g_stop);
+}
+
+bool st_outbox_add(const char *device_id, const char *frame) {
+    if (!valid_token(device_id) || !valid_token(frame) || strlen(device_id) >= 64) return false;
+    pthread_mutex_lock(&g_lock);
+    if (!g_open) { pthread_mutex_unlock(&g_lock); return false; }
+    st_outbox_entry_t e = { .seq = g_next_seq++, .queued_at = (long long)time(NULL) };
+    snprintf(e.device_id, sizeof(e.device_id), "%s", device_id);
+    snprintf(e.frame, sizeof(e.frame), "%s", frame);
+    unsigned long evicted = push_back(&e);
+    journal_add(&e);
+    if (evicted) {
+        journal_line("- %lu\n", evicted);
+        g_evicted++;
+        dlog_print(DLOG_WARN, LOG_TAG, "full (%d), evicted the oldest frame", g_cfg.max_entries);
+    }
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+void st_outbox_kick(void) {
+    pthread_mutex_lock(&g_lock);
+    if (g_open && g_backoff > 0) {
+        g_backoff = 0;
+        g_next_at = 0;
+        pthread_cond_broadcast(&g_cond);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_outbox_set_paused(bool paused) {
+    pthread_mutex_lock(&g_lock);
+    if (g_paused != paused) {
+        g_paused = paused;
+        if (!paused) {
+            // whatever failed before the pause gets a fresh attempt
+            g_backoff = 0;
+            g_next_at = 0;
+        }
+        pthread_cond_broadcast(&g_cond);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+size_t st_outbox_pending(void) {
+    pthread_mutex_lock(&g_lock);
+    size_t n = g_count;
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+unsigned long st_outbox_evicted(void) {
+    pthread_mutex_lock(&g_lock);
+    unsigned long n = g_evicted;
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
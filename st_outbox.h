@@ -0,0 +1,79 @@
+#ifndef ST_OUTBOX_H
+#define ST_OUTBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- STORE-AND-FORWARD OUTBOX ----------
+// A frame whose evaluation request cannot reach the service is not lost:
+// its reference (device and stored frame file, never the image itself) is
+// appended to a journal and re-sent by one background thread once the
+// service answers again. Captures keep running at their own pace while
+// the uplink is down.
+//
+// Journal (append-only, one line per change):
+//   + <seq> <epoch> <deviceId> <frame>
+//   - <seq>
+// It is replayed at open and rewritten with only the live entries when
+// the dead lines outnumber them. At most max_entries are kept; adding one
+// more evicts the oldest.
+//
+// The drain thread sends oldest first, at most one per min_interval_sec.
+// After ST_OUTBOX_RETRY it waits retry_sec, doubled per further failure up
+// to retry_max_sec, and while probe_url's circuit breaker is open it does
+// not try at all. st_outbox_kick() ends the wait (e.g. after a live
+// request got through). Thread-safe.
+
+typedef struct {
+    unsigned long seq;
+    long long queued_at;        // epoch seconds
+    char device_id[64];
+    char frame[128];            // file name, as given to st_outbox_add
+} st_outbox_entry_t;
+
+typedef enum {
+    ST_OUTBOX_SENT,             // delivered: removed
+    ST_OUTBOX_RETRY,            // still unreachable: kept, drain backs off
+    ST_OUTBOX_DROP,             // can never succeed (frame gone, rejected): removed
+} st_outbox_result_e;
+
+// Runs on the drain thread.
+typedef st_outbox_result_e (*st_outbox_send_fn)(const st_outbox_entry_t *e, void *ctx);
+
+typedef struct {
+    const char *path;           // journal file
+    int max_entries;
+    double min_interval_sec;    // between two sends
+    double retry_sec;
+    double retry_max_sec;
+    const char *probe_url;      // NULL: no breaker check
+} st_outbox_cfg_t;
+
+#define ST_OUTBOX_CFG_DEFAULT { NULL, 200, 2.0, 15.0, 300.0, NULL }
+
+// Replays the journal and starts the drain thread.
+bool st_outbox_open(const st_outbox_cfg_t *cfg, st_outbox_send_fn send, void *ctx);
+// Stops the drain thread; an in-flight send should poll st_outbox_stopping().
+void st_outbox_close(void);
+bool st_outbox_stopping(void);
+
+// False when the outbox is not open or an id is empty or has whitespace.
+bool st_outbox_add(const char *device_id, const char *frame);
+void st_outbox_kick(void);
+// While paused nothing is sent (an in-flight send completes) and entries
+// keep queueing; unpausing also clears the backoff.
+void st_outbox_set_paused(bool paused);
+
+size_t st_outbox_pending(void);
+// Entries dropped by the size bound since open.
+unsigned long st_outbox_evicted(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+#include "st_pipeline.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "ST_PIPE"
+#define MAX_THREADS 8                   // per stage
+#define CANCEL_POLL_MS 200              // waits for room re-check cancelled() this often
+
+typedef struct {
+    char name[32];
+    void **ring;
+    size_t depth, head, count;
+    size_t busy;
+    unsigned long processed;
+    double busy_sec, blocked_sec;
+    pthread_cond_t not_empty, not_full;
+    int threads;
+    pthread_t tid[MAX_THREADS];
+} stage_t;
+
+typedef struct {
+    st_pipe_t *p;
+    int stage;
+} worker_arg_t;
+
+struct st_pipe {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;                // signalled when an item leaves a stage
+    stage_t stages[ST_PIPE_MAX_STAGES];
+    worker_arg_t args[ST_PIPE_MAX_STAGES];
+    int n;
+    st_pipe_run_fn run;
+    st_pipe_done_fn done;
+    void *ctx;
+    atomic_bool closing;                // no new items from outside (drain)
+    atomic_bool stop;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void deadline_in(struct timespec *ts, int ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+// Caller holds p->lock; may wait on it for room.
+static bool push_locked(st_pipe_t *p, int stage, void *item, bool (*cancelled)(void *), void *cancel_ctx) {
+    stage_t *s = &p->stages[stage];
+    if (s->count == s->depth) {
+        double t0 = now_sec();
+        while (s->count == s->depth && !atomic_load(&p->stop)) {
+            if (cancelled) {
+                struct timespec dl;
+                deadline_in(&dl, CANCEL_POLL_MS);
+                pthread_cond_timedwait(&s->not_full, &p->lock, &dl);
+                if (cancelled(cancel_ctx)) break;
+            } else {
+                pthread_cond_wait(&s->not_full, &p->lock);
+            }
+        }
+        s->blocked_sec += now_sec() - t0;
+        if (s->count == s->depth) return false;
+    }
+    if (atomic_load(&p->stop)) return false;
+    s->ring[(s->head + s->count) % s->depth] = item;
+    s->count++;
+    pthread_cond_signal(&s->not_empty);
+    return true;
+}
+
+static void *worker_main(void *arg) {
+    worker_arg_t *a = arg;
+    st_pipe_t *p = a->p;
+    stage_t *s = &p->stages[a->stage];
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!s->count && !atomic_load(&p->stop)) pthread_cond_wait(&s->not_empty, &p->lock);
+        if (atomic_load(&p->stop)) break;           // queued items are dropped by st_pipe_destroy
+        void *item = s->ring[s->head];
+        s->head = (s->head + 1) % s->depth;
+        s->count--;
+        s->busy++;
+        pthread_cond_signal(&s->not_full);
+        pthread_mutex_unlock(&p->lock);
+
+        double t0 = now_sec();
+        int next = p->run(a->stage, item, p->ctx);
+        double spent = now_sec() - t0;
+
+        pthread_mutex_lock(&p->lock);
+        s->busy_sec += spent;
+        s->processed++;
+        bool forwarded = false;
+        if (next > a->stage && next < p->n) {
+            forwarded = push_locked(p, next, item, NULL, NULL);
+        } else if (next != ST_PIPE_DONE) {
+            dlog_print(DLOG_ERROR, LOG_TAG, "%s: run() returned stage %d, finishing item", s->name, next);
+        }
+        s->busy--;
+        pthread_cond_broadcast(&p->idle);
+        if (!forwarded) {
+            pthread_mutex_unlock(&p->lock);
+            p->done(item, next != ST_PIPE_DONE, p->ctx);
+            pthread_mutex_lock(&p->lock);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+// ---------- API ----------
+static void free_stages(st_pipe_t *p) {
+    for (int i = 0; i < p->n; i++) {
+        free(p->stages[i].ring);
+        pthread_cond_destroy(&p->stages[i].not_empty);
+        pthread_cond_destroy(&p->stages[i].not_full);
+    }
+    pthread_cond_destroy(&p->idle);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+static void stop_and_join(st_pipe_t *p) {
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->stop, true);
+    for (int i = 0; i < p->n; i++) {
+        pthread_cond_broadcast(&p->stages[i].not_empty);
+        pthread_cond_broadcast(&p->stages[i].not_full);
+    }
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->n; i++)
+        for (int t = 0; t < p->stages[i].threads; t++) pthread_join(p->stages[i].tid[t], NULL);
+}
+
+st_pipe_t *st_pipe_create(const st_pipe_stage_cfg_t *stages, int n,
+                          st_pipe_run_fn run, st_pipe_done_fn done, void *ctx) {
+    if (n <= 0 || n > ST_PIPE_MAX_STAGES || !run || !done) return NULL;
+    st_pipe_t *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    atomic_init(&p->stop, false);
+    atomic_init(&p->closing, false);
+    p->run = run;
+    p->done = done;
+    p->ctx = ctx;
+    p->n = n;
+    for (int i = 0; i < n; i++) {
+        stage_t *s = &p->stages[i];
+        snprintf(s->name, sizeof(s->name), "%s", stages[i].name ? stages[i].name : "stage");
+        s->depth = stages[i].depth ? stages[i].depth : 1;
+        s->ring = calloc(s->depth, sizeof(*s->ring));
+        pthread_cond_init(&s->not_empty, NULL);
+        pthread_cond_init(&s->not_full, NULL);
+        if (!s->ring) { free_stages(p); return NULL; }
+    }
+
+    bool ok = true;
+    for (int i = 0; i < n && ok; i++) {
+        stage_t *s = &p->stages[i];
+        int want = stages[i].threads < 1 ? 1 : (stages[i].threads > MAX_THREADS ? MAX_THREADS : stages[i].threads);
+        p->args[i].p = p;
+        p->args[i].stage = i;
+        for (int t = 0; t < want && ok; t++) {
+            ok = pthread_create(&s->tid[t], NULL, worker_main, &p->args[i]) == 0;
+            if (ok) s->threads++;
+        }
+    }
+    if (!ok) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "could not start pipeline workers");
+        stop_and_join(p);
+        free_stages(p);
+        return NULL;
+    }
+    return p;
+}
+
+bool st_pipe_push(st_pipe_t *p, int stage, void *item, bool (*cancelled)(void *), void *cancel_ctx) {
+    if (!p || stage < 0 || stage >= p->n) return false;
+    pthread_mutex_lock(&p->lock);
+    bool ok = !atomic_load(&p->closing) && push_locked(p, stage, item, cancelled, cancel_ctx);
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+bool st_pipe_stopping(const st_pipe_t *p) {
+    // not closing: a drain lets running items finish their work
+    return p && atomic_load(&p->stop);
+}
+
+void st_pipe_stats(st_pipe_t *p, int stage, st_pipe_stage_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!p || stage < 0 || stage >= p->n) return;
+    pthread_mutex_lock(&p->lock);
+    const stage_t *s = &p->stages[stage];
+    out->processed = s->processed;
+    out->queued = s->count;
+    out->busy = s->busy;
+    out->busy_sec = s->busy_sec;
+    out->blocked_sec = s->blocked_sec;
+    pthread_mutex_unlock(&p->lock);
+}
+
+size_t st_pipe_summary(st_pipe_t *p, char *buf, size_t len) {
+    size_t used = 0;
+    if (!len) return 0;
+    buf[0] = '\0';
+    for (int i = 0; p && i < p->n && used < len; i++) {
+        st_pipe_stage_stats_t st;
+        st_pipe_stats(p, i, &st);
+        int w = snprintf(buf + used, len - used, "%s  n=%lu  avg=%.0f  busy=%zu/%d  queue=%zu/%zu  blocked=%.0f\n",
+                         p->stages[i].name, st.processed,
+                         st.processed ? st.busy_sec * 1000.0 / st.processed : 0.0,
+                         st.busy, p->stages[i].threads, st.queued, p->stages[i].depth,
+                         st.blocked_sec * 1000.0);
+        if (w < 0) break;
+        used += (size_t)w < len - used ? (size_t)w : len - used - 1;
+    }
+    return used;
+}
+
+void st_pipe_destroy(st_pipe_t *p, bool drain) {
+    if (!p) return;
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->closing, true);
+    if (drain) {
+        for (;;) {
+            bool idle = true;
+            for (int i = 0; i < p->n; i++)
+                if (p->stages[i].count || p->stages[i].busy) idle = false;
+            if (idle) break;
+            pthread_cond_wait(&p->idle, &p->lock);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    stop_and_join(p);
+
+    // whatever is still queued never ran its remaining stages
+    for (int i = 0; i < p->n; i++) {
+        stage_t *s = &p->stages[i];
+        for (; s->count; s->count--, s->head = (s->head + 1) % s->depth) p->done(s->ring[s->head], true, p->ctx);
+    }
+    free_stages(p);
+}
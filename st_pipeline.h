@@ -0,0 +1,75 @@
+#ifndef ST_PIPELINE_H
+#define ST_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- STAGED PIPELINE ----------
+// Items (capture jobs) move through a fixed sequence of stages. Each stage
+// has its own worker thread(s) and a bounded queue in front of it, so
+// different items occupy different stages at the same time and throughput
+// is set by the slowest stage rather than the sum of all of them.
+//
+// run() does one stage's work on an item and returns the stage it goes to
+// next (always a later one) or ST_PIPE_DONE; the item is then queued there,
+// waiting for room when that queue is full, so a slow stage holds back the
+// ones before it instead of piling up work. done() is called once per item
+// when it leaves the pipeline: finished, or dropped at shutdown.
+//
+// Producers hand items in with st_pipe_push(), which also waits for room.
+// Thread-safe; run/done are called on the pipeline's threads.
+
+#define ST_PIPE_MAX_STAGES 4
+#define ST_PIPE_DONE (-1)
+
+typedef int (*st_pipe_run_fn)(int stage, void *item, void *ctx);
+typedef void (*st_pipe_done_fn)(void *item, bool dropped, void *ctx);
+
+typedef struct {
+    const char *name;           // for st_pipe_summary
+    int threads;                // >= 1
+    size_t depth;               // queued items before push waits, >= 1
+} st_pipe_stage_cfg_t;
+
+typedef struct {
+    unsigned long processed;
+    size_t queued;
+    size_t busy;
+    double busy_sec;            // time spent in run()
+    double blocked_sec;         // time producers waited for room in this queue
+} st_pipe_stage_stats_t;
+
+typedef struct st_pipe st_pipe_t;
+
+st_pipe_t *st_pipe_create(const st_pipe_stage_cfg_t *stages, int n,
+                          st_pipe_run_fn run, st_pipe_done_fn done, void *ctx);
+
+// Queues item at stage; false (item not taken) when the pipeline stops or
+// cancelled(cancel_ctx) turns true while waiting for room. cancelled may be
+// NULL.
+bool st_pipe_push(st_pipe_t *p, int stage, void *item,
+                  bool (*cancelled)(void *), void *cancel_ctx);
+
+// true once st_pipe_destroy stops the workers (after the drain, if any);
+// long run() calls should give up.
+bool st_pipe_stopping(const st_pipe_t *p);
+
+void st_pipe_stats(st_pipe_t *p, int stage, st_pipe_stage_stats_t *out);
+
+// One line per stage: "name  n=  avg=  busy=  queue=  blocked=".
+size_t st_pipe_summary(st_pipe_t *p, char *buf, size_t len);
+
+// Stops the workers and frees p. With drain, queued items are finished
+// first; otherwise running items finish and queued ones are dropped.
+// No st_pipe_push may be in progress or follow.
+void st_pipe_destroy(st_pipe_t *p, bool drain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#include "st_preview.h"
+
+#include <dlog.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_TAG "ST_PREVIEW"
+
+// overlay tracks the caller's image, which the container lays out
+static void follow_cb(void *data, Evas *e, Evas_Object *obj, void *info) {
+    st_preview_t *p = data;
+    (void)e; (void)info;
+    Evas_Coord x, y, w, h;
+    evas_object_geometry_get(obj, &x, &y, &w, &h);
+    evas_object_move(p->img[1], x, y);
+    evas_object_resize(p->img[1], w, h);
+}
+
+static void start_load(st_preview_t *p, const char *path) {
+    int b = p->front == 0 ? 1 : 0;
+    Evas_Object *img = p->img[b];
+    Evas_Coord w = 0, h = 0;
+    evas_object_geometry_get(p->img[0], NULL, NULL, &w, &h);
+    // decode no larger than shown; before the first layout fall back to full size
+    evas_object_image_load_size_set(img, w > 0 ? w : 0, h > 0 ? h : 0);
+    evas_object_image_file_set(img, path, NULL);
+    if (evas_object_image_load_error_get(img) != EVAS_LOAD_ERROR_NONE) {
+        dlog_print(DLOG_WARN, LOG_TAG, "cannot open %s", path);
+        return;
+    }
+    p->loading = b;
+    evas_object_image_preload(img, EINA_FALSE);
+}
+
+static void preloaded_cb(void *data, Evas *e, Evas_Object *obj, void *info) {
+    st_preview_t *p = data;
+    (void)e; (void)info;
+    int b = obj == p->img[1] ? 1 : 0;
+    if (b != p->loading) return;
+    p->loading = -1;
+
+    if (evas_object_image_load_error_get(obj) == EVAS_LOAD_ERROR_NONE) {
+        if (b == 1) {
+            evas_object_stack_above(p->img[1], p->img[0]);
+            evas_object_show(p->img[1]);
+        } else {
+            evas_object_hide(p->img[1]);
+        }
+        evas_object_show(p->img[0]);    // hidden by the caller until the first frame
+        p->front = b;
+    } else {
+        dlog_print(DLOG_WARN, LOG_TAG, "decode failed, keeping the previous frame");
+    }
+
+    if (p->next[0]) {
+        char path[sizeof(p->next)];
+        snprintf(path, sizeof(path), "%s", p->next);
+        p->next[0] = '\0';
+        start_load(p, path);
+    }
+}
+
+void st_preview_init(st_preview_t *p, Evas_Object *img) {
+    memset(p, 0, sizeof(*p));
+    p->front = p->loading = -1;
+    p->img[0] = img;
+    p->img[1] = evas_object_image_filled_add(evas_object_evas_get(img));
+    evas_object_image_filled_set(p->img[1], evas_object_image_filled_get(img));
+    // same smart parent (e.g. the box): stacked and clipped with img, but not packed
+    Evas_Object *parent = evas_object_smart_parent_get(img);
+    if (parent) evas_object_smart_member_add(p->img[1], parent);
+    Evas_Object *clip = evas_object_clip_get(img);
+    if (clip) evas_object_clip_set(p->img[1], clip);
+    for (int i = 0; i < 2; i++)
+        evas_object_event_callback_add(p->img[i], EVAS_CALLBACK_IMAGE_PRELOADED, preloaded_cb, p);
+    evas_object_event_callback_add(img, EVAS_CALLBACK_MOVE, follow_cb, p);
+    evas_object_event_callback_add(img, EVAS_CALLBACK_RESIZE, follow_cb, p);
+    follow_cb(p, NULL, img, NULL);
+}
+
+void st_preview_cleanup(st_preview_t *p) {
+    if (!p->img[0]) return;
+    evas_object_event_callback_del_full(p->img[0], EVAS_CALLBACK_MOVE, follow_cb, p);
+    evas_object_event_callback_del_full(p->img[0], EVAS_CALLBACK_RESIZE, follow_cb, p);
+    evas_object_event_callback_del_full(p->img[0], EVAS_CALLBACK_IMAGE_PRELOADED, preloaded_cb, p);
+    if (p->loading == 0) evas_object_image_preload(p->img[0], EINA_TRUE);
+    evas_object_del(p->img[1]);
+    memset(p, 0, sizeof(*p));
+    p->front = p->loading = -1;
+}
+
+void st_preview_set_file(st_preview_t *p, const char *path) {
+    if (!p->img[0] || !path) return;
+    if (p->loading >= 0 || p->released) {
+        snprintf(p->next, sizeof(p->next), "%s", path);
+        return;
+    }
+    start_load(p, path);
+}
+
+void st_preview_release(st_preview_t *p) {
+    if (!p->img[0] || p->released) return;
+    // newest first: pending, decoding, on screen
+    int b = p->loading >= 0 ? p->loading : p->front;
+    if (!p->next[0] && b >= 0) {
+        const char *file = NULL;
+        evas_object_image_file_get(p->img[b], &file, NULL);
+        if (file) snprintf(p->next, sizeof(p->next), "%s", file);
+    }
+    if (p->loading >= 0) evas_object_image_preload(p->img[p->loading], EINA_TRUE);
+    for (int i = 0; i < 2; i++) {
+        evas_object_hide(p->img[i]);
+        evas_object_image_file_set(p->img[i], NULL, NULL);
+    }
+    evas_image_cache_flush(evas_object_evas_get(p->img[0]));
+    p->front = p->loading = -1;
+    p->released = true;
+}
+
+void st_preview_restore(st_preview_t *p) {
+    if (!p->img[0] || !p->released) return;
+    p->released = false;
+    if (p->next[0]) {
+        char path[sizeof(p->next)];
+        snprintf(path, sizeof(path), "%s", p->next);
+        p->next[0] = '\0';
+        start_load(p, path);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef ST_PREVIEW_H
+#define ST_PREVIEW_H
+
+#include <Elementary.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- IMAGE PREVIEW ----------
+// Setting a capture on the preview used to decode the full camera JPEG
+// synchronously on the main loop, once per frame in live mode. Frames are
+// now decoded by Evas' preload thread at the size the widget is shown
+// (evas_object_image_load_size_set lets the JPEG loader scale down while
+// decoding), into whichever of two buffers is off screen. The frame on
+// screen stays up until the new one is ready; a frame requested while one
+// is decoding replaces any older pending one.
+//
+// img is an Evas image (evas_object_image_filled_add) the caller has
+// packed; a second image is kept over it with the same geometry.
+// Main loop only.
+
+typedef struct {
+    Evas_Object *img[2];    // [0] the caller's image, [1] overlay following its geometry
+    int front;              // buffer on screen, -1 before the first frame
+    int loading;            // buffer being decoded, -1 when idle
+    char next[512];         // newest path requested while decoding, "" none
+    bool released;          // st_preview_release(): nothing decoded until restore
+} st_preview_t;
+
+void st_preview_init(st_preview_t *p, Evas_Object *img);
+void st_preview_cleanup(st_preview_t *p);
+
+// Decodes path in the background and shows it once ready.
+void st_preview_set_file(st_preview_t *p, const char *path);
+
+// Frees both decoded frames (and Evas' image cache) while the app is in
+// the background. Frames set meanwhile are not decoded; restore decodes
+// the newest one (or the one that was shown) again.
+void st_preview_release(st_preview_t *p);
+void st_preview_restore(st_preview_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -53,7 +53,9 @@ typedef struct { char *buf; size_t len; } mem_t;
 static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userdata) {
     mem_t *m = userdata;
     size_t new_len = m->len + size * nmemb;
-    m->buf = realloc(m->buf, new_len + 1);
+    char *buf = realloc(m->buf, new_len + 1);
+    if (!buf) return 0;   // curl fails the transfer; m->buf is still valid and freed by the caller
+    m->buf = buf;
     memcpy(m->buf + m->len, ptr, size * nmemb);
     m->buf[new_len] = '\0';
     m->len = new_len;
@@ -98,6 +100,14 @@ static char* http_post(const char *url, const char *token, const char *payload)
     return m.buf;
 }
 
+// For commands whose response body is not needed.
+static bool http_post_ok(const char *url, const char *token, const char *payload) {
+    char *resp = http_post(url, token, payload);
+    bool ok = resp != NULL;
+    free(resp);
+    return ok;
+}
+
 static bool http_download_file(const char *url, const char *token, const char *save_path) {
     CURL *curl = curl_easy_init();
     if (!curl) return false;
@@ -242,7 +252,7 @@ static void take_image_capture(appdata_s *ad, const char *save_path) {
         "{\"commands\":[{\"component\":\"main\",\"capability\":\"Refresh\","
         "\"command\":\"refresh\",\"arguments\":[]}]}";
 
-    if (http_post(url, ACCESS_TOKEN, payload_refresh) == NULL) {
+    if (!http_post_ok(url, ACCESS_TOKEN, payload_refresh)) {
         printf("Failed to send refresh command.\n");
     }
 
@@ -395,7 +405,7 @@ static void take_image_capture(appdata_s *ad, const char *save_path) {
     // Step 1: Send the refresh command
     ui_log_append(ad, "Sending refresh command...");
 
-    if (http_post(url, ACCESS_TOKEN, payload_refresh) == NULL) {
+    if (!http_post_ok(url, ACCESS_TOKEN, payload_refresh)) {
         printf("Failed to send refresh command.\n");
     }
 
@@ -416,7 +426,7 @@ static void take_image_capture(appdata_s *ad, const char *save_path) {
 
     // Send the combined command
     ui_log_append(ad, "Sending combined refresh and image capture command...");
-    if (http_post(url, ACCESS_TOKEN, payload) == NULL) {
+    if (!http_post_ok(url, ACCESS_TOKEN, payload)) {
         printf("Failed to send combined command.\n");
         return;
     }
@@ -563,7 +573,7 @@ static void take_image_capture(appdata_s *ad, const char *save_path) {
         "{\"commands\":[{\"component\":\"main\",\"capability\":\"Refresh\","
         "\"command\":\"refresh\",\"arguments\":[]}]}";
 
-    if (http_post(url, ACCESS_TOKEN, payload_refresh) == NULL) {
+    if (!http_post_ok(url, ACCESS_TOKEN, payload_refresh)) {
         printf("Failed to send refresh command.\n");
     }
 }
@@ -580,7 +590,7 @@ static void show_caps_clicked(void *data, Evas_Object *obj, void *event_info) {
         "{\"commands\":[{\"component\":\"main\",\"capability\":\"Refresh\","
         "\"command\":\"refresh\",\"arguments\":[]}]}";
 
-        if (http_post(url, ACCESS_TOKEN, payload_refresh) == NULL) {
+        if (!http_post_ok(url, ACCESS_TOKEN, payload_refresh)) {
             printf("Failed to send refresh command.\n");
         }
 
@@ -602,9 +612,10 @@ static Eina_Bool live_loop_cb(void *data) {
     appdata_s *ad = data;
     if (!ad->live_running) return ECORE_CALLBACK_CANCEL;
 
-    const char *data_path = app_get_data_path(); // Get the data directory path
+    char *data_path = app_get_data_path(); // Get the data directory path
     char save_path[512];
     snprintf(save_path, sizeof(save_path), "%scaptured_image.jpg", data_path); // Construct the save path
+    free(data_path);
 
     take_image_capture(ad, save_path); // Save the image in the data directory
     return ad->live_running ? ECORE_CALLBACK_RENEW : ECORE_CALLBACK_CANCEL;
@@ -636,7 +647,7 @@ static void show_caps_clicked(void *data, Evas_Object *obj, void *event_info) {
         "{\"commands\":[{\"component\":\"main\",\"capability\":\"Refresh\","
         "\"command\":\"refresh\",\"arguments\":[]}]}";
 
-        if (http_post(url, ACCESS_TOKEN, payload_refresh) == NULL) {
+        if (!http_post_ok(url, ACCESS_TOKEN, payload_refresh)) {
             printf("Failed to send refresh command.\n");
         }
 
@@ -659,9 +670,10 @@ static Eina_Bool live_loop_cb(void *data) {
     appdata_s *ad = data;
     if (!ad->live_running) return ECORE_CALLBACK_CANCEL;
 
-    const char *data_path = app_get_data_path(); // Get the data directory path
+    char *data_path = app_get_data_path(); // Get the data directory path
     char save_path[512];
     snprintf(save_path, sizeof(save_path), "%scaptured_image.jpg", data_path); // Construct the save path
+    free(data_path);
 
     take_image_capture(ad, save_path); // Save the image in the data directory
     return ad->live_running ? ECORE_CALLBACK_RENEW : ECORE_CALLBACK_CANCEL;
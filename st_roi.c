@@ -0,0 +1,156 @@
+#include "st_roi.h"
+
+#include "st_jpeg_scale.h"
+#include "st_metrics.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "ST_ROI"
+#define CELLS (ST_ROI_GRID_W * ST_ROI_GRID_H)
+
+typedef struct {
+    char device_id[64];
+    int src_w, src_h;
+    unsigned long used;         // g_tick at the last frame, 0: free slot
+    uint8_t luma[CELLS];
+} grid_t;
+
+static grid_t g_grids[ST_ROI_MAX_DEVICES];
+static unsigned long g_tick;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *st_roi_result_name(st_roi_result_e r) {
+    switch (r) {
+    case ST_ROI_CROPPED: return "cropped";
+    case ST_ROI_FIRST: return "first";
+    case ST_ROI_STILL: return "still";
+    case ST_ROI_WIDE: return "wide";
+    default: return "error";
+    }
+}
+
+void st_roi_reset(void) {
+    pthread_mutex_lock(&g_lock);
+    memset(g_grids, 0, sizeof(g_grids));
+    pthread_mutex_unlock(&g_lock);
+}
+
+// Frame at grid size: 1/8 DCT decode, box filtered, BT.601 luma.
+static bool frame_grid(const uint8_t *jpg, size_t len, uint8_t *luma, int *src_w, int *src_h) {
+    uint8_t *rgb = NULL;
+    st_jpeg_scale_info_t si;
+    if (!st_jpeg_decode_rgb(jpg, len, ST_ROI_GRID_W, ST_ROI_GRID_H, &rgb, &si)) return false;
+    for (int i = 0; i < CELLS; i++) {
+        const uint8_t *p = rgb + i * 3;
+        luma[i] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+    free(rgb);
+    *src_w = si.src_w;
+    *src_h = si.src_h;
+    return true;
+}
+
+// Stores the new grid and copies the previous one into prev; false when
+// there was none at this frame size.
+static bool grid_swap(const char *device_id, const uint8_t *luma, int w, int h, uint8_t *prev) {
+    pthread_mutex_lock(&g_lock);
+    grid_t *g = NULL, *lru = &g_grids[0];
+    for (int i = 0; i < ST_ROI_MAX_DEVICES; i++) {
+        if (g_grids[i].used && strcmp(g_grids[i].device_id, device_id) == 0) { g = &g_grids[i]; break; }
+        if (g_grids[i].used < lru->used) lru = &g_grids[i];
+    }
+    bool had = g && g->src_w == w && g->src_h == h;
+    if (had) memcpy(prev, g->luma, CELLS);
+    if (!g) {
+        g = lru;
+        snprintf(g->device_id, sizeof(g->device_id), "%s", device_id);
+    }
+    g->src_w = w;
+    g->src_h = h;
+    g->used = ++g_tick;
+    memcpy(g->luma, luma, CELLS);
+    pthread_mutex_unlock(&g_lock);
+    return had;
+}
+
+// Grows [*lo, *lo + *len) to at least min around its centre, inside [0, limit).
+static void span_grow(int *lo, int *len, int min, int limit) {
+    if (min > limit) min = limit;
+    if (*len < min) {
+        *lo -= (min - *len) / 2;
+        *len = min;
+    }
+    if (*lo < 0) *lo = 0;
+    if (*lo + *len > limit) *lo = limit - *len;
+    if (*lo < 0) { *lo = 0; *len = limit; }
+}
+
+static st_roi_result_e roi_count(st_roi_result_e r) {
+    char labels[32];
+    snprintf(labels, sizeof(labels), "result=\"%s\"", st_roi_result_name(r));
+    st_metric_inc(st_metrics_counter("st_roi_frames_total", labels));
+    return r;
+}
+
+st_roi_result_e st_roi_crop(const char *device_id, const uint8_t *jpg, size_t len,
+                            const st_roi_cfg_t *cfg, int max_dim, int quality,
+                            uint8_t **out, size_t *out_len, st_roi_info_t *info) {
+    *out = NULL;
+    *out_len = 0;
+    st_roi_info_t ri;
+    memset(&ri, 0, sizeof(ri));
+    if (info) *info = ri;
+    if (!device_id || !cfg) return ST_ROI_ERROR;
+
+    uint8_t cur[CELLS], prev[CELLS];
+    if (!frame_grid(jpg, len, cur, &ri.src_w, &ri.src_h)) return roi_count(ST_ROI_ERROR);
+    if (info) *info = ri;
+    if (!grid_swap(device_id, cur, ri.src_w, ri.src_h, prev)) return roi_count(ST_ROI_FIRST);
+
+    int x0 = ST_ROI_GRID_W, y0 = ST_ROI_GRID_H, x1 = -1, y1 = -1;
+    for (int y = 0; y < ST_ROI_GRID_H; y++) {
+        for (int x = 0; x < ST_ROI_GRID_W; x++) {
+            int d = cur[y * ST_ROI_GRID_W + x] - prev[y * ST_ROI_GRID_W + x];
+            if (d < 0) d = -d;
+            if (d <= cfg->threshold) continue;
+            ri.changed++;
+            if (x < x0) x0 = x;
+            if (x > x1) x1 = x;
+            if (y < y0) y0 = y;
+            if (y > y1) y1 = y;
+        }
+    }
+    if (info) *info = ri;
+    if (ri.changed < cfg->min_cells) return roi_count(ST_ROI_STILL);
+
+    // cells -> source pixels, then pad and the minimum size
+    ri.x = (int)((long long)x0 * ri.src_w / ST_ROI_GRID_W);
+    ri.y = (int)((long long)y0 * ri.src_h / ST_ROI_GRID_H);
+    ri.w = (int)((long long)(x1 + 1) * ri.src_w / ST_ROI_GRID_W) - ri.x;
+    ri.h = (int)((long long)(y1 + 1) * ri.src_h / ST_ROI_GRID_H) - ri.y;
+    int px = (int)(ri.w * cfg->pad), py = (int)(ri.h * cfg->pad);
+    ri.x -= px;
+    ri.y -= py;
+    ri.w += 2 * px;
+    ri.h += 2 * py;
+    if (ri.x < 0) { ri.w += ri.x; ri.x = 0; }
+    if (ri.y < 0) { ri.h += ri.y; ri.y = 0; }
+    span_grow(&ri.x, &ri.w, cfg->min_dim, ri.src_w);
+    span_grow(&ri.y, &ri.h, cfg->min_dim, ri.src_h);
+    if (info) *info = ri;
+    if ((double)ri.w * ri.h > cfg->max_area * ri.src_w * ri.src_h) return roi_count(ST_ROI_WIDE);
+
+    st_jpeg_scale_info_t si;
+    if (!st_jpeg_crop(jpg, len, ri.x, ri.y, ri.w, ri.h, max_dim, quality, out, out_len, &si)) {
+        dlog_print(DLOG_WARN, LOG_TAG, "crop %dx%d+%d+%d failed", ri.w, ri.h, ri.x, ri.y);
+        return roi_count(ST_ROI_ERROR);
+    }
+    ri.out_w = si.out_w;
+    ri.out_h = si.out_h;
+    if (info) *info = ri;
+    return roi_count(ST_ROI_CROPPED);
+}
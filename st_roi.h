@@ -0,0 +1,75 @@
+#ifndef ST_ROI_H
+#define ST_ROI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- REGION OF INTEREST ----------
+// VLM prefill scales with image tokens, and what a camera frame adds over
+// the previous one is usually a person somewhere in a corner. Each device
+// keeps a luma grid (ST_ROI_GRID_W x ST_ROI_GRID_H cells) of its last
+// evaluated frame. The next frame is decoded at 1/8 scale into the same
+// grid, cells whose mean luma moved by more than threshold count as
+// changed, and the frame is cropped to their bounding box plus pad.
+// Only that region is decoded at full size (st_jpeg_crop) and sent.
+//
+// The full frame still goes out:
+//   - for the device's first frame (nothing to compare against);
+//   - when fewer than min_cells changed (noise or an empty scene);
+//   - when the box covers more than max_area of the frame, e.g. lights
+//     switching on or the camera moving.
+// Crops are grown to at least min_dim source pixels per side, so the
+// model keeps some context around a small change.
+// The grid is replaced by every frame passed in. Thread-safe.
+
+#define ST_ROI_GRID_W 64
+#define ST_ROI_GRID_H 36
+#define ST_ROI_MAX_DEVICES 16       // least recently used grid is dropped
+
+typedef struct {
+    int threshold;              // mean luma change (0..255) of a changed cell
+    int min_cells;
+    double pad;                 // share of the box size added on every side
+    double max_area;            // share of the frame above which no crop is made
+    int min_dim;                // smallest crop side, source pixels
+} st_roi_cfg_t;
+
+#define ST_ROI_CFG_DEFAULT { 18, 3, 0.25, 0.6, 384 }
+
+typedef enum {
+    ST_ROI_CROPPED,
+    ST_ROI_FIRST,               // no previous frame for this device
+    ST_ROI_STILL,               // fewer than min_cells changed
+    ST_ROI_WIDE,                // change covers more than max_area
+    ST_ROI_ERROR,               // not a decodable JPEG
+} st_roi_result_e;
+
+typedef struct {
+    int src_w, src_h;
+    int x, y, w, h;             // crop in source pixels (ST_ROI_CROPPED)
+    int out_w, out_h;           // encoded size
+    int changed;                // changed cells
+} st_roi_info_t;
+
+// Compares jpg with the device's previous frame and, on ST_ROI_CROPPED,
+// sets *out to a malloc'd JPEG of the region, longest side at most max_dim
+// (0: crop size). Any other result leaves *out NULL; send the frame as usual.
+st_roi_result_e st_roi_crop(const char *device_id, const uint8_t *jpg, size_t len,
+                            const st_roi_cfg_t *cfg, int max_dim, int quality,
+                            uint8_t **out, size_t *out_len, st_roi_info_t *info);
+
+const char *st_roi_result_name(st_roi_result_e r);
+
+// Drops every cached grid.
+void st_roi_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
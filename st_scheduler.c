@@ -0,0 +1,206 @@
+#include "st_scheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void st_sched_init(st_scheduler_t *s, size_t max_inflight) {
+    memset(s, 0, sizeof(*s));
+    s->max_inflight = max_inflight ? max_inflight : 1;
+    s->calls_per_capture = ST_SCHED_CALLS_PER_CAPTURE;
+    snprintf(s->accounts[0].name, sizeof(s->accounts[0].name), "default");
+    s->account_count = 1;
+}
+
+static int effective_interval(const st_scheduler_t *s, const st_sched_device_t *d) {
+    double iv = d->interval_sec;
+    double lat = d->avg_duration_sec * ST_SCHED_LATENCY_FACTOR;
+    if (lat > iv) iv = lat;
+    if (s->budget_per_min > 0 && s->count) {
+        double share = s->count * s->calls_per_capture * 60.0 / s->budget_per_min;
+        if (share > iv) iv = share;
+    }
+    const st_sched_account_t *a = &s->accounts[d->account];
+    if (a->budget_per_min > 0 && a->devices) {
+        double share = a->devices * s->calls_per_capture * 60.0 / a->budget_per_min;
+        if (share > iv) iv = share;
+    }
+    return (int)ceil(iv);
+}
+
+static void update_intervals(st_scheduler_t *s) {
+    for (size_t i = 0; i < s->count; i++)
+        s->devs[i].effective_interval_sec = effective_interval(s, &s->devs[i]);
+}
+
+int st_sched_find_account(const st_scheduler_t *s, const char *name) {
+    for (size_t i = 0; name && i < s->account_count; i++)
+        if (strcmp(s->accounts[i].name, name) == 0) return (int)i;
+    return -1;
+}
+
+int st_sched_account(st_scheduler_t *s, const char *name) {
+    if (!name || !*name) return 0;
+    int a = st_sched_find_account(s, name);
+    if (a >= 0 || s->account_count >= ST_SCHED_MAX_ACCOUNTS) return a;
+    st_sched_account_t *acct = &s->accounts[s->account_count];
+    memset(acct, 0, sizeof(*acct));
+    snprintf(acct->name, sizeof(acct->name), "%s", name);
+    return (int)s->account_count++;
+}
+
+void st_sched_set_account_limits(st_scheduler_t *s, int account, size_t max_inflight, double calls_per_min) {
+    if (account < 0 || (size_t)account >= s->account_count) return;
+    s->accounts[account].max_inflight = max_inflight;
+    s->accounts[account].budget_per_min = calls_per_min > 0 ? calls_per_min : 0;
+    update_intervals(s);
+}
+
+st_sched_device_t *st_sched_add(st_scheduler_t *s, const char *id, const char *name, int interval_sec) {
+    return st_sched_add_to(s, 0, NULL, id, name, interval_sec);
+}
+
+st_sched_device_t *st_sched_add_to(st_scheduler_t *s, int account, const char *location,
+                                   const char *id, const char *name, int interval_sec) {
+    if (!id || !*id || s->count >= ST_SCHED_MAX_DEVICES) return NULL;
+    if (account < 0 || (size_t)account >= s->account_count) return NULL;
+    for (size_t i = 0; i < s->count; i++)
+        if (strcmp(s->devs[i].id, id) == 0) return &s->devs[i];
+
+    st_sched_device_t *d = &s->devs[s->count++];
+    memset(d, 0, sizeof(*d));
+    snprintf(d->id, sizeof(d->id), "%s", id);
+    snprintf(d->name, sizeof(d->name), "%s", (name && *name) ? name : id);
+    d->account = account;
+    snprintf(d->location, sizeof(d->location), "%s", location ? location : "");
+    s->accounts[account].devices++;
+    d->interval_sec = interval_sec > 0 ? interval_sec : 30;
+    d->next_due = 0;            // due on the first live tick
+    update_intervals(s);        // one more device shares the budget
+    return d;
+}
+
+int st_sched_load(st_scheduler_t *s, const char *path, int default_interval_sec) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[512];
+    char location[64] = "";
+    int added = 0, account = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n#")] = '\0';
+        char id[64] = {0};
+        int interval = default_interval_sec;
+        int n = 0;
+        if (sscanf(line, " [%31[^] \t]%n", id, &n) == 1) {
+            // [account location...]: the devices below, up to the next section
+            const char *loc = line + n + strspn(line + n, " \t");
+            snprintf(location, sizeof(location), "%.*s", (int)strcspn(loc, "]"), loc);
+            account = st_sched_account(s, id);     // -1: table full, the section is skipped
+            continue;
+        }
+        if (account < 0) continue;
+        if (sscanf(line, "%63s%n", id, &n) != 1) continue;
+
+        char *rest = line + n;
+        int m = 0;
+        if (sscanf(rest, "%d%n", &interval, &m) == 1) rest += m;
+        else interval = default_interval_sec;
+        while (*rest == ' ' || *rest == '\t') rest++;
+
+        if (st_sched_add_to(s, account, location, id, rest, interval)) added++;
+    }
+    fclose(fp);
+    return added;
+}
+
+void st_sched_trigger_all(st_scheduler_t *s) {
+    for (size_t i = 0; i < s->count; i++) s->devs[i].forced = true;
+}
+
+st_sched_device_t *st_sched_find(st_scheduler_t *s, const char *id) {
+    for (size_t i = 0; i < s->count; i++)
+        if (strcmp(s->devs[i].id, id) == 0) return &s->devs[i];
+    return NULL;
+}
+
+st_sched_device_t *st_sched_trigger(st_scheduler_t *s, const char *id) {
+    st_sched_device_t *d = st_sched_find(s, id);
+    if (d) d->forced = true;
+    return d;
+}
+
+void st_sched_set_interval(st_scheduler_t *s, st_sched_device_t *d, int interval_sec) {
+    if (!d || interval_sec <= 0) return;
+    double last_start = d->next_due - d->effective_interval_sec;
+    d->interval_sec = interval_sec;
+    d->effective_interval_sec = effective_interval(s, d);
+    if (d->next_due > 0) d->next_due = last_start + d->effective_interval_sec;
+}
+
+st_sched_device_t *st_sched_next(st_scheduler_t *s, double now, bool live) {
+    if (s->inflight >= s->max_inflight) return NULL;
+
+    st_sched_device_t *best = NULL;
+    for (size_t i = 0; i < s->count; i++) {
+        st_sched_device_t *d = &s->devs[i];
+        if (d->busy) continue;
+        const st_sched_account_t *a = &s->accounts[d->account];
+        if (a->max_inflight && a->inflight >= a->max_inflight) continue;
+        if (!d->forced && (!live || d->next_due > now)) continue;
+        // forced first, then the most overdue
+        if (!best || (d->forced && !best->forced) ||
+            (d->forced == best->forced && d->next_due < best->next_due))
+            best = d;
+    }
+    if (best) {
+        best->busy = true;
+        best->forced = false;
+        s->inflight++;
+        s->accounts[best->account].inflight++;
+    }
+    return best;
+}
+
+void st_sched_done(st_scheduler_t *s, st_sched_device_t *d, bool ok, double started, double now) {
+    if (!d || !d->busy) return;
+    d->busy = false;
+    d->worker = NULL;
+    if (s->inflight) s->inflight--;
+    if (s->accounts[d->account].inflight) s->accounts[d->account].inflight--;
+    d->last_duration_sec = now - started;
+    d->avg_duration_sec = d->avg_duration_sec > 0
+        ? 0.7 * d->avg_duration_sec + 0.3 * d->last_duration_sec
+        : d->last_duration_sec;
+    if (ok) d->captures++;
+    else d->failures++;
+    d->effective_interval_sec = effective_interval(s, d);
+    // interval is measured start-to-start, so slow captures do not drift
+    d->next_due = started + d->effective_interval_sec;
+    if (d->next_due < now) d->next_due = now;
+}
+
+void st_sched_set_budget(st_scheduler_t *s, double calls_per_min) {
+    s->budget_per_min = calls_per_min > 0 ? calls_per_min : 0;
+    update_intervals(s);
+}
+
+void st_sched_note_calls(st_scheduler_t *s, unsigned long total_calls) {
+    unsigned long captures = 0;
+    for (size_t i = 0; i < s->count; i++) captures += s->devs[i].captures + s->devs[i].failures;
+    if (total_calls < s->calls_mark) s->calls_mark = total_calls;
+    // a few captures per sample, so one capture's polling does not swing it
+    if (captures < s->captures_mark + 3) return;
+    double per = (double)(total_calls - s->calls_mark) / (double)(captures - s->captures_mark);
+    s->calls_per_capture = 0.7 * s->calls_per_capture + 0.3 * per;
+    s->calls_mark = total_calls;
+    s->captures_mark = captures;
+    update_intervals(s);
+}
+
+double st_sched_rate_per_min(const st_scheduler_t *s) {
+    double rate = 0;
+    for (size_t i = 0; i < s->count; i++)
+        if (s->devs[i].effective_interval_sec > 0) rate += 60.0 / s->devs[i].effective_interval_sec;
+    return rate;
+}
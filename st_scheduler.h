@@ -0,0 +1,125 @@
+#ifndef ST_SCHEDULER_H
+#define ST_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- MULTI-DEVICE CAPTURE SCHEDULER ----------
+// Keeps the list of cameras, each with its own capture interval, and hands
+// out the most overdue idle device while fewer than max_inflight captures
+// are running. The scheduler only decides *what* runs next; the app runs
+// each capture on its own worker and reports back with st_sched_done().
+// Not thread-safe: call it from the main loop only.
+//
+// Device file format (one device per line, '#' comments):
+//   <deviceId> [interval_sec] [display name...]
+// Devices of more than one account or location are grouped in sections:
+//   [<account> [location...]]
+// Devices before the first section belong to account 0 ("default").
+//
+// The configured interval is a lower bound. A device whose captures take
+// long is spaced at ST_SCHED_LATENCY_FACTOR times its average capture time,
+// and with an API budget set every device gets at most an equal share of
+// it (captures x measured calls per capture <= budget_per_min). An account
+// may add a budget and an inflight limit of its own, shared only by its
+// devices, so one account's many cameras neither starve the others of
+// capture slots nor spend the others' API calls.
+
+#define ST_SCHED_MAX_DEVICES 128
+#define ST_SCHED_LATENCY_FACTOR 2.0     // busy at most half the time
+#define ST_SCHED_CALLS_PER_CAPTURE 6.0  // initial estimate until measured
+#define ST_SCHED_MAX_ACCOUNTS 16
+
+typedef struct {
+    char name[32];
+    size_t max_inflight;        // 0 -> only the scheduler's limit
+    size_t inflight;
+    double budget_per_min;      // API calls per minute for its devices, 0 -> only the global budget
+    size_t devices;
+} st_sched_account_t;
+
+typedef struct {
+    char id[64];
+    char name[128];
+    int account;                // index into st_scheduler_t.accounts
+    char location[64];          // "" when the section names none
+    int interval_sec;
+    double next_due;            // epoch seconds
+    bool busy;
+    bool forced;                // capture on the next dispatch regardless of interval
+    void *worker;               // app handle for the running capture (for cancel)
+    unsigned captures;
+    unsigned failures;
+    double last_duration_sec;
+    double avg_duration_sec;    // moving average of capture latency
+    int effective_interval_sec; // interval actually used, see above
+    // last frame that was evaluated, for skipping repeats (owned by the app)
+    char last_image_url[512];
+    uint64_t last_frame_hash;
+    unsigned duplicates;
+} st_sched_device_t;
+
+typedef struct {
+    st_sched_device_t devs[ST_SCHED_MAX_DEVICES];
+    size_t count;
+    size_t max_inflight;
+    size_t inflight;
+    double budget_per_min;      // API calls per minute for all captures, 0 -> unlimited
+    st_sched_account_t accounts[ST_SCHED_MAX_ACCOUNTS];
+    size_t account_count;       // >= 1: accounts[0] is "default"
+    double calls_per_capture;
+    unsigned long calls_mark, captures_mark;    // last st_sched_note_calls sample
+} st_scheduler_t;
+
+void st_sched_init(st_scheduler_t *s, size_t max_inflight);
+// Adds a device to account 0.
+st_sched_device_t *st_sched_add(st_scheduler_t *s, const char *id, const char *name, int interval_sec);
+// Adds a device to account (an index); NULL when full or account is unknown.
+st_sched_device_t *st_sched_add_to(st_scheduler_t *s, int account, const char *location,
+                                   const char *id, const char *name, int interval_sec);
+
+// Index of the account called name, created without limits of its own
+// when it is new; -1 when the table is full.
+int st_sched_account(st_scheduler_t *s, const char *name);
+// -1 when there is no account called name.
+int st_sched_find_account(const st_scheduler_t *s, const char *name);
+// Limits of one account (0: none of its own beyond the scheduler's).
+void st_sched_set_account_limits(st_scheduler_t *s, int account, size_t max_inflight, double calls_per_min);
+
+// Appends devices from a file; returns how many were added, -1 if unreadable.
+int st_sched_load(st_scheduler_t *s, const char *path, int default_interval_sec);
+
+// Marks every device due now (one-shot sweep).
+void st_sched_trigger_all(st_scheduler_t *s);
+// Marks one device due now, live or not; NULL when id is unknown.
+st_sched_device_t *st_sched_trigger(st_scheduler_t *s, const char *id);
+
+st_sched_device_t *st_sched_find(st_scheduler_t *s, const char *id);
+// Changes the configured interval (e.g. to a heartbeat for triggered cameras).
+void st_sched_set_interval(st_scheduler_t *s, st_sched_device_t *d, int interval_sec);
+
+// Next device to start, or NULL when none is due or the pool is full.
+// Devices whose account is at its inflight limit wait, the others are
+// still dispatched. live=false only dispatches forced devices. Marks the
+// device busy.
+st_sched_device_t *st_sched_next(st_scheduler_t *s, double now, bool live);
+
+void st_sched_done(st_scheduler_t *s, st_sched_device_t *d, bool ok, double started, double now);
+
+void st_sched_set_budget(st_scheduler_t *s, double calls_per_min);
+// Feeds the running total of API calls made; the calls-per-capture estimate
+// is updated from the calls and captures since the previous sample.
+void st_sched_note_calls(st_scheduler_t *s, unsigned long total_calls);
+// Captures per minute over all devices at the current effective intervals.
+double st_sched_rate_per_min(const st_scheduler_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
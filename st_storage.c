@@ -0,0 +1,262 @@
+#include "st_storage.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "ST_STORAGE"
+#define INDEX_NAME "captures.idx"
+
+typedef st_storage_entry_t entry_t;
+
+typedef struct write_req {
+    struct write_req *next;
+    char name[128];
+    void *data;
+    size_t len;
+    st_storage_done_fn done;
+    void *ctx;
+} write_req_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_writer;
+static bool g_running = false;
+static bool g_stop = false;
+static write_req_t *g_queue_head = NULL, *g_queue_tail = NULL;
+
+static st_storage_cfg_t g_cfg;
+static char g_dir[256];
+// index, oldest first; touched by the writer thread and st_storage_usage
+static entry_t *g_entries = NULL;
+static size_t g_count = 0, g_cap = 0;
+static long long g_bytes = 0;
+static st_storage_removed_fn g_removed;
+static void *g_removed_ctx;
+
+// ---------- INDEX ----------
+static void index_path(char *out, size_t len, const char *suffix) {
+    snprintf(out, len, "%s" INDEX_NAME "%s", g_dir, suffix);
+}
+
+static bool entry_push(long long when, long long bytes, const char *name) {
+    if (g_count == g_cap) {
+        size_t cap = g_cap ? g_cap * 2 : 256;
+        entry_t *p = realloc(g_entries, cap * sizeof(*p));
+        if (!p) return false;
+        g_entries = p;
+        g_cap = cap;
+    }
+    entry_t *e = &g_entries[g_count++];
+    e->when = when;
+    e->bytes = bytes;
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    g_bytes += bytes;
+    return true;
+}
+
+static void index_load(void) {
+    char path[320];
+    index_path(path, sizeof(path), "");
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    char line[256], name[128];
+    long long when, bytes;
+    while (fgets(line, sizeof(line), fp))
+        if (sscanf(line, "%lld %lld %127s", &when, &bytes, name) == 3) entry_push(when, bytes, name);
+    fclose(fp);
+}
+
+static void index_rewrite(void) {
+    char path[320], tmp[330];
+    index_path(path, sizeof(path), "");
+    index_path(tmp, sizeof(tmp), ".tmp");
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return;
+    for (size_t i = 0; i < g_count; i++)
+        fprintf(fp, "%lld %lld %s\n", g_entries[i].when, g_entries[i].bytes, g_entries[i].name);
+    if (fclose(fp) == 0) rename(tmp, path);
+}
+
+static void index_append(const entry_t *e) {
+    char path[320];
+    index_path(path, sizeof(path), "");
+    FILE *fp = fopen(path, "a");
+    if (!fp) return;
+    fprintf(fp, "%lld %lld %s\n", e->when, e->bytes, e->name);
+    fclose(fp);
+}
+
+// Deletes the oldest files until every limit holds; caller holds g_lock.
+// Returns how many were deleted.
+static size_t enforce_limits(long long now) {
+    size_t drop = 0;
+    long long bytes = g_bytes;
+    while (drop < g_count) {
+        const entry_t *e = &g_entries[drop];
+        bool over = (g_cfg.max_files > 0 && g_count - drop > (size_t)g_cfg.max_files) ||
+                    (g_cfg.quota_bytes > 0 && bytes > g_cfg.quota_bytes) ||
+                    (g_cfg.max_age_sec > 0 && now - e->when > g_cfg.max_age_sec);
+        if (!over) break;
+        char path[400];
+        snprintf(path, sizeof(path), "%s%s", g_dir, e->name);
+        remove(path);
+        if (g_removed) g_removed(e->name, g_removed_ctx);
+        bytes -= e->bytes;
+        drop++;
+    }
+    if (drop) {
+        memmove(g_entries, g_entries + drop, (g_count - drop) * sizeof(*g_entries));
+        g_count -= drop;
+        g_bytes = bytes;
+    }
+    return drop;
+}
+
+// ---------- WRITER ----------
+static bool write_file(const write_req_t *r) {
+    char path[400], part[410];
+    snprintf(path, sizeof(path), "%s%s", g_dir, r->name);
+    snprintf(part, sizeof(part), "%s.part", path);
+    FILE *fp = fopen(part, "wb");
+    if (!fp) return false;
+    bool ok = fwrite(r->data, 1, r->len, fp) == r->len;
+    ok = fclose(fp) == 0 && ok;
+    if (ok) ok = rename(part, path) == 0;
+    if (!ok) remove(part);
+    return ok;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (!g_queue_head && !g_stop) pthread_cond_wait(&g_cond, &g_lock);
+        write_req_t *r = g_queue_head;
+        if (!r) break;
+        g_queue_head = r->next;
+        if (!g_queue_head) g_queue_tail = NULL;
+        pthread_mutex_unlock(&g_lock);
+
+        bool ok = write_file(r);
+        if (!ok) dlog_print(DLOG_ERROR, LOG_TAG, "write %s failed", r->name);
+
+        pthread_mutex_lock(&g_lock);
+        if (ok) {
+            long long now = (long long)time(NULL);
+            if (entry_push(now, (long long)r->len, r->name)) {
+                if (enforce_limits(now)) index_rewrite();
+                else index_append(&g_entries[g_count - 1]);
+            }
+        }
+        pthread_mutex_unlock(&g_lock);
+
+        if (r->done) {
+            char path[400];
+            snprintf(path, sizeof(path), "%s%s", g_dir, r->name);
+            r->done(path, ok, r->ctx);
+        }
+        free(r->data);
+        free(r);
+        pthread_mutex_lock(&g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+// ---------- API ----------
+bool st_storage_open(const st_storage_cfg_t *cfg) {
+    pthread_mutex_lock(&g_lock);
+    if (g_running) { pthread_mutex_unlock(&g_lock); return true; }
+    g_cfg = *cfg;
+    snprintf(g_dir, sizeof(g_dir), "%s", cfg->dir);
+    g_cfg.dir = g_dir;
+    g_count = 0;
+    g_bytes = 0;
+    index_load();
+    // limits may have been lowered since the last run
+    if (enforce_limits((long long)time(NULL))) index_rewrite();
+    g_stop = false;
+    g_running = pthread_create(&g_writer, NULL, writer_main, NULL) == 0;
+    bool ok = g_running;
+    pthread_mutex_unlock(&g_lock);
+    if (!ok) dlog_print(DLOG_ERROR, LOG_TAG, "could not start storage writer");
+    return ok;
+}
+
+void st_storage_close(void) {
+    pthread_mutex_lock(&g_lock);
+    if (!g_running) { pthread_mutex_unlock(&g_lock); return; }
+    g_stop = true;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_writer, NULL);
+
+    pthread_mutex_lock(&g_lock);
+    g_running = false;
+    free(g_entries);
+    g_entries = NULL;
+    g_count = g_cap = 0;
+    g_bytes = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+bool st_storage_put(const char *name, void *data, size_t len,
+                    st_storage_done_fn done, void *ctx) {
+    write_req_t *r = calloc(1, sizeof(*r));
+    if (!r || !name || strchr(name, '/') || strlen(name) >= sizeof(r->name)) {
+        free(r);
+        free(data);
+        return false;
+    }
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->data = data;
+    r->len = len;
+    r->done = done;
+    r->ctx = ctx;
+
+    pthread_mutex_lock(&g_lock);
+    if (!g_running || g_stop) {
+        pthread_mutex_unlock(&g_lock);
+        free(r);
+        free(data);
+        return false;
+    }
+    if (g_queue_tail) g_queue_tail->next = r;
+    else g_queue_head = r;
+    g_queue_tail = r;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+size_t st_storage_usage(long long *bytes) {
+    pthread_mutex_lock(&g_lock);
+    size_t n = g_count;
+    if (bytes) *bytes = g_bytes;
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+size_t st_storage_list(const char *prefix, long long since, st_storage_entry_t *out, size_t max) {
+    size_t plen = prefix ? strlen(prefix) : 0, n = 0;
+    pthread_mutex_lock(&g_lock);
+    for (size_t i = g_count; i-- > 0 && n < max;) {
+        const entry_t *e = &g_entries[i];
+        if (e->when < since) break;     // oldest first, so the rest is older still
+        if (plen && strncmp(e->name, prefix, plen) != 0) continue;
+        out[n++] = *e;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+void st_storage_on_remove(st_storage_removed_fn fn, void *ctx) {
+    pthread_mutex_lock(&g_lock);
+    g_removed = fn;
+    g_removed_ctx = ctx;
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,65 @@
+#ifndef ST_STORAGE_H
+#define ST_STORAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- CAPTURE STORAGE ----------
+// Every capture leaves files in the pictures folder and nothing ever
+// deleted them. Files handed to st_storage_put() are written by one
+// background thread (as <name>.part, then renamed, so readers never see a
+// half-written file) and recorded in an index file (<dir>captures.idx:
+// "<epoch> <bytes> <name>" per line). After each write the oldest entries
+// are deleted until the count, age and byte limits hold again. The index
+// is the only state read at startup; the folder is never scanned.
+//
+// Only files written through st_storage are managed. Thread-safe.
+
+typedef struct {
+    const char *dir;            // with trailing '/'
+    int max_files;              // 0 -> unlimited
+    int max_age_sec;            // 0 -> unlimited
+    long long quota_bytes;      // 0 -> unlimited
+} st_storage_cfg_t;
+
+typedef struct {
+    long long when;             // epoch seconds the write completed
+    long long bytes;
+    char name[128];
+} st_storage_entry_t;
+
+// Called on the writer thread once the file is in place (ok) or failed.
+typedef void (*st_storage_done_fn)(const char *path, bool ok, void *ctx);
+// Called for every managed file the limits delete (name relative to dir),
+// with the storage lock held: it must not call back into st_storage.
+typedef void (*st_storage_removed_fn)(const char *name, void *ctx);
+
+bool st_storage_open(const st_storage_cfg_t *cfg);
+// Finishes queued writes, then stops the writer.
+void st_storage_close(void);
+
+// Takes ownership of data (malloc'd; freed after the write, also on
+// failure). name is relative to dir. done may be NULL.
+bool st_storage_put(const char *name, void *data, size_t len,
+                    st_storage_done_fn done, void *ctx);
+
+// Managed files and their total size.
+size_t st_storage_usage(long long *bytes);
+
+// Copies up to max entries, newest first, whose name starts with prefix
+// (NULL: any) and that were written at or after since (0: any). Returns
+// how many were copied.
+size_t st_storage_list(const char *prefix, long long since, st_storage_entry_t *out, size_t max);
+
+// Set before st_storage_open() to also see the deletions made there.
+void st_storage_on_remove(st_storage_removed_fn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
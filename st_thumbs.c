@@ -0,0 +1,188 @@
+#include "st_thumbs.h"
+
+#include "st_jpeg_scale.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define LOG_TAG "ST_THUMBS"
+#define NAME_MAX_LEN 128
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static bool g_open = false;
+static bool g_stop = false;
+static st_thumbs_cfg_t g_cfg;
+static char g_src_dir[256], g_dir[256];
+static st_thumbs_ready_fn g_ready;
+static void *g_ready_ctx;
+
+// pending requests, oldest first; the worker takes the last one
+static char g_queue[ST_THUMBS_QUEUE][NAME_MAX_LEN];
+static size_t g_queued;
+
+static bool valid_name(const char *name) {
+    return name && *name && !strchr(name, '/') && strlen(name) < NAME_MAX_LEN;
+}
+
+// caller holds g_lock
+static bool queue_remove(const char *name) {
+    for (size_t i = 0; i < g_queued; i++) {
+        if (strcmp(g_queue[i], name) != 0) continue;
+        memmove(g_queue[i], g_queue[i + 1], (g_queued - i - 1) * NAME_MAX_LEN);
+        g_queued--;
+        return true;
+    }
+    return false;
+}
+
+// ---------- WORKER ----------
+static uint8_t *read_all(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    uint8_t *buf = NULL;
+    long n = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    if (n > 0 && fseek(fp, 0, SEEK_SET) == 0 && (buf = malloc((size_t)n))) {
+        if (fread(buf, 1, (size_t)n, fp) != (size_t)n) {
+            free(buf);
+            buf = NULL;
+        }
+    }
+    fclose(fp);
+    *len = buf ? (size_t)n : 0;
+    return buf;
+}
+
+static bool write_atomic(const char *path, const uint8_t *data, size_t len) {
+    char part[410];
+    snprintf(part, sizeof(part), "%s.part", path);
+    FILE *fp = fopen(part, "wb");
+    if (!fp) return false;
+    bool ok = fwrite(data, 1, len, fp) == len;
+    ok = fclose(fp) == 0 && ok;
+    if (ok) ok = rename(part, path) == 0;
+    if (!ok) remove(part);
+    return ok;
+}
+
+static bool make_thumb(const char *name, const char *thumb) {
+    char src[400];
+    snprintf(src, sizeof(src), "%s%s", g_src_dir, name);
+    size_t len;
+    uint8_t *jpg = read_all(src, &len);
+    if (!jpg) return false;
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+    st_jpeg_scale_info_t si;
+    bool ok;
+    if (st_jpeg_downscale(jpg, len, g_cfg.max_dim, g_cfg.quality, &out, &out_len, &si)) {
+        ok = write_atomic(thumb, out, out_len);
+        free(out);
+    } else {
+        // small already (or not a JPEG: then the viewer's loader fails on it too)
+        uint8_t *rgb = NULL;
+        ok = st_jpeg_decode_rgb(jpg, len, 1, 1, &rgb, &si) && write_atomic(thumb, jpg, len);
+        free(rgb);
+    }
+    free(jpg);
+    return ok;
+}
+
+static void *thumbs_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (!g_queued && !g_stop) pthread_cond_wait(&g_cond, &g_lock);
+        if (g_stop) break;
+        char name[NAME_MAX_LEN];
+        snprintf(name, sizeof(name), "%s", g_queue[--g_queued]);
+        pthread_mutex_unlock(&g_lock);
+
+        char thumb[400];
+        bool ok = st_thumbs_path(name, thumb, sizeof(thumb)) || make_thumb(name, thumb);
+        if (!ok) dlog_print(DLOG_WARN, LOG_TAG, "no thumbnail for %s", name);
+        g_ready(name, ok ? thumb : NULL, g_ready_ctx);
+
+        pthread_mutex_lock(&g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+// ---------- API ----------
+bool st_thumbs_open(const st_thumbs_cfg_t *cfg, st_thumbs_ready_fn ready, void *ctx) {
+    if (!cfg || !cfg->src_dir || !cfg->dir || !ready) return false;
+    pthread_mutex_lock(&g_lock);
+    if (g_open) { pthread_mutex_unlock(&g_lock); return true; }
+    g_cfg = *cfg;
+    if (g_cfg.max_dim < 16) g_cfg.max_dim = 16;
+    snprintf(g_src_dir, sizeof(g_src_dir), "%s", cfg->src_dir);
+    snprintf(g_dir, sizeof(g_dir), "%s", cfg->dir);
+    mkdir(g_dir, 0755);
+    g_ready = ready;
+    g_ready_ctx = ctx;
+    g_queued = 0;
+    g_stop = false;
+    g_open = pthread_create(&g_thread, NULL, thumbs_main, NULL) == 0;
+    bool ok = g_open;
+    pthread_mutex_unlock(&g_lock);
+    if (!ok) dlog_print(DLOG_ERROR, LOG_TAG, "could not start the thumbnail worker");
+    return ok;
+}
+
+void st_thumbs_close(void) {
+    pthread_mutex_lock(&g_lock);
+    if (!g_open) { pthread_mutex_unlock(&g_lock); return; }
+    g_stop = true;
+    g_queued = 0;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    pthread_join(g_thread, NULL);
+    pthread_mutex_lock(&g_lock);
+    g_open = false;
+    pthread_mutex_unlock(&g_lock);
+}
+
+bool st_thumbs_path(const char *name, char *path, size_t len) {
+    if (!valid_name(name) || !g_dir[0]) return false;
+    snprintf(path, len, "%s%s", g_dir, name);
+    struct stat st;
+    return stat(path, &st) == 0 && st.st_size > 0;
+}
+
+bool st_thumbs_request(const char *name) {
+    if (!valid_name(name)) return false;
+    pthread_mutex_lock(&g_lock);
+    if (!g_open || g_stop) { pthread_mutex_unlock(&g_lock); return false; }
+    queue_remove(name);
+    if (g_queued == ST_THUMBS_QUEUE) {
+        // oldest request: scrolled past long ago
+        memmove(g_queue[0], g_queue[1], (ST_THUMBS_QUEUE - 1) * NAME_MAX_LEN);
+        g_queued--;
+    }
+    snprintf(g_queue[g_queued++], NAME_MAX_LEN, "%s", name);
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+    return true;
+}
+
+void st_thumbs_cancel(const char *name) {
+    pthread_mutex_lock(&g_lock);
+    if (!name) g_queued = 0;
+    else queue_remove(name);
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_thumbs_forget(const char *name) {
+    char path[400];
+    if (!valid_name(name) || !g_dir[0]) return;     // never opened
+    st_thumbs_cancel(name);
+    snprintf(path, sizeof(path), "%s%s", g_dir, name);
+    remove(path);
+}
@@ -0,0 +1,57 @@
+#ifndef ST_THUMBS_H
+#define ST_THUMBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- CAPTURE THUMBNAILS ----------
+// Browsing the stored captures must not decode full camera frames. Every
+// capture gets a thumbnail file <dir><name>. It is made once, on one
+// background thread, by st_jpeg_downscale (DCT-scaled decode, box filter,
+// re-encode), and is kept in dir from then on. A viewer asks for the
+// items it shows: requests are served newest first, so the ones scrolled
+// into view jump ahead of those scrolled past. Items that leave the view
+// are cancelled. A bounded queue drops its oldest request when full.
+//
+// Thumbnails are not tracked separately. Whatever deletes a capture calls
+// st_thumbs_forget() (e.g. from st_storage_on_remove). Thread-safe.
+
+#define ST_THUMBS_QUEUE 64
+
+typedef struct {
+    const char *src_dir;        // captures, with trailing '/'
+    const char *dir;            // thumbnails, with trailing '/' (created)
+    int max_dim;                // longest thumbnail side
+    int quality;
+} st_thumbs_cfg_t;
+
+#define ST_THUMBS_CFG_DEFAULT { NULL, NULL, 240, 75 }
+
+// Runs on the worker thread. thumb is the file to show (NULL when name is
+// not a readable JPEG).
+typedef void (*st_thumbs_ready_fn)(const char *name, const char *thumb, void *ctx);
+
+bool st_thumbs_open(const st_thumbs_cfg_t *cfg, st_thumbs_ready_fn ready, void *ctx);
+// Drops queued requests and stops the worker after the one in progress.
+void st_thumbs_close(void);
+
+// Thumbnail path of name; true when it exists already, so it can be shown
+// without a request.
+bool st_thumbs_path(const char *name, char *path, size_t len);
+// Queues name ahead of earlier requests; a name already queued moves up.
+// ready fires once it is done. False when not open or name is invalid.
+bool st_thumbs_request(const char *name);
+// Withdraws a queued request (NULL: all of them).
+void st_thumbs_cancel(const char *name);
+// Deletes the thumbnail of a removed capture.
+void st_thumbs_forget(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
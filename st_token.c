@@ -0,0 +1,495 @@
+#include "st_token.h"
+
+#include "st_base64.h"
+#include "st_http.h"
+#include "st_json_path.h"
+#include "st_metrics.h"
+
+#include <dlog.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_TOKEN"
+
+typedef struct {
+    char client_id[256];
+    char client_secret[256];
+    char refresh_token[1024];
+    char access_token[1024];
+    char expires_in[64];
+    time_t expires_at;
+} creds_t;
+
+// Immutable published copy of the access token. Readers load snap and
+// copy from it without the lock; a replaced snapshot is kept on the
+// retired chain until cleanup (one per refresh, about one a day).
+typedef struct tok_snap {
+    struct tok_snap *retired;
+    time_t expires_at;
+    uint32_t gen;                       // shared->gen this copy was read at
+    char token[];
+} tok_snap_t;
+
+// <path>.lock, shared by every app using the same token file: flock on it
+// serializes refreshes across processes, and its mapped page carries a
+// generation bumped on each rewrite so the others reload instead of
+// refreshing (and rotating the refresh token) themselves.
+typedef struct {
+    _Atomic uint32_t gen;
+} shared_t;
+
+// One token file. The default instance backs st_token_init/get/...; an
+// account of its own is opened with st_token_open.
+struct st_token {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    creds_t creds;
+    _Atomic(tok_snap_t *) snap;
+    int lock_fd;
+    shared_t *shared;                   // NULL: no lock file, this process only
+    uint32_t gen;                       // generation creds was read at
+    char path[512];
+    bool loaded;
+    bool refreshing;
+    bool bg_pending;                    // background refresh started, not yet running
+    time_t bg_retry_at;                 // backoff after a failed background refresh
+    // Basic auth for the client never changes, and the form body only when
+    // the refresh token rotates, so both are built once and reused. Only
+    // touched by the refresh in flight (or before any can start).
+    char auth[832];
+    char form[1100];
+    char form_token[1024];              // refresh token form was built for
+};
+
+static st_token_t g_default = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .lock_fd = -1,
+};
+
+#define BG_RETRY_SEC 30
+
+// ---------- FILE ----------
+static bool read_kv_file(const char *path, creds_t *t) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return false;
+    char line[1536];
+    while (fgets(line, sizeof(line), fp)) {
+        char *eq = strchr(line, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        char *key = line, *val = eq + 1;
+        val[strcspn(val, "\r\n")] = '\0';
+        if (strcmp(key, "client_id") == 0) snprintf(t->client_id, sizeof(t->client_id), "%s", val);
+        else if (strcmp(key, "client_secret") == 0) snprintf(t->client_secret, sizeof(t->client_secret), "%s", val);
+        else if (strcmp(key, "refresh_token") == 0) snprintf(t->refresh_token, sizeof(t->refresh_token), "%s", val);
+        else if (strcmp(key, "access_token") == 0) snprintf(t->access_token, sizeof(t->access_token), "%s", val);
+        else if (strcmp(key, "expires_in") == 0) snprintf(t->expires_in, sizeof(t->expires_in), "%s", val);
+        else if (strcmp(key, "expires_at") == 0) t->expires_at = (time_t)atoll(val);
+    }
+    fclose(fp);
+
+    // files written before expires_at existed: expires_in counts from the last write
+    struct stat st;
+    if (!t->expires_at && atol(t->expires_in) > 0 && stat(path, &st) == 0)
+        t->expires_at = st.st_mtime + atol(t->expires_in);
+    return true;
+}
+
+static bool write_all(int fd, const char *p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// tmp + fsync + rename: a crash leaves either the old file or the new one.
+static bool write_atomic(const char *path, const char *data, size_t len) {
+    char tmp[520];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return false;
+    bool ok = write_all(fd, data, len) && fsync(fd) == 0;
+    if (close(fd) != 0) ok = false;
+    if (ok && rename(tmp, path) != 0) ok = false;
+    if (!ok) unlink(tmp);
+    return ok;
+}
+
+static bool write_kv_file(const char *path, const creds_t *t) {
+    char buf[sizeof(creds_t) + 128];
+    int n = snprintf(buf, sizeof(buf),
+                     "client_id=%s\nclient_secret=%s\nrefresh_token=%s\naccess_token=%s\nexpires_in=%s\nexpires_at=%lld\n",
+                     t->client_id, t->client_secret, t->refresh_token, t->access_token, t->expires_in,
+                     (long long)t->expires_at);
+    return n > 0 && (size_t)n < sizeof(buf) && write_atomic(path, buf, (size_t)n);
+}
+
+// Caller holds k->lock.
+static void publish_locked(st_token_t *k) {
+    tok_snap_t *old = atomic_load_explicit(&k->snap, memory_order_relaxed);
+    tok_snap_t *n = NULL;
+    if (k->loaded) {
+        size_t len = strlen(k->creds.access_token);
+        n = malloc(sizeof(*n) + len + 1);
+        if (!n) return;                 // readers keep the previous token
+        n->expires_at = k->creds.expires_at;
+        n->gen = k->gen;
+        memcpy(n->token, k->creds.access_token, len + 1);
+        n->retired = old;
+    }
+    atomic_store_explicit(&k->snap, n, memory_order_release);
+    if (!n) {
+        while (old) { tok_snap_t *r = old->retired; free(old); old = r; }
+    }
+}
+
+// ---------- SHARED ----------
+static void shared_open(st_token_t *k, const char *path) {
+    char lock[520];
+    snprintf(lock, sizeof(lock), "%s.lock", path);
+    int fd = open(lock, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        dlog_print(DLOG_WARN, LOG_TAG, "no %s, refresh is not shared", lock);
+        return;
+    }
+    struct stat st;
+    void *m = MAP_FAILED;
+    // ftruncate only grows a new (zero-filled) file; gen starts at 0
+    if (fstat(fd, &st) == 0 && (st.st_size >= (off_t)sizeof(shared_t) || ftruncate(fd, sizeof(shared_t)) == 0))
+        m = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        dlog_print(DLOG_WARN, LOG_TAG, "cannot map %s, refresh is not shared", lock);
+        close(fd);
+        return;
+    }
+    k->lock_fd = fd;
+    k->shared = m;
+}
+
+static void shared_close(st_token_t *k) {
+    if (k->shared) munmap(k->shared, sizeof(shared_t));
+    if (k->lock_fd >= 0) close(k->lock_fd);
+    k->shared = NULL;
+    k->lock_fd = -1;
+}
+
+static uint32_t shared_gen(const st_token_t *k) {
+    return k->shared ? atomic_load_explicit(&k->shared->gen, memory_order_acquire) : 0;
+}
+
+static bool snap_current(const st_token_t *k, const tok_snap_t *s) {
+    return s->gen == shared_gen(k);
+}
+
+// Caller holds k->lock. Picks up a file another process rewrote.
+static void sync_locked(st_token_t *k) {
+    if (!k->loaded || k->refreshing) return;
+    uint32_t gen = shared_gen(k);
+    if (gen == k->gen) return;
+    creds_t t;
+    memset(&t, 0, sizeof(t));
+    // read after the generation: a rewrite meanwhile is seen on the next call
+    if (read_kv_file(k->path, &t) && (t.access_token[0] || t.refresh_token[0])) k->creds = t;
+    k->gen = gen;
+    publish_locked(k);
+}
+
+bool st_token_seed(const char *path, const char *seed) {
+    struct stat st;
+    if (!path || stat(path, &st) == 0) return true;
+    FILE *fp = seed ? fopen(seed, "rb") : NULL;
+    if (!fp) return false;
+    char buf[sizeof(creds_t) + 128];
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    bool ok = !ferror(fp) && feof(fp);
+    fclose(fp);
+    return ok && write_atomic(path, buf, n);
+}
+
+// ---------- REFRESH ----------
+static void prepare_auth(st_token_t *k, const creds_t *t) {
+    char credentials[600];
+    snprintf(credentials, sizeof(credentials), "%s:%s", t->client_id, t->client_secret);
+    char b64[812];
+    b64[st_b64_encode((const uint8_t *)credentials, strlen(credentials), b64)] = '\0';
+    snprintf(k->auth, sizeof(k->auth), "Basic %s", b64);
+}
+
+static const char *form_body(st_token_t *k, const creds_t *t) {
+    if (!k->form[0] || strcmp(k->form_token, t->refresh_token) != 0) {
+        snprintf(k->form_token, sizeof(k->form_token), "%s", t->refresh_token);
+        snprintf(k->form, sizeof(k->form), "grant_type=refresh_token&refresh_token=%s", t->refresh_token);
+    }
+    return k->form;
+}
+
+// Network part of a refresh; works on a private copy, no lock held.
+// Goes through the pooled, verified TLS connection like every API call.
+static bool refresh_grant(st_token_t *k, creds_t *t) {
+    st_http_req_t req = {
+        .url = ST_TOKEN_URL,
+        .auth_header = k->auth,
+        .content_type = "application/x-www-form-urlencoded",
+        .body = form_body(k, t),
+    };
+    st_buf_t m = {0};
+    st_http_info_t info;
+    if (!st_http_perform(&req, &m, NULL, &info)) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "refresh failed (HTTP %ld)", info.status);
+        free(m.buf);
+        return false;
+    }
+
+    char acc[sizeof(t->access_token)], ref[sizeof(t->refresh_token)], exp[32];
+    st_json_target_t tg[] = {
+        { "access_token", acc, sizeof(acc), false },
+        { "refresh_token", ref, sizeof(ref), false },
+        { "expires_in", exp, sizeof(exp), false },
+    };
+    st_json_extract(m.buf, m.len, tg, 3);
+    free(m.buf);
+    if (!tg[0].found || !acc[0]) {
+        dlog_print(DLOG_ERROR, LOG_TAG, "refresh reply has no access_token");
+        return false;
+    }
+    snprintf(t->access_token, sizeof(t->access_token), "%s", acc);
+    if (tg[1].found && ref[0]) snprintf(t->refresh_token, sizeof(t->refresh_token), "%s", ref);
+    long lifetime = tg[2].found ? atol(exp) : 0;
+    if (lifetime <= 0) lifetime = ST_TOKEN_DEFAULT_LIFETIME_SEC;
+    snprintf(t->expires_in, sizeof(t->expires_in), "%ld", lifetime);
+    t->expires_at = time(NULL) + lifetime;
+    return true;
+}
+
+// Single flight. Caller holds k->lock; it is released while on the wire.
+// The caller that finds a refresh running waits for it instead, in this
+// process through k->done and in other processes through the flock. The
+// file is re-read under the flock: a token another process refreshed
+// meanwhile is adopted, and otherwise its (rotated) refresh token is used.
+static void refresh_locked(st_token_t *k) {
+    if (k->refreshing) {
+        while (k->refreshing) pthread_cond_wait(&k->done, &k->lock);
+        return;
+    }
+    k->refreshing = true;
+    creds_t work = k->creds;
+    pthread_mutex_unlock(&k->lock);
+
+    if (k->lock_fd >= 0) flock(k->lock_fd, LOCK_EX);
+    uint32_t gen = shared_gen(k);
+    creds_t disk;
+    memset(&disk, 0, sizeof(disk));
+    bool adopted = false, ok = false;
+    if (read_kv_file(k->path, &disk) && disk.refresh_token[0]) {
+        adopted = disk.access_token[0] && strcmp(disk.access_token, work.access_token) != 0 &&
+                  (!disk.expires_at || time(NULL) < disk.expires_at);
+        work = disk;
+    }
+    if (!adopted && (ok = refresh_grant(k, &work))) {
+        if (write_kv_file(k->path, &work)) {
+            if (k->shared) gen = atomic_fetch_add_explicit(&k->shared->gen, 1, memory_order_acq_rel) + 1;
+        } else {
+            dlog_print(DLOG_WARN, LOG_TAG, "could not save %s", k->path);
+        }
+    }
+    if (k->lock_fd >= 0) flock(k->lock_fd, LOCK_UN);
+    st_metric_inc(st_metrics_counter("st_token_refreshes_total",
+                                     adopted ? "result=\"adopted\"" : ok ? "result=\"ok\"" : "result=\"failed\""));
+
+    pthread_mutex_lock(&k->lock);
+    if (ok || adopted) {
+        k->creds = work;
+        k->gen = gen;
+        publish_locked(k);
+        if (ok) dlog_print(DLOG_INFO, LOG_TAG, "%s refreshed, valid for %s s", k->path, k->creds.expires_in);
+        else dlog_print(DLOG_INFO, LOG_TAG, "%s refreshed by another app", k->path);
+    }
+    k->refreshing = false;
+    pthread_cond_broadcast(&k->done);
+}
+
+static bool in_ahead_window(const st_token_t *k, time_t now) {
+    return k->creds.expires_at && now >= k->creds.expires_at - ST_TOKEN_REFRESH_AHEAD_SEC;
+}
+
+static void *refresh_thread(void *arg) {
+    st_token_t *k = arg;
+    pthread_mutex_lock(&k->lock);
+    k->bg_pending = false;
+    sync_locked(k);
+    // a foreground refresh may have renewed the token meanwhile
+    if (in_ahead_window(k, time(NULL))) {
+        char before[sizeof(k->creds.access_token)];
+        memcpy(before, k->creds.access_token, sizeof(before));
+        refresh_locked(k);
+        if (strcmp(before, k->creds.access_token) == 0) k->bg_retry_at = time(NULL) + BG_RETRY_SEC;
+    }
+    pthread_cond_broadcast(&k->done);
+    pthread_mutex_unlock(&k->lock);
+    return NULL;
+}
+
+// Caller holds k->lock.
+static void refresh_background(st_token_t *k) {
+    if (k->refreshing || k->bg_pending || time(NULL) < k->bg_retry_at) return;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t th;
+    if (pthread_create(&th, &attr, refresh_thread, k) == 0)
+        k->bg_pending = true;
+    else
+        dlog_print(DLOG_WARN, LOG_TAG, "could not start background refresh");
+    pthread_attr_destroy(&attr);
+}
+
+// ---------- INSTANCES ----------
+static bool token_load(st_token_t *k, const char *path) {
+    creds_t t;
+    memset(&t, 0, sizeof(t));
+    if (!path || !read_kv_file(path, &t)) return false;
+
+    pthread_mutex_lock(&k->lock);
+    if (!k->shared) shared_open(k, path);
+    k->gen = shared_gen(k);
+    k->creds = t;
+    prepare_auth(k, &t);
+    snprintf(k->path, sizeof(k->path), "%s", path);
+    k->loaded = t.access_token[0] || t.refresh_token[0];
+    bool ok = k->loaded;
+    publish_locked(k);
+    pthread_mutex_unlock(&k->lock);
+    return ok;
+}
+
+static void token_unload(st_token_t *k) {
+    pthread_mutex_lock(&k->lock);
+    while (k->refreshing || k->bg_pending) pthread_cond_wait(&k->done, &k->lock);
+    memset(&k->creds, 0, sizeof(k->creds));
+    memset(k->auth, 0, sizeof(k->auth));
+    memset(k->form, 0, sizeof(k->form));
+    k->loaded = false;
+    publish_locked(k);
+    shared_close(k);
+    pthread_mutex_unlock(&k->lock);
+}
+
+st_token_t *st_token_open(const char *path) {
+    st_token_t *k = calloc(1, sizeof(*k));
+    if (!k) return NULL;
+    pthread_mutex_init(&k->lock, NULL);
+    pthread_cond_init(&k->done, NULL);
+    k->lock_fd = -1;
+    if (!token_load(k, path)) {
+        st_token_close(k);
+        return NULL;
+    }
+    return k;
+}
+
+void st_token_close(st_token_t *k) {
+    if (!k || k == &g_default) return;
+    token_unload(k);
+    pthread_cond_destroy(&k->done);
+    pthread_mutex_destroy(&k->lock);
+    free(k);
+}
+
+st_token_t *st_token_default(void) {
+    return &g_default;
+}
+
+bool st_token_available_for(st_token_t *k) {
+    const tok_snap_t *s = atomic_load_explicit(&k->snap, memory_order_acquire);
+    return s && s->token[0];
+}
+
+time_t st_token_expires_at_for(st_token_t *k) {
+    const tok_snap_t *s = atomic_load_explicit(&k->snap, memory_order_acquire);
+    return s ? s->expires_at : 0;
+}
+
+char *st_token_get_for(st_token_t *k) {
+    // fast path: a token well inside its lifetime, that no other app has
+    // replaced, needs no lock
+    const tok_snap_t *s = atomic_load_explicit(&k->snap, memory_order_acquire);
+    if (s && s->token[0] && s->expires_at && snap_current(k, s) &&
+        time(NULL) < s->expires_at - ST_TOKEN_REFRESH_AHEAD_SEC)
+        return strdup(s->token);
+
+    pthread_mutex_lock(&k->lock);
+    if (!k->loaded) { pthread_mutex_unlock(&k->lock); return NULL; }
+    sync_locked(k);
+    time_t now = time(NULL);
+    if (!k->creds.access_token[0] || (k->creds.expires_at && now >= k->creds.expires_at))
+        refresh_locked(k);
+    else if (in_ahead_window(k, now))
+        refresh_background(k);
+    // an expired token whose refresh failed is still handed out; the API decides
+    char *tok = k->creds.access_token[0] ? strdup(k->creds.access_token) : NULL;
+    pthread_mutex_unlock(&k->lock);
+    return tok;
+}
+
+char *st_token_refresh_for(st_token_t *k, const char *rejected) {
+    pthread_mutex_lock(&k->lock);
+    if (!k->loaded) { pthread_mutex_unlock(&k->lock); return NULL; }
+    sync_locked(k);
+    if (k->refreshing || !rejected || strcmp(rejected, k->creds.access_token) == 0)
+        refresh_locked(k);
+    char *tok = k->creds.access_token[0] ? strdup(k->creds.access_token) : NULL;
+    pthread_mutex_unlock(&k->lock);
+    return tok;
+}
+
+void st_token_maintain_for(st_token_t *k) {
+    const tok_snap_t *s = atomic_load_explicit(&k->snap, memory_order_acquire);
+    if (!s || (snap_current(k, s) && (!s->expires_at || time(NULL) < s->expires_at - ST_TOKEN_REFRESH_AHEAD_SEC)))
+        return;
+    pthread_mutex_lock(&k->lock);
+    sync_locked(k);
+    if (k->loaded && in_ahead_window(k, time(NULL))) refresh_background(k);
+    pthread_mutex_unlock(&k->lock);
+}
+
+// ---------- DEFAULT ACCOUNT ----------
+bool st_token_init(const char *path) {
+    return token_load(&g_default, path);
+}
+
+void st_token_cleanup(void) {
+    token_unload(&g_default);
+}
+
+bool st_token_available(void) {
+    return st_token_available_for(&g_default);
+}
+
+time_t st_token_expires_at(void) {
+    return st_token_expires_at_for(&g_default);
+}
+
+char *st_token_get(void) {
+    return st_token_get_for(&g_default);
+}
+
+char *st_token_refresh(const char *rejected) {
+    return st_token_refresh_for(&g_default, rejected);
+}
+
+void st_token_maintain(void) {
+    st_token_maintain_for(&g_default);
+}
@@ -0,0 +1,86 @@
+#ifndef ST_TOKEN_H
+#define ST_TOKEN_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- TOKEN LIFECYCLE ----------
+// Owns the OAuth credentials from token.txt (key=value lines). Expiry is
+// tracked as an absolute time (expires_at, written next to expires_in), so
+// the token is known to be good without a validation request at startup.
+//
+//  - st_token_get() returns the current token; close to expiry it starts
+//    a background refresh, and it only blocks when the token has expired
+//  - concurrent refreshes are coalesced into one flight: callers that
+//    arrive while a refresh is running wait for its result
+//  - st_token_refresh() is for a request that still got a 401; it is a
+//    no-op when another thread already replaced the rejected token
+//  - the file is read once; the access token is then served from memory
+//    without taking a lock unless it is due for a refresh
+//  - the file is only rewritten when a refresh changed it, through a
+//    fsync'd temp file renamed over it, so a crash never leaves it torn
+//  - apps sharing the token file share its refreshes: a refresh holds a
+//    flock on <path>.lock, and the generation counter mapped from that
+//    file tells the other apps to reload, so one refresh (and one
+//    refresh-token rotation) serves all of them
+//
+// All functions are thread-safe; st_token_cleanup() must not race with
+// the others.
+//
+// The functions without a handle work on the default token file
+// (st_token_init). Every further account has its own file, opened with
+// st_token_open, and the same lifecycle through the *_for functions.
+
+#define ST_TOKEN_URL "https://auth-global.api.smartthings.com/oauth/token"
+#define ST_TOKEN_REFRESH_AHEAD_SEC 300      // refresh this long before expiry
+#define ST_TOKEN_DEFAULT_LIFETIME_SEC 86400 // when the server omits expires_in
+
+// Creates path as an atomic copy of seed when it does not exist yet.
+// True when path exists afterwards.
+bool st_token_seed(const char *path, const char *seed);
+
+// Loads path. False when it is missing or has no access/refresh token.
+bool st_token_init(const char *path);
+void st_token_cleanup(void);
+
+bool st_token_available(void);
+
+// Absolute expiry (epoch seconds); 0 when unknown.
+time_t st_token_expires_at(void);
+
+// malloc'd copy of a usable access token (caller frees), NULL when none.
+char *st_token_get(void);
+
+// Forces a refresh unless rejected is no longer the current token.
+// Returns the new token like st_token_get().
+char *st_token_refresh(const char *rejected);
+
+// Starts a background refresh when inside the refresh-ahead window.
+// Cheap; meant to be called from a periodic timer.
+void st_token_maintain(void);
+
+// ---------- PER-ACCOUNT TOKENS ----------
+typedef struct st_token st_token_t;
+
+// Loads path like st_token_init; NULL when it is missing or unusable.
+st_token_t *st_token_open(const char *path);
+// Waits for a refresh in flight. The default instance is never closed here.
+void st_token_close(st_token_t *tok);
+// The instance behind st_token_init/get/...
+st_token_t *st_token_default(void);
+
+bool st_token_available_for(st_token_t *tok);
+time_t st_token_expires_at_for(st_token_t *tok);
+char *st_token_get_for(st_token_t *tok);
+char *st_token_refresh_for(st_token_t *tok, const char *rejected);
+void st_token_maintain_for(st_token_t *tok);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
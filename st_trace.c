@@ -0,0 +1,147 @@
+#include "st_trace.h"
+
+#include "st_metrics.h"
+
+#include <dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "ST_TRACE"
+
+typedef struct {
+    const char *name;
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    st_metric_t *hist;          // st_stage_ms{stage="<name>"}
+} stage_t;
+
+typedef struct {
+    const char *name;
+    uint64_t start_us;
+    uint64_t dur_us;
+    long tid;
+} event_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static stage_t g_stages[ST_TRACE_MAX_STAGES];
+static int g_nstages = 0;
+static bool g_record = false;
+static event_t g_events[ST_TRACE_MAX_EVENTS];
+static size_t g_ev_head = 0;
+static size_t g_ev_count = 0;
+
+uint64_t st_trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+st_span_t st_span_begin(const char *name) {
+    st_span_t s = { name, st_trace_now_us() };
+    return s;
+}
+
+// Caller holds g_lock.
+static stage_t *stage_for(const char *name) {
+    for (int i = 0; i < g_nstages; i++)
+        if (g_stages[i].name == name) return &g_stages[i];
+    for (int i = 0; i < g_nstages; i++)
+        if (strcmp(g_stages[i].name, name) == 0) return &g_stages[i];
+    if (g_nstages >= ST_TRACE_MAX_STAGES) return NULL;
+    stage_t *s = &g_stages[g_nstages++];
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    char labels[ST_METRICS_MAX_LABELS];
+    snprintf(labels, sizeof(labels), "stage=\"%s\"", name);
+    s->hist = st_metrics_histogram("st_stage_ms", labels);
+    return s;
+}
+
+void st_span_end(st_span_t *span) {
+    if (!span || !span->name) return;
+    uint64_t end = st_trace_now_us();
+    uint64_t dur = end - span->start_us;
+
+    st_metric_t *hist = NULL;
+    pthread_mutex_lock(&g_lock);
+    stage_t *s = stage_for(span->name);
+    if (s) {
+        s->count++;
+        s->total_us += dur;
+        if (dur > s->max_us) s->max_us = dur;
+        hist = s->hist;
+    }
+    if (g_record) {
+        event_t *e = &g_events[g_ev_head];
+        e->name = span->name;
+        e->start_us = span->start_us;
+        e->dur_us = dur;
+        e->tid = (long)syscall(SYS_gettid);
+        g_ev_head = (g_ev_head + 1) % ST_TRACE_MAX_EVENTS;
+        if (g_ev_count < ST_TRACE_MAX_EVENTS) g_ev_count++;
+    }
+    pthread_mutex_unlock(&g_lock);
+    st_metric_observe(hist, (double)dur / 1000.0);
+    span->name = NULL;
+}
+
+void st_trace_record_events(bool on) {
+    pthread_mutex_lock(&g_lock);
+    g_record = on;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void st_trace_reset(void) {
+    pthread_mutex_lock(&g_lock);
+    g_nstages = 0;
+    g_ev_head = g_ev_count = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+size_t st_trace_summary(char *buf, size_t len) {
+    size_t n = 0;
+    if (len) buf[0] = '\0';
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_nstages && n < len; i++) {
+        const stage_t *s = &g_stages[i];
+        double avg = s->count ? (double)s->total_us / (double)s->count / 1000.0 : 0;
+        int w = snprintf(buf + n, len - n, "%-14s n=%-5llu avg=%8.1f max=%8.1f total=%10.1f ms\n",
+                         s->name, (unsigned long long)s->count, avg,
+                         (double)s->max_us / 1000.0, (double)s->total_us / 1000.0);
+        if (w < 0) break;
+        n += (size_t)w < len - n ? (size_t)w : len - n - 1;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+void st_trace_dump_dlog(void) {
+    char buf[ST_TRACE_MAX_STAGES * 96];
+    st_trace_summary(buf, sizeof(buf));
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        dlog_print(DLOG_INFO, LOG_TAG, "%s", line);
+}
+
+bool st_trace_write_chrome(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return false;
+    pid_t pid = getpid();
+    fputs("{\"traceEvents\":[\n", fp);
+    pthread_mutex_lock(&g_lock);
+    size_t first = (g_ev_head + ST_TRACE_MAX_EVENTS - g_ev_count) % ST_TRACE_MAX_EVENTS;
+    for (size_t i = 0; i < g_ev_count; i++) {
+        const event_t *e = &g_events[(first + i) % ST_TRACE_MAX_EVENTS];
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%ld}\n",
+                i ? "," : "", e->name, (unsigned long long)e->start_us,
+                (unsigned long long)e->dur_us, (int)pid, e->tid);
+    }
+    pthread_mutex_unlock(&g_lock);
+    fputs("],\"displayTimeUnit\":\"ms\"}\n", fp);
+    return fclose(fp) == 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ST_TRACE_H
+#define ST_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- TRACING SPANS ----------
+// Monotonic-clock spans with per-stage counters (count / total / max) so a
+// capture's latency can be split into SmartThings time and our own work.
+//
+//   ST_TRACE_SCOPE("cap.download");          // ends at the closing brace
+//   st_span_t s = st_span_begin("http.get"); ... st_span_end(&s);
+//
+// Stage names must be string literals (stats are keyed by the pointer).
+// Every stage also feeds the st_stage_ms{stage="<name>"} histogram of the
+// metrics registry (st_metrics.h).
+// When event recording is enabled, finished spans also go into a bounded
+// ring that can be written as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev). All functions are thread-safe.
+
+#define ST_TRACE_MAX_STAGES 32
+#define ST_TRACE_MAX_EVENTS 4096
+
+typedef struct {
+    const char *name;
+    uint64_t start_us;
+} st_span_t;
+
+uint64_t st_trace_now_us(void);
+
+st_span_t st_span_begin(const char *name);
+void st_span_end(st_span_t *span);
+
+static inline void st_span_cleanup_(st_span_t *s) { st_span_end(s); }
+#define ST_TRACE_CAT2_(a, b) a##b
+#define ST_TRACE_CAT_(a, b) ST_TRACE_CAT2_(a, b)
+#define ST_TRACE_SCOPE(name) \
+    st_span_t ST_TRACE_CAT_(st_span_, __LINE__) __attribute__((cleanup(st_span_cleanup_))) = st_span_begin(name)
+
+// Keeps finished spans for st_trace_write_chrome (off by default).
+void st_trace_record_events(bool on);
+void st_trace_reset(void);
+
+// One line per stage: "name  n=  avg=  max=  total=" (all in ms).
+size_t st_trace_summary(char *buf, size_t len);
+void st_trace_dump_dlog(void);
+bool st_trace_write_chrome(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
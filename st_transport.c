@@ -0,0 +1,97 @@
+#include "st_transport.h"
+
+#include <dlog.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "ST_TRANSPORT"
+#define API_BASE "https://api.smartthings.com/v1"
+
+static st_local_channel_t g_local;
+static void *g_local_ctx;
+static atomic_bool g_have_local;        // published after g_local/g_local_ctx are written
+static atomic_ulong g_local_calls, g_cloud_calls, g_fallbacks;
+
+void st_transport_set_local(const st_local_channel_t *ch, void *ctx) {
+    atomic_store(&g_have_local, false);
+    if (!ch) return;
+    g_local = *ch;
+    g_local_ctx = ctx;
+    atomic_store(&g_have_local, true);
+}
+
+bool st_transport_local_up(void) {
+    return atomic_load(&g_have_local) && g_local.connected && g_local.connected(g_local_ctx);
+}
+
+static st_path_e cloud(const st_http_req_t *req, st_buf_t *out) {
+    st_http_info_t info;
+    if (!req->bearer) return ST_PATH_NONE;
+    if (!st_http_perform(req, out, NULL, &info)) {
+        free(out->buf);
+        out->buf = NULL;
+        out->len = 0;
+        return ST_PATH_NONE;
+    }
+    atomic_fetch_add(&g_cloud_calls, 1);
+    return ST_PATH_CLOUD;
+}
+
+// The local attempt; a decline or failure leaves out empty.
+static bool local_done(bool ok, st_buf_t *out, const char *what, const char *device_id) {
+    if (ok && out->buf) {
+        atomic_fetch_add(&g_local_calls, 1);
+        return true;
+    }
+    free(out->buf);
+    out->buf = NULL;
+    out->len = 0;
+    atomic_fetch_add(&g_fallbacks, 1);
+    dlog_print(DLOG_INFO, LOG_TAG, "%s %s: local channel failed, using REST", what, device_id);
+    return false;
+}
+
+st_path_e st_transport_status(const char *device_id, const char *token, st_buf_t *out) {
+    out->buf = NULL;
+    out->len = 0;
+    if (st_transport_local_up() && g_local.status &&
+        local_done(g_local.status(device_id, out, g_local_ctx), out, "status", device_id))
+        return ST_PATH_LOCAL;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/devices/%s/status", API_BASE, device_id);
+    st_http_req_t req = { .url = url, .bearer = token };
+    return cloud(&req, out);
+}
+
+st_path_e st_transport_command(const char *device_id, const char *token,
+                               const char *commands_json, st_buf_t *out) {
+    out->buf = NULL;
+    out->len = 0;
+    if (st_transport_local_up() && g_local.command &&
+        local_done(g_local.command(device_id, commands_json, out, g_local_ctx), out, "command", device_id))
+        return ST_PATH_LOCAL;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/devices/%s/commands", API_BASE, device_id);
+    st_http_req_t req = { .url = url, .bearer = token,
+                          .content_type = "application/json; charset=utf-8", .body = commands_json };
+    return cloud(&req, out);
+}
+
+const char *st_path_str(st_path_e path) {
+    switch (path) {
+    case ST_PATH_LOCAL: return "local";
+    case ST_PATH_CLOUD: return "cloud";
+    case ST_PATH_NONE:  break;
+    }
+    return "none";
+}
+
+void st_transport_counts(unsigned long *local, unsigned long *cloud_calls, unsigned long *fallbacks) {
+    if (local) *local = atomic_load(&g_local_calls);
+    if (cloud_calls) *cloud_calls = atomic_load(&g_cloud_calls);
+    if (fallbacks) *fallbacks = atomic_load(&g_fallbacks);
+}
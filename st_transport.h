@@ -0,0 +1,59 @@
+#ifndef ST_TRANSPORT_H
+#define ST_TRANSPORT_H
+
+#include <stdbool.h>
+
+#include "st_http.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- DEVICE TRANSPORT ----------
+// Device status reads and commands either go over a local channel (the
+// SmartThings client SDK session the app keeps open) or over cloud REST
+// (/devices/{id}/status, /devices/{id}/commands with the OAuth token).
+// While the channel reports connected, it is tried first. When it declines
+// or fails, the call falls back to REST. Every call returns the path that
+// actually answered, so callers can log it or show it.
+//
+// The local channel is a set of callbacks registered by the app, since only
+// the app owns the SDK handle. The callbacks return the same JSON as the REST
+// endpoints: a status document, or the commands reply. A local call needs no
+// token, so token may be NULL when no REST fallback is wanted.
+
+typedef enum {
+    ST_PATH_NONE,               // neither path answered
+    ST_PATH_LOCAL,
+    ST_PATH_CLOUD,
+} st_path_e;
+
+typedef struct {
+    bool (*connected)(void *ctx);
+    // true when handled; out->buf is malloc'd (caller frees). NULL: not offered.
+    bool (*status)(const char *device_id, st_buf_t *out, void *ctx);
+    // commands_json is the REST body: {"commands":[...]}
+    bool (*command)(const char *device_id, const char *commands_json, st_buf_t *out, void *ctx);
+} st_local_channel_t;
+
+// ch NULL unregisters; calls already past the connected check still use
+// the old channel, so its ctx must outlive them. Registering a new channel
+// is not to be done while requests are in flight.
+void st_transport_set_local(const st_local_channel_t *ch, void *ctx);
+bool st_transport_local_up(void);
+
+// out->buf holds the reply (caller frees) unless ST_PATH_NONE is returned.
+st_path_e st_transport_status(const char *device_id, const char *token, st_buf_t *out);
+st_path_e st_transport_command(const char *device_id, const char *token,
+                               const char *commands_json, st_buf_t *out);
+
+const char *st_path_str(st_path_e path);
+
+// Calls answered per path, and local attempts that fell back to REST.
+void st_transport_counts(unsigned long *local, unsigned long *cloud, unsigned long *fallbacks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+#include "st_ui_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void st_ui_log_init(st_ui_log_t *log, Evas_Object *entry) {
+    memset(log, 0, sizeof(*log));
+    log->entry = entry;
+    log->shown = 1;
+}
+
+void st_ui_log_cleanup(st_ui_log_t *log) {
+    if (log->job) ecore_job_del(log->job);
+    for (size_t i = 0; i < ST_UI_LOG_LINES; i++) free(log->lines[i]);
+    memset(log, 0, sizeof(*log));
+}
+
+// i-th oldest line still in the ring
+static const char *ring_line(const st_ui_log_t *log, size_t i) {
+    size_t first = (log->head + ST_UI_LOG_LINES - log->count) % ST_UI_LOG_LINES;
+    return log->lines[(first + i) % ST_UI_LOG_LINES];
+}
+
+static void rebuild(st_ui_log_t *log) {
+    size_t total = 1;
+    for (size_t i = 0; i < log->count; i++) total += strlen(ring_line(log, i)) + 4;
+    char *txt = malloc(total);
+    if (!txt) return;
+    size_t n = 0;
+    for (size_t i = 0; i < log->count; i++) {
+        const char *l = ring_line(log, i);
+        size_t k = strlen(l);
+        if (i) { memcpy(txt + n, "<br>", 4); n += 4; }
+        memcpy(txt + n, l, k);
+        n += k;
+    }
+    txt[n] = '\0';
+    elm_entry_entry_set(log->entry, txt);
+    free(txt);
+    log->shown = log->count;
+}
+
+static void flush_job(void *data) {
+    st_ui_log_t *log = data;
+    log->job = NULL;
+    if (!log->entry || !log->pending) return;
+
+    if (log->shown + log->pending >= 2 * ST_UI_LOG_LINES) {
+        rebuild(log);
+    } else {
+        for (size_t i = log->count - log->pending; i < log->count; i++) {
+            elm_entry_entry_append(log->entry, "<br>");
+            elm_entry_entry_append(log->entry, ring_line(log, i));
+        }
+        log->shown += log->pending;
+    }
+    log->pending = 0;
+    elm_entry_cursor_end_set(log->entry);
+}
+
+void st_ui_log_append(st_ui_log_t *log, const char *text) {
+    char *line = strdup(text ? text : "");
+    if (!line) return;
+    free(log->lines[log->head]);
+    log->lines[log->head] = line;
+    log->head = (log->head + 1) % ST_UI_LOG_LINES;
+    if (log->count < ST_UI_LOG_LINES) log->count++;
+    if (log->pending < log->count) log->pending++;
+    else log->shown = 2 * ST_UI_LOG_LINES;     // overran the ring between flushes: rebuild
+
+    if (!log->job) log->job = ecore_job_add(flush_job, log);
+}
@@ -0,0 +1,46 @@
+#ifndef ST_UI_LOG_H
+#define ST_UI_LOG_H
+
+#include <Elementary.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- UI LOG ----------
+// The on-screen log used to read back the whole entry text, append one
+// line with sprintf and set it all again: quadratic in the log length,
+// which live capture makes unbounded. Lines now go into a fixed ring;
+// new lines are appended to the widget only (elm_entry_entry_append), at
+// most once per main-loop iteration via an ecore_job. When the widget
+// holds twice the ring capacity it is rebuilt from the ring once, so its
+// size stays bounded as well.
+//
+// Main loop only.
+
+#define ST_UI_LOG_LINES 200
+
+typedef struct {
+    Evas_Object *entry;
+    char *lines[ST_UI_LOG_LINES];   // ring, malloc'd markup lines
+    size_t head;                    // next slot to write
+    size_t count;                   // lines in the ring
+    size_t pending;                 // newest lines not yet in the widget
+    size_t shown;                   // lines currently in the widget
+    Ecore_Job *job;
+} st_ui_log_t;
+
+// entry keeps its current text as the first line.
+void st_ui_log_init(st_ui_log_t *log, Evas_Object *entry);
+void st_ui_log_cleanup(st_ui_log_t *log);
+
+// text is entry markup (e.g. "<b>..</b>").
+void st_ui_log_append(st_ui_log_t *log, const char *text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
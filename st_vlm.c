@@ -0,0 +1,285 @@
+#include "st_vlm.h"
+
+#include "st_json_path.h"
+
+#include <dlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "ST_VLM"
+
+size_t st_json_escape(const char *s, char *out) {
+    size_t j = 0;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        const char *esc = NULL;
+        switch (*p) {
+        case '"':  esc = "\\\""; break;
+        case '\\': esc = "\\\\"; break;
+        case '\n': esc = "\\n"; break;
+        case '\r': esc = "\\r"; break;
+        case '\t': esc = "\\t"; break;
+        case '\b': esc = "\\b"; break;
+        case '\f': esc = "\\f"; break;
+        default: break;
+        }
+        if (esc) {
+            size_t n = strlen(esc);
+            if (out) memcpy(out + j, esc, n);
+            j += n;
+        } else if (*p < 0x20) {
+            if (out) snprintf(out + j, 7, "\\u%04x", *p);
+            j += 6;
+        } else {
+            if (out) out[j] = (char)*p;
+            j++;
+        }
+    }
+    return j;
+}
+
+// ---------- PROMPT TEMPLATE ----------
+static const char PROMPT_HEAD[] = "{\"method\":\"generate_from_image\",\"params\":[\"";
+static const char PROMPT_MID[] = "\",\"";
+
+bool st_vlm_prompt_compile(st_vlm_prompt_t *t, const char *prompt, int id) {
+    memset(t, 0, sizeof(*t));
+    if (!prompt) return false;
+    const size_t head = sizeof(PROMPT_HEAD) - 1, mid = sizeof(PROMPT_MID) - 1;
+    size_t plen = st_json_escape(prompt, NULL);
+    t->prefix = malloc(head + plen + mid + 1);
+    if (!t->prefix) return false;
+    memcpy(t->prefix, PROMPT_HEAD, head);
+    st_json_escape(prompt, t->prefix + head);
+    memcpy(t->prefix + head + plen, PROMPT_MID, mid + 1);
+    t->prefix_len = head + plen + mid;
+    t->suffix_len = (size_t)snprintf(t->suffix, sizeof(t->suffix), "\"],\"id\":%d}", id);
+    return true;
+}
+
+void st_vlm_prompt_free(st_vlm_prompt_t *t) {
+    if (!t) return;
+    free(t->prefix);
+    memset(t, 0, sizeof(*t));
+}
+
+size_t st_vlm_prompt_len(const st_vlm_prompt_t *t, size_t base64_len) {
+    return t->prefix_len + base64_len + t->suffix_len;
+}
+
+char *st_vlm_prompt_render(const st_vlm_prompt_t *t, const char *base64, size_t base64_len,
+                           size_t *len_out) {
+    if (!t || !t->prefix || !base64) return NULL;
+    size_t n = st_vlm_prompt_len(t, base64_len);
+    char *out = malloc(n + 1);
+    if (!out) return NULL;
+    memcpy(out, t->prefix, t->prefix_len);
+    memcpy(out + t->prefix_len, base64, base64_len);
+    memcpy(out + t->prefix_len + base64_len, t->suffix, t->suffix_len + 1);
+    if (len_out) *len_out = n;
+    return out;
+}
+
+// ---------- BODY SOURCE ----------
+#define BODY_PARTS 3
+
+typedef struct {
+    const char *ptr[BODY_PARTS];
+    size_t len[BODY_PARTS];
+    int part;
+    size_t off;
+} body_source_t;
+
+static size_t body_read(char *dst, size_t cap, void *ctx) {
+    body_source_t *b = ctx;
+    size_t n = 0;
+    while (n < cap && b->part < BODY_PARTS) {
+        size_t left = b->len[b->part] - b->off;
+        if (left == 0) { b->part++; b->off = 0; continue; }
+        size_t take = left < cap - n ? left : cap - n;
+        memcpy(dst + n, b->ptr[b->part] + b->off, take);
+        n += take;
+        b->off += take;
+    }
+    return n;
+}
+
+bool st_vlm_send_prompt(const st_vlm_endpoint_t *ep, const st_vlm_prompt_t *t,
+                        const char *base64, size_t base64_len,
+                        st_buf_t *reply, st_http_info_t *info) {
+    if (!ep || !ep->url || !t || !t->prefix || !base64) return false;
+
+    // the image is sent from base64 in place, between the precompiled framing
+    body_source_t src = {
+        .ptr = { t->prefix, base64, t->suffix },
+        .len = { t->prefix_len, base64_len, t->suffix_len },
+    };
+    st_http_req_t req = {
+        .url = ep->url,
+        .bearer = ep->bearer,
+        .content_type = "application/json",
+        .read_fn = body_read,
+        .read_ctx = &src,
+        .read_len = ep->chunked ? -1 : (long long)st_vlm_prompt_len(t, base64_len),
+        .timeout_sec = ep->timeout_sec,
+        .cancelled = ep->cancelled,
+        .xfer_ctx = ep->cancel_ctx,
+    };
+    return st_http_perform(&req, reply, NULL, info);
+}
+
+bool st_vlm_send(const st_vlm_endpoint_t *ep, const char *prompt,
+                 const char *base64, size_t base64_len, int id,
+                 st_buf_t *reply, st_http_info_t *info) {
+    st_vlm_prompt_t t;
+    if (!st_vlm_prompt_compile(&t, prompt, id)) return false;
+    bool ok = st_vlm_send_prompt(ep, &t, base64, base64_len, reply, info);
+    st_vlm_prompt_free(&t);
+    return ok;
+}
+
+// ---------- MULTI-PROMPT ----------
+static const char BATCH_HEAD[] = "{\"method\":\"generate_batch_from_image\",\"params\":[[\"";
+static const char BATCH_SEP[] = "\",\"";
+static const char BATCH_MID[] = "\"],\"";
+
+bool st_vlm_prompt_compile_batch(st_vlm_prompt_t *t, const char *const *prompts, size_t n, int id) {
+    memset(t, 0, sizeof(*t));
+    if (!prompts || !n) return false;
+    const size_t head = sizeof(BATCH_HEAD) - 1, sep = sizeof(BATCH_SEP) - 1, mid = sizeof(BATCH_MID) - 1;
+    size_t len = head + mid;
+    for (size_t i = 0; i < n; i++) {
+        if (!prompts[i]) return false;
+        len += st_json_escape(prompts[i], NULL) + (i ? sep : 0);
+    }
+    t->prefix = malloc(len + 1);
+    if (!t->prefix) return false;
+    char *w = t->prefix;
+    memcpy(w, BATCH_HEAD, head);
+    w += head;
+    for (size_t i = 0; i < n; i++) {
+        if (i) { memcpy(w, BATCH_SEP, sep); w += sep; }
+        w += st_json_escape(prompts[i], w);
+    }
+    memcpy(w, BATCH_MID, mid + 1);
+    t->prefix_len = len;
+    t->suffix_len = (size_t)snprintf(t->suffix, sizeof(t->suffix), "\"],\"id\":%d}", id);
+    return true;
+}
+
+bool st_vlm_prompt_set_add(st_vlm_prompt_set_t *set, const char *label, const char *text) {
+    if (!text || !*text || set->n == ST_VLM_MAX_PROMPTS) return false;
+    char *copy = strdup(text);
+    if (!copy) return false;
+    snprintf(set->label[set->n], sizeof(set->label[0]), "%s", (label && *label) ? label : "prompt");
+    set->text[set->n++] = copy;
+    return true;
+}
+
+// "\n" in the file stands for a newline (prompts are multi-line chat templates).
+static void unescape_newlines(char *s) {
+    char *w = s;
+    for (const char *r = s; *r; r++) {
+        if (r[0] == '\\' && r[1] == 'n') { *w++ = '\n'; r++; }
+        else *w++ = *r;
+    }
+    *w = '\0';
+}
+
+static int load_lines(st_vlm_prompt_set_t *set, FILE *fp, const char *want) {
+    char line[4096];
+    int added = 0;
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        char id[64] = {0}, label[32] = {0};
+        int n = 0;
+        if (sscanf(line, "%63s %31s %n", id, label, &n) != 2 || !n) continue;
+        if (strcmp(id, want) != 0) continue;
+        unescape_newlines(line + n);
+        if (st_vlm_prompt_set_add(set, label, line + n)) added++;
+        else dlog_print(DLOG_WARN, LOG_TAG, "prompt %s/%s not added", id, label);
+    }
+    return added;
+}
+
+int st_vlm_prompt_set_load(st_vlm_prompt_set_t *set, const char *path, const char *device_id) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    int added = device_id ? load_lines(set, fp, device_id) : 0;
+    if (!added) added = load_lines(set, fp, "*");
+    fclose(fp);
+    return added;
+}
+
+bool st_vlm_prompt_set_compile(st_vlm_prompt_set_t *set, int id) {
+    st_vlm_prompt_free(&set->tmpl);
+    set->id = id;
+    if (set->n == 1) return st_vlm_prompt_compile(&set->tmpl, set->text[0], id);
+    return st_vlm_prompt_compile_batch(&set->tmpl, (const char *const *)set->text, set->n, id);
+}
+
+void st_vlm_prompt_set_free(st_vlm_prompt_set_t *set) {
+    if (!set) return;
+    for (size_t i = 0; i < set->n; i++) free(set->text[i]);
+    st_vlm_prompt_free(&set->tmpl);
+    memset(set, 0, sizeof(*set));
+}
+
+// The "result" string of a single-prompt JSON-RPC reply into answer i;
+// ok[i] only when the reply has one.
+static bool answer_set(st_vlm_answers_t *a, size_t i, const st_buf_t *reply) {
+    st_json_target_t t = { "result", a->text[i], sizeof(a->text[i]), false };
+    if (reply->buf) st_json_extract(reply->buf, reply->len, &t, 1);
+    if (!t.found) a->text[i][0] = '\0';
+    return a->ok[i] = t.found;
+}
+
+bool st_vlm_send_set(const st_vlm_endpoint_t *ep, const st_vlm_prompt_set_t *set,
+                     const char *base64, size_t base64_len,
+                     st_vlm_answers_t *answers, st_http_info_t *info) {
+    memset(answers, 0, sizeof(*answers));
+    if (!set || !set->n) return false;
+    answers->n = set->n;
+    st_buf_t reply = {0};
+    st_http_info_t local;
+    if (!info) info = &local;
+
+    if (set->n == 1) {
+        bool ok = st_vlm_send_prompt(ep, &set->tmpl, base64, base64_len, &reply, info) &&
+                  answer_set(answers, 0, &reply);
+        free(reply.buf);
+        return ok;
+    }
+
+    bool ok = st_vlm_send_prompt(ep, &set->tmpl, base64, base64_len, &reply, info);
+    char code[16] = "";
+    size_t got = 0;
+    if (reply.buf) {
+        char paths[ST_VLM_MAX_PROMPTS][24];
+        st_json_target_t t[ST_VLM_MAX_PROMPTS + 1];
+        for (size_t i = 0; i < set->n; i++) {
+            snprintf(paths[i], sizeof(paths[i]), "result[%zu]", i);
+            t[i] = (st_json_target_t){ paths[i], answers->text[i], sizeof(answers->text[i]), false };
+        }
+        t[set->n] = (st_json_target_t){ "error.code", code, sizeof(code), false };
+        st_json_extract(reply.buf, reply.len, t, set->n + 1);
+        for (size_t i = 0; i < set->n; i++)
+            if ((answers->ok[i] = t[i].found)) got++;
+    }
+    free(reply.buf);
+    if (ok && got) return true;
+
+    // no batch method on this service: one request per prompt, image resent each time
+    if (strcmp(code, "-32601") != 0) return got > 0;
+    dlog_print(DLOG_WARN, LOG_TAG, "%s has no batch method, sending %zu prompts one by one", ep->url, set->n);
+    for (size_t i = 0; i < set->n; i++) {
+        st_buf_t one = {0};
+        if (st_vlm_send(ep, set->text[i], base64, base64_len, set->id, &one, info) &&
+            answer_set(answers, i, &one))
+            got++;
+        free(one.buf);
+    }
+    return got > 0;
+}
@@ -0,0 +1,116 @@
+#ifndef ST_VLM_H
+#define ST_VLM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "st_http.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- VLM EVALUATION SENDER ----------
+// Posts {"method":"generate_from_image","params":[<prompt>,<base64>],"id":N}
+// to the evaluation service without ever building the JSON: the body is
+// streamed from its pieces (fixed framing, escaped prompt, the caller's
+// base64 buffer) by a curl read callback. The request goes through the
+// st_http pool, so consecutive captures reuse one keep-alive connection.
+
+typedef struct {
+    const char *url;            // e.g. "http://192.168.3.80:9090/generate"
+    const char *bearer;         // optional
+    long timeout_sec;           // 0 -> ST_HTTP_DEFAULT_TIMEOUT_SEC
+    bool chunked;               // send without Content-Length (chunked on HTTP/1.1)
+    bool (*cancelled)(void *ctx); // optional, see st_http_req_t
+    void *cancel_ctx;
+} st_vlm_endpoint_t;
+
+// JSON string escape of s into out (without quotes). Returns the escaped
+// length; when out is NULL only the length is computed.
+size_t st_json_escape(const char *s, char *out);
+
+// ---------- PROMPT TEMPLATE ----------
+// The request for a fixed prompt and id is always
+//   prefix  = {"method":"generate_from_image","params":["<escaped prompt>","
+//   base64
+//   suffix  = "],"id":N}
+// Compiled once, a capture only supplies the base64: nothing is escaped,
+// formatted or copied per request.
+typedef struct {
+    char *prefix;
+    size_t prefix_len;
+    char suffix[32];
+    size_t suffix_len;
+} st_vlm_prompt_t;
+
+bool st_vlm_prompt_compile(st_vlm_prompt_t *t, const char *prompt, int id);
+void st_vlm_prompt_free(st_vlm_prompt_t *t);
+// Request body length for base64_len bytes of image.
+size_t st_vlm_prompt_len(const st_vlm_prompt_t *t, size_t base64_len);
+// The whole body in one malloc'd buffer (debug files); *len_out is set.
+char *st_vlm_prompt_render(const st_vlm_prompt_t *t, const char *base64, size_t base64_len,
+                           size_t *len_out);
+
+// Sends one image with a compiled prompt; the three pieces are streamed by
+// the read callback. The reply body is returned in reply (caller frees).
+bool st_vlm_send_prompt(const st_vlm_endpoint_t *ep, const st_vlm_prompt_t *t,
+                        const char *base64, size_t base64_len,
+                        st_buf_t *reply, st_http_info_t *info);
+
+// One-off form: compiles prompt for this request only.
+bool st_vlm_send(const st_vlm_endpoint_t *ep, const char *prompt,
+                 const char *base64, size_t base64_len, int id,
+                 st_buf_t *reply, st_http_info_t *info);
+
+// ---------- MULTI-PROMPT ----------
+// Several questions about one frame go out as one request that carries
+// the image once:
+//   {"method":"generate_batch_from_image","params":[["<p1>","<p2>",..],"<base64>"],"id":N}
+// and come back as {"result":["<a1>","<a2>",..]} in prompt order. A set
+// with one prompt keeps the single-prompt request. Services without the
+// batch method (JSON-RPC error -32601) are asked once per prompt instead.
+//
+// Prompt file format (one prompt per line, '#' comments, \n in the text):
+//   <deviceId|*> <label> <prompt text...>
+// A device uses its own lines, else the '*' lines.
+
+#define ST_VLM_MAX_PROMPTS 8
+#define ST_VLM_ANSWER_MAX 512
+
+typedef struct {
+    size_t n;
+    char label[ST_VLM_MAX_PROMPTS][32];
+    char *text[ST_VLM_MAX_PROMPTS];
+    st_vlm_prompt_t tmpl;       // request framing for all n prompts
+    int id;
+} st_vlm_prompt_set_t;
+
+typedef struct {
+    size_t n;
+    bool ok[ST_VLM_MAX_PROMPTS];
+    char text[ST_VLM_MAX_PROMPTS][ST_VLM_ANSWER_MAX];
+} st_vlm_answers_t;
+
+bool st_vlm_prompt_compile_batch(st_vlm_prompt_t *t, const char *const *prompts, size_t n, int id);
+
+bool st_vlm_prompt_set_add(st_vlm_prompt_set_t *set, const char *label, const char *text);
+// Adds device_id's prompts from path (or the '*' ones when it has none);
+// returns how many were added, -1 if unreadable.
+int st_vlm_prompt_set_load(st_vlm_prompt_set_t *set, const char *path, const char *device_id);
+bool st_vlm_prompt_set_compile(st_vlm_prompt_set_t *set, int id);
+void st_vlm_prompt_set_free(st_vlm_prompt_set_t *set);
+
+// Asks every prompt of set about one image; answers->n == set->n and
+// text[i] is the bare "result" string whichever way it was asked (ok[i]
+// false when the reply had none). False when no answer arrived at all;
+// the reply of a failed request is in info.
+bool st_vlm_send_set(const st_vlm_endpoint_t *ep, const st_vlm_prompt_set_t *set,
+                     const char *base64, size_t base64_len,
+                     st_vlm_answers_t *answers, st_http_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
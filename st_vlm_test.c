@@ -0,0 +1,92 @@
+// cmake -DST_TESTS=ON ... && ctest
+//
+// st_vlm_send_set against the mock's /vlm route (st_mock_server.c): a
+// one-prompt set, a batch set, and a batch set on a service without the
+// batch method (one request per prompt). Whichever way a prompt was
+// asked, its answer must be the bare "result" string, not the reply body.
+
+#include <curl/curl.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "st_http.h"
+#include "st_mock_server.h"
+#include "st_vlm.h"
+
+static volatile sig_atomic_t g_stop = 0;
+static st_mock_cfg_t g_cfg;
+static int g_failures = 0;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                     \
+        }                                                                     \
+    } while (0)
+
+static void *mock_main(void *arg) {
+    (void)arg;
+    st_mock_run(&g_cfg, &g_stop, NULL);
+    return NULL;
+}
+
+static void check_set(const st_vlm_endpoint_t *ep, const char *const *prompts, size_t n) {
+    st_vlm_prompt_set_t set;
+    memset(&set, 0, sizeof(set));
+    for (size_t i = 0; i < n; i++) CHECK(st_vlm_prompt_set_add(&set, "q", prompts[i]));
+    CHECK(st_vlm_prompt_set_compile(&set, 1));
+
+    static const char b64[] = "/9j/4AAQSkZJRgABAQ==";
+    st_vlm_answers_t answers;
+    st_http_info_t info;
+    CHECK(st_vlm_send_set(ep, &set, b64, sizeof(b64) - 1, &answers, &info));
+    CHECK(answers.n == n);
+    for (size_t i = 0; i < n; i++) {
+        char want[ST_VLM_ANSWER_MAX];
+        snprintf(want, sizeof(want), "answer: %s", prompts[i]);
+        CHECK(answers.ok[i]);
+        if (strcmp(answers.text[i], want) != 0) {
+            fprintf(stderr, "prompt %zu of %zu: got '%s', want '%s'\n", i, n, answers.text[i], want);
+            g_failures++;
+        }
+    }
+    st_vlm_prompt_set_free(&set);
+}
+
+int main(void) {
+    st_mock_cfg_default(&g_cfg);
+    g_cfg.port = 18000 + (int)(getpid() % 1000);
+    g_cfg.routes[ST_MOCK_VLM].latency_ms = 0;
+    g_cfg.routes[ST_MOCK_VLM].jitter_ms = 0;
+    pthread_t th;
+    if (pthread_create(&th, NULL, mock_main, NULL) != 0) return 1;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    st_http_init();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/vlm", g_cfg.port);
+    const st_vlm_endpoint_t ep = { .url = url, .timeout_sec = 10 };
+    // the mock binds in its thread: wait until it answers
+    for (int i = 0; i < 100 && !st_http_prewarm(url); i++) usleep(20000);
+
+    static const char *const one[] = { "Is there a person at the door?" };
+    static const char *const two[] = { "Is there a person?", "Is the \"door\" open?" };
+
+    check_set(&ep, one, 1);
+    check_set(&ep, two, 2);
+    g_cfg.vlm_batch = false;        // -32601: asked one by one
+    check_set(&ep, two, 2);
+
+    g_stop = 1;
+    pthread_join(th, NULL);
+    st_http_cleanup();
+    curl_global_cleanup();
+    if (g_failures) fprintf(stderr, "%d check(s) failed\n", g_failures);
+    else printf("st_vlm_test: ok\n");
+    return g_failures ? 1 : 0;
+}
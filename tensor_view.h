@@ -0,0 +1,250 @@
+#pragma once
+
+#include <onnxruntime_cxx_api.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ============================================================
+// Typed N-dimensional tensor view for ONNX inputs
+//
+// A TensorView is a non-owning {pointer, dtype, shape, strides}
+// description of caller-owned or mmapped memory. Any rank, strides
+// in elements (C order, Fortran order or arbitrary).
+//
+//   as_ort_value()   zero-copy Ort::Value; requires C-contiguous
+//   reversed()       Fortran array seen as its C-order transpose,
+//                    still zero-copy (shape reversed)
+//   copy_to_c()      gathers any layout into a C-order destination
+//
+// Supported dtypes: f16, f32, f64, i8, u8, i32, i64, bool.
+// ============================================================
+
+enum class DType { F16, F32, F64, I8, U8, I32, I64, Bool };
+
+static inline size_t dtype_size(DType t) {
+    switch (t) {
+    case DType::F16: return 2;
+    case DType::F32: return 4;
+    case DType::F64: return 8;
+    case DType::I8:  return 1;
+    case DType::U8:  return 1;
+    case DType::I32: return 4;
+    case DType::I64: return 8;
+    case DType::Bool: return 1;
+    }
+    return 0;
+}
+
+static inline const char* dtype_name(DType t) {
+    switch (t) {
+    case DType::F16: return "float16";
+    case DType::F32: return "float32";
+    case DType::F64: return "float64";
+    case DType::I8:  return "int8";
+    case DType::U8:  return "uint8";
+    case DType::I32: return "int32";
+    case DType::I64: return "int64";
+    case DType::Bool: return "bool";
+    }
+    return "?";
+}
+
+static inline ONNXTensorElementDataType dtype_to_onnx(DType t) {
+    switch (t) {
+    case DType::F16: return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+    case DType::F32: return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+    case DType::F64: return ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE;
+    case DType::I8:  return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8;
+    case DType::U8:  return ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8;
+    case DType::I32: return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32;
+    case DType::I64: return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64;
+    case DType::Bool: return ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL;
+    }
+    return ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+}
+
+static inline DType dtype_from_onnx(ONNXTensorElementDataType t) {
+    switch (t) {
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: return DType::F16;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:   return DType::F32;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:  return DType::F64;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:    return DType::I8;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:   return DType::U8;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:   return DType::I32;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:   return DType::I64;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:    return DType::Bool;
+    default: break;
+    }
+    throw std::runtime_error("Unsupported ONNX element type " + std::to_string(static_cast<int>(t)));
+}
+
+// numpy descr ('<f4', '|u1', ...) -> DType. Big-endian is rejected.
+static inline DType dtype_from_npy(const std::string& d) {
+    if (d.size() != 3 || d[0] == '>') {
+        throw std::runtime_error("Unsupported dtype in .npy header: " + d);
+    }
+    std::string k = d.substr(1);
+    if (k == "f2") return DType::F16;
+    if (k == "f4") return DType::F32;
+    if (k == "f8") return DType::F64;
+    if (k == "i1") return DType::I8;
+    if (k == "u1") return DType::U8;
+    if (k == "i4") return DType::I32;
+    if (k == "i8") return DType::I64;
+    if (k == "b1") return DType::Bool;
+    throw std::runtime_error("Unsupported dtype in .npy header: " + d);
+}
+
+// DType -> numpy descr, for writing .npy headers.
+static inline const char* dtype_to_npy(DType t) {
+    switch (t) {
+    case DType::F16: return "<f2";
+    case DType::F32: return "<f4";
+    case DType::F64: return "<f8";
+    case DType::I8:  return "|i1";
+    case DType::U8:  return "|u1";
+    case DType::I32: return "<i4";
+    case DType::I64: return "<i8";
+    case DType::Bool: return "|b1";
+    }
+    return "?";
+}
+
+template <typename T> struct DTypeOf;
+template <> struct DTypeOf<float>    { static constexpr DType value = DType::F32; };
+template <> struct DTypeOf<double>   { static constexpr DType value = DType::F64; };
+template <> struct DTypeOf<int8_t>   { static constexpr DType value = DType::I8; };
+template <> struct DTypeOf<uint8_t>  { static constexpr DType value = DType::U8; };
+template <> struct DTypeOf<int32_t>  { static constexpr DType value = DType::I32; };
+template <> struct DTypeOf<int64_t>  { static constexpr DType value = DType::I64; };
+template <> struct DTypeOf<uint16_t> { static constexpr DType value = DType::F16; };  // raw half bits
+
+static inline std::vector<int64_t> c_strides(const std::vector<int64_t>& shape) {
+    std::vector<int64_t> s(shape.size());
+    int64_t acc = 1;
+    for (size_t i = shape.size(); i-- > 0;) {
+        s[i] = acc;
+        acc *= shape[i];
+    }
+    return s;
+}
+
+static inline std::vector<int64_t> f_strides(const std::vector<int64_t>& shape) {
+    std::vector<int64_t> s(shape.size());
+    int64_t acc = 1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        s[i] = acc;
+        acc *= shape[i];
+    }
+    return s;
+}
+
+struct TensorView {
+    void* data = nullptr;
+    DType dtype = DType::F32;
+    std::vector<int64_t> shape;
+    std::vector<int64_t> strides;   // in elements
+
+    static TensorView c_order(void* p, DType t, std::vector<int64_t> shape) {
+        TensorView v;
+        v.data = p;
+        v.dtype = t;
+        v.strides = c_strides(shape);
+        v.shape = std::move(shape);
+        return v;
+    }
+
+    static TensorView fortran_order(void* p, DType t, std::vector<int64_t> shape) {
+        TensorView v;
+        v.data = p;
+        v.dtype = t;
+        v.strides = f_strides(shape);
+        v.shape = std::move(shape);
+        return v;
+    }
+
+    size_t element_count() const {
+        size_t n = 1;
+        for (int64_t d : shape) n *= static_cast<size_t>(d);
+        return n;
+    }
+    size_t byte_size() const { return element_count() * dtype_size(dtype); }
+
+    bool is_c_contiguous() const { return strides == c_strides(shape); }
+
+    // Zero-copy; the memory must outlive the returned value.
+    Ort::Value as_ort_value(const Ort::MemoryInfo& mem_info) const {
+        if (!is_c_contiguous()) {
+            throw std::runtime_error("TensorView is not C-contiguous; use reversed() or copy_to_c()");
+        }
+        return Ort::Value::CreateTensor(mem_info, data, byte_size(),
+                                        shape.data(), shape.size(), dtype_to_onnx(dtype));
+    }
+
+    template <typename T>
+    T* typed() const {
+        if (DTypeOf<T>::value != dtype) {
+            throw std::runtime_error(std::string("Unexpected dtype. Expected ") +
+                                     dtype_name(DTypeOf<T>::value) + ", got " + dtype_name(dtype));
+        }
+        return static_cast<T*>(data);
+    }
+
+    // Same bytes with dimensions (and strides) reversed. A Fortran
+    // array becomes a C-contiguous view of its transpose.
+    TensorView reversed() const {
+        TensorView v = *this;
+        v.shape.assign(shape.rbegin(), shape.rend());
+        v.strides.assign(strides.rbegin(), strides.rend());
+        return v;
+    }
+
+    // Gathers this view into dst in C order (dst holds byte_size()).
+    void copy_to_c(void* dst) const {
+        const size_t es = dtype_size(dtype);
+        const size_t n = element_count();
+        if (is_c_contiguous()) {
+            std::memcpy(dst, data, n * es);
+            return;
+        }
+        if (n == 0) return;
+
+        const size_t rank = shape.size();
+        std::vector<int64_t> idx(rank, 0);
+        const char* src = static_cast<const char*>(data);
+        char* out = static_cast<char*>(dst);
+        for (size_t i = 0; i < n; ++i) {
+            int64_t off = 0;
+            for (size_t d = 0; d < rank; ++d) off += idx[d] * strides[d];
+            std::memcpy(out + i * es, src + off * static_cast<int64_t>(es), es);
+            for (size_t d = rank; d-- > 0;) {
+                if (++idx[d] < shape[d]) break;
+                idx[d] = 0;
+            }
+        }
+    }
+};
+
+// Owned, 64-byte aligned C-order copy for views that cannot be bound
+// directly (strided or Fortran inputs that the model needs untransposed).
+struct ContiguousTensor {
+    std::unique_ptr<void, void (*)(void*)> buf{nullptr, std::free};
+    TensorView view;
+
+    static ContiguousTensor from(const TensorView& src) {
+        ContiguousTensor t;
+        size_t bytes = (src.byte_size() + 63) / 64 * 64;
+        void* p = std::aligned_alloc(64, bytes ? bytes : 64);
+        if (!p) throw std::runtime_error("ContiguousTensor: allocation failed");
+        t.buf.reset(p);
+        src.copy_to_c(p);
+        t.view = TensorView::c_order(p, src.dtype, src.shape);
+        return t;
+    }
+};